@@ -0,0 +1,491 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Steps canonical scenes through the public cb2World API and prints the per phase
+// profile statistics and the memory high-water marks as JSON. No window or GL is
+// needed, only the engine sources and the cinder math headers:
+//
+//   c++ -O2 -std=c++11 -pthread -Isrc -I<cinder>/include benchmarks/cb2Benchmark.cpp <engine .cpp files>
+//
+// or with -DCB2_HEADLESS in place of the cinder include path.
+//
+// Usage: cb2Benchmark [frames] [threads] [scene]
+
+#include <CinderBox2D/CinderBox2D.h>
+#include <CinderBox2D/Dynamics/cb2ProfileStats.h>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Counting allocator
+
+struct cb2MemoryCounter
+{
+	std::atomic<long long> current[cb2_memoryTagCount];
+	std::atomic<long long> peak[cb2_memoryTagCount];
+	std::atomic<long long> totalCurrent;
+	std::atomic<long long> totalPeak;
+	std::atomic<long long> allocationCount;
+};
+
+static cb2MemoryCounter s_memory;
+
+static void UpdatePeak(std::atomic<long long>* peak, long long value)
+{
+	long long old = peak->load();
+	while (value > old && peak->compare_exchange_weak(old, value) == false)
+	{
+	}
+}
+
+// The size is kept in front of the block, at the alignment so the block stays aligned.
+static void* CountingAlloc(int size, int alignment, cb2MemoryTag tag, void* context)
+{
+	CB2_NOT_USED(context);
+	int header = alignment < 16 ? 16 : alignment;
+	char* mem = (char*)malloc(size + 2 * header);
+	if (mem == NULL)
+	{
+		return NULL;
+	}
+
+	char* block = (char*)(((size_t)mem + 2 * header - 1) & ~(size_t)(header - 1));
+	((long long*)block)[-1] = size;
+	((void**)block)[-2] = mem;
+
+	long long current = s_memory.current[tag] += size;
+	UpdatePeak(s_memory.peak + tag, current);
+	long long total = s_memory.totalCurrent += size;
+	UpdatePeak(&s_memory.totalPeak, total);
+	++s_memory.allocationCount;
+	return block;
+}
+
+static void CountingFree(void* mem, cb2MemoryTag tag, void* context)
+{
+	CB2_NOT_USED(context);
+	if (mem == NULL)
+	{
+		return;
+	}
+
+	long long size = ((long long*)mem)[-1];
+	s_memory.current[tag] -= size;
+	s_memory.totalCurrent -= size;
+	free(((void**)mem)[-2]);
+}
+
+static void ResetPeaks()
+{
+	for (int i = 0; i < cb2_memoryTagCount; ++i)
+	{
+		s_memory.peak[i] = s_memory.current[i].load();
+	}
+	s_memory.totalPeak = s_memory.totalCurrent.load();
+	s_memory.allocationCount = 0;
+}
+
+// Scenes
+
+struct Scene
+{
+	const char* name;
+	void (*build)(cb2World* world);
+	void (*update)(cb2World* world, int frame);
+};
+
+static cb2Body* CreateGround(cb2World* world, float halfWidth)
+{
+	cb2BodyDef bd;
+	cb2Body* ground = world->CreateBody(&bd);
+	cb2EdgeShape shape;
+	shape.Set(ci::Vec2f(-halfWidth, 0.0f), ci::Vec2f(halfWidth, 0.0f));
+	ground->CreateFixture(&shape, 0.0f);
+	return ground;
+}
+
+static cb2Body* CreateBox(cb2World* world, const ci::Vec2f& position, float hx, float hy, float angle)
+{
+	cb2BodyDef bd;
+	bd.type = cb2_dynamicBody;
+	bd.position = position;
+	bd.angle = angle;
+	cb2Body* body = world->CreateBody(&bd);
+	cb2PolygonShape shape;
+	shape.SetAsBox(hx, hy);
+	body->CreateFixture(&shape, 1.0f);
+	return body;
+}
+
+static cb2Body* CreateBall(cb2World* world, const ci::Vec2f& position, float radius)
+{
+	cb2BodyDef bd;
+	bd.type = cb2_dynamicBody;
+	bd.position = position;
+	cb2Body* body = world->CreateBody(&bd);
+	cb2CircleShape shape;
+	shape.m_radius = radius;
+	body->CreateFixture(&shape, 1.0f);
+	return body;
+}
+
+// A 60 row pyramid of 1830 boxes.
+static void BuildPyramid(cb2World* world)
+{
+	CreateGround(world, 80.0f);
+	const int rowCount = 60;
+	for (int i = 0; i < rowCount; ++i)
+	{
+		float y = 0.5f + 1.0f * i;
+		float x0 = -0.5f * (rowCount - i - 1);
+		for (int j = 0; j < rowCount - i; ++j)
+		{
+			CreateBox(world, ci::Vec2f(x0 + 1.0f * j, y), 0.5f, 0.5f, 0.0f);
+		}
+	}
+}
+
+// Four rotating boxes driven by motors, each with 300 small bodies inside.
+static void BuildTumblers(cb2World* world)
+{
+	cb2BodyDef bd;
+	cb2Body* ground = world->CreateBody(&bd);
+
+	for (int t = 0; t < 4; ++t)
+	{
+		ci::Vec2f center(-60.0f + 40.0f * t, 20.0f);
+		cb2BodyDef tumblerDef;
+		tumblerDef.type = cb2_dynamicBody;
+		tumblerDef.allowSleep = false;
+		tumblerDef.position = center;
+		cb2Body* tumbler = world->CreateBody(&tumblerDef);
+
+		cb2PolygonShape wall;
+		wall.SetAsBox(0.5f, 10.0f, ci::Vec2f(10.0f, 0.0f), 0.0f);
+		tumbler->CreateFixture(&wall, 5.0f);
+		wall.SetAsBox(0.5f, 10.0f, ci::Vec2f(-10.0f, 0.0f), 0.0f);
+		tumbler->CreateFixture(&wall, 5.0f);
+		wall.SetAsBox(10.0f, 0.5f, ci::Vec2f(0.0f, 10.0f), 0.0f);
+		tumbler->CreateFixture(&wall, 5.0f);
+		wall.SetAsBox(10.0f, 0.5f, ci::Vec2f(0.0f, -10.0f), 0.0f);
+		tumbler->CreateFixture(&wall, 5.0f);
+
+		cb2RevoluteJointDef jd;
+		jd.Initialize(ground, tumbler, center);
+		jd.motorSpeed = 0.05f * cb2_pi;
+		jd.maxMotorTorque = 1e8f;
+		jd.enableMotor = true;
+		world->CreateJoint(&jd);
+
+		for (int i = 0; i < 300; ++i)
+		{
+			ci::Vec2f p = center + ci::Vec2f(-8.0f + 0.8f * (i % 20), -8.0f + 0.8f * (i / 20));
+			CreateBox(world, p, 0.125f, 0.125f, 0.0f);
+		}
+	}
+}
+
+// Joints between the parts of a ragdoll, anchored where the parts meet.
+static void CreateRagdoll(cb2World* world, const ci::Vec2f& origin)
+{
+	cb2Body* torso = CreateBox(world, origin + ci::Vec2f(0.0f, 2.0f), 0.3f, 0.6f, 0.0f);
+	cb2Body* head = CreateBall(world, origin + ci::Vec2f(0.0f, 3.0f), 0.3f);
+
+	cb2Body* parts[8];
+	parts[0] = CreateBox(world, origin + ci::Vec2f(-0.6f, 2.3f), 0.3f, 0.1f, 0.0f);
+	parts[1] = CreateBox(world, origin + ci::Vec2f(-1.2f, 2.3f), 0.3f, 0.1f, 0.0f);
+	parts[2] = CreateBox(world, origin + ci::Vec2f(0.6f, 2.3f), 0.3f, 0.1f, 0.0f);
+	parts[3] = CreateBox(world, origin + ci::Vec2f(1.2f, 2.3f), 0.3f, 0.1f, 0.0f);
+	parts[4] = CreateBox(world, origin + ci::Vec2f(-0.2f, 1.0f), 0.1f, 0.4f, 0.0f);
+	parts[5] = CreateBox(world, origin + ci::Vec2f(-0.2f, 0.2f), 0.1f, 0.4f, 0.0f);
+	parts[6] = CreateBox(world, origin + ci::Vec2f(0.2f, 1.0f), 0.1f, 0.4f, 0.0f);
+	parts[7] = CreateBox(world, origin + ci::Vec2f(0.2f, 0.2f), 0.1f, 0.4f, 0.0f);
+
+	cb2RevoluteJointDef jd;
+	jd.enableLimit = true;
+	jd.lowerAngle = -0.25f * cb2_pi;
+	jd.upperAngle = 0.25f * cb2_pi;
+
+	jd.Initialize(torso, head, origin + ci::Vec2f(0.0f, 2.7f));
+	world->CreateJoint(&jd);
+	jd.Initialize(torso, parts[0], origin + ci::Vec2f(-0.3f, 2.3f));
+	world->CreateJoint(&jd);
+	jd.Initialize(parts[0], parts[1], origin + ci::Vec2f(-0.9f, 2.3f));
+	world->CreateJoint(&jd);
+	jd.Initialize(torso, parts[2], origin + ci::Vec2f(0.3f, 2.3f));
+	world->CreateJoint(&jd);
+	jd.Initialize(parts[2], parts[3], origin + ci::Vec2f(0.9f, 2.3f));
+	world->CreateJoint(&jd);
+	jd.Initialize(torso, parts[4], origin + ci::Vec2f(-0.2f, 1.4f));
+	world->CreateJoint(&jd);
+	jd.Initialize(parts[4], parts[5], origin + ci::Vec2f(-0.2f, 0.6f));
+	world->CreateJoint(&jd);
+	jd.Initialize(torso, parts[6], origin + ci::Vec2f(0.2f, 1.4f));
+	world->CreateJoint(&jd);
+	jd.Initialize(parts[6], parts[7], origin + ci::Vec2f(0.2f, 0.6f));
+	world->CreateJoint(&jd);
+}
+
+// 200 ragdolls dropped into a pit.
+static void BuildRagdolls(cb2World* world)
+{
+	cb2Body* ground = CreateGround(world, 30.0f);
+	cb2EdgeShape wall;
+	wall.Set(ci::Vec2f(-30.0f, 0.0f), ci::Vec2f(-30.0f, 80.0f));
+	ground->CreateFixture(&wall, 0.0f);
+	wall.Set(ci::Vec2f(30.0f, 0.0f), ci::Vec2f(30.0f, 80.0f));
+	ground->CreateFixture(&wall, 0.0f);
+
+	for (int i = 0; i < 200; ++i)
+	{
+		CreateRagdoll(world, ci::Vec2f(-25.0f + 2.5f * (i % 20), 2.0f + 4.0f * (i / 20)));
+	}
+}
+
+// A 60 by 60 grid of circles joined to their neighbors, hanging from the top row.
+static void BuildJointGrid(cb2World* world)
+{
+	const int n = 60;
+	cb2BodyDef bd;
+	cb2Body* ground = world->CreateBody(&bd);
+
+	cb2Body** bodies = (cb2Body**)malloc(n * n * sizeof(cb2Body*));
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			cb2BodyDef def;
+			def.type = j == 0 ? cb2_staticBody : cb2_dynamicBody;
+			def.position.set(1.0f * i, -1.0f * j);
+			cb2Body* body = world->CreateBody(&def);
+			cb2CircleShape shape;
+			shape.m_radius = 0.4f;
+			cb2FixtureDef fd;
+			fd.shape = &shape;
+			fd.density = 1.0f;
+			fd.filter.maskBits = 0;
+			body->CreateFixture(&fd);
+
+			cb2RevoluteJointDef jd;
+			if (i > 0)
+			{
+				jd.Initialize(bodies[(i - 1) * n + j], body, def.position);
+				world->CreateJoint(&jd);
+			}
+			if (j > 0)
+			{
+				jd.Initialize(bodies[i * n + j - 1], body, def.position);
+				world->CreateJoint(&jd);
+			}
+			bodies[i * n + j] = body;
+		}
+	}
+	free(bodies);
+	CB2_NOT_USED(ground);
+}
+
+// A wall of boxes hit by waves of bullets.
+static void BuildBullets(cb2World* world)
+{
+	CreateGround(world, 100.0f);
+	for (int i = 0; i < 30; ++i)
+	{
+		for (int j = 0; j < 20; ++j)
+		{
+			CreateBox(world, ci::Vec2f(20.0f + 1.0f * j, 0.5f + 1.0f * i), 0.45f, 0.45f, 0.0f);
+		}
+	}
+}
+
+static void UpdateBullets(cb2World* world, int frame)
+{
+	if (frame % 10 != 0)
+	{
+		return;
+	}
+
+	for (int i = 0; i < 20; ++i)
+	{
+		cb2BodyDef bd;
+		bd.type = cb2_dynamicBody;
+		bd.bullet = true;
+		bd.position.set(-40.0f, 1.0f + 1.5f * i);
+		bd.linearVelocity.set(300.0f, 0.0f);
+		cb2Body* body = world->CreateBody(&bd);
+		cb2CircleShape shape;
+		shape.m_radius = 0.1f;
+		body->CreateFixture(&shape, 20.0f);
+	}
+}
+
+// Hills made of one 4000 vertex chain with 1000 circles rolling down.
+static void BuildChainTerrain(cb2World* world)
+{
+	const int vertexCount = 4000;
+	ci::Vec2f* vertices = (ci::Vec2f*)malloc(vertexCount * sizeof(ci::Vec2f));
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		float x = -200.0f + 0.1f * i;
+		vertices[i].set(x, 3.0f * sinf(0.05f * x) + 0.5f * sinf(0.7f * x) - 0.02f * x);
+	}
+
+	cb2BodyDef bd;
+	cb2Body* ground = world->CreateBody(&bd);
+	cb2ChainShape chain;
+	chain.CreateChain(vertices, vertexCount);
+	ground->CreateFixture(&chain, 0.0f);
+	free(vertices);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		CreateBall(world, ci::Vec2f(-190.0f + 0.38f * i, 15.0f + (i % 5)), 0.25f);
+	}
+}
+
+// A large world of obstacles and resting boxes where only a few bodies move.
+static void BuildOpenWorld(cb2World* world)
+{
+	CreateGround(world, 500.0f);
+
+	cb2BodyDef bd;
+	cb2Body* obstacles = world->CreateBody(&bd);
+	for (int i = 0; i < 2000; ++i)
+	{
+		cb2PolygonShape shape;
+		shape.SetAsBox(0.5f, 0.5f + 0.25f * (i % 4), ci::Vec2f(-495.0f + 0.5f * i, 0.5f + 0.25f * (i % 4)), 0.0f);
+		obstacles->CreateFixture(&shape, 0.0f);
+	}
+
+	for (int i = 0; i < 5000; ++i)
+	{
+		CreateBox(world, ci::Vec2f(-495.0f + 0.2f * i, 4.0f + 1.0f * (i % 3)), 0.25f, 0.25f, 0.0f);
+	}
+
+	for (int i = 0; i < 20; ++i)
+	{
+		cb2BodyDef def;
+		def.type = cb2_kinematicBody;
+		def.position.set(-450.0f + 45.0f * i, 8.0f);
+		def.linearVelocity.set(i % 2 ? 2.0f : -2.0f, 0.0f);
+		cb2Body* body = world->CreateBody(&def);
+		cb2PolygonShape shape;
+		shape.SetAsBox(1.0f, 1.0f);
+		body->CreateFixture(&shape, 1.0f);
+	}
+}
+
+static const Scene s_scenes[] =
+{
+	{ "pyramid", BuildPyramid, NULL },
+	{ "tumblers", BuildTumblers, NULL },
+	{ "ragdolls", BuildRagdolls, NULL },
+	{ "joint_grid", BuildJointGrid, NULL },
+	{ "bullets", BuildBullets, UpdateBullets },
+	{ "chain_terrain", BuildChainTerrain, NULL },
+	{ "open_world", BuildOpenWorld, NULL }
+};
+
+static const char* s_tagNames[cb2_memoryTagCount] =
+{
+	"general",
+	"block",
+	"stack",
+	"tree",
+	"broadphase"
+};
+
+static void RunScene(const Scene& scene, int frameCount, int threadCount, bool first)
+{
+	ResetPeaks();
+
+	cb2World* world = new cb2World(ci::Vec2f(0.0f, -10.0f));
+	world->SetThreadCount(threadCount);
+	world->SetProfileWindow(frameCount);
+	scene.build(world);
+
+	int maxStackAllocation = 0;
+	for (int i = 0; i < frameCount; ++i)
+	{
+		if (scene.update)
+		{
+			scene.update(world, i);
+		}
+		world->Step(1.0f / 60.0f, 8, 3);
+		maxStackAllocation = cb2Max(maxStackAllocation, world->GetProfile().maxStackAllocation);
+	}
+
+	printf("%s\n    {\n", first ? "" : ",");
+	printf("      \"name\": \"%s\",\n", scene.name);
+	printf("      \"bodies\": %d,\n", world->GetBodyCount());
+	printf("      \"joints\": %d,\n", world->GetJointCount());
+	printf("      \"contacts\": %d,\n", world->GetContactCount());
+	printf("      \"proxies\": %d,\n", world->GetProxyCount());
+
+	const cb2ProfileStats& stats = world->GetProfileStats();
+	printf("      \"profile\": {");
+	for (int i = 0; i < cb2_profileFieldCount; ++i)
+	{
+		cb2ProfileStat stat = stats.GetStat((cb2ProfileField)i);
+		printf("%s\n        \"%s\": { \"mean\": %g, \"min\": %g, \"p50\": %g, \"p95\": %g, \"p99\": %g, \"max\": %g }",
+			i == 0 ? "" : ",", cb2ProfileStats::GetFieldName((cb2ProfileField)i),
+			stat.mean, stat.min, stat.p50, stat.p95, stat.p99, stat.max);
+	}
+	printf("\n      },\n");
+
+	printf("      \"memory\": {\n");
+	printf("        \"peak\": %lld,\n", s_memory.totalPeak.load());
+	for (int i = 0; i < cb2_memoryTagCount; ++i)
+	{
+		printf("        \"%s\": %lld,\n", s_tagNames[i], s_memory.peak[i].load());
+	}
+	printf("        \"allocations\": %lld,\n", s_memory.allocationCount.load());
+	printf("        \"maxStackAllocation\": %d\n", maxStackAllocation);
+	printf("      }\n    }");
+
+	delete world;
+}
+
+int main(int argc, char** argv)
+{
+	int frameCount = argc > 1 ? atoi(argv[1]) : 600;
+	int threadCount = argc > 2 ? atoi(argv[2]) : 1;
+	const char* only = argc > 3 ? argv[3] : NULL;
+	frameCount = cb2Max(frameCount, 1);
+	threadCount = cb2Max(threadCount, 1);
+
+	cb2SetAllocator(CountingAlloc, CountingFree, NULL);
+
+	printf("{\n  \"frames\": %d,\n  \"threads\": %d,\n  \"scenes\": [", frameCount, threadCount);
+	bool first = true;
+	int sceneCount = sizeof(s_scenes) / sizeof(s_scenes[0]);
+	for (int i = 0; i < sceneCount; ++i)
+	{
+		if (only && strcmp(only, s_scenes[i].name) != 0)
+		{
+			continue;
+		}
+
+		RunScene(s_scenes[i], frameCount, threadCount, first);
+		first = false;
+	}
+	printf("\n  ]\n}\n");
+
+	cb2SetAllocator(NULL, NULL, NULL);
+	return 0;
+}
@@ -0,0 +1,500 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Times the narrow-phase, tree, allocator and solver kernels one at a time on seeded
+// random inputs and prints ns/op and cycles/op as JSON. Each kernel runs over a fixed
+// table of inputs so branch and cache behavior look like a real step, not one hot case:
+//
+//   c++ -O2 -std=c++11 -pthread -Isrc -I<cinder>/include benchmarks/cb2MicroBenchmark.cpp <engine .cpp files>
+//
+// or with -DCB2_HEADLESS in place of the cinder include path.
+//
+// Usage: cb2MicroBenchmark [seed] [kernel]
+//
+// Cycles come from rdtsc on x86 and are reference cycles, so they only match core
+// cycles when frequency scaling is off. Other targets report null.
+
+#include <CinderBox2D/CinderBox2D.h>
+#include <CinderBox2D/Collision/cb2Collision.h>
+#include <CinderBox2D/Common/cb2BlockAllocator.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CB2_BENCH_CYCLES
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+static long long ReadCycles()
+{
+#if defined(CB2_BENCH_CYCLES)
+	return (long long)__rdtsc();
+#else
+	return 0;
+#endif
+}
+
+// Seeded inputs
+
+static unsigned int s_seed = 12345;
+
+static float RandomFloat(float lo, float hi)
+{
+	s_seed = s_seed * 1664525u + 1013904223u;
+	return lo + (hi - lo) * float(s_seed >> 8) * (1.0f / 16777216.0f);
+}
+
+static ci::Vec2f RandomVec(float extent)
+{
+	float x = RandomFloat(-extent, extent);
+	float y = RandomFloat(-extent, extent);
+	return ci::Vec2f(x, y);
+}
+
+static cb2Transform RandomTransform(float extent)
+{
+	cb2Transform xf;
+	xf.p = RandomVec(extent);
+	xf.q.set(RandomFloat(-cb2_pi, cb2_pi));
+	return xf;
+}
+
+static void RandomPolygon(cb2PolygonShape* shape)
+{
+	ci::Vec2f points[cb2_maxPolygonVertices];
+	int count = 3 + (int)RandomFloat(0.0f, float(cb2_maxPolygonVertices - 3) + 0.999f);
+	for (int i = 0; i < count; ++i)
+	{
+		float angle = 2.0f * cb2_pi * (i + RandomFloat(0.1f, 0.9f)) / count;
+		float radius = RandomFloat(0.3f, 0.6f);
+		points[i].set(radius * cosf(angle), radius * sinf(angle));
+	}
+	shape->set(points, count);
+}
+
+// Input tables. Pairs are placed so that about half of them overlap.
+
+enum
+{
+	e_inputCount = 1024,
+	e_proxyCount = 4096
+};
+
+static cb2PolygonShape s_polygons[e_inputCount];
+static cb2CircleShape s_circles[e_inputCount];
+static cb2EdgeShape s_edges[e_inputCount];
+static cb2Transform s_xfA[e_inputCount];
+static cb2Transform s_xfB[e_inputCount];
+static cb2Sweep s_sweepA[e_inputCount];
+static cb2Sweep s_sweepB[e_inputCount];
+static cb2AABB s_queryBoxes[e_inputCount];
+static cb2RayCastInput s_rays[e_inputCount];
+static cb2AABB s_proxyBoxes[e_proxyCount];
+static ci::Vec2f s_moves[e_proxyCount];
+static int s_sizes[e_inputCount];
+
+static cb2DynamicTree* s_tree;
+static int s_proxies[e_proxyCount];
+static void* s_blocks[e_inputCount];
+static cb2BlockAllocator* s_allocator;
+
+// Kernel results are folded into this so the calls cannot be removed.
+static volatile float s_sink;
+
+static void BuildInputs()
+{
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		RandomPolygon(s_polygons + i);
+		s_circles[i].m_radius = RandomFloat(0.2f, 0.6f);
+		s_edges[i].Set(RandomVec(1.0f), RandomVec(1.0f));
+
+		s_xfA[i] = RandomTransform(0.0f);
+		s_xfB[i] = RandomTransform(1.0f);
+
+		cb2Sweep sweep;
+		sweep.localCenter.set(0.0f, 0.0f);
+		sweep.alpha0 = 0.0f;
+		sweep.c0 = RandomVec(0.5f);
+		sweep.c = sweep.c0;
+		sweep.a0 = RandomFloat(-cb2_pi, cb2_pi);
+		sweep.a = sweep.a0 + RandomFloat(-0.5f, 0.5f);
+		s_sweepA[i] = sweep;
+		sweep.c0 = ci::Vec2f(-5.0f, 0.0f) + RandomVec(1.0f);
+		sweep.c = ci::Vec2f(5.0f, 0.0f) + RandomVec(1.0f);
+		sweep.a0 = RandomFloat(-cb2_pi, cb2_pi);
+		sweep.a = sweep.a0 + RandomFloat(-2.0f, 2.0f);
+		s_sweepB[i] = sweep;
+
+		ci::Vec2f center = RandomVec(100.0f);
+		ci::Vec2f extent(RandomFloat(1.0f, 5.0f), RandomFloat(1.0f, 5.0f));
+		s_queryBoxes[i].lowerBound = center - extent;
+		s_queryBoxes[i].upperBound = center + extent;
+
+		s_rays[i].p1 = RandomVec(100.0f);
+		s_rays[i].p2 = s_rays[i].p1 + RandomVec(20.0f);
+		s_rays[i].maxFraction = 1.0f;
+
+		s_sizes[i] = (int)RandomFloat(8.0f, float(cb2_maxBlockSize));
+	}
+
+	for (int i = 0; i < e_proxyCount; ++i)
+	{
+		ci::Vec2f center = RandomVec(100.0f);
+		ci::Vec2f extent(RandomFloat(0.2f, 1.0f), RandomFloat(0.2f, 1.0f));
+		s_proxyBoxes[i].lowerBound = center - extent;
+		s_proxyBoxes[i].upperBound = center + extent;
+		s_moves[i] = RandomVec(0.3f);
+	}
+}
+
+// Kernels. Each call runs e_inputCount operations.
+
+static void RunCollidePolygons()
+{
+	float sum = 0.0f;
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		cb2Manifold manifold;
+		int j = (i + 1) & (e_inputCount - 1);
+		cb2CollidePolygons(&manifold, s_polygons + i, s_xfA[i], s_polygons + j, s_xfB[i]);
+		sum += float(manifold.pointCount);
+	}
+	s_sink = s_sink + sum;
+}
+
+static void RunCollideCircles()
+{
+	float sum = 0.0f;
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		cb2Manifold manifold;
+		int j = (i + 1) & (e_inputCount - 1);
+		cb2CollideCircles(&manifold, s_circles + i, s_xfA[i], s_circles + j, s_xfB[i]);
+		sum += float(manifold.pointCount);
+	}
+	s_sink = s_sink + sum;
+}
+
+static void RunCollideEdgeAndPolygon()
+{
+	float sum = 0.0f;
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		cb2Manifold manifold;
+		cb2CollideEdgeAndPolygon(&manifold, s_edges + i, s_xfA[i], s_polygons + i, s_xfB[i]);
+		sum += float(manifold.pointCount);
+	}
+	s_sink = s_sink + sum;
+}
+
+static void RunDistance()
+{
+	float sum = 0.0f;
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		int j = (i + 1) & (e_inputCount - 1);
+		cb2DistanceInput input;
+		input.proxyA.set(s_polygons + i, 0);
+		input.proxyB.set(s_polygons + j, 0);
+		input.transformA = s_xfA[i];
+		input.transformB = s_xfB[i];
+		input.useRadii = true;
+		cb2SimplexCache cache;
+		cache.count = 0;
+		cb2DistanceOutput output;
+		cb2Distance(&output, &cache, &input);
+		sum += output.distance;
+	}
+	s_sink = s_sink + sum;
+}
+
+static void RunTimeOfImpact()
+{
+	float sum = 0.0f;
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		int j = (i + 1) & (e_inputCount - 1);
+		cb2TOIInput input;
+		input.proxyA.set(s_polygons + i, 0);
+		input.proxyB.set(s_polygons + j, 0);
+		input.sweepA = s_sweepA[i];
+		input.sweepB = s_sweepB[i];
+		input.tMax = 1.0f;
+		cb2TOIOutput output;
+		cb2TimeOfImpact(&output, &input);
+		sum += output.t;
+	}
+	s_sink = s_sink + sum;
+}
+
+struct QueryCounter
+{
+	bool QueryCallback(int proxyId)
+	{
+		CB2_NOT_USED(proxyId);
+		++count;
+		return true;
+	}
+
+	float RayCastCallback(const cb2RayCastInput& input, int proxyId)
+	{
+		CB2_NOT_USED(proxyId);
+		++count;
+		return input.maxFraction;
+	}
+
+	int count;
+};
+
+static void RunTreeQuery()
+{
+	QueryCounter counter;
+	counter.count = 0;
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		s_tree->Query(&counter, s_queryBoxes[i]);
+	}
+	s_sink = s_sink + float(counter.count);
+}
+
+static void RunTreeRayCast()
+{
+	QueryCounter counter;
+	counter.count = 0;
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		s_tree->RayCast(&counter, s_rays[i]);
+	}
+	s_sink = s_sink + float(counter.count);
+}
+
+// Proxies drift back and forth, so most moves stay inside the fat box and some
+// reinsert, like bodies moving in a step.
+static int s_moveFrame;
+
+static void RunTreeMoveProxy()
+{
+	int count = 0;
+	int offset = (s_moveFrame++ * e_inputCount) & (e_proxyCount - 1);
+	float sign = (s_moveFrame / (e_proxyCount / e_inputCount)) & 1 ? -1.0f : 1.0f;
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		int index = offset + i;
+		ci::Vec2f d = sign * s_moves[index];
+		s_proxyBoxes[index].lowerBound += d;
+		s_proxyBoxes[index].upperBound += d;
+		count += s_tree->MoveProxy(s_proxies[index], s_proxyBoxes[index], d) ? 1 : 0;
+	}
+	s_sink = s_sink + float(count);
+}
+
+// Blocks of mixed sizes are allocated and then freed in a shuffled order.
+static void RunBlockAllocator()
+{
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		s_blocks[i] = s_allocator->Allocate(s_sizes[i]);
+	}
+	for (int i = 0; i < e_inputCount; ++i)
+	{
+		int index = (i * 389) & (e_inputCount - 1);
+		s_allocator->Free(s_blocks[index], s_sizes[index]);
+	}
+}
+
+// Timing
+
+struct Kernel
+{
+	const char* name;
+	void (*run)();
+	int opsPerRun;
+};
+
+static const Kernel s_kernels[] =
+{
+	{ "cb2CollidePolygons", RunCollidePolygons, e_inputCount },
+	{ "cb2CollideCircles", RunCollideCircles, e_inputCount },
+	{ "cb2CollideEdgeAndPolygon", RunCollideEdgeAndPolygon, e_inputCount },
+	{ "cb2Distance", RunDistance, e_inputCount },
+	{ "cb2TimeOfImpact", RunTimeOfImpact, e_inputCount },
+	{ "cb2DynamicTree::Query", RunTreeQuery, e_inputCount },
+	{ "cb2DynamicTree::RayCast", RunTreeRayCast, e_inputCount },
+	{ "cb2DynamicTree::MoveProxy", RunTreeMoveProxy, e_inputCount },
+	{ "cb2BlockAllocator::Allocate+Free", RunBlockAllocator, 2 * e_inputCount }
+};
+
+static void PrintResult(const char* name, double ns, double cycles, bool first)
+{
+	printf("%s\n    { \"name\": \"%s\", \"ns\": %.2f, ", first ? "" : ",", name, ns);
+#if defined(CB2_BENCH_CYCLES)
+	printf("\"cycles\": %.1f }", cycles);
+#else
+	CB2_NOT_USED(cycles);
+	printf("\"cycles\": null }");
+#endif
+}
+
+// The kernel runs in trials of about a millisecond after a warm-up. The fastest trial
+// is reported since noise only ever adds time.
+static void RunKernel(const Kernel& kernel, bool first)
+{
+	const int trialCount = 50;
+
+	long long warmupStart = cb2Timer::GetTicks();
+	int runsPerTrial = 0;
+	while (double(cb2Timer::GetTicks() - warmupStart) * cb2Timer::GetTickMilliseconds() < 1.0)
+	{
+		kernel.run();
+		++runsPerTrial;
+	}
+	runsPerTrial = cb2Max(runsPerTrial, 1);
+
+	double bestNs = 1e30;
+	double bestCycles = 1e30;
+	for (int trial = 0; trial < trialCount; ++trial)
+	{
+		long long cycles0 = ReadCycles();
+		long long ticks0 = cb2Timer::GetTicks();
+		for (int i = 0; i < runsPerTrial; ++i)
+		{
+			kernel.run();
+		}
+		long long ticks1 = cb2Timer::GetTicks();
+		long long cycles1 = ReadCycles();
+
+		double ops = double(runsPerTrial) * double(kernel.opsPerRun);
+		double ns = double(ticks1 - ticks0) * cb2Timer::GetTickMilliseconds() * 1e6 / ops;
+		if (ns < bestNs)
+		{
+			bestNs = ns;
+			bestCycles = double(cycles1 - cycles0) / ops;
+		}
+	}
+
+	PrintResult(kernel.name, bestNs, bestCycles, first);
+}
+
+// The contact solver needs island state that is internal to the world, so it is timed
+// through a settled pyramid with sleeping off. The velocity solve time is divided by
+// the contact iterations it ran.
+static void RunContactSolver(bool first)
+{
+	cb2World* world = new cb2World(ci::Vec2f(0.0f, -10.0f));
+	world->SetAllowSleeping(false);
+
+	cb2BodyDef bd;
+	cb2Body* ground = world->CreateBody(&bd);
+	cb2EdgeShape edge;
+	edge.Set(ci::Vec2f(-40.0f, 0.0f), ci::Vec2f(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	const int rowCount = 30;
+	cb2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+	for (int i = 0; i < rowCount; ++i)
+	{
+		for (int j = 0; j < rowCount - i; ++j)
+		{
+			cb2BodyDef def;
+			def.type = cb2_dynamicBody;
+			def.position.set(-0.5f * (rowCount - i - 1) + 1.0f * j, 0.5f + 1.0f * i);
+			world->CreateBody(&def)->CreateFixture(&box, 1.0f);
+		}
+	}
+
+	for (int i = 0; i < 120; ++i)
+	{
+		world->Step(1.0f / 60.0f, 8, 3);
+	}
+
+	double bestNs = 1e30;
+	double bestCycles = 1e30;
+	for (int i = 0; i < 60; ++i)
+	{
+		long long cycles0 = ReadCycles();
+		long long ticks0 = cb2Timer::GetTicks();
+		world->Step(1.0f / 60.0f, 8, 3);
+		long long ticks1 = cb2Timer::GetTicks();
+		long long cycles1 = ReadCycles();
+
+		const cb2Profile& profile = world->GetProfile();
+		if (profile.islandCount == 0 || profile.islandContactCount == 0)
+		{
+			continue;
+		}
+
+		// velocityIterations is summed over the islands.
+		double ops = double(profile.velocityIterations) * profile.islandContactCount / profile.islandCount;
+		double ns = double(profile.solveVelocity) * 1e6 / ops;
+		if (ns < bestNs)
+		{
+			bestNs = ns;
+			double stepNs = double(ticks1 - ticks0) * cb2Timer::GetTickMilliseconds() * 1e6;
+			bestCycles = stepNs > 0.0 ? double(cycles1 - cycles0) * ns / stepNs : 0.0;
+		}
+	}
+
+	delete world;
+	PrintResult("cb2ContactSolver::SolveVelocityConstraints", bestNs, bestCycles, first);
+}
+
+int main(int argc, char** argv)
+{
+	s_seed = argc > 1 ? (unsigned int)strtoul(argv[1], NULL, 10) : 12345;
+	const char* only = argc > 2 ? argv[2] : NULL;
+
+	printf("{\n  \"seed\": %u,\n  \"kernels\": [", s_seed);
+	BuildInputs();
+
+	s_tree = new cb2DynamicTree;
+	for (int i = 0; i < e_proxyCount; ++i)
+	{
+		s_proxies[i] = s_tree->CreateProxy(s_proxyBoxes[i], NULL);
+	}
+	s_allocator = new cb2BlockAllocator;
+
+	bool first = true;
+	int kernelCount = sizeof(s_kernels) / sizeof(s_kernels[0]);
+	for (int i = 0; i < kernelCount; ++i)
+	{
+		if (only && strstr(s_kernels[i].name, only) == NULL)
+		{
+			continue;
+		}
+
+		RunKernel(s_kernels[i], first);
+		first = false;
+	}
+
+	if (only == NULL || strstr("cb2ContactSolver::SolveVelocityConstraints", only) != NULL)
+	{
+		RunContactSolver(first);
+	}
+	printf("\n  ]\n}\n");
+
+	delete s_allocator;
+	delete s_tree;
+	return 0;
+}
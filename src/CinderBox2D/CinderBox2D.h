@@ -39,6 +39,9 @@ For discussion please visit http://box2d.org/forum
 #include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2HeightfieldShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CompoundShape.h>
 
 #include <CinderBox2D/Collision/cb2BroadPhase.h>
 #include <CinderBox2D/Collision/cb2Distance.h>
@@ -47,6 +50,9 @@ For discussion please visit http://box2d.org/forum
 
 #include <CinderBox2D/Dynamics/cb2Body.h>
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2MaterialTable.h>
+#include <CinderBox2D/Dynamics/cb2Replication.h>
+#include <CinderBox2D/Dynamics/cb2TargetDrives.h>
 #include <CinderBox2D/Dynamics/cb2WorldCallbacks.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 #include <CinderBox2D/Dynamics/cb2World.h>
@@ -65,4 +71,6 @@ For discussion please visit http://box2d.org/forum
 #include <CinderBox2D/Dynamics/Joints/cb2WeldJoint.h>
 #include <CinderBox2D/Dynamics/Joints/cb2WheelJoint.h>
 
+#include <CinderBox2D/Particle/cb2ParticleSystem.h>
+
 #endif
@@ -0,0 +1,234 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <new>
+
+void cb2CapsuleShape::Set(const ci::Vec2f& v1, const ci::Vec2f& v2, float radius)
+{
+	cb2Assert(cb2DistanceSquared(v1, v2) > cb2_linearSlop * cb2_linearSlop);
+	m_vertex1 = v1;
+	m_vertex2 = v2;
+	m_radius = radius;
+}
+
+cb2Shape* cb2CapsuleShape::Clone(cb2BlockAllocator* allocator) const
+{
+	void* mem = allocator->Allocate(sizeof(cb2CapsuleShape));
+	cb2CapsuleShape* clone = new (mem) cb2CapsuleShape;
+	*clone = *this;
+	return clone;
+}
+
+int cb2CapsuleShape::GetChildCount() const
+{
+	return 1;
+}
+
+bool cb2CapsuleShape::TestPoint(const cb2Transform& xf, const ci::Vec2f& p) const
+{
+	ci::Vec2f localPoint = cb2MulT(xf, p);
+
+	// Closest point on the segment.
+	ci::Vec2f e = m_vertex2 - m_vertex1;
+	float t = cb2Clamp(cb2Dot(localPoint - m_vertex1, e) / cb2Dot(e, e), 0.0f, 1.0f);
+	ci::Vec2f d = localPoint - (m_vertex1 + t * e);
+	return cb2Dot(d, d) <= m_radius * m_radius;
+}
+
+// Cast a ray in the local frame against one cap. This is cb2CircleShape::RayCast.
+static bool cb2RayCastCap(float* fraction, ci::Vec2f* normal, const ci::Vec2f& p1, const ci::Vec2f& p2,
+						 float maxFraction, const ci::Vec2f& center, float radius)
+{
+	ci::Vec2f s = p1 - center;
+	float b = cb2Dot(s, s) - radius * radius;
+
+	// Solve quadratic equation.
+	ci::Vec2f r = p2 - p1;
+	float c =  cb2Dot(s, r);
+	float rr = cb2Dot(r, r);
+	float sigma = c * c - rr * b;
+
+	// Check for negative discriminant and short segment.
+	if (sigma < 0.0f || rr < cb2_epsilon)
+	{
+		return false;
+	}
+
+	// Find the point of intersection of the line with the circle.
+	float a = -(c + cb2Sqrt(sigma));
+
+	// Is the intersection point on the segment?
+	if (0.0f <= a && a <= maxFraction * rr)
+	{
+		a /= rr;
+		*fraction = a;
+		*normal = s + a * r;
+		normal->normalize();
+		return true;
+	}
+
+	return false;
+}
+
+// The ray meets the sides of the infinite capsule where
+// v1 +/- radius * n + s1 * a = p1 + s2 * u
+// The caps are tested when the hit is past either end of the segment.
+bool cb2CapsuleShape::RayCast(cb2RayCastOutput* output, const cb2RayCastInput& input,
+							const cb2Transform& xf, int childIndex) const
+{
+	CB2_NOT_USED(childIndex);
+
+	// Put the ray into the capsule's frame of reference.
+	ci::Vec2f p1 = cb2MulT(xf.q, input.p1 - xf.p);
+	ci::Vec2f p2 = cb2MulT(xf.q, input.p2 - xf.p);
+
+	ci::Vec2f v1 = m_vertex1;
+	ci::Vec2f v2 = m_vertex2;
+	ci::Vec2f a = v2 - v1;
+	float capsuleLength = a.length();
+	a *= 1.0f / capsuleLength;
+
+	float fraction;
+	ci::Vec2f normal;
+	bool hit = false;
+
+	// Does the ray start within the infinite capsule?
+	ci::Vec2f q = p1 - v1;
+	float qa = cb2Dot(q, a);
+	ci::Vec2f qp = q - qa * a;
+	if (cb2Dot(qp, qp) < m_radius * m_radius)
+	{
+		if (qa < 0.0f)
+		{
+			hit = cb2RayCastCap(&fraction, &normal, p1, p2, input.maxFraction, v1, m_radius);
+		}
+		else if (qa > capsuleLength)
+		{
+			hit = cb2RayCastCap(&fraction, &normal, p1, p2, input.maxFraction, v2, m_radius);
+		}
+
+		// Otherwise the ray starts inside the capsule.
+	}
+	else
+	{
+		ci::Vec2f d = p2 - p1;
+		float rayLength = d.length();
+		if (rayLength < cb2_epsilon)
+		{
+			return false;
+		}
+		ci::Vec2f u = (1.0f / rayLength) * d;
+		ci::Vec2f n(a.y, -a.x);
+
+		// A ray parallel to the axis and outside the infinite capsule misses.
+		float den = -a.x * u.y + u.x * a.y;
+		if (-cb2_epsilon < den && den < cb2_epsilon)
+		{
+			return false;
+		}
+
+		// Cramer's rule on both sides, keep the nearer one.
+		float invDen = 1.0f / den;
+		ci::Vec2f b1 = q - m_radius * n;
+		ci::Vec2f b2 = q + m_radius * n;
+		float s21 = (a.x * b1.y - b1.x * a.y) * invDen;
+		float s22 = (a.x * b2.y - b2.x * a.y) * invDen;
+
+		float s2;
+		ci::Vec2f b;
+		if (s21 < s22)
+		{
+			s2 = s21;
+			b = b1;
+		}
+		else
+		{
+			s2 = s22;
+			b = b2;
+			n = -n;
+		}
+
+		if (s2 < 0.0f || input.maxFraction * rayLength < s2)
+		{
+			return false;
+		}
+
+		float s1 = (-b.x * u.y + u.x * b.y) * invDen;
+		if (s1 < 0.0f)
+		{
+			hit = cb2RayCastCap(&fraction, &normal, p1, p2, input.maxFraction, v1, m_radius);
+		}
+		else if (capsuleLength < s1)
+		{
+			hit = cb2RayCastCap(&fraction, &normal, p1, p2, input.maxFraction, v2, m_radius);
+		}
+		else
+		{
+			fraction = s2 / rayLength;
+			normal = n;
+			hit = true;
+		}
+	}
+
+	if (hit)
+	{
+		output->fraction = fraction;
+		output->normal = cb2Mul(xf.q, normal);
+	}
+	return hit;
+}
+
+void cb2CapsuleShape::ComputeAABB(cb2AABB* aabb, const cb2Transform& xf, int childIndex) const
+{
+	CB2_NOT_USED(childIndex);
+
+	ci::Vec2f v1 = cb2Mul(xf, m_vertex1);
+	ci::Vec2f v2 = cb2Mul(xf, m_vertex2);
+
+	ci::Vec2f lower = cb2Min(v1, v2);
+	ci::Vec2f upper = cb2Max(v1, v2);
+
+	ci::Vec2f r(m_radius, m_radius);
+	aabb->lowerBound = lower - r;
+	aabb->upperBound = upper + r;
+}
+
+// A box of the segment length and two half circles. Each half circle has its
+// centroid lc past the end of the segment.
+void cb2CapsuleShape::ComputeMass(cb2MassData* massData, float density) const
+{
+	float radius = m_radius;
+	float rr = radius * radius;
+	float length = (m_vertex2 - m_vertex1).length();
+	float ll = length * length;
+
+	float circleMass = density * cb2_pi * rr;
+	float boxMass = density * 2.0f * radius * length;
+	massData->mass = circleMass + boxMass;
+	massData->center = 0.5f * (m_vertex1 + m_vertex2);
+
+	// Inertia about the centroid, parallel axis for the half circles.
+	float lc = 4.0f * radius / (3.0f * cb2_pi);
+	float h = 0.5f * length;
+	float circleInertia = circleMass * (0.5f * rr + h * h + 2.0f * h * lc);
+	float boxInertia = boxMass * (4.0f * rr + ll) / 12.0f;
+
+	// inertia about the local origin
+	massData->I = circleInertia + boxInertia + massData->mass * cb2Dot(massData->center, massData->center);
+}
@@ -21,13 +21,70 @@
 #include <new>
 #include <memory.h>
 
+// Chains with at least this many edges get a local tree and a single broad-phase proxy.
+const int cb2_chainTreeCount = 64;
+
 cb2ChainShape::~cb2ChainShape()
 {
-	cb2Free(m_vertices);
+	if (m_childTree)
+	{
+		m_childTree->~cb2StaticTree();
+		cb2Free(m_childTree);
+		m_childTree = NULL;
+	}
+
+	cb2Free(m_normals);
+	m_normals = NULL;
+
+	if (m_ownsVertices)
+	{
+		cb2Free(m_vertices);
+	}
 	m_vertices = NULL;
 	m_count = 0;
 }
 
+void cb2ChainShape::CreateChildTree()
+{
+	m_localAABB.lowerBound = m_vertices[0];
+	m_localAABB.upperBound = m_vertices[0];
+	for (int i = 1; i < m_count; ++i)
+	{
+		m_localAABB.lowerBound = cb2Min(m_localAABB.lowerBound, m_vertices[i]);
+		m_localAABB.upperBound = cb2Max(m_localAABB.upperBound, m_vertices[i]);
+	}
+
+	if (m_count - 1 < cb2_chainTreeCount)
+	{
+		return;
+	}
+
+	void* mem = cb2Alloc(sizeof(cb2StaticTree));
+	m_childTree = new (mem) cb2StaticTree;
+
+	// The proxies are allocated in order, so the proxy id is the child index.
+	for (int i = 0; i < m_count - 1; ++i)
+	{
+		cb2AABB aabb;
+		aabb.lowerBound = cb2Min(m_vertices[i], m_vertices[i + 1]);
+		aabb.upperBound = cb2Max(m_vertices[i], m_vertices[i + 1]);
+		int proxyId = m_childTree->CreateProxy(aabb, NULL);
+		cb2Assert(proxyId == i);
+		CB2_NOT_USED(proxyId);
+	}
+
+	m_childTree->Rebuild();
+}
+
+void cb2ChainShape::CreateEdgeNormals()
+{
+	m_normals = (ci::Vec2f*)cb2Alloc((m_count - 1) * sizeof(ci::Vec2f));
+	for (int i = 0; i < m_count - 1; ++i)
+	{
+		m_normals[i] = cb2ComputeEdgeNormal(m_vertices[i], m_vertices[i + 1]);
+	}
+}
+
 void cb2ChainShape::CreateLoop(const ci::Vec2f* vertices, int count)
 {
 	cb2Assert(m_vertices == NULL && m_count == 0);
@@ -48,6 +105,9 @@ void cb2ChainShape::CreateLoop(const ci::Vec2f* vertices, int count)
 	m_nextVertex = m_vertices[1];
 	m_hasPrevVertex = true;
 	m_hasNextVertex = true;
+
+	CreateChildTree();
+	CreateEdgeNormals();
 }
 
 void cb2ChainShape::CreateChain(const ci::Vec2f* vertices, int count)
@@ -71,6 +131,34 @@ void cb2ChainShape::CreateChain(const ci::Vec2f* vertices, int count)
 
 	cb2::setZero(m_prevVertex);
 	cb2::setZero(m_nextVertex);
+
+	CreateChildTree();
+	CreateEdgeNormals();
+}
+
+void cb2ChainShape::CreateView(const ci::Vec2f* vertices, int count, const cb2AABB& localAABB, const cb2StaticTreeView* childTree)
+{
+	cb2Assert(m_vertices == NULL && m_count == 0);
+	cb2Assert(count >= 2);
+	cb2Assert(childTree == NULL || childTree->proxyCount == count - 1);
+
+	m_count = count;
+	m_vertices = (ci::Vec2f*)vertices;
+	m_ownsVertices = false;
+
+	m_hasPrevVertex = false;
+	m_hasNextVertex = false;
+
+	cb2::setZero(m_prevVertex);
+	cb2::setZero(m_nextVertex);
+
+	m_localAABB = localAABB;
+	if (childTree)
+	{
+		void* mem = cb2Alloc(sizeof(cb2StaticTree));
+		m_childTree = new (mem) cb2StaticTree;
+		m_childTree->Attach(*childTree);
+	}
 }
 
 void cb2ChainShape::SetPrevVertex(const ci::Vec2f& prevVertex)
@@ -89,11 +177,35 @@ cb2Shape* cb2ChainShape::Clone(cb2BlockAllocator* allocator) const
 {
 	void* mem = allocator->Allocate(sizeof(cb2ChainShape));
 	cb2ChainShape* clone = new (mem) cb2ChainShape;
-	clone->CreateChain(m_vertices, m_count);
+	clone->m_count = m_count;
+	if (m_ownsVertices)
+	{
+		clone->m_vertices = (ci::Vec2f*)cb2Alloc(m_count * sizeof(ci::Vec2f));
+		memcpy(clone->m_vertices, m_vertices, m_count * sizeof(ci::Vec2f));
+	}
+	else
+	{
+		clone->m_vertices = m_vertices;
+		clone->m_ownsVertices = false;
+	}
+	if (m_normals)
+	{
+		clone->m_normals = (ci::Vec2f*)cb2Alloc((m_count - 1) * sizeof(ci::Vec2f));
+		memcpy(clone->m_normals, m_normals, (m_count - 1) * sizeof(ci::Vec2f));
+	}
 	clone->m_prevVertex = m_prevVertex;
 	clone->m_nextVertex = m_nextVertex;
 	clone->m_hasPrevVertex = m_hasPrevVertex;
 	clone->m_hasNextVertex = m_hasNextVertex;
+
+	// Copy the child tree instead of building it again. An attached tree is shared.
+	clone->m_localAABB = m_localAABB;
+	if (m_childTree)
+	{
+		void* treeMem = cb2Alloc(sizeof(cb2StaticTree));
+		clone->m_childTree = new (treeMem) cb2StaticTree;
+		clone->m_childTree->Copy(*m_childTree);
+	}
 	return clone;
 }
 
@@ -142,9 +254,64 @@ bool cb2ChainShape::TestPoint(const cb2Transform& xf, const ci::Vec2f& p) const
 	return false;
 }
 
+struct cb2ChainRayCastWrapper
+{
+	float RayCastCallback(const cb2RayCastInput& input, int childIndex)
+	{
+		cb2RayCastOutput output;
+		if (chain->RayCast(&output, input, identity, childIndex) == false)
+		{
+			return input.maxFraction;
+		}
+
+		// Clip the ray to the hit so only closer children are tested.
+		*closest = output;
+		hit = true;
+		return output.fraction;
+	}
+
+	const cb2ChainShape* chain;
+	cb2Transform identity;
+	cb2RayCastOutput* closest;
+	bool hit;
+};
+
 bool cb2ChainShape::RayCast(cb2RayCastOutput* output, const cb2RayCastInput& input,
 							const cb2Transform& xf, int childIndex) const
 {
+	if (childIndex == e_allChildren)
+	{
+		cb2RayCastInput local;
+		local.p1 = cb2MulT(xf, input.p1);
+		local.p2 = cb2MulT(xf, input.p2);
+		local.maxFraction = input.maxFraction;
+
+		cb2ChainRayCastWrapper wrapper;
+		wrapper.chain = this;
+		wrapper.identity.SetIdentity();
+		wrapper.closest = output;
+		wrapper.hit = false;
+
+		if (m_childTree)
+		{
+			m_childTree->RayCast(&wrapper, local);
+		}
+		else
+		{
+			for (int i = 0; i < m_count - 1; ++i)
+			{
+				float value = wrapper.RayCastCallback(local, i);
+				local.maxFraction = value;
+			}
+		}
+
+		if (wrapper.hit)
+		{
+			output->normal = cb2Mul(xf.q, output->normal);
+		}
+		return wrapper.hit;
+	}
+
 	cb2Assert(childIndex < m_count);
 
 	cb2EdgeShape edgeShape;
@@ -164,6 +331,18 @@ bool cb2ChainShape::RayCast(cb2RayCastOutput* output, const cb2RayCastInput& inp
 
 void cb2ChainShape::ComputeAABB(cb2AABB* aabb, const cb2Transform& xf, int childIndex) const
 {
+	if (childIndex == e_allChildren)
+	{
+		// Box of the rotated local box.
+		ci::Vec2f c = cb2Mul(xf, m_localAABB.GetCenter());
+		ci::Vec2f h = m_localAABB.GetExtents();
+		ci::Vec2f r(cb2Abs(xf.q.c) * h.x + cb2Abs(xf.q.s) * h.y,
+					cb2Abs(xf.q.s) * h.x + cb2Abs(xf.q.c) * h.y);
+		aabb->lowerBound = c - r;
+		aabb->upperBound = c + r;
+		return;
+	}
+
 	cb2Assert(childIndex < m_count);
 
 	int i1 = childIndex;
@@ -180,6 +359,23 @@ void cb2ChainShape::ComputeAABB(cb2AABB* aabb, const cb2Transform& xf, int child
 	aabb->upperBound = cb2Max(v1, v2);
 }
 
+bool cb2ChainShape::TestChildOverlap(int childIndex, const cb2AABB& aabb, const cb2Transform& xf) const
+{
+	cb2Assert(0 <= childIndex && childIndex < m_count - 1);
+	cb2AABB local = ComputeLocalAABB(aabb, xf);
+
+	if (m_childTree)
+	{
+		return cb2TestOverlap(m_childTree->GetFatAABB(childIndex), local);
+	}
+
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	cb2AABB box;
+	box.lowerBound = cb2Min(m_vertices[childIndex], m_vertices[childIndex + 1]) - r;
+	box.upperBound = cb2Max(m_vertices[childIndex], m_vertices[childIndex + 1]) + r;
+	return cb2TestOverlap(box, local);
+}
+
 void cb2ChainShape::ComputeMass(cb2MassData* massData, float density) const
 {
 	CB2_NOT_USED(density);
@@ -20,6 +20,7 @@
 #define CB2_CHAIN_SHAPE_H
 
 #include <CinderBox2D/Collision/Shapes/cb2Shape.h>
+#include <CinderBox2D/Collision/cb2StaticTree.h>
 
 class cb2EdgeShape;
 
@@ -28,10 +29,18 @@ class cb2EdgeShape;
 /// Therefore, you may use any winding order.
 /// Since there may be many vertices, they are allocated using cb2Alloc.
 /// Connectivity information is used to create smooth collisions.
+/// Long chains keep their child edge boxes in a local tree. The fixture then uses a
+/// single broad-phase proxy and the contact manager resolves the children.
 /// WARNING: The chain will not collide properly if there are self-intersections.
 class cb2ChainShape : public cb2Shape
 {
 public:
+	enum
+	{
+		/// The child index of a proxy or query that covers the whole chain.
+		e_allChildren = -1
+	};
+
 	cb2ChainShape();
 
 	/// The destructor frees the vertices using cb2Free.
@@ -47,6 +56,16 @@ public:
 	/// @param count the vertex count
 	void CreateChain(const ci::Vec2f* vertices, int count);
 
+	/// Create a chain on vertices and a child tree held elsewhere, such as a mapped level
+	/// file. Nothing is copied, so the memory must outlive the shape and its clones and
+	/// the vertices must not be changed. Loops pass their closing vertex and set the
+	/// neighbor vertices like CreateLoop does.
+	/// @param vertices an array of vertices, these are not copied
+	/// @param count the vertex count
+	/// @param localAABB the box of the vertices
+	/// @param childTree the tree of the child edge boxes, or NULL to test every child
+	void CreateView(const ci::Vec2f* vertices, int count, const cb2AABB& localAABB, const cb2StaticTreeView* childTree);
+
 	/// Establish connectivity to a vertex that precedes the first vertex.
 	/// Don't call this for loops.
 	void SetPrevVertex(const ci::Vec2f& prevVertex);
@@ -55,7 +74,7 @@ public:
 	/// Don't call this for loops.
 	void SetNextVertex(const ci::Vec2f& nextVertex);
 
-	/// Implement cb2Shape. Vertices are cloned using cb2Alloc.
+	/// Implement cb2Shape. Vertices are cloned using cb2Alloc, except for views which share them.
 	cb2Shape* Clone(cb2BlockAllocator* allocator) const;
 
 	/// @see cb2Shape::GetChildCount
@@ -68,17 +87,33 @@ public:
 	/// @see cb2Shape::TestPoint
 	bool TestPoint(const cb2Transform& transform, const ci::Vec2f& p) const;
 
-	/// Implement cb2Shape.
+	/// Implement cb2Shape. Use e_allChildren to get the closest hit of all children.
 	bool RayCast(cb2RayCastOutput* output, const cb2RayCastInput& input,
 					const cb2Transform& transform, int childIndex) const;
 
 	/// @see cb2Shape::ComputeAABB
+	/// Use e_allChildren to get the box of the whole chain.
 	void ComputeAABB(cb2AABB* aabb, const cb2Transform& transform, int childIndex) const;
 
 	/// Chains have zero mass.
 	/// @see cb2Shape::ComputeMass
 	void ComputeMass(cb2MassData* massData, float density) const;
 
+	/// Get the unit normal of each child edge, on the right of the edge from vertex i to
+	/// vertex i + 1, computed when the chain is created. Views have none and return NULL.
+	const ci::Vec2f* GetEdgeNormals() const;
+
+	/// Get the local tree of the child edge boxes, or NULL for short chains.
+	const cb2StaticTree* GetChildTree() const;
+
+	/// Query the children whose fat local box overlaps a world box. The callback class
+	/// must have `bool QueryCallback(int childIndex)`.
+	template <typename T>
+	void QueryChildren(T* callback, const cb2AABB& aabb, const cb2Transform& transform) const;
+
+	/// Test a child's fat local box against a world box, like QueryChildren.
+	bool TestChildOverlap(int childIndex, const cb2AABB& aabb, const cb2Transform& transform) const;
+
 	/// The vertices. Owned by this class.
 	ci::Vec2f* m_vertices;
 
@@ -87,6 +122,18 @@ public:
 
 	ci::Vec2f m_prevVertex, m_nextVertex;
 	bool m_hasPrevVertex, m_hasNextVertex;
+
+private:
+
+	void CreateChildTree();
+	void CreateEdgeNormals();
+
+	static cb2AABB ComputeLocalAABB(const cb2AABB& aabb, const cb2Transform& transform);
+
+	cb2StaticTree* m_childTree;
+	ci::Vec2f* m_normals;
+	cb2AABB m_localAABB;
+	bool m_ownsVertices;
 };
 
 inline cb2ChainShape::cb2ChainShape()
@@ -97,6 +144,57 @@ inline cb2ChainShape::cb2ChainShape()
 	m_count = 0;
 	m_hasPrevVertex = false;
 	m_hasNextVertex = false;
+	m_childTree = NULL;
+	m_normals = NULL;
+	m_ownsVertices = true;
+}
+
+inline const ci::Vec2f* cb2ChainShape::GetEdgeNormals() const
+{
+	return m_normals;
+}
+
+inline const cb2StaticTree* cb2ChainShape::GetChildTree() const
+{
+	return m_childTree;
+}
+
+inline cb2AABB cb2ChainShape::ComputeLocalAABB(const cb2AABB& aabb, const cb2Transform& transform)
+{
+	// Box of the rotated box.
+	ci::Vec2f c = cb2MulT(transform, aabb.GetCenter());
+	ci::Vec2f h = aabb.GetExtents();
+	ci::Vec2f r(cb2Abs(transform.q.c) * h.x + cb2Abs(transform.q.s) * h.y,
+				cb2Abs(transform.q.s) * h.x + cb2Abs(transform.q.c) * h.y);
+
+	cb2AABB local;
+	local.lowerBound = c - r;
+	local.upperBound = c + r;
+	return local;
+}
+
+template <typename T>
+inline void cb2ChainShape::QueryChildren(T* callback, const cb2AABB& aabb, const cb2Transform& transform) const
+{
+	cb2AABB local = ComputeLocalAABB(aabb, transform);
+
+	if (m_childTree)
+	{
+		m_childTree->Query(callback, local);
+		return;
+	}
+
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	for (int i = 0; i < m_count - 1; ++i)
+	{
+		cb2AABB box;
+		box.lowerBound = cb2Min(m_vertices[i], m_vertices[i + 1]) - r;
+		box.upperBound = cb2Max(m_vertices[i], m_vertices[i + 1]) + r;
+		if (cb2TestOverlap(box, local) && callback->QueryCallback(i) == false)
+		{
+			return;
+		}
+	}
 }
 
 #endif
@@ -0,0 +1,65 @@
+/*
+* Copyright (c) 2006-2010 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_CHILD_QUERY_H
+#define CB2_CHILD_QUERY_H
+
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CompoundShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2HeightfieldShape.h>
+
+/// Query the children of a shape whose proxy covers all children: a chain with a
+/// child tree, a heightfield or a compound.
+template <typename T>
+inline void cb2QueryChildren(const cb2Shape* shape, T* callback, const cb2AABB& aabb, const cb2Transform& transform)
+{
+	switch (shape->GetType())
+	{
+	case cb2Shape::e_heightfield:
+		((const cb2HeightfieldShape*)shape)->QueryChildren(callback, aabb, transform);
+		break;
+
+	case cb2Shape::e_compound:
+		((const cb2CompoundShape*)shape)->QueryChildren(callback, aabb, transform);
+		break;
+
+	default:
+		cb2Assert(shape->GetType() == cb2Shape::e_chain);
+		((const cb2ChainShape*)shape)->QueryChildren(callback, aabb, transform);
+		break;
+	}
+}
+
+/// Test one child of a shape whose proxy covers all children, like cb2QueryChildren.
+inline bool cb2TestChildOverlap(const cb2Shape* shape, int childIndex, const cb2AABB& aabb, const cb2Transform& transform)
+{
+	switch (shape->GetType())
+	{
+	case cb2Shape::e_heightfield:
+		return ((const cb2HeightfieldShape*)shape)->TestChildOverlap(childIndex, aabb, transform);
+
+	case cb2Shape::e_compound:
+		return ((const cb2CompoundShape*)shape)->TestChildOverlap(childIndex, aabb, transform);
+
+	default:
+		cb2Assert(shape->GetType() == cb2Shape::e_chain);
+		return ((const cb2ChainShape*)shape)->TestChildOverlap(childIndex, aabb, transform);
+	}
+}
+
+#endif
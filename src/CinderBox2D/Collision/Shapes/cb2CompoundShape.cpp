@@ -0,0 +1,481 @@
+/*
+* Copyright (c) 2006-2010 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Collision/Shapes/cb2CompoundShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
+#include <new>
+#include <memory.h>
+
+// Corners flatter than this sine of the turn angle are taken as collinear.
+const float cb2_decomposeCollinearSine = 1.0e-3f;
+
+// A piece of the decomposition, as indices into the outline.
+struct cb2DecomposePiece
+{
+	int indices[cb2_maxPolygonVertices];
+	int count;
+};
+
+// A diagonal of the triangulation between two triangles.
+struct cb2DecomposeDiagonal
+{
+	int triangle1, triangle2;
+};
+
+static bool cb2IsConvexCorner(const ci::Vec2f& a, const ci::Vec2f& b, const ci::Vec2f& c)
+{
+	ci::Vec2f e1 = b - a;
+	ci::Vec2f e2 = c - b;
+	return cb2Cross(e1, e2) > cb2_decomposeCollinearSine * e1.length() * e2.length();
+}
+
+// Is p inside the counter-clockwise triangle abc or on its boundary?
+static bool cb2PointInTriangle(const ci::Vec2f& p, const ci::Vec2f& a, const ci::Vec2f& b, const ci::Vec2f& c)
+{
+	return cb2Cross(b - a, p - a) >= 0.0f && cb2Cross(c - b, p - b) >= 0.0f && cb2Cross(a - c, p - c) >= 0.0f;
+}
+
+static int cb2FindRoot(int* parents, int i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+// Merge piece q into piece p across their shared edge. Returns false if the
+// result would be concave or have too many vertices.
+static bool cb2MergePieces(cb2DecomposePiece* p, const cb2DecomposePiece* q, const ci::Vec2f* ps)
+{
+	int count = p->count + q->count - 2;
+	if (count > cb2_maxPolygonVertices)
+	{
+		return false;
+	}
+
+	// Find the edge a->b of p that q has as b->a.
+	int ip = -1, iq = -1;
+	for (int i = 0; i < p->count && ip == -1; ++i)
+	{
+		int a = p->indices[i];
+		int b = p->indices[i + 1 < p->count ? i + 1 : 0];
+		for (int j = 0; j < q->count; ++j)
+		{
+			if (q->indices[j] == b && q->indices[j + 1 < q->count ? j + 1 : 0] == a)
+			{
+				ip = i;
+				iq = j;
+				break;
+			}
+		}
+	}
+
+	if (ip == -1)
+	{
+		return false;
+	}
+
+	// Walk p from b back around to a, then q from after a up to before b.
+	cb2DecomposePiece merged;
+	merged.count = 0;
+	for (int i = 0; i < p->count; ++i)
+	{
+		merged.indices[merged.count++] = p->indices[(ip + 1 + i) % p->count];
+	}
+	for (int j = 0; j < q->count - 2; ++j)
+	{
+		merged.indices[merged.count++] = q->indices[(iq + 2 + j) % q->count];
+	}
+	cb2Assert(merged.count == count);
+
+	// Only the corners at the ends of the edge change.
+	int corners[2] = { p->count - 1, 0 };
+	for (int k = 0; k < 2; ++k)
+	{
+		int i = corners[k];
+		const ci::Vec2f& a = ps[merged.indices[(i + count - 1) % count]];
+		const ci::Vec2f& b = ps[merged.indices[i]];
+		const ci::Vec2f& c = ps[merged.indices[(i + 1) % count]];
+		if (cb2IsConvexCorner(a, b, c) == false)
+		{
+			return false;
+		}
+	}
+
+	*p = merged;
+	return true;
+}
+
+int cb2DecomposePolygon(const ci::Vec2f* vertices, int count, cb2PolygonShape* pieces, int maxPieces)
+{
+	cb2Assert(count >= 3);
+	if (count < 3)
+	{
+		return 0;
+	}
+
+	ci::Vec2f* ps = (ci::Vec2f*)cb2Alloc(count * sizeof(ci::Vec2f));
+	int* remaining = (int*)cb2Alloc(count * sizeof(int));
+	int* edgeOwners = (int*)cb2Alloc(count * sizeof(int));
+	cb2DecomposePiece* triangles = (cb2DecomposePiece*)cb2Alloc(count * sizeof(cb2DecomposePiece));
+	cb2DecomposeDiagonal* diagonals = (cb2DecomposeDiagonal*)cb2Alloc(count * sizeof(cb2DecomposeDiagonal));
+	int* parents = (int*)cb2Alloc(count * sizeof(int));
+
+	// Weld neighbors and drop flat corners until the outline is stable.
+	int n = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		if (n == 0 || cb2DistanceSquared(vertices[i], ps[n - 1]) > cb2_linearSlop * cb2_linearSlop)
+		{
+			ps[n++] = vertices[i];
+		}
+	}
+	while (n > 1 && cb2DistanceSquared(ps[0], ps[n - 1]) <= cb2_linearSlop * cb2_linearSlop)
+	{
+		--n;
+	}
+
+	// Put the outline in counter-clockwise order.
+	float area = 0.0f;
+	for (int i = 0; i < n; ++i)
+	{
+		area += cb2Cross(ps[i], ps[i + 1 < n ? i + 1 : 0]);
+	}
+	if (area < 0.0f)
+	{
+		for (int i = 0; i < n / 2; ++i)
+		{
+			cb2Swap(ps[i], ps[n - 1 - i]);
+		}
+	}
+
+	bool removed = true;
+	while (removed && n >= 3)
+	{
+		removed = false;
+		for (int i = 0; i < n; ++i)
+		{
+			const ci::Vec2f& a = ps[i > 0 ? i - 1 : n - 1];
+			const ci::Vec2f& b = ps[i];
+			const ci::Vec2f& c = ps[i + 1 < n ? i + 1 : 0];
+			ci::Vec2f e1 = b - a;
+			ci::Vec2f e2 = c - b;
+			if (cb2Abs(cb2Cross(e1, e2)) <= cb2_decomposeCollinearSine * e1.length() * e2.length() && cb2Dot(e1, e2) > 0.0f)
+			{
+				memmove(ps + i, ps + i + 1, (n - i - 1) * sizeof(ci::Vec2f));
+				--n;
+				removed = true;
+				break;
+			}
+		}
+	}
+
+	int pieceCount = 0;
+	if (n >= 3 && cb2Abs(area) > cb2_epsilon)
+	{
+		// Ear clipping. The other side of each remaining edge i -> i + 1 is owned by
+		// edgeOwners[i], which is -1 for the outline.
+		int remainingCount = n;
+		for (int i = 0; i < n; ++i)
+		{
+			remaining[i] = i;
+			edgeOwners[i] = -1;
+		}
+
+		int triangleCount = 0;
+		int diagonalCount = 0;
+		bool failed = false;
+		while (remainingCount >= 3)
+		{
+			int ear = -1;
+			for (int i = 0; i < remainingCount && ear == -1; ++i)
+			{
+				const ci::Vec2f& a = ps[remaining[i > 0 ? i - 1 : remainingCount - 1]];
+				const ci::Vec2f& b = ps[remaining[i]];
+				const ci::Vec2f& c = ps[remaining[i + 1 < remainingCount ? i + 1 : 0]];
+				if (remainingCount > 3 && cb2IsConvexCorner(a, b, c) == false)
+				{
+					continue;
+				}
+
+				// No other vertex may be inside the ear.
+				bool empty = true;
+				for (int j = 0; j < remainingCount && empty && remainingCount > 3; ++j)
+				{
+					const ci::Vec2f& p = ps[remaining[j]];
+					if (p != a && p != b && p != c && cb2PointInTriangle(p, a, b, c))
+					{
+						empty = false;
+					}
+				}
+
+				if (empty)
+				{
+					ear = i;
+				}
+			}
+
+			if (ear == -1)
+			{
+				// Self intersecting or numerically broken outline.
+				failed = true;
+				break;
+			}
+
+			int prev = ear > 0 ? ear - 1 : remainingCount - 1;
+			int next = ear + 1 < remainingCount ? ear + 1 : 0;
+
+			cb2DecomposePiece* triangle = triangles + triangleCount;
+			triangle->indices[0] = remaining[prev];
+			triangle->indices[1] = remaining[ear];
+			triangle->indices[2] = remaining[next];
+			triangle->count = 3;
+
+			// The two clipped edges separate this triangle from earlier ones.
+			int owners[3] = { edgeOwners[prev], edgeOwners[ear], remainingCount == 3 ? edgeOwners[next] : -1 };
+			for (int k = 0; k < 3; ++k)
+			{
+				if (owners[k] != -1)
+				{
+					diagonals[diagonalCount].triangle1 = owners[k];
+					diagonals[diagonalCount].triangle2 = triangleCount;
+					++diagonalCount;
+				}
+			}
+
+			edgeOwners[prev] = triangleCount;
+			++triangleCount;
+
+			memmove(remaining + ear, remaining + ear + 1, (remainingCount - ear - 1) * sizeof(int));
+			memmove(edgeOwners + ear, edgeOwners + ear + 1, (remainingCount - ear - 1) * sizeof(int));
+			--remainingCount;
+			if (remainingCount < 3)
+			{
+				break;
+			}
+		}
+
+		if (failed == false)
+		{
+			// Hertel-Mehlhorn: remove each diagonal whose removal keeps the piece convex.
+			for (int i = 0; i < triangleCount; ++i)
+			{
+				parents[i] = i;
+			}
+
+			for (int i = 0; i < diagonalCount; ++i)
+			{
+				int root1 = cb2FindRoot(parents, diagonals[i].triangle1);
+				int root2 = cb2FindRoot(parents, diagonals[i].triangle2);
+				if (root1 != root2 && cb2MergePieces(triangles + root1, triangles + root2, ps))
+				{
+					parents[root2] = root1;
+				}
+			}
+
+			for (int i = 0; i < triangleCount; ++i)
+			{
+				if (parents[i] != i)
+				{
+					continue;
+				}
+
+				cb2Assert(pieceCount < maxPieces);
+				if (pieceCount == maxPieces)
+				{
+					break;
+				}
+
+				const cb2DecomposePiece* piece = triangles + i;
+				ci::Vec2f pieceVertices[cb2_maxPolygonVertices];
+				for (int k = 0; k < piece->count; ++k)
+				{
+					pieceVertices[k] = ps[piece->indices[k]];
+				}
+				pieces[pieceCount++].SetConvex(pieceVertices, piece->count);
+			}
+		}
+	}
+
+	cb2Free(parents);
+	cb2Free(diagonals);
+	cb2Free(triangles);
+	cb2Free(edgeOwners);
+	cb2Free(remaining);
+	cb2Free(ps);
+	return pieceCount;
+}
+
+cb2CompoundShape::~cb2CompoundShape()
+{
+	cb2Free(m_children);
+	cb2Free(m_childBoxes);
+	m_children = NULL;
+	m_childBoxes = NULL;
+	m_count = 0;
+}
+
+void cb2CompoundShape::Create(const cb2PolygonShape* pieces, int count)
+{
+	cb2Assert(m_children == NULL && m_count == 0);
+	cb2Assert(count >= 1);
+
+	m_count = count;
+	m_children = (cb2PolygonShape*)cb2Alloc(count * sizeof(cb2PolygonShape));
+	m_childBoxes = (cb2AABB*)cb2Alloc(count * sizeof(cb2AABB));
+
+	cb2Transform identity;
+	identity.SetIdentity();
+
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	for (int i = 0; i < count; ++i)
+	{
+		// The contacts take the radius of the fixture shape.
+		cb2PolygonShape* child = new (m_children + i) cb2PolygonShape(pieces[i]);
+		child->m_radius = m_radius;
+
+		child->ComputeAABB(m_childBoxes + i, identity, 0);
+		m_childBoxes[i].lowerBound -= r;
+		m_childBoxes[i].upperBound += r;
+	}
+}
+
+bool cb2CompoundShape::CreateFromOutline(const ci::Vec2f* vertices, int count)
+{
+	int maxPieces = cb2Max(count - 2, 1);
+	cb2PolygonShape* pieces = (cb2PolygonShape*)cb2Alloc(maxPieces * sizeof(cb2PolygonShape));
+	for (int i = 0; i < maxPieces; ++i)
+	{
+		new (pieces + i) cb2PolygonShape;
+	}
+
+	int pieceCount = cb2DecomposePolygon(vertices, count, pieces, maxPieces);
+	if (pieceCount > 0)
+	{
+		Create(pieces, pieceCount);
+	}
+
+	cb2Free(pieces);
+	return pieceCount > 0;
+}
+
+cb2Shape* cb2CompoundShape::Clone(cb2BlockAllocator* allocator) const
+{
+	void* mem = allocator->Allocate(sizeof(cb2CompoundShape));
+	cb2CompoundShape* clone = new (mem) cb2CompoundShape;
+	clone->m_radius = m_radius;
+	clone->m_count = m_count;
+	clone->m_children = (cb2PolygonShape*)cb2Alloc(m_count * sizeof(cb2PolygonShape));
+	for (int i = 0; i < m_count; ++i)
+	{
+		new (clone->m_children + i) cb2PolygonShape(m_children[i]);
+	}
+	clone->m_childBoxes = (cb2AABB*)cb2Alloc(m_count * sizeof(cb2AABB));
+	memcpy(clone->m_childBoxes, m_childBoxes, m_count * sizeof(cb2AABB));
+	return clone;
+}
+
+int cb2CompoundShape::GetChildCount() const
+{
+	return m_count;
+}
+
+bool cb2CompoundShape::TestPoint(const cb2Transform& xf, const ci::Vec2f& p) const
+{
+	for (int i = 0; i < m_count; ++i)
+	{
+		if (m_children[i].TestPoint(xf, p))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool cb2CompoundShape::RayCast(cb2RayCastOutput* output, const cb2RayCastInput& input,
+							   const cb2Transform& xf, int childIndex) const
+{
+	if (childIndex != cb2ChainShape::e_allChildren)
+	{
+		cb2Assert(0 <= childIndex && childIndex < m_count);
+		return m_children[childIndex].RayCast(output, input, xf, 0);
+	}
+
+	// Clip the ray to each hit so only closer pieces are reported.
+	cb2RayCastInput clipped = input;
+	bool hit = false;
+	for (int i = 0; i < m_count; ++i)
+	{
+		cb2RayCastOutput childOutput;
+		if (m_children[i].RayCast(&childOutput, clipped, xf, 0))
+		{
+			*output = childOutput;
+			clipped.maxFraction = childOutput.fraction;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+void cb2CompoundShape::ComputeAABB(cb2AABB* aabb, const cb2Transform& xf, int childIndex) const
+{
+	if (childIndex != cb2ChainShape::e_allChildren)
+	{
+		cb2Assert(0 <= childIndex && childIndex < m_count);
+		m_children[childIndex].ComputeAABB(aabb, xf, 0);
+		return;
+	}
+
+	m_children[0].ComputeAABB(aabb, xf, 0);
+	for (int i = 1; i < m_count; ++i)
+	{
+		cb2AABB childAABB;
+		m_children[i].ComputeAABB(&childAABB, xf, 0);
+		aabb->Combine(childAABB);
+	}
+}
+
+bool cb2CompoundShape::TestChildOverlap(int childIndex, const cb2AABB& aabb, const cb2Transform& xf) const
+{
+	cb2Assert(0 <= childIndex && childIndex < m_count);
+	return cb2TestOverlap(m_childBoxes[childIndex], ComputeLocalAABB(aabb, xf));
+}
+
+void cb2CompoundShape::ComputeMass(cb2MassData* massData, float density) const
+{
+	massData->mass = 0.0f;
+	cb2::setZero(massData->center);
+	massData->I = 0.0f;
+
+	// The inertia of each piece is about the shape origin, so they add up.
+	for (int i = 0; i < m_count; ++i)
+	{
+		cb2MassData childMass;
+		m_children[i].ComputeMass(&childMass, density);
+		massData->mass += childMass.mass;
+		massData->center += childMass.mass * childMass.center;
+		massData->I += childMass.I;
+	}
+
+	if (massData->mass > 0.0f)
+	{
+		massData->center *= 1.0f / massData->mass;
+	}
+}
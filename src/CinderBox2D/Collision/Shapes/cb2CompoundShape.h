@@ -0,0 +1,148 @@
+/*
+* Copyright (c) 2006-2010 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_COMPOUND_SHAPE_H
+#define CB2_COMPOUND_SHAPE_H
+
+#include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+
+/// Decompose a simple polygon into convex pieces with at most cb2_maxPolygonVertices
+/// vertices each. The outline is triangulated by ear clipping and the triangles are
+/// merged across their diagonals while the pieces stay convex (Hertel-Mehlhorn),
+/// which gives at most four times the minimal piece count and usually close to it.
+/// Coincident and collinear outline points are removed first.
+/// @param vertices the outline, in either winding, without self intersections
+/// @param count the vertex count, at least 3
+/// @param pieces receives the pieces
+/// @param maxPieces the capacity of pieces, count - 2 is always enough
+/// @return the piece count, or zero for a degenerate outline
+int cb2DecomposePolygon(const ci::Vec2f* vertices, int count, cb2PolygonShape* pieces, int maxPieces);
+
+/// A compound is a set of convex polygon pieces that share one broad-phase proxy.
+/// The contact manager pairs the pieces under the proxy, like the cells of a
+/// heightfield, so a concave body costs one fixture and one proxy.
+/// Since there may be many pieces, they are allocated using cb2Alloc.
+class cb2CompoundShape : public cb2Shape
+{
+public:
+	cb2CompoundShape();
+
+	/// The destructor frees the pieces using cb2Free.
+	~cb2CompoundShape();
+
+	/// Create the compound from convex pieces, these are copied.
+	/// @param pieces an array of polygons
+	/// @param count the piece count, at least 1
+	void Create(const cb2PolygonShape* pieces, int count);
+
+	/// Decompose a concave outline with cb2DecomposePolygon and create the compound
+	/// from the pieces.
+	/// @return false for a degenerate outline, the compound is then left empty
+	bool CreateFromOutline(const ci::Vec2f* vertices, int count);
+
+	/// Implement cb2Shape. Pieces are cloned using cb2Alloc.
+	cb2Shape* Clone(cb2BlockAllocator* allocator) const;
+
+	/// @see cb2Shape::GetChildCount
+	int GetChildCount() const;
+
+	/// Get a piece.
+	const cb2PolygonShape* GetChild(int index) const;
+
+	/// @see cb2Shape::TestPoint
+	bool TestPoint(const cb2Transform& transform, const ci::Vec2f& p) const;
+
+	/// Implement cb2Shape. Use cb2ChainShape::e_allChildren to get the closest hit of all pieces.
+	bool RayCast(cb2RayCastOutput* output, const cb2RayCastInput& input,
+					const cb2Transform& transform, int childIndex) const;
+
+	/// @see cb2Shape::ComputeAABB
+	/// Use cb2ChainShape::e_allChildren to get the box of the whole compound.
+	void ComputeAABB(cb2AABB* aabb, const cb2Transform& transform, int childIndex) const;
+
+	/// The mass of all pieces.
+	/// @see cb2Shape::ComputeMass
+	void ComputeMass(cb2MassData* massData, float density) const;
+
+	/// Query the pieces whose fat local box overlaps a world box. The callback class
+	/// must have `bool QueryCallback(int childIndex)`.
+	template <typename T>
+	void QueryChildren(T* callback, const cb2AABB& aabb, const cb2Transform& transform) const;
+
+	/// Test a piece's fat local box against a world box, like QueryChildren.
+	bool TestChildOverlap(int childIndex, const cb2AABB& aabb, const cb2Transform& transform) const;
+
+	/// The pieces. Owned by this class.
+	cb2PolygonShape* m_children;
+
+	/// The piece count.
+	int m_count;
+
+private:
+
+	static cb2AABB ComputeLocalAABB(const cb2AABB& aabb, const cb2Transform& transform);
+
+	// The fat local box of each piece.
+	cb2AABB* m_childBoxes;
+};
+
+inline cb2CompoundShape::cb2CompoundShape()
+{
+	m_type = e_compound;
+	m_radius = cb2_polygonRadius;
+	m_children = NULL;
+	m_childBoxes = NULL;
+	m_count = 0;
+}
+
+inline const cb2PolygonShape* cb2CompoundShape::GetChild(int index) const
+{
+	cb2Assert(0 <= index && index < m_count);
+	return m_children + index;
+}
+
+inline cb2AABB cb2CompoundShape::ComputeLocalAABB(const cb2AABB& aabb, const cb2Transform& transform)
+{
+	// Box of the rotated box.
+	ci::Vec2f c = cb2MulT(transform, aabb.GetCenter());
+	ci::Vec2f h = aabb.GetExtents();
+	ci::Vec2f r(cb2Abs(transform.q.c) * h.x + cb2Abs(transform.q.s) * h.y,
+				cb2Abs(transform.q.s) * h.x + cb2Abs(transform.q.c) * h.y);
+
+	cb2AABB local;
+	local.lowerBound = c - r;
+	local.upperBound = c + r;
+	return local;
+}
+
+template <typename T>
+inline void cb2CompoundShape::QueryChildren(T* callback, const cb2AABB& aabb, const cb2Transform& transform) const
+{
+	cb2AABB local = ComputeLocalAABB(aabb, transform);
+
+	// Compounds have few pieces, a tree would not pay for itself.
+	for (int i = 0; i < m_count; ++i)
+	{
+		if (cb2TestOverlap(m_childBoxes[i], local) && callback->QueryCallback(i) == false)
+		{
+			return;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,212 @@
+/*
+* Copyright (c) 2006-2010 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Collision/Shapes/cb2HeightfieldShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
+#include <new>
+#include <memory.h>
+
+cb2HeightfieldShape::~cb2HeightfieldShape()
+{
+	cb2Free(m_heights);
+	m_heights = NULL;
+	m_count = 0;
+}
+
+void cb2HeightfieldShape::Create(const float* heights, int count, float spacing)
+{
+	cb2Assert(m_heights == NULL && m_count == 0);
+	cb2Assert(count >= 2);
+	cb2Assert(spacing > cb2_linearSlop);
+
+	m_count = count;
+	m_spacing = spacing;
+	m_heights = (float*)cb2Alloc(count * sizeof(float));
+	memcpy(m_heights, heights, count * sizeof(float));
+
+	m_minHeight = heights[0];
+	m_maxHeight = heights[0];
+	for (int i = 1; i < count; ++i)
+	{
+		m_minHeight = cb2Min(m_minHeight, heights[i]);
+		m_maxHeight = cb2Max(m_maxHeight, heights[i]);
+	}
+}
+
+cb2Shape* cb2HeightfieldShape::Clone(cb2BlockAllocator* allocator) const
+{
+	void* mem = allocator->Allocate(sizeof(cb2HeightfieldShape));
+	cb2HeightfieldShape* clone = new (mem) cb2HeightfieldShape;
+	clone->m_radius = m_radius;
+	clone->m_count = m_count;
+	clone->m_spacing = m_spacing;
+	clone->m_heights = (float*)cb2Alloc(m_count * sizeof(float));
+	memcpy(clone->m_heights, m_heights, m_count * sizeof(float));
+	clone->m_minHeight = m_minHeight;
+	clone->m_maxHeight = m_maxHeight;
+	return clone;
+}
+
+int cb2HeightfieldShape::GetChildCount() const
+{
+	// cell count = sample count - 1
+	return m_count - 1;
+}
+
+void cb2HeightfieldShape::GetChildEdge(cb2EdgeShape* edge, int index) const
+{
+	cb2Assert(0 <= index && index < m_count - 1);
+	edge->m_type = cb2Shape::e_edge;
+	edge->m_radius = m_radius;
+
+	float x = index * m_spacing;
+	edge->m_vertex1.set(x, m_heights[index]);
+	edge->m_vertex2.set(x + m_spacing, m_heights[index + 1]);
+
+	if (index > 0)
+	{
+		edge->m_vertex0.set(x - m_spacing, m_heights[index - 1]);
+		edge->m_hasVertex0 = true;
+	}
+	else
+	{
+		edge->m_hasVertex0 = false;
+	}
+
+	if (index < m_count - 2)
+	{
+		edge->m_vertex3.set(x + 2.0f * m_spacing, m_heights[index + 2]);
+		edge->m_hasVertex3 = true;
+	}
+	else
+	{
+		edge->m_hasVertex3 = false;
+	}
+}
+
+bool cb2HeightfieldShape::TestPoint(const cb2Transform& xf, const ci::Vec2f& p) const
+{
+	CB2_NOT_USED(xf);
+	CB2_NOT_USED(p);
+	return false;
+}
+
+bool cb2HeightfieldShape::RayCast(cb2RayCastOutput* output, const cb2RayCastInput& input,
+								  const cb2Transform& xf, int childIndex) const
+{
+	cb2EdgeShape edgeShape;
+
+	if (childIndex != cb2ChainShape::e_allChildren)
+	{
+		cb2Assert(0 <= childIndex && childIndex < m_count - 1);
+		edgeShape.m_vertex1 = GetVertex(childIndex);
+		edgeShape.m_vertex2 = GetVertex(childIndex + 1);
+		return edgeShape.RayCast(output, input, xf, 0);
+	}
+
+	cb2RayCastInput local;
+	local.p1 = cb2MulT(xf, input.p1);
+	local.p2 = cb2MulT(xf, input.p2);
+	local.maxFraction = input.maxFraction;
+
+	// Walk the cells under the ray from its start. A hit in a cell is closer than
+	// any hit in the cells after it, so the walk stops at the first hit.
+	float x1 = local.p1.x;
+	float x2 = local.p1.x + local.maxFraction * (local.p2.x - local.p1.x);
+	float width = (m_count - 1) * m_spacing;
+	if (cb2Max(x1, x2) < 0.0f || width < cb2Min(x1, x2))
+	{
+		return false;
+	}
+
+	float invSpacing = 1.0f / m_spacing;
+	int first = cb2Clamp((int)floorf(cb2Clamp(x1, 0.0f, width) * invSpacing), 0, m_count - 2);
+	int last = cb2Clamp((int)floorf(cb2Clamp(x2, 0.0f, width) * invSpacing), 0, m_count - 2);
+	int step = first <= last ? 1 : -1;
+
+	cb2Transform identity;
+	identity.SetIdentity();
+
+	for (int i = first; ; i += step)
+	{
+		edgeShape.m_vertex1 = GetVertex(i);
+		edgeShape.m_vertex2 = GetVertex(i + 1);
+		if (edgeShape.RayCast(output, local, identity, 0))
+		{
+			output->normal = cb2Mul(xf.q, output->normal);
+			return true;
+		}
+
+		if (i == last)
+		{
+			break;
+		}
+	}
+
+	return false;
+}
+
+void cb2HeightfieldShape::ComputeAABB(cb2AABB* aabb, const cb2Transform& xf, int childIndex) const
+{
+	if (childIndex == cb2ChainShape::e_allChildren)
+	{
+		// Box of the rotated local box.
+		cb2AABB localAABB;
+		localAABB.lowerBound.set(0.0f, m_minHeight);
+		localAABB.upperBound.set((m_count - 1) * m_spacing, m_maxHeight);
+
+		ci::Vec2f c = cb2Mul(xf, localAABB.GetCenter());
+		ci::Vec2f h = localAABB.GetExtents();
+		ci::Vec2f r(cb2Abs(xf.q.c) * h.x + cb2Abs(xf.q.s) * h.y,
+					cb2Abs(xf.q.s) * h.x + cb2Abs(xf.q.c) * h.y);
+		aabb->lowerBound = c - r;
+		aabb->upperBound = c + r;
+		return;
+	}
+
+	cb2Assert(0 <= childIndex && childIndex < m_count - 1);
+
+	ci::Vec2f v1 = cb2Mul(xf, GetVertex(childIndex));
+	ci::Vec2f v2 = cb2Mul(xf, GetVertex(childIndex + 1));
+
+	aabb->lowerBound = cb2Min(v1, v2);
+	aabb->upperBound = cb2Max(v1, v2);
+}
+
+bool cb2HeightfieldShape::TestChildOverlap(int childIndex, const cb2AABB& aabb, const cb2Transform& xf) const
+{
+	cb2Assert(0 <= childIndex && childIndex < m_count - 1);
+	cb2AABB local = ComputeLocalAABB(aabb, xf);
+
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	ci::Vec2f v1 = GetVertex(childIndex);
+	ci::Vec2f v2 = GetVertex(childIndex + 1);
+	cb2AABB box;
+	box.lowerBound = cb2Min(v1, v2) - r;
+	box.upperBound = cb2Max(v1, v2) + r;
+	return cb2TestOverlap(box, local);
+}
+
+void cb2HeightfieldShape::ComputeMass(cb2MassData* massData, float density) const
+{
+	CB2_NOT_USED(density);
+
+	massData->mass = 0.0f;
+	cb2::setZero(massData->center);
+	massData->I = 0.0f;
+}
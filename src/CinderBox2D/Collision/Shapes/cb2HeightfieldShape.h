@@ -0,0 +1,165 @@
+/*
+* Copyright (c) 2006-2010 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_HEIGHTFIELD_SHAPE_H
+#define CB2_HEIGHTFIELD_SHAPE_H
+
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
+
+class cb2EdgeShape;
+
+/// A heightfield is a chain over regularly spaced samples. Vertex i is at
+/// (i * m_spacing, m_heights[i]) in the body frame, so only the heights are stored.
+/// Each cell between two samples is a child edge with its neighbors as ghost vertices.
+/// The fixture uses a single broad-phase proxy and the cells under a box are found
+/// by index math, there is no child tree.
+/// Since there may be many samples, they are allocated using cb2Alloc.
+class cb2HeightfieldShape : public cb2Shape
+{
+public:
+	cb2HeightfieldShape();
+
+	/// The destructor frees the heights using cb2Free.
+	~cb2HeightfieldShape();
+
+	/// Create the heightfield.
+	/// @param heights an array of heights, these are copied
+	/// @param count the sample count, at least 2
+	/// @param spacing the horizontal distance between samples
+	void Create(const float* heights, int count, float spacing);
+
+	/// Implement cb2Shape. Heights are cloned using cb2Alloc.
+	cb2Shape* Clone(cb2BlockAllocator* allocator) const;
+
+	/// @see cb2Shape::GetChildCount
+	int GetChildCount() const;
+
+	/// Get the local position of a sample.
+	ci::Vec2f GetVertex(int index) const;
+
+	/// Get a cell edge.
+	void GetChildEdge(cb2EdgeShape* edge, int index) const;
+
+	/// This always return false.
+	/// @see cb2Shape::TestPoint
+	bool TestPoint(const cb2Transform& transform, const ci::Vec2f& p) const;
+
+	/// Implement cb2Shape. Use cb2ChainShape::e_allChildren to get the closest hit of all cells.
+	bool RayCast(cb2RayCastOutput* output, const cb2RayCastInput& input,
+					const cb2Transform& transform, int childIndex) const;
+
+	/// @see cb2Shape::ComputeAABB
+	/// Use cb2ChainShape::e_allChildren to get the box of the whole heightfield.
+	void ComputeAABB(cb2AABB* aabb, const cb2Transform& transform, int childIndex) const;
+
+	/// Heightfields have zero mass.
+	/// @see cb2Shape::ComputeMass
+	void ComputeMass(cb2MassData* massData, float density) const;
+
+	/// Query the cells whose fat local box overlaps a world box. The callback class
+	/// must have `bool QueryCallback(int childIndex)`.
+	template <typename T>
+	void QueryChildren(T* callback, const cb2AABB& aabb, const cb2Transform& transform) const;
+
+	/// Test a cell's fat local box against a world box, like QueryChildren.
+	bool TestChildOverlap(int childIndex, const cb2AABB& aabb, const cb2Transform& transform) const;
+
+	/// The heights. Owned by this class.
+	float* m_heights;
+
+	/// The sample count.
+	int m_count;
+
+	/// The horizontal distance between samples.
+	float m_spacing;
+
+private:
+
+	static cb2AABB ComputeLocalAABB(const cb2AABB& aabb, const cb2Transform& transform);
+
+	float m_minHeight, m_maxHeight;
+};
+
+inline cb2HeightfieldShape::cb2HeightfieldShape()
+{
+	m_type = e_heightfield;
+	m_radius = cb2_polygonRadius;
+	m_heights = NULL;
+	m_count = 0;
+	m_spacing = 1.0f;
+	m_minHeight = 0.0f;
+	m_maxHeight = 0.0f;
+}
+
+inline ci::Vec2f cb2HeightfieldShape::GetVertex(int index) const
+{
+	cb2Assert(0 <= index && index < m_count);
+	return ci::Vec2f(index * m_spacing, m_heights[index]);
+}
+
+inline cb2AABB cb2HeightfieldShape::ComputeLocalAABB(const cb2AABB& aabb, const cb2Transform& transform)
+{
+	// Box of the rotated box.
+	ci::Vec2f c = cb2MulT(transform, aabb.GetCenter());
+	ci::Vec2f h = aabb.GetExtents();
+	ci::Vec2f r(cb2Abs(transform.q.c) * h.x + cb2Abs(transform.q.s) * h.y,
+				cb2Abs(transform.q.s) * h.x + cb2Abs(transform.q.c) * h.y);
+
+	cb2AABB local;
+	local.lowerBound = c - r;
+	local.upperBound = c + r;
+	return local;
+}
+
+template <typename T>
+inline void cb2HeightfieldShape::QueryChildren(T* callback, const cb2AABB& aabb, const cb2Transform& transform) const
+{
+	cb2AABB local = ComputeLocalAABB(aabb, transform);
+
+	float r = cb2_aabbExtension;
+	float width = (m_count - 1) * m_spacing;
+	if (local.upperBound.x + r < 0.0f || width < local.lowerBound.x - r ||
+		local.upperBound.y + r < m_minHeight || m_maxHeight < local.lowerBound.y - r)
+	{
+		return;
+	}
+
+	// The cells under the box, clamped before the conversion so far boxes do not overflow.
+	float invSpacing = 1.0f / m_spacing;
+	int lower = (int)floorf(cb2Max(local.lowerBound.x - r, 0.0f) * invSpacing);
+	int upper = (int)floorf(cb2Min(local.upperBound.x + r, width) * invSpacing);
+	lower = cb2Max(lower, 0);
+	upper = cb2Min(upper, m_count - 2);
+
+	for (int i = lower; i <= upper; ++i)
+	{
+		float h1 = m_heights[i];
+		float h2 = m_heights[i + 1];
+		if (cb2Max(h1, h2) + r < local.lowerBound.y || local.upperBound.y < cb2Min(h1, h2) - r)
+		{
+			continue;
+		}
+
+		if (callback->QueryCallback(i) == false)
+		{
+			return;
+		}
+	}
+}
+
+#endif
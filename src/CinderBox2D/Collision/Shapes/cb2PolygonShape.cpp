@@ -117,6 +117,55 @@ static ci::Vec2f ComputeCentroid(const ci::Vec2f* vs, int count)
 	return c;
 }
 
+// Sort the points by x, then by y. The count is at most cb2_maxPolygonVertices,
+// so insertion sort is the fastest.
+static void cb2SortPoints(ci::Vec2f* ps, int count)
+{
+	for (int i = 1; i < count; ++i)
+	{
+		ci::Vec2f p = ps[i];
+		int j = i - 1;
+		while (j >= 0 && (ps[j].x > p.x || (ps[j].x == p.x && ps[j].y > p.y)))
+		{
+			ps[j + 1] = ps[j];
+			--j;
+		}
+		ps[j + 1] = p;
+	}
+}
+
+// Andrew's monotone chain on sorted points. The hull is counter-clockwise and
+// collinear points are dropped. The hull needs room for 2 * count points.
+// http://en.wikibooks.org/wiki/Algorithm_Implementation/Geometry/Convex_hull/Monotone_chain
+static int cb2ComputeHull(const ci::Vec2f* ps, int count, ci::Vec2f* hull)
+{
+	int m = 0;
+
+	// Lower hull.
+	for (int i = 0; i < count; ++i)
+	{
+		while (m >= 2 && cb2Cross(hull[m - 1] - hull[m - 2], ps[i] - hull[m - 2]) <= 0.0f)
+		{
+			--m;
+		}
+		hull[m++] = ps[i];
+	}
+
+	// Upper hull.
+	int lower = m + 1;
+	for (int i = count - 2; i >= 0; --i)
+	{
+		while (m >= lower && cb2Cross(hull[m - 1] - hull[m - 2], ps[i] - hull[m - 2]) <= 0.0f)
+		{
+			--m;
+		}
+		hull[m++] = ps[i];
+	}
+
+	// The last point is the first one again.
+	return m - 1;
+}
+
 void cb2PolygonShape::set(const ci::Vec2f* vertices, int count)
 {
 	cb2Assert(3 <= count && count <= cb2_maxPolygonVertices);
@@ -160,76 +209,54 @@ void cb2PolygonShape::set(const ci::Vec2f* vertices, int count)
 		return;
 	}
 
-	// Create the convex hull using the Gift wrapping algorithm
-	// http://en.wikipedia.org/wiki/Gift_wrapping_algorithm
+	cb2SortPoints(ps, n);
+
+	ci::Vec2f hull[2 * cb2_maxPolygonVertices];
+	int m = cb2ComputeHull(ps, n, hull);
+	if (m < 3)
+	{
+		// All points are collinear.
+		cb2Assert(false);
+		SetAsBox(1.0f, 1.0f);
+		return;
+	}
 
-	// Find the right most point on the hull
+	// Start at the right most point, lowest first, as the gift wrapping hull did.
+	// This keeps the vertex order, and so the feature ids, of existing content.
 	int i0 = 0;
-	float x0 = ps[0].x;
-	for (int i = 1; i < n; ++i)
+	for (int i = 1; i < m; ++i)
 	{
-		float x = ps[i].x;
-		if (x > x0 || (x == x0 && ps[i].y < ps[i0].y))
+		if (hull[i].x > hull[i0].x || (hull[i].x == hull[i0].x && hull[i].y < hull[i0].y))
 		{
 			i0 = i;
-			x0 = x;
 		}
 	}
 
-	int hull[cb2_maxPolygonVertices];
-	int m = 0;
-	int ih = i0;
-
-	for (;;)
+	for (int i = 0; i < m; ++i)
 	{
-		hull[m] = ih;
-
-		int ie = 0;
-		for (int j = 1; j < n; ++j)
-		{
-			if (ie == ih)
-			{
-				ie = j;
-				continue;
-			}
+		ps[i] = hull[i0 + i < m ? i0 + i : i0 + i - m];
+	}
 
-			ci::Vec2f r = ps[ie] - ps[hull[m]];
-			ci::Vec2f v = ps[j] - ps[hull[m]];
-			float c = cb2Cross(r, v);
-			if (c < 0.0f)
-			{
-				ie = j;
-			}
+	SetConvex(ps, m);
+}
 
-			// Collinearity check
-			if (c == 0.0f && v.lengthSquared() > r.lengthSquared())
-			{
-				ie = j;
-			}
-		}
+void cb2PolygonShape::SetConvex(const ci::Vec2f* vertices, int count)
+{
+	cb2Assert(3 <= count && count <= cb2_maxPolygonVertices);
 
-		++m;
-		ih = ie;
-
-		if (ie == i0)
-		{
-			break;
-		}
-	}
-	
-	m_count = m;
+	m_count = count;
 
 	// Copy vertices.
-	for (int i = 0; i < m; ++i)
+	for (int i = 0; i < count; ++i)
 	{
-		m_vertices[i] = ps[hull[i]];
+		m_vertices[i] = vertices[i];
 	}
 
 	// Compute normals. Ensure the edges have non-zero length.
-	for (int i = 0; i < m; ++i)
+	for (int i = 0; i < count; ++i)
 	{
 		int i1 = i;
-		int i2 = i + 1 < m ? i + 1 : 0;
+		int i2 = i + 1 < count ? i + 1 : 0;
 		ci::Vec2f edge = m_vertices[i2] - m_vertices[i1];
 		cb2Assert(edge.lengthSquared() > cb2_epsilon * cb2_epsilon);
 		m_normals[i] = cb2Cross(edge, 1.0f);
@@ -237,7 +264,24 @@ void cb2PolygonShape::set(const ci::Vec2f* vertices, int count)
 	}
 
 	// Compute the polygon centroid.
-	m_centroid = ComputeCentroid(m_vertices, m);
+	m_centroid = ComputeCentroid(m_vertices, count);
+}
+
+void cb2SetPolygons(cb2PolygonShape* polygons, int polygonCount, const ci::Vec2f* points, const int* counts, bool convex)
+{
+	const ci::Vec2f* p = points;
+	for (int i = 0; i < polygonCount; ++i)
+	{
+		if (convex)
+		{
+			polygons[i].SetConvex(p, counts[i]);
+		}
+		else
+		{
+			polygons[i].set(p, counts[i]);
+		}
+		p += counts[i];
+	}
 }
 
 bool cb2PolygonShape::TestPoint(const cb2Transform& xf, const ci::Vec2f& p) const
@@ -39,10 +39,15 @@ public:
 	/// Create a convex hull from the given array of local points.
 	/// The count must be in the range [3, cb2_maxPolygonVertices].
 	/// @warning the points may be re-ordered, even if they form a convex polygon
-	/// @warning collinear points are handled but not removed. Collinear points
-	/// may lead to poor stacking behavior.
+	/// @warning collinear points on the hull are removed.
 	void set(const ci::Vec2f* points, int count);
 
+	/// Copy a polygon that is already convex, skipping the welding and the hull.
+	/// The count must be in the range [3, cb2_maxPolygonVertices].
+	/// @warning the points must be in counter-clockwise order with no collinear
+	/// or coincident points. Only the normals check this, in debug builds.
+	void SetConvex(const ci::Vec2f* points, int count);
+
 	/// Build vertices to represent an axis-aligned box centered on the local origin.
 	/// @param hx the half-width.
 	/// @param hy the half-height.
@@ -84,6 +89,11 @@ public:
 	int m_count;
 };
 
+/// Build many polygons at once, such as the pieces of a fracture. Polygon i takes the
+/// next counts[i] points. With convex set the points of each polygon must be as
+/// SetConvex requires, otherwise their hulls are computed.
+void cb2SetPolygons(cb2PolygonShape* polygons, int polygonCount, const ci::Vec2f* points, const int* counts, bool convex);
+
 inline cb2PolygonShape::cb2PolygonShape()
 {
 	m_type = e_polygon;
@@ -49,7 +49,10 @@ public:
 		e_edge = 1,
 		e_polygon = 2,
 		e_chain = 3,
-		e_typeCount = 4
+		e_capsule = 4,
+		e_heightfield = 5,
+		e_compound = 6,
+		e_typeCount = 7
 	};
 
 	virtual ~cb2Shape() {}
@@ -17,6 +17,11 @@
 */
 
 #include <CinderBox2D/Collision/cb2BroadPhase.h>
+#include <CinderBox2D/Common/cb2ThreadPool.h>
+
+// Below this many moved proxies the pairs are found on the calling thread.
+const int cb2_minParallelMoveCount = 64;
+const int cb2_findPairsGrainSize = 16;
 
 cb2BroadPhase::cb2BroadPhase()
 {
@@ -24,24 +29,146 @@ cb2BroadPhase::cb2BroadPhase()
 
 	m_pairCapacity = 16;
 	m_pairCount = 0;
-	m_pairBuffer = (cb2Pair*)cb2Alloc(m_pairCapacity * sizeof(cb2Pair));
+	m_pairBuffer = (cb2Pair*)cb2Alloc(m_pairCapacity * sizeof(cb2Pair), cb2_defaultAlignment, cb2_memoryBroadPhase);
 
 	m_moveCapacity = 16;
 	m_moveCount = 0;
-	m_moveBuffer = (int*)cb2Alloc(m_moveCapacity * sizeof(int));
+	m_moveBuffer = (int*)cb2Alloc(m_moveCapacity * sizeof(int), cb2_defaultAlignment, cb2_memoryBroadPhase);
+	m_queryCount = 0;
+
+	m_moveIndexCapacity = 0;
+	m_moveIndices = NULL;
+	m_staticMoveIndexCapacity = 0;
+	m_staticMoveIndices = NULL;
+
+	m_keyCapacity = 0;
+	m_keys = NULL;
+	m_staticKeyCapacity = 0;
+	m_staticKeys = NULL;
+	m_defaultKey.owner = -1;
+	m_defaultKey.categoryBits = 0xFFFF;
+	m_defaultKey.maskBits = 0xFFFF;
+	m_defaultKey.groupIndex = 0;
+	m_defaultKey.layer = 0;
+	m_defaultKey.flags = 0;
+	m_filterRejection = false;
+	m_sensorRejection = false;
+	for (int i = 0; i < cb2_maxLayers; ++i)
+	{
+		m_layerMasks[i] = 0xFFFFFFFF;
+	}
+	m_layerFiltering = false;
+
+	m_type = cb2_dynamicTreeBroadPhase;
+	m_staticTreeEnabled = false;
+	m_optimizeLeafCount = 0;
+
+	m_threadPool = NULL;
+	m_threadPairs = NULL;
+	m_threadPairCount = 0;
 }
 
 cb2BroadPhase::~cb2BroadPhase()
 {
-	cb2Free(m_moveBuffer);
-	cb2Free(m_pairBuffer);
+	SetThreadPool(NULL);
+	cb2Free(m_staticKeys, cb2_memoryBroadPhase);
+	cb2Free(m_keys, cb2_memoryBroadPhase);
+	cb2Free(m_staticMoveIndices, cb2_memoryBroadPhase);
+	cb2Free(m_moveIndices, cb2_memoryBroadPhase);
+	cb2Free(m_moveBuffer, cb2_memoryBroadPhase);
+	cb2Free(m_pairBuffer, cb2_memoryBroadPhase);
 }
 
-int cb2BroadPhase::CreateProxy(const cb2AABB& aabb, void* userData)
+void cb2BroadPhase::SetThreadPool(cb2ThreadPool* threadPool)
 {
-	int proxyId = m_tree.CreateProxy(aabb, userData);
+	for (int i = 0; i < m_threadPairCount; ++i)
+	{
+		cb2Free(m_threadPairs[i].pairs, cb2_memoryBroadPhase);
+	}
+	cb2Free(m_threadPairs, cb2_memoryBroadPhase);
+	m_threadPairs = NULL;
+	m_threadPairCount = 0;
+
+	m_threadPool = threadPool;
+	if (m_threadPool == NULL)
+	{
+		return;
+	}
+
+	m_threadPairCount = m_threadPool->GetThreadCount();
+	m_threadPairs = (cb2ThreadPairBuffer*)cb2Alloc(m_threadPairCount * sizeof(cb2ThreadPairBuffer), cb2_defaultAlignment, cb2_memoryBroadPhase);
+	for (int i = 0; i < m_threadPairCount; ++i)
+	{
+		m_threadPairs[i].capacity = 16;
+		m_threadPairs[i].count = 0;
+		m_threadPairs[i].pairs = (cb2Pair*)cb2Alloc(m_threadPairs[i].capacity * sizeof(cb2Pair), cb2_defaultAlignment, cb2_memoryBroadPhase);
+	}
+}
+
+void cb2BroadPhase::GetMemory(cb2BroadPhaseMemory* memory) const
+{
+	memory->treeNodeCount = m_tree.GetNodeCount();
+	memory->treeNodeCapacity = m_tree.GetNodeCapacity();
+	memory->staticNodeCount = m_staticTree.GetNodeCount();
+	memory->staticNodeCapacity = m_staticTree.GetNodeCapacity();
+	memory->moveCapacity = m_moveCapacity;
+	memory->pairCapacity = m_pairCapacity;
+
+	memory->threadPairCapacity = 0;
+	for (int i = 0; i < m_threadPairCount; ++i)
+	{
+		memory->threadPairCapacity += m_threadPairs[i].capacity;
+	}
+
+	// The hash and the sweep and prune keep their arrays whatever the type.
+	memory->bytes = m_tree.GetMemory() + m_staticTree.GetMemory() + m_hash.GetMemory() + m_sweep.GetMemory();
+	memory->bytes += m_moveCapacity * (int)sizeof(int);
+	memory->bytes += (m_pairCapacity + memory->threadPairCapacity) * (int)sizeof(cb2Pair);
+	memory->bytes += m_threadPairCount * (int)sizeof(cb2ThreadPairBuffer);
+	memory->bytes += (m_moveIndexCapacity + m_staticMoveIndexCapacity) * (int)sizeof(int);
+	memory->bytes += (m_keyCapacity + m_staticKeyCapacity) * (int)sizeof(cb2ProxyKey);
+}
+
+void cb2BroadPhase::SetType(cb2BroadPhaseType type, float cellSize)
+{
+	cb2Assert(m_proxyCount == 0);
+	m_type = type;
+	m_hash.SetCellSize(cellSize);
+}
+
+int cb2BroadPhase::CreateProxy(const cb2AABB& aabb, void* userData, bool isStatic, int layer)
+{
+	cb2Assert(0 <= layer && layer < cb2_maxLayers);
+
+	int proxyId;
+	if (isStatic && m_staticTreeEnabled)
+	{
+		proxyId = m_staticTree.CreateProxy(aabb, userData) | e_staticProxy;
+	}
+	else if (m_type == cb2_spatialHashBroadPhase)
+	{
+		proxyId = m_hash.CreateProxy(aabb, userData);
+		cb2Assert(IsStaticProxy(proxyId) == false);
+	}
+	else if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		proxyId = m_sweep.CreateProxy(aabb, userData);
+		cb2Assert(IsStaticProxy(proxyId) == false);
+	}
+	else
+	{
+		proxyId = m_tree.CreateProxy(aabb, userData, 1u << layer);
+		cb2Assert(IsStaticProxy(proxyId) == false);
+	}
+	cb2ProxyKey* key = GetKeySlot(proxyId);
+	*key = m_defaultKey;
+	key->layer = (unsigned char)layer;
+	if (isStatic)
+	{
+		key->flags = cb2ProxyKey::e_fixedFlag | cb2ProxyKey::e_staticFlag;
+	}
 	++m_proxyCount;
-	BufferMove(proxyId);
+	BufferProxy(proxyId);
 	return proxyId;
 }
 
@@ -49,50 +176,385 @@ void cb2BroadPhase::DestroyProxy(int proxyId)
 {
 	UnBufferMove(proxyId);
 	--m_proxyCount;
-	m_tree.DestroyProxy(proxyId);
+	if (IsStaticProxy(proxyId))
+	{
+		m_staticTree.DestroyProxy(proxyId & ~e_staticProxy);
+	}
+	else if (m_type == cb2_spatialHashBroadPhase)
+	{
+		m_hash.DestroyProxy(proxyId);
+	}
+	else if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		m_sweep.DestroyProxy(proxyId);
+	}
+	else
+	{
+		m_tree.DestroyProxy(proxyId);
+	}
 }
 
 void cb2BroadPhase::MoveProxy(int proxyId, const cb2AABB& aabb, const ci::Vec2f& displacement)
 {
-	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	bool buffer;
+	if (IsStaticProxy(proxyId))
+	{
+		buffer = m_staticTree.MoveProxy(proxyId & ~e_staticProxy, aabb);
+	}
+	else if (m_type == cb2_spatialHashBroadPhase)
+	{
+		buffer = m_hash.MoveProxy(proxyId, aabb, displacement);
+	}
+	else if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		buffer = m_sweep.MoveProxy(proxyId, aabb, displacement);
+	}
+	else
+	{
+		buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	}
+
 	if (buffer)
 	{
-		BufferMove(proxyId);
+		BufferProxy(proxyId);
+	}
+}
+
+void cb2BroadPhase::MoveProxies(const cb2ProxyMove* moves, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		const cb2ProxyMove* move = moves + i;
+		if (move->move)
+		{
+			if (IsStaticProxy(move->proxyId) || m_type != cb2_dynamicTreeBroadPhase)
+			{
+				MoveProxy(move->proxyId, move->aabb, move->displacement);
+			}
+			else if (m_tree.RefitProxy(move->proxyId, move->aabb, move->displacement))
+			{
+				BufferProxy(move->proxyId);
+			}
+		}
+
+		if (move->touch)
+		{
+			BufferProxy(move->proxyId);
+		}
 	}
 }
 
 void cb2BroadPhase::TouchProxy(int proxyId)
 {
-	BufferMove(proxyId);
+	BufferProxy(proxyId);
+}
+
+void cb2BroadPhase::SetProxyLayer(int proxyId, int layer)
+{
+	cb2Assert(0 <= layer && layer < cb2_maxLayers);
+	GetKeySlot(proxyId)->layer = (unsigned char)layer;
+	if (IsStaticProxy(proxyId) == false && m_type == cb2_dynamicTreeBroadPhase)
+	{
+		m_tree.SetLayers(proxyId, 1u << layer);
+	}
+}
+
+void cb2BroadPhase::SetProxyKey(int proxyId, const cb2ProxyKey& key)
+{
+	cb2Assert(key.layer < cb2_maxLayers);
+	cb2ProxyKey* slot = GetKeySlot(proxyId);
+	int oldLayer = slot->layer;
+	*slot = key;
+	if (key.layer != oldLayer && IsStaticProxy(proxyId) == false && m_type == cb2_dynamicTreeBroadPhase)
+	{
+		m_tree.SetLayers(proxyId, 1u << key.layer);
+	}
+}
+
+void cb2BroadPhase::SetLayerCollision(int layerA, int layerB, bool flag)
+{
+	cb2Assert(0 <= layerA && layerA < cb2_maxLayers);
+	cb2Assert(0 <= layerB && layerB < cb2_maxLayers);
+	if (flag)
+	{
+		m_layerMasks[layerA] |= 1u << layerB;
+		m_layerMasks[layerB] |= 1u << layerA;
+	}
+	else
+	{
+		m_layerMasks[layerA] &= ~(1u << layerB);
+		m_layerMasks[layerB] &= ~(1u << layerA);
+	}
+
+	m_layerFiltering = false;
+	for (int i = 0; i < cb2_maxLayers; ++i)
+	{
+		if (m_layerMasks[i] != 0xFFFFFFFF)
+		{
+			m_layerFiltering = true;
+		}
+	}
+}
+
+void cb2BroadPhase::SetFatAABB(int proxyId, const cb2AABB& fatAABB)
+{
+	if (IsStaticProxy(proxyId))
+	{
+		m_staticTree.SetFatAABB(proxyId & ~e_staticProxy, fatAABB);
+	}
+	else if (m_type == cb2_spatialHashBroadPhase)
+	{
+		m_hash.SetFatAABB(proxyId, fatAABB);
+	}
+	else if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		m_sweep.SetFatAABB(proxyId, fatAABB);
+	}
+	else
+	{
+		m_tree.SetFatAABB(proxyId, fatAABB);
+	}
+}
+
+void cb2BroadPhase::SetMoveBuffer(const int* proxyIds, int count)
+{
+	ResetMoveBuffer();
+	for (int i = 0; i < count; ++i)
+	{
+		if (proxyIds[i] != e_nullProxy)
+		{
+			BufferMove(proxyIds[i]);
+		}
+	}
+}
+
+void cb2BroadPhase::CopyTrees(const cb2BroadPhase& broadPhase)
+{
+	m_type = broadPhase.m_type;
+	m_tree.Copy(broadPhase.m_tree);
+	m_hash.Copy(broadPhase.m_hash);
+	m_sweep.Copy(broadPhase.m_sweep);
+	m_staticTree.Copy(broadPhase.m_staticTree);
+	m_proxyCount = broadPhase.m_proxyCount;
+}
+
+void cb2BroadPhase::Copy(const cb2BroadPhase& broadPhase)
+{
+	CopyTrees(broadPhase);
+	m_staticTreeEnabled = broadPhase.m_staticTreeEnabled;
+	m_optimizeLeafCount = broadPhase.m_optimizeLeafCount;
+
+	memcpy(m_layerMasks, broadPhase.m_layerMasks, sizeof(m_layerMasks));
+	m_layerFiltering = broadPhase.m_layerFiltering;
+	m_filterRejection = broadPhase.m_filterRejection;
+	m_sensorRejection = broadPhase.m_sensorRejection;
+	if (broadPhase.m_keyCapacity > 0)
+	{
+		GetKeySlot(broadPhase.m_keyCapacity - 1);
+		memcpy(m_keys, broadPhase.m_keys, broadPhase.m_keyCapacity * sizeof(cb2ProxyKey));
+	}
+	if (broadPhase.m_staticKeyCapacity > 0)
+	{
+		GetKeySlot((broadPhase.m_staticKeyCapacity - 1) | e_staticProxy);
+		memcpy(m_staticKeys, broadPhase.m_staticKeys, broadPhase.m_staticKeyCapacity * sizeof(cb2ProxyKey));
+	}
+
+	SetMoveBuffer(broadPhase.m_moveBuffer, broadPhase.m_moveCount);
+}
+
+void cb2BroadPhase::BeginBulkCreate()
+{
+	m_tree.BeginBulkInsert();
+}
+
+void cb2BroadPhase::EndBulkCreate()
+{
+	m_tree.EndBulkInsert();
+}
+
+int* cb2BroadPhase::GetMoveIndex(int proxyId)
+{
+	bool isStatic = IsStaticProxy(proxyId);
+	int index = isStatic ? proxyId & ~e_staticProxy : proxyId;
+	int** indices = isStatic ? &m_staticMoveIndices : &m_moveIndices;
+	int* capacity = isStatic ? &m_staticMoveIndexCapacity : &m_moveIndexCapacity;
+
+	if (index >= *capacity)
+	{
+		int oldCapacity = *capacity;
+		int* oldIndices = *indices;
+		*capacity = cb2Max(2 * oldCapacity, index + 1);
+		*indices = (int*)cb2Alloc(*capacity * sizeof(int), cb2_defaultAlignment, cb2_memoryBroadPhase);
+		if (oldCapacity > 0)
+		{
+			memcpy(*indices, oldIndices, oldCapacity * sizeof(int));
+		}
+		cb2Free(oldIndices, cb2_memoryBroadPhase);
+
+		for (int i = oldCapacity; i < *capacity; ++i)
+		{
+			(*indices)[i] = e_nullProxy;
+		}
+	}
+
+	return *indices + index;
+}
+
+cb2ProxyKey* cb2BroadPhase::GetKeySlot(int proxyId)
+{
+	bool isStatic = IsStaticProxy(proxyId);
+	int index = isStatic ? proxyId & ~e_staticProxy : proxyId;
+	cb2ProxyKey** keys = isStatic ? &m_staticKeys : &m_keys;
+	int* capacity = isStatic ? &m_staticKeyCapacity : &m_keyCapacity;
+
+	if (index >= *capacity)
+	{
+		int oldCapacity = *capacity;
+		cb2ProxyKey* oldKeys = *keys;
+		*capacity = cb2Max(2 * oldCapacity, index + 1);
+		*keys = (cb2ProxyKey*)cb2Alloc(*capacity * sizeof(cb2ProxyKey), cb2_defaultAlignment, cb2_memoryBroadPhase);
+		if (oldCapacity > 0)
+		{
+			memcpy(*keys, oldKeys, oldCapacity * sizeof(cb2ProxyKey));
+		}
+		cb2Free(oldKeys, cb2_memoryBroadPhase);
+		for (int i = oldCapacity; i < *capacity; ++i)
+		{
+			(*keys)[i] = m_defaultKey;
+		}
+	}
+
+	return *keys + index;
+}
+
+void cb2BroadPhase::Reserve(int proxyCount, int pairCount)
+{
+	if (m_type == cb2_dynamicTreeBroadPhase)
+	{
+		m_tree.Reserve(proxyCount);
+	}
+
+	if (proxyCount > m_moveIndexCapacity)
+	{
+		// Reserve the slots of the highest proxy id.
+		GetMoveIndex(proxyCount - 1);
+	}
+
+	if (proxyCount > m_keyCapacity)
+	{
+		GetKeySlot(proxyCount - 1);
+	}
+
+	if (proxyCount > m_moveCapacity)
+	{
+		int* oldBuffer = m_moveBuffer;
+		m_moveCapacity = proxyCount;
+		m_moveBuffer = (int*)cb2Alloc(m_moveCapacity * sizeof(int), cb2_defaultAlignment, cb2_memoryBroadPhase);
+		memcpy(m_moveBuffer, oldBuffer, m_moveCount * sizeof(int));
+		cb2Free(oldBuffer, cb2_memoryBroadPhase);
+	}
+
+	if (pairCount > m_pairCapacity)
+	{
+		cb2Pair* oldBuffer = m_pairBuffer;
+		m_pairCapacity = pairCount;
+		m_pairBuffer = (cb2Pair*)cb2Alloc(m_pairCapacity * sizeof(cb2Pair), cb2_defaultAlignment, cb2_memoryBroadPhase);
+		memcpy(m_pairBuffer, oldBuffer, m_pairCount * sizeof(cb2Pair));
+		cb2Free(oldBuffer, cb2_memoryBroadPhase);
+	}
+
+	// Each thread finds its share of the pairs.
+	for (int i = 0; i < m_threadPairCount; ++i)
+	{
+		cb2ThreadPairBuffer* buffer = m_threadPairs + i;
+		int capacity = pairCount / m_threadPairCount + 1;
+		if (capacity > buffer->capacity)
+		{
+			cb2Pair* oldBuffer = buffer->pairs;
+			buffer->capacity = capacity;
+			buffer->pairs = (cb2Pair*)cb2Alloc(buffer->capacity * sizeof(cb2Pair), cb2_defaultAlignment, cb2_memoryBroadPhase);
+			memcpy(buffer->pairs, oldBuffer, buffer->count * sizeof(cb2Pair));
+			cb2Free(oldBuffer, cb2_memoryBroadPhase);
+		}
+	}
 }
 
 void cb2BroadPhase::BufferMove(int proxyId)
 {
+	// A proxy is buffered at most once per update.
+	int* moveIndex = GetMoveIndex(proxyId);
+	if (*moveIndex != e_nullProxy)
+	{
+		return;
+	}
+
 	if (m_moveCount == m_moveCapacity)
 	{
 		int* oldBuffer = m_moveBuffer;
 		m_moveCapacity *= 2;
-		m_moveBuffer = (int*)cb2Alloc(m_moveCapacity * sizeof(int));
+		m_moveBuffer = (int*)cb2Alloc(m_moveCapacity * sizeof(int), cb2_defaultAlignment, cb2_memoryBroadPhase);
 		memcpy(m_moveBuffer, oldBuffer, m_moveCount * sizeof(int));
-		cb2Free(oldBuffer);
+		cb2Free(oldBuffer, cb2_memoryBroadPhase);
 	}
 
+	*moveIndex = m_moveCount;
 	m_moveBuffer[m_moveCount] = proxyId;
 	++m_moveCount;
 }
 
+// Buffers the proxies a static proxy overlaps.
+class cb2NeighborQuery
+{
+public:
+	bool QueryCallback(int proxyId)
+	{
+		if ((broadPhase->GetProxyKey(proxyId).flags & cb2ProxyKey::e_staticFlag) == 0)
+		{
+			broadPhase->BufferMove(proxyId);
+		}
+		return true;
+	}
+
+	cb2BroadPhase* broadPhase;
+};
+
+void cb2BroadPhase::BufferProxy(int proxyId)
+{
+	if ((GetProxyKey(proxyId).flags & cb2ProxyKey::e_staticFlag) == 0)
+	{
+		BufferMove(proxyId);
+		return;
+	}
+
+	// Proxies still pending in a bulk insert are buffered already.
+	cb2NeighborQuery query;
+	query.broadPhase = this;
+	QueryProxies(&query, GetFatAABB(proxyId), GetQueryLayerMask(proxyId));
+}
+
 void cb2BroadPhase::UnBufferMove(int proxyId)
+{
+	int* moveIndex = GetMoveIndex(proxyId);
+	if (*moveIndex != e_nullProxy)
+	{
+		m_moveBuffer[*moveIndex] = e_nullProxy;
+		*moveIndex = e_nullProxy;
+	}
+}
+
+void cb2BroadPhase::ResetMoveBuffer()
 {
 	for (int i = 0; i < m_moveCount; ++i)
 	{
-		if (m_moveBuffer[i] == proxyId)
+		if (m_moveBuffer[i] != e_nullProxy)
 		{
-			m_moveBuffer[i] = e_nullProxy;
+			*GetMoveIndex(m_moveBuffer[i]) = e_nullProxy;
 		}
 	}
+	m_moveCount = 0;
 }
 
-// This is called from cb2DynamicTree::Query when we are gathering pairs.
+// This is called from cb2DynamicTree::Query and cb2SpatialHash::Query when we are gathering pairs.
 bool cb2BroadPhase::QueryCallback(int proxyId)
 {
 	// A proxy cannot form a pair with itself.
@@ -101,19 +563,237 @@ bool cb2BroadPhase::QueryCallback(int proxyId)
 		return true;
 	}
 
+	PairCallback(proxyId, m_queryProxyId);
+	return true;
+}
+
+// This is called from cb2SweepAndPrune::FindPairs and QueryCallback.
+void cb2BroadPhase::PairCallback(int proxyIdA, int proxyIdB)
+{
+	if (ShouldPair(proxyIdA, proxyIdB) == false)
+	{
+		return;
+	}
+
 	// Grow the pair buffer as needed.
 	if (m_pairCount == m_pairCapacity)
 	{
 		cb2Pair* oldBuffer = m_pairBuffer;
 		m_pairCapacity *= 2;
-		m_pairBuffer = (cb2Pair*)cb2Alloc(m_pairCapacity * sizeof(cb2Pair));
+		m_pairBuffer = (cb2Pair*)cb2Alloc(m_pairCapacity * sizeof(cb2Pair), cb2_defaultAlignment, cb2_memoryBroadPhase);
 		memcpy(m_pairBuffer, oldBuffer, m_pairCount * sizeof(cb2Pair));
-		cb2Free(oldBuffer);
+		cb2Free(oldBuffer, cb2_memoryBroadPhase);
 	}
 
-	m_pairBuffer[m_pairCount].proxyIdA = cb2Min(proxyId, m_queryProxyId);
-	m_pairBuffer[m_pairCount].proxyIdB = cb2Max(proxyId, m_queryProxyId);
+	m_pairBuffer[m_pairCount].proxyIdA = cb2Min(proxyIdA, proxyIdB);
+	m_pairBuffer[m_pairCount].proxyIdB = cb2Max(proxyIdA, proxyIdB);
 	++m_pairCount;
+}
 
-	return true;
+// Gathers the pairs of one proxy into a thread's pair buffer.
+class cb2PairQuery
+{
+public:
+	bool QueryCallback(int proxyId)
+	{
+		// A proxy cannot form a pair with itself.
+		if (proxyId == queryProxyId)
+		{
+			return true;
+		}
+
+		if (broadPhase->ShouldPair(proxyId, queryProxyId) == false)
+		{
+			return true;
+		}
+
+		// Grow the pair buffer as needed.
+		if (buffer->count == buffer->capacity)
+		{
+			cb2Pair* oldBuffer = buffer->pairs;
+			buffer->capacity *= 2;
+			buffer->pairs = (cb2Pair*)cb2Alloc(buffer->capacity * sizeof(cb2Pair), cb2_defaultAlignment, cb2_memoryBroadPhase);
+			memcpy(buffer->pairs, oldBuffer, buffer->count * sizeof(cb2Pair));
+			cb2Free(oldBuffer, cb2_memoryBroadPhase);
+		}
+
+		buffer->pairs[buffer->count].proxyIdA = cb2Min(proxyId, queryProxyId);
+		buffer->pairs[buffer->count].proxyIdB = cb2Max(proxyId, queryProxyId);
+		++buffer->count;
+
+		return true;
+	}
+
+	const cb2BroadPhase* broadPhase;
+	cb2ThreadPairBuffer* buffer;
+	int queryProxyId;
+};
+
+class cb2FindPairsTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		broadPhase->FindPairs(begin, end, broadPhase->m_threadPairs + threadIndex);
+	}
+
+	const cb2BroadPhase* broadPhase;
+};
+
+void cb2BroadPhase::FindPairs()
+{
+	// Reset pair buffer
+	m_pairCount = 0;
+
+	// Pending proxies are built into the trees before they are shared.
+	m_tree.EndBulkInsert();
+	m_staticTree.Rebuild();
+
+	// Query in proxy order so neighboring queries touch neighboring nodes. The buffer
+	// slots of the proxies are stale from here on, until ResetMoveBuffer.
+	std::sort(m_moveBuffer, m_moveBuffer + m_moveCount);
+
+	if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		FindSweepPairs();
+		return;
+	}
+
+	if (m_threadPool && m_moveCount >= cb2_minParallelMoveCount)
+	{
+		for (int i = 0; i < m_threadPairCount; ++i)
+		{
+			m_threadPairs[i].count = 0;
+		}
+
+		for (int i = 0; i < m_moveCount; ++i)
+		{
+			if (m_moveBuffer[i] != e_nullProxy)
+			{
+				m_queryCount += IsStaticProxy(m_moveBuffer[i]) == false && m_staticTree.GetProxyCount() > 0 ? 2 : 1;
+			}
+		}
+
+		cb2FindPairsTask task;
+		task.broadPhase = this;
+		m_threadPool->ParallelFor(&task, m_moveCount, cb2_findPairsGrainSize);
+
+		// Merge the thread buffers. The order is restored by the sort in UpdatePairs.
+		int pairCount = 0;
+		for (int i = 0; i < m_threadPairCount; ++i)
+		{
+			pairCount += m_threadPairs[i].count;
+		}
+
+		if (pairCount > m_pairCapacity)
+		{
+			cb2Free(m_pairBuffer, cb2_memoryBroadPhase);
+			while (m_pairCapacity < pairCount)
+			{
+				m_pairCapacity *= 2;
+			}
+			m_pairBuffer = (cb2Pair*)cb2Alloc(m_pairCapacity * sizeof(cb2Pair), cb2_defaultAlignment, cb2_memoryBroadPhase);
+		}
+
+		for (int i = 0; i < m_threadPairCount; ++i)
+		{
+			const cb2ThreadPairBuffer* buffer = m_threadPairs + i;
+			memcpy(m_pairBuffer + m_pairCount, buffer->pairs, buffer->count * sizeof(cb2Pair));
+			m_pairCount += buffer->count;
+		}
+
+		return;
+	}
+
+	// Perform tree queries for all moving proxies.
+	for (int i = 0; i < m_moveCount; ++i)
+	{
+		m_queryProxyId = m_moveBuffer[i];
+		if (m_queryProxyId == e_nullProxy)
+		{
+			continue;
+		}
+
+		// We have to query the tree with the fat AABB so that
+		// we don't fail to create a pair that may touch later.
+		const cb2AABB& fatAABB = GetFatAABB(m_queryProxyId);
+
+		// Query tree, create pairs and add them pair buffer. Subtrees holding
+		// no layer this proxy collides with are skipped.
+		QueryProxies(this, fatAABB, GetQueryLayerMask(m_queryProxyId));
+		++m_queryCount;
+
+		// Static proxies do not pair with each other.
+		if (IsStaticProxy(m_queryProxyId) == false && m_staticTree.GetProxyCount() > 0)
+		{
+			++m_queryCount;
+			cb2BroadPhaseCallback<cb2BroadPhase> wrapper;
+			wrapper.callback = this;
+			wrapper.proxyFlag = e_staticProxy;
+			m_staticTree.Query(&wrapper, fatAABB);
+		}
+	}
+}
+
+void cb2BroadPhase::FindPairs(int begin, int end, cb2ThreadPairBuffer* buffer) const
+{
+	cb2PairQuery query;
+	query.broadPhase = this;
+	query.buffer = buffer;
+
+	for (int i = begin; i < end; ++i)
+	{
+		query.queryProxyId = m_moveBuffer[i];
+		if (query.queryProxyId == e_nullProxy)
+		{
+			continue;
+		}
+
+		const cb2AABB& fatAABB = GetFatAABB(query.queryProxyId);
+		QueryProxies(&query, fatAABB, GetQueryLayerMask(query.queryProxyId));
+
+		if (IsStaticProxy(query.queryProxyId) == false && m_staticTree.GetProxyCount() > 0)
+		{
+			cb2BroadPhaseCallback<cb2PairQuery> wrapper;
+			wrapper.callback = &query;
+			wrapper.proxyFlag = e_staticProxy;
+			m_staticTree.Query(&wrapper, fatAABB);
+		}
+	}
+}
+
+void cb2BroadPhase::FindSweepPairs()
+{
+	// One sweep finds the pairs of all moved proxies that are not static.
+	for (int i = 0; i < m_moveCount; ++i)
+	{
+		int proxyId = m_moveBuffer[i];
+		if (proxyId != e_nullProxy && IsStaticProxy(proxyId) == false)
+		{
+			m_sweep.MarkMoved(proxyId);
+		}
+	}
+
+	m_sweep.FindPairs(this);
+
+	// Pairs with the static tree are found by queries of the moved proxies.
+	if (m_staticTree.GetProxyCount() == 0)
+	{
+		return;
+	}
+
+	for (int i = 0; i < m_moveCount; ++i)
+	{
+		m_queryProxyId = m_moveBuffer[i];
+		if (m_queryProxyId == e_nullProxy)
+		{
+			continue;
+		}
+
+		++m_queryCount;
+		cb2BroadPhaseCallback<cb2BroadPhase> wrapper;
+		wrapper.callback = this;
+		wrapper.proxyFlag = e_staticProxy;
+		m_staticTree.Query(&wrapper, GetFatAABB(m_queryProxyId));
+	}
 }
@@ -22,8 +22,32 @@
 #include <CinderBox2D/Common/cb2Settings.h>
 #include <CinderBox2D/Collision/cb2Collision.h>
 #include <CinderBox2D/Collision/cb2DynamicTree.h>
+#include <CinderBox2D/Collision/cb2SpatialHash.h>
+#include <CinderBox2D/Collision/cb2SweepAndPrune.h>
+#include <CinderBox2D/Collision/cb2StaticTree.h>
 #include <algorithm>
 
+class cb2ThreadPool;
+
+/// What the broad-phase keeps of each proxy to reject pairs without reading the user
+/// data: the owner, the collision filter, the layer and flags. See cb2BroadPhase::SetProxyKey.
+struct cb2ProxyKey
+{
+	enum
+	{
+		e_fixedFlag		= 0x01,		///< two proxies with fixed owners do not pair
+		e_sensorFlag	= 0x02,		///< dropped while sensors are rejected
+		e_staticFlag	= 0x04		///< never queries, the proxies it overlaps query instead
+	};
+
+	int owner;						///< proxies of the same owner do not pair, -1 for none
+	unsigned short categoryBits;
+	unsigned short maskBits;
+	short groupIndex;
+	unsigned char layer;
+	unsigned char flags;
+};
+
 struct cb2Pair
 {
 	int proxyIdA;
@@ -31,6 +55,120 @@ struct cb2Pair
 	int next;
 };
 
+/// Forwards tree callbacks to a client, tagging the proxy ids of one tree and
+/// remembering where a ray cast was clipped so the next tree can continue from it.
+template <typename T>
+struct cb2BroadPhaseCallback
+{
+	bool QueryCallback(int proxyId)
+	{
+		proceed = callback->QueryCallback(proxyId | proxyFlag);
+		return proceed;
+	}
+
+	float RayCastCallback(const cb2RayCastInput& input, int proxyId)
+	{
+		float value = callback->RayCastCallback(input, proxyId | proxyFlag);
+		if (value == 0.0f)
+		{
+			proceed = false;
+		}
+		else if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+		return value;
+	}
+
+	T* callback;
+	int proxyFlag;
+	bool proceed;
+	float maxFraction;
+};
+
+/// Forwards the results of a batched query to a client, tagging the proxy ids of one tree.
+/// The single query form is used for the static tree, one query of the batch at a time.
+template <typename T>
+struct cb2BatchQueryCallback
+{
+	bool QueryCallback(int index, int proxyId)
+	{
+		proceed = callback->QueryCallback(index, proxyId | proxyFlag);
+		return proceed;
+	}
+
+	bool QueryCallback(int proxyId)
+	{
+		return QueryCallback(queryIndex, proxyId);
+	}
+
+	T* callback;
+	int queryIndex;
+	int proxyFlag;
+	bool proceed;
+};
+
+/// Forwards the results of one ray of a batch, remembering where the ray was clipped.
+template <typename T>
+struct cb2BatchRayCastCallback
+{
+	float RayCastCallback(const cb2RayCastInput& input, int proxyId)
+	{
+		float value = callback->RayCastCallback(rayIndex, input, proxyId | proxyFlag);
+		if (value >= 0.0f)
+		{
+			maxFraction = value;
+		}
+		return value;
+	}
+
+	T* callback;
+	int rayIndex;
+	int proxyFlag;
+	float maxFraction;
+};
+
+/// The structure that holds the proxies of non-static fixtures.
+enum cb2BroadPhaseType
+{
+	cb2_dynamicTreeBroadPhase,
+	cb2_spatialHashBroadPhase,
+	cb2_sweepAndPruneBroadPhase
+};
+
+/// Pairs found by one thread during a parallel UpdatePairs.
+struct cb2ThreadPairBuffer
+{
+	cb2Pair* pairs;
+	int capacity;
+	int count;
+};
+
+/// The change a proxy needs after its fixture moved, see cb2BroadPhase::MoveProxies.
+/// Fixtures fill these without touching the broad-phase, so bodies can be prepared
+/// in parallel.
+struct cb2ProxyMove
+{
+	cb2AABB aabb;
+	ci::Vec2f displacement;
+	int proxyId;
+	bool move;		///< the fat AABB no longer covers the proxy
+	bool touch;		///< the children of the proxy moved, so their pairs are found again
+};
+
+/// The memory of a broad-phase, see cb2BroadPhase::GetMemory.
+struct cb2BroadPhaseMemory
+{
+	int treeNodeCount;
+	int treeNodeCapacity;
+	int staticNodeCount;
+	int staticNodeCapacity;
+	int moveCapacity;
+	int pairCapacity;
+	int threadPairCapacity;		///< the pair buffers of the pool threads together
+	int bytes;					///< all arrays of the broad-phase, trees included
+};
+
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
@@ -40,15 +178,18 @@ public:
 
 	enum
 	{
-		e_nullProxy = -1
+		e_nullProxy = -1,
+		e_staticProxy = 0x40000000
 	};
 
 	cb2BroadPhase();
 	~cb2BroadPhase();
 
 	/// Create a proxy with an initial AABB. Pairs are not reported until
-	/// UpdatePairs is called.
-	int CreateProxy(const cb2AABB& aabb, void* userData);
+	/// UpdatePairs is called. Static proxies go to the static tree when it is enabled.
+	/// They never enter the move buffer: the proxies around them find their pairs.
+	/// The layer is in [0, cb2_maxLayers). See SetLayerCollision.
+	int CreateProxy(const cb2AABB& aabb, void* userData, bool isStatic = false, int layer = 0);
 
 	/// Destroy a proxy. It is up to the client to remove any pairs.
 	void DestroyProxy(int proxyId);
@@ -60,12 +201,66 @@ public:
 	/// Call to trigger a re-processing of it's pairs on the next call to UpdatePairs.
 	void TouchProxy(int proxyId);
 
+	/// Move and touch many proxies. In the dynamic tree a proxy whose new fat AABB still
+	/// overlaps its old one keeps its leaf and the boxes above it are refit, which is
+	/// cheaper than reinserting it. The tree then drifts from the shape insertion gives
+	/// it, which SetOptimizeLeafCount repairs over time. Other proxies use MoveProxy.
+	void MoveProxies(const cb2ProxyMove* moves, int count);
+
+	/// Move a proxy to another layer. Call TouchProxy to find the pairs it gains.
+	void SetProxyLayer(int proxyId, int layer);
+	int GetProxyLayer(int proxyId) const;
+
+	/// Set the key of a proxy, layer included. New proxies have no owner, no flags and
+	/// a filter that passes everything. Call TouchProxy to find the pairs it gains.
+	void SetProxyKey(int proxyId, const cb2ProxyKey& key);
+	const cb2ProxyKey& GetProxyKey(int proxyId) const;
+
+	/// Enable/disable the rejection of pairs by the category, mask and group of the keys,
+	/// as cb2ContactFilter does, and of pairs with a sensor key. Both are off by default.
+	void SetFilterRejection(bool flag) { m_filterRejection = flag; }
+	void SetSensorRejection(bool flag) { m_sensorRejection = flag; }
+
+	/// Enable/disable collision between two layers. All layers collide by default.
+	/// Pairs of proxies on layers that do not collide are never reported, and the
+	/// dynamic tree skips subtrees that hold no layer the query proxy collides with.
+	/// Existing pairs are not touched.
+	void SetLayerCollision(int layerA, int layerB, bool flag);
+	bool ShouldCollideLayers(int layerA, int layerB) const;
+
+	/// Give a proxy this fat AABB as is, without buffering a move. This restores
+	/// the proxies of a world snapshot.
+	void SetFatAABB(int proxyId, const cb2AABB& fatAABB);
+
+	/// Get the proxies buffered as moved since the last UpdatePairs. Entries of
+	/// proxies that were destroyed are e_nullProxy.
+	const int* GetMoveBuffer() const { return m_moveBuffer; }
+	int GetMoveCount() const { return m_moveCount; }
+
+	/// Get the number of tree queries made for new pairs since the last reset.
+	int GetQueryCount() const { return m_queryCount; }
+	void ResetQueryCount() { m_queryCount = 0; }
+
+	/// Replace the proxies buffered as moved.
+	void SetMoveBuffer(const int* proxyIds, int count);
+
 	/// Get the fat AABB for a proxy.
 	const cb2AABB& GetFatAABB(int proxyId) const;
 
 	/// Get user data from a proxy. Returns NULL if the id is invalid.
 	void* GetUserData(int proxyId) const;
 
+	/// Set the user data of a proxy.
+	void SetUserData(int proxyId, void* userData);
+
+	/// Make the trees of this broad-phase a copy of another broad-phase. Proxy ids
+	/// are kept, so the copy can answer queries and ray casts on its own.
+	void CopyTrees(const cb2BroadPhase& broadPhase);
+
+	/// Make this broad-phase a copy of another broad-phase, with its options and its
+	/// buffered moves. The user data still refers to the proxies of the other one.
+	void Copy(const cb2BroadPhase& broadPhase);
+
 	/// Test overlap of fat AABBs.
 	bool TestOverlap(int proxyIdA, int proxyIdB) const;
 
@@ -81,6 +276,20 @@ public:
 	template <typename T>
 	void Query(T* callback, const cb2AABB& aabb) const;
 
+	/// Visit the proxies near a point, nearest first in each tree. The callback works as in
+	/// cb2DynamicTree::QueryClosest. The spatial hash and the sweep and prune visit the
+	/// proxies in the square of maxDistance in no order, so give them a finite distance.
+	template <typename T>
+	void QueryClosest(T* callback, const ci::Vec2f& point, float maxDistance) const;
+
+	/// Query many AABBs at once. See cb2DynamicTree::QueryBatch.
+	template <typename T>
+	void QueryBatch(T* callback, const cb2AABB* aabbs, const int* order, int count) const;
+
+	/// Ray-cast many segments at once. See cb2DynamicTree::RayCastBatch.
+	template <typename T>
+	void RayCastBatch(T* callback, const cb2RayCastInput* inputs, const int* order, int count) const;
+
 	/// Ray-cast against the proxies in the tree. This relies on the callback
 	/// to perform a exact ray-cast in the case were the proxy contains a shape.
 	/// The callback also performs the any collision filtering. This has performance
@@ -91,6 +300,18 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const cb2RayCastInput& input) const;
 
+	/// Create many proxies at once. Proxies created until EndBulkCreate are not
+	/// inserted one by one. The tree is then built top-down with the surface area
+	/// heuristic, at the latest by the next UpdatePairs. Queries miss these proxies until then.
+	void BeginBulkCreate();
+	void EndBulkCreate();
+	bool IsBulkCreating() const { return m_tree.IsBulkInserting(); }
+
+	/// Set the number of leaves of the subtree rebuilt by each UpdatePairs. This keeps
+	/// the tree quality from degrading as proxies wander. The default is zero.
+	void SetOptimizeLeafCount(int leafCount) { m_optimizeLeafCount = leafCount; }
+	int GetOptimizeLeafCount() const { return m_optimizeLeafCount; }
+
 	/// Get the height of the embedded tree.
 	int GetTreeHeight() const;
 
@@ -105,28 +326,123 @@ public:
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const ci::Vec2f& newOrigin);
 
+	/// Enable/disable the static tree for proxies created from now on. Static proxies
+	/// are then kept in a four wide tree that is rebuilt whenever they change,
+	/// and they never query for pairs among themselves.
+	void SetStaticTree(bool flag) { m_staticTreeEnabled = flag; }
+	bool GetStaticTree() const { return m_staticTreeEnabled; }
+
+	/// Choose where the proxies that are not in the static tree are kept. The dynamic tree
+	/// suits any content. The spatial hash is faster for many proxies of similar size,
+	/// given a cell size near that size. The sweep and prune is faster when few proxies
+	/// move and the motion is coherent. This can only be changed while there are no proxies.
+	void SetType(cb2BroadPhaseType type, float cellSize = 1.0f);
+	cb2BroadPhaseType GetType() const { return m_type; }
+
+	/// Is this proxy stored in the static tree?
+	static bool IsStaticProxy(int proxyId);
+
+	/// Grow the proxy tree, the move buffer and the pair buffer so they hold
+	/// proxyCount proxies and pairCount new pairs per update without reallocating.
+	void Reserve(int proxyCount, int pairCount);
+
+	/// Set the thread pool used to find new pairs. Each thread queries a slice of
+	/// the move buffer. Pass NULL to find pairs on the calling thread.
+	void SetThreadPool(cb2ThreadPool* threadPool);
+
+	/// Get the capacities of the trees and buffers and the bytes they hold.
+	void GetMemory(cb2BroadPhaseMemory* memory) const;
+
 private:
 
 	friend class cb2DynamicTree;
+	friend class cb2SpatialHash;
+	friend class cb2SweepAndPrune;
+	friend class cb2FindPairsTask;
+	friend class cb2PairQuery;
+	friend class cb2NeighborQuery;
+	template <typename T> friend struct cb2BroadPhaseCallback;
 
 	void BufferMove(int proxyId);
 	void UnBufferMove(int proxyId);
+	void ResetMoveBuffer();
+
+	/// Buffer a proxy that moved or was touched. A static proxy stays out of the move
+	/// buffer and buffers the proxies it overlaps instead, so their queries find its pairs.
+	void BufferProxy(int proxyId);
+
+	/// Get the move buffer slot of a proxy, growing the slot arrays as needed.
+	int* GetMoveIndex(int proxyId);
+
+	/// Get the key slot of a proxy, growing the slot arrays as needed.
+	cb2ProxyKey* GetKeySlot(int proxyId);
+
+	/// Can two proxies pair, going by their keys? This reads no user data.
+	bool ShouldPair(int proxyIdA, int proxyIdB) const;
+
+	/// Get the layers a proxy can pair with, for masked tree queries.
+	unsigned int GetQueryLayerMask(int proxyId) const;
 
 	bool QueryCallback(int proxyId);
+	void PairCallback(int proxyIdA, int proxyIdB);
+
+	/// Query or ray-cast the proxies that are not in the static tree.
+	template <typename T>
+	void QueryProxies(T* callback, const cb2AABB& aabb) const;
+	template <typename T>
+	void QueryProxies(T* callback, const cb2AABB& aabb, unsigned int layerMask) const;
+	template <typename T>
+	void RayCastProxies(T* callback, const cb2RayCastInput& input) const;
 
+	/// Query the tree for all moving proxies and fill the pair buffer.
+	void FindPairs();
+	void FindPairs(int begin, int end, cb2ThreadPairBuffer* buffer) const;
+	void FindSweepPairs();
+
+	cb2BroadPhaseType m_type;
 	cb2DynamicTree m_tree;
+	cb2SpatialHash m_hash;
+	cb2SweepAndPrune m_sweep;
+	cb2StaticTree m_staticTree;
+	bool m_staticTreeEnabled;
+	int m_optimizeLeafCount;
 
 	int m_proxyCount;
 
 	int* m_moveBuffer;
 	int m_moveCapacity;
 	int m_moveCount;
+	int m_queryCount;
+
+	// The move buffer index of each proxy, or e_nullProxy. Static proxies have their own ids.
+	int* m_moveIndices;
+	int m_moveIndexCapacity;
+	int* m_staticMoveIndices;
+	int m_staticMoveIndexCapacity;
+
+	// The key of each proxy, kept like the move buffer indices.
+	cb2ProxyKey* m_keys;
+	int m_keyCapacity;
+	cb2ProxyKey* m_staticKeys;
+	int m_staticKeyCapacity;
+	cb2ProxyKey m_defaultKey;
+	bool m_filterRejection;
+	bool m_sensorRejection;
+
+	// Bit j of mask i is set when layer i collides with layer j. Filtering is
+	// skipped while all layers collide.
+	unsigned int m_layerMasks[cb2_maxLayers];
+	bool m_layerFiltering;
 
 	cb2Pair* m_pairBuffer;
 	int m_pairCapacity;
 	int m_pairCount;
 
 	int m_queryProxyId;
+
+	cb2ThreadPool* m_threadPool;
+	cb2ThreadPairBuffer* m_threadPairs;
+	int m_threadPairCount;
 };
 
 /// This is used to sort pairs.
@@ -145,20 +461,69 @@ inline bool cb2PairLessThan(const cb2Pair& pair1, const cb2Pair& pair2)
 	return false;
 }
 
+inline bool cb2BroadPhase::IsStaticProxy(int proxyId)
+{
+	return proxyId != e_nullProxy && (proxyId & e_staticProxy) != 0;
+}
+
 inline void* cb2BroadPhase::GetUserData(int proxyId) const
 {
+	if (IsStaticProxy(proxyId))
+	{
+		return m_staticTree.GetUserData(proxyId & ~e_staticProxy);
+	}
+	if (m_type == cb2_spatialHashBroadPhase)
+	{
+		return m_hash.GetUserData(proxyId);
+	}
+	if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		return m_sweep.GetUserData(proxyId);
+	}
 	return m_tree.GetUserData(proxyId);
 }
 
+inline void cb2BroadPhase::SetUserData(int proxyId, void* userData)
+{
+	if (IsStaticProxy(proxyId))
+	{
+		m_staticTree.SetUserData(proxyId & ~e_staticProxy, userData);
+	}
+	else if (m_type == cb2_spatialHashBroadPhase)
+	{
+		m_hash.SetUserData(proxyId, userData);
+	}
+	else if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		m_sweep.SetUserData(proxyId, userData);
+	}
+	else
+	{
+		m_tree.SetUserData(proxyId, userData);
+	}
+}
+
 inline bool cb2BroadPhase::TestOverlap(int proxyIdA, int proxyIdB) const
 {
-	const cb2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
-	const cb2AABB& aabbB = m_tree.GetFatAABB(proxyIdB);
+	const cb2AABB& aabbA = GetFatAABB(proxyIdA);
+	const cb2AABB& aabbB = GetFatAABB(proxyIdB);
 	return cb2TestOverlap(aabbA, aabbB);
 }
 
 inline const cb2AABB& cb2BroadPhase::GetFatAABB(int proxyId) const
 {
+	if (IsStaticProxy(proxyId))
+	{
+		return m_staticTree.GetFatAABB(proxyId & ~e_staticProxy);
+	}
+	if (m_type == cb2_spatialHashBroadPhase)
+	{
+		return m_hash.GetFatAABB(proxyId);
+	}
+	if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		return m_sweep.GetFatAABB(proxyId);
+	}
 	return m_tree.GetFatAABB(proxyId);
 }
 
@@ -183,30 +548,122 @@ inline float cb2BroadPhase::GetTreeQuality() const
 }
 
 template <typename T>
-void cb2BroadPhase::UpdatePairs(T* callback)
+inline void cb2BroadPhase::QueryProxies(T* callback, const cb2AABB& aabb) const
 {
-	// Reset pair buffer
-	m_pairCount = 0;
+	if (m_type == cb2_spatialHashBroadPhase)
+	{
+		m_hash.Query(callback, aabb);
+	}
+	else if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		m_sweep.Query(callback, aabb);
+	}
+	else
+	{
+		m_tree.Query(callback, aabb);
+	}
+}
 
-	// Perform tree queries for all moving proxies.
-	for (int i = 0; i < m_moveCount; ++i)
+template <typename T>
+inline void cb2BroadPhase::QueryProxies(T* callback, const cb2AABB& aabb, unsigned int layerMask) const
+{
+	if (m_type == cb2_dynamicTreeBroadPhase && layerMask != 0xFFFFFFFF)
 	{
-		m_queryProxyId = m_moveBuffer[i];
-		if (m_queryProxyId == e_nullProxy)
+		m_tree.Query(callback, aabb, layerMask);
+	}
+	else
+	{
+		QueryProxies(callback, aabb);
+	}
+}
+
+inline const cb2ProxyKey& cb2BroadPhase::GetProxyKey(int proxyId) const
+{
+	bool isStatic = IsStaticProxy(proxyId);
+	int index = isStatic ? proxyId & ~e_staticProxy : proxyId;
+	if (isStatic)
+	{
+		return index < m_staticKeyCapacity ? m_staticKeys[index] : m_defaultKey;
+	}
+	return index < m_keyCapacity ? m_keys[index] : m_defaultKey;
+}
+
+inline int cb2BroadPhase::GetProxyLayer(int proxyId) const
+{
+	return GetProxyKey(proxyId).layer;
+}
+
+inline bool cb2BroadPhase::ShouldCollideLayers(int layerA, int layerB) const
+{
+	cb2Assert(0 <= layerA && layerA < cb2_maxLayers);
+	cb2Assert(0 <= layerB && layerB < cb2_maxLayers);
+	return (m_layerMasks[layerA] & (1u << layerB)) != 0;
+}
+
+inline bool cb2BroadPhase::ShouldPair(int proxyIdA, int proxyIdB) const
+{
+	const cb2ProxyKey& keyA = GetProxyKey(proxyIdA);
+	const cb2ProxyKey& keyB = GetProxyKey(proxyIdB);
+
+	// Proxies of one owner, or of two owners that cannot move each other.
+	if ((keyA.owner == keyB.owner && keyA.owner != -1) || (keyA.flags & keyB.flags & cb2ProxyKey::e_fixedFlag))
+	{
+		return false;
+	}
+
+	if (m_layerFiltering && ShouldCollideLayers(keyA.layer, keyB.layer) == false)
+	{
+		return false;
+	}
+
+	if (m_sensorRejection && ((keyA.flags | keyB.flags) & cb2ProxyKey::e_sensorFlag))
+	{
+		return false;
+	}
+
+	if (m_filterRejection)
+	{
+		if (keyA.groupIndex == keyB.groupIndex && keyA.groupIndex != 0)
 		{
-			continue;
+			return keyA.groupIndex > 0;
 		}
 
-		// We have to query the tree with the fat AABB so that
-		// we don't fail to create a pair that may touch later.
-		const cb2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
+		return (keyA.maskBits & keyB.categoryBits) != 0 && (keyA.categoryBits & keyB.maskBits) != 0;
+	}
 
-		// Query tree, create pairs and add them pair buffer.
-		m_tree.Query(this, fatAABB);
+	return true;
+}
+
+inline unsigned int cb2BroadPhase::GetQueryLayerMask(int proxyId) const
+{
+	return m_layerFiltering ? m_layerMasks[GetProxyLayer(proxyId)] : 0xFFFFFFFF;
+}
+
+template <typename T>
+inline void cb2BroadPhase::RayCastProxies(T* callback, const cb2RayCastInput& input) const
+{
+	if (m_type == cb2_spatialHashBroadPhase)
+	{
+		m_hash.RayCast(callback, input);
 	}
+	else if (m_type == cb2_sweepAndPruneBroadPhase)
+	{
+		m_sweep.RayCast(callback, input);
+	}
+	else
+	{
+		m_tree.RayCast(callback, input);
+	}
+}
+
+template <typename T>
+void cb2BroadPhase::UpdatePairs(T* callback)
+{
+	// Query the tree for all moving proxies and fill the pair buffer.
+	FindPairs();
 
 	// Reset move buffer
-	m_moveCount = 0;
+	ResetMoveBuffer();
 
 	// Sort the pair buffer to expose duplicates.
 	std::sort(m_pairBuffer, m_pairBuffer + m_pairCount, cb2PairLessThan);
@@ -216,8 +673,8 @@ void cb2BroadPhase::UpdatePairs(T* callback)
 	while (i < m_pairCount)
 	{
 		cb2Pair* primaryPair = m_pairBuffer + i;
-		void* userDataA = m_tree.GetUserData(primaryPair->proxyIdA);
-		void* userDataB = m_tree.GetUserData(primaryPair->proxyIdB);
+		void* userDataA = GetUserData(primaryPair->proxyIdA);
+		void* userDataB = GetUserData(primaryPair->proxyIdB);
 
 		callback->AddPair(userDataA, userDataB);
 		++i;
@@ -235,24 +692,205 @@ void cb2BroadPhase::UpdatePairs(T* callback)
 	}
 
 	// Try to keep the tree balanced.
-	//m_tree.Rebalance(4);
+	m_tree.Optimize(m_optimizeLeafCount);
 }
 
 template <typename T>
 inline void cb2BroadPhase::Query(T* callback, const cb2AABB& aabb) const
 {
-	m_tree.Query(callback, aabb);
+	if (m_staticTree.GetProxyCount() == 0)
+	{
+		QueryProxies(callback, aabb);
+		return;
+	}
+
+	cb2BroadPhaseCallback<T> wrapper;
+	wrapper.callback = callback;
+	wrapper.proxyFlag = 0;
+	wrapper.proceed = true;
+	QueryProxies(&wrapper, aabb);
+
+	if (wrapper.proceed)
+	{
+		wrapper.proxyFlag = e_staticProxy;
+		m_staticTree.Query(&wrapper, aabb);
+	}
+}
+
+/// Forwards a closest query to a client, tagging the proxy ids of one tree and
+/// remembering the search distance so the next tree can continue from it. The
+/// box queries of the spatial hash and the sweep and prune are forwarded too.
+template <typename T>
+struct cb2ClosestQueryCallback
+{
+	float ClosestCallback(int proxyId)
+	{
+		float value = callback->ClosestCallback(proxyId | proxyFlag);
+		if (value < 0.0f)
+		{
+			proceed = false;
+		}
+		else
+		{
+			maxDistance = cb2Min(maxDistance, value);
+		}
+		return value;
+	}
+
+	bool QueryCallback(int proxyId)
+	{
+		if (cb2DistanceSquared(broadPhase->GetFatAABB(proxyId | proxyFlag), point) > maxDistance * maxDistance)
+		{
+			return true;
+		}
+		return ClosestCallback(proxyId) >= 0.0f;
+	}
+
+	T* callback;
+	const cb2BroadPhase* broadPhase;
+	ci::Vec2f point;
+	int proxyFlag;
+	bool proceed;
+	float maxDistance;
+};
+
+template <typename T>
+inline void cb2BroadPhase::QueryClosest(T* callback, const ci::Vec2f& point, float maxDistance) const
+{
+	cb2ClosestQueryCallback<T> wrapper;
+	wrapper.callback = callback;
+	wrapper.broadPhase = this;
+	wrapper.point = point;
+	wrapper.proxyFlag = 0;
+	wrapper.proceed = true;
+	wrapper.maxDistance = maxDistance;
+
+	if (m_type == cb2_dynamicTreeBroadPhase)
+	{
+		m_tree.QueryClosest(&wrapper, point, maxDistance);
+	}
+	else
+	{
+		cb2Assert(maxDistance < cb2_maxFloat);
+		cb2AABB aabb;
+		aabb.lowerBound = point - ci::Vec2f(maxDistance, maxDistance);
+		aabb.upperBound = point + ci::Vec2f(maxDistance, maxDistance);
+		QueryProxies(&wrapper, aabb);
+	}
+
+	if (wrapper.proceed)
+	{
+		// Continue with the distance found in the dynamic proxies.
+		wrapper.proxyFlag = e_staticProxy;
+		m_staticTree.QueryClosest(&wrapper, point, wrapper.maxDistance);
+	}
+}
+
+template <typename T>
+inline void cb2BroadPhase::QueryBatch(T* callback, const cb2AABB* aabbs, const int* order, int count) const
+{
+	cb2BatchQueryCallback<T> wrapper;
+	wrapper.callback = callback;
+	wrapper.proxyFlag = 0;
+	wrapper.proceed = true;
+	if (m_type == cb2_dynamicTreeBroadPhase)
+	{
+		m_tree.QueryBatch(&wrapper, aabbs, order, count);
+	}
+	else
+	{
+		for (int i = 0; i < count && wrapper.proceed; ++i)
+		{
+			wrapper.queryIndex = order[i];
+			QueryProxies(&wrapper, aabbs[order[i]]);
+		}
+	}
+
+	wrapper.proxyFlag = e_staticProxy;
+	for (int i = 0; i < count && wrapper.proceed && m_staticTree.GetProxyCount() > 0; ++i)
+	{
+		wrapper.queryIndex = order[i];
+		m_staticTree.Query(&wrapper, aabbs[order[i]]);
+	}
 }
 
 template <typename T>
 inline void cb2BroadPhase::RayCast(T* callback, const cb2RayCastInput& input) const
 {
-	m_tree.RayCast(callback, input);
+	if (m_staticTree.GetProxyCount() == 0)
+	{
+		RayCastProxies(callback, input);
+		return;
+	}
+
+	cb2BroadPhaseCallback<T> wrapper;
+	wrapper.callback = callback;
+	wrapper.proxyFlag = 0;
+	wrapper.proceed = true;
+	wrapper.maxFraction = input.maxFraction;
+	RayCastProxies(&wrapper, input);
+
+	if (wrapper.proceed)
+	{
+		// Continue with the ray clipped by the dynamic tree.
+		cb2RayCastInput staticInput = input;
+		staticInput.maxFraction = wrapper.maxFraction;
+		wrapper.proxyFlag = e_staticProxy;
+		m_staticTree.RayCast(&wrapper, staticInput);
+	}
+}
+
+template <typename T>
+inline void cb2BroadPhase::RayCastBatch(T* callback, const cb2RayCastInput* inputs, const int* order, int count) const
+{
+	float* fractions = (float*)cb2Alloc(count * sizeof(float), cb2_defaultAlignment, cb2_memoryBroadPhase);
+	cb2BatchRayCastCallback<T> wrapper;
+	wrapper.callback = callback;
+	if (m_type == cb2_dynamicTreeBroadPhase)
+	{
+		m_tree.RayCastBatch(callback, inputs, order, count, fractions);
+	}
+	else
+	{
+		wrapper.proxyFlag = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			int rayIndex = order[i];
+			wrapper.rayIndex = rayIndex;
+			wrapper.maxFraction = inputs[rayIndex].maxFraction;
+			RayCastProxies(&wrapper, inputs[rayIndex]);
+			fractions[rayIndex] = wrapper.maxFraction;
+		}
+	}
+
+	if (m_staticTree.GetProxyCount() > 0)
+	{
+		wrapper.proxyFlag = e_staticProxy;
+		for (int i = 0; i < count; ++i)
+		{
+			// Continue each ray where the dynamic tree clipped it.
+			int rayIndex = order[i];
+			if (fractions[rayIndex] == 0.0f)
+			{
+				continue;
+			}
+
+			cb2RayCastInput input = inputs[rayIndex];
+			input.maxFraction = fractions[rayIndex];
+			wrapper.rayIndex = rayIndex;
+			m_staticTree.RayCast(&wrapper, input);
+		}
+	}
+
+	cb2Free(fractions, cb2_memoryBroadPhase);
 }
 
 inline void cb2BroadPhase::ShiftOrigin(const ci::Vec2f& newOrigin)
 {
 	m_tree.ShiftOrigin(newOrigin);
+	m_hash.ShiftOrigin(newOrigin);
+	m_sweep.ShiftOrigin(newOrigin);
+	m_staticTree.ShiftOrigin(newOrigin);
 }
 
 #endif
@@ -0,0 +1,471 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Collision/cb2Collision.h>
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+
+// A convex polygon with a radius. Capsules and edges are polygons of two vertices,
+// so one routine collides any pair of them.
+struct cb2RoundedPolygon
+{
+	ci::Vec2f vertices[cb2_maxPolygonVertices];
+	ci::Vec2f normals[cb2_maxPolygonVertices];
+	int count;
+	float radius;
+};
+
+static void cb2MakeRoundedPolygon(cb2RoundedPolygon* polygon, const ci::Vec2f& v1, const ci::Vec2f& v2, float radius)
+{
+	ci::Vec2f normal = cb2Cross(v2 - v1, 1.0f);
+	normal.normalize();
+
+	polygon->vertices[0] = v1;
+	polygon->vertices[1] = v2;
+	polygon->normals[0] = normal;
+	polygon->normals[1] = -normal;
+	polygon->count = 2;
+	polygon->radius = radius;
+}
+
+static void cb2MakeRoundedPolygon(cb2RoundedPolygon* polygon, const cb2PolygonShape* shape)
+{
+	for (int i = 0; i < shape->m_count; ++i)
+	{
+		polygon->vertices[i] = shape->m_vertices[i];
+		polygon->normals[i] = shape->m_normals[i];
+	}
+	polygon->count = shape->m_count;
+	polygon->radius = shape->m_radius;
+}
+
+// Find the max separation between poly1 and poly2 using edge normals from poly1.
+// Both polygons are in the same frame.
+static float cb2FindMaxSeparation(int* edgeIndex, const cb2RoundedPolygon* poly1, const cb2RoundedPolygon* poly2)
+{
+	int bestIndex = 0;
+	float maxSeparation = -cb2_maxFloat;
+	for (int i = 0; i < poly1->count; ++i)
+	{
+		ci::Vec2f n = poly1->normals[i];
+		ci::Vec2f v1 = poly1->vertices[i];
+
+		// Find the deepest point of poly2 for normal i.
+		float si = cb2_maxFloat;
+		for (int j = 0; j < poly2->count; ++j)
+		{
+			float sij = cb2Dot(n, poly2->vertices[j] - v1);
+			if (sij < si)
+			{
+				si = sij;
+			}
+		}
+
+		if (si > maxSeparation)
+		{
+			maxSeparation = si;
+			bestIndex = i;
+		}
+	}
+
+	*edgeIndex = bestIndex;
+	return maxSeparation;
+}
+
+// Find the edge of the polygon most anti-parallel to the reference normal.
+static int cb2FindIncidentEdge(const cb2RoundedPolygon* polygon, const ci::Vec2f& normal)
+{
+	int index = 0;
+	float minDot = cb2_maxFloat;
+	for (int i = 0; i < polygon->count; ++i)
+	{
+		float dot = cb2Dot(normal, polygon->normals[i]);
+		if (dot < minDot)
+		{
+			minDot = dot;
+			index = i;
+		}
+	}
+	return index;
+}
+
+// Closest points of the segments p1 + s * (q1 - p1) and p2 + t * (q2 - p2) with s and t in
+// [0, 1], from Real-Time Collision Detection by Christer Ericson, Section 5.1.9.
+// Returns the squared distance.
+static float cb2SegmentDistanceSquared(float* fraction1, float* fraction2,
+									  const ci::Vec2f& p1, const ci::Vec2f& q1,
+									  const ci::Vec2f& p2, const ci::Vec2f& q2)
+{
+	ci::Vec2f d1 = q1 - p1;
+	ci::Vec2f d2 = q2 - p2;
+	ci::Vec2f r = p1 - p2;
+	float dd1 = cb2Dot(d1, d1);
+	float dd2 = cb2Dot(d2, d2);
+	float rd1 = cb2Dot(r, d1);
+	float rd2 = cb2Dot(r, d2);
+
+	const float epsSqr = cb2_epsilon * cb2_epsilon;
+
+	float s = 0.0f, t = 0.0f;
+	if (dd1 < epsSqr || dd2 < epsSqr)
+	{
+		// Handle the point cases.
+		if (dd1 >= epsSqr)
+		{
+			s = cb2Clamp(-rd1 / dd1, 0.0f, 1.0f);
+		}
+		else if (dd2 >= epsSqr)
+		{
+			t = cb2Clamp(rd2 / dd2, 0.0f, 1.0f);
+		}
+	}
+	else
+	{
+		// Closest points of the lines, clamped to the first segment.
+		float d12 = cb2Dot(d1, d2);
+		float denom = dd1 * dd2 - d12 * d12;
+		if (denom != 0.0f)
+		{
+			s = cb2Clamp((d12 * rd2 - rd1 * dd2) / denom, 0.0f, 1.0f);
+		}
+
+		// Clamped to the second segment, then the first one again.
+		t = (d12 * s + rd2) / dd2;
+		if (t < 0.0f)
+		{
+			t = 0.0f;
+			s = cb2Clamp(-rd1 / dd1, 0.0f, 1.0f);
+		}
+		else if (t > 1.0f)
+		{
+			t = 1.0f;
+			s = cb2Clamp((d12 - rd1) / dd1, 0.0f, 1.0f);
+		}
+	}
+
+	*fraction1 = s;
+	*fraction2 = t;
+	return cb2DistanceSquared(p1 + s * d1, p2 + t * d2);
+}
+
+// The separating axis test of cb2CollidePolygons, except that cores which are apart and
+// closest at two vertices get one point along the line between those vertices. No face
+// normal is the contact normal there, and the rounded ends would hover at the corners.
+static void cb2CollideRoundedPolygons(cb2Manifold* manifold,
+									 const cb2RoundedPolygon* polyA, const cb2Transform& xfA,
+									 const cb2RoundedPolygon* polyB, const cb2Transform& xfB,
+									 float speculativeDistance)
+{
+	manifold->pointCount = 0;
+
+	// Work in the frame of A.
+	cb2Transform xf = cb2MulT(xfA, xfB);
+	cb2RoundedPolygon localB;
+	for (int i = 0; i < polyB->count; ++i)
+	{
+		localB.vertices[i] = cb2Mul(xf, polyB->vertices[i]);
+		localB.normals[i] = cb2Mul(xf.q, polyB->normals[i]);
+	}
+	localB.count = polyB->count;
+	localB.radius = polyB->radius;
+
+	float totalRadius = polyA->radius + polyB->radius;
+	float contactRadius = totalRadius + speculativeDistance;
+
+	int edgeA = 0;
+	float separationA = cb2FindMaxSeparation(&edgeA, polyA, &localB);
+	if (separationA > contactRadius)
+	{
+		return;
+	}
+
+	int edgeB = 0;
+	float separationB = cb2FindMaxSeparation(&edgeB, &localB, polyA);
+	if (separationB > contactRadius)
+	{
+		return;
+	}
+
+	const float k_tol = 0.1f * cb2_linearSlop;
+
+	bool flip = separationB > separationA + k_tol;
+	if (flip)
+	{
+		edgeA = cb2FindIncidentEdge(polyA, localB.normals[edgeB]);
+	}
+	else
+	{
+		edgeB = cb2FindIncidentEdge(&localB, polyA->normals[edgeA]);
+	}
+
+	int iA1 = edgeA;
+	int iA2 = edgeA + 1 < polyA->count ? edgeA + 1 : 0;
+	int iB1 = edgeB;
+	int iB2 = edgeB + 1 < localB.count ? edgeB + 1 : 0;
+
+	if (cb2Max(separationA, separationB) > k_tol)
+	{
+		float fractionA, fractionB;
+		float distSqr = cb2SegmentDistanceSquared(&fractionA, &fractionB,
+			polyA->vertices[iA1], polyA->vertices[iA2], localB.vertices[iB1], localB.vertices[iB2]);
+
+		bool vertexA = fractionA == 0.0f || fractionA == 1.0f;
+		bool vertexB = fractionB == 0.0f || fractionB == 1.0f;
+		if (vertexA && vertexB)
+		{
+			if (distSqr > contactRadius * contactRadius)
+			{
+				return;
+			}
+
+			int iA = fractionA == 0.0f ? iA1 : iA2;
+			int iB = fractionB == 0.0f ? iB1 : iB2;
+
+			manifold->type = cb2Manifold::e_circles;
+			manifold->localPoint = polyA->vertices[iA];
+			cb2::setZero(manifold->localNormal);
+			manifold->pointCount = 1;
+
+			cb2ManifoldPoint* cp = manifold->points + 0;
+			cp->localPoint = polyB->vertices[iB];
+			cp->id.cf.indexA = (unsigned char)iA;
+			cp->id.cf.indexB = (unsigned char)iB;
+			cp->id.cf.typeA = cb2ContactFeature::e_vertex;
+			cp->id.cf.typeB = cb2ContactFeature::e_vertex;
+			return;
+		}
+	}
+
+	const cb2RoundedPolygon* poly1;	// reference polygon
+	const cb2RoundedPolygon* poly2;	// incident polygon
+	int i11, i12, i21, i22;
+
+	if (flip)
+	{
+		poly1 = &localB;
+		poly2 = polyA;
+		i11 = iB1;
+		i12 = iB2;
+		i21 = iA1;
+		i22 = iA2;
+		manifold->type = cb2Manifold::e_faceB;
+		manifold->localNormal = polyB->normals[i11];
+		manifold->localPoint = 0.5f * (polyB->vertices[i11] + polyB->vertices[i12]);
+	}
+	else
+	{
+		poly1 = polyA;
+		poly2 = &localB;
+		i11 = iA1;
+		i12 = iA2;
+		i21 = iB1;
+		i22 = iB2;
+		manifold->type = cb2Manifold::e_faceA;
+		manifold->localNormal = polyA->normals[i11];
+		manifold->localPoint = 0.5f * (polyA->vertices[i11] + polyA->vertices[i12]);
+	}
+
+	cb2ClipVertex incidentEdge[2];
+	incidentEdge[0].v = poly2->vertices[i21];
+	incidentEdge[0].id.cf.indexA = (unsigned char)i11;
+	incidentEdge[0].id.cf.indexB = (unsigned char)i21;
+	incidentEdge[0].id.cf.typeA = cb2ContactFeature::e_face;
+	incidentEdge[0].id.cf.typeB = cb2ContactFeature::e_vertex;
+
+	incidentEdge[1].v = poly2->vertices[i22];
+	incidentEdge[1].id.cf.indexA = (unsigned char)i11;
+	incidentEdge[1].id.cf.indexB = (unsigned char)i22;
+	incidentEdge[1].id.cf.typeA = cb2ContactFeature::e_face;
+	incidentEdge[1].id.cf.typeB = cb2ContactFeature::e_vertex;
+
+	ci::Vec2f v11 = poly1->vertices[i11];
+	ci::Vec2f v12 = poly1->vertices[i12];
+
+	ci::Vec2f tangent = v12 - v11;
+	tangent.normalize();
+	ci::Vec2f normal = cb2Cross(tangent, 1.0f);
+
+	// Face offset.
+	float frontOffset = cb2Dot(normal, v11);
+
+	// Side offsets, extended by the radii.
+	float sideOffset1 = -cb2Dot(tangent, v11) + totalRadius;
+	float sideOffset2 = cb2Dot(tangent, v12) + totalRadius;
+
+	// Clip incident edge against extruded edge1 side edges.
+	cb2ClipVertex clipPoints1[2];
+	cb2ClipVertex clipPoints2[2];
+
+	if (cb2ClipSegmentToLine(clipPoints1, incidentEdge, -tangent, sideOffset1, i11) < 2)
+	{
+		return;
+	}
+
+	if (cb2ClipSegmentToLine(clipPoints2, clipPoints1, tangent, sideOffset2, i12) < 2)
+	{
+		return;
+	}
+
+	int pointCount = 0;
+	for (int i = 0; i < cb2_maxManifoldPoints; ++i)
+	{
+		float separation = cb2Dot(normal, clipPoints2[i].v) - frontOffset;
+
+		if (separation <= contactRadius)
+		{
+			cb2ManifoldPoint* cp = manifold->points + pointCount;
+			cp->id = clipPoints2[i].id;
+			if (flip)
+			{
+				// The incident points are on A, swap the features.
+				cp->localPoint = clipPoints2[i].v;
+				cb2ContactFeature cf = cp->id.cf;
+				cp->id.cf.indexA = cf.indexB;
+				cp->id.cf.indexB = cf.indexA;
+				cp->id.cf.typeA = cf.typeB;
+				cp->id.cf.typeB = cf.typeA;
+			}
+			else
+			{
+				cp->localPoint = cb2MulT(xf, clipPoints2[i].v);
+			}
+			++pointCount;
+		}
+	}
+
+	manifold->pointCount = pointCount;
+}
+
+void cb2CollideCapsuleAndCircle(
+	cb2Manifold* manifold,
+	const cb2CapsuleShape* capsuleA, const cb2Transform& xfA,
+	const cb2CircleShape* circleB, const cb2Transform& xfB)
+{
+	cb2CollideCapsuleAndCircle(manifold, capsuleA, xfA, circleB, xfB, 0.0f);
+}
+
+void cb2CollideCapsuleAndCircle(
+	cb2Manifold* manifold,
+	const cb2CapsuleShape* capsuleA, const cb2Transform& xfA,
+	const cb2CircleShape* circleB, const cb2Transform& xfB,
+	float speculativeDistance)
+{
+	manifold->pointCount = 0;
+
+	// Compute circle position in the frame of the capsule.
+	ci::Vec2f c = cb2MulT(xfA, cb2Mul(xfB, circleB->m_p));
+
+	// Closest point on the segment.
+	ci::Vec2f v1 = capsuleA->m_vertex1;
+	ci::Vec2f e = capsuleA->m_vertex2 - v1;
+	float t = cb2Clamp(cb2Dot(c - v1, e) / cb2Dot(e, e), 0.0f, 1.0f);
+	ci::Vec2f p = v1 + t * e;
+
+	float radius = capsuleA->m_radius + circleB->m_radius + speculativeDistance;
+	if (cb2DistanceSquared(c, p) > radius * radius)
+	{
+		return;
+	}
+
+	manifold->type = cb2Manifold::e_circles;
+	manifold->localPoint = p;
+	cb2::setZero(manifold->localNormal);
+	manifold->pointCount = 1;
+
+	manifold->points[0].localPoint = circleB->m_p;
+	manifold->points[0].id.key = 0;
+}
+
+void cb2CollideCapsules(
+	cb2Manifold* manifold,
+	const cb2CapsuleShape* capsuleA, const cb2Transform& xfA,
+	const cb2CapsuleShape* capsuleB, const cb2Transform& xfB)
+{
+	cb2CollideCapsules(manifold, capsuleA, xfA, capsuleB, xfB, 0.0f);
+}
+
+void cb2CollideCapsules(
+	cb2Manifold* manifold,
+	const cb2CapsuleShape* capsuleA, const cb2Transform& xfA,
+	const cb2CapsuleShape* capsuleB, const cb2Transform& xfB,
+	float speculativeDistance)
+{
+	cb2RoundedPolygon polyA, polyB;
+	cb2MakeRoundedPolygon(&polyA, capsuleA->m_vertex1, capsuleA->m_vertex2, capsuleA->m_radius);
+	cb2MakeRoundedPolygon(&polyB, capsuleB->m_vertex1, capsuleB->m_vertex2, capsuleB->m_radius);
+	cb2CollideRoundedPolygons(manifold, &polyA, xfA, &polyB, xfB, speculativeDistance);
+}
+
+void cb2CollidePolygonAndCapsule(
+	cb2Manifold* manifold,
+	const cb2PolygonShape* polygonA, const cb2Transform& xfA,
+	const cb2CapsuleShape* capsuleB, const cb2Transform& xfB)
+{
+	cb2CollidePolygonAndCapsule(manifold, polygonA, xfA, capsuleB, xfB, 0.0f);
+}
+
+void cb2CollidePolygonAndCapsule(
+	cb2Manifold* manifold,
+	const cb2PolygonShape* polygonA, const cb2Transform& xfA,
+	const cb2CapsuleShape* capsuleB, const cb2Transform& xfB,
+	float speculativeDistance)
+{
+	cb2RoundedPolygon polyA, polyB;
+	cb2MakeRoundedPolygon(&polyA, polygonA);
+	cb2MakeRoundedPolygon(&polyB, capsuleB->m_vertex1, capsuleB->m_vertex2, capsuleB->m_radius);
+	cb2CollideRoundedPolygons(manifold, &polyA, xfA, &polyB, xfB, speculativeDistance);
+}
+
+void cb2CollideEdgeAndCapsule(
+	cb2Manifold* manifold,
+	const cb2EdgeShape* edgeA, const cb2Transform& xfA,
+	const cb2CapsuleShape* capsuleB, const cb2Transform& xfB)
+{
+	cb2CollideEdgeAndCapsule(manifold, edgeA, xfA, capsuleB, xfB, 0.0f);
+}
+
+void cb2CollideEdgeAndCapsule(
+	cb2Manifold* manifold,
+	const cb2EdgeShape* edgeA, const cb2Transform& xfA,
+	const cb2CapsuleShape* capsuleB, const cb2Transform& xfB,
+	float speculativeDistance)
+{
+	if (edgeA->m_hasVertex0 || edgeA->m_hasVertex3)
+	{
+		// The edge and polygon collider knows the adjacent edges. It takes the
+		// capsule as a polygon of two vertices with the capsule radius.
+		cb2PolygonShape polygonB;
+		polygonB.m_count = 2;
+		polygonB.m_vertices[0] = capsuleB->m_vertex1;
+		polygonB.m_vertices[1] = capsuleB->m_vertex2;
+		polygonB.m_normals[0] = cb2Cross(capsuleB->m_vertex2 - capsuleB->m_vertex1, 1.0f);
+		polygonB.m_normals[0].normalize();
+		polygonB.m_normals[1] = -polygonB.m_normals[0];
+		polygonB.m_centroid = 0.5f * (capsuleB->m_vertex1 + capsuleB->m_vertex2);
+		polygonB.m_radius = capsuleB->m_radius;
+		cb2CollideEdgeAndPolygon(manifold, edgeA, xfA, &polygonB, xfB, speculativeDistance);
+		return;
+	}
+
+	cb2RoundedPolygon polyA, polyB;
+	cb2MakeRoundedPolygon(&polyA, edgeA->m_vertex1, edgeA->m_vertex2, edgeA->m_radius);
+	cb2MakeRoundedPolygon(&polyB, capsuleB->m_vertex1, capsuleB->m_vertex2, capsuleB->m_radius);
+	cb2CollideRoundedPolygons(manifold, &polyA, xfA, &polyB, xfB, speculativeDistance);
+}
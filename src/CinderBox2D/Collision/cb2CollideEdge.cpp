@@ -17,6 +17,7 @@
  */
 
 #include <CinderBox2D/Collision/cb2Collision.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
@@ -27,6 +28,14 @@
 void cb2CollideEdgeAndCircle(cb2Manifold* manifold,
 							const cb2EdgeShape* edgeA, const cb2Transform& xfA,
 							const cb2CircleShape* circleB, const cb2Transform& xfB)
+{
+	cb2CollideEdgeAndCircle(manifold, edgeA, xfA, circleB, xfB, 0.0f);
+}
+
+void cb2CollideEdgeAndCircle(cb2Manifold* manifold,
+							const cb2EdgeShape* edgeA, const cb2Transform& xfA,
+							const cb2CircleShape* circleB, const cb2Transform& xfB,
+							float speculativeDistance)
 {
 	manifold->pointCount = 0;
 	
@@ -40,7 +49,7 @@ void cb2CollideEdgeAndCircle(cb2Manifold* manifold,
 	float u = cb2Dot(e, B - Q);
 	float v = cb2Dot(e, Q - A);
 	
-	float radius = edgeA->m_radius + circleB->m_radius;
+	float radius = edgeA->m_radius + circleB->m_radius + speculativeDistance;
 	
 	cb2ContactFeature cf;
 	cf.indexB = 0;
@@ -194,7 +203,16 @@ struct cb2ReferenceFace
 struct cb2EPCollider
 {
 	void Collide(cb2Manifold* manifold, const cb2EdgeShape* edgeA, const cb2Transform& xfA,
-				 const cb2PolygonShape* polygonB, const cb2Transform& xfB);
+				 const cb2PolygonShape* polygonB, const cb2Transform& xfB, float speculativeDistance);
+
+	// Collide a chain edge, reading the edge normals the chain keeps.
+	void Collide(cb2Manifold* manifold, const cb2ChainShape* chainA, int index, const cb2Transform& xfA,
+				 const cb2PolygonShape* polygonB, const cb2Transform& xfB, float speculativeDistance);
+
+	// Collide once the vertices are set, with the normals of the edges that exist.
+	void Collide(cb2Manifold* manifold, bool hasVertex0, bool hasVertex3, float edgeRadius, const cb2Transform& xfA,
+				 const cb2PolygonShape* polygonB, const cb2Transform& xfB, float speculativeDistance);
+
 	cb2EPAxis ComputeEdgeSeparation();
 	cb2EPAxis ComputePolygonSeparation();
 	
@@ -228,12 +246,8 @@ struct cb2EPCollider
 // 7. Return if _any_ axis indicates separation
 // 8. Clip
 void cb2EPCollider::Collide(cb2Manifold* manifold, const cb2EdgeShape* edgeA, const cb2Transform& xfA,
-						   const cb2PolygonShape* polygonB, const cb2Transform& xfB)
+						   const cb2PolygonShape* polygonB, const cb2Transform& xfB, float speculativeDistance)
 {
-	m_xf = cb2MulT(xfA, xfB);
-	
-	m_centroidB = cb2Mul(m_xf, polygonB->m_centroid);
-	
 	m_v0 = edgeA->m_vertex0;
 	m_v1 = edgeA->m_vertex1;
 	m_v2 = edgeA->m_vertex2;
@@ -242,30 +256,81 @@ void cb2EPCollider::Collide(cb2Manifold* manifold, const cb2EdgeShape* edgeA, co
 	bool hasVertex0 = edgeA->m_hasVertex0;
 	bool hasVertex3 = edgeA->m_hasVertex3;
 	
-	ci::Vec2f edge1 = m_v2 - m_v1;
-	edge1.normalize();
-	m_normal1.set(edge1.y, -edge1.x);
+	m_normal1 = cb2ComputeEdgeNormal(m_v1, m_v2);
+	if (hasVertex0)
+	{
+		m_normal0 = cb2ComputeEdgeNormal(m_v0, m_v1);
+	}
+	if (hasVertex3)
+	{
+		m_normal2 = cb2ComputeEdgeNormal(m_v2, m_v3);
+	}
+
+	Collide(manifold, hasVertex0, hasVertex3, edgeA->m_radius, xfA, polygonB, xfB, speculativeDistance);
+}
+
+void cb2EPCollider::Collide(cb2Manifold* manifold, const cb2ChainShape* chainA, int index, const cb2Transform& xfA,
+						   const cb2PolygonShape* polygonB, const cb2Transform& xfB, float speculativeDistance)
+{
+	cb2Assert(0 <= index && index < chainA->m_count - 1);
+	const ci::Vec2f* vertices = chainA->m_vertices;
+	const ci::Vec2f* normals = chainA->GetEdgeNormals();
+	int lastIndex = chainA->m_count - 2;
+
+	m_v1 = vertices[index];
+	m_v2 = vertices[index + 1];
+	m_normal1 = normals[index];
+
+	// The neighbors inside the chain have their normals, the ghost edges at the ends do not.
+	bool hasVertex0 = index > 0 || chainA->m_hasPrevVertex;
+	if (index > 0)
+	{
+		m_v0 = vertices[index - 1];
+		m_normal0 = normals[index - 1];
+	}
+	else if (hasVertex0)
+	{
+		m_v0 = chainA->m_prevVertex;
+		m_normal0 = cb2ComputeEdgeNormal(m_v0, m_v1);
+	}
+
+	bool hasVertex3 = index < lastIndex || chainA->m_hasNextVertex;
+	if (index < lastIndex)
+	{
+		m_v3 = vertices[index + 2];
+		m_normal2 = normals[index + 1];
+	}
+	else if (hasVertex3)
+	{
+		m_v3 = chainA->m_nextVertex;
+		m_normal2 = cb2ComputeEdgeNormal(m_v2, m_v3);
+	}
+
+	Collide(manifold, hasVertex0, hasVertex3, chainA->m_radius, xfA, polygonB, xfB, speculativeDistance);
+}
+
+void cb2EPCollider::Collide(cb2Manifold* manifold, bool hasVertex0, bool hasVertex3, float edgeRadius, const cb2Transform& xfA,
+						   const cb2PolygonShape* polygonB, const cb2Transform& xfB, float speculativeDistance)
+{
+	m_xf = cb2MulT(xfA, xfB);
+	
+	m_centroidB = cb2Mul(m_xf, polygonB->m_centroid);
+	
 	float offset1 = cb2Dot(m_normal1, m_centroidB - m_v1);
 	float offset0 = 0.0f, offset2 = 0.0f;
 	bool convex1 = false, convex2 = false;
 	
-	// Is there a preceding edge?
+	// Is there a preceding edge? The cross product of the normals is the one of the edges.
 	if (hasVertex0)
 	{
-		ci::Vec2f edge0 = m_v1 - m_v0;
-		edge0.normalize();
-		m_normal0.set(edge0.y, -edge0.x);
-		convex1 = cb2Cross(edge0, edge1) >= 0.0f;
+		convex1 = cb2Cross(m_normal0, m_normal1) >= 0.0f;
 		offset0 = cb2Dot(m_normal0, m_centroidB - m_v0);
 	}
 	
 	// Is there a following edge?
 	if (hasVertex3)
 	{
-		ci::Vec2f edge2 = m_v3 - m_v2;
-		edge2.normalize();
-		m_normal2.set(edge2.y, -edge2.x);
-		convex2 = cb2Cross(edge1, edge2) > 0.0f;
+		convex2 = cb2Cross(m_normal1, m_normal2) > 0.0f;
 		offset2 = cb2Dot(m_normal2, m_centroidB - m_v2);
 	}
 	
@@ -432,7 +497,7 @@ void cb2EPCollider::Collide(cb2Manifold* manifold, const cb2EdgeShape* edgeA, co
 		m_polygonB.normals[i] = cb2Mul(m_xf.q, polygonB->m_normals[i]);
 	}
 	
-	m_radius = 2.0f * cb2_polygonRadius;
+	m_radius = edgeRadius + polygonB->m_radius + speculativeDistance;
 	
 	manifold->pointCount = 0;
 	
@@ -692,7 +757,32 @@ cb2EPAxis cb2EPCollider::ComputePolygonSeparation()
 void cb2CollideEdgeAndPolygon(	cb2Manifold* manifold,
 							 const cb2EdgeShape* edgeA, const cb2Transform& xfA,
 							 const cb2PolygonShape* polygonB, const cb2Transform& xfB)
+{
+	cb2CollideEdgeAndPolygon(manifold, edgeA, xfA, polygonB, xfB, 0.0f);
+}
+
+void cb2CollideEdgeAndPolygon(	cb2Manifold* manifold,
+							 const cb2EdgeShape* edgeA, const cb2Transform& xfA,
+							 const cb2PolygonShape* polygonB, const cb2Transform& xfB,
+							 float speculativeDistance)
+{
+	cb2EPCollider collider;
+	collider.Collide(manifold, edgeA, xfA, polygonB, xfB, speculativeDistance);
+}
+
+void cb2CollideEdgeAndPolygon(	cb2Manifold* manifold,
+							 const cb2ChainShape* chainA, int childIndex, const cb2Transform& xfA,
+							 const cb2PolygonShape* polygonB, const cb2Transform& xfB,
+							 float speculativeDistance)
 {
 	cb2EPCollider collider;
-	collider.Collide(manifold, edgeA, xfA, polygonB, xfB);
+	if (chainA->GetEdgeNormals() == NULL)
+	{
+		cb2EdgeShape edge;
+		chainA->GetChildEdge(&edge, childIndex);
+		collider.Collide(manifold, &edge, xfA, polygonB, xfB, speculativeDistance);
+		return;
+	}
+
+	collider.Collide(manifold, chainA, childIndex, xfA, polygonB, xfB, speculativeDistance);
 }
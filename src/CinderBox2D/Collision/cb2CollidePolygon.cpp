@@ -18,12 +18,18 @@
 
 #include <CinderBox2D/Collision/cb2Collision.h>
 #include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+#include <CinderBox2D/Common/cb2Simd.h>
 
 // Find the max separation between poly1 and poly2 using edge normals from poly1.
-static float cb2FindMaxSeparation(int* edgeIndex,
+// Also returns the largest separation of the other normals. The normals of poly1 are processed cb2_simdWidth at a time against each vertex
+// of poly2. The lanes use the same operations as cb2Dot(n, v2 - v1), so the result
+// matches the scalar loop exactly.
+static float cb2FindMaxSeparation(int* edgeIndex, float* secondSeparation,
 								 const cb2PolygonShape* poly1, const cb2Transform& xf1,
 								 const cb2PolygonShape* poly2, const cb2Transform& xf2)
 {
+	const int laneCount = ((cb2_maxPolygonVertices + cb2_simdWidth - 1) / cb2_simdWidth) * cb2_simdWidth;
+
 	int count1 = poly1->m_count;
 	int count2 = poly2->m_count;
 	const ci::Vec2f* n1s = poly1->m_normals;
@@ -31,36 +37,114 @@ static float cb2FindMaxSeparation(int* edgeIndex,
 	const ci::Vec2f* v2s = poly2->m_vertices;
 	cb2Transform xf = cb2MulT(xf2, xf1);
 
-	int bestIndex = 0;
-	float maxSeparation = -cb2_maxFloat;
-	for (int i = 0; i < count1; ++i)
+	// Poly1 normals and vertices in frame2. Unused lanes repeat the first edge.
+	float nx[laneCount], ny[laneCount];
+	float vx[laneCount], vy[laneCount];
+	for (int i = 0; i < laneCount; ++i)
 	{
-		// Get poly1 normal in frame2.
-		ci::Vec2f n = cb2Mul(xf.q, n1s[i]);
-		ci::Vec2f v1 = cb2Mul(xf, v1s[i]);
+		int k = i < count1 ? i : 0;
+		ci::Vec2f n = cb2Mul(xf.q, n1s[k]);
+		ci::Vec2f v1 = cb2Mul(xf, v1s[k]);
+		nx[i] = n.x;
+		ny[i] = n.y;
+		vx[i] = v1.x;
+		vy[i] = v1.y;
+	}
 
-		// Find deepest point for normal i.
-		float si = cb2_maxFloat;
+	// Find the deepest point of poly2 for each normal.
+	float separations[laneCount];
+	for (int i = 0; i < count1; i += cb2_simdWidth)
+	{
+		cb2FloatW nX = cb2LoadW(nx + i);
+		cb2FloatW nY = cb2LoadW(ny + i);
+		cb2FloatW v1X = cb2LoadW(vx + i);
+		cb2FloatW v1Y = cb2LoadW(vy + i);
+
+		cb2FloatW si = cb2SplatW(cb2_maxFloat);
 		for (int j = 0; j < count2; ++j)
 		{
-			float sij = cb2Dot(n, v2s[j] - v1);
-			if (sij < si)
-	{
-				si = sij;
-	}
+			cb2FloatW dX = cb2SubW(cb2SplatW(v2s[j].x), v1X);
+			cb2FloatW dY = cb2SubW(cb2SplatW(v2s[j].y), v1Y);
+			cb2FloatW sij = cb2AddW(cb2MulW(nX, dX), cb2MulW(nY, dY));
+			si = cb2MinW(si, sij);
+		}
+
+		cb2StoreW(separations + i, si);
 	}
 
-		if (si > maxSeparation)
+	int bestIndex = 0;
+	float maxSeparation = -cb2_maxFloat;
+	float nextSeparation = -cb2_maxFloat;
+	for (int i = 0; i < count1; ++i)
+	{
+		if (separations[i] > maxSeparation)
 		{
-			maxSeparation = si;
+			nextSeparation = maxSeparation;
+			maxSeparation = separations[i];
 			bestIndex = i;
 		}
+		else if (separations[i] > nextSeparation)
+		{
+			nextSeparation = separations[i];
+		}
 	}
 
 	*edgeIndex = bestIndex;
+	*secondSeparation = nextSeparation;
 	return maxSeparation;
 }
 
+// Find the separation of poly2 along one edge normal of poly1. This matches the
+// value computed for that edge by cb2FindMaxSeparation.
+static float cb2EdgeSeparation(const cb2PolygonShape* poly1, const cb2Transform& xf1, int edge1,
+							  const cb2PolygonShape* poly2, const cb2Transform& xf2)
+{
+	int count2 = poly2->m_count;
+	const ci::Vec2f* v2s = poly2->m_vertices;
+	cb2Transform xf = cb2MulT(xf2, xf1);
+
+	ci::Vec2f n = cb2Mul(xf.q, poly1->m_normals[edge1]);
+	ci::Vec2f v1 = cb2Mul(xf, poly1->m_vertices[edge1]);
+
+	float separation = cb2_maxFloat;
+	for (int j = 0; j < count2; ++j)
+	{
+		float sj = n.x * (v2s[j].x - v1.x) + n.y * (v2s[j].y - v1.y);
+		if (sj < separation)
+		{
+			separation = sj;
+		}
+	}
+
+	return separation;
+}
+
+// Largest vertex distance from the polygon origin.
+static float cb2ComputeExtent(const cb2PolygonShape* poly)
+{
+	float extent = 0.0f;
+	for (int i = 0; i < poly->m_count; ++i)
+	{
+		extent = cb2Max(extent, poly->m_vertices[i].lengthSquared());
+	}
+	return cb2Sqrt(extent);
+}
+
+// Bound the change of any edge separation between two relative transforms of B in the
+// frame of A. A normal of A sees the vertices of B move by at most |dp| + chord * rB. A
+// normal of B also turns by chord against vertices up to rA + rB + |p| away.
+static float cb2SeparationChange(const cb2Transform& xf0, const cb2Transform& xf, float extent)
+{
+	float s = xf.q.s * xf0.q.c - xf.q.c * xf0.q.s;
+	float c = xf.q.c * xf0.q.c + xf.q.s * xf0.q.s;
+
+	// Chord length 2 sin(angle / 2) of the relative rotation, stable for small angles.
+	float oneMinusC = c > 0.0f ? s * s / (1.0f + c) : 1.0f - c;
+	float chord = cb2Sqrt(s * s + oneMinusC * oneMinusC);
+
+	return (xf.p - xf0.p).length() + chord * (extent + xf.p.length());
+}
+
 static void cb2FindIncidentEdge(cb2ClipVertex c[2],
 							 const cb2PolygonShape* poly1, const cb2Transform& xf1, int edge1,
 							 const cb2PolygonShape* poly2, const cb2Transform& xf2)
@@ -116,36 +200,132 @@ static void cb2FindIncidentEdge(cb2ClipVertex c[2],
 void cb2CollidePolygons(cb2Manifold* manifold,
 					  const cb2PolygonShape* polyA, const cb2Transform& xfA,
 					  const cb2PolygonShape* polyB, const cb2Transform& xfB)
+{
+	cb2CollidePolygons(manifold, polyA, xfA, polyB, xfB, NULL);
+}
+
+void cb2CollidePolygons(cb2Manifold* manifold,
+					  const cb2PolygonShape* polyA, const cb2Transform& xfA,
+					  const cb2PolygonShape* polyB, const cb2Transform& xfB,
+					  cb2PolygonCache* cache)
+{
+	cb2CollidePolygons(manifold, polyA, xfA, polyB, xfB, cache, 0.0f);
+}
+
+void cb2CollidePolygons(cb2Manifold* manifold,
+					  const cb2PolygonShape* polyA, const cb2Transform& xfA,
+					  const cb2PolygonShape* polyB, const cb2Transform& xfB,
+					  cb2PolygonCache* cache, float speculativeDistance)
 {
 	manifold->pointCount = 0;
 	float totalRadius = polyA->m_radius + polyB->m_radius;
 
-	int edgeA = 0;
-	float separationA = cb2FindMaxSeparation(&edgeA, polyA, xfA, polyB, xfB);
-	if (separationA > totalRadius)
-		return;
+	// Points are kept up to this separation, the skin is still clipped with totalRadius.
+	float contactRadius = totalRadius + speculativeDistance;
 
-	int edgeB = 0;
-	float separationB = cb2FindMaxSeparation(&edgeB, polyB, xfB, polyA, xfA);
-	if (separationB > totalRadius)
-		return;
+	int edge1 = 0;		// reference edge
+	unsigned char flip = 0;
+	bool cached = false;
+	cb2Transform xf;
+
+	// Separations move by less than this allowance from rounding.
+	const float k_slack = 0.01f * cb2_linearSlop;
+
+	if (cache && cache->state == cb2PolygonCache::e_separated)
+	{
+		// Still separated along the same axis? Then the full search would stop as well.
+		float separation = cache->flip ?
+			cb2EdgeSeparation(polyB, xfB, cache->edge, polyA, xfA) :
+			cb2EdgeSeparation(polyA, xfA, cache->edge, polyB, xfB);
+		if (separation > contactRadius)
+			return;
+	}
+	else if (cache && cache->state == cb2PolygonCache::e_touching)
+	{
+		// Every separation moves by at most delta, so the comparisons of the full search keep
+		// their outcome while 2 * delta stays below the margin.
+		xf = cb2MulT(xfA, xfB);
+		// A different contact radius moves the reject tests by the difference.
+		float delta = cb2SeparationChange(cache->xf, xf, cache->extent);
+		float margin = cache->margin - cb2Abs(contactRadius - cache->radius);
+		if (2.0f * delta + k_slack < margin)
+		{
+			edge1 = cache->edge;
+			flip = cache->flip;
+			cached = true;
+		}
+	}
+
+	if (cached == false)
+	{
+		int edgeA = 0;
+		float secondA;
+		float separationA = cb2FindMaxSeparation(&edgeA, &secondA, polyA, xfA, polyB, xfB);
+		if (separationA > contactRadius)
+		{
+			if (cache)
+			{
+				cache->state = cb2PolygonCache::e_separated;
+				cache->edge = edgeA;
+				cache->flip = 0;
+			}
+			return;
+		}
+
+		int edgeB = 0;
+		float secondB;
+		float separationB = cb2FindMaxSeparation(&edgeB, &secondB, polyB, xfB, polyA, xfA);
+		if (separationB > contactRadius)
+		{
+			if (cache)
+			{
+				cache->state = cb2PolygonCache::e_separated;
+				cache->edge = edgeB;
+				cache->flip = 1;
+			}
+			return;
+		}
+
+		const float k_tol = 0.1f * cb2_linearSlop;
+
+		if (separationB > separationA + k_tol)
+		{
+			edge1 = edgeB;
+			flip = 1;
+		}
+		else
+		{
+			edge1 = edgeA;
+			flip = 0;
+		}
+
+		if (cache)
+		{
+			float margin = cb2Min(contactRadius - separationA, contactRadius - separationB);
+			margin = cb2Min(margin, cb2Abs(separationB - separationA - k_tol));
+			margin = cb2Min(margin, flip ? separationB - secondB : separationA - secondA);
+
+			cache->state = cb2PolygonCache::e_touching;
+			cache->edge = edge1;
+			cache->flip = flip;
+			cache->margin = margin;
+			cache->radius = contactRadius;
+			cache->extent = cb2ComputeExtent(polyA) + 2.0f * cb2ComputeExtent(polyB);
+			cache->xf = cb2MulT(xfA, xfB);
+		}
+	}
 
 	const cb2PolygonShape* poly1;	// reference polygon
 	const cb2PolygonShape* poly2;	// incident polygon
 	cb2Transform xf1, xf2;
-	int edge1;		// reference edge
-	unsigned char flip;
-	const float k_tol = 0.1f * cb2_linearSlop;
 
-	if (separationB > separationA + k_tol)
+	if (flip)
 	{
 		poly1 = polyB;
 		poly2 = polyA;
 		xf1 = xfB;
 		xf2 = xfA;
-		edge1 = edgeB;
 		manifold->type = cb2Manifold::e_faceB;
-		flip = 1;
 	}
 	else
 	{
@@ -153,9 +333,7 @@ void cb2CollidePolygons(cb2Manifold* manifold,
 		poly2 = polyB;
 		xf1 = xfA;
 		xf2 = xfB;
-		edge1 = edgeA;
 		manifold->type = cb2Manifold::e_faceA;
-		flip = 0;
 	}
 
 	cb2ClipVertex incidentEdge[2];
@@ -217,7 +395,7 @@ void cb2CollidePolygons(cb2Manifold* manifold,
 	{
 		float separation = cb2Dot(normal, clipPoints2[i].v) - frontOffset;
 
-		if (separation <= totalRadius)
+		if (separation <= contactRadius)
 		{
 			cb2ManifoldPoint* cp = manifold->points + pointCount;
 			cp->localPoint = cb2MulT(xf2, clipPoints2[i].v);
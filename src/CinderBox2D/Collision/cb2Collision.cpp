@@ -18,6 +18,8 @@
 
 #include <CinderBox2D/Collision/cb2Collision.h>
 #include <CinderBox2D/Collision/cb2Distance.h>
+#include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
 
 void cb2WorldManifold::Initialize(const cb2Manifold* manifold,
 						  const cb2Transform& xfA, float radiusA,
@@ -250,3 +252,149 @@ bool cb2TestOverlap(	const cb2Shape* shapeA, int indexA,
 
 	return output.distance < 10.0f * cb2_epsilon;
 }
+
+bool cb2TestOverlap(	const cb2Shape* shapeA, int indexA,
+					const cb2Shape* shapeB, int indexB,
+					const cb2Transform& xfA, const cb2Transform& xfB,
+					cb2SimplexCache* cache)
+{
+	cb2DistanceInput input;
+	input.proxyA.set(shapeA, indexA);
+	input.proxyB.set(shapeB, indexB);
+	input.transformA = xfA;
+	input.transformB = xfB;
+	input.useRadii = true;
+
+	cb2DistanceOutput output;
+
+	cb2Distance(&output, cache, &input);
+
+	return output.distance < 10.0f * cb2_epsilon;
+}
+
+// Determine if a point in the frame of a polygon is closer than radius to the polygon
+// core, with the Voronoi regions of cb2CollidePolygonAndCircle.
+static bool cb2TestPointAndPolygon(const ci::Vec2f& p, const cb2PolygonShape* polygon, float radius)
+{
+	int normalIndex = 0;
+	float separation = -cb2_maxFloat;
+	int count = polygon->m_count;
+	const ci::Vec2f* vertices = polygon->m_vertices;
+	const ci::Vec2f* normals = polygon->m_normals;
+	for (int i = 0; i < count; ++i)
+	{
+		float s = cb2Dot(normals[i], p - vertices[i]);
+		if (s >= radius)
+		{
+			return false;
+		}
+
+		if (s > separation)
+		{
+			separation = s;
+			normalIndex = i;
+		}
+	}
+
+	if (separation <= 0.0f)
+	{
+		return true;
+	}
+
+	ci::Vec2f v1 = vertices[normalIndex];
+	ci::Vec2f v2 = vertices[normalIndex + 1 < count ? normalIndex + 1 : 0];
+	if (cb2Dot(p - v1, v2 - v1) <= 0.0f)
+	{
+		return cb2DistanceSquared(p, v1) < radius * radius;
+	}
+	if (cb2Dot(p - v2, v1 - v2) <= 0.0f)
+	{
+		return cb2DistanceSquared(p, v2) < radius * radius;
+	}
+	return true;
+}
+
+// Find the largest separation of poly2 along the edge normals of poly1.
+static float cb2PolygonSeparation(const cb2PolygonShape* poly1, const cb2Transform& xf1,
+								 const cb2PolygonShape* poly2, const cb2Transform& xf2)
+{
+	cb2Transform xf = cb2MulT(xf2, xf1);
+	float maxSeparation = -cb2_maxFloat;
+	for (int i = 0; i < poly1->m_count; ++i)
+	{
+		ci::Vec2f n = cb2Mul(xf.q, poly1->m_normals[i]);
+		ci::Vec2f v1 = cb2Mul(xf, poly1->m_vertices[i]);
+
+		float si = cb2_maxFloat;
+		for (int j = 0; j < poly2->m_count; ++j)
+		{
+			si = cb2Min(si, cb2Dot(n, poly2->m_vertices[j] - v1));
+		}
+		maxSeparation = cb2Max(maxSeparation, si);
+	}
+	return maxSeparation;
+}
+
+bool cb2TestOverlap(	const cb2Shape* shapeA, const cb2DistanceProxy& proxyA, const cb2Transform& xfA,
+					const cb2Shape* shapeB, int indexB, const cb2Transform& xfB)
+{
+	cb2Shape::Type typeA = shapeA->GetType();
+	cb2Shape::Type typeB = shapeB->GetType();
+
+	if (typeA == cb2Shape::e_circle && typeB == cb2Shape::e_circle)
+	{
+		const cb2CircleShape* circleA = (const cb2CircleShape*)shapeA;
+		const cb2CircleShape* circleB = (const cb2CircleShape*)shapeB;
+		float radius = circleA->m_radius + circleB->m_radius;
+		return cb2DistanceSquared(cb2Mul(xfA, circleA->m_p), cb2Mul(xfB, circleB->m_p)) < radius * radius;
+	}
+
+	if (typeA == cb2Shape::e_circle && typeB == cb2Shape::e_polygon)
+	{
+		const cb2CircleShape* circleA = (const cb2CircleShape*)shapeA;
+		const cb2PolygonShape* polygonB = (const cb2PolygonShape*)shapeB;
+		ci::Vec2f p = cb2MulT(xfB, cb2Mul(xfA, circleA->m_p));
+		return cb2TestPointAndPolygon(p, polygonB, circleA->m_radius + polygonB->m_radius);
+	}
+
+	if (typeA == cb2Shape::e_polygon && typeB == cb2Shape::e_circle)
+	{
+		const cb2PolygonShape* polygonA = (const cb2PolygonShape*)shapeA;
+		const cb2CircleShape* circleB = (const cb2CircleShape*)shapeB;
+		ci::Vec2f p = cb2MulT(xfA, cb2Mul(xfB, circleB->m_p));
+		return cb2TestPointAndPolygon(p, polygonA, polygonA->m_radius + circleB->m_radius);
+	}
+
+	if (typeA == cb2Shape::e_polygon && typeB == cb2Shape::e_polygon)
+	{
+		// Separating axes decide unless the cores are apart by less than the radii,
+		// where the rounded corners need the exact distance.
+		const cb2PolygonShape* polygonA = (const cb2PolygonShape*)shapeA;
+		const cb2PolygonShape* polygonB = (const cb2PolygonShape*)shapeB;
+		float separation = cb2Max(cb2PolygonSeparation(polygonA, xfA, polygonB, xfB), cb2PolygonSeparation(polygonB, xfB, polygonA, xfA));
+		if (separation >= polygonA->m_radius + polygonB->m_radius)
+		{
+			return false;
+		}
+		if (separation <= 0.0f)
+		{
+			return true;
+		}
+	}
+
+	cb2DistanceInput input;
+	input.proxyA = proxyA;
+	input.proxyB.set(shapeB, indexB);
+	input.transformA = xfA;
+	input.transformB = xfB;
+	input.useRadii = true;
+
+	cb2SimplexCache cache;
+	cache.count = 0;
+
+	cb2DistanceOutput output;
+
+	cb2Distance(&output, &cache, &input);
+
+	return output.distance < 10.0f * cb2_epsilon;
+}
@@ -27,9 +27,13 @@
 /// queries, and TOI queries.
 
 class cb2Shape;
+class cb2ChainShape;
 class cb2CircleShape;
 class cb2EdgeShape;
 class cb2PolygonShape;
+class cb2CapsuleShape;
+struct cb2SimplexCache;
+struct cb2DistanceProxy;
 
 const unsigned char cb2_nullFeature = UCHAR_MAX;
 
@@ -92,7 +96,7 @@ struct cb2ManifoldPoint
 /// This structure is stored across time steps, so we keep it small.
 struct cb2Manifold
 {
-	enum Type
+	enum Type : unsigned char
 	{
 		e_circles,
 		e_faceA,
@@ -103,7 +107,7 @@ struct cb2Manifold
 	ci::Vec2f localNormal;								///< not use for Type::e_points
 	ci::Vec2f localPoint;								///< usage depends on manifold type
 	Type type;
-	int pointCount;								///< the number of manifold points
+	unsigned char pointCount;					///< the number of manifold points
 };
 
 /// This is used to compute the current state of a contact manifold.
@@ -220,35 +224,163 @@ void cb2CollideCircles(cb2Manifold* manifold,
 					  const cb2CircleShape* circleA, const cb2Transform& xfA,
 					  const cb2CircleShape* circleB, const cb2Transform& xfB);
 
+/// Same as above, also keeping the points of shapes up to speculativeDistance apart.
+/// Such points have a positive separation. They let the solver stop a fast body
+/// before it reaches the other shape. The same holds for the overloads below.
+void cb2CollideCircles(cb2Manifold* manifold,
+					  const cb2CircleShape* circleA, const cb2Transform& xfA,
+					  const cb2CircleShape* circleB, const cb2Transform& xfB,
+					  float speculativeDistance);
+
 /// Compute the collision manifold between a polygon and a circle.
 void cb2CollidePolygonAndCircle(cb2Manifold* manifold,
 							   const cb2PolygonShape* polygonA, const cb2Transform& xfA,
 							   const cb2CircleShape* circleB, const cb2Transform& xfB);
 
+void cb2CollidePolygonAndCircle(cb2Manifold* manifold,
+							   const cb2PolygonShape* polygonA, const cb2Transform& xfA,
+							   const cb2CircleShape* circleB, const cb2Transform& xfB,
+							   float speculativeDistance);
+
 /// Compute the collision manifold between two polygons.
 void cb2CollidePolygons(cb2Manifold* manifold,
 					   const cb2PolygonShape* polygonA, const cb2Transform& xfA,
 					   const cb2PolygonShape* polygonB, const cb2Transform& xfB);
 
+/// Used to warm start cb2CollidePolygons between frames.
+/// Set state to e_empty on first call.
+struct cb2PolygonCache
+{
+	enum State : unsigned char
+	{
+		e_empty,
+		e_separated,
+		e_touching
+	};
+
+	State state;
+	unsigned char flip;		///< 1 if the edge belongs to polygon B
+	short edge;				///< the separating or reference edge
+	float margin;			///< how much the separations can move before the result changes
+	float radius;			///< the contact radius the margin was computed for
+	float extent;			///< bound on the vertex radii, turns rotation into distance
+	cb2Transform xf;		///< transform of B relative to A for a touching result
+};
+
+/// Compute the collision manifold between two polygons. The cache holds the separating
+/// axis or reference edge of the previous call. A separating axis is tested first. A
+/// reference edge is reused while the relative motion is too small to change the choice of
+/// the full search, so the result is the same as without the cache.
+void cb2CollidePolygons(cb2Manifold* manifold,
+					   const cb2PolygonShape* polygonA, const cb2Transform& xfA,
+					   const cb2PolygonShape* polygonB, const cb2Transform& xfB,
+					   cb2PolygonCache* cache);
+
+void cb2CollidePolygons(cb2Manifold* manifold,
+					   const cb2PolygonShape* polygonA, const cb2Transform& xfA,
+					   const cb2PolygonShape* polygonB, const cb2Transform& xfB,
+					   cb2PolygonCache* cache, float speculativeDistance);
+
 /// Compute the collision manifold between an edge and a circle.
 void cb2CollideEdgeAndCircle(cb2Manifold* manifold,
 							   const cb2EdgeShape* polygonA, const cb2Transform& xfA,
 							   const cb2CircleShape* circleB, const cb2Transform& xfB);
 
+void cb2CollideEdgeAndCircle(cb2Manifold* manifold,
+							   const cb2EdgeShape* polygonA, const cb2Transform& xfA,
+							   const cb2CircleShape* circleB, const cb2Transform& xfB,
+							   float speculativeDistance);
+
 /// Compute the collision manifold between an edge and a circle.
 void cb2CollideEdgeAndPolygon(cb2Manifold* manifold,
 							   const cb2EdgeShape* edgeA, const cb2Transform& xfA,
 							   const cb2PolygonShape* circleB, const cb2Transform& xfB);
 
+void cb2CollideEdgeAndPolygon(cb2Manifold* manifold,
+							   const cb2EdgeShape* edgeA, const cb2Transform& xfA,
+							   const cb2PolygonShape* circleB, const cb2Transform& xfB,
+							   float speculativeDistance);
+
+/// Compute the collision manifold between a child edge of a chain and a polygon. This reads
+/// the edge normals the chain keeps instead of making an edge shape.
+void cb2CollideEdgeAndPolygon(cb2Manifold* manifold,
+							   const cb2ChainShape* chainA, int childIndex, const cb2Transform& xfA,
+							   const cb2PolygonShape* polygonB, const cb2Transform& xfB,
+							   float speculativeDistance);
+
+/// Get the unit normal on the right of the segment from v1 to v2, as the edge collider
+/// uses for edges and for the edges of chains.
+ci::Vec2f cb2ComputeEdgeNormal(const ci::Vec2f& v1, const ci::Vec2f& v2);
+
+/// Compute the collision manifold between a capsule and a circle.
+void cb2CollideCapsuleAndCircle(cb2Manifold* manifold,
+							   const cb2CapsuleShape* capsuleA, const cb2Transform& xfA,
+							   const cb2CircleShape* circleB, const cb2Transform& xfB);
+
+void cb2CollideCapsuleAndCircle(cb2Manifold* manifold,
+							   const cb2CapsuleShape* capsuleA, const cb2Transform& xfA,
+							   const cb2CircleShape* circleB, const cb2Transform& xfB,
+							   float speculativeDistance);
+
+/// Compute the collision manifold between two capsules.
+void cb2CollideCapsules(cb2Manifold* manifold,
+					   const cb2CapsuleShape* capsuleA, const cb2Transform& xfA,
+					   const cb2CapsuleShape* capsuleB, const cb2Transform& xfB);
+
+void cb2CollideCapsules(cb2Manifold* manifold,
+					   const cb2CapsuleShape* capsuleA, const cb2Transform& xfA,
+					   const cb2CapsuleShape* capsuleB, const cb2Transform& xfB,
+					   float speculativeDistance);
+
+/// Compute the collision manifold between a polygon and a capsule.
+void cb2CollidePolygonAndCapsule(cb2Manifold* manifold,
+								const cb2PolygonShape* polygonA, const cb2Transform& xfA,
+								const cb2CapsuleShape* capsuleB, const cb2Transform& xfB);
+
+void cb2CollidePolygonAndCapsule(cb2Manifold* manifold,
+								const cb2PolygonShape* polygonA, const cb2Transform& xfA,
+								const cb2CapsuleShape* capsuleB, const cb2Transform& xfB,
+								float speculativeDistance);
+
+/// Compute the collision manifold between an edge and a capsule. Edges with adjacent
+/// vertices are smooth, as in cb2CollideEdgeAndPolygon.
+void cb2CollideEdgeAndCapsule(cb2Manifold* manifold,
+							 const cb2EdgeShape* edgeA, const cb2Transform& xfA,
+							 const cb2CapsuleShape* capsuleB, const cb2Transform& xfB);
+
+void cb2CollideEdgeAndCapsule(cb2Manifold* manifold,
+							 const cb2EdgeShape* edgeA, const cb2Transform& xfA,
+							 const cb2CapsuleShape* capsuleB, const cb2Transform& xfB,
+							 float speculativeDistance);
+
 /// Clipping for contact manifolds.
 int cb2ClipSegmentToLine(cb2ClipVertex vOut[2], const cb2ClipVertex vIn[2],
 							const ci::Vec2f& normal, float offset, int vertexIndexA);
 
+/// Determine if the segment p1 + t * d, t in [0, maxFraction], touches an AABB.
+bool cb2TestSegmentOverlap(const cb2AABB& aabb, const ci::Vec2f& p1, const ci::Vec2f& d, float maxFraction);
+
+/// Get the squared distance from a point to an AABB, zero if the point is inside.
+float cb2DistanceSquared(const cb2AABB& aabb, const ci::Vec2f& point);
+
 /// Determine if two generic shapes overlap.
 bool cb2TestOverlap(	const cb2Shape* shapeA, int indexA,
 					const cb2Shape* shapeB, int indexB,
 					const cb2Transform& xfA, const cb2Transform& xfB);
 
+/// Determine if two generic shapes overlap, warm starting from and updating the simplex
+/// cache of a previous test on the same shapes.
+bool cb2TestOverlap(	const cb2Shape* shapeA, int indexA,
+					const cb2Shape* shapeB, int indexB,
+					const cb2Transform& xfA, const cb2Transform& xfB,
+					cb2SimplexCache* cache);
+
+/// Determine if a shape overlaps a child of another shape, reusing the distance proxy of
+/// shape A across many tests. Circles and polygons are tested in closed form and with
+/// separating axes. Other shapes, and polygons closer than their radii, run cb2Distance.
+bool cb2TestOverlap(	const cb2Shape* shapeA, const cb2DistanceProxy& proxyA, const cb2Transform& xfA,
+					const cb2Shape* shapeB, int indexB, const cb2Transform& xfB);
+
 // ---------------- Inline Functions ------------------------------------------
 
 inline bool cb2AABB::IsValid() const
@@ -274,4 +406,57 @@ inline bool cb2TestOverlap(const cb2AABB& a, const cb2AABB& b)
 	return true;
 }
 
+inline float cb2DistanceSquared(const cb2AABB& aabb, const ci::Vec2f& point)
+{
+	float dx = cb2Max(cb2Max(aabb.lowerBound.x - point.x, point.x - aabb.upperBound.x), 0.0f);
+	float dy = cb2Max(cb2Max(aabb.lowerBound.y - point.y, point.y - aabb.upperBound.y), 0.0f);
+	return dx * dx + dy * dy;
+}
+
+inline ci::Vec2f cb2ComputeEdgeNormal(const ci::Vec2f& v1, const ci::Vec2f& v2)
+{
+	ci::Vec2f edge = v2 - v1;
+	edge.normalize();
+	return ci::Vec2f(edge.y, -edge.x);
+}
+
+inline bool cb2TestSegmentOverlap(const cb2AABB& aabb, const ci::Vec2f& p1, const ci::Vec2f& d, float maxFraction)
+{
+	float tmin = 0.0f;
+	float tmax = maxFraction;
+	for (int i = 0; i < 2; ++i)
+	{
+		float p = i == 0 ? p1.x : p1.y;
+		float di = i == 0 ? d.x : d.y;
+		float lower = i == 0 ? aabb.lowerBound.x : aabb.lowerBound.y;
+		float upper = i == 0 ? aabb.upperBound.x : aabb.upperBound.y;
+
+		if (cb2Abs(di) < cb2_epsilon)
+		{
+			if (p < lower || upper < p)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		float inv = 1.0f / di;
+		float t1 = (lower - p) * inv;
+		float t2 = (upper - p) * inv;
+		if (t1 > t2)
+		{
+			cb2Swap(t1, t2);
+		}
+
+		tmin = cb2Max(tmin, t1);
+		tmax = cb2Min(tmax, t2);
+		if (tmin > tmax)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 #endif
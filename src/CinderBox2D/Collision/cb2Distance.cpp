@@ -21,6 +21,9 @@
 #include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2HeightfieldShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CompoundShape.h>
 
 // GJK using Voronoi regions (Christer Ericson) and Barycentric coordinates.
 int cb2_gjkCalls, cb2_gjkIters, cb2_gjkMaxIters;
@@ -44,6 +47,13 @@ void cb2DistanceProxy::set(const cb2Shape* shape, int index)
 			m_vertices = polygon->m_vertices;
 			m_count = polygon->m_count;
 			m_radius = polygon->m_radius;
+
+			for (int i = 0; i < e_laneCount; ++i)
+			{
+				const ci::Vec2f& v = m_vertices[i < m_count ? i : 0];
+				m_laneX[i] = v.x;
+				m_laneY[i] = v.y;
+			}
 		}
 		break;
 
@@ -77,6 +87,36 @@ void cb2DistanceProxy::set(const cb2Shape* shape, int index)
 		}
 		break;
 
+	case cb2Shape::e_capsule:
+		{
+			const cb2CapsuleShape* capsule = static_cast<const cb2CapsuleShape*>(shape);
+			m_vertices = &capsule->m_vertex1;
+			m_count = 2;
+			m_radius = capsule->m_radius;
+		}
+		break;
+
+	case cb2Shape::e_heightfield:
+		{
+			const cb2HeightfieldShape* heightfield = static_cast<const cb2HeightfieldShape*>(shape);
+			m_buffer[0] = heightfield->GetVertex(index);
+			m_buffer[1] = heightfield->GetVertex(index + 1);
+			m_vertices = m_buffer;
+			m_count = 2;
+			m_radius = heightfield->m_radius;
+		}
+		break;
+
+	case cb2Shape::e_compound:
+		{
+			const cb2CompoundShape* compound = static_cast<const cb2CompoundShape*>(shape);
+			const cb2PolygonShape* piece = compound->GetChild(index);
+			m_vertices = piece->m_vertices;
+			m_count = piece->m_count;
+			m_radius = piece->m_radius;
+		}
+		break;
+
 	default:
 		cb2Assert(false);
 	}
@@ -601,3 +641,103 @@ void cb2Distance(cb2DistanceOutput* output,
 		}
 	}
 }
+
+bool cb2ShapeCast(cb2ShapeCastOutput* output, const cb2ShapeCastPairInput* input, cb2SimplexCache* cache)
+{
+	output->iterations = 0;
+	output->fraction = input->maxFraction;
+
+	float totalRadius = input->proxyA.m_radius + input->proxyB.m_radius;
+	float target = cb2Max(cb2_linearSlop, totalRadius - cb2_linearSlop);
+	float tolerance = 0.5f * cb2_linearSlop;
+	ci::Vec2f translation = input->translationB;
+
+	cb2DistanceInput distanceInput;
+	distanceInput.proxyA = input->proxyA;
+	distanceInput.proxyB = input->proxyB;
+	distanceInput.transformA = input->transformA;
+	distanceInput.transformB = input->transformB;
+	distanceInput.useRadii = false;
+
+	const int k_maxIterations = 20;
+	float fraction = 0.0f;
+	for (int iter = 0; iter < k_maxIterations; ++iter)
+	{
+		distanceInput.transformB.p = input->transformB.p + fraction * translation;
+
+		cb2DistanceOutput distanceOutput;
+		cb2Distance(&distanceOutput, cache, &distanceInput);
+		++output->iterations;
+
+		if (distanceOutput.distance < target + tolerance)
+		{
+			if (iter == 0)
+			{
+				// Initially overlapping.
+				return false;
+			}
+
+			// The advancement stops short of the core shapes, so the distance is positive.
+			ci::Vec2f normal = distanceOutput.pointB - distanceOutput.pointA;
+			if (distanceOutput.distance > cb2_epsilon)
+			{
+				normal /= distanceOutput.distance;
+			}
+			else
+			{
+				normal = -translation;
+				normal.normalize();
+			}
+			output->point = distanceOutput.pointA + input->proxyA.m_radius * normal;
+			output->normal = normal;
+			output->fraction = fraction;
+			return true;
+		}
+
+		ci::Vec2f normal = (distanceOutput.pointB - distanceOutput.pointA) / distanceOutput.distance;
+
+		// B must be closing in on A along the separating axis.
+		float speed = -cb2Dot(translation, normal);
+		if (speed <= 0.0f)
+		{
+			return false;
+		}
+
+		fraction += (distanceOutput.distance - target) / speed;
+		if (fraction > input->maxFraction)
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+cb2DistanceQuery::cb2DistanceQuery()
+{
+	m_cache.count = 0;
+}
+
+void cb2DistanceQuery::Set(const cb2Shape* shapeA, int indexA, const cb2Shape* shapeB, int indexB)
+{
+	m_proxyA.set(shapeA, indexA);
+	m_proxyB.set(shapeB, indexB);
+	m_cache.count = 0;
+}
+
+void cb2DistanceQuery::Compute(cb2DistanceOutput* output, const cb2Transform& xfA, const cb2Transform& xfB, bool useRadii)
+{
+	cb2DistanceInput input;
+	input.proxyA = m_proxyA;
+	input.proxyB = m_proxyB;
+	input.transformA = xfA;
+	input.transformB = xfB;
+	input.useRadii = useRadii;
+
+	cb2Distance(output, &m_cache, &input);
+}
+
+void cb2DistanceQuery::Reset()
+{
+	m_cache.count = 0;
+}
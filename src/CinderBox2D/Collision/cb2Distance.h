@@ -21,6 +21,7 @@
 #define CB2_DISTANCE_H
 
 #include <CinderBox2D/Common/cb2Math.h>
+#include <CinderBox2D/Common/cb2Simd.h>
 
 class cb2Shape;
 
@@ -46,10 +47,21 @@ struct cb2DistanceProxy
 	/// Get a vertex by index. Used by cb2Distance.
 	const ci::Vec2f& GetVertex(int index) const;
 
+	/// Lanes of the structure-of-arrays vertex mirror.
+	enum
+	{
+		e_laneCount = ((cb2_maxPolygonVertices + cb2_simdWidth - 1) / cb2_simdWidth) * cb2_simdWidth
+	};
+
 	ci::Vec2f m_buffer[2];
 	const ci::Vec2f* m_vertices;
 	int m_count;
 	float m_radius;
+
+	/// Polygon vertices as x and y lanes for the support search. Lanes past
+	/// m_count repeat vertex 0. Filled for polygons, used when m_count > 3.
+	float m_laneX[e_laneCount];
+	float m_laneY[e_laneCount];
 };
 
 /// Used to warm start cb2Distance.
@@ -90,6 +102,58 @@ void cb2Distance(cb2DistanceOutput* output,
 				cb2SimplexCache* cache, 
 				const cb2DistanceInput* input);
 
+/// Input parameters for cb2ShapeCast. Proxy B moves by translationB times the
+/// fraction, proxy A stays fixed.
+struct cb2ShapeCastPairInput
+{
+	cb2DistanceProxy proxyA;
+	cb2DistanceProxy proxyB;
+	cb2Transform transformA;
+	cb2Transform transformB;
+	ci::Vec2f translationB;
+	float maxFraction;
+};
+
+/// Output results for cb2ShapeCast.
+struct cb2ShapeCastOutput
+{
+	ci::Vec2f point;		///< contact point on the surface of A
+	ci::Vec2f normal;		///< surface normal of A at the point, towards B
+	float fraction;			///< fraction of translationB where the shapes touch
+	int iterations;			///< number of conservative advancement steps
+};
+
+/// Sweep proxy B along its translation until it touches proxy A, using conservative
+/// advancement on the distance. Each step advances by the distance divided by the closing
+/// speed, so it never passes the first contact. The simplex cache is input/output and
+/// warm starts every step, set cb2SimplexCache.count to zero on the first call.
+/// @return false if the shapes do not touch before maxFraction or overlap at the start.
+bool cb2ShapeCast(cb2ShapeCastOutput* output, const cb2ShapeCastPairInput* input, cb2SimplexCache* cache);
+
+/// A distance query between two shapes that keeps its simplex cache between calls.
+/// When the shapes move a little between calls, GJK starts from the previous closest
+/// features and usually converges in one or two iterations.
+class cb2DistanceQuery
+{
+public:
+	cb2DistanceQuery();
+
+	/// Set the shapes and flush the cache. The shapes must remain in scope while
+	/// the query is in use.
+	void Set(const cb2Shape* shapeA, int indexA, const cb2Shape* shapeB, int indexB);
+
+	/// Compute the closest points for the given transforms.
+	void Compute(cb2DistanceOutput* output, const cb2Transform& xfA, const cb2Transform& xfB, bool useRadii);
+
+	/// Flush the cache, e.g. after a teleport.
+	void Reset();
+
+private:
+	cb2DistanceProxy m_proxyA;
+	cb2DistanceProxy m_proxyB;
+	cb2SimplexCache m_cache;
+};
+
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -106,23 +170,46 @@ inline const ci::Vec2f& cb2DistanceProxy::GetVertex(int index) const
 
 inline int cb2DistanceProxy::GetSupport(const ci::Vec2f& d) const
 {
-	int bestIndex = 0;
-	float bestValue = cb2Dot(m_vertices[0], d);
-	for (int i = 1; i < m_count; ++i)
+	if (m_count > 3)
 	{
-		float value = cb2Dot(m_vertices[i], d);
-		if (value > bestValue)
+		// Dot products cb2_simdWidth vertices at a time, then the first lane holding the maximum.
+		cb2FloatW dx = cb2SplatW(d.x);
+		cb2FloatW dy = cb2SplatW(d.y);
+		cb2FloatW values[e_laneCount / cb2_simdWidth];
+		cb2FloatW maxValue = cb2SplatW(-cb2_maxFloat);
+		int groupCount = (m_count + cb2_simdWidth - 1) / cb2_simdWidth;
+		for (int i = 0; i < groupCount; ++i)
 		{
-			bestIndex = i;
-			bestValue = value;
+			int lane = i * cb2_simdWidth;
+			values[i] = cb2AddW(cb2MulW(cb2LoadW(m_laneX + lane), dx), cb2MulW(cb2LoadW(m_laneY + lane), dy));
+			maxValue = cb2MaxW(maxValue, values[i]);
 		}
-	}
 
-	return bestIndex;
-}
+		float lanes[cb2_simdWidth];
+		cb2StoreW(lanes, maxValue);
+		float bestValue = lanes[0];
+		for (int i = 1; i < cb2_simdWidth; ++i)
+		{
+			bestValue = cb2Max(bestValue, lanes[i]);
+		}
+
+		cb2FloatW best = cb2SplatW(bestValue);
+		for (int i = 0; i < groupCount; ++i)
+		{
+			int mask = cb2MaskLessEqualW(best, values[i]);
+			if (mask != 0)
+			{
+				int bestIndex = i * cb2_simdWidth;
+				while ((mask & 1) == 0)
+				{
+					mask >>= 1;
+					++bestIndex;
+				}
+				return bestIndex;
+			}
+		}
+	}
 
-inline const ci::Vec2f& cb2DistanceProxy::GetSupportVertex(const ci::Vec2f& d) const
-{
 	int bestIndex = 0;
 	float bestValue = cb2Dot(m_vertices[0], d);
 	for (int i = 1; i < m_count; ++i)
@@ -135,7 +222,12 @@ inline const ci::Vec2f& cb2DistanceProxy::GetSupportVertex(const ci::Vec2f& d) c
 		}
 	}
 
-	return m_vertices[bestIndex];
+	return bestIndex;
+}
+
+inline const ci::Vec2f& cb2DistanceProxy::GetSupportVertex(const ci::Vec2f& d) const
+{
+	return m_vertices[GetSupport(d)];
 }
 
 #endif
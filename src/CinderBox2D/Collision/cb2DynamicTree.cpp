@@ -17,16 +17,34 @@
 */
 
 #include <CinderBox2D/Collision/cb2DynamicTree.h>
+#include <CinderBox2D/Collision/cb2TreeBuild.h>
 #include <memory.h>
 
+const int cb2_cacheLineSize = 64;
+
+// Allocate the node pool aligned to a cache line, followed by the user data and layer arrays.
+static cb2TreeNode* cb2AllocNodes(int capacity, void** memory, void*** userData, unsigned int** layers)
+{
+	int nodeSize = capacity * sizeof(cb2TreeNode);
+	int userDataSize = capacity * sizeof(void*);
+	*memory = cb2Alloc(nodeSize + userDataSize + capacity * sizeof(unsigned int), cb2_cacheLineSize, cb2_memoryTree);
+
+	cb2TreeNode* nodes = (cb2TreeNode*)*memory;
+	*userData = (void**)((char*)*memory + nodeSize);
+	*layers = (unsigned int*)((char*)*memory + nodeSize + userDataSize);
+	return nodes;
+}
+
 cb2DynamicTree::cb2DynamicTree()
 {
 	m_root = cb2_nullNode;
 
 	m_nodeCapacity = 16;
 	m_nodeCount = 0;
-	m_nodes = (cb2TreeNode*)cb2Alloc(m_nodeCapacity * sizeof(cb2TreeNode));
+	m_nodes = cb2AllocNodes(m_nodeCapacity, &m_nodeMemory, &m_userData, &m_layers);
 	memset(m_nodes, 0, m_nodeCapacity * sizeof(cb2TreeNode));
+	memset(m_userData, 0, m_nodeCapacity * sizeof(void*));
+	memset(m_layers, 0, m_nodeCapacity * sizeof(unsigned int));
 
 	// Build a linked list for the free list.
 	for (int i = 0; i < m_nodeCapacity - 1; ++i)
@@ -41,12 +59,35 @@ cb2DynamicTree::cb2DynamicTree()
 	m_path = 0;
 
 	m_insertionCount = 0;
+
+	m_bulkInsert = false;
 }
 
 cb2DynamicTree::~cb2DynamicTree()
 {
 	// This frees the entire tree in one shot.
-	cb2Free(m_nodes);
+	cb2Free(m_nodeMemory, cb2_memoryTree);
+}
+
+void cb2DynamicTree::Copy(const cb2DynamicTree& tree)
+{
+	if (m_nodeCapacity != tree.m_nodeCapacity)
+	{
+		cb2Free(m_nodeMemory, cb2_memoryTree);
+		m_nodeCapacity = tree.m_nodeCapacity;
+		m_nodes = cb2AllocNodes(m_nodeCapacity, &m_nodeMemory, &m_userData, &m_layers);
+	}
+
+	memcpy(m_nodes, tree.m_nodes, m_nodeCapacity * sizeof(cb2TreeNode));
+	memcpy(m_userData, tree.m_userData, m_nodeCapacity * sizeof(void*));
+	memcpy(m_layers, tree.m_layers, m_nodeCapacity * sizeof(unsigned int));
+
+	m_root = tree.m_root;
+	m_nodeCount = tree.m_nodeCount;
+	m_freeList = tree.m_freeList;
+	m_path = tree.m_path;
+	m_insertionCount = tree.m_insertionCount;
+	m_bulkInsert = tree.m_bulkInsert;
 }
 
 // Allocate a node from the pool. Grow the pool if necessary.
@@ -56,24 +97,7 @@ int cb2DynamicTree::AllocateNode()
 	if (m_freeList == cb2_nullNode)
 	{
 		cb2Assert(m_nodeCount == m_nodeCapacity);
-
-		// The free list is empty. Rebuild a bigger pool.
-		cb2TreeNode* oldNodes = m_nodes;
-		m_nodeCapacity *= 2;
-		m_nodes = (cb2TreeNode*)cb2Alloc(m_nodeCapacity * sizeof(cb2TreeNode));
-		memcpy(m_nodes, oldNodes, m_nodeCount * sizeof(cb2TreeNode));
-		cb2Free(oldNodes);
-
-		// Build a linked list for the free list. The parent
-		// pointer becomes the "next" pointer.
-		for (int i = m_nodeCount; i < m_nodeCapacity - 1; ++i)
-		{
-			m_nodes[i].next = i + 1;
-			m_nodes[i].height = -1;
-		}
-		m_nodes[m_nodeCapacity-1].next = cb2_nullNode;
-		m_nodes[m_nodeCapacity-1].height = -1;
-		m_freeList = m_nodeCount;
+		GrowPool(2 * m_nodeCapacity);
 	}
 
 	// Peel a node off the free list.
@@ -83,11 +107,58 @@ int cb2DynamicTree::AllocateNode()
 	m_nodes[nodeId].child1 = cb2_nullNode;
 	m_nodes[nodeId].child2 = cb2_nullNode;
 	m_nodes[nodeId].height = 0;
-	m_nodes[nodeId].userData = NULL;
+	m_userData[nodeId] = NULL;
+	m_layers[nodeId] = 0;
 	++m_nodeCount;
 	return nodeId;
 }
 
+// Rebuild a bigger pool. The new nodes go in front of the free list.
+void cb2DynamicTree::GrowPool(int capacity)
+{
+	cb2Assert(capacity > m_nodeCapacity);
+
+	cb2TreeNode* oldNodes = m_nodes;
+	void** oldUserData = m_userData;
+	unsigned int* oldLayers = m_layers;
+	void* oldMemory = m_nodeMemory;
+	int oldCapacity = m_nodeCapacity;
+	m_nodeCapacity = capacity;
+	m_nodes = cb2AllocNodes(m_nodeCapacity, &m_nodeMemory, &m_userData, &m_layers);
+	memcpy(m_nodes, oldNodes, oldCapacity * sizeof(cb2TreeNode));
+	memcpy(m_userData, oldUserData, oldCapacity * sizeof(void*));
+	memcpy(m_layers, oldLayers, oldCapacity * sizeof(unsigned int));
+	cb2Free(oldMemory, cb2_memoryTree);
+
+	// Build a linked list for the free list. The parent
+	// pointer becomes the "next" pointer.
+	for (int i = oldCapacity; i < m_nodeCapacity - 1; ++i)
+	{
+		m_nodes[i].next = i + 1;
+		m_nodes[i].height = -1;
+	}
+	m_nodes[m_nodeCapacity-1].next = m_freeList;
+	m_nodes[m_nodeCapacity-1].height = -1;
+	m_freeList = oldCapacity;
+}
+
+void cb2DynamicTree::Reserve(int proxyCount)
+{
+	// A tree of n leaves has n - 1 internal nodes.
+	int nodeCount = 2 * proxyCount - 1;
+	if (nodeCount <= m_nodeCapacity)
+	{
+		return;
+	}
+
+	int capacity = m_nodeCapacity;
+	while (capacity < nodeCount)
+	{
+		capacity *= 2;
+	}
+	GrowPool(capacity);
+}
+
 // Return a node to the pool.
 void cb2DynamicTree::FreeNode(int nodeId)
 {
@@ -102,7 +173,7 @@ void cb2DynamicTree::FreeNode(int nodeId)
 // Create a proxy in the tree as a leaf node. We return the index
 // of the node instead of a pointer so that we can grow
 // the node pool.
-int cb2DynamicTree::CreateProxy(const cb2AABB& aabb, void* userData)
+int cb2DynamicTree::CreateProxy(const cb2AABB& aabb, void* userData, unsigned int layers)
 {
 	int proxyId = AllocateNode();
 
@@ -110,10 +181,14 @@ int cb2DynamicTree::CreateProxy(const cb2AABB& aabb, void* userData)
 	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
 	m_nodes[proxyId].aabb.lowerBound = aabb.lowerBound - r;
 	m_nodes[proxyId].aabb.upperBound = aabb.upperBound + r;
-	m_nodes[proxyId].userData = userData;
+	m_userData[proxyId] = userData;
+	m_layers[proxyId] = layers;
 	m_nodes[proxyId].height = 0;
 
-	InsertLeaf(proxyId);
+	if (m_bulkInsert == false)
+	{
+		InsertLeaf(proxyId);
+	}
 
 	return proxyId;
 }
@@ -123,7 +198,10 @@ void cb2DynamicTree::DestroyProxy(int proxyId)
 	cb2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
 	cb2Assert(m_nodes[proxyId].IsLeaf());
 
-	RemoveLeaf(proxyId);
+	if (IsInTree(proxyId))
+	{
+		RemoveLeaf(proxyId);
+	}
 	FreeNode(proxyId);
 }
 
@@ -138,8 +216,12 @@ bool cb2DynamicTree::MoveProxy(int proxyId, const cb2AABB& aabb, const ci::Vec2f
 		return false;
 	}
 
-	RemoveLeaf(proxyId);
+	SetFatAABB(proxyId, ComputeFatAABB(aabb, displacement));
+	return true;
+}
 
+cb2AABB cb2DynamicTree::ComputeFatAABB(const cb2AABB& aabb, const ci::Vec2f& displacement)
+{
 	// Extend AABB.
 	cb2AABB b = aabb;
 	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
@@ -167,12 +249,97 @@ bool cb2DynamicTree::MoveProxy(int proxyId, const cb2AABB& aabb, const ci::Vec2f
 		b.upperBound.y += d.y;
 	}
 
-	m_nodes[proxyId].aabb = b;
+	return b;
+}
+
+bool cb2DynamicTree::RefitProxy(int proxyId, const cb2AABB& aabb, const ci::Vec2f& displacement)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	cb2Assert(m_nodes[proxyId].IsLeaf());
+
+	cb2TreeNode* leaf = m_nodes + proxyId;
+	if (leaf->aabb.Contains(aabb))
+	{
+		return false;
+	}
+
+	cb2AABB fatAABB = ComputeFatAABB(aabb, displacement);
+
+	// A proxy that jumped away would stretch every box above it, so it is re-inserted.
+	if (m_bulkInsert || IsInTree(proxyId) == false || cb2TestOverlap(leaf->aabb, fatAABB) == false)
+	{
+		SetFatAABB(proxyId, fatAABB);
+		return true;
+	}
+
+	leaf->aabb = fatAABB;
+
+	// Refit the ancestors until a box does not change, the boxes above it are then right.
+	int index = leaf->parent;
+	while (index != cb2_nullNode)
+	{
+		cb2TreeNode* node = m_nodes + index;
+		cb2AABB box;
+		box.Combine(m_nodes[node->child1].aabb, m_nodes[node->child2].aabb);
+		if (box.lowerBound == node->aabb.lowerBound && box.upperBound == node->aabb.upperBound)
+		{
+			break;
+		}
+
+		node->aabb = box;
+		index = node->parent;
+	}
 
-	InsertLeaf(proxyId);
 	return true;
 }
 
+void cb2DynamicTree::SetFatAABB(int proxyId, const cb2AABB& fatAABB)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	cb2Assert(m_nodes[proxyId].IsLeaf());
+
+	if (IsInTree(proxyId))
+	{
+		RemoveLeaf(proxyId);
+		m_nodes[proxyId].parent = cb2_nullNode;
+	}
+
+	m_nodes[proxyId].aabb = fatAABB;
+
+	if (m_bulkInsert == false)
+	{
+		InsertLeaf(proxyId);
+	}
+}
+
+// Leaves created during a bulk insert have no parent until the tree is built.
+bool cb2DynamicTree::IsInTree(int leaf) const
+{
+	return leaf == m_root || m_nodes[leaf].parent != cb2_nullNode;
+}
+
+void cb2DynamicTree::SetLayers(int proxyId, unsigned int layers)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	cb2Assert(m_nodes[proxyId].IsLeaf());
+
+	m_layers[proxyId] = layers;
+
+	// Update the unions above the leaf until one does not change.
+	int index = m_nodes[proxyId].parent;
+	while (index != cb2_nullNode)
+	{
+		unsigned int unionLayers = m_layers[m_nodes[index].child1] | m_layers[m_nodes[index].child2];
+		if (m_layers[index] == unionLayers)
+		{
+			break;
+		}
+
+		m_layers[index] = unionLayers;
+		index = m_nodes[index].parent;
+	}
+}
+
 void cb2DynamicTree::InsertLeaf(int leaf)
 {
 	++m_insertionCount;
@@ -261,9 +428,10 @@ void cb2DynamicTree::InsertLeaf(int leaf)
 	int oldParent = m_nodes[sibling].parent;
 	int newParent = AllocateNode();
 	m_nodes[newParent].parent = oldParent;
-	m_nodes[newParent].userData = NULL;
+	m_userData[newParent] = NULL;
 	m_nodes[newParent].aabb.Combine(leafAABB, m_nodes[sibling].aabb);
 	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_layers[newParent] = m_layers[leaf] | m_layers[sibling];
 
 	if (oldParent != cb2_nullNode)
 	{
@@ -306,6 +474,7 @@ void cb2DynamicTree::InsertLeaf(int leaf)
 
 		m_nodes[index].height = 1 + cb2Max(m_nodes[child1].height, m_nodes[child2].height);
 		m_nodes[index].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+		m_layers[index] = m_layers[child1] | m_layers[child2];
 
 		index = m_nodes[index].parent;
 	}
@@ -358,6 +527,7 @@ void cb2DynamicTree::RemoveLeaf(int leaf)
 
 			m_nodes[index].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
 			m_nodes[index].height = 1 + cb2Max(m_nodes[child1].height, m_nodes[child2].height);
+			m_layers[index] = m_layers[child1] | m_layers[child2];
 
 			index = m_nodes[index].parent;
 		}
@@ -435,6 +605,8 @@ int cb2DynamicTree::Balance(int iA)
 			G->parent = iA;
 			A->aabb.Combine(B->aabb, G->aabb);
 			C->aabb.Combine(A->aabb, F->aabb);
+			m_layers[iA] = m_layers[iB] | m_layers[iG];
+			m_layers[iC] = m_layers[iA] | m_layers[iF];
 
 			A->height = 1 + cb2Max(B->height, G->height);
 			C->height = 1 + cb2Max(A->height, F->height);
@@ -446,6 +618,8 @@ int cb2DynamicTree::Balance(int iA)
 			F->parent = iA;
 			A->aabb.Combine(B->aabb, F->aabb);
 			C->aabb.Combine(A->aabb, G->aabb);
+			m_layers[iA] = m_layers[iB] | m_layers[iF];
+			m_layers[iC] = m_layers[iA] | m_layers[iG];
 
 			A->height = 1 + cb2Max(B->height, F->height);
 			C->height = 1 + cb2Max(A->height, G->height);
@@ -495,6 +669,8 @@ int cb2DynamicTree::Balance(int iA)
 			E->parent = iA;
 			A->aabb.Combine(C->aabb, E->aabb);
 			B->aabb.Combine(A->aabb, D->aabb);
+			m_layers[iA] = m_layers[iC] | m_layers[iE];
+			m_layers[iB] = m_layers[iA] | m_layers[iD];
 
 			A->height = 1 + cb2Max(C->height, E->height);
 			B->height = 1 + cb2Max(A->height, D->height);
@@ -506,6 +682,8 @@ int cb2DynamicTree::Balance(int iA)
 			D->parent = iA;
 			A->aabb.Combine(C->aabb, D->aabb);
 			B->aabb.Combine(A->aabb, E->aabb);
+			m_layers[iA] = m_layers[iC] | m_layers[iD];
+			m_layers[iB] = m_layers[iA] | m_layers[iE];
 
 			A->height = 1 + cb2Max(C->height, D->height);
 			B->height = 1 + cb2Max(A->height, E->height);
@@ -645,6 +823,7 @@ void cb2DynamicTree::ValidateMetrics(int index) const
 
 	cb2Assert(aabb.lowerBound == node->aabb.lowerBound);
 	cb2Assert(aabb.upperBound == node->aabb.upperBound);
+	cb2Assert(m_layers[index] == (m_layers[child1] | m_layers[child2]));
 
 	ValidateMetrics(child1);
 	ValidateMetrics(child2);
@@ -693,7 +872,7 @@ int cb2DynamicTree::GetMaxBalance() const
 
 void cb2DynamicTree::RebuildBottomUp()
 {
-	int* nodes = (int*)cb2Alloc(m_nodeCount * sizeof(int));
+	int* nodes = (int*)cb2Alloc(m_nodeCount * sizeof(int), cb2_defaultAlignment, cb2_memoryTree);
 	int count = 0;
 
 	// Build array of leaves. Free the rest.
@@ -752,6 +931,7 @@ void cb2DynamicTree::RebuildBottomUp()
 		parent->height = 1 + cb2Max(child1->height, child2->height);
 		parent->aabb.Combine(child1->aabb, child2->aabb);
 		parent->parent = cb2_nullNode;
+		m_layers[parentIndex] = m_layers[index1] | m_layers[index2];
 
 		child1->parent = parentIndex;
 		child2->parent = parentIndex;
@@ -762,11 +942,176 @@ void cb2DynamicTree::RebuildBottomUp()
 	}
 
 	m_root = nodes[0];
-	cb2Free(nodes);
+	cb2Free(nodes, cb2_memoryTree);
 
 	Validate();
 }
 
+void cb2DynamicTree::Optimize(int leafCount)
+{
+	if (m_root == cb2_nullNode || leafCount < 2)
+	{
+		return;
+	}
+
+	// A subtree of height h has at most 2^h leaves.
+	int maxHeight = 0;
+	while (maxHeight < 30 && (2 << maxHeight) <= leafCount)
+	{
+		++maxHeight;
+	}
+
+	// Descend using the bits of the path counter to select the children.
+	int index = m_root;
+	unsigned int bit = 0;
+	while (m_nodes[index].height > maxHeight)
+	{
+		int selector = (m_path >> bit) & 1;
+		index = selector == 0 ? m_nodes[index].child1 : m_nodes[index].child2;
+
+		// Keep bit between 0 and 31 because m_path has 32 bits
+		bit = (bit + 1) & 0x1F;
+	}
+	++m_path;
+
+	if (m_nodes[index].height < 2)
+	{
+		// Nothing to improve.
+		return;
+	}
+
+	// Gather the leaves of the subtree and free its internal nodes.
+	int parent = m_nodes[index].parent;
+	int* leaves = (int*)cb2Alloc((1 << m_nodes[index].height) * sizeof(int), cb2_defaultAlignment, cb2_memoryTree);
+	int count = 0;
+
+	cb2GrowableStack<int, 256> stack;
+	stack.Push(index);
+	while (stack.GetCount() > 0)
+	{
+		int nodeId = stack.Pop();
+		if (m_nodes[nodeId].IsLeaf())
+		{
+			leaves[count++] = nodeId;
+			continue;
+		}
+
+		stack.Push(m_nodes[nodeId].child1);
+		stack.Push(m_nodes[nodeId].child2);
+		FreeNode(nodeId);
+	}
+
+	int subtree = BuildTopDown(leaves, count);
+	cb2Free(leaves, cb2_memoryTree);
+
+	// Attach the new subtree and fix the heights above it. The boxes do not change.
+	m_nodes[subtree].parent = parent;
+	if (parent == cb2_nullNode)
+	{
+		m_root = subtree;
+		return;
+	}
+
+	if (m_nodes[parent].child1 == index)
+	{
+		m_nodes[parent].child1 = subtree;
+	}
+	else
+	{
+		m_nodes[parent].child2 = subtree;
+	}
+
+	while (parent != cb2_nullNode)
+	{
+		cb2TreeNode* node = m_nodes + parent;
+		node->height = 1 + cb2Max(m_nodes[node->child1].height, m_nodes[node->child2].height);
+		parent = node->parent;
+	}
+}
+
+void cb2DynamicTree::RebuildTopDown()
+{
+	int* leaves = (int*)cb2Alloc(cb2Max(m_nodeCount, 1) * sizeof(int), cb2_defaultAlignment, cb2_memoryTree);
+	int count = 0;
+
+	// Build array of leaves. Free the rest.
+	for (int i = 0; i < m_nodeCapacity; ++i)
+	{
+		if (m_nodes[i].height < 0)
+		{
+			// free node in pool
+			continue;
+		}
+
+		if (m_nodes[i].IsLeaf())
+		{
+			m_nodes[i].parent = cb2_nullNode;
+			leaves[count] = i;
+			++count;
+		}
+		else
+		{
+			FreeNode(i);
+		}
+	}
+
+	if (count > 0)
+	{
+		m_root = BuildTopDown(leaves, count);
+		m_nodes[m_root].parent = cb2_nullNode;
+	}
+	else
+	{
+		m_root = cb2_nullNode;
+	}
+
+	cb2Free(leaves, cb2_memoryTree);
+}
+
+int cb2DynamicTree::BuildTopDown(int* leaves, int count)
+{
+	if (count == 1)
+	{
+		return leaves[0];
+	}
+
+	int leftCount = cb2PartitionSAH(leaves, count, m_nodes);
+	int index1 = BuildTopDown(leaves, leftCount);
+	int index2 = BuildTopDown(leaves + leftCount, count - leftCount);
+
+	// Allocating may grow the pool, so pointers are taken afterwards.
+	int parentIndex = AllocateNode();
+	cb2TreeNode* parent = m_nodes + parentIndex;
+	cb2TreeNode* child1 = m_nodes + index1;
+	cb2TreeNode* child2 = m_nodes + index2;
+	parent->child1 = index1;
+	parent->child2 = index2;
+	parent->height = 1 + cb2Max(child1->height, child2->height);
+	parent->aabb.Combine(child1->aabb, child2->aabb);
+	m_layers[parentIndex] = m_layers[index1] | m_layers[index2];
+
+	child1->parent = parentIndex;
+	child2->parent = parentIndex;
+
+	return parentIndex;
+}
+
+void cb2DynamicTree::BeginBulkInsert()
+{
+	m_bulkInsert = true;
+}
+
+void cb2DynamicTree::EndBulkInsert()
+{
+	if (m_bulkInsert == false)
+	{
+		return;
+	}
+
+	m_bulkInsert = false;
+	RebuildTopDown();
+}
+
 void cb2DynamicTree::ShiftOrigin(const ci::Vec2f& newOrigin)
 {
 	// Build array of leaves. Free the rest.
@@ -20,11 +20,16 @@
 #define CB2_DYNAMIC_TREE_H
 
 #include <CinderBox2D/Collision/cb2Collision.h>
+#include <CinderBox2D/Common/cb2GrowableHeap.h>
 #include <CinderBox2D/Common/cb2GrowableStack.h>
+#include <CinderBox2D/Common/cb2Simd.h>
 
 #define cb2_nullNode (-1)
 
 /// A node in the dynamic tree. The client does not interact with this directly.
+/// Nodes are 32 bytes and the pool is aligned so that a node never straddles a
+/// cache line. The user data and the layer bits are kept in side arrays since
+/// most traversals never read them.
 struct cb2TreeNode
 {
 	bool IsLeaf() const
@@ -35,8 +40,6 @@ struct cb2TreeNode
 	/// Enlarged AABB
 	cb2AABB aabb;
 
-	void* userData;
-
 	union
 	{
 		int parent;
@@ -68,7 +71,8 @@ public:
 	~cb2DynamicTree();
 
 	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
-	int CreateProxy(const cb2AABB& aabb, void* userData);
+	/// The layer bits are the layers the proxy belongs to. See SetLayers.
+	int CreateProxy(const cb2AABB& aabb, void* userData, unsigned int layers = 0xFFFFFFFF);
 
 	/// Destroy a proxy. This asserts if the id is invalid.
 	void DestroyProxy(int proxyId);
@@ -79,18 +83,61 @@ public:
 	/// @return true if the proxy was re-inserted.
 	bool MoveProxy(int proxyId, const cb2AABB& aabb1, const ci::Vec2f& displacement);
 
+	/// Move a proxy like MoveProxy, but keep the leaf in place and refit the boxes above
+	/// it when the new fat AABB overlaps the old one. The proxy is re-inserted otherwise.
+	/// @return true if the proxy got a new fat AABB.
+	bool RefitProxy(int proxyId, const cb2AABB& aabb, const ci::Vec2f& displacement);
+
+	/// Re-insert a proxy with this fattened AABB as is.
+	void SetFatAABB(int proxyId, const cb2AABB& fatAABB);
+
 	/// Get proxy user data.
 	/// @return the proxy user data or 0 if the id is invalid.
 	void* GetUserData(int proxyId) const;
 
+	/// Set proxy user data.
+	void SetUserData(int proxyId, void* userData);
+
 	/// Get the fat AABB for a proxy.
 	const cb2AABB& GetFatAABB(int proxyId) const;
 
+	/// Set the layer bits of a proxy. Each internal node holds the union of the
+	/// layers below it, so a masked query can skip whole subtrees.
+	void SetLayers(int proxyId, unsigned int layers);
+
+	/// Get the layer bits of a node.
+	unsigned int GetLayers(int nodeId) const;
+
+	/// Make this tree a copy of another tree. Proxy ids and user data are kept.
+	void Copy(const cb2DynamicTree& tree);
+
+	/// Grow the node pool so it holds proxyCount proxies without reallocating.
+	void Reserve(int proxyCount);
+
 	/// Query an AABB for overlapping proxies. The callback class
 	/// is called for each proxy that overlaps the supplied AABB.
 	template <typename T>
 	void Query(T* callback, const cb2AABB& aabb) const;
 
+	/// Query an AABB for overlapping proxies that have one of the layers of layerMask.
+	/// Subtrees without any of these layers are not visited.
+	template <typename T>
+	void Query(T* callback, const cb2AABB& aabb, unsigned int layerMask) const;
+
+	/// Visit the proxies nearest to a point first, in order of the distance to their
+	/// boxes. The callback is called with callback->ClosestCallback(proxyId) and returns
+	/// the new search distance, usually the distance of the farthest result it keeps.
+	/// Proxies whose boxes are farther are never visited. Return a negative value to stop.
+	template <typename T>
+	void QueryClosest(T* callback, const ci::Vec2f& point, float maxDistance) const;
+
+	/// Query many AABBs at once. Queries are traversed in groups of 32 consecutive
+	/// entries of order, testing each node once per group, so order should keep
+	/// nearby boxes together. The callback is called with callback->QueryCallback(queryIndex, proxyId)
+	/// for each proxy that overlaps a box and can stop the whole batch by returning false.
+	template <typename T>
+	void QueryBatch(T* callback, const cb2AABB* aabbs, const int* order, int count) const;
+
 	/// Ray-cast against the proxies in the tree. This relies on the callback
 	/// to perform a exact ray-cast in the case were the proxy contains a shape.
 	/// The callback also performs the any collision filtering. This has performance
@@ -101,6 +148,14 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const cb2RayCastInput& input) const;
 
+	/// Ray-cast many segments at once. Rays are traversed in packets of four consecutive
+	/// entries of order, and each node is tested against a packet with SIMD slab tests.
+	/// The callback is called with callback->RayCastCallback(rayIndex, subInput, proxyId) and
+	/// returns a value as in RayCast, which clips or terminates that ray only.
+	/// @param fractions receives the final max fraction of each ray, or zero if it was terminated.
+	template <typename T>
+	void RayCastBatch(T* callback, const cb2RayCastInput* inputs, const int* order, int count, float* fractions) const;
+
 	/// Validate this tree. For testing.
 	void Validate() const;
 
@@ -115,9 +170,37 @@ public:
 	/// Get the ratio of the sum of the node areas to the root area.
 	float GetAreaRatio() const;
 
+	/// Get the number of nodes in use, leaves and internal nodes.
+	int GetNodeCount() const { return m_nodeCount; }
+
+	/// Get the number of nodes the pool holds.
+	int GetNodeCapacity() const { return m_nodeCapacity; }
+
+	/// Get the bytes of the node pool.
+	int GetMemory() const { return m_nodeCapacity * (int)(sizeof(cb2TreeNode) + sizeof(void*) + sizeof(unsigned int)); }
+
 	/// Build an optimal tree. Very expensive. For testing.
 	void RebuildBottomUp();
 
+	/// Improve the tree incrementally by rebuilding one subtree of at most leafCount
+	/// leaves top-down. Successive calls walk different paths of the tree, so over
+	/// time the whole tree is visited.
+	void Optimize(int leafCount);
+
+	/// Build the tree top-down from all leaves with a binned surface area heuristic.
+	/// This takes O(n log n) time and usually gives a better tree than incremental insertion.
+	void RebuildTopDown();
+
+	/// Stop inserting new proxies into the tree. They keep valid ids and fat AABBs,
+	/// but queries do not find them until EndBulkInsert builds the tree.
+	void BeginBulkInsert();
+
+	/// Build the tree top-down with all proxies created since BeginBulkInsert.
+	void EndBulkInsert();
+
+	/// Are proxies being created without insertion?
+	bool IsBulkInserting() const { return m_bulkInsert; }
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
@@ -125,11 +208,19 @@ public:
 
 private:
 
+	void GrowPool(int capacity);
+
 	int AllocateNode();
 	void FreeNode(int node);
 
+	// Fatten a proxy AABB by the extension and the predicted displacement.
+	static cb2AABB ComputeFatAABB(const cb2AABB& aabb, const ci::Vec2f& displacement);
+
 	void InsertLeaf(int node);
 	void RemoveLeaf(int node);
+	bool IsInTree(int leaf) const;
+
+	int BuildTopDown(int* leaves, int count);
 
 	int Balance(int index);
 
@@ -142,6 +233,9 @@ private:
 	int m_root;
 
 	cb2TreeNode* m_nodes;
+	void** m_userData;
+	unsigned int* m_layers;
+	void* m_nodeMemory;
 	int m_nodeCount;
 	int m_nodeCapacity;
 
@@ -151,12 +245,20 @@ private:
 	unsigned int m_path;
 
 	int m_insertionCount;
+
+	bool m_bulkInsert;
 };
 
 inline void* cb2DynamicTree::GetUserData(int proxyId) const
 {
 	cb2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
-	return m_nodes[proxyId].userData;
+	return m_userData[proxyId];
+}
+
+inline void cb2DynamicTree::SetUserData(int proxyId, void* userData)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	m_userData[proxyId] = userData;
 }
 
 inline const cb2AABB& cb2DynamicTree::GetFatAABB(int proxyId) const
@@ -165,36 +267,228 @@ inline const cb2AABB& cb2DynamicTree::GetFatAABB(int proxyId) const
 	return m_nodes[proxyId].aabb;
 }
 
+inline unsigned int cb2DynamicTree::GetLayers(int nodeId) const
+{
+	cb2Assert(0 <= nodeId && nodeId < m_nodeCapacity);
+	return m_layers[nodeId];
+}
+
 template <typename T>
 inline void cb2DynamicTree::Query(T* callback, const cb2AABB& aabb) const
 {
+	if (m_root == cb2_nullNode || cb2TestOverlap(m_nodes[m_root].aabb, aabb) == false)
+	{
+		return;
+	}
+
+	// Only overlapping nodes are pushed. Both children are tested while
+	// the parent is in cache, so misses never reach the stack.
 	cb2GrowableStack<int, 256> stack;
 	stack.Push(m_root);
 
 	while (stack.GetCount() > 0)
 	{
 		int nodeId = stack.Pop();
-		if (nodeId == cb2_nullNode)
+		const cb2TreeNode* node = m_nodes + nodeId;
+
+		if (node->IsLeaf())
 		{
-			continue;
+			bool proceed = callback->QueryCallback(nodeId);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+		else
+		{
+			if (cb2TestOverlap(m_nodes[node->child1].aabb, aabb))
+			{
+				stack.Push(node->child1);
+			}
+
+			if (cb2TestOverlap(m_nodes[node->child2].aabb, aabb))
+			{
+				stack.Push(node->child2);
+			}
 		}
+	}
+}
+
+template <typename T>
+inline void cb2DynamicTree::Query(T* callback, const cb2AABB& aabb, unsigned int layerMask) const
+{
+	if (m_root == cb2_nullNode || (m_layers[m_root] & layerMask) == 0 || cb2TestOverlap(m_nodes[m_root].aabb, aabb) == false)
+	{
+		return;
+	}
+
+	// Children without a layer of the mask are rejected before their boxes are read.
+	cb2GrowableStack<int, 256> stack;
+	stack.Push(m_root);
 
+	while (stack.GetCount() > 0)
+	{
+		int nodeId = stack.Pop();
 		const cb2TreeNode* node = m_nodes + nodeId;
 
-		if (cb2TestOverlap(node->aabb, aabb))
+		if (node->IsLeaf())
 		{
+			bool proceed = callback->QueryCallback(nodeId);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+		else
+		{
+			if ((m_layers[node->child1] & layerMask) != 0 && cb2TestOverlap(m_nodes[node->child1].aabb, aabb))
+			{
+				stack.Push(node->child1);
+			}
+
+			if ((m_layers[node->child2] & layerMask) != 0 && cb2TestOverlap(m_nodes[node->child2].aabb, aabb))
+			{
+				stack.Push(node->child2);
+			}
+		}
+	}
+}
+
+/// A node waiting in a closest query, keyed by its squared distance to the point.
+struct cb2TreeClosestEntry
+{
+	float key;
+	int nodeId;
+};
+
+template <typename T>
+inline void cb2DynamicTree::QueryClosest(T* callback, const ci::Vec2f& point, float maxDistance) const
+{
+	if (m_root == cb2_nullNode || maxDistance < 0.0f)
+	{
+		return;
+	}
+
+	float maxDistanceSqr = maxDistance * maxDistance;
+	cb2TreeClosestEntry entry;
+	entry.key = cb2DistanceSquared(m_nodes[m_root].aabb, point);
+	entry.nodeId = m_root;
+	if (entry.key > maxDistanceSqr)
+	{
+		return;
+	}
+
+	cb2GrowableHeap<cb2TreeClosestEntry, 256> heap;
+	heap.Push(entry);
+
+	while (heap.GetCount() > 0)
+	{
+		entry = heap.Pop();
+
+		// The nearest box left is out of reach, so are all the others.
+		if (entry.key > maxDistanceSqr)
+		{
+			return;
+		}
+
+		const cb2TreeNode* node = m_nodes + entry.nodeId;
+		if (node->IsLeaf())
+		{
+			float distance = callback->ClosestCallback(entry.nodeId);
+			if (distance < 0.0f)
+			{
+				return;
+			}
+			maxDistanceSqr = cb2Min(maxDistanceSqr, distance * distance);
+			continue;
+		}
+
+		cb2TreeClosestEntry child;
+		child.nodeId = node->child1;
+		child.key = cb2DistanceSquared(m_nodes[child.nodeId].aabb, point);
+		if (child.key <= maxDistanceSqr)
+		{
+			heap.Push(child);
+		}
+
+		child.nodeId = node->child2;
+		child.key = cb2DistanceSquared(m_nodes[child.nodeId].aabb, point);
+		if (child.key <= maxDistanceSqr)
+		{
+			heap.Push(child);
+		}
+	}
+}
+
+/// A node and the queries of a group that still overlap it.
+struct cb2TreeBatchEntry
+{
+	int nodeId;
+	unsigned int mask;
+};
+
+template <typename T>
+inline void cb2DynamicTree::QueryBatch(T* callback, const cb2AABB* aabbs, const int* order, int count) const
+{
+	if (m_root == cb2_nullNode)
+	{
+		return;
+	}
+
+	cb2GrowableStack<cb2TreeBatchEntry, 256> stack;
+
+	for (int groupStart = 0; groupStart < count; groupStart += 32)
+	{
+		const int* group = order + groupStart;
+		int groupCount = cb2Min(count - groupStart, 32);
+
+		cb2TreeBatchEntry entry;
+		entry.nodeId = m_root;
+		entry.mask = groupCount == 32 ? 0xFFFFFFFF : (1u << groupCount) - 1;
+		stack.Push(entry);
+
+		while (stack.GetCount() > 0)
+		{
+			entry = stack.Pop();
+			const cb2TreeNode* node = m_nodes + entry.nodeId;
+
+			unsigned int mask = 0;
+			for (int i = 0; i < groupCount; ++i)
+			{
+				if ((entry.mask & (1u << i)) && cb2TestOverlap(node->aabb, aabbs[group[i]]))
+				{
+					mask |= 1u << i;
+				}
+			}
+
+			if (mask == 0)
+			{
+				continue;
+			}
+
 			if (node->IsLeaf())
 			{
-				bool proceed = callback->QueryCallback(nodeId);
-				if (proceed == false)
+				for (int i = 0; i < groupCount; ++i)
 				{
-					return;
+					if ((mask & (1u << i)) == 0)
+					{
+						continue;
+					}
+
+					bool proceed = callback->QueryCallback(group[i], entry.nodeId);
+					if (proceed == false)
+					{
+						return;
+					}
 				}
 			}
 			else
 			{
-				stack.Push(node->child1);
-				stack.Push(node->child2);
+				entry.mask = mask;
+				entry.nodeId = node->child1;
+				stack.Push(entry);
+				entry.nodeId = node->child2;
+				stack.Push(entry);
 			}
 		}
 	}
@@ -286,4 +580,135 @@ inline void cb2DynamicTree::RayCast(T* callback, const cb2RayCastInput& input) c
 	}
 }
 
+template <typename T>
+inline void cb2DynamicTree::RayCastBatch(T* callback, const cb2RayCastInput* inputs, const int* order, int count, float* fractions) const
+{
+	for (int i = 0; i < count; ++i)
+	{
+		fractions[i] = inputs[i].maxFraction;
+	}
+
+	if (m_root == cb2_nullNode)
+	{
+		return;
+	}
+
+	cb2GrowableStack<cb2TreeBatchEntry, 256> stack;
+
+	for (int packetStart = 0; packetStart < count; packetStart += cb2_simdWidth)
+	{
+		const int* packet = order + packetStart;
+		int packetCount = cb2Min(count - packetStart, cb2_simdWidth);
+
+		// Rays are p1 + t * (p2 - p1) with t in [0, maxFraction]. Unused lanes have no length.
+		float originX[cb2_simdWidth], originY[cb2_simdWidth];
+		float invDX[cb2_simdWidth], invDY[cb2_simdWidth];
+		float maxT[cb2_simdWidth];
+		unsigned int active = 0;
+		for (int i = 0; i < cb2_simdWidth; ++i)
+		{
+			if (i < packetCount)
+			{
+				const cb2RayCastInput& input = inputs[packet[i]];
+				ci::Vec2f d = input.p2 - input.p1;
+				cb2Assert(d.lengthSquared() > 0.0f);
+				originX[i] = input.p1.x;
+				originY[i] = input.p1.y;
+
+				// Axis aligned rays get a huge inverse so the slab reduces to a range test.
+				invDX[i] = cb2Abs(d.x) > cb2_epsilon ? 1.0f / d.x : (d.x < 0.0f ? -cb2_maxFloat : cb2_maxFloat);
+				invDY[i] = cb2Abs(d.y) > cb2_epsilon ? 1.0f / d.y : (d.y < 0.0f ? -cb2_maxFloat : cb2_maxFloat);
+				maxT[i] = input.maxFraction;
+				active |= 1u << i;
+			}
+			else
+			{
+				originX[i] = originY[i] = 0.0f;
+				invDX[i] = invDY[i] = 1.0f;
+				maxT[i] = -1.0f;
+			}
+		}
+
+		cb2FloatW ox = cb2LoadW(originX);
+		cb2FloatW oy = cb2LoadW(originY);
+		cb2FloatW idx = cb2LoadW(invDX);
+		cb2FloatW idy = cb2LoadW(invDY);
+		cb2FloatW zero = cb2ZeroW();
+
+		cb2TreeBatchEntry entry;
+		entry.nodeId = m_root;
+		entry.mask = active;
+		stack.Push(entry);
+
+		while (stack.GetCount() > 0)
+		{
+			entry = stack.Pop();
+
+			// Rays may have been terminated since the entry was pushed.
+			unsigned int mask = entry.mask & active;
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			const cb2TreeNode* node = m_nodes + entry.nodeId;
+
+			// Slab test of the node box against the four rays.
+			cb2FloatW tx1 = cb2MulW(cb2SubW(cb2SplatW(node->aabb.lowerBound.x), ox), idx);
+			cb2FloatW tx2 = cb2MulW(cb2SubW(cb2SplatW(node->aabb.upperBound.x), ox), idx);
+			cb2FloatW ty1 = cb2MulW(cb2SubW(cb2SplatW(node->aabb.lowerBound.y), oy), idy);
+			cb2FloatW ty2 = cb2MulW(cb2SubW(cb2SplatW(node->aabb.upperBound.y), oy), idy);
+			cb2FloatW tmin = cb2MaxW(cb2MaxW(cb2MinW(tx1, tx2), cb2MinW(ty1, ty2)), zero);
+			cb2FloatW tmax = cb2MinW(cb2MinW(cb2MaxW(tx1, tx2), cb2MaxW(ty1, ty2)), cb2LoadW(maxT));
+			mask &= (unsigned int)cb2MaskLessEqualW(tmin, tmax);
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			if (node->IsLeaf())
+			{
+				for (int i = 0; i < packetCount; ++i)
+				{
+					if ((mask & (1u << i)) == 0)
+					{
+						continue;
+					}
+
+					cb2RayCastInput subInput;
+					subInput.p1 = inputs[packet[i]].p1;
+					subInput.p2 = inputs[packet[i]].p2;
+					subInput.maxFraction = maxT[i];
+
+					float value = callback->RayCastCallback(packet[i], subInput, entry.nodeId);
+
+					if (value == 0.0f)
+					{
+						// The client has terminated this ray.
+						active &= ~(1u << i);
+						maxT[i] = -1.0f;
+					}
+					else if (value > 0.0f)
+					{
+						maxT[i] = value;
+					}
+				}
+			}
+			else
+			{
+				entry.mask = mask;
+				entry.nodeId = node->child1;
+				stack.Push(entry);
+				entry.nodeId = node->child2;
+				stack.Push(entry);
+			}
+		}
+
+		for (int i = 0; i < packetCount; ++i)
+		{
+			fractions[packet[i]] = (active & (1u << i)) ? maxT[i] : 0.0f;
+		}
+	}
+}
+
 #endif
@@ -0,0 +1,405 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Collision/cb2SpatialHash.h>
+#include <memory.h>
+
+// Proxies covering more cells than this are tested by every query instead.
+const int cb2_hashMaxProxyCells = 16;
+
+cb2SpatialHash::cb2SpatialHash()
+{
+	m_cellSize = 1.0f;
+	m_inverseCellSize = 1.0f;
+
+	m_proxyCapacity = 16;
+	m_proxyCount = 0;
+	m_proxies = (cb2HashProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2HashProxy));
+
+	// Build a linked list for the free list.
+	for (int i = 0; i < m_proxyCapacity - 1; ++i)
+	{
+		m_proxies[i].next = i + 1;
+		m_proxies[i].largeIndex = e_freeProxy;
+	}
+	m_proxies[m_proxyCapacity-1].next = e_nullNode;
+	m_proxies[m_proxyCapacity-1].largeIndex = e_freeProxy;
+	m_freeList = 0;
+
+	m_entryCapacity = 0;
+	m_entryCount = 0;
+	m_entryFreeList = e_nullNode;
+	m_entries = NULL;
+
+	m_bucketCount = 64;
+	m_buckets = (int*)cb2Alloc(m_bucketCount * sizeof(int));
+	for (int i = 0; i < m_bucketCount; ++i)
+	{
+		m_buckets[i] = e_nullNode;
+	}
+
+	m_largeCapacity = 16;
+	m_largeCount = 0;
+	m_largeProxies = (int*)cb2Alloc(m_largeCapacity * sizeof(int));
+}
+
+cb2SpatialHash::~cb2SpatialHash()
+{
+	cb2Free(m_largeProxies);
+	cb2Free(m_buckets);
+	cb2Free(m_entries);
+	cb2Free(m_proxies);
+}
+
+void cb2SpatialHash::SetCellSize(float cellSize)
+{
+	cb2Assert(m_proxyCount == 0);
+	cb2Assert(cellSize > 0.0f);
+	m_cellSize = cellSize;
+	m_inverseCellSize = 1.0f / cellSize;
+}
+
+void cb2SpatialHash::Copy(const cb2SpatialHash& hash)
+{
+	if (m_proxyCapacity != hash.m_proxyCapacity)
+	{
+		cb2Free(m_proxies);
+		m_proxyCapacity = hash.m_proxyCapacity;
+		m_proxies = (cb2HashProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2HashProxy));
+	}
+	memcpy(m_proxies, hash.m_proxies, m_proxyCapacity * sizeof(cb2HashProxy));
+
+	if (m_entryCapacity != hash.m_entryCapacity)
+	{
+		cb2Free(m_entries);
+		m_entryCapacity = hash.m_entryCapacity;
+		m_entries = (cb2HashEntry*)cb2Alloc(m_entryCapacity * sizeof(cb2HashEntry));
+	}
+	if (m_entryCapacity > 0)
+	{
+		memcpy(m_entries, hash.m_entries, m_entryCapacity * sizeof(cb2HashEntry));
+	}
+
+	if (m_bucketCount != hash.m_bucketCount)
+	{
+		cb2Free(m_buckets);
+		m_bucketCount = hash.m_bucketCount;
+		m_buckets = (int*)cb2Alloc(m_bucketCount * sizeof(int));
+	}
+	memcpy(m_buckets, hash.m_buckets, m_bucketCount * sizeof(int));
+
+	if (m_largeCapacity != hash.m_largeCapacity)
+	{
+		cb2Free(m_largeProxies);
+		m_largeCapacity = hash.m_largeCapacity;
+		m_largeProxies = (int*)cb2Alloc(m_largeCapacity * sizeof(int));
+	}
+	memcpy(m_largeProxies, hash.m_largeProxies, hash.m_largeCount * sizeof(int));
+
+	m_cellSize = hash.m_cellSize;
+	m_inverseCellSize = hash.m_inverseCellSize;
+	m_proxyCount = hash.m_proxyCount;
+	m_freeList = hash.m_freeList;
+	m_entryCount = hash.m_entryCount;
+	m_entryFreeList = hash.m_entryFreeList;
+	m_largeCount = hash.m_largeCount;
+}
+
+int cb2SpatialHash::CreateProxy(const cb2AABB& aabb, void* userData)
+{
+	// Expand the proxy pool as needed.
+	if (m_freeList == e_nullNode)
+	{
+		cb2Assert(m_proxyCount == m_proxyCapacity);
+
+		cb2HashProxy* oldProxies = m_proxies;
+		m_proxyCapacity *= 2;
+		m_proxies = (cb2HashProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2HashProxy));
+		memcpy(m_proxies, oldProxies, m_proxyCount * sizeof(cb2HashProxy));
+		cb2Free(oldProxies);
+
+		for (int i = m_proxyCount; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxies[i].next = i + 1;
+			m_proxies[i].largeIndex = e_freeProxy;
+		}
+		m_proxies[m_proxyCapacity-1].next = e_nullNode;
+		m_proxies[m_proxyCapacity-1].largeIndex = e_freeProxy;
+		m_freeList = m_proxyCount;
+	}
+
+	int proxyId = m_freeList;
+	cb2HashProxy* proxy = m_proxies + proxyId;
+	m_freeList = proxy->next;
+	++m_proxyCount;
+
+	// Fatten the aabb.
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	proxy->aabb.lowerBound = aabb.lowerBound - r;
+	proxy->aabb.upperBound = aabb.upperBound + r;
+	proxy->userData = userData;
+	proxy->next = e_nullNode;
+
+	InsertProxy(proxyId);
+	return proxyId;
+}
+
+void cb2SpatialHash::DestroyProxy(int proxyId)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2Assert(m_proxies[proxyId].largeIndex != e_freeProxy);
+
+	RemoveProxy(proxyId);
+
+	m_proxies[proxyId].largeIndex = e_freeProxy;
+	m_proxies[proxyId].next = m_freeList;
+	m_freeList = proxyId;
+	--m_proxyCount;
+}
+
+bool cb2SpatialHash::MoveProxy(int proxyId, const cb2AABB& aabb, const ci::Vec2f& displacement)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2Assert(m_proxies[proxyId].largeIndex != e_freeProxy);
+
+	cb2HashProxy* proxy = m_proxies + proxyId;
+	if (proxy->aabb.Contains(aabb))
+	{
+		return false;
+	}
+
+	// Extend AABB.
+	cb2AABB b = aabb;
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	b.lowerBound = b.lowerBound - r;
+	b.upperBound = b.upperBound + r;
+
+	// Predict AABB displacement.
+	ci::Vec2f d = cb2_aabbMultiplier * displacement;
+
+	if (d.x < 0.0f)
+	{
+		b.lowerBound.x += d.x;
+	}
+	else
+	{
+		b.upperBound.x += d.x;
+	}
+
+	if (d.y < 0.0f)
+	{
+		b.lowerBound.y += d.y;
+	}
+	else
+	{
+		b.upperBound.y += d.y;
+	}
+
+	SetFatAABB(proxyId, b);
+	return true;
+}
+
+void cb2SpatialHash::SetFatAABB(int proxyId, const cb2AABB& fatAABB)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2Assert(m_proxies[proxyId].largeIndex != e_freeProxy);
+
+	// Keep the entries if the proxy still covers the same cells.
+	cb2HashProxy* proxy = m_proxies + proxyId;
+	if (proxy->largeIndex == e_nullNode &&
+		proxy->lowerX == ComputeCell(fatAABB.lowerBound.x) && proxy->lowerY == ComputeCell(fatAABB.lowerBound.y) &&
+		proxy->upperX == ComputeCell(fatAABB.upperBound.x) && proxy->upperY == ComputeCell(fatAABB.upperBound.y))
+	{
+		proxy->aabb = fatAABB;
+		return;
+	}
+
+	RemoveProxy(proxyId);
+	proxy->aabb = fatAABB;
+	InsertProxy(proxyId);
+}
+
+void cb2SpatialHash::InsertProxy(int proxyId)
+{
+	cb2HashProxy* proxy = m_proxies + proxyId;
+	proxy->lowerX = ComputeCell(proxy->aabb.lowerBound.x);
+	proxy->lowerY = ComputeCell(proxy->aabb.lowerBound.y);
+	proxy->upperX = ComputeCell(proxy->aabb.upperBound.x);
+	proxy->upperY = ComputeCell(proxy->aabb.upperBound.y);
+
+	float cellCount = float(proxy->upperX - proxy->lowerX + 1) * float(proxy->upperY - proxy->lowerY + 1);
+	if (cellCount > float(cb2_hashMaxProxyCells))
+	{
+		if (m_largeCount == m_largeCapacity)
+		{
+			int* oldLarge = m_largeProxies;
+			m_largeCapacity *= 2;
+			m_largeProxies = (int*)cb2Alloc(m_largeCapacity * sizeof(int));
+			memcpy(m_largeProxies, oldLarge, m_largeCount * sizeof(int));
+			cb2Free(oldLarge);
+		}
+
+		proxy->largeIndex = m_largeCount;
+		m_largeProxies[m_largeCount] = proxyId;
+		++m_largeCount;
+		return;
+	}
+
+	proxy->largeIndex = e_nullNode;
+	for (int y = proxy->lowerY; y <= proxy->upperY; ++y)
+	{
+		for (int x = proxy->lowerX; x <= proxy->upperX; ++x)
+		{
+			AddEntry(proxyId, x, y);
+		}
+	}
+}
+
+void cb2SpatialHash::RemoveProxy(int proxyId)
+{
+	cb2HashProxy* proxy = m_proxies + proxyId;
+	if (proxy->largeIndex != e_nullNode)
+	{
+		// Swap the last large proxy into the hole.
+		int index = proxy->largeIndex;
+		--m_largeCount;
+		int lastId = m_largeProxies[m_largeCount];
+		m_largeProxies[index] = lastId;
+		m_proxies[lastId].largeIndex = index;
+		proxy->largeIndex = e_nullNode;
+		return;
+	}
+
+	for (int y = proxy->lowerY; y <= proxy->upperY; ++y)
+	{
+		for (int x = proxy->lowerX; x <= proxy->upperX; ++x)
+		{
+			RemoveEntry(proxyId, x, y);
+		}
+	}
+}
+
+void cb2SpatialHash::AddEntry(int proxyId, int x, int y)
+{
+	// Expand the entry pool as needed.
+	if (m_entryFreeList == e_nullNode)
+	{
+		cb2Assert(m_entryCount == m_entryCapacity);
+
+		cb2HashEntry* oldEntries = m_entries;
+		m_entryCapacity = cb2Max(2 * m_entryCapacity, 64);
+		m_entries = (cb2HashEntry*)cb2Alloc(m_entryCapacity * sizeof(cb2HashEntry));
+		if (oldEntries)
+		{
+			memcpy(m_entries, oldEntries, m_entryCount * sizeof(cb2HashEntry));
+			cb2Free(oldEntries);
+		}
+
+		for (int i = m_entryCount; i < m_entryCapacity - 1; ++i)
+		{
+			m_entries[i].proxyId = e_nullNode;
+			m_entries[i].next = i + 1;
+		}
+		m_entries[m_entryCapacity-1].proxyId = e_nullNode;
+		m_entries[m_entryCapacity-1].next = e_nullNode;
+		m_entryFreeList = m_entryCount;
+	}
+
+	// Keep about one entry per bucket.
+	if (m_entryCount >= m_bucketCount)
+	{
+		GrowBuckets();
+	}
+
+	int entryId = m_entryFreeList;
+	cb2HashEntry* entry = m_entries + entryId;
+	m_entryFreeList = entry->next;
+	++m_entryCount;
+
+	int bucket = HashCell(x, y);
+	entry->proxyId = proxyId;
+	entry->cellX = x;
+	entry->cellY = y;
+	entry->next = m_buckets[bucket];
+	m_buckets[bucket] = entryId;
+}
+
+void cb2SpatialHash::RemoveEntry(int proxyId, int x, int y)
+{
+	int* link = m_buckets + HashCell(x, y);
+	while (*link != e_nullNode)
+	{
+		cb2HashEntry* entry = m_entries + *link;
+		if (entry->proxyId == proxyId && entry->cellX == x && entry->cellY == y)
+		{
+			int entryId = *link;
+			*link = entry->next;
+
+			entry->proxyId = e_nullNode;
+			entry->next = m_entryFreeList;
+			m_entryFreeList = entryId;
+			--m_entryCount;
+			return;
+		}
+		link = &entry->next;
+	}
+
+	cb2Assert(false);
+}
+
+void cb2SpatialHash::GrowBuckets()
+{
+	cb2Free(m_buckets);
+	m_bucketCount *= 2;
+	m_buckets = (int*)cb2Alloc(m_bucketCount * sizeof(int));
+	for (int i = 0; i < m_bucketCount; ++i)
+	{
+		m_buckets[i] = e_nullNode;
+	}
+
+	// Relink the live entries.
+	for (int i = 0; i < m_entryCapacity; ++i)
+	{
+		cb2HashEntry* entry = m_entries + i;
+		if (entry->proxyId == e_nullNode)
+		{
+			continue;
+		}
+
+		int bucket = HashCell(entry->cellX, entry->cellY);
+		entry->next = m_buckets[bucket];
+		m_buckets[bucket] = i;
+	}
+}
+
+void cb2SpatialHash::ShiftOrigin(const ci::Vec2f& newOrigin)
+{
+	// The cells change, so every proxy is entered again.
+	for (int i = 0; i < m_proxyCapacity; ++i)
+	{
+		cb2HashProxy* proxy = m_proxies + i;
+		if (proxy->largeIndex == e_freeProxy)
+		{
+			continue;
+		}
+
+		RemoveProxy(i);
+		proxy->aabb.lowerBound -= newOrigin;
+		proxy->aabb.upperBound -= newOrigin;
+		InsertProxy(i);
+	}
+}
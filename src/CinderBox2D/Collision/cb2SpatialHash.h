@@ -0,0 +1,431 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_SPATIAL_HASH_H
+#define CB2_SPATIAL_HASH_H
+
+#include <CinderBox2D/Collision/cb2Collision.h>
+
+/// A proxy stored in the spatial hash.
+struct cb2HashProxy
+{
+	/// Enlarged AABB
+	cb2AABB aabb;
+	void* userData;
+
+	/// The cells covered by the enlarged AABB.
+	int lowerX, lowerY;
+	int upperX, upperY;
+
+	/// Index in the large proxy list, -1 when the proxy is in the cells, -2 when free.
+	int largeIndex;
+	int next;
+};
+
+/// One proxy in one cell. Entries of a bucket are linked.
+struct cb2HashEntry
+{
+	int proxyId;
+	int cellX;
+	int cellY;
+	int next;
+};
+
+/// A uniform grid stored in a hash table. Each proxy is entered into every cell its
+/// fattened AABB covers, so a query only visits the cells of its own AABB. This beats
+/// the dynamic tree when the proxies are many, small and of similar size. Proxies that
+/// cover too many cells are kept in a separate list that every query tests.
+/// The proxy interface is the same as cb2DynamicTree.
+class cb2SpatialHash
+{
+public:
+
+	enum
+	{
+		e_nullNode = -1,
+		e_freeProxy = -2
+	};
+
+	/// Constructing the hash initializes the proxy pool.
+	cb2SpatialHash();
+
+	/// Destroy the hash, freeing the proxy pool.
+	~cb2SpatialHash();
+
+	/// Set the size of a grid cell. This can only be changed while the hash is empty.
+	/// Pick a size near the typical proxy size.
+	void SetCellSize(float cellSize);
+	float GetCellSize() const { return m_cellSize; }
+
+	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
+	int CreateProxy(const cb2AABB& aabb, void* userData);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int proxyId);
+
+	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
+	/// then the proxy is moved to its new cells.
+	/// @return true if the fattened AABB changed.
+	bool MoveProxy(int proxyId, const cb2AABB& aabb1, const ci::Vec2f& displacement);
+
+	/// Move a proxy to the cells of this fattened AABB as is.
+	void SetFatAABB(int proxyId, const cb2AABB& fatAABB);
+
+	/// Get proxy user data.
+	void* GetUserData(int proxyId) const;
+
+	/// Set proxy user data.
+	void SetUserData(int proxyId, void* userData);
+
+	/// Get the fat AABB for a proxy.
+	const cb2AABB& GetFatAABB(int proxyId) const;
+
+	/// Make this hash a copy of another hash. Proxy ids and user data are kept.
+	void Copy(const cb2SpatialHash& hash);
+
+	/// Get the number of proxies.
+	int GetProxyCount() const { return m_proxyCount; }
+
+	/// Get the bytes of the proxy, entry, bucket and large proxy arrays.
+	int GetMemory() const
+	{
+		return m_proxyCapacity * (int)sizeof(cb2HashProxy) + m_entryCapacity * (int)sizeof(cb2HashEntry) +
+			(m_bucketCount + m_largeCapacity) * (int)sizeof(int);
+	}
+
+	/// Query an AABB for overlapping proxies. The callback class
+	/// is called once for each proxy that overlaps the supplied AABB.
+	template <typename T>
+	void Query(T* callback, const cb2AABB& aabb) const;
+
+	/// Ray-cast against the proxies in the hash. The cells are walked in ray order.
+	/// The callback works as in cb2DynamicTree::RayCast.
+	template <typename T>
+	void RayCast(T* callback, const cb2RayCastInput& input) const;
+
+	/// Shift the world origin. Useful for large worlds.
+	/// The shift formula is: position -= newOrigin
+	/// @param newOrigin the new origin with respect to the old origin
+	void ShiftOrigin(const ci::Vec2f& newOrigin);
+
+private:
+
+	int ComputeCell(float x) const;
+	int HashCell(int x, int y) const;
+
+	void InsertProxy(int proxyId);
+	void RemoveProxy(int proxyId);
+
+	void AddEntry(int proxyId, int x, int y);
+	void RemoveEntry(int proxyId, int x, int y);
+	void GrowBuckets();
+
+	template <typename T>
+	void QueryAll(T* callback, const cb2AABB& aabb) const;
+
+	template <typename T>
+	void RayCastAll(T* callback, const cb2RayCastInput& input) const;
+
+	float m_cellSize;
+	float m_inverseCellSize;
+
+	cb2HashProxy* m_proxies;
+	int m_proxyCapacity;
+	int m_proxyCount;
+	int m_freeList;
+
+	cb2HashEntry* m_entries;
+	int m_entryCapacity;
+	int m_entryCount;
+	int m_entryFreeList;
+
+	int* m_buckets;
+	int m_bucketCount;
+
+	int* m_largeProxies;
+	int m_largeCapacity;
+	int m_largeCount;
+};
+
+inline void* cb2SpatialHash::GetUserData(int proxyId) const
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline void cb2SpatialHash::SetUserData(int proxyId, void* userData)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].userData = userData;
+}
+
+inline const cb2AABB& cb2SpatialHash::GetFatAABB(int proxyId) const
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].aabb;
+}
+
+inline int cb2SpatialHash::ComputeCell(float x) const
+{
+	// Clamp so that far away coordinates cannot overflow the cell index.
+	float cell = cb2Clamp(x * m_inverseCellSize, -1.0e8f, 1.0e8f);
+	return (int)floorf(cell);
+}
+
+inline int cb2SpatialHash::HashCell(int x, int y) const
+{
+	unsigned int h = ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u);
+	return (int)(h & (unsigned int)(m_bucketCount - 1));
+}
+
+template <typename T>
+void cb2SpatialHash::QueryAll(T* callback, const cb2AABB& aabb) const
+{
+	for (int i = 0; i < m_proxyCapacity; ++i)
+	{
+		const cb2HashProxy* proxy = m_proxies + i;
+		if (proxy->largeIndex == e_freeProxy || cb2TestOverlap(proxy->aabb, aabb) == false)
+		{
+			continue;
+		}
+
+		if (callback->QueryCallback(i) == false)
+		{
+			return;
+		}
+	}
+}
+
+template <typename T>
+inline void cb2SpatialHash::Query(T* callback, const cb2AABB& aabb) const
+{
+	int lowerX = ComputeCell(aabb.lowerBound.x);
+	int lowerY = ComputeCell(aabb.lowerBound.y);
+	int upperX = ComputeCell(aabb.upperBound.x);
+	int upperY = ComputeCell(aabb.upperBound.y);
+
+	// Visiting more cells than there are entries is slower than testing every proxy.
+	float cellCount = float(upperX - lowerX + 1) * float(upperY - lowerY + 1);
+	if (cellCount > float(m_entryCount + m_largeCount))
+	{
+		QueryAll(callback, aabb);
+		return;
+	}
+
+	for (int i = 0; i < m_largeCount; ++i)
+	{
+		int proxyId = m_largeProxies[i];
+		if (cb2TestOverlap(m_proxies[proxyId].aabb, aabb))
+		{
+			if (callback->QueryCallback(proxyId) == false)
+			{
+				return;
+			}
+		}
+	}
+
+	for (int y = lowerY; y <= upperY; ++y)
+	{
+		for (int x = lowerX; x <= upperX; ++x)
+		{
+			int entryId = m_buckets[HashCell(x, y)];
+			while (entryId != e_nullNode)
+			{
+				const cb2HashEntry* entry = m_entries + entryId;
+				entryId = entry->next;
+				if (entry->cellX != x || entry->cellY != y)
+				{
+					continue;
+				}
+
+				// Report a proxy only in the first cell it shares with the query.
+				const cb2HashProxy* proxy = m_proxies + entry->proxyId;
+				if (x != cb2Max(proxy->lowerX, lowerX) || y != cb2Max(proxy->lowerY, lowerY))
+				{
+					continue;
+				}
+
+				if (cb2TestOverlap(proxy->aabb, aabb))
+				{
+					if (callback->QueryCallback(entry->proxyId) == false)
+					{
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+void cb2SpatialHash::RayCastAll(T* callback, const cb2RayCastInput& input) const
+{
+	ci::Vec2f p1 = input.p1;
+	ci::Vec2f d = input.p2 - input.p1;
+	float maxFraction = input.maxFraction;
+
+	for (int i = 0; i < m_proxyCapacity; ++i)
+	{
+		const cb2HashProxy* proxy = m_proxies + i;
+		if (proxy->largeIndex == e_freeProxy || cb2TestSegmentOverlap(proxy->aabb, p1, d, maxFraction) == false)
+		{
+			continue;
+		}
+
+		cb2RayCastInput subInput;
+		subInput.p1 = input.p1;
+		subInput.p2 = input.p2;
+		subInput.maxFraction = maxFraction;
+
+		float value = callback->RayCastCallback(subInput, i);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+	}
+}
+
+template <typename T>
+inline void cb2SpatialHash::RayCast(T* callback, const cb2RayCastInput& input) const
+{
+	ci::Vec2f p1 = input.p1;
+	ci::Vec2f d = input.p2 - input.p1;
+	cb2Assert(d.lengthSquared() > 0.0f);
+	float maxFraction = input.maxFraction;
+
+	int x = ComputeCell(p1.x);
+	int y = ComputeCell(p1.y);
+	int endX = ComputeCell(p1.x + maxFraction * d.x);
+	int endY = ComputeCell(p1.y + maxFraction * d.y);
+
+	// Walking more cells than there are entries is slower than testing every proxy.
+	int stepCount = cb2Abs(endX - x) + cb2Abs(endY - y);
+	if (stepCount > m_entryCount + m_largeCount)
+	{
+		RayCastAll(callback, input);
+		return;
+	}
+
+	cb2RayCastInput subInput;
+	subInput.p1 = input.p1;
+	subInput.p2 = input.p2;
+
+	for (int i = 0; i < m_largeCount; ++i)
+	{
+		int proxyId = m_largeProxies[i];
+		if (cb2TestSegmentOverlap(m_proxies[proxyId].aabb, p1, d, maxFraction) == false)
+		{
+			continue;
+		}
+
+		subInput.maxFraction = maxFraction;
+		float value = callback->RayCastCallback(subInput, proxyId);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+	}
+
+	// Walk the cells along the ray (Amanatides and Woo).
+	int stepX = d.x > 0.0f ? 1 : -1;
+	int stepY = d.y > 0.0f ? 1 : -1;
+	float deltaX = d.x != 0.0f ? cb2Abs(m_cellSize / d.x) : cb2_maxFloat;
+	float deltaY = d.y != 0.0f ? cb2Abs(m_cellSize / d.y) : cb2_maxFloat;
+	float nextX = d.x != 0.0f ? ((x + (stepX > 0 ? 1 : 0)) * m_cellSize - p1.x) / d.x : cb2_maxFloat;
+	float nextY = d.y != 0.0f ? ((y + (stepY > 0 ? 1 : 0)) * m_cellSize - p1.y) / d.y : cb2_maxFloat;
+
+	// Rounding can make the walk differ from the end cell by one step.
+	int prevX = x;
+	int prevY = y;
+	for (int step = 0; step <= stepCount + 1; ++step)
+	{
+		int entryId = m_buckets[HashCell(x, y)];
+		while (entryId != e_nullNode)
+		{
+			const cb2HashEntry* entry = m_entries + entryId;
+			entryId = entry->next;
+			if (entry->cellX != x || entry->cellY != y)
+			{
+				continue;
+			}
+
+			// Cells covered by a proxy are walked in a row, so a proxy was already
+			// reported if the previous cell is one of its cells.
+			const cb2HashProxy* proxy = m_proxies + entry->proxyId;
+			if (step > 0 && proxy->lowerX <= prevX && prevX <= proxy->upperX && proxy->lowerY <= prevY && prevY <= proxy->upperY)
+			{
+				continue;
+			}
+
+			if (cb2TestSegmentOverlap(proxy->aabb, p1, d, maxFraction) == false)
+			{
+				continue;
+			}
+
+			subInput.maxFraction = maxFraction;
+			float value = callback->RayCastCallback(subInput, entry->proxyId);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return;
+			}
+
+			if (value > 0.0f)
+			{
+				maxFraction = value;
+			}
+		}
+
+		prevX = x;
+		prevY = y;
+		if (nextX < nextY)
+		{
+			if (nextX > maxFraction)
+			{
+				break;
+			}
+			x += stepX;
+			nextX += deltaX;
+		}
+		else
+		{
+			if (nextY > maxFraction)
+			{
+				break;
+			}
+			y += stepY;
+			nextY += deltaY;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,416 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Collision/cb2StaticTree.h>
+#include <CinderBox2D/Collision/cb2TreeBuild.h>
+#include <memory.h>
+
+cb2StaticTree::cb2StaticTree()
+{
+	m_proxyCapacity = 16;
+	m_proxyCount = 0;
+	m_proxies = (cb2StaticProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2StaticProxy));
+
+	// Build a linked list for the free list.
+	for (int i = 0; i < m_proxyCapacity - 1; ++i)
+	{
+		m_proxies[i].next = i + 1;
+		m_proxies[i].pending = e_freeProxy;
+	}
+	m_proxies[m_proxyCapacity-1].next = e_nullNode;
+	m_proxies[m_proxyCapacity-1].pending = e_freeProxy;
+	m_freeList = 0;
+
+	m_pendingCapacity = 16;
+	m_pendingCount = 0;
+	m_pending = (int*)cb2Alloc(m_pendingCapacity * sizeof(int));
+
+	m_nodeCapacity = 0;
+	m_nodeCount = 0;
+	m_nodes = NULL;
+	m_root = e_nullNode;
+
+	m_dirty = false;
+	m_attached = false;
+}
+
+cb2StaticTree::~cb2StaticTree()
+{
+	if (m_attached == false)
+	{
+		cb2Free(m_nodes);
+		cb2Free(m_proxies);
+	}
+	cb2Free(m_pending);
+}
+
+void cb2StaticTree::Copy(const cb2StaticTree& tree)
+{
+	// An attached tree shares the arrays of the other tree.
+	if (tree.m_attached)
+	{
+		cb2StaticTreeView view;
+		tree.GetView(&view);
+		Attach(view);
+		return;
+	}
+
+	if (m_attached)
+	{
+		m_proxies = NULL;
+		m_proxyCapacity = 0;
+		m_nodes = NULL;
+		m_nodeCapacity = 0;
+		m_attached = false;
+	}
+
+	if (m_proxyCapacity != tree.m_proxyCapacity)
+	{
+		cb2Free(m_proxies);
+		m_proxyCapacity = tree.m_proxyCapacity;
+		m_proxies = (cb2StaticProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2StaticProxy));
+	}
+	memcpy(m_proxies, tree.m_proxies, m_proxyCapacity * sizeof(cb2StaticProxy));
+
+	if (m_pendingCapacity != tree.m_pendingCapacity)
+	{
+		cb2Free(m_pending);
+		m_pendingCapacity = tree.m_pendingCapacity;
+		m_pending = (int*)cb2Alloc(m_pendingCapacity * sizeof(int));
+	}
+	memcpy(m_pending, tree.m_pending, tree.m_pendingCount * sizeof(int));
+
+	if (m_nodeCapacity < tree.m_nodeCount)
+	{
+		cb2Free(m_nodes);
+		m_nodeCapacity = tree.m_nodeCount;
+		m_nodes = (cb2StaticTreeNode*)cb2Alloc(m_nodeCapacity * sizeof(cb2StaticTreeNode));
+	}
+	if (tree.m_nodeCount > 0)
+	{
+		memcpy(m_nodes, tree.m_nodes, tree.m_nodeCount * sizeof(cb2StaticTreeNode));
+	}
+
+	m_proxyCount = tree.m_proxyCount;
+	m_freeList = tree.m_freeList;
+	m_pendingCount = tree.m_pendingCount;
+	m_nodeCount = tree.m_nodeCount;
+	m_root = tree.m_root;
+	m_dirty = tree.m_dirty;
+}
+
+int cb2StaticTree::CreateProxy(const cb2AABB& aabb, void* userData)
+{
+	cb2Assert(m_attached == false);
+	// Expand the proxy pool as needed.
+	if (m_freeList == e_nullNode)
+	{
+		cb2Assert(m_proxyCount == m_proxyCapacity);
+
+		cb2StaticProxy* oldProxies = m_proxies;
+		m_proxyCapacity *= 2;
+		m_proxies = (cb2StaticProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2StaticProxy));
+		memcpy(m_proxies, oldProxies, m_proxyCount * sizeof(cb2StaticProxy));
+		cb2Free(oldProxies);
+
+		for (int i = m_proxyCount; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxies[i].next = i + 1;
+			m_proxies[i].pending = e_freeProxy;
+		}
+		m_proxies[m_proxyCapacity-1].next = e_nullNode;
+		m_proxies[m_proxyCapacity-1].pending = e_freeProxy;
+		m_freeList = m_proxyCount;
+	}
+
+	int proxyId = m_freeList;
+	cb2StaticProxy* proxy = m_proxies + proxyId;
+	m_freeList = proxy->next;
+	++m_proxyCount;
+
+	// Fatten the aabb.
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	proxy->aabb.lowerBound = aabb.lowerBound - r;
+	proxy->aabb.upperBound = aabb.upperBound + r;
+	proxy->userData = userData;
+	proxy->next = e_nullNode;
+
+	AddPending(proxyId);
+	return proxyId;
+}
+
+void cb2StaticTree::DestroyProxy(int proxyId)
+{
+	cb2Assert(m_attached == false);
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2Assert(m_proxies[proxyId].pending != e_freeProxy);
+
+	if (m_proxies[proxyId].pending != e_nullNode)
+	{
+		RemovePending(proxyId);
+	}
+
+	// A leaf may still refer to this proxy until the next build.
+	cb2StaticProxy* proxy = m_proxies + proxyId;
+	proxy->pending = e_freeProxy;
+	proxy->userData = NULL;
+	proxy->next = m_freeList;
+	m_freeList = proxyId;
+	--m_proxyCount;
+	m_dirty = true;
+}
+
+bool cb2StaticTree::MoveProxy(int proxyId, const cb2AABB& aabb)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2Assert(m_proxies[proxyId].pending != e_freeProxy);
+
+	cb2StaticProxy* proxy = m_proxies + proxyId;
+	if (proxy->aabb.Contains(aabb))
+	{
+		return false;
+	}
+
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	cb2AABB b;
+	b.lowerBound = aabb.lowerBound - r;
+	b.upperBound = aabb.upperBound + r;
+	SetFatAABB(proxyId, b);
+	return true;
+}
+
+void cb2StaticTree::SetFatAABB(int proxyId, const cb2AABB& fatAABB)
+{
+	cb2Assert(m_attached == false);
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2Assert(m_proxies[proxyId].pending != e_freeProxy);
+
+	cb2StaticProxy* proxy = m_proxies + proxyId;
+	proxy->aabb = fatAABB;
+
+	if (proxy->pending == e_nullNode)
+	{
+		AddPending(proxyId);
+	}
+}
+
+void cb2StaticTree::AddPending(int proxyId)
+{
+	if (m_pendingCount == m_pendingCapacity)
+	{
+		int* oldPending = m_pending;
+		m_pendingCapacity *= 2;
+		m_pending = (int*)cb2Alloc(m_pendingCapacity * sizeof(int));
+		memcpy(m_pending, oldPending, m_pendingCount * sizeof(int));
+		cb2Free(oldPending);
+	}
+
+	m_proxies[proxyId].pending = m_pendingCount;
+	m_pending[m_pendingCount] = proxyId;
+	++m_pendingCount;
+	m_dirty = true;
+}
+
+void cb2StaticTree::RemovePending(int proxyId)
+{
+	int index = m_proxies[proxyId].pending;
+	cb2Assert(0 <= index && index < m_pendingCount);
+
+	--m_pendingCount;
+	int lastId = m_pending[m_pendingCount];
+	m_pending[index] = lastId;
+	m_proxies[lastId].pending = index;
+	m_proxies[proxyId].pending = e_nullNode;
+}
+
+void cb2StaticTree::Rebuild()
+{
+	if (m_dirty == false)
+	{
+		return;
+	}
+
+	int* proxyIds = (int*)cb2Alloc(cb2Max(m_proxyCount, 1) * sizeof(int));
+	int count = 0;
+	for (int i = 0; i < m_proxyCapacity; ++i)
+	{
+		if (m_proxies[i].pending != e_freeProxy)
+		{
+			m_proxies[i].pending = e_nullNode;
+			proxyIds[count++] = i;
+		}
+	}
+	cb2Assert(count == m_proxyCount);
+	m_pendingCount = 0;
+
+	// Every node has at least two children, except a root with only one proxy.
+	if (m_nodeCapacity < count)
+	{
+		cb2Free(m_nodes);
+		m_nodeCapacity = count;
+		m_nodes = (cb2StaticTreeNode*)cb2Alloc(m_nodeCapacity * sizeof(cb2StaticTreeNode));
+	}
+
+	m_nodeCount = 0;
+	m_root = count > 0 ? BuildNode(proxyIds, count) : e_nullNode;
+
+	cb2Free(proxyIds);
+	m_dirty = false;
+}
+
+int cb2StaticTree::BuildNode(int* proxyIds, int count)
+{
+	cb2Assert(m_nodeCount < m_nodeCapacity);
+	int nodeId = m_nodeCount++;
+
+	// Split the largest group until there are four.
+	int begin[4] = { 0, 0, 0, 0 };
+	int size[4] = { count, 0, 0, 0 };
+	int groupCount = 1;
+	while (groupCount < 4)
+	{
+		int largest = 0;
+		for (int i = 1; i < groupCount; ++i)
+		{
+			if (size[i] > size[largest])
+			{
+				largest = i;
+			}
+		}
+
+		if (size[largest] < 2)
+		{
+			break;
+		}
+
+		int leftCount = cb2PartitionSAH(proxyIds + begin[largest], size[largest], m_proxies);
+		begin[groupCount] = begin[largest] + leftCount;
+		size[groupCount] = size[largest] - leftCount;
+		size[largest] = leftCount;
+		++groupCount;
+	}
+
+	// Build the children before filling this node.
+	cb2AABB boxes[4];
+	int children[4];
+	int leafMask = 0;
+	for (int i = 0; i < groupCount; ++i)
+	{
+		const int* ids = proxyIds + begin[i];
+		boxes[i] = m_proxies[ids[0]].aabb;
+		for (int j = 1; j < size[i]; ++j)
+		{
+			boxes[i].Combine(m_proxies[ids[j]].aabb);
+		}
+
+		if (size[i] == 1)
+		{
+			children[i] = ids[0];
+			leafMask |= 1 << i;
+		}
+		else
+		{
+			children[i] = BuildNode(proxyIds + begin[i], size[i]);
+		}
+	}
+
+	cb2StaticTreeNode* node = m_nodes + nodeId;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i < groupCount)
+		{
+			node->lowerX[i] = boxes[i].lowerBound.x;
+			node->lowerY[i] = boxes[i].lowerBound.y;
+			node->upperX[i] = boxes[i].upperBound.x;
+			node->upperY[i] = boxes[i].upperBound.y;
+			node->children[i] = children[i];
+		}
+		else
+		{
+			node->lowerX[i] = cb2_maxFloat;
+			node->lowerY[i] = cb2_maxFloat;
+			node->upperX[i] = -cb2_maxFloat;
+			node->upperY[i] = -cb2_maxFloat;
+			node->children[i] = e_nullNode;
+		}
+	}
+	node->leafMask = leafMask;
+
+	return nodeId;
+}
+
+void cb2StaticTree::GetView(cb2StaticTreeView* view) const
+{
+	cb2Assert(m_dirty == false);
+	cb2Assert(m_attached || m_freeList == e_nullNode || m_freeList == m_proxyCount);
+	view->proxies = m_proxies;
+	view->proxyCount = m_proxyCount;
+	view->nodes = m_nodes;
+	view->nodeCount = m_nodeCount;
+	view->root = m_root;
+}
+
+void cb2StaticTree::Attach(const cb2StaticTreeView& view)
+{
+	if (m_attached == false)
+	{
+		cb2Free(m_nodes);
+		cb2Free(m_proxies);
+	}
+
+	// The arrays are never written while attached.
+	m_proxies = (cb2StaticProxy*)view.proxies;
+	m_proxyCapacity = view.proxyCount;
+	m_proxyCount = view.proxyCount;
+	m_freeList = e_nullNode;
+	m_pendingCount = 0;
+	m_nodes = (cb2StaticTreeNode*)view.nodes;
+	m_nodeCapacity = view.nodeCount;
+	m_nodeCount = view.nodeCount;
+	m_root = view.root;
+	m_dirty = false;
+	m_attached = true;
+}
+
+void cb2StaticTree::ShiftOrigin(const ci::Vec2f& newOrigin)
+{
+	cb2Assert(m_attached == false);
+	for (int i = 0; i < m_proxyCapacity; ++i)
+	{
+		if (m_proxies[i].pending != e_freeProxy)
+		{
+			m_proxies[i].aabb.lowerBound -= newOrigin;
+			m_proxies[i].aabb.upperBound -= newOrigin;
+		}
+	}
+
+	for (int i = 0; i < m_nodeCount; ++i)
+	{
+		cb2StaticTreeNode* node = m_nodes + i;
+		for (int j = 0; j < 4; ++j)
+		{
+			if (node->children[j] != e_nullNode)
+			{
+				node->lowerX[j] -= newOrigin.x;
+				node->lowerY[j] -= newOrigin.y;
+				node->upperX[j] -= newOrigin.x;
+				node->upperY[j] -= newOrigin.y;
+			}
+		}
+	}
+}
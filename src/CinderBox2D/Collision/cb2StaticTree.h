@@ -0,0 +1,512 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_STATIC_TREE_H
+#define CB2_STATIC_TREE_H
+
+#include <CinderBox2D/Collision/cb2Collision.h>
+#include <CinderBox2D/Common/cb2GrowableHeap.h>
+#include <CinderBox2D/Common/cb2GrowableStack.h>
+#include <CinderBox2D/Common/cb2Simd.h>
+
+/// A node of the static tree with four children. Leaf children are proxy ids.
+/// Unused children have an inverted box so they never overlap anything.
+struct cb2StaticTreeNode
+{
+	float lowerX[4];
+	float lowerY[4];
+	float upperX[4];
+	float upperY[4];
+	int children[4];
+	int leafMask;
+};
+
+/// A proxy stored in the static tree.
+struct cb2StaticProxy
+{
+	/// Enlarged AABB
+	cb2AABB aabb;
+	void* userData;
+
+	/// Index in the pending list, -1 when in the tree, -2 when free.
+	int pending;
+	int next;
+};
+
+/// The arrays of a built static tree, so it can be stored in a file and used in place.
+/// See cb2StaticTree::Attach.
+struct cb2StaticTreeView
+{
+	const cb2StaticProxy* proxies;
+	int proxyCount;
+	const cb2StaticTreeNode* nodes;
+	int nodeCount;
+	int root;
+};
+
+/// A bounding volume hierarchy for proxies that rarely move, such as level geometry.
+/// The tree is built top-down with a binned surface area heuristic and stores four
+/// children per node, so a query tests four boxes with one SIMD compare. Proxies that
+/// were created or moved since the last Rebuild are kept in a pending list and tested
+/// one at a time until the next Rebuild.
+class cb2StaticTree
+{
+public:
+
+	enum
+	{
+		e_nullNode = -1,
+		e_freeProxy = -2
+	};
+
+	cb2StaticTree();
+	~cb2StaticTree();
+
+	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
+	int CreateProxy(const cb2AABB& aabb, void* userData);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int proxyId);
+
+	/// Move a proxy. If the proxy has moved outside of its fattened AABB it becomes
+	/// pending until the next Rebuild.
+	/// @return true if the fattened AABB changed.
+	bool MoveProxy(int proxyId, const cb2AABB& aabb);
+
+	/// Give a proxy this fattened AABB as is. It becomes pending until the next Rebuild.
+	void SetFatAABB(int proxyId, const cb2AABB& fatAABB);
+
+	/// Get proxy user data.
+	void* GetUserData(int proxyId) const;
+
+	/// Set proxy user data.
+	void SetUserData(int proxyId, void* userData);
+
+	/// Get the fat AABB for a proxy.
+	const cb2AABB& GetFatAABB(int proxyId) const;
+
+	/// Make this tree a copy of another tree. Proxy ids and user data are kept.
+	void Copy(const cb2StaticTree& tree);
+
+	/// Get the number of proxies.
+	int GetProxyCount() const;
+
+	/// Get the number of nodes of the last build.
+	int GetNodeCount() const { return m_nodeCount; }
+
+	/// Get the number of nodes the node array holds.
+	int GetNodeCapacity() const { return m_nodeCapacity; }
+
+	/// Get the bytes of the proxy, pending and node arrays.
+	int GetMemory() const
+	{
+		return m_proxyCapacity * (int)sizeof(cb2StaticProxy) + m_pendingCapacity * (int)sizeof(int) +
+			m_nodeCapacity * (int)sizeof(cb2StaticTreeNode);
+	}
+
+	/// Rebuild the tree from all proxies if any proxy changed since the last build.
+	void Rebuild();
+
+	/// Get the arrays of the tree after a Rebuild. The proxy ids must be 0 to n - 1,
+	/// as they are when no proxy was destroyed.
+	void GetView(cb2StaticTreeView* view) const;
+
+	/// Use the arrays of a built tree held elsewhere, such as a mapped level file, without
+	/// copying them. The tree is then read only and the arrays must outlive it.
+	void Attach(const cb2StaticTreeView& view);
+
+	/// Is the tree using arrays it does not own?
+	bool IsAttached() const { return m_attached; }
+
+	/// Query an AABB for overlapping proxies. The callback class
+	/// is called for each proxy that overlaps the supplied AABB.
+	template <typename T>
+	void Query(T* callback, const cb2AABB& aabb) const;
+
+	/// Ray-cast against the proxies in the tree. The callback works as in cb2DynamicTree::RayCast.
+	template <typename T>
+	void RayCast(T* callback, const cb2RayCastInput& input) const;
+
+	/// Visit the proxies nearest to a point first. The callback works as in
+	/// cb2DynamicTree::QueryClosest. Pending proxies are visited after the tree.
+	template <typename T>
+	void QueryClosest(T* callback, const ci::Vec2f& point, float maxDistance) const;
+
+	/// Shift the world origin. Useful for large worlds.
+	/// The shift formula is: position -= newOrigin
+	/// @param newOrigin the new origin with respect to the old origin
+	void ShiftOrigin(const ci::Vec2f& newOrigin);
+
+private:
+
+	void AddPending(int proxyId);
+	void RemovePending(int proxyId);
+
+	int BuildNode(int* proxyIds, int count);
+
+	cb2StaticProxy* m_proxies;
+	int m_proxyCapacity;
+	int m_proxyCount;
+	int m_freeList;
+
+	int* m_pending;
+	int m_pendingCapacity;
+	int m_pendingCount;
+
+	cb2StaticTreeNode* m_nodes;
+	int m_nodeCapacity;
+	int m_nodeCount;
+	int m_root;
+
+	bool m_dirty;
+	bool m_attached;
+};
+
+inline void* cb2StaticTree::GetUserData(int proxyId) const
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline void cb2StaticTree::SetUserData(int proxyId, void* userData)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].userData = userData;
+}
+
+inline const cb2AABB& cb2StaticTree::GetFatAABB(int proxyId) const
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].aabb;
+}
+
+inline int cb2StaticTree::GetProxyCount() const
+{
+	return m_proxyCount;
+}
+
+template <typename T>
+inline void cb2StaticTree::Query(T* callback, const cb2AABB& aabb) const
+{
+	if (m_root != e_nullNode)
+	{
+		cb2FloatW qLowerX = cb2SplatW(aabb.lowerBound.x);
+		cb2FloatW qLowerY = cb2SplatW(aabb.lowerBound.y);
+		cb2FloatW qUpperX = cb2SplatW(aabb.upperBound.x);
+		cb2FloatW qUpperY = cb2SplatW(aabb.upperBound.y);
+		cb2FloatW zero = cb2ZeroW();
+
+		cb2GrowableStack<int, 256> stack;
+		stack.Push(m_root);
+
+		while (stack.GetCount() > 0)
+		{
+			const cb2StaticTreeNode* node = m_nodes + stack.Pop();
+
+			// The boxes overlap when no axis separates them.
+			cb2FloatW d = cb2MaxW(cb2SubW(cb2LoadW(node->lowerX), qUpperX), cb2SubW(cb2LoadW(node->lowerY), qUpperY));
+			d = cb2MaxW(d, cb2MaxW(cb2SubW(qLowerX, cb2LoadW(node->upperX)), cb2SubW(qLowerY, cb2LoadW(node->upperY))));
+			int mask = cb2MaskLessEqualW(d, zero);
+
+			// Push in reverse so the first child is visited first.
+			for (int i = 3; i >= 0; --i)
+			{
+				if ((mask & (1 << i)) == 0 || (node->leafMask & (1 << i)) != 0)
+				{
+					continue;
+				}
+
+				stack.Push(node->children[i]);
+			}
+
+			mask &= node->leafMask;
+			for (int i = 0; i < 4; ++i)
+			{
+				if ((mask & (1 << i)) == 0)
+				{
+					continue;
+				}
+
+				// Skip proxies that moved or were destroyed since the build.
+				int proxyId = node->children[i];
+				if (m_proxies[proxyId].pending != e_nullNode)
+				{
+					continue;
+				}
+
+				bool proceed = callback->QueryCallback(proxyId);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < m_pendingCount; ++i)
+	{
+		int proxyId = m_pending[i];
+		if (cb2TestOverlap(m_proxies[proxyId].aabb, aabb))
+		{
+			bool proceed = callback->QueryCallback(proxyId);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+	}
+}
+
+/// A node or proxy waiting in a closest query of the static tree.
+struct cb2StaticTreeClosestEntry
+{
+	float key;
+	int id;
+	bool leaf;
+};
+
+template <typename T>
+inline void cb2StaticTree::QueryClosest(T* callback, const ci::Vec2f& point, float maxDistance) const
+{
+	if (maxDistance < 0.0f)
+	{
+		return;
+	}
+
+	float maxDistanceSqr = maxDistance * maxDistance;
+	if (m_root != e_nullNode)
+	{
+		cb2GrowableHeap<cb2StaticTreeClosestEntry, 256> heap;
+		cb2StaticTreeClosestEntry entry;
+		entry.key = 0.0f;
+		entry.id = m_root;
+		entry.leaf = false;
+		heap.Push(entry);
+
+		while (heap.GetCount() > 0)
+		{
+			entry = heap.Pop();
+			if (entry.key > maxDistanceSqr)
+			{
+				break;
+			}
+
+			if (entry.leaf)
+			{
+				float distance = callback->ClosestCallback(entry.id);
+				if (distance < 0.0f)
+				{
+					return;
+				}
+				maxDistanceSqr = cb2Min(maxDistanceSqr, distance * distance);
+				continue;
+			}
+
+			const cb2StaticTreeNode* node = m_nodes + entry.id;
+			for (int i = 0; i < 4; ++i)
+			{
+				int child = node->children[i];
+				if (child == e_nullNode)
+				{
+					continue;
+				}
+
+				bool leaf = (node->leafMask & (1 << i)) != 0;
+
+				// Skip proxies that moved or were destroyed since the build.
+				if (leaf && m_proxies[child].pending != e_nullNode)
+				{
+					continue;
+				}
+
+				float dx = cb2Max(cb2Max(node->lowerX[i] - point.x, point.x - node->upperX[i]), 0.0f);
+				float dy = cb2Max(cb2Max(node->lowerY[i] - point.y, point.y - node->upperY[i]), 0.0f);
+				cb2StaticTreeClosestEntry next;
+				next.key = dx * dx + dy * dy;
+				next.id = child;
+				next.leaf = leaf;
+				if (next.key <= maxDistanceSqr)
+				{
+					heap.Push(next);
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < m_pendingCount; ++i)
+	{
+		int proxyId = m_pending[i];
+		if (cb2DistanceSquared(m_proxies[proxyId].aabb, point) <= maxDistanceSqr)
+		{
+			float distance = callback->ClosestCallback(proxyId);
+			if (distance < 0.0f)
+			{
+				return;
+			}
+			maxDistanceSqr = cb2Min(maxDistanceSqr, distance * distance);
+		}
+	}
+}
+
+template <typename T>
+inline void cb2StaticTree::RayCast(T* callback, const cb2RayCastInput& input) const
+{
+	ci::Vec2f p1 = input.p1;
+	ci::Vec2f p2 = input.p2;
+	ci::Vec2f r = p2 - p1;
+	cb2Assert(r.lengthSquared() > 0.0f);
+	r.normalize();
+
+	// v is perpendicular to the segment.
+	ci::Vec2f v = cb2Cross(1.0f, r);
+	ci::Vec2f abs_v = cb2Abs(v);
+
+	float maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	cb2AABB segmentAABB;
+	{
+		ci::Vec2f t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = cb2Min(p1, t);
+		segmentAABB.upperBound = cb2Max(p1, t);
+	}
+
+	cb2RayCastInput subInput;
+	subInput.p1 = input.p1;
+	subInput.p2 = input.p2;
+
+	if (m_root != e_nullNode)
+	{
+		cb2FloatW zero = cb2ZeroW();
+		cb2FloatW half = cb2SplatW(0.5f);
+		cb2FloatW p1X = cb2SplatW(p1.x);
+		cb2FloatW p1Y = cb2SplatW(p1.y);
+		cb2FloatW vX = cb2SplatW(v.x);
+		cb2FloatW vY = cb2SplatW(v.y);
+		cb2FloatW absVX = cb2SplatW(abs_v.x);
+		cb2FloatW absVY = cb2SplatW(abs_v.y);
+
+		cb2GrowableStack<int, 256> stack;
+		stack.Push(m_root);
+
+		while (stack.GetCount() > 0)
+		{
+			const cb2StaticTreeNode* node = m_nodes + stack.Pop();
+
+			cb2FloatW lowerX = cb2LoadW(node->lowerX);
+			cb2FloatW lowerY = cb2LoadW(node->lowerY);
+			cb2FloatW upperX = cb2LoadW(node->upperX);
+			cb2FloatW upperY = cb2LoadW(node->upperY);
+
+			// Overlap with the segment bounding box.
+			cb2FloatW d = cb2MaxW(cb2SubW(lowerX, cb2SplatW(segmentAABB.upperBound.x)), cb2SubW(lowerY, cb2SplatW(segmentAABB.upperBound.y)));
+			d = cb2MaxW(d, cb2MaxW(cb2SubW(cb2SplatW(segmentAABB.lowerBound.x), upperX), cb2SubW(cb2SplatW(segmentAABB.lowerBound.y), upperY)));
+			int mask = cb2MaskLessEqualW(d, zero);
+
+			// Separating axis for segment (Gino, p80).
+			// |dot(v, p1 - c)| > dot(|v|, h)
+			cb2FloatW cX = cb2MulW(half, cb2AddW(lowerX, upperX));
+			cb2FloatW cY = cb2MulW(half, cb2AddW(lowerY, upperY));
+			cb2FloatW hX = cb2MulW(half, cb2SubW(upperX, lowerX));
+			cb2FloatW hY = cb2MulW(half, cb2SubW(upperY, lowerY));
+			cb2FloatW dot = cb2AddW(cb2MulW(vX, cb2SubW(p1X, cX)), cb2MulW(vY, cb2SubW(p1Y, cY)));
+			dot = cb2MaxW(dot, cb2SubW(zero, dot));
+			cb2FloatW separation = cb2SubW(dot, cb2AddW(cb2MulW(absVX, hX), cb2MulW(absVY, hY)));
+			mask &= cb2MaskLessEqualW(separation, zero);
+
+			// Push in reverse so the first child is visited first.
+			for (int i = 3; i >= 0; --i)
+			{
+				if ((mask & (1 << i)) == 0 || (node->leafMask & (1 << i)) != 0)
+				{
+					continue;
+				}
+
+				stack.Push(node->children[i]);
+			}
+
+			mask &= node->leafMask;
+			for (int i = 0; i < 4; ++i)
+			{
+				if ((mask & (1 << i)) == 0)
+				{
+					continue;
+				}
+
+				int proxyId = node->children[i];
+				if (m_proxies[proxyId].pending != e_nullNode)
+				{
+					continue;
+				}
+
+				subInput.maxFraction = maxFraction;
+				float value = callback->RayCastCallback(subInput, proxyId);
+
+				if (value == 0.0f)
+				{
+					// The client has terminated the ray cast.
+					return;
+				}
+
+				if (value > 0.0f)
+				{
+					// Update segment bounding box.
+					maxFraction = value;
+					ci::Vec2f t = p1 + maxFraction * (p2 - p1);
+					segmentAABB.lowerBound = cb2Min(p1, t);
+					segmentAABB.upperBound = cb2Max(p1, t);
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < m_pendingCount; ++i)
+	{
+		int proxyId = m_pending[i];
+		const cb2AABB& aabb = m_proxies[proxyId].aabb;
+		if (cb2TestOverlap(aabb, segmentAABB) == false)
+		{
+			continue;
+		}
+
+		ci::Vec2f c = aabb.GetCenter();
+		ci::Vec2f h = aabb.GetExtents();
+		float separation = cb2Abs(cb2Dot(v, p1 - c)) - cb2Dot(abs_v, h);
+		if (separation > 0.0f)
+		{
+			continue;
+		}
+
+		subInput.maxFraction = maxFraction;
+		float value = callback->RayCastCallback(subInput, proxyId);
+
+		if (value == 0.0f)
+		{
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			maxFraction = value;
+			ci::Vec2f t = p1 + maxFraction * (p2 - p1);
+			segmentAABB.lowerBound = cb2Min(p1, t);
+			segmentAABB.upperBound = cb2Max(p1, t);
+		}
+	}
+}
+
+#endif
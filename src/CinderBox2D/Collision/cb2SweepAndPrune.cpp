@@ -0,0 +1,393 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Collision/cb2SweepAndPrune.h>
+#include <algorithm>
+#include <memory.h>
+
+// Proxies wider than this are kept out of the sorted array.
+const float cb2_sweepLargeWidth = 8.0f;
+
+// Beyond this many order violations a full sort is cheaper than an insertion sort.
+const int cb2_sweepMaxInsertionCount = 256;
+
+/// This is used to sort proxies by their lower bound.
+struct cb2SweepLessThan
+{
+	bool operator()(int proxyIdA, int proxyIdB) const
+	{
+		return proxies[proxyIdA].aabb.lowerBound.x < proxies[proxyIdB].aabb.lowerBound.x;
+	}
+
+	const cb2SweepProxy* proxies;
+};
+
+cb2SweepAndPrune::cb2SweepAndPrune()
+{
+	m_proxyCapacity = 16;
+	m_proxyCount = 0;
+	m_proxies = (cb2SweepProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2SweepProxy));
+
+	// Build a linked list for the free list.
+	for (int i = 0; i < m_proxyCapacity - 1; ++i)
+	{
+		m_proxies[i].next = i + 1;
+		m_proxies[i].index = e_freeProxy;
+	}
+	m_proxies[m_proxyCapacity-1].next = e_nullNode;
+	m_proxies[m_proxyCapacity-1].index = e_freeProxy;
+	m_freeList = 0;
+
+	m_sortedCapacity = 16;
+	m_sortedCount = 0;
+	m_sorted = (int*)cb2Alloc(m_sortedCapacity * sizeof(int));
+
+	m_largeCapacity = 16;
+	m_largeCount = 0;
+	m_largeProxies = (int*)cb2Alloc(m_largeCapacity * sizeof(int));
+
+	m_movedCapacity = 16;
+	m_movedCount = 0;
+	m_moved = (int*)cb2Alloc(m_movedCapacity * sizeof(int));
+
+	m_maxWidth = 0.0f;
+	m_unsortedCount = 0;
+}
+
+cb2SweepAndPrune::~cb2SweepAndPrune()
+{
+	cb2Free(m_moved);
+	cb2Free(m_largeProxies);
+	cb2Free(m_sorted);
+	cb2Free(m_proxies);
+}
+
+void cb2SweepAndPrune::Copy(const cb2SweepAndPrune& sweep)
+{
+	if (m_proxyCapacity != sweep.m_proxyCapacity)
+	{
+		cb2Free(m_proxies);
+		m_proxyCapacity = sweep.m_proxyCapacity;
+		m_proxies = (cb2SweepProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2SweepProxy));
+	}
+	memcpy(m_proxies, sweep.m_proxies, m_proxyCapacity * sizeof(cb2SweepProxy));
+
+	if (m_sortedCapacity != sweep.m_sortedCapacity)
+	{
+		cb2Free(m_sorted);
+		m_sortedCapacity = sweep.m_sortedCapacity;
+		m_sorted = (int*)cb2Alloc(m_sortedCapacity * sizeof(int));
+	}
+	memcpy(m_sorted, sweep.m_sorted, sweep.m_sortedCount * sizeof(int));
+
+	if (m_largeCapacity != sweep.m_largeCapacity)
+	{
+		cb2Free(m_largeProxies);
+		m_largeCapacity = sweep.m_largeCapacity;
+		m_largeProxies = (int*)cb2Alloc(m_largeCapacity * sizeof(int));
+	}
+	memcpy(m_largeProxies, sweep.m_largeProxies, sweep.m_largeCount * sizeof(int));
+
+	if (m_movedCapacity != sweep.m_movedCapacity)
+	{
+		cb2Free(m_moved);
+		m_movedCapacity = sweep.m_movedCapacity;
+		m_moved = (int*)cb2Alloc(m_movedCapacity * sizeof(int));
+	}
+	memcpy(m_moved, sweep.m_moved, sweep.m_movedCount * sizeof(int));
+
+	m_proxyCount = sweep.m_proxyCount;
+	m_freeList = sweep.m_freeList;
+	m_sortedCount = sweep.m_sortedCount;
+	m_largeCount = sweep.m_largeCount;
+	m_movedCount = sweep.m_movedCount;
+	m_maxWidth = sweep.m_maxWidth;
+	m_unsortedCount = sweep.m_unsortedCount;
+}
+
+int cb2SweepAndPrune::CreateProxy(const cb2AABB& aabb, void* userData)
+{
+	// Expand the proxy pool as needed.
+	if (m_freeList == e_nullNode)
+	{
+		cb2Assert(m_proxyCount == m_proxyCapacity);
+
+		cb2SweepProxy* oldProxies = m_proxies;
+		m_proxyCapacity *= 2;
+		m_proxies = (cb2SweepProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2SweepProxy));
+		memcpy(m_proxies, oldProxies, m_proxyCount * sizeof(cb2SweepProxy));
+		cb2Free(oldProxies);
+
+		for (int i = m_proxyCount; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxies[i].next = i + 1;
+			m_proxies[i].index = e_freeProxy;
+		}
+		m_proxies[m_proxyCapacity-1].next = e_nullNode;
+		m_proxies[m_proxyCapacity-1].index = e_freeProxy;
+		m_freeList = m_proxyCount;
+	}
+
+	int proxyId = m_freeList;
+	cb2SweepProxy* proxy = m_proxies + proxyId;
+	m_freeList = proxy->next;
+	++m_proxyCount;
+
+	// Fatten the aabb.
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	proxy->aabb.lowerBound = aabb.lowerBound - r;
+	proxy->aabb.upperBound = aabb.upperBound + r;
+	proxy->userData = userData;
+	proxy->next = e_nullNode;
+	proxy->moved = false;
+
+	InsertProxy(proxyId);
+	return proxyId;
+}
+
+void cb2SweepAndPrune::DestroyProxy(int proxyId)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2Assert(m_proxies[proxyId].index != e_freeProxy);
+
+	RemoveProxy(proxyId);
+
+	m_proxies[proxyId].index = e_freeProxy;
+	m_proxies[proxyId].next = m_freeList;
+	m_freeList = proxyId;
+	--m_proxyCount;
+}
+
+bool cb2SweepAndPrune::MoveProxy(int proxyId, const cb2AABB& aabb, const ci::Vec2f& displacement)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2Assert(m_proxies[proxyId].index != e_freeProxy);
+
+	cb2SweepProxy* proxy = m_proxies + proxyId;
+	if (proxy->aabb.Contains(aabb))
+	{
+		return false;
+	}
+
+	// Extend AABB.
+	cb2AABB b = aabb;
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	b.lowerBound = b.lowerBound - r;
+	b.upperBound = b.upperBound + r;
+
+	// Predict AABB displacement.
+	ci::Vec2f d = cb2_aabbMultiplier * displacement;
+
+	if (d.x < 0.0f)
+	{
+		b.lowerBound.x += d.x;
+	}
+	else
+	{
+		b.upperBound.x += d.x;
+	}
+
+	if (d.y < 0.0f)
+	{
+		b.lowerBound.y += d.y;
+	}
+	else
+	{
+		b.upperBound.y += d.y;
+	}
+
+	SetFatAABB(proxyId, b);
+	return true;
+}
+
+void cb2SweepAndPrune::SetFatAABB(int proxyId, const cb2AABB& fatAABB)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2Assert(m_proxies[proxyId].index != e_freeProxy);
+
+	cb2SweepProxy* proxy = m_proxies + proxyId;
+	float width = fatAABB.upperBound.x - fatAABB.lowerBound.x;
+	if (proxy->large != (width > cb2_sweepLargeWidth))
+	{
+		RemoveProxy(proxyId);
+		proxy->aabb = fatAABB;
+		InsertProxy(proxyId);
+		return;
+	}
+
+	proxy->aabb = fatAABB;
+	if (proxy->large)
+	{
+		return;
+	}
+
+	// Note when the proxy has passed a neighbor. The next sort restores the order.
+	m_maxWidth = cb2Max(m_maxWidth, width);
+	int index = proxy->index;
+	if ((index > 0 && m_proxies[m_sorted[index - 1]].aabb.lowerBound.x > fatAABB.lowerBound.x) ||
+		(index + 1 < m_sortedCount && m_proxies[m_sorted[index + 1]].aabb.lowerBound.x < fatAABB.lowerBound.x))
+	{
+		++m_unsortedCount;
+	}
+}
+
+void cb2SweepAndPrune::MarkMoved(int proxyId)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	cb2SweepProxy* proxy = m_proxies + proxyId;
+	if (proxy->moved)
+	{
+		return;
+	}
+
+	if (m_movedCount == m_movedCapacity)
+	{
+		int* oldMoved = m_moved;
+		m_movedCapacity *= 2;
+		m_moved = (int*)cb2Alloc(m_movedCapacity * sizeof(int));
+		memcpy(m_moved, oldMoved, m_movedCount * sizeof(int));
+		cb2Free(oldMoved);
+	}
+
+	proxy->moved = true;
+	m_moved[m_movedCount] = proxyId;
+	++m_movedCount;
+}
+
+void cb2SweepAndPrune::InsertProxy(int proxyId)
+{
+	cb2SweepProxy* proxy = m_proxies + proxyId;
+	float width = proxy->aabb.upperBound.x - proxy->aabb.lowerBound.x;
+	proxy->large = width > cb2_sweepLargeWidth;
+
+	if (proxy->large)
+	{
+		if (m_largeCount == m_largeCapacity)
+		{
+			int* oldLarge = m_largeProxies;
+			m_largeCapacity *= 2;
+			m_largeProxies = (int*)cb2Alloc(m_largeCapacity * sizeof(int));
+			memcpy(m_largeProxies, oldLarge, m_largeCount * sizeof(int));
+			cb2Free(oldLarge);
+		}
+
+		proxy->index = m_largeCount;
+		m_largeProxies[m_largeCount] = proxyId;
+		++m_largeCount;
+		return;
+	}
+
+	if (m_sortedCount == m_sortedCapacity)
+	{
+		int* oldSorted = m_sorted;
+		m_sortedCapacity *= 2;
+		m_sorted = (int*)cb2Alloc(m_sortedCapacity * sizeof(int));
+		memcpy(m_sorted, oldSorted, m_sortedCount * sizeof(int));
+		cb2Free(oldSorted);
+	}
+
+	// Append. The next sort moves the proxy into place.
+	if (m_sortedCount > 0 && m_proxies[m_sorted[m_sortedCount - 1]].aabb.lowerBound.x > proxy->aabb.lowerBound.x)
+	{
+		++m_unsortedCount;
+	}
+
+	m_maxWidth = cb2Max(m_maxWidth, width);
+	proxy->index = m_sortedCount;
+	m_sorted[m_sortedCount] = proxyId;
+	++m_sortedCount;
+}
+
+void cb2SweepAndPrune::RemoveProxy(int proxyId)
+{
+	cb2SweepProxy* proxy = m_proxies + proxyId;
+	int index = proxy->index;
+
+	if (proxy->large)
+	{
+		// Swap the last large proxy into the hole.
+		--m_largeCount;
+		int lastId = m_largeProxies[m_largeCount];
+		m_largeProxies[index] = lastId;
+		m_proxies[lastId].index = index;
+		return;
+	}
+
+	// Close the gap, keeping the order.
+	--m_sortedCount;
+	for (int i = index; i < m_sortedCount; ++i)
+	{
+		m_sorted[i] = m_sorted[i + 1];
+		m_proxies[m_sorted[i]].index = i;
+	}
+}
+
+void cb2SweepAndPrune::Sort()
+{
+	if (m_unsortedCount == 0)
+	{
+		return;
+	}
+
+	if (m_unsortedCount > cb2_sweepMaxInsertionCount)
+	{
+		cb2SweepLessThan lessThan;
+		lessThan.proxies = m_proxies;
+		std::sort(m_sorted, m_sorted + m_sortedCount, lessThan);
+	}
+	else
+	{
+		// Coherent motion leaves the proxies nearly sorted.
+		for (int i = 1; i < m_sortedCount; ++i)
+		{
+			int proxyId = m_sorted[i];
+			float x = m_proxies[proxyId].aabb.lowerBound.x;
+
+			int j = i - 1;
+			while (j >= 0 && m_proxies[m_sorted[j]].aabb.lowerBound.x > x)
+			{
+				m_sorted[j + 1] = m_sorted[j];
+				--j;
+			}
+			m_sorted[j + 1] = proxyId;
+		}
+	}
+
+	// Update the indices and tighten the search window.
+	m_maxWidth = 0.0f;
+	for (int i = 0; i < m_sortedCount; ++i)
+	{
+		cb2SweepProxy* proxy = m_proxies + m_sorted[i];
+		proxy->index = i;
+		m_maxWidth = cb2Max(m_maxWidth, proxy->aabb.upperBound.x - proxy->aabb.lowerBound.x);
+	}
+
+	m_unsortedCount = 0;
+}
+
+void cb2SweepAndPrune::ShiftOrigin(const ci::Vec2f& newOrigin)
+{
+	// The order along x does not change.
+	for (int i = 0; i < m_proxyCapacity; ++i)
+	{
+		if (m_proxies[i].index != e_freeProxy)
+		{
+			m_proxies[i].aabb.lowerBound -= newOrigin;
+			m_proxies[i].aabb.upperBound -= newOrigin;
+		}
+	}
+}
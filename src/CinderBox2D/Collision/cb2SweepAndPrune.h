@@ -0,0 +1,396 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_SWEEP_AND_PRUNE_H
+#define CB2_SWEEP_AND_PRUNE_H
+
+#include <CinderBox2D/Collision/cb2Collision.h>
+
+/// A proxy stored in the sweep and prune.
+struct cb2SweepProxy
+{
+	/// Enlarged AABB
+	cb2AABB aabb;
+	void* userData;
+
+	/// Index in the sorted array or in the large proxy list, -2 when free.
+	int index;
+	int next;
+	bool large;
+	bool moved;
+};
+
+/// Proxies sorted along the x-axis by the lower bound of their fattened AABB. The order
+/// is restored with an insertion sort, which is close to linear when the motion is coherent
+/// from frame to frame. New pairs are found by sweeping the sorted proxies around each
+/// moved proxy, so resting proxies cost nothing.
+/// Proxies much wider than the rest are kept in a separate list so they do not
+/// widen the search window of every query.
+/// The proxy interface is the same as cb2DynamicTree.
+class cb2SweepAndPrune
+{
+public:
+
+	enum
+	{
+		e_nullNode = -1,
+		e_freeProxy = -2
+	};
+
+	/// Constructing the sweep and prune initializes the proxy pool.
+	cb2SweepAndPrune();
+
+	/// Destroy the sweep and prune, freeing the proxy pool.
+	~cb2SweepAndPrune();
+
+	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
+	int CreateProxy(const cb2AABB& aabb, void* userData);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int proxyId);
+
+	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
+	/// then the fattened AABB is recomputed.
+	/// @return true if the fattened AABB changed.
+	bool MoveProxy(int proxyId, const cb2AABB& aabb1, const ci::Vec2f& displacement);
+
+	/// Give a proxy this fattened AABB as is.
+	void SetFatAABB(int proxyId, const cb2AABB& fatAABB);
+
+	/// Get proxy user data.
+	void* GetUserData(int proxyId) const;
+
+	/// Set proxy user data.
+	void SetUserData(int proxyId, void* userData);
+
+	/// Get the fat AABB for a proxy.
+	const cb2AABB& GetFatAABB(int proxyId) const;
+
+	/// Make this sweep and prune a copy of another one. Proxy ids and user data are kept.
+	void Copy(const cb2SweepAndPrune& sweep);
+
+	/// Get the number of proxies.
+	int GetProxyCount() const { return m_proxyCount; }
+
+	/// Get the bytes of the proxy, sorted, large proxy and moved arrays.
+	int GetMemory() const
+	{
+		return m_proxyCapacity * (int)sizeof(cb2SweepProxy) +
+			(m_sortedCapacity + m_largeCapacity + m_movedCapacity) * (int)sizeof(int);
+	}
+
+	/// Mark a proxy so that FindPairs reports its pairs.
+	void MarkMoved(int proxyId);
+
+	/// Sort the proxies and report each overlapping pair with a marked proxy by calling
+	/// callback->PairCallback(proxyIdA, proxyIdB). The marks are cleared.
+	template <typename T>
+	void FindPairs(T* callback);
+
+	/// Query an AABB for overlapping proxies. The callback class
+	/// is called for each proxy that overlaps the supplied AABB.
+	template <typename T>
+	void Query(T* callback, const cb2AABB& aabb) const;
+
+	/// Ray-cast against the proxies. The callback works as in cb2DynamicTree::RayCast.
+	template <typename T>
+	void RayCast(T* callback, const cb2RayCastInput& input) const;
+
+	/// Shift the world origin. Useful for large worlds.
+	/// The shift formula is: position -= newOrigin
+	/// @param newOrigin the new origin with respect to the old origin
+	void ShiftOrigin(const ci::Vec2f& newOrigin);
+
+private:
+
+	void Sort();
+
+	void InsertProxy(int proxyId);
+	void RemoveProxy(int proxyId);
+
+	/// Get the first sorted index that may overlap a box whose lower bound is lowerX.
+	int FindFirst(float lowerX) const;
+
+	cb2SweepProxy* m_proxies;
+	int m_proxyCapacity;
+	int m_proxyCount;
+	int m_freeList;
+
+	int* m_sorted;
+	int m_sortedCapacity;
+	int m_sortedCount;
+
+	int* m_largeProxies;
+	int m_largeCapacity;
+	int m_largeCount;
+
+	int* m_moved;
+	int m_movedCapacity;
+	int m_movedCount;
+
+	/// The widest proxy in the sorted array is no wider than this.
+	float m_maxWidth;
+
+	/// Number of order violations since the last sort. The sorted array
+	/// can only be searched when this is zero.
+	int m_unsortedCount;
+};
+
+inline void* cb2SweepAndPrune::GetUserData(int proxyId) const
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline void cb2SweepAndPrune::SetUserData(int proxyId, void* userData)
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].userData = userData;
+}
+
+inline const cb2AABB& cb2SweepAndPrune::GetFatAABB(int proxyId) const
+{
+	cb2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].aabb;
+}
+
+inline int cb2SweepAndPrune::FindFirst(float lowerX) const
+{
+	if (m_unsortedCount > 0)
+	{
+		return 0;
+	}
+
+	// Binary search for the first proxy that starts within the widest proxy of lowerX.
+	float x = lowerX - m_maxWidth;
+	int low = 0;
+	int high = m_sortedCount;
+	while (low < high)
+	{
+		int mid = (low + high) >> 1;
+		if (m_proxies[m_sorted[mid]].aabb.lowerBound.x < x)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+template <typename T>
+void cb2SweepAndPrune::FindPairs(T* callback)
+{
+	Sort();
+
+	// Large proxies are tested against everything.
+	for (int i = 0; i < m_largeCount; ++i)
+	{
+		int proxyIdA = m_largeProxies[i];
+		const cb2SweepProxy* proxyA = m_proxies + proxyIdA;
+
+		for (int j = FindFirst(proxyA->aabb.lowerBound.x); j < m_sortedCount; ++j)
+		{
+			int proxyIdB = m_sorted[j];
+			const cb2SweepProxy* proxyB = m_proxies + proxyIdB;
+			if (proxyB->aabb.lowerBound.x > proxyA->aabb.upperBound.x)
+			{
+				break;
+			}
+
+			if ((proxyA->moved || proxyB->moved) && cb2TestOverlap(proxyA->aabb, proxyB->aabb))
+			{
+				callback->PairCallback(proxyIdA, proxyIdB);
+			}
+		}
+
+		for (int j = i + 1; j < m_largeCount; ++j)
+		{
+			int proxyIdB = m_largeProxies[j];
+			const cb2SweepProxy* proxyB = m_proxies + proxyIdB;
+			if ((proxyA->moved || proxyB->moved) && cb2TestOverlap(proxyA->aabb, proxyB->aabb))
+			{
+				callback->PairCallback(proxyIdA, proxyIdB);
+			}
+		}
+	}
+
+	// Sweep along x from each moved proxy. A pair of two moved proxies is found
+	// from the one that starts first.
+	for (int i = 0; i < m_movedCount; ++i)
+	{
+		int proxyIdA = m_moved[i];
+		const cb2SweepProxy* proxyA = m_proxies + proxyIdA;
+		if (proxyA->large)
+		{
+			continue;
+		}
+
+		int index = proxyA->index;
+		for (int j = index + 1; j < m_sortedCount; ++j)
+		{
+			int proxyIdB = m_sorted[j];
+			const cb2SweepProxy* proxyB = m_proxies + proxyIdB;
+			if (proxyB->aabb.lowerBound.x > proxyA->aabb.upperBound.x)
+			{
+				break;
+			}
+
+			if (proxyA->aabb.lowerBound.y <= proxyB->aabb.upperBound.y && proxyB->aabb.lowerBound.y <= proxyA->aabb.upperBound.y)
+			{
+				callback->PairCallback(proxyIdA, proxyIdB);
+			}
+		}
+
+		float lowerX = proxyA->aabb.lowerBound.x - m_maxWidth;
+		for (int j = index - 1; j >= 0; --j)
+		{
+			int proxyIdB = m_sorted[j];
+			const cb2SweepProxy* proxyB = m_proxies + proxyIdB;
+			if (proxyB->aabb.lowerBound.x < lowerX)
+			{
+				break;
+			}
+
+			if (proxyB->moved || proxyB->aabb.upperBound.x < proxyA->aabb.lowerBound.x)
+			{
+				continue;
+			}
+
+			if (proxyA->aabb.lowerBound.y <= proxyB->aabb.upperBound.y && proxyB->aabb.lowerBound.y <= proxyA->aabb.upperBound.y)
+			{
+				callback->PairCallback(proxyIdA, proxyIdB);
+			}
+		}
+	}
+
+	for (int i = 0; i < m_movedCount; ++i)
+	{
+		m_proxies[m_moved[i]].moved = false;
+	}
+	m_movedCount = 0;
+}
+
+template <typename T>
+inline void cb2SweepAndPrune::Query(T* callback, const cb2AABB& aabb) const
+{
+	for (int i = 0; i < m_largeCount; ++i)
+	{
+		int proxyId = m_largeProxies[i];
+		if (cb2TestOverlap(m_proxies[proxyId].aabb, aabb))
+		{
+			if (callback->QueryCallback(proxyId) == false)
+			{
+				return;
+			}
+		}
+	}
+
+	// Without order the whole array is scanned.
+	bool sorted = m_unsortedCount == 0;
+	for (int i = FindFirst(aabb.lowerBound.x); i < m_sortedCount; ++i)
+	{
+		int proxyId = m_sorted[i];
+		const cb2SweepProxy* proxy = m_proxies + proxyId;
+		if (sorted && proxy->aabb.lowerBound.x > aabb.upperBound.x)
+		{
+			break;
+		}
+
+		if (cb2TestOverlap(proxy->aabb, aabb))
+		{
+			if (callback->QueryCallback(proxyId) == false)
+			{
+				return;
+			}
+		}
+	}
+}
+
+template <typename T>
+inline void cb2SweepAndPrune::RayCast(T* callback, const cb2RayCastInput& input) const
+{
+	ci::Vec2f p1 = input.p1;
+	ci::Vec2f d = input.p2 - input.p1;
+	cb2Assert(d.lengthSquared() > 0.0f);
+	float maxFraction = input.maxFraction;
+
+	cb2RayCastInput subInput;
+	subInput.p1 = input.p1;
+	subInput.p2 = input.p2;
+
+	for (int i = 0; i < m_largeCount; ++i)
+	{
+		int proxyId = m_largeProxies[i];
+		if (cb2TestSegmentOverlap(m_proxies[proxyId].aabb, p1, d, maxFraction) == false)
+		{
+			continue;
+		}
+
+		subInput.maxFraction = maxFraction;
+		float value = callback->RayCastCallback(subInput, proxyId);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+	}
+
+	float lowerX = cb2Min(p1.x, p1.x + maxFraction * d.x);
+	bool sorted = m_unsortedCount == 0;
+	for (int i = FindFirst(lowerX); i < m_sortedCount; ++i)
+	{
+		int proxyId = m_sorted[i];
+		const cb2SweepProxy* proxy = m_proxies + proxyId;
+
+		// The segment shrinks as it is clipped.
+		float upperX = cb2Max(p1.x, p1.x + maxFraction * d.x);
+		if (sorted && proxy->aabb.lowerBound.x > upperX)
+		{
+			break;
+		}
+
+		if (cb2TestSegmentOverlap(proxy->aabb, p1, d, maxFraction) == false)
+		{
+			continue;
+		}
+
+		subInput.maxFraction = maxFraction;
+		float value = callback->RayCastCallback(subInput, proxyId);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+	}
+}
+
+#endif
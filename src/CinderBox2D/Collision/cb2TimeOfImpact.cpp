@@ -253,6 +253,13 @@ struct cb2SeparationFunction
 // CCD via the local separating axis method. This seeks progression
 // by computing the largest time at which separation is maintained.
 void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input)
+{
+	cb2SimplexCache cache;
+	cache.count = 0;
+	cb2TimeOfImpact(output, input, &cache);
+}
+
+void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input, cb2SimplexCache* cache)
 {
 	cb2Timer timer;
 
@@ -260,6 +267,8 @@ void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input)
 
 	output->state = cb2TOIOutput::e_unknown;
 	output->t = input->tMax;
+	output->iterations = 0;
+	output->rootIterations = 0;
 
 	const cb2DistanceProxy* proxyA = &input->proxyA;
 	const cb2DistanceProxy* proxyB = &input->proxyB;
@@ -284,8 +293,6 @@ void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input)
 	int iter = 0;
 
 	// Prepare input for distance query.
-	cb2SimplexCache cache;
-	cache.count = 0;
 	cb2DistanceInput distanceInput;
 	distanceInput.proxyA = input->proxyA;
 	distanceInput.proxyB = input->proxyB;
@@ -304,7 +311,7 @@ void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input)
 		distanceInput.transformA = xfA;
 		distanceInput.transformB = xfB;
 		cb2DistanceOutput distanceOutput;
-		cb2Distance(&distanceOutput, &cache, &distanceInput);
+		cb2Distance(&distanceOutput, cache, &distanceInput);
 
 		// If the shapes are overlapped, we give up on continuous collision.
 		if (distanceOutput.distance <= 0.0f)
@@ -325,7 +332,7 @@ void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input)
 
 		// Initialize the separating axis.
 		cb2SeparationFunction fcn;
-		fcn.Initialize(&cache, proxyA, sweepA, proxyB, sweepB, t1);
+		fcn.Initialize(cache, proxyA, sweepA, proxyB, sweepB, t1);
 #if 0
 		// Dump the curve seen by the root finder
 		{
@@ -423,6 +430,7 @@ void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input)
 				}
 
 				++rootIterCount;
+				++output->rootIterations;
 				++cb2_toiRootIters;
 
 				float s = fcn.Evaluate(indexA, indexB, t);
@@ -479,6 +487,7 @@ void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input)
 		}
 	}
 
+	output->iterations = iter;
 	cb2_toiMaxIters = cb2Max(cb2_toiMaxIters, iter);
 
 	float time = timer.GetMilliseconds();
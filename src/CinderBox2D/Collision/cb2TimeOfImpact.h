@@ -46,6 +46,8 @@ struct cb2TOIOutput
 
 	State state;
 	float t;
+	int iterations;		// number of separating axes tried
+	int rootIterations;	// total iterations of the root finder
 };
 
 /// Compute the upper bound on time before two shapes penetrate. Time is represented as
@@ -55,4 +57,9 @@ struct cb2TOIOutput
 /// Note: use cb2Distance to compute the contact point and normal at the time of impact.
 void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input);
 
+/// Same as above, warm starting the distance queries from the simplex of a previous call
+/// on the same proxies. The cache is input/output, set cb2SimplexCache.count to zero on
+/// the first call.
+void cb2TimeOfImpact(cb2TOIOutput* output, const cb2TOIInput* input, cb2SimplexCache* cache);
+
 #endif
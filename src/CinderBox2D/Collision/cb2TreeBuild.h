@@ -0,0 +1,160 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_TREE_BUILD_H
+#define CB2_TREE_BUILD_H
+
+#include <CinderBox2D/Collision/cb2Collision.h>
+
+const int cb2_treeBuildBinCount = 8;
+
+/// Partition ids in two using binned centroids and the surface area heuristic.
+/// items[ids[i]].aabb is the box of the item ids[i]. This is used to build trees top-down.
+/// @return the number of ids placed at the front, in [1, count - 1].
+template <typename T>
+int cb2PartitionSAH(int* ids, int count, const T* items)
+{
+	cb2Assert(count >= 2);
+
+	cb2AABB centroidBounds;
+	centroidBounds.lowerBound = items[ids[0]].aabb.GetCenter();
+	centroidBounds.upperBound = centroidBounds.lowerBound;
+	for (int i = 1; i < count; ++i)
+	{
+		ci::Vec2f c = items[ids[i]].aabb.GetCenter();
+		centroidBounds.lowerBound = cb2Min(centroidBounds.lowerBound, c);
+		centroidBounds.upperBound = cb2Max(centroidBounds.upperBound, c);
+	}
+
+	ci::Vec2f extent = centroidBounds.upperBound - centroidBounds.lowerBound;
+	int axis = extent.x >= extent.y ? 0 : 1;
+	float lower = axis == 0 ? centroidBounds.lowerBound.x : centroidBounds.lowerBound.y;
+	float width = axis == 0 ? extent.x : extent.y;
+	if (width <= 0.0f)
+	{
+		// All centroids coincide.
+		return count / 2;
+	}
+
+	float scale = cb2_treeBuildBinCount / width;
+
+	int binCounts[cb2_treeBuildBinCount];
+	cb2AABB binBoxes[cb2_treeBuildBinCount];
+	for (int i = 0; i < cb2_treeBuildBinCount; ++i)
+	{
+		binCounts[i] = 0;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		const cb2AABB& aabb = items[ids[i]].aabb;
+		ci::Vec2f c = aabb.GetCenter();
+		int bin = cb2Min(int(scale * ((axis == 0 ? c.x : c.y) - lower)), cb2_treeBuildBinCount - 1);
+		if (binCounts[bin] == 0)
+		{
+			binBoxes[bin] = aabb;
+		}
+		else
+		{
+			binBoxes[bin].Combine(aabb);
+		}
+		++binCounts[bin];
+	}
+
+	// Sweep from the right to get the cost of each right side.
+	float rightCosts[cb2_treeBuildBinCount];
+	{
+		cb2AABB box;
+		int rightCount = 0;
+		for (int i = cb2_treeBuildBinCount - 1; i > 0; --i)
+		{
+			if (binCounts[i] > 0)
+			{
+				if (rightCount == 0)
+				{
+					box = binBoxes[i];
+				}
+				else
+				{
+					box.Combine(binBoxes[i]);
+				}
+				rightCount += binCounts[i];
+			}
+			rightCosts[i] = rightCount > 0 ? rightCount * box.GetPerimeter() : 0.0f;
+		}
+	}
+
+	// Sweep from the left and keep the cheapest split with items on both sides.
+	int bestSplit = -1;
+	float bestCost = cb2_maxFloat;
+	{
+		cb2AABB box;
+		int leftCount = 0;
+		for (int i = 0; i < cb2_treeBuildBinCount - 1; ++i)
+		{
+			if (binCounts[i] > 0)
+			{
+				if (leftCount == 0)
+				{
+					box = binBoxes[i];
+				}
+				else
+				{
+					box.Combine(binBoxes[i]);
+				}
+				leftCount += binCounts[i];
+			}
+
+			if (leftCount == 0 || leftCount == count)
+			{
+				continue;
+			}
+
+			float cost = leftCount * box.GetPerimeter() + rightCosts[i + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+	}
+	cb2Assert(bestSplit != -1);
+
+	// Partition in place.
+	int left = 0;
+	int right = count - 1;
+	while (left <= right)
+	{
+		ci::Vec2f c = items[ids[left]].aabb.GetCenter();
+		int bin = cb2Min(int(scale * ((axis == 0 ? c.x : c.y) - lower)), cb2_treeBuildBinCount - 1);
+		if (bin <= bestSplit)
+		{
+			++left;
+		}
+		else
+		{
+			cb2Swap(ids[left], ids[right]);
+			--right;
+		}
+	}
+
+	cb2Assert(0 < left && left < count);
+	return left;
+}
+
+#endif
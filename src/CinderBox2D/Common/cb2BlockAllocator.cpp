@@ -17,6 +17,7 @@
 */
 
 #include <CinderBox2D/Common/cb2BlockAllocator.h>
+#include <CinderBox2D/Common/cb2ThreadPool.h>
 #include <limits.h>
 #include <memory.h>
 #include <stddef.h>
@@ -52,17 +53,33 @@ struct cb2Block
 	cb2Block* next;
 };
 
+struct cb2BlockCache
+{
+	cb2Block* freeLists[cb2_blockSizes];
+	int counts[cb2_blockSizes];
+
+	// Keep the caches of different threads on different cache lines.
+	char padding[64];
+};
+
 cb2BlockAllocator::cb2BlockAllocator()
 {
 	cb2Assert(cb2_blockSizes < UCHAR_MAX);
 
 	m_chunkSpace = cb2_chunkArrayIncrement;
 	m_chunkCount = 0;
-	m_chunks = (cb2Chunk*)cb2Alloc(m_chunkSpace * sizeof(cb2Chunk));
+	m_chunks = (cb2Chunk*)cb2Alloc(m_chunkSpace * sizeof(cb2Chunk), cb2_defaultAlignment, cb2_memoryBlock);
 	
 	memset(m_chunks, 0, m_chunkSpace * sizeof(cb2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
 
+	m_threadPool = NULL;
+	m_caches = NULL;
+	m_cacheCount = 0;
+
+	m_largeCount = 0;
+	m_largeBytes = 0;
+
 	if (s_blockSizeLookupInitialized == false)
 	{
 		int j = 0;
@@ -88,10 +105,15 @@ cb2BlockAllocator::~cb2BlockAllocator()
 {
 	for (int i = 0; i < m_chunkCount; ++i)
 	{
-		cb2Free(m_chunks[i].blocks);
+		cb2Free(m_chunks[i].blocks, cb2_memoryBlock);
 	}
 
-	cb2Free(m_chunks);
+	cb2Free(m_chunks, cb2_memoryBlock);
+
+	if (m_caches)
+	{
+		cb2Free(m_caches, cb2_memoryBlock);
+	}
 }
 
 void* cb2BlockAllocator::Allocate(int size)
@@ -103,52 +125,194 @@ void* cb2BlockAllocator::Allocate(int size)
 
 	if (size > cb2_maxBlockSize)
 	{
-		return cb2Alloc(size);
+		++m_largeCount;
+		m_largeBytes += size;
+		return cb2Alloc(size, cb2_defaultAlignment, cb2_memoryBlock);
 	}
 
 	int index = s_blockSizeLookup[size];
 	cb2Assert(0 <= index && index < cb2_blockSizes);
 
-	if (m_freeLists[index])
+	if (m_caches)
 	{
-		cb2Block* block = m_freeLists[index];
-		m_freeLists[index] = block->next;
+		cb2BlockCache* cache = m_caches + m_threadPool->GetThreadIndex();
+		if (cache->freeLists[index] == NULL)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (int i = 0; i < cb2_blockCacheBatch; ++i)
+			{
+				cb2Block* block = AllocateShared(index);
+				block->next = cache->freeLists[index];
+				cache->freeLists[index] = block;
+			}
+			cache->counts[index] += cb2_blockCacheBatch;
+		}
+
+		cb2Block* block = cache->freeLists[index];
+		cache->freeLists[index] = block->next;
+		--cache->counts[index];
 		return block;
 	}
-	else
+
+	return AllocateShared(index);
+}
+
+cb2Block* cb2BlockAllocator::AllocateShared(int index)
+{
+	if (m_freeLists[index] == NULL)
+	{
+		AddChunk(index);
+	}
+
+	cb2Block* block = m_freeLists[index];
+	m_freeLists[index] = block->next;
+	return block;
+}
+
+cb2Chunk* cb2BlockAllocator::NewChunk(int index)
+{
+	if (m_chunkCount == m_chunkSpace)
 	{
-		if (m_chunkCount == m_chunkSpace)
-		{
-			cb2Chunk* oldChunks = m_chunks;
-			m_chunkSpace += cb2_chunkArrayIncrement;
-			m_chunks = (cb2Chunk*)cb2Alloc(m_chunkSpace * sizeof(cb2Chunk));
-			memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(cb2Chunk));
-			memset(m_chunks + m_chunkCount, 0, cb2_chunkArrayIncrement * sizeof(cb2Chunk));
-			cb2Free(oldChunks);
-		}
+		cb2Chunk* oldChunks = m_chunks;
+		m_chunkSpace += cb2_chunkArrayIncrement;
+		m_chunks = (cb2Chunk*)cb2Alloc(m_chunkSpace * sizeof(cb2Chunk), cb2_defaultAlignment, cb2_memoryBlock);
+		memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(cb2Chunk));
+		memset(m_chunks + m_chunkCount, 0, cb2_chunkArrayIncrement * sizeof(cb2Chunk));
+		cb2Free(oldChunks, cb2_memoryBlock);
+	}
 
-		cb2Chunk* chunk = m_chunks + m_chunkCount;
-		chunk->blocks = (cb2Block*)cb2Alloc(cb2_chunkSize);
+	cb2Chunk* chunk = m_chunks + m_chunkCount;
+	chunk->blocks = (cb2Block*)cb2Alloc(cb2_chunkSize, cb2_defaultAlignment, cb2_memoryBlock);
 #if defined(_DEBUG)
-		memset(chunk->blocks, 0xcd, cb2_chunkSize);
+	memset(chunk->blocks, 0xcd, cb2_chunkSize);
 #endif
-		int blockSize = s_blockSizes[index];
-		chunk->blockSize = blockSize;
-		int blockCount = cb2_chunkSize / blockSize;
-		cb2Assert(blockCount * blockSize <= cb2_chunkSize);
-		for (int i = 0; i < blockCount - 1; ++i)
+	chunk->blockSize = s_blockSizes[index];
+	++m_chunkCount;
+	return chunk;
+}
+
+void cb2BlockAllocator::AddChunk(int index)
+{
+	cb2Chunk* chunk = NewChunk(index);
+	int blockSize = chunk->blockSize;
+	int blockCount = cb2_chunkSize / blockSize;
+	cb2Assert(blockCount * blockSize <= cb2_chunkSize);
+	for (int i = 0; i < blockCount - 1; ++i)
+	{
+		cb2Block* block = (cb2Block*)((char*)chunk->blocks + blockSize * i);
+		cb2Block* next = (cb2Block*)((char*)chunk->blocks + blockSize * (i + 1));
+		block->next = next;
+	}
+	cb2Block* last = (cb2Block*)((char*)chunk->blocks + blockSize * (blockCount - 1));
+	last->next = m_freeLists[index];
+
+	m_freeLists[index] = chunk->blocks;
+}
+
+void cb2BlockAllocator::AllocateContiguous(int size, int count, void** blocks)
+{
+	cb2Assert(0 < size && 0 <= count);
+	if (size > cb2_maxBlockSize)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			blocks[i] = Allocate(size);
+		}
+		return;
+	}
+
+	int index = s_blockSizeLookup[size];
+	cb2Assert(0 <= index && index < cb2_blockSizes);
+
+	std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+	if (m_caches)
+	{
+		lock.lock();
+	}
+
+	int blockSize = s_blockSizes[index];
+	int blockCount = cb2_chunkSize / blockSize;
+	int i = 0;
+	while (i < count)
+	{
+		cb2Chunk* chunk = NewChunk(index);
+		int usedCount = count - i < blockCount ? count - i : blockCount;
+		for (int j = 0; j < usedCount; ++j)
+		{
+			blocks[i + j] = (char*)chunk->blocks + blockSize * j;
+		}
+		i += usedCount;
+
+		// The rest of the last chunk goes to the free list.
+		for (int j = blockCount - 1; j >= usedCount; --j)
+		{
+			cb2Block* block = (cb2Block*)((char*)chunk->blocks + blockSize * j);
+			block->next = m_freeLists[index];
+			m_freeLists[index] = block;
+		}
+	}
+}
+
+void cb2BlockAllocator::Reserve(int size, int count)
+{
+	if (size <= 0 || size > cb2_maxBlockSize)
+	{
+		return;
+	}
+
+	int index = s_blockSizeLookup[size];
+	cb2Assert(0 <= index && index < cb2_blockSizes);
+
+	std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+	if (m_caches)
+	{
+		lock.lock();
+	}
+
+	int freeCount = 0;
+	for (cb2Block* block = m_freeLists[index]; block && freeCount < count; block = block->next)
+	{
+		++freeCount;
+	}
+
+	int blockCount = cb2_chunkSize / s_blockSizes[index];
+	int chunkCount = (count - freeCount + blockCount - 1) / blockCount;
+	if (chunkCount <= 0)
+	{
+		return;
+	}
+
+	// Grow the chunk array once.
+	if (m_chunkCount + chunkCount > m_chunkSpace)
+	{
+		cb2Chunk* oldChunks = m_chunks;
+		while (m_chunkSpace < m_chunkCount + chunkCount)
 		{
-			cb2Block* block = (cb2Block*)((char*)chunk->blocks + blockSize * i);
-			cb2Block* next = (cb2Block*)((char*)chunk->blocks + blockSize * (i + 1));
-			block->next = next;
+			m_chunkSpace += cb2_chunkArrayIncrement;
 		}
-		cb2Block* last = (cb2Block*)((char*)chunk->blocks + blockSize * (blockCount - 1));
-		last->next = NULL;
+		m_chunks = (cb2Chunk*)cb2Alloc(m_chunkSpace * sizeof(cb2Chunk), cb2_defaultAlignment, cb2_memoryBlock);
+		memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(cb2Chunk));
+		memset(m_chunks + m_chunkCount, 0, (m_chunkSpace - m_chunkCount) * sizeof(cb2Chunk));
+		cb2Free(oldChunks, cb2_memoryBlock);
+	}
+
+	for (int i = 0; i < chunkCount; ++i)
+	{
+		AddChunk(index);
+	}
+}
 
-		m_freeLists[index] = chunk->blocks->next;
-		++m_chunkCount;
+void cb2BlockAllocator::ReturnBlocks(cb2BlockCache* cache, int index, int keepCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (cache->counts[index] > keepCount)
+	{
+		cb2Block* block = cache->freeLists[index];
+		cache->freeLists[index] = block->next;
+		--cache->counts[index];
 
-		return chunk->blocks;
+		block->next = m_freeLists[index];
+		m_freeLists[index] = block;
 	}
 }
 
@@ -163,7 +327,9 @@ void cb2BlockAllocator::Free(void* p, int size)
 
 	if (size > cb2_maxBlockSize)
 	{
-		cb2Free(p);
+		--m_largeCount;
+		m_largeBytes -= size;
+		cb2Free(p, cb2_memoryBlock);
 		return;
 	}
 
@@ -171,7 +337,13 @@ void cb2BlockAllocator::Free(void* p, int size)
 	cb2Assert(0 <= index && index < cb2_blockSizes);
 
 #ifdef _DEBUG
-	// Verify the memory address and size is valid.
+	// Verify the memory address and size is valid. Other threads may add chunks.
+	std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+	if (m_caches)
+	{
+		lock.lock();
+	}
+
 	int blockSize = s_blockSizes[index];
 	bool found = false;
 	for (int i = 0; i < m_chunkCount; ++i)
@@ -194,9 +366,28 @@ void cb2BlockAllocator::Free(void* p, int size)
 	cb2Assert(found);
 
 	memset(p, 0xfd, blockSize);
+
+	if (m_caches)
+	{
+		lock.unlock();
+	}
 #endif
 
 	cb2Block* block = (cb2Block*)p;
+	if (m_caches)
+	{
+		cb2BlockCache* cache = m_caches + m_threadPool->GetThreadIndex();
+		block->next = cache->freeLists[index];
+		cache->freeLists[index] = block;
+		++cache->counts[index];
+
+		if (cache->counts[index] >= 2 * cb2_blockCacheBatch)
+		{
+			ReturnBlocks(cache, index, cb2_blockCacheBatch);
+		}
+		return;
+	}
+
 	block->next = m_freeLists[index];
 	m_freeLists[index] = block;
 }
@@ -205,11 +396,80 @@ void cb2BlockAllocator::Clear()
 {
 	for (int i = 0; i < m_chunkCount; ++i)
 	{
-		cb2Free(m_chunks[i].blocks);
+		cb2Free(m_chunks[i].blocks, cb2_memoryBlock);
 	}
 
 	m_chunkCount = 0;
 	memset(m_chunks, 0, m_chunkSpace * sizeof(cb2Chunk));
 
 	memset(m_freeLists, 0, sizeof(m_freeLists));
+
+	if (m_caches)
+	{
+		memset(m_caches, 0, m_cacheCount * sizeof(cb2BlockCache));
+	}
+}
+
+void cb2BlockAllocator::SetThreadPool(cb2ThreadPool* threadPool)
+{
+	if (m_caches)
+	{
+		for (int i = 0; i < m_cacheCount; ++i)
+		{
+			for (int j = 0; j < cb2_blockSizes; ++j)
+			{
+				ReturnBlocks(m_caches + i, j, 0);
+			}
+		}
+
+		cb2Free(m_caches, cb2_memoryBlock);
+		m_caches = NULL;
+		m_cacheCount = 0;
+	}
+
+	m_threadPool = threadPool;
+	if (m_threadPool && m_threadPool->GetThreadCount() > 1)
+	{
+		m_cacheCount = m_threadPool->GetThreadCount();
+		m_caches = (cb2BlockCache*)cb2Alloc(m_cacheCount * sizeof(cb2BlockCache), cb2_defaultAlignment, cb2_memoryBlock);
+		memset(m_caches, 0, m_cacheCount * sizeof(cb2BlockCache));
+	}
+}
+
+void cb2BlockAllocator::GetStats(cb2BlockAllocatorStats* stats) const
+{
+	memset(stats, 0, sizeof(cb2BlockAllocatorStats));
+	stats->chunkCount = m_chunkCount;
+	stats->chunkBytes = m_chunkCount * cb2_chunkSize + m_chunkSpace * (int)sizeof(cb2Chunk);
+
+	for (int i = 0; i < m_chunkCount; ++i)
+	{
+		int index = s_blockSizeLookup[m_chunks[i].blockSize];
+		++stats->chunkCounts[index];
+	}
+
+	for (int j = 0; j < cb2_blockSizes; ++j)
+	{
+		int freeCount = 0;
+		for (cb2Block* block = m_freeLists[j]; block; block = block->next)
+		{
+			++freeCount;
+		}
+		for (int i = 0; i < m_cacheCount; ++i)
+		{
+			freeCount += m_caches[i].counts[j];
+		}
+
+		stats->usedBlocks[j] = stats->chunkCounts[j] * (cb2_chunkSize / s_blockSizes[j]) - freeCount;
+		stats->usedBytes += stats->usedBlocks[j] * s_blockSizes[j];
+	}
+
+	stats->largeCount = m_largeCount;
+	stats->largeBytes = m_largeBytes;
+}
+
+int cb2BlockAllocator::GetBlockSize(int index)
+{
+	cb2Assert(0 <= index && index < cb2_blockSizes);
+	return s_blockSizes[index];
 }
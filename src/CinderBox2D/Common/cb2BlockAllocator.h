@@ -20,14 +20,34 @@
 #define CB2_BLOCK_ALLOCATOR_H
 
 #include <CinderBox2D/Common/cb2Settings.h>
+#include <atomic>
+#include <mutex>
 
 const int cb2_chunkSize = 16 * 1024;
 const int cb2_maxBlockSize = 640;
 const int cb2_blockSizes = 14;
 const int cb2_chunkArrayIncrement = 128;
 
+// Blocks moved between a thread cache and the shared free lists at a time.
+const int cb2_blockCacheBatch = 32;
+
 struct cb2Block;
 struct cb2Chunk;
+struct cb2BlockCache;
+class cb2ThreadPool;
+
+/// The memory of a block allocator, see cb2BlockAllocator::GetStats. Used blocks
+/// are the blocks of the chunks that are not on a free list.
+struct cb2BlockAllocatorStats
+{
+	int chunkCount;
+	int chunkBytes;							///< the chunks and the chunk array
+	int chunkCounts[cb2_blockSizes];		///< chunks per size class
+	int usedBlocks[cb2_blockSizes];			///< allocated blocks per size class
+	int usedBytes;							///< bytes of the allocated blocks
+	int largeCount;							///< allocations above cb2_maxBlockSize
+	int largeBytes;
+};
 
 /// This is a small object allocator used for allocating small
 /// objects that persist for more than one time step.
@@ -46,14 +66,59 @@ public:
 
 	void Clear();
 
+	/// Give each thread of the pool its own free lists. Allocate and Free may then be
+	/// called concurrently from the threads of the pool. The threads take blocks from
+	/// and return blocks to the shared free lists in batches, under a lock. A block may
+	/// be freed by another thread than the one that allocated it. Pass NULL to return
+	/// the cached blocks. This must not be called while other threads use the allocator.
+	void SetThreadPool(cb2ThreadPool* threadPool);
+
+	/// Add chunks until count blocks of the given size are free. Sizes above
+	/// cb2_maxBlockSize are not pooled and are ignored.
+	void Reserve(int size, int count);
+
+	/// Allocate count blocks that follow each other in memory, taken from new chunks,
+	/// for objects created and visited together. Each block is freed on its own with
+	/// Free. Sizes above cb2_maxBlockSize are allocated one by one.
+	void AllocateContiguous(int size, int count, void** blocks);
+
+	/// Get the memory of the allocator. This walks the free lists, so it is slower than
+	/// an allocation. This must not be called while other threads use the allocator.
+	void GetStats(cb2BlockAllocatorStats* stats) const;
+
+	/// Get the block size of a size class.
+	static int GetBlockSize(int index);
+
 private:
 
+	// Allocate a chunk for a block size, growing the chunk array if needed.
+	cb2Chunk* NewChunk(int index);
+
+	// Allocate a chunk for a block size and put its blocks in front of the free list.
+	void AddChunk(int index);
+
+	// Take a block from the shared free lists, adding a chunk if needed.
+	cb2Block* AllocateShared(int index);
+
+	// Move blocks of a cache to the shared free lists, keeping keepCount of them.
+	void ReturnBlocks(cb2BlockCache* cache, int index, int keepCount);
+
 	cb2Chunk* m_chunks;
 	int m_chunkCount;
 	int m_chunkSpace;
 
 	cb2Block* m_freeLists[cb2_blockSizes];
 
+	// Per thread free lists. The shared free lists are locked while these are used.
+	cb2ThreadPool* m_threadPool;
+	cb2BlockCache* m_caches;
+	int m_cacheCount;
+	std::mutex m_mutex;
+
+	// Allocations too large for the blocks, which may be made by several threads.
+	std::atomic<int> m_largeCount;
+	std::atomic<int> m_largeBytes;
+
 	static int s_blockSizes[cb2_blockSizes];
 	static unsigned char s_blockSizeLookup[cb2_maxBlockSize + 1];
 	static bool s_blockSizeLookupInitialized;
@@ -21,6 +21,7 @@
 cb2Draw::cb2Draw()
 {
 	m_drawFlags = 0;
+	m_hasView = false;
 }
 
 void cb2Draw::SetFlags(unsigned int flags)
@@ -42,3 +43,29 @@ void cb2Draw::ClearFlags(unsigned int flags)
 {
 	m_drawFlags &= ~flags;
 }
+
+void cb2Draw::SetView(const ci::Vec2f& lower, const ci::Vec2f& upper)
+{
+	m_viewLower = lower;
+	m_viewUpper = upper;
+	m_hasView = true;
+}
+
+void cb2Draw::ClearView()
+{
+	m_hasView = false;
+}
+
+bool cb2Draw::GetView(ci::Vec2f* lower, ci::Vec2f* upper) const
+{
+	*lower = m_viewLower;
+	*upper = m_viewUpper;
+	return m_hasView;
+}
+
+void cb2Draw::DrawString(int x, int y, const char* text)
+{
+	CB2_NOT_USED(x);
+	CB2_NOT_USED(y);
+	CB2_NOT_USED(text);
+}
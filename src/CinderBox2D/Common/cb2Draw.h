@@ -25,9 +25,9 @@
 struct cb2Color
 {
 	cb2Color() {}
-	cb2Color(float r, float g, float b) : r(r), g(g), b(b) {}
-	void set(float ri, float gi, float bi) { r = ri; g = gi; b = bi; }
-	float r, g, b;
+	cb2Color(float r, float g, float b, float a = 1.0f) : r(r), g(g), b(b), a(a) {}
+	void set(float ri, float gi, float bi, float ai = 1.0f) { r = ri; g = gi; b = bi; a = ai; }
+	float r, g, b, a;
 };
 
 /// Implement and register this class with a cb2World to provide debug drawing of physics
@@ -45,7 +45,9 @@ public:
 		e_jointBit				= 0x0002,	///< draw joint connections
 		e_aabbBit				= 0x0004,	///< draw axis aligned bounding boxes
 		e_pairBit				= 0x0008,	///< draw broad-phase pairs
-		e_centerOfMassBit		= 0x0010	///< draw center of mass frame
+		e_centerOfMassBit		= 0x0010,	///< draw center of mass frame
+		e_profileBit			= 0x0020,	///< draw the rolling profile statistics
+		e_particleBit			= 0x0040	///< draw particle systems
 	};
 
 	/// set the drawing flags.
@@ -60,6 +62,17 @@ public:
 	/// Clear flags from the current flags.
 	void ClearFlags(unsigned int flags);
 
+	/// Only draw what overlaps this box, in world coordinates. cb2World::DrawDebugData
+	/// then finds the fixtures with a query of the broad-phase instead of visiting every
+	/// body. Inactive bodies have no proxies and are not drawn while a view is set.
+	void SetView(const ci::Vec2f& lower, const ci::Vec2f& upper);
+
+	/// Draw everything again.
+	void ClearView();
+
+	/// Get the view box. Returns false if no view is set.
+	bool GetView(ci::Vec2f* lower, ci::Vec2f* upper) const;
+
 	/// Draw a closed polygon provided in CCW order.
 	virtual void DrawPolygon(const ci::Vec2f* vertices, int vertexCount, const cb2Color& color) = 0;
 
@@ -79,8 +92,13 @@ public:
 	/// @param xf a transform.
 	virtual void DrawTransform(const cb2Transform& xf) = 0;
 
+	/// Draw text at a position in screen pixels. The default draws nothing.
+	virtual void DrawString(int x, int y, const char* text);
+
 protected:
 	unsigned int m_drawFlags;
+	ci::Vec2f m_viewLower, m_viewUpper;
+	bool m_hasView;
 };
 
 #endif
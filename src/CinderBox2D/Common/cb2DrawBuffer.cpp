@@ -0,0 +1,223 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Common/cb2DrawBuffer.h>
+#include <string.h>
+
+// Grow an array to hold at least count entries, doubling the capacity.
+template <typename T>
+static void cb2GrowArray(T** array, int* capacity, int used, int count)
+{
+	if (count <= *capacity)
+	{
+		return;
+	}
+
+	int newCapacity = cb2Max(2 * *capacity, cb2Max(count, 64));
+	T* newArray = (T*)cb2Alloc(newCapacity * sizeof(T));
+	if (*array)
+	{
+		memcpy(newArray, *array, used * sizeof(T));
+		cb2Free(*array);
+	}
+	*array = newArray;
+	*capacity = newCapacity;
+}
+
+cb2DrawBuffer::cb2DrawBuffer()
+{
+	memset(m_batches, 0, sizeof(m_batches));
+	m_strings = NULL;
+	m_stringCount = 0;
+	m_stringCapacity = 0;
+	m_chars = NULL;
+	m_charCount = 0;
+	m_charCapacity = 0;
+	m_axisScale = 0.4f;
+	m_circleSegments = 0;
+	SetCircleSegments(16);
+}
+
+cb2DrawBuffer::~cb2DrawBuffer()
+{
+	for (int i = 0; i < e_batchCount; ++i)
+	{
+		cb2Free(m_batches[i].vertices);
+		cb2Free(m_batches[i].colors);
+		cb2Free(m_batches[i].indices);
+	}
+	cb2Free(m_strings);
+	cb2Free(m_chars);
+}
+
+void cb2DrawBuffer::Clear()
+{
+	for (int i = 0; i < e_batchCount; ++i)
+	{
+		m_batches[i].vertexCount = 0;
+		m_batches[i].indexCount = 0;
+	}
+	m_stringCount = 0;
+	m_charCount = 0;
+}
+
+void cb2DrawBuffer::SetCircleSegments(int count)
+{
+	m_circleSegments = cb2Clamp(count, 3, (int)e_maxCircleSegments);
+	float increment = 2.0f * cb2_pi / m_circleSegments;
+	for (int i = 0; i < m_circleSegments; ++i)
+	{
+		float theta = increment * i;
+		m_unitCircle[i].set(cosf(theta), sinf(theta));
+	}
+}
+
+const char* cb2DrawBuffer::GetString(int index, int* x, int* y) const
+{
+	cb2Assert(0 <= index && index < m_stringCount);
+	*x = m_strings[index].x;
+	*y = m_strings[index].y;
+	return m_chars + m_strings[index].offset;
+}
+
+unsigned int cb2DrawBuffer::Reserve(Batch batch, int vertexCount, int indexCount)
+{
+	cb2DrawBatch* b = m_batches + batch;
+	if (b->vertexCount + vertexCount > b->vertexCapacity)
+	{
+		// The positions and colors grow to the same capacity.
+		int capacity = b->vertexCapacity;
+		cb2GrowArray(&b->vertices, &capacity, b->vertexCount, b->vertexCount + vertexCount);
+		cb2GrowArray(&b->colors, &b->vertexCapacity, b->vertexCount, b->vertexCount + vertexCount);
+	}
+	cb2GrowArray(&b->indices, &b->indexCapacity, b->indexCount, b->indexCount + indexCount);
+
+	unsigned int first = (unsigned int)b->vertexCount;
+	b->vertexCount += vertexCount;
+	b->indexCount += indexCount;
+	return first;
+}
+
+void cb2DrawBuffer::AddLoop(const ci::Vec2f* vertices, int vertexCount, const cb2Color& color)
+{
+	cb2DrawBatch* b = m_batches + e_lines;
+	unsigned int first = Reserve(e_lines, vertexCount, 2 * vertexCount);
+	ci::Vec2f* v = b->vertices + first;
+	cb2Color* c = b->colors + first;
+	unsigned int* index = b->indices + b->indexCount - 2 * vertexCount;
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		v[i] = vertices[i];
+		c[i] = color;
+		index[2 * i] = first + i;
+		index[2 * i + 1] = first + (i + 1 < vertexCount ? i + 1 : 0);
+	}
+}
+
+void cb2DrawBuffer::AddFan(const ci::Vec2f* vertices, int vertexCount, const cb2Color& color)
+{
+	cb2DrawBatch* b = m_batches + e_triangles;
+	int triangleCount = vertexCount - 2;
+	unsigned int first = Reserve(e_triangles, vertexCount, 3 * triangleCount);
+	ci::Vec2f* v = b->vertices + first;
+	cb2Color* c = b->colors + first;
+	unsigned int* index = b->indices + b->indexCount - 3 * triangleCount;
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		v[i] = vertices[i];
+		c[i] = color;
+	}
+	for (int i = 0; i < triangleCount; ++i)
+	{
+		index[3 * i] = first;
+		index[3 * i + 1] = first + i + 1;
+		index[3 * i + 2] = first + i + 2;
+	}
+}
+
+void cb2DrawBuffer::Tessellate(const ci::Vec2f& center, float radius)
+{
+	for (int i = 0; i < m_circleSegments; ++i)
+	{
+		m_circleVertices[i] = center + radius * m_unitCircle[i];
+	}
+}
+
+void cb2DrawBuffer::DrawPolygon(const ci::Vec2f* vertices, int vertexCount, const cb2Color& color)
+{
+	AddLoop(vertices, vertexCount, color);
+}
+
+// Fills are drawn at half intensity and half alpha under a full outline.
+void cb2DrawBuffer::DrawSolidPolygon(const ci::Vec2f* vertices, int vertexCount, const cb2Color& color)
+{
+	cb2Color fill(0.5f * color.r, 0.5f * color.g, 0.5f * color.b, 0.5f * color.a);
+	if (vertexCount >= 3)
+	{
+		AddFan(vertices, vertexCount, fill);
+	}
+	AddLoop(vertices, vertexCount, color);
+}
+
+void cb2DrawBuffer::DrawCircle(const ci::Vec2f& center, float radius, const cb2Color& color)
+{
+	Tessellate(center, radius);
+	AddLoop(m_circleVertices, m_circleSegments, color);
+}
+
+void cb2DrawBuffer::DrawSolidCircle(const ci::Vec2f& center, float radius, const ci::Vec2f& axis, const cb2Color& color)
+{
+	Tessellate(center, radius);
+	cb2Color fill(0.5f * color.r, 0.5f * color.g, 0.5f * color.b, 0.5f * color.a);
+	AddFan(m_circleVertices, m_circleSegments, fill);
+	AddLoop(m_circleVertices, m_circleSegments, color);
+	DrawSegment(center, center + radius * axis, color);
+}
+
+void cb2DrawBuffer::DrawSegment(const ci::Vec2f& p1, const ci::Vec2f& p2, const cb2Color& color)
+{
+	cb2DrawBatch* b = m_batches + e_lines;
+	unsigned int first = Reserve(e_lines, 2, 2);
+	b->vertices[first] = p1;
+	b->vertices[first + 1] = p2;
+	b->colors[first] = color;
+	b->colors[first + 1] = color;
+	b->indices[b->indexCount - 2] = first;
+	b->indices[b->indexCount - 1] = first + 1;
+}
+
+void cb2DrawBuffer::DrawTransform(const cb2Transform& xf)
+{
+	DrawSegment(xf.p, xf.p + m_axisScale * xf.q.GetXAxis(), cb2Color(1.0f, 0.0f, 0.0f));
+	DrawSegment(xf.p, xf.p + m_axisScale * xf.q.GetYAxis(), cb2Color(0.0f, 1.0f, 0.0f));
+}
+
+void cb2DrawBuffer::DrawString(int x, int y, const char* text)
+{
+	int length = (int)strlen(text) + 1;
+	cb2GrowArray(&m_strings, &m_stringCapacity, m_stringCount, m_stringCount + 1);
+	cb2GrowArray(&m_chars, &m_charCapacity, m_charCount, m_charCount + length);
+
+	cb2DrawString* s = m_strings + m_stringCount;
+	s->x = x;
+	s->y = y;
+	s->offset = m_charCount;
+	memcpy(m_chars + m_charCount, text, length);
+	++m_stringCount;
+	m_charCount += length;
+}
@@ -0,0 +1,125 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_DRAW_BUFFER_H
+#define CB2_DRAW_BUFFER_H
+
+#include <CinderBox2D/Common/cb2Draw.h>
+
+/// A debug draw that collects the primitives into flat arrays instead of drawing them.
+/// Circles and solid polygons are tessellated, so a frame is two indexed draws: one
+/// triangle list for the fills and one line list for the outlines. Call Clear before
+/// cb2World::DrawDebugData and upload the arrays after it.
+class cb2DrawBuffer : public cb2Draw
+{
+public:
+	cb2DrawBuffer();
+	~cb2DrawBuffer();
+
+	enum Batch
+	{
+		e_triangles = 0,	///< indexed triangle list of the fills
+		e_lines,			///< indexed line list of the outlines
+		e_batchCount
+	};
+
+	/// Remove all primitives and strings. The memory is kept for the next frame.
+	void Clear();
+
+	/// Set the number of segments of a tessellated circle, in [3, e_maxCircleSegments].
+	void SetCircleSegments(int count);
+	int GetCircleSegments() const { return m_circleSegments; }
+
+	/// Set the length of the axes drawn by DrawTransform.
+	void SetAxisScale(float scale) { m_axisScale = scale; }
+	float GetAxisScale() const { return m_axisScale; }
+
+	/// Get the vertex positions and colors of a batch, GetVertexCount entries each.
+	int GetVertexCount(Batch batch) const { return m_batches[batch].vertexCount; }
+	const ci::Vec2f* GetVertices(Batch batch) const { return m_batches[batch].vertices; }
+	const cb2Color* GetColors(Batch batch) const { return m_batches[batch].colors; }
+
+	/// Get the indices of a batch, three per triangle or two per line.
+	int GetIndexCount(Batch batch) const { return m_batches[batch].indexCount; }
+	const unsigned int* GetIndices(Batch batch) const { return m_batches[batch].indices; }
+
+	/// Get a string passed to DrawString and its position in screen pixels.
+	int GetStringCount() const { return m_stringCount; }
+	const char* GetString(int index, int* x, int* y) const;
+
+	/// @see cb2Draw
+	void DrawPolygon(const ci::Vec2f* vertices, int vertexCount, const cb2Color& color);
+	void DrawSolidPolygon(const ci::Vec2f* vertices, int vertexCount, const cb2Color& color);
+	void DrawCircle(const ci::Vec2f& center, float radius, const cb2Color& color);
+	void DrawSolidCircle(const ci::Vec2f& center, float radius, const ci::Vec2f& axis, const cb2Color& color);
+	void DrawSegment(const ci::Vec2f& p1, const ci::Vec2f& p2, const cb2Color& color);
+	void DrawTransform(const cb2Transform& xf);
+	void DrawString(int x, int y, const char* text);
+
+	enum
+	{
+		e_maxCircleSegments = 64
+	};
+
+private:
+
+	struct cb2DrawBatch
+	{
+		ci::Vec2f* vertices;
+		cb2Color* colors;
+		unsigned int* indices;
+		int vertexCount;
+		int vertexCapacity;
+		int indexCount;
+		int indexCapacity;
+	};
+
+	struct cb2DrawString
+	{
+		int x, y;
+		int offset;
+	};
+
+	// Reserve vertices and indices in a batch. Returns the index of the first vertex.
+	unsigned int Reserve(Batch batch, int vertexCount, int indexCount);
+
+	// Add the outline of a closed loop of vertices.
+	void AddLoop(const ci::Vec2f* vertices, int vertexCount, const cb2Color& color);
+
+	// Add a filled convex polygon as a triangle fan.
+	void AddFan(const ci::Vec2f* vertices, int vertexCount, const cb2Color& color);
+
+	// Write the tessellated circle to m_circleVertices.
+	void Tessellate(const ci::Vec2f& center, float radius);
+
+	cb2DrawBatch m_batches[e_batchCount];
+
+	ci::Vec2f m_unitCircle[e_maxCircleSegments];
+	ci::Vec2f m_circleVertices[e_maxCircleSegments];
+	int m_circleSegments;
+	float m_axisScale;
+
+	cb2DrawString* m_strings;
+	int m_stringCount;
+	int m_stringCapacity;
+	char* m_chars;
+	int m_charCount;
+	int m_charCapacity;
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_DRAW_VBO_MESH_H
+#define CB2_DRAW_VBO_MESH_H
+
+#include <CinderBox2D/Common/cb2DrawBuffer.h>
+
+// This file needs Cinder's OpenGL classes and is header only, so a headless build
+// that never includes it does not depend on them.
+#if !defined(CB2_HEADLESS)
+
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Vbo.h>
+
+/// A cb2DrawBuffer that uploads each batch into one dynamic gl::VboMesh, so the debug
+/// view of a frame costs two draw calls however many shapes it has. The meshes only
+/// grow, and the part written this frame is drawn with gl::drawRange.
+/// The strings are not drawn, see cb2DrawBuffer::GetString.
+class cb2DrawVboMesh : public cb2DrawBuffer
+{
+public:
+	cb2DrawVboMesh()
+	{
+		for (int i = 0; i < e_batchCount; ++i)
+		{
+			m_vertexCapacity[i] = 0;
+			m_indexCapacity[i] = 0;
+			m_indexCount[i] = 0;
+		}
+	}
+
+	/// Copy the collected primitives to the meshes. Call after cb2World::DrawDebugData.
+	void Upload()
+	{
+		UploadBatch(e_triangles, GL_TRIANGLES);
+		UploadBatch(e_lines, GL_LINES);
+	}
+
+	/// Draw the uploaded meshes with the current matrices, fills first.
+	void Draw() const
+	{
+		for (int i = 0; i < e_batchCount; ++i)
+		{
+			if (m_indexCount[i] > 0)
+			{
+				ci::gl::drawRange(m_meshes[i], 0, m_indexCount[i]);
+			}
+		}
+	}
+
+private:
+
+	void UploadBatch(Batch batch, GLenum primitive)
+	{
+		int vertexCount = GetVertexCount(batch);
+		int indexCount = GetIndexCount(batch);
+		m_indexCount[batch] = indexCount;
+		if (indexCount == 0)
+		{
+			return;
+		}
+
+		if (vertexCount > m_vertexCapacity[batch] || indexCount > m_indexCapacity[batch])
+		{
+			m_vertexCapacity[batch] = cb2Max(vertexCount, 2 * m_vertexCapacity[batch]);
+			m_indexCapacity[batch] = cb2Max(indexCount, 2 * m_indexCapacity[batch]);
+
+			ci::gl::VboMesh::Layout layout;
+			layout.setDynamicIndices();
+			layout.setDynamicPositions();
+			layout.setDynamicColorsRGBA();
+			m_meshes[batch] = ci::gl::VboMesh::create(m_vertexCapacity[batch], m_indexCapacity[batch], layout, primitive);
+		}
+
+		const ci::Vec2f* vertices = GetVertices(batch);
+		const cb2Color* colors = GetColors(batch);
+		{
+			// The iterator unmaps the buffer when it goes out of scope.
+			ci::gl::VboMesh::VertexIter iter = m_meshes[batch]->mapVertexBuffer();
+			for (int i = 0; i < vertexCount; ++i)
+			{
+				iter.setPosition(vertices[i].x, vertices[i].y, 0.0f);
+				iter.setColorRGBA(ci::ColorA(colors[i].r, colors[i].g, colors[i].b, colors[i].a));
+				++iter;
+			}
+		}
+
+		m_meshes[batch]->getIndexVbo().bufferSubData(0, indexCount * sizeof(unsigned int), GetIndices(batch));
+	}
+
+	ci::gl::VboMeshRef m_meshes[e_batchCount];
+	int m_vertexCapacity[e_batchCount];
+	int m_indexCapacity[e_batchCount];
+	int m_indexCount[e_batchCount];
+};
+
+#endif
+
+#endif
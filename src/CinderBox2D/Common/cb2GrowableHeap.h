@@ -0,0 +1,130 @@
+/*
+* Copyright (c) 2010 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_GROWABLE_HEAP_H
+#define CB2_GROWABLE_HEAP_H
+#include <CinderBox2D/Common/cb2Settings.h>
+#include <memory.h>
+
+/// This is a growable binary min-heap with an initial capacity of N, ordered by
+/// the key member of T. If the heap exceeds the initial capacity, the heap
+/// memory is used to increase its size, as with cb2GrowableStack.
+template <typename T, int N>
+class cb2GrowableHeap
+{
+public:
+	cb2GrowableHeap()
+	{
+		m_heap = m_array;
+		m_count = 0;
+		m_capacity = N;
+	}
+
+	~cb2GrowableHeap()
+	{
+		if (m_heap != m_array)
+		{
+			cb2Free(m_heap);
+			m_heap = NULL;
+		}
+	}
+
+	void Push(const T& element)
+	{
+		if (m_count == m_capacity)
+		{
+			T* old = m_heap;
+			m_capacity *= 2;
+			m_heap = (T*)cb2Alloc(m_capacity * sizeof(T));
+			memcpy(m_heap, old, m_count * sizeof(T));
+			if (old != m_array)
+			{
+				cb2Free(old);
+			}
+		}
+
+		// Sift up.
+		int i = m_count++;
+		while (i > 0)
+		{
+			int parent = (i - 1) >> 1;
+			if (m_heap[parent].key <= element.key)
+			{
+				break;
+			}
+			m_heap[i] = m_heap[parent];
+			i = parent;
+		}
+		m_heap[i] = element;
+	}
+
+	/// Get the element with the smallest key.
+	const T& Top() const
+	{
+		cb2Assert(m_count > 0);
+		return m_heap[0];
+	}
+
+	T Pop()
+	{
+		cb2Assert(m_count > 0);
+		T top = m_heap[0];
+		T last = m_heap[--m_count];
+
+		// Sift the last element down from the root.
+		int i = 0;
+		for (;;)
+		{
+			int child = 2 * i + 1;
+			if (child >= m_count)
+			{
+				break;
+			}
+			if (child + 1 < m_count && m_heap[child + 1].key < m_heap[child].key)
+			{
+				++child;
+			}
+			if (last.key <= m_heap[child].key)
+			{
+				break;
+			}
+			m_heap[i] = m_heap[child];
+			i = child;
+		}
+		if (m_count > 0)
+		{
+			m_heap[i] = last;
+		}
+
+		return top;
+	}
+
+	int GetCount() const
+	{
+		return m_count;
+	}
+
+private:
+	T* m_heap;
+	T m_array[N];
+	int m_count;
+	int m_capacity;
+};
+
+
+#endif
@@ -18,105 +18,92 @@
 
 #include <CinderBox2D/Common/cb2Math.h>
 
-namespace cb2
+// The polynomials are the minimax fits of Cephes. Each operation is rounded on
+// its own, so the bits only depend on IEEE arithmetic.
+void cb2SinCos(float angle, float* s, float* c)
 {
-
-ci::Vec2f solve( const ci::Matrix22f& m, const ci::Vec2f& b)
-{
-	float a11 = m.m00, a12 = m.m01, a21 = m.m10, a22 = m.m11;
-	float det = a11 * a22 - a12 * a21;
-	if (det != 0.0f)
+	// Reduce to [-pi/4, pi/4] around the nearest multiple of pi/2. The multiple is
+	// subtracted in three parts that are exact in float.
+	float k = floorf(angle * (2.0f / cb2_pi) + 0.5f);
+	float x = angle - k * 1.5703125f;
+	x = x - k * 4.837512969970703125e-4f;
+	x = x - k * 7.54978995489188216e-8f;
+
+	float z = x * x;
+	float sx = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+	float cx = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+
+	int quadrant = (int)(k - 4.0f * floorf(0.25f * k));
+	switch (quadrant)
 	{
-		det = 1.0f / det;
+	case 0:
+		*s = sx;
+		*c = cx;
+		break;
+
+	case 1:
+		*s = cx;
+		*c = -sx;
+		break;
+
+	case 2:
+		*s = -sx;
+		*c = -cx;
+		break;
+
+	default:
+		*s = -cx;
+		*c = sx;
+		break;
 	}
-	ci::Vec2f x;
-	x.x = det * (a22 * b.x - a12 * b.y);
-	x.y = det * (a11 * b.y - a21 * b.x);
-	return x;
 }
 
-/// Solve A * x = b, where b is a column vector. This is more efficient
-/// than computing the inverse in one-shot cases.
-ci::Vec3f solve( const ci::Matrix33f& A, const ci::Vec3f& b)
+float cb2ComputeAtan2(float y, float x)
 {
-  // todo: optimize math here
-  ci::Vec3f ex = A.getColumn(0);
-  ci::Vec3f ey = A.getColumn(1);
-  ci::Vec3f ez = A.getColumn(2);
-
-	float det = cb2Dot(ex, cb2Cross(ey, ez));
-	if (det != 0.0f)
+	if (x == 0.0f)
 	{
-		det = 1.0f / det;
+		if (y > 0.0f)
+		{
+			return 0.5f * cb2_pi;
+		}
+
+		if (y < 0.0f)
+		{
+			return -0.5f * cb2_pi;
+		}
+
+		return 0.0f;
 	}
-	ci::Vec3f x;
-	x.x = det * cb2Dot(b, cb2Cross(ey, ez));
-	x.y = det * cb2Dot(ex, cb2Cross(b, ez));
-	x.z = det * cb2Dot(ex, cb2Cross(ey, b));
-	return x;
-}
 
-/// Solve A * x = b, where b is a column vector. This is more efficient
-/// than computing the inverse in one-shot cases.
-ci::Vec2f solve22( const ci::Matrix33f& A, const ci::Vec2f& b)
-{
-	float a11 = A.m00, a12 = A.m10, a21 = A.m01, a22 = A.m11;
-	float det = a11 * a22 - a12 * a21;
-	if (det != 0.0f)
+	// Reduce the ratio to [0, tan(pi/8)].
+	float t = y / x;
+	float sign = 1.0f;
+	if (t < 0.0f)
 	{
-		det = 1.0f / det;
+		t = -t;
+		sign = -1.0f;
 	}
-	ci::Vec2f x;
-	x.x = det * (a22 * b.x - a12 * b.y);
-	x.y = det * (a11 * b.y - a21 * b.x);
-	return x;
-}
 
-///
-void getInverse22( const ci::Matrix33f& A, ci::Matrix33f* M )
-{
-	float a = A.m00, b = A.m10, c = A.m01, d = A.m11;
-	float det = a * d - b * c;
-	if (det != 0.0f)
+	float offset = 0.0f;
+	if (t > 2.414213562373095f)
 	{
-		det = 1.0f / det;
+		offset = 0.5f * cb2_pi;
+		t = -1.0f / t;
 	}
-
-	M->m00 =  det * d;	M->m10 = -det * b; M->m02 = 0.0f;
-	M->m01 = -det * c;	M->m11 =  det * a; M->m12 = 0.0f;
-	M->m10 = 0.0f;      M->m21 = 0.0f;     M->m22 = 0.0f;
-}
-
-/// Returns the zero matrix if singular.
-void getSymInverse33( const ci::Matrix33f& A, ci::Matrix33f* M )
-{
-  // todo: optimize math here
-  ci::Vec3f ex = A.getColumn(0);
-  ci::Vec3f ey = A.getColumn(1);
-  ci::Vec3f ez = A.getColumn(2);
-
-	float det = cb2Dot(ex, cb2Cross(ey, ez));
-
-	if (det != 0.0f)
+	else if (t > 0.4142135623730950f)
 	{
-		det = 1.0f / det;
+		offset = 0.25f * cb2_pi;
+		t = (t - 1.0f) / (t + 1.0f);
 	}
 
-	float a11 = ex.x, a12 = ey.x, a13 = ez.x;
-	float a22 = ey.y, a23 = ez.y;
-	float a33 = ez.z;
+	float z = t * t;
+	float a = (((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * t + t;
+	a = sign * (offset + a);
 
-	M->m00 = det * (a22 * a33 - a23 * a23);
-	M->m01 = det * (a13 * a23 - a12 * a33);
-	M->m02 = det * (a12 * a23 - a13 * a22);
-
-	M->m10 = M->m01;
-	M->m11 = det * (a11 * a33 - a13 * a13);
-	M->m12 = det * (a13 * a12 - a11 * a23);
-
-	M->m20 = M->m02;
-	M->m21 = M->m12;
-	M->m22 = det * (a11 * a22 - a12 * a12);
-}
+	if (x < 0.0f)
+	{
+		a += y < 0.0f ? -cb2_pi : cb2_pi;
+	}
 
+	return a;
 }
@@ -18,9 +18,7 @@
 
 #ifndef CB2_MATH_H
 #define CB2_MATH_H
-#include <cinder/Vector.h>
-#include <cinder/Matrix22.h>
-#include <cinder/Matrix33.h>
+#include <CinderBox2D/Common/cb2Vector.h>
 #include <CinderBox2D/Common/cb2Settings.h>
 #include <math.h>
 
@@ -57,27 +55,22 @@ template< typename T > inline T& getElement(       ci::Vec4<T> &v, int i ) { ret
 
 
 template< typename T > inline ci::Vec2<T> skew( const ci::Vec2<T> &v ) { return ci::Vec2<T>( -v.y, v.x ); }
+}
 
-/// Solve A * x = b, where b is a column vector. This is more efficient
-/// than computing the inverse in one-shot cases.
-ci::Vec2f solve( const ci::Matrix22f& m, const ci::Vec2f& b);
-
-/// Solve A * x = b, where b is a column vector. This is more efficient
-/// than computing the inverse in one-shot cases.
-ci::Vec3f solve( const ci::Matrix33f&A, const ci::Vec3f& b);
-
-/// Solve A * x = b, where b is a column vector. This is more efficient
-/// than computing the inverse in one-shot cases. Solve only the upper
-/// 2-by-2 matrix equation.
-ci::Vec2f solve22( const ci::Matrix33f&A, const ci::Vec2f& b);
-
-void getInverse22( const ci::Matrix33f& A, ci::Matrix33f* M);
+/// Compute the sine and cosine of an angle in radians with basic arithmetic only,
+/// so the result is the same on every platform. Used with CB2_DETERMINISTIC.
+void cb2SinCos(float angle, float* s, float* c);
 
-void getSymInverse33( const ci::Matrix33f& A, ci::Matrix33f* M );
-}
+/// Compute the arc tangent of y / x in [-pi, pi] with basic arithmetic only.
+/// Used with CB2_DETERMINISTIC.
+float cb2ComputeAtan2(float y, float x);
 
 #define	cb2Sqrt(x)	sqrtf(x)
+#if defined(CB2_DETERMINISTIC)
+#define	cb2Atan2(y, x)	cb2ComputeAtan2(y, x)
+#else
 #define	cb2Atan2(y, x)	atan2f(y, x)
+#endif
 
 
 /// Rotation
@@ -88,17 +81,25 @@ struct cb2Rot
 	/// Initialize from an angle in radians
 	explicit cb2Rot(float angle)
 	{
+#if defined(CB2_DETERMINISTIC)
+		cb2SinCos(angle, &s, &c);
+#else
 		/// TODO_ERIN optimize
 		s = sinf(angle);
 		c = cosf(angle);
+#endif
 	}
 
 	/// set using an angle in radians.
 	void set(float angle)
 	{
+#if defined(CB2_DETERMINISTIC)
+		cb2SinCos(angle, &s, &c);
+#else
 		/// TODO_ERIN optimize
 		s = sinf(angle);
 		c = cosf(angle);
+#endif
 	}
 
 	/// set to the identity rotation
@@ -221,7 +222,7 @@ inline ci::Vec2f cb2Mul(const ci::Matrix22f& A, const ci::Vec2f& v)
 /// then this transforms the vector from one frame to another (inverse transform).
 inline ci::Vec2f cb2MulT(const ci::Matrix22f& A, const ci::Vec2f& v)
 {
-  return A.transposed() * v;
+	return ci::Vec2f(A.m00 * v.x + A.m10 * v.y, A.m01 * v.x + A.m11 * v.y);
 }
 
 inline float cb2Distance(const ci::Vec2f& a, const ci::Vec2f& b)
@@ -257,7 +258,8 @@ inline ci::Matrix22f cb2Mul(const ci::Matrix22f& A, const ci::Matrix22f& B)
 // A^T * B
 inline ci::Matrix22f cb2MulT(const ci::Matrix22f& A, const ci::Matrix22f& B)
 {
-  return A.transposed() * B;
+	return ci::Matrix22f(A.m00 * B.m00 + A.m10 * B.m10, A.m01 * B.m00 + A.m11 * B.m10,
+						 A.m00 * B.m01 + A.m10 * B.m11, A.m01 * B.m01 + A.m11 * B.m11);
 }
 
 /// Multiply a matrix times a vector.
@@ -272,6 +274,114 @@ inline ci::Vec2f cb2Mul22(const ci::Matrix33f& A, const ci::Vec2f& v)
 	return ci::Vec2f(A.m00 * v.x + A.m10 * v.y, A.m01 * v.x + A.m11 * v.y);
 }
 
+// The solvers below are inline so the joint solver loops keep the matrix entries
+// in registers. They read the entries directly instead of copying the columns,
+// in the same order of operations as the column form.
+namespace cb2
+{
+
+/// Solve A * x = b, where b is a column vector. This is more efficient
+/// than computing the inverse in one-shot cases.
+inline ci::Vec2f solve(const ci::Matrix22f& A, const ci::Vec2f& b)
+{
+	float a11 = A.m00, a12 = A.m01, a21 = A.m10, a22 = A.m11;
+	float det = a11 * a22 - a12 * a21;
+	if (det != 0.0f)
+	{
+		det = 1.0f / det;
+	}
+	return ci::Vec2f(det * (a22 * b.x - a12 * b.y), det * (a11 * b.y - a21 * b.x));
+}
+
+/// Solve A * x = b, where b is a column vector. This is more efficient
+/// than computing the inverse in one-shot cases.
+inline ci::Vec3f solve(const ci::Matrix33f& A, const ci::Vec3f& b)
+{
+	// Columns ex = (m00, m10, m20), ey = (m01, m11, m21), ez = (m02, m12, m22).
+	float eyzX = A.m11 * A.m22 - A.m21 * A.m12;
+	float eyzY = A.m21 * A.m02 - A.m22 * A.m01;
+	float eyzZ = A.m01 * A.m12 - A.m02 * A.m11;
+
+	float det = A.m00 * eyzX + A.m10 * eyzY + A.m20 * eyzZ;
+	if (det != 0.0f)
+	{
+		det = 1.0f / det;
+	}
+
+	float bzX = b.y * A.m22 - A.m12 * b.z;
+	float bzY = b.z * A.m02 - A.m22 * b.x;
+	float bzZ = b.x * A.m12 - A.m02 * b.y;
+
+	float ybX = A.m11 * b.z - b.y * A.m21;
+	float ybY = A.m21 * b.x - b.z * A.m01;
+	float ybZ = A.m01 * b.y - b.x * A.m11;
+
+	ci::Vec3f x;
+	x.x = det * (b.x * eyzX + b.y * eyzY + b.z * eyzZ);
+	x.y = det * (A.m00 * bzX + A.m10 * bzY + A.m20 * bzZ);
+	x.z = det * (A.m00 * ybX + A.m10 * ybY + A.m20 * ybZ);
+	return x;
+}
+
+/// Solve A * x = b, where b is a column vector. This is more efficient
+/// than computing the inverse in one-shot cases. Solve only the upper
+/// 2-by-2 matrix equation.
+inline ci::Vec2f solve22(const ci::Matrix33f& A, const ci::Vec2f& b)
+{
+	float a11 = A.m00, a12 = A.m10, a21 = A.m01, a22 = A.m11;
+	float det = a11 * a22 - a12 * a21;
+	if (det != 0.0f)
+	{
+		det = 1.0f / det;
+	}
+	return ci::Vec2f(det * (a22 * b.x - a12 * b.y), det * (a11 * b.y - a21 * b.x));
+}
+
+/// Get the inverse of the upper 2-by-2 matrix as a 3-by-3 matrix with
+/// zeros in the third row and column. Returns the zero matrix if singular.
+inline void getInverse22(const ci::Matrix33f& A, ci::Matrix33f* M)
+{
+	float a = A.m00, b = A.m01, c = A.m10, d = A.m11;
+	float det = a * d - b * c;
+	if (det != 0.0f)
+	{
+		det = 1.0f / det;
+	}
+
+	M->m00 =  det * d;	M->m01 = -det * b;	M->m02 = 0.0f;
+	M->m10 = -det * c;	M->m11 =  det * a;	M->m12 = 0.0f;
+	M->m20 = 0.0f;		M->m21 = 0.0f;		M->m22 = 0.0f;
+}
+
+/// Get the symmetric inverse of this matrix as a 3-by-3.
+/// Returns the zero matrix if singular.
+inline void getSymInverse33(const ci::Matrix33f& A, ci::Matrix33f* M)
+{
+	float det = A.m00 * (A.m11 * A.m22 - A.m21 * A.m12) + A.m10 * (A.m21 * A.m02 - A.m22 * A.m01) + A.m20 * (A.m01 * A.m12 - A.m02 * A.m11);
+	if (det != 0.0f)
+	{
+		det = 1.0f / det;
+	}
+
+	float a11 = A.m00, a12 = A.m01, a13 = A.m02;
+	float a22 = A.m11, a23 = A.m12;
+	float a33 = A.m22;
+
+	M->m00 = det * (a22 * a33 - a23 * a23);
+	M->m01 = det * (a13 * a23 - a12 * a33);
+	M->m02 = det * (a12 * a23 - a13 * a22);
+
+	M->m10 = M->m01;
+	M->m11 = det * (a11 * a33 - a13 * a13);
+	M->m12 = det * (a13 * a12 - a11 * a23);
+
+	M->m20 = M->m02;
+	M->m21 = M->m12;
+	M->m22 = det * (a11 * a22 - a12 * a12);
+}
+
+}
+
 /// Multiply two rotations: q * r
 inline cb2Rot cb2Mul(const cb2Rot& q, const cb2Rot& r)
 {
@@ -425,6 +535,18 @@ inline bool cb2IsPowerOfTwo(unsigned int x)
 	return result;
 }
 
+/// Spread the low 16 bits so that there is a zero bit between each. Two spread
+/// coordinates interleave into a Morton code.
+inline unsigned int cb2SpreadBits(unsigned int x)
+{
+	x &= 0x0000FFFF;
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
 inline void cb2Sweep::GetTransform(cb2Transform* xf, float beta) const
 {
 	xf->p = (1.0f - beta) * c0 + beta * c;
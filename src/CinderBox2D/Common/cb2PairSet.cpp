@@ -0,0 +1,114 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Common/cb2PairSet.h>
+#include <memory.h>
+
+// Empty slots hold all bits set. Valid keys never do, since ids are non-negative.
+const unsigned long long cb2_emptyPairKey = ~0ULL;
+
+cb2PairSet::cb2PairSet()
+{
+	m_capacity = 64;
+	m_count = 0;
+	m_keys = (unsigned long long*)cb2Alloc(m_capacity * sizeof(unsigned long long));
+	memset(m_keys, 0xff, m_capacity * sizeof(unsigned long long));
+}
+
+cb2PairSet::~cb2PairSet()
+{
+	cb2Free(m_keys);
+}
+
+bool cb2PairSet::AddPair(int idA, int idB)
+{
+	// Keep the table at most half full so probes stay short.
+	if (2 * (m_count + 1) > m_capacity)
+	{
+		Grow();
+	}
+
+	unsigned long long key = MakeKey(idA, idB);
+	int slot = FindSlot(key);
+	if (m_keys[slot] == key)
+	{
+		return false;
+	}
+
+	m_keys[slot] = key;
+	++m_count;
+	return true;
+}
+
+bool cb2PairSet::RemovePair(int idA, int idB)
+{
+	unsigned long long key = MakeKey(idA, idB);
+	int slot = FindSlot(key);
+	if (m_keys[slot] != key)
+	{
+		return false;
+	}
+
+	// Shift back the following keys of the probe run so no lookup stops early.
+	int mask = m_capacity - 1;
+	int hole = slot;
+	int next = (hole + 1) & mask;
+	while (m_keys[next] != cb2_emptyPairKey)
+	{
+		int home = (int)(Hash(m_keys[next]) & (unsigned int)mask);
+
+		// Move the key if its home is not within (hole, next].
+		if (((next - home) & mask) >= ((next - hole) & mask))
+		{
+			m_keys[hole] = m_keys[next];
+			hole = next;
+		}
+		next = (next + 1) & mask;
+	}
+
+	m_keys[hole] = cb2_emptyPairKey;
+	--m_count;
+	return true;
+}
+
+void cb2PairSet::Reserve(int count)
+{
+	while (2 * count > m_capacity)
+	{
+		Grow();
+	}
+}
+
+void cb2PairSet::Grow()
+{
+	unsigned long long* oldKeys = m_keys;
+	int oldCapacity = m_capacity;
+
+	m_capacity *= 2;
+	m_keys = (unsigned long long*)cb2Alloc(m_capacity * sizeof(unsigned long long));
+	memset(m_keys, 0xff, m_capacity * sizeof(unsigned long long));
+
+	for (int i = 0; i < oldCapacity; ++i)
+	{
+		if (oldKeys[i] != cb2_emptyPairKey)
+		{
+			m_keys[FindSlot(oldKeys[i])] = oldKeys[i];
+		}
+	}
+
+	cb2Free(oldKeys);
+}
@@ -0,0 +1,96 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_PAIR_SET_H
+#define CB2_PAIR_SET_H
+
+#include <CinderBox2D/Common/cb2Math.h>
+
+/// A set of unordered pairs of non-negative ids, stored in an open addressed
+/// hash table with linear probing. Lookups, inserts and removals are O(1).
+class cb2PairSet
+{
+public:
+	cb2PairSet();
+	~cb2PairSet();
+
+	/// Add a pair. Returns false if the pair was already in the set.
+	bool AddPair(int idA, int idB);
+
+	/// Remove a pair. Returns false if the pair was not in the set.
+	bool RemovePair(int idA, int idB);
+
+	/// Is the pair in the set?
+	bool ContainsPair(int idA, int idB) const;
+
+	/// Grow the table so it holds count pairs without rehashing.
+	void Reserve(int count);
+
+	/// Get the number of pairs.
+	int GetCount() const { return m_count; }
+
+private:
+
+	static unsigned long long MakeKey(int idA, int idB);
+	static unsigned int Hash(unsigned long long key);
+
+	int FindSlot(unsigned long long key) const;
+	void Grow();
+
+	unsigned long long* m_keys;
+	int m_capacity;
+	int m_count;
+};
+
+inline unsigned long long cb2PairSet::MakeKey(int idA, int idB)
+{
+	cb2Assert(idA >= 0 && idB >= 0);
+	unsigned long long a = (unsigned long long)cb2Min(idA, idB);
+	unsigned long long b = (unsigned long long)cb2Max(idA, idB);
+	return (a << 32) | b;
+}
+
+inline unsigned int cb2PairSet::Hash(unsigned long long key)
+{
+	// Finalizer of MurmurHash3.
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (unsigned int)key;
+}
+
+// Returns the slot holding the key, or the empty slot where it belongs.
+inline int cb2PairSet::FindSlot(unsigned long long key) const
+{
+	int mask = m_capacity - 1;
+	int slot = (int)(Hash(key) & (unsigned int)mask);
+	while (m_keys[slot] != key && m_keys[slot] != ~0ULL)
+	{
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+inline bool cb2PairSet::ContainsPair(int idA, int idB) const
+{
+	unsigned long long key = MakeKey(idA, idB);
+	return m_keys[FindSlot(key)] == key;
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Common/cb2Profiler.h>
+#include <CinderBox2D/Common/cb2Math.h>
+#include <memory.h>
+
+cb2TraceRecorder::cb2TraceRecorder(int threadCount)
+{
+	cb2Assert(threadCount > 0);
+	m_threadCount = threadCount;
+	m_timelines = (Timeline*)cb2Alloc(m_threadCount * sizeof(Timeline));
+	memset(m_timelines, 0, m_threadCount * sizeof(Timeline));
+}
+
+cb2TraceRecorder::~cb2TraceRecorder()
+{
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		cb2Free(m_timelines[i].events);
+		cb2Free(m_timelines[i].stack);
+	}
+	cb2Free(m_timelines);
+}
+
+cb2TraceRecorder::Event* cb2TraceRecorder::AddEvent(Timeline* timeline)
+{
+	if (timeline->eventCount == timeline->eventCapacity)
+	{
+		Event* oldEvents = timeline->events;
+		timeline->eventCapacity = cb2Max(2 * timeline->eventCapacity, 256);
+		timeline->events = (Event*)cb2Alloc(timeline->eventCapacity * sizeof(Event));
+		if (oldEvents)
+		{
+			memcpy(timeline->events, oldEvents, timeline->eventCount * sizeof(Event));
+			cb2Free(oldEvents);
+		}
+	}
+
+	Event* event = timeline->events + timeline->eventCount;
+	++timeline->eventCount;
+	return event;
+}
+
+void cb2TraceRecorder::BeginZone(const char* name, int count, int threadIndex)
+{
+	cb2Assert(0 <= threadIndex && threadIndex < m_threadCount);
+	Timeline* timeline = m_timelines + threadIndex;
+
+	if (timeline->stackCount == timeline->stackCapacity)
+	{
+		int* oldStack = timeline->stack;
+		timeline->stackCapacity = cb2Max(2 * timeline->stackCapacity, 16);
+		timeline->stack = (int*)cb2Alloc(timeline->stackCapacity * sizeof(int));
+		if (oldStack)
+		{
+			memcpy(timeline->stack, oldStack, timeline->stackCount * sizeof(int));
+			cb2Free(oldStack);
+		}
+	}
+
+	timeline->stack[timeline->stackCount++] = timeline->eventCount;
+
+	Event* event = AddEvent(timeline);
+	event->name = name;
+	event->type = e_zone;
+	event->value = count;
+	event->begin = m_timer.GetMilliseconds();
+	event->end = event->begin;
+}
+
+void cb2TraceRecorder::EndZone(int threadIndex)
+{
+	cb2Assert(0 <= threadIndex && threadIndex < m_threadCount);
+	Timeline* timeline = m_timelines + threadIndex;
+	cb2Assert(timeline->stackCount > 0);
+
+	int index = timeline->stack[--timeline->stackCount];
+
+	// The zone began before the last Clear.
+	if (index < 0)
+	{
+		return;
+	}
+
+	timeline->events[index].end = m_timer.GetMilliseconds();
+}
+
+void cb2TraceRecorder::ReportCounter(const char* name, int value)
+{
+	Event* event = AddEvent(m_timelines);
+	event->name = name;
+	event->type = e_counter;
+	event->value = value;
+	event->begin = m_timer.GetMilliseconds();
+	event->end = event->begin;
+}
+
+void cb2TraceRecorder::Clear()
+{
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		Timeline* timeline = m_timelines + i;
+		timeline->eventCount = 0;
+		for (int j = 0; j < timeline->stackCount; ++j)
+		{
+			timeline->stack[j] = -1;
+		}
+	}
+}
+
+int cb2TraceRecorder::GetEventCount(int threadIndex) const
+{
+	cb2Assert(0 <= threadIndex && threadIndex < m_threadCount);
+	return m_timelines[threadIndex].eventCount;
+}
+
+void cb2TraceRecorder::WriteChromeTrace(FILE* file) const
+{
+	// Times are in microseconds.
+	fprintf(file, "{\"traceEvents\":[\n");
+	bool first = true;
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		const Timeline* timeline = m_timelines + i;
+		for (int j = 0; j < timeline->eventCount; ++j)
+		{
+			const Event* event = timeline->events + j;
+			if (first == false)
+			{
+				fprintf(file, ",\n");
+			}
+			first = false;
+
+			if (event->type == e_zone)
+			{
+				fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"count\":%d}}",
+					event->name, i, 1000.0f * event->begin, 1000.0f * (event->end - event->begin), event->value);
+			}
+			else
+			{
+				fprintf(file, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%d}}",
+					event->name, i, 1000.0f * event->begin, event->value);
+			}
+		}
+	}
+	fprintf(file, "\n]}\n");
+}
@@ -0,0 +1,148 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_PROFILER_H
+#define CB2_PROFILER_H
+
+#include <CinderBox2D/Common/cb2Settings.h>
+#include <CinderBox2D/Common/cb2Timer.h>
+#include <stdio.h>
+
+/// Receives the nested zones and the counters of each time step. Implement this
+/// to forward them to an external profiler such as Tracy, or use cb2TraceRecorder.
+/// Zones of different threads are reported concurrently, each thread nests its own.
+/// Names are string literals that outlive the world.
+class cb2Profiler
+{
+public:
+	virtual ~cb2Profiler() {}
+
+	/// Called when a zone starts. The count is the number of items the zone
+	/// works on, such as the bodies of an island, or zero.
+	virtual void BeginZone(const char* name, int count, int threadIndex) = 0;
+
+	/// Called when the innermost open zone of a thread ends.
+	virtual void EndZone(int threadIndex) = 0;
+
+	/// Called at the end of each step with the counters of cb2Profile.
+	virtual void ReportCounter(const char* name, int value) = 0;
+};
+
+/// Begins a zone when constructed and ends it when destroyed. This does nothing
+/// without a profiler, and compiles out with CB2_NO_PROFILING.
+class cb2ProfileZone
+{
+public:
+#if defined(CB2_NO_PROFILING)
+	cb2ProfileZone(cb2Profiler* profiler, const char* name, int count = 0, int threadIndex = 0)
+	{
+		CB2_NOT_USED(profiler);
+		CB2_NOT_USED(name);
+		CB2_NOT_USED(count);
+		CB2_NOT_USED(threadIndex);
+	}
+#else
+	cb2ProfileZone(cb2Profiler* profiler, const char* name, int count = 0, int threadIndex = 0)
+	{
+		m_profiler = profiler;
+		m_threadIndex = threadIndex;
+		if (m_profiler)
+		{
+			m_profiler->BeginZone(name, count, threadIndex);
+		}
+	}
+
+	~cb2ProfileZone()
+	{
+		if (m_profiler)
+		{
+			m_profiler->EndZone(m_threadIndex);
+		}
+	}
+
+private:
+	cb2Profiler* m_profiler;
+	int m_threadIndex;
+#endif
+};
+
+/// A profiler that records the zones and counters in memory with timestamps, one
+/// timeline per thread, and writes them in the Chrome trace event format. Open the
+/// file with chrome://tracing or Perfetto.
+class cb2TraceRecorder : public cb2Profiler
+{
+public:
+	/// The thread count must cover the threads of the worlds that use this recorder.
+	cb2TraceRecorder(int threadCount);
+	~cb2TraceRecorder();
+
+	/// Implement cb2Profiler.
+	void BeginZone(const char* name, int count, int threadIndex);
+
+	/// Implement cb2Profiler.
+	void EndZone(int threadIndex);
+
+	/// Implement cb2Profiler. Counters are kept on the timeline of thread zero.
+	void ReportCounter(const char* name, int value);
+
+	/// Drop all recorded events. Zones that are open stay open.
+	void Clear();
+
+	/// Get the number of events recorded on a thread.
+	int GetEventCount(int threadIndex) const;
+
+	/// Write the recorded events as a Chrome trace JSON document.
+	void WriteChromeTrace(FILE* file) const;
+
+private:
+
+	enum EventType
+	{
+		e_zone,
+		e_counter
+	};
+
+	struct Event
+	{
+		const char* name;
+		int type;
+		int value;
+		float begin;
+		float end;
+	};
+
+	struct Timeline
+	{
+		Event* events;
+		int eventCount;
+		int eventCapacity;
+
+		// Indices of the open zones, innermost last.
+		int* stack;
+		int stackCount;
+		int stackCapacity;
+	};
+
+	Event* AddEvent(Timeline* timeline);
+
+	cb2Timer m_timer;
+	Timeline* m_timelines;
+	int m_threadCount;
+};
+
+#endif
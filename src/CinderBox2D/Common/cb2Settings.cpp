@@ -20,18 +20,74 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
 
 cb2Version cb2_version = {2, 3, 1};
 
-// Memory allocators. Modify these to use your own allocator.
+// Memory allocators. Use cb2SetAllocator to install your own allocator.
+static cb2AllocFcn* s_allocFcn = NULL;
+static cb2FreeFcn* s_freeFcn = NULL;
+static void* s_allocContext = NULL;
+
+void cb2SetAllocator(cb2AllocFcn* allocFcn, cb2FreeFcn* freeFcn, void* context)
+{
+	cb2Assert((allocFcn == NULL) == (freeFcn == NULL));
+	s_allocFcn = allocFcn;
+	s_freeFcn = freeFcn;
+	s_allocContext = context;
+}
+
 void* cb2Alloc(int size)
 {
-	return malloc(size);
+	return cb2Alloc(size, cb2_defaultAlignment, cb2_memoryGeneral);
+}
+
+void* cb2Alloc(int size, int alignment, cb2MemoryTag tag)
+{
+	cb2Assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	if (s_allocFcn)
+	{
+		return s_allocFcn(size, alignment, tag, s_allocContext);
+	}
+
+#if defined(_WIN32)
+	return _aligned_malloc(size, alignment);
+#else
+	if (alignment <= cb2_defaultAlignment)
+	{
+		return malloc(size);
+	}
+
+	void* mem = NULL;
+	if (posix_memalign(&mem, alignment, size) != 0)
+	{
+		return NULL;
+	}
+	return mem;
+#endif
 }
 
 void cb2Free(void* mem)
 {
+	cb2Free(mem, cb2_memoryGeneral);
+}
+
+void cb2Free(void* mem, cb2MemoryTag tag)
+{
+	if (s_freeFcn)
+	{
+		s_freeFcn(mem, tag, s_allocContext);
+		return;
+	}
+
+#if defined(_WIN32)
+	_aligned_free(mem);
+#else
 	free(mem);
+#endif
 }
 
 // You can modify this to use your logging facility.
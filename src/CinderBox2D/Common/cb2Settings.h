@@ -19,7 +19,9 @@
 #ifndef CB2_SETTINGS_H
 #define CB2_SETTINGS_H
 
+#if !defined(CB2_HEADLESS)
 #include <cinder/Cinder.h>
+#endif
 #include <stddef.h>
 #include <assert.h>
 #include <float.h>
@@ -31,6 +33,25 @@
 #define	cb2_epsilon		FLT_EPSILON
 #define cb2_pi			3.14159265359f
 
+/// Define CB2_DETERMINISTIC to get bit identical results on all platforms with IEEE
+/// single precision floats, for lockstep simulation. The sine, cosine and arc tangent
+/// of the C library are then replaced by cb2SinCos and cb2ComputeAtan2, and multiplies
+/// and adds are not contracted into fused operations in the code that includes this
+/// file. Build the whole program with -ffp-contract=off (or /fp:precise) as well.
+/// Square roots are correctly rounded by IEEE 754 and are kept.
+#if defined(CB2_DETERMINISTIC)
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0
+#error "CB2_DETERMINISTIC needs float math without extended precision, such as SSE2 on x86."
+#endif
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract (off)
+#endif
+#endif
+
 /// @file
 /// Global tuning constants based on meters-kilograms-seconds (MKS) units.
 ///
@@ -71,12 +92,30 @@
 /// Maximum number of sub-steps per contact in continuous physics simulation.
 #define cb2_maxSubSteps			8
 
+/// The number of collision layers of the layer matrix. Each fixture is on one layer.
+#define cb2_maxLayers			32
+
+/// The number of materials of the material table, see cb2World::SetMaterial.
+#define cb2_maxMaterials		32
+
 
 // Dynamics
 
 /// Maximum number of contacts to be handled to solve a TOI impact.
 #define cb2_maxTOIContacts			32
 
+/// The most levels of detail of the simulation, see cb2World::SetLodLevels.
+#define cb2_maxLodLevels			4
+
+/// The most points the levels of detail are measured from, see cb2World::SetLodObservers.
+#define cb2_maxLodObservers			8
+
+/// The most time steps added to an island that owes time, see cb2World::SetSolveBudget.
+#define cb2_maxCatchUpSteps			3
+
+/// The most time steps an island deferred by the solve budget can owe.
+#define cb2_maxSolveDebtSteps		8
+
 /// A velocity threshold for elastic collisions. Any collision with a relative linear
 /// velocity below this threshold will be treated as inelastic.
 #define cb2_velocityThreshold		1.0f
@@ -119,12 +158,45 @@
 
 // Memory Allocation
 
-/// Implement this function to use your own memory allocator.
+/// The subsystem an allocation belongs to. This is passed to the user allocator
+/// so physics memory can be tracked and budgeted per subsystem.
+enum cb2MemoryTag
+{
+	cb2_memoryGeneral = 0,
+	cb2_memoryBlock,		///< block allocator chunks and large objects
+	cb2_memoryStack,		///< stack allocator buffers and overflow
+	cb2_memoryTree,			///< dynamic tree node pools
+	cb2_memoryBroadPhase,	///< broad-phase move and pair buffers
+	cb2_memoryTagCount
+};
+
+/// The default alignment of engine allocations.
+#define cb2_defaultAlignment	16
+
+/// User allocation function. This must return memory aligned to at least alignment,
+/// which is a power of two. The context is the pointer given to cb2SetAllocator.
+typedef void* cb2AllocFcn(int size, int alignment, cb2MemoryTag tag, void* context);
+
+/// User free function. This receives the tag the memory was allocated with.
+typedef void cb2FreeFcn(void* mem, cb2MemoryTag tag, void* context);
+
+/// Route engine memory through your own allocator. Pass NULL functions to restore
+/// malloc and free. Set this before creating any world and do not change it
+/// while engine memory is still allocated.
+void cb2SetAllocator(cb2AllocFcn* allocFcn, cb2FreeFcn* freeFcn, void* context);
+
+/// Allocate engine memory with the default alignment and the general tag.
 void* cb2Alloc(int size);
 
-/// If you implement cb2Alloc, you should also implement this function.
+/// Allocate engine memory with an alignment and a subsystem tag.
+void* cb2Alloc(int size, int alignment, cb2MemoryTag tag);
+
+/// Free memory from cb2Alloc(int).
 void cb2Free(void* mem);
 
+/// Free memory from cb2Alloc(int, int, cb2MemoryTag) using the same tag.
+void cb2Free(void* mem, cb2MemoryTag tag);
+
 /// Logging function.
 void cb2Log(const char* string, ...);
 
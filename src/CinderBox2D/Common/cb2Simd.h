@@ -0,0 +1,148 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_SIMD_H
+#define CB2_SIMD_H
+
+#include <CinderBox2D/Common/cb2Settings.h>
+#include <math.h>
+
+/// Four float lanes processed together. SSE2 and NEON are used when the
+/// compiler targets them, otherwise a plain struct that compilers can still
+/// vectorize. Define CB2_NO_SIMD to force the plain version.
+#if !defined(CB2_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+
+#define CB2_SIMD_SSE2
+#include <emmintrin.h>
+
+typedef __m128 cb2FloatW;
+
+inline cb2FloatW cb2ZeroW() { return _mm_setzero_ps(); }
+inline cb2FloatW cb2SplatW(float a) { return _mm_set1_ps(a); }
+inline cb2FloatW cb2LoadW(const float* a) { return _mm_loadu_ps(a); }
+inline void cb2StoreW(float* a, cb2FloatW b) { _mm_storeu_ps(a, b); }
+inline cb2FloatW cb2AddW(cb2FloatW a, cb2FloatW b) { return _mm_add_ps(a, b); }
+inline cb2FloatW cb2SubW(cb2FloatW a, cb2FloatW b) { return _mm_sub_ps(a, b); }
+inline cb2FloatW cb2MulW(cb2FloatW a, cb2FloatW b) { return _mm_mul_ps(a, b); }
+inline cb2FloatW cb2MinW(cb2FloatW a, cb2FloatW b) { return _mm_min_ps(a, b); }
+inline cb2FloatW cb2MaxW(cb2FloatW a, cb2FloatW b) { return _mm_max_ps(a, b); }
+inline cb2FloatW cb2DivW(cb2FloatW a, cb2FloatW b) { return _mm_div_ps(a, b); }
+inline cb2FloatW cb2SqrtW(cb2FloatW a) { return _mm_sqrt_ps(a); }
+inline cb2FloatW cb2AbsW(cb2FloatW a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline cb2FloatW cb2SelectGreaterW(cb2FloatW a, cb2FloatW b, cb2FloatW t, cb2FloatW f)
+{
+	__m128 m = _mm_cmpgt_ps(a, b);
+	return _mm_or_ps(_mm_and_ps(m, t), _mm_andnot_ps(m, f));
+}
+inline int cb2MaskLessEqualW(cb2FloatW a, cb2FloatW b) { return _mm_movemask_ps(_mm_cmple_ps(a, b)); }
+
+#elif !defined(CB2_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+
+#define CB2_SIMD_NEON
+#include <arm_neon.h>
+
+typedef float32x4_t cb2FloatW;
+
+inline cb2FloatW cb2ZeroW() { return vdupq_n_f32(0.0f); }
+inline cb2FloatW cb2SplatW(float a) { return vdupq_n_f32(a); }
+inline cb2FloatW cb2LoadW(const float* a) { return vld1q_f32(a); }
+inline void cb2StoreW(float* a, cb2FloatW b) { vst1q_f32(a, b); }
+inline cb2FloatW cb2AddW(cb2FloatW a, cb2FloatW b) { return vaddq_f32(a, b); }
+inline cb2FloatW cb2SubW(cb2FloatW a, cb2FloatW b) { return vsubq_f32(a, b); }
+inline cb2FloatW cb2MulW(cb2FloatW a, cb2FloatW b) { return vmulq_f32(a, b); }
+inline cb2FloatW cb2MinW(cb2FloatW a, cb2FloatW b) { return vminq_f32(a, b); }
+inline cb2FloatW cb2MaxW(cb2FloatW a, cb2FloatW b) { return vmaxq_f32(a, b); }
+#if defined(__aarch64__) || defined(_M_ARM64)
+inline cb2FloatW cb2DivW(cb2FloatW a, cb2FloatW b) { return vdivq_f32(a, b); }
+inline cb2FloatW cb2SqrtW(cb2FloatW a) { return vsqrtq_f32(a); }
+#else
+// ARMv7 NEON has only estimates, so divide and take roots lane by lane.
+inline cb2FloatW cb2DivW(cb2FloatW a, cb2FloatW b)
+{
+	float x[4], y[4];
+	vst1q_f32(x, a);
+	vst1q_f32(y, b);
+	x[0] /= y[0]; x[1] /= y[1]; x[2] /= y[2]; x[3] /= y[3];
+	return vld1q_f32(x);
+}
+inline cb2FloatW cb2SqrtW(cb2FloatW a)
+{
+	float x[4];
+	vst1q_f32(x, a);
+	x[0] = sqrtf(x[0]); x[1] = sqrtf(x[1]); x[2] = sqrtf(x[2]); x[3] = sqrtf(x[3]);
+	return vld1q_f32(x);
+}
+#endif
+inline cb2FloatW cb2AbsW(cb2FloatW a) { return vabsq_f32(a); }
+inline cb2FloatW cb2SelectGreaterW(cb2FloatW a, cb2FloatW b, cb2FloatW t, cb2FloatW f) { return vbslq_f32(vcgtq_f32(a, b), t, f); }
+inline int cb2MaskLessEqualW(cb2FloatW a, cb2FloatW b)
+{
+	uint32x4_t m = vcleq_f32(a, b);
+	return (vgetq_lane_u32(m, 0) & 1) | (vgetq_lane_u32(m, 1) & 2) | (vgetq_lane_u32(m, 2) & 4) | (vgetq_lane_u32(m, 3) & 8);
+}
+
+#else
+
+struct cb2FloatW
+{
+	float x, y, z, w;
+};
+
+inline cb2FloatW cb2MakeW(float x, float y, float z, float w)
+{
+	cb2FloatW a;
+	a.x = x; a.y = y; a.z = z; a.w = w;
+	return a;
+}
+
+inline cb2FloatW cb2ZeroW() { return cb2MakeW(0.0f, 0.0f, 0.0f, 0.0f); }
+inline cb2FloatW cb2SplatW(float a) { return cb2MakeW(a, a, a, a); }
+inline cb2FloatW cb2LoadW(const float* a) { return cb2MakeW(a[0], a[1], a[2], a[3]); }
+inline void cb2StoreW(float* a, cb2FloatW b) { a[0] = b.x; a[1] = b.y; a[2] = b.z; a[3] = b.w; }
+inline cb2FloatW cb2AddW(cb2FloatW a, cb2FloatW b) { return cb2MakeW(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+inline cb2FloatW cb2SubW(cb2FloatW a, cb2FloatW b) { return cb2MakeW(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); }
+inline cb2FloatW cb2MulW(cb2FloatW a, cb2FloatW b) { return cb2MakeW(a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w); }
+inline cb2FloatW cb2MinW(cb2FloatW a, cb2FloatW b)
+{
+	return cb2MakeW(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z, a.w < b.w ? a.w : b.w);
+}
+inline cb2FloatW cb2MaxW(cb2FloatW a, cb2FloatW b)
+{
+	return cb2MakeW(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z, a.w > b.w ? a.w : b.w);
+}
+inline cb2FloatW cb2DivW(cb2FloatW a, cb2FloatW b) { return cb2MakeW(a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w); }
+inline cb2FloatW cb2SqrtW(cb2FloatW a) { return cb2MakeW(sqrtf(a.x), sqrtf(a.y), sqrtf(a.z), sqrtf(a.w)); }
+inline cb2FloatW cb2AbsW(cb2FloatW a) { return cb2MakeW(fabsf(a.x), fabsf(a.y), fabsf(a.z), fabsf(a.w)); }
+inline cb2FloatW cb2SelectGreaterW(cb2FloatW a, cb2FloatW b, cb2FloatW t, cb2FloatW f)
+{
+	return cb2MakeW(a.x > b.x ? t.x : f.x, a.y > b.y ? t.y : f.y, a.z > b.z ? t.z : f.z, a.w > b.w ? t.w : f.w);
+}
+inline int cb2MaskLessEqualW(cb2FloatW a, cb2FloatW b)
+{
+	return (a.x <= b.x ? 1 : 0) | (a.y <= b.y ? 2 : 0) | (a.z <= b.z ? 4 : 0) | (a.w <= b.w ? 8 : 0);
+}
+
+#endif
+
+/// cb2MaskLessEqualW returns a four bit mask with bit i set where lane i of a <= b.
+/// cb2SelectGreaterW picks lane i of t where lane i of a > b, otherwise lane i of f.
+
+/// Number of lanes in cb2FloatW.
+const int cb2_simdWidth = 4;
+
+#endif
@@ -21,6 +21,8 @@
 
 cb2StackAllocator::cb2StackAllocator()
 {
+	m_data = (char*)cb2Alloc(cb2_stackSize, cb2_defaultAlignment, cb2_memoryStack);
+	m_capacity = cb2_stackSize;
 	m_index = 0;
 	m_allocation = 0;
 	m_maxAllocation = 0;
@@ -31,17 +33,22 @@ cb2StackAllocator::~cb2StackAllocator()
 {
 	cb2Assert(m_index == 0);
 	cb2Assert(m_entryCount == 0);
+	cb2Free(m_data, cb2_memoryStack);
 }
 
 void* cb2StackAllocator::Allocate(int size)
 {
 	cb2Assert(m_entryCount < cb2_maxStackEntries);
 
+	// Round the size up so every allocation of the stack starts aligned, as the
+	// ones from cb2Alloc do.
+	size = (size + cb2_defaultAlignment - 1) & ~(cb2_defaultAlignment - 1);
+
 	cb2StackEntry* entry = m_entries + m_entryCount;
 	entry->size = size;
-	if (m_index + size > cb2_stackSize)
+	if (m_index + size > m_capacity)
 	{
-		entry->data = (char*)cb2Alloc(size);
+		entry->data = (char*)cb2Alloc(size, cb2_defaultAlignment, cb2_memoryStack);
 		entry->usedMalloc = true;
 	}
 	else
@@ -65,7 +72,7 @@ void cb2StackAllocator::Free(void* p)
 	cb2Assert(p == entry->data);
 	if (entry->usedMalloc)
 	{
-		cb2Free(p);
+		cb2Free(p, cb2_memoryStack);
 	}
 	else
 	{
@@ -74,9 +81,32 @@ void cb2StackAllocator::Free(void* p)
 	m_allocation -= entry->size;
 	--m_entryCount;
 
+	// Grow while nothing points into the stack.
+	if (m_entryCount == 0)
+	{
+		Reserve(m_maxAllocation);
+	}
+
 	p = NULL;
 }
 
+void cb2StackAllocator::Reserve(int size)
+{
+	cb2Assert(m_entryCount == 0);
+	if (size <= m_capacity)
+	{
+		return;
+	}
+
+	while (m_capacity < size)
+	{
+		m_capacity *= 2;
+	}
+
+	cb2Free(m_data, cb2_memoryStack);
+	m_data = (char*)cb2Alloc(m_capacity, cb2_defaultAlignment, cb2_memoryStack);
+}
+
 int cb2StackAllocator::GetMaxAllocation() const
 {
 	return m_maxAllocation;
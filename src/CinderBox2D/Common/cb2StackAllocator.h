@@ -21,7 +21,7 @@
 
 #include <CinderBox2D/Common/cb2Settings.h>
 
-const int cb2_stackSize = 100 * 1024;	// 100k
+const int cb2_stackSize = 100 * 1024;	// 100k, the initial size
 const int cb2_maxStackEntries = 32;
 
 struct cb2StackEntry
@@ -34,6 +34,9 @@ struct cb2StackEntry
 // This is a stack allocator used for fast per step allocations.
 // You must nest allocate/free pairs. The code will assert
 // if you try to interleave multiple allocate/free pairs.
+// Allocations are aligned to cb2_defaultAlignment, and the ones that do not fit
+// fall back to cb2Alloc. Once the stack is empty again it grows past the
+// high-water mark, so a steady load stops calling cb2Alloc.
 class cb2StackAllocator
 {
 public:
@@ -45,9 +48,16 @@ public:
 
 	int GetMaxAllocation() const;
 
+	// Grow the stack to hold size bytes. This must be called while nothing is allocated.
+	void Reserve(int size);
+
+	// The size of the stack, in bytes.
+	int GetCapacity() const { return m_capacity; }
+
 private:
 
-	char m_data[cb2_stackSize];
+	char* m_data;
+	int m_capacity;
 	int m_index;
 
 	int m_allocation;
@@ -0,0 +1,160 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Common/cb2ThreadPool.h>
+#include <CinderBox2D/Common/cb2Math.h>
+#include <new>
+
+// The pool and index of a worker thread.
+static thread_local const cb2ThreadPool* s_workerPool = NULL;
+static thread_local int s_workerIndex = 0;
+
+cb2ThreadPool::cb2ThreadPool(int threadCount)
+{
+	cb2Assert(threadCount > 0);
+	m_threadCount = threadCount;
+	m_generation = 0;
+	m_busyCount = 0;
+	m_quit = false;
+	m_task = NULL;
+	m_count = 0;
+	m_grainSize = 1;
+	m_next = 0;
+
+	// Thread zero is the caller of ParallelFor.
+	m_threads = NULL;
+	if (m_threadCount > 1)
+	{
+		m_threads = (std::thread*)cb2Alloc((m_threadCount - 1) * sizeof(std::thread));
+		for (int i = 1; i < m_threadCount; ++i)
+		{
+			new (m_threads + i - 1) std::thread(&cb2ThreadPool::WorkerMain, this, i);
+		}
+	}
+}
+
+cb2ThreadPool::~cb2ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (int i = 0; i < m_threadCount - 1; ++i)
+	{
+		m_threads[i].join();
+		m_threads[i].~thread();
+	}
+
+	if (m_threads)
+	{
+		cb2Free(m_threads);
+	}
+}
+
+void cb2ThreadPool::ParallelFor(cb2Task* task, int count, int grainSize)
+{
+	cb2Assert(m_task == NULL);
+	cb2Assert(grainSize > 0);
+
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// Not worth waking the workers.
+	if (m_threadCount == 1 || count <= grainSize)
+	{
+		task->Execute(0, count, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = task;
+		m_count = count;
+		m_grainSize = grainSize;
+		m_next = 0;
+		m_busyCount = m_threadCount - 1;
+		++m_generation;
+	}
+	m_wakeCondition.notify_all();
+
+	Run(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_busyCount > 0)
+	{
+		m_doneCondition.wait(lock);
+	}
+	m_task = NULL;
+}
+
+int cb2ThreadPool::GetThreadIndex() const
+{
+	return s_workerPool == this ? s_workerIndex : 0;
+}
+
+void cb2ThreadPool::WorkerMain(int threadIndex)
+{
+	s_workerPool = this;
+	s_workerIndex = threadIndex;
+
+	unsigned int generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (m_generation == generation && m_quit == false)
+			{
+				m_wakeCondition.wait(lock);
+			}
+
+			if (m_quit)
+			{
+				return;
+			}
+
+			generation = m_generation;
+		}
+
+		Run(threadIndex);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busyCount == 0)
+		{
+			m_doneCondition.notify_one();
+		}
+	}
+}
+
+void cb2ThreadPool::Run(int threadIndex)
+{
+	for (;;)
+	{
+		int begin = m_next.fetch_add(m_grainSize);
+		if (begin >= m_count)
+		{
+			break;
+		}
+
+		int end = cb2Min(begin + m_grainSize, m_count);
+		m_task->Execute(begin, end, threadIndex);
+	}
+}
@@ -0,0 +1,80 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_THREAD_POOL_H
+#define CB2_THREAD_POOL_H
+
+#include <CinderBox2D/Common/cb2Settings.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/// A unit of work that can be split into independent ranges of items.
+/// Implementations must not touch data owned by other items.
+class cb2Task
+{
+public:
+	virtual ~cb2Task() {}
+
+	/// Run the items [begin, end). threadIndex is in [0, thread count)
+	/// and is zero for the thread that called cb2ThreadPool::ParallelFor.
+	virtual void Execute(int begin, int end, int threadIndex) = 0;
+};
+
+/// A fixed set of worker threads used to run tasks in parallel. The calling
+/// thread takes part in every task, so a pool of one thread has no workers.
+class cb2ThreadPool
+{
+public:
+	cb2ThreadPool(int threadCount);
+	~cb2ThreadPool();
+
+	/// Get the number of threads, including the calling thread.
+	int GetThreadCount() const { return m_threadCount; }
+
+	/// Run the items [0, count) of a task in ranges of grainSize items and
+	/// wait for all of them to finish. This must not be called from inside a task.
+	void ParallelFor(cb2Task* task, int count, int grainSize);
+
+	/// Get the index of the current thread in this pool. Threads that are not
+	/// workers of this pool get zero, like the caller of ParallelFor.
+	int GetThreadIndex() const;
+
+private:
+
+	void WorkerMain(int threadIndex);
+	void Run(int threadIndex);
+
+	int m_threadCount;
+	std::thread* m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	unsigned int m_generation;
+	int m_busyCount;
+	bool m_quit;
+
+	cb2Task* m_task;
+	int m_count;
+	int m_grainSize;
+	std::atomic<int> m_next;
+};
+
+#endif
@@ -18,84 +18,33 @@
 
 #include <CinderBox2D/Common/cb2Timer.h>
 
-#if defined(_WIN32)
+#if defined(CB2_TIMER_RDTSC)
 
-double cb2Timer::s_invFrequency = 0.0f;
-
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-
-cb2Timer::cb2Timer()
+double cb2Timer::ComputeTickMilliseconds()
 {
-	LARGE_INTEGER largeInteger;
-
-	if (s_invFrequency == 0.0f)
+	// Count the cycles of a few milliseconds of the steady clock.
+	typedef std::chrono::steady_clock clock;
+	clock::time_point start = clock::now();
+	long long startTicks = GetTicks();
+	clock::time_point end = start;
+	while (end - start < std::chrono::milliseconds(2))
 	{
-		QueryPerformanceFrequency(&largeInteger);
-		s_invFrequency = double(largeInteger.QuadPart);
-		if (s_invFrequency > 0.0f)
-		{
-			s_invFrequency = 1000.0f / s_invFrequency;
-		}
+		end = clock::now();
 	}
+	long long ticks = GetTicks() - startTicks;
 
-	QueryPerformanceCounter(&largeInteger);
-	m_start = double(largeInteger.QuadPart);
-}
-
-void cb2Timer::Reset()
-{
-	LARGE_INTEGER largeInteger;
-	QueryPerformanceCounter(&largeInteger);
-	m_start = double(largeInteger.QuadPart);
-}
-
-float cb2Timer::GetMilliseconds() const
-{
-	LARGE_INTEGER largeInteger;
-	QueryPerformanceCounter(&largeInteger);
-	double count = double(largeInteger.QuadPart);
-	float ms = float(s_invFrequency * (count - m_start));
-	return ms;
-}
-
-#elif defined(__linux__) || defined (__APPLE__)
-
-#include <sys/time.h>
-
-cb2Timer::cb2Timer()
-{
-    Reset();
-}
-
-void cb2Timer::Reset()
-{
-    timeval t;
-    gettimeofday(&t, 0);
-    m_start_sec = t.tv_sec;
-    m_start_usec = t.tv_usec;
-}
-
-float cb2Timer::GetMilliseconds() const
-{
-    timeval t;
-    gettimeofday(&t, 0);
-    return 1000.0f * (t.tv_sec - m_start_sec) + 0.001f * (t.tv_usec - m_start_usec);
+	double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	return ticks > 0 ? milliseconds / double(ticks) : 0.0;
 }
 
-#else
-
-cb2Timer::cb2Timer()
-{
-}
-
-void cb2Timer::Reset()
-{
-}
+#elif defined(CB2_TIMER_CNTVCT)
 
-float cb2Timer::GetMilliseconds() const
+double cb2Timer::ComputeTickMilliseconds()
 {
-	return 0.0f;
+	// The generic timer reports its own frequency.
+	long long frequency;
+	__asm__ volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+	return frequency > 0 ? 1000.0 / double(frequency) : 0.0;
 }
 
 #endif
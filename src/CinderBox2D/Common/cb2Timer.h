@@ -21,30 +21,90 @@
 
 #include <CinderBox2D/Common/cb2Settings.h>
 
-/// Timer for profiling. This has platform specific code and may
-/// not work on every platform.
+/// Define CB2_NO_PROFILING to compile the timers and profile zones out. Timers
+/// then always read zero, so the profile is empty and the TOI time budget is off.
+/// Define CB2_CYCLE_TIMER to read the cycle counter (rdtsc on x86, cntvct on
+/// ARM64) instead of std::chrono::steady_clock. The rdtsc rate is calibrated
+/// against the steady clock on first use, which takes 2ms, and assumes an
+/// invariant TSC.
+#if defined(CB2_NO_PROFILING)
+
+/// Timer for profiling. Compiled out by CB2_NO_PROFILING.
+class cb2Timer
+{
+public:
+	cb2Timer() {}
+	void Reset() {}
+	float GetMilliseconds() const { return 0.0f; }
+};
+
+#else
+
+#include <chrono>
+
+#if defined(CB2_CYCLE_TIMER) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define CB2_TIMER_RDTSC
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#elif defined(CB2_CYCLE_TIMER) && defined(__aarch64__)
+#define CB2_TIMER_CNTVCT
+#endif
+
+/// Timer for profiling. Reading it is a single counter read, so timers are
+/// cheap enough for the micro phases of a step.
 class cb2Timer
 {
 public:
 
 	/// Constructor
-	cb2Timer();
+	cb2Timer() { Reset(); }
 
 	/// Reset the timer.
-	void Reset();
+	void Reset() { m_start = GetTicks(); }
 
 	/// Get the time since construction or the last reset.
-	float GetMilliseconds() const;
+	float GetMilliseconds() const
+	{
+		return float(double(GetTicks() - m_start) * GetTickMilliseconds());
+	}
 
-private:
+	/// Read the counter of the timer backend.
+	static long long GetTicks()
+	{
+#if defined(CB2_TIMER_RDTSC)
+		return (long long)__rdtsc();
+#elif defined(CB2_TIMER_CNTVCT)
+		long long ticks;
+		__asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+		return ticks;
+#else
+		return (long long)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
 
-#if defined(_WIN32)
-	double m_start;
-	static double s_invFrequency;
-#elif defined(__linux__) || defined (__APPLE__)
-	unsigned long m_start_sec;
-	unsigned long m_start_usec;
+	/// Get the milliseconds per tick of GetTicks.
+	static double GetTickMilliseconds()
+	{
+#if defined(CB2_TIMER_RDTSC) || defined(CB2_TIMER_CNTVCT)
+		static const double tickMilliseconds = ComputeTickMilliseconds();
+		return tickMilliseconds;
+#else
+		typedef std::chrono::steady_clock::period period;
+		return 1000.0 * double(period::num) / double(period::den);
 #endif
+	}
+
+private:
+
+	// Measure the rate of the cycle counter.
+	static double ComputeTickMilliseconds();
+
+	long long m_start;
 };
 
 #endif
+
+#endif
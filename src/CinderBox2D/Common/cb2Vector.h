@@ -0,0 +1,308 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_VECTOR_H
+#define CB2_VECTOR_H
+
+/// The vector and matrix types come from Cinder by default. Define CB2_HEADLESS to use
+/// the built-in types below instead, so the engine builds without Cinder, for servers or
+/// tools that only run the simulation. Every source file then compiles on its own:
+///
+///   c++ -O2 -std=c++11 -pthread -DCB2_HEADLESS -Isrc -c <engine .cpp files>
+///
+/// The built-in types have the members the engine uses, with the layout and the
+/// semantics of their Cinder counterparts, so results are the same with both.
+#if defined(CB2_HEADLESS)
+
+#include <cmath>
+#include <limits>
+
+namespace cinder
+{
+
+template<typename T> struct Vec2
+{
+	T x, y;
+
+	Vec2() : x(0), y(0) {}
+	Vec2(T nx, T ny) : x(nx), y(ny) {}
+
+	void set(T nx, T ny) { x = nx; y = ny; }
+
+	T& operator[](int n) { return (&x)[n]; }
+	const T& operator[](int n) const { return (&x)[n]; }
+
+	Vec2 operator+(const Vec2& rhs) const { return Vec2(x + rhs.x, y + rhs.y); }
+	Vec2 operator-(const Vec2& rhs) const { return Vec2(x - rhs.x, y - rhs.y); }
+	Vec2 operator*(T rhs) const { return Vec2(x * rhs, y * rhs); }
+	Vec2 operator/(T rhs) const { return Vec2(x / rhs, y / rhs); }
+	Vec2 operator-() const { return Vec2(-x, -y); }
+
+	Vec2& operator+=(const Vec2& rhs) { x += rhs.x; y += rhs.y; return *this; }
+	Vec2& operator-=(const Vec2& rhs) { x -= rhs.x; y -= rhs.y; return *this; }
+	Vec2& operator*=(T rhs) { x *= rhs; y *= rhs; return *this; }
+	Vec2& operator/=(T rhs) { x /= rhs; y /= rhs; return *this; }
+
+	bool operator==(const Vec2& rhs) const { return x == rhs.x && y == rhs.y; }
+	bool operator!=(const Vec2& rhs) const { return !(*this == rhs); }
+
+	T dot(const Vec2& rhs) const { return x * rhs.x + y * rhs.y; }
+	T length() const { return std::sqrt(x * x + y * y); }
+	T lengthSquared() const { return x * x + y * y; }
+
+	void normalize()
+	{
+		T invS = T(1) / length();
+		x *= invS;
+		y *= invS;
+	}
+
+	Vec2 normalized() const
+	{
+		T invS = T(1) / length();
+		return Vec2(x * invS, y * invS);
+	}
+
+	static Vec2 zero() { return Vec2(0, 0); }
+};
+
+template<typename T> inline Vec2<T> operator*(T s, const Vec2<T>& v) { return Vec2<T>(s * v.x, s * v.y); }
+
+template<typename T> struct Vec3
+{
+	T x, y, z;
+
+	Vec3() : x(0), y(0), z(0) {}
+	Vec3(T nx, T ny, T nz) : x(nx), y(ny), z(nz) {}
+
+	void set(T nx, T ny, T nz) { x = nx; y = ny; z = nz; }
+
+	T& operator[](int n) { return (&x)[n]; }
+	const T& operator[](int n) const { return (&x)[n]; }
+
+	Vec3 operator+(const Vec3& rhs) const { return Vec3(x + rhs.x, y + rhs.y, z + rhs.z); }
+	Vec3 operator-(const Vec3& rhs) const { return Vec3(x - rhs.x, y - rhs.y, z - rhs.z); }
+	Vec3 operator*(T rhs) const { return Vec3(x * rhs, y * rhs, z * rhs); }
+	Vec3 operator/(T rhs) const { return Vec3(x / rhs, y / rhs, z / rhs); }
+	Vec3 operator-() const { return Vec3(-x, -y, -z); }
+
+	Vec3& operator+=(const Vec3& rhs) { x += rhs.x; y += rhs.y; z += rhs.z; return *this; }
+	Vec3& operator-=(const Vec3& rhs) { x -= rhs.x; y -= rhs.y; z -= rhs.z; return *this; }
+	Vec3& operator*=(T rhs) { x *= rhs; y *= rhs; z *= rhs; return *this; }
+	Vec3& operator/=(T rhs) { x /= rhs; y /= rhs; z /= rhs; return *this; }
+
+	bool operator==(const Vec3& rhs) const { return x == rhs.x && y == rhs.y && z == rhs.z; }
+	bool operator!=(const Vec3& rhs) const { return !(*this == rhs); }
+
+	T dot(const Vec3& rhs) const { return x * rhs.x + y * rhs.y + z * rhs.z; }
+	Vec3 cross(const Vec3& rhs) const { return Vec3(y * rhs.z - rhs.y * z, z * rhs.x - rhs.z * x, x * rhs.y - rhs.x * y); }
+	T length() const { return std::sqrt(x * x + y * y + z * z); }
+	T lengthSquared() const { return x * x + y * y + z * z; }
+
+	static Vec3 zero() { return Vec3(0, 0, 0); }
+};
+
+template<typename T> inline Vec3<T> operator*(T s, const Vec3<T>& v) { return Vec3<T>(s * v.x, s * v.y, s * v.z); }
+
+template<typename T> struct Vec4
+{
+	T x, y, z, w;
+
+	Vec4() : x(0), y(0), z(0), w(0) {}
+	Vec4(T nx, T ny, T nz, T nw) : x(nx), y(ny), z(nz), w(nw) {}
+};
+
+/// Column major 2x2 matrix, mRC is row R and column C.
+template<typename T> struct Matrix22
+{
+	union
+	{
+		T m[4];
+		struct
+		{
+			T m00, m10;
+			T m01, m11;
+		};
+	};
+
+	Matrix22() { setToIdentity(); }
+
+	Matrix22(T d0, T d1, T d2, T d3, bool srcIsRowMajor = false) { set(d0, d1, d2, d3, srcIsRowMajor); }
+
+	Matrix22(const Vec2<T>& vx, const Vec2<T>& vy)
+	{
+		m00 = vx.x; m10 = vx.y;
+		m01 = vy.x; m11 = vy.y;
+	}
+
+	void set(T d0, T d1, T d2, T d3, bool srcIsRowMajor = false)
+	{
+		if (srcIsRowMajor)
+		{
+			m00 = d0; m01 = d1;
+			m10 = d2; m11 = d3;
+		}
+		else
+		{
+			m00 = d0; m10 = d1;
+			m01 = d2; m11 = d3;
+		}
+	}
+
+	Vec2<T> getColumn(int col) const { return Vec2<T>(m[2 * col], m[2 * col + 1]); }
+	void setColumn(int col, const Vec2<T>& v) { m[2 * col] = v.x; m[2 * col + 1] = v.y; }
+
+	void setToNull() { m00 = m10 = m01 = m11 = 0; }
+	void setToIdentity() { m00 = m11 = 1; m10 = m01 = 0; }
+
+	Matrix22 operator+(const Matrix22& rhs) const
+	{
+		return Matrix22(m00 + rhs.m00, m10 + rhs.m10, m01 + rhs.m01, m11 + rhs.m11);
+	}
+
+	Matrix22 operator*(const Matrix22& rhs) const
+	{
+		return Matrix22(m00 * rhs.m00 + m01 * rhs.m10, m10 * rhs.m00 + m11 * rhs.m10,
+						m00 * rhs.m01 + m01 * rhs.m11, m10 * rhs.m01 + m11 * rhs.m11);
+	}
+
+	Vec2<T> operator*(const Vec2<T>& rhs) const
+	{
+		return Vec2<T>(m00 * rhs.x + m01 * rhs.y, m10 * rhs.x + m11 * rhs.y);
+	}
+
+	Matrix22 transposed() const { return Matrix22(m00, m01, m10, m11); }
+
+	/// The zero matrix is returned when the determinant is not above epsilon.
+	Matrix22 inverted(T epsilon = std::numeric_limits<T>::min()) const
+	{
+		Matrix22 inv = zero();
+		T det = m00 * m11 - m01 * m10;
+		if (std::fabs(det) > epsilon)
+		{
+			T invDet = T(1) / det;
+			inv.m00 = m11 * invDet;
+			inv.m10 = -m10 * invDet;
+			inv.m01 = -m01 * invDet;
+			inv.m11 = m00 * invDet;
+		}
+		return inv;
+	}
+
+	static Matrix22 zero() { return Matrix22(0, 0, 0, 0); }
+};
+
+/// Column major 3x3 matrix, mRC is row R and column C.
+template<typename T> struct Matrix33
+{
+	union
+	{
+		T m[9];
+		struct
+		{
+			T m00, m10, m20;
+			T m01, m11, m21;
+			T m02, m12, m22;
+		};
+	};
+
+	Matrix33() { setToIdentity(); }
+
+	Matrix33(T d0, T d1, T d2, T d3, T d4, T d5, T d6, T d7, T d8, bool srcIsRowMajor = false)
+	{
+		set(d0, d1, d2, d3, d4, d5, d6, d7, d8, srcIsRowMajor);
+	}
+
+	Matrix33(const Vec3<T>& vx, const Vec3<T>& vy, const Vec3<T>& vz)
+	{
+		setColumn(0, vx);
+		setColumn(1, vy);
+		setColumn(2, vz);
+	}
+
+	void set(T d0, T d1, T d2, T d3, T d4, T d5, T d6, T d7, T d8, bool srcIsRowMajor = false)
+	{
+		if (srcIsRowMajor)
+		{
+			m00 = d0; m01 = d1; m02 = d2;
+			m10 = d3; m11 = d4; m12 = d5;
+			m20 = d6; m21 = d7; m22 = d8;
+		}
+		else
+		{
+			m00 = d0; m10 = d1; m20 = d2;
+			m01 = d3; m11 = d4; m21 = d5;
+			m02 = d6; m12 = d7; m22 = d8;
+		}
+	}
+
+	Vec3<T> getColumn(int col) const { return Vec3<T>(m[3 * col], m[3 * col + 1], m[3 * col + 2]); }
+	void setColumn(int col, const Vec3<T>& v) { m[3 * col] = v.x; m[3 * col + 1] = v.y; m[3 * col + 2] = v.z; }
+
+	void setToNull()
+	{
+		for (int i = 0; i < 9; ++i)
+		{
+			m[i] = 0;
+		}
+	}
+
+	void setToIdentity()
+	{
+		setToNull();
+		m00 = m11 = m22 = 1;
+	}
+
+	Vec3<T> operator*(const Vec3<T>& rhs) const
+	{
+		return Vec3<T>(m00 * rhs.x + m01 * rhs.y + m02 * rhs.z,
+					   m10 * rhs.x + m11 * rhs.y + m12 * rhs.z,
+					   m20 * rhs.x + m21 * rhs.y + m22 * rhs.z);
+	}
+
+	Matrix33 transposed() const { return Matrix33(m00, m01, m02, m10, m11, m12, m20, m21, m22); }
+
+	static Matrix33 zero() { Matrix33 r; r.setToNull(); return r; }
+};
+
+typedef Vec2<int> Vec2i;
+typedef Vec2<float> Vec2f;
+typedef Vec2<double> Vec2d;
+typedef Vec3<int> Vec3i;
+typedef Vec3<float> Vec3f;
+typedef Vec3<double> Vec3d;
+typedef Vec4<float> Vec4f;
+typedef Vec4<double> Vec4d;
+typedef Matrix22<float> Matrix22f;
+typedef Matrix22<double> Matrix22d;
+typedef Matrix33<float> Matrix33f;
+typedef Matrix33<double> Matrix33d;
+
+}
+
+namespace ci = cinder;
+
+#else
+
+#include <cinder/Vector.h>
+#include <cinder/Matrix22.h>
+#include <cinder/Matrix33.h>
+
+#endif
+
+#endif
@@ -0,0 +1,54 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/Contacts/cb2ChainAndCapsuleContact.h>
+#include <CinderBox2D/Common/cb2BlockAllocator.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
+
+#include <new>
+
+cb2Contact* cb2ChainAndCapsuleContact::Create(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB, cb2BlockAllocator* allocator)
+{
+	void* mem = allocator->Allocate(sizeof(cb2ChainAndCapsuleContact));
+	return new (mem) cb2ChainAndCapsuleContact(fixtureA, indexA, fixtureB, indexB);
+}
+
+void cb2ChainAndCapsuleContact::Destroy(cb2Contact* contact, cb2BlockAllocator* allocator)
+{
+	((cb2ChainAndCapsuleContact*)contact)->~cb2ChainAndCapsuleContact();
+	allocator->Free(contact, sizeof(cb2ChainAndCapsuleContact));
+}
+
+cb2ChainAndCapsuleContact::cb2ChainAndCapsuleContact(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB)
+: cb2Contact(fixtureA, indexA, fixtureB, indexB)
+{
+	m_type = e_chainAndCapsuleContact;
+	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_chain);
+	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_capsule);
+}
+
+void cb2ChainAndCapsuleContact::Evaluate(cb2Manifold* manifold, const cb2Transform& xfA, const cb2Transform& xfB)
+{
+	cb2ChainShape* chain = (cb2ChainShape*)m_fixtureA->GetShape();
+	cb2EdgeShape edge;
+	chain->GetChildEdge(&edge, m_indexA);
+	cb2CollideEdgeAndCapsule(	manifold, &edge, xfA,
+								(cb2CapsuleShape*)m_fixtureB->GetShape(), xfB, m_speculativeDistance);
+}
@@ -39,6 +39,7 @@ void cb2ChainAndCircleContact::Destroy(cb2Contact* contact, cb2BlockAllocator* a
 cb2ChainAndCircleContact::cb2ChainAndCircleContact(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB)
 : cb2Contact(fixtureA, indexA, fixtureB, indexB)
 {
+	m_type = e_chainAndCircleContact;
 	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_chain);
 	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_circle);
 }
@@ -49,5 +50,5 @@ void cb2ChainAndCircleContact::Evaluate(cb2Manifold* manifold, const cb2Transfor
 	cb2EdgeShape edge;
 	chain->GetChildEdge(&edge, m_indexA);
 	cb2CollideEdgeAndCircle(	manifold, &edge, xfA,
-							(cb2CircleShape*)m_fixtureB->GetShape(), xfB);
+							(cb2CircleShape*)m_fixtureB->GetShape(), xfB, m_speculativeDistance);
 }
@@ -20,7 +20,6 @@
 #include <CinderBox2D/Common/cb2BlockAllocator.h>
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
 #include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
-#include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
 
 #include <new>
 
@@ -39,6 +38,7 @@ void cb2ChainAndPolygonContact::Destroy(cb2Contact* contact, cb2BlockAllocator*
 cb2ChainAndPolygonContact::cb2ChainAndPolygonContact(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB)
 : cb2Contact(fixtureA, indexA, fixtureB, indexB)
 {
+	m_type = e_chainAndPolygonContact;
 	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_chain);
 	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_polygon);
 }
@@ -46,8 +46,6 @@ cb2ChainAndPolygonContact::cb2ChainAndPolygonContact(cb2Fixture* fixtureA, int i
 void cb2ChainAndPolygonContact::Evaluate(cb2Manifold* manifold, const cb2Transform& xfA, const cb2Transform& xfB)
 {
 	cb2ChainShape* chain = (cb2ChainShape*)m_fixtureA->GetShape();
-	cb2EdgeShape edge;
-	chain->GetChildEdge(&edge, m_indexA);
-	cb2CollideEdgeAndPolygon(	manifold, &edge, xfA,
-								(cb2PolygonShape*)m_fixtureB->GetShape(), xfB);
+	cb2CollideEdgeAndPolygon(	manifold, chain, m_indexA, xfA,
+								(cb2PolygonShape*)m_fixtureB->GetShape(), xfB, m_speculativeDistance);
 }
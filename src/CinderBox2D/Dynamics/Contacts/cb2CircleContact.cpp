@@ -40,6 +40,7 @@ void cb2CircleContact::Destroy(cb2Contact* contact, cb2BlockAllocator* allocator
 cb2CircleContact::cb2CircleContact(cb2Fixture* fixtureA, cb2Fixture* fixtureB)
 	: cb2Contact(fixtureA, 0, fixtureB, 0)
 {
+	m_type = e_circleContact;
 	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_circle);
 	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_circle);
 }
@@ -48,5 +49,5 @@ void cb2CircleContact::Evaluate(cb2Manifold* manifold, const cb2Transform& xfA,
 {
 	cb2CollideCircles(manifold,
 					(cb2CircleShape*)m_fixtureA->GetShape(), xfA,
-					(cb2CircleShape*)m_fixtureB->GetShape(), xfB);
+					(cb2CircleShape*)m_fixtureB->GetShape(), xfB, m_speculativeDistance);
 }
@@ -0,0 +1,53 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/Contacts/cb2CompoundContact.h>
+#include <CinderBox2D/Common/cb2BlockAllocator.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Collision/Shapes/cb2CompoundShape.h>
+
+#include <new>
+
+cb2Contact* cb2CompoundContact::Create(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB, cb2BlockAllocator* allocator)
+{
+	void* mem = allocator->Allocate(sizeof(cb2CompoundContact));
+	return new (mem) cb2CompoundContact(fixtureA, indexA, fixtureB, indexB);
+}
+
+void cb2CompoundContact::Destroy(cb2Contact* contact, cb2BlockAllocator* allocator)
+{
+	((cb2CompoundContact*)contact)->~cb2CompoundContact();
+	allocator->Free(contact, sizeof(cb2CompoundContact));
+}
+
+cb2CompoundContact::cb2CompoundContact(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB)
+: cb2Contact(fixtureA, indexA, fixtureB, indexB)
+{
+	m_type = e_compoundContact;
+	m_cache.state = cb2PolygonCache::e_empty;
+	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_compound);
+	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_compound);
+}
+
+void cb2CompoundContact::Evaluate(cb2Manifold* manifold, const cb2Transform& xfA, const cb2Transform& xfB)
+{
+	cb2CompoundShape* compoundA = (cb2CompoundShape*)m_fixtureA->GetShape();
+	cb2CompoundShape* compoundB = (cb2CompoundShape*)m_fixtureB->GetShape();
+	cb2CollidePolygons(	manifold, compoundA->GetChild(m_indexA), xfA,
+						compoundB->GetChild(m_indexB), xfB, &m_cache, m_speculativeDistance);
+}
@@ -24,15 +24,33 @@
 #include <CinderBox2D/Dynamics/Contacts/cb2EdgeAndPolygonContact.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2ChainAndCircleContact.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2ChainAndPolygonContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2CapsuleAndCircleContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2CapsuleContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2PolygonAndCapsuleContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2EdgeAndCapsuleContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2ChainAndCapsuleContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2HeightfieldAndCircleContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2HeightfieldAndPolygonContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2HeightfieldAndCapsuleContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2CompoundAndCircleContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2CompoundAndPolygonContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2CompoundAndCapsuleContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2CompoundContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2EdgeAndCompoundContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2ChainAndCompoundContact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2HeightfieldAndCompoundContact.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2ContactSolver.h>
 
 #include <CinderBox2D/Collision/cb2Collision.h>
 #include <CinderBox2D/Collision/cb2TimeOfImpact.h>
 #include <CinderBox2D/Collision/Shapes/cb2Shape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
 #include <CinderBox2D/Common/cb2BlockAllocator.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2ContactEvents.h>
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
 #include <CinderBox2D/Dynamics/cb2World.h>
+#include <CinderBox2D/Dynamics/cb2ContactManager.h>
 
 cb2ContactRegister cb2Contact::s_registers[cb2Shape::e_typeCount][cb2Shape::e_typeCount];
 bool cb2Contact::s_initialized = false;
@@ -46,6 +64,21 @@ void cb2Contact::InitializeRegisters()
 	AddType(cb2EdgeAndPolygonContact::Create, cb2EdgeAndPolygonContact::Destroy, cb2Shape::e_edge, cb2Shape::e_polygon);
 	AddType(cb2ChainAndCircleContact::Create, cb2ChainAndCircleContact::Destroy, cb2Shape::e_chain, cb2Shape::e_circle);
 	AddType(cb2ChainAndPolygonContact::Create, cb2ChainAndPolygonContact::Destroy, cb2Shape::e_chain, cb2Shape::e_polygon);
+	AddType(cb2CapsuleAndCircleContact::Create, cb2CapsuleAndCircleContact::Destroy, cb2Shape::e_capsule, cb2Shape::e_circle);
+	AddType(cb2CapsuleContact::Create, cb2CapsuleContact::Destroy, cb2Shape::e_capsule, cb2Shape::e_capsule);
+	AddType(cb2PolygonAndCapsuleContact::Create, cb2PolygonAndCapsuleContact::Destroy, cb2Shape::e_polygon, cb2Shape::e_capsule);
+	AddType(cb2EdgeAndCapsuleContact::Create, cb2EdgeAndCapsuleContact::Destroy, cb2Shape::e_edge, cb2Shape::e_capsule);
+	AddType(cb2ChainAndCapsuleContact::Create, cb2ChainAndCapsuleContact::Destroy, cb2Shape::e_chain, cb2Shape::e_capsule);
+	AddType(cb2HeightfieldAndCircleContact::Create, cb2HeightfieldAndCircleContact::Destroy, cb2Shape::e_heightfield, cb2Shape::e_circle);
+	AddType(cb2HeightfieldAndPolygonContact::Create, cb2HeightfieldAndPolygonContact::Destroy, cb2Shape::e_heightfield, cb2Shape::e_polygon);
+	AddType(cb2HeightfieldAndCapsuleContact::Create, cb2HeightfieldAndCapsuleContact::Destroy, cb2Shape::e_heightfield, cb2Shape::e_capsule);
+	AddType(cb2CompoundAndCircleContact::Create, cb2CompoundAndCircleContact::Destroy, cb2Shape::e_compound, cb2Shape::e_circle);
+	AddType(cb2CompoundAndPolygonContact::Create, cb2CompoundAndPolygonContact::Destroy, cb2Shape::e_compound, cb2Shape::e_polygon);
+	AddType(cb2CompoundAndCapsuleContact::Create, cb2CompoundAndCapsuleContact::Destroy, cb2Shape::e_compound, cb2Shape::e_capsule);
+	AddType(cb2CompoundContact::Create, cb2CompoundContact::Destroy, cb2Shape::e_compound, cb2Shape::e_compound);
+	AddType(cb2EdgeAndCompoundContact::Create, cb2EdgeAndCompoundContact::Destroy, cb2Shape::e_edge, cb2Shape::e_compound);
+	AddType(cb2ChainAndCompoundContact::Create, cb2ChainAndCompoundContact::Destroy, cb2Shape::e_chain, cb2Shape::e_compound);
+	AddType(cb2HeightfieldAndCompoundContact::Create, cb2HeightfieldAndCompoundContact::Destroy, cb2Shape::e_heightfield, cb2Shape::e_compound);
 }
 
 void cb2Contact::AddType(cb2ContactCreateFcn* createFcn, cb2ContactDestroyFcn* destoryFcn,
@@ -126,6 +159,10 @@ void cb2Contact::Destroy(cb2Contact* contact, cb2BlockAllocator* allocator)
 cb2Contact::cb2Contact(cb2Fixture* fA, int indexA, cb2Fixture* fB, int indexB)
 {
 	m_flags = e_enabledFlag;
+	if (fA->m_reportPostSolve || fB->m_reportPostSolve)
+	{
+		m_flags |= e_postSolveFlag;
+	}
 
 	m_fixtureA = fA;
 	m_fixtureB = fB;
@@ -136,8 +173,12 @@ cb2Contact::cb2Contact(cb2Fixture* fA, int indexA, cb2Fixture* fB, int indexB)
 	m_manifold.pointCount = 0;
 
 	m_prev = NULL;
+	m_arrayIndex = -1;
+	m_awakeIndex = -1;
 	m_next = NULL;
 
+	m_islandLink = NULL;
+
 	m_nodeA.contact = NULL;
 	m_nodeA.prev = NULL;
 	m_nodeA.next = NULL;
@@ -149,11 +190,41 @@ cb2Contact::cb2Contact(cb2Fixture* fA, int indexA, cb2Fixture* fB, int indexB)
 	m_nodeB.other = NULL;
 
 	m_toiCount = 0;
+	m_toiKey = 0;
+	m_simplexCache.count = 0;
+	m_speculativeDistance = 0.0f;
 
-	m_friction = cb2MixFriction(m_fixtureA->m_friction, m_fixtureB->m_friction);
-	m_restitution = cb2MixRestitution(m_fixtureA->m_restitution, m_fixtureB->m_restitution);
+	UpdateMaterial();
+}
 
-	m_tangentSpeed = 0.0f;
+cb2MaterialPair cb2Contact::MixMaterials() const
+{
+	// A fixture without a material uses its own values.
+	int materialA = m_fixtureA->m_material;
+	int materialB = m_fixtureB->m_material;
+	const cb2MaterialTable* materials = materialA >= 0 || materialB >= 0 ? m_fixtureA->m_body->m_world->m_materials : NULL;
+	if (materials && materialA >= 0 && materialB >= 0)
+	{
+		return materials->GetPair(materialA, materialB);
+	}
+
+	cb2MaterialPair pair;
+	float frictionA = materials && materialA >= 0 ? materials->GetFriction(materialA) : m_fixtureA->m_friction;
+	float frictionB = materials && materialB >= 0 ? materials->GetFriction(materialB) : m_fixtureB->m_friction;
+	float restitutionA = materials && materialA >= 0 ? materials->GetRestitution(materialA) : m_fixtureA->m_restitution;
+	float restitutionB = materials && materialB >= 0 ? materials->GetRestitution(materialB) : m_fixtureB->m_restitution;
+	pair.friction = cb2MixFriction(frictionA, frictionB);
+	pair.restitution = cb2MixRestitution(restitutionA, restitutionB);
+	pair.tangentSpeed = 0.0f;
+	return pair;
+}
+
+void cb2Contact::UpdateMaterial()
+{
+	cb2MaterialPair pair = MixMaterials();
+	m_friction = pair.friction;
+	m_restitution = pair.restitution;
+	m_tangentSpeed = pair.tangentSpeed;
 }
 
 // Update the contact manifold and touching status.
@@ -161,12 +232,44 @@ cb2Contact::cb2Contact(cb2Fixture* fA, int indexA, cb2Fixture* fB, int indexB)
 void cb2Contact::Update(cb2ContactListener* listener)
 {
 	cb2Manifold oldManifold = m_manifold;
+	bool wasTouching = (m_flags & e_touchingFlag) == e_touchingFlag;
+
+	UpdateManifold(oldManifold);
+	ReportUpdate(listener, oldManifold, wasTouching);
+}
+
+inline void cb2Contact::MatchImpulses(const cb2Manifold& oldManifold)
+{
+	// Match old contact ids to new contact ids and copy the
+	// stored impulses to warm start the solver.
+	for (int i = 0; i < m_manifold.pointCount; ++i)
+	{
+		cb2ManifoldPoint* mp2 = m_manifold.points + i;
+		mp2->normalImpulse = 0.0f;
+		mp2->tangentImpulse = 0.0f;
+		cb2ContactID id2 = mp2->id;
+
+		for (int j = 0; j < oldManifold.pointCount; ++j)
+		{
+			const cb2ManifoldPoint* mp1 = oldManifold.points + j;
+
+			if (mp1->id.key == id2.key)
+			{
+				mp2->normalImpulse = mp1->normalImpulse;
+				mp2->tangentImpulse = mp1->tangentImpulse;
+				break;
+			}
+		}
+	}
+}
 
+template <typename T>
+inline void cb2Contact::UpdateManifold(const cb2Manifold& oldManifold)
+{
 	// Re-enable this contact.
 	m_flags |= e_enabledFlag;
 
 	bool touching = false;
-	bool wasTouching = (m_flags & e_touchingFlag) == e_touchingFlag;
 
 	bool sensorA = m_fixtureA->IsSensor();
 	bool sensorB = m_fixtureB->IsSensor();
@@ -182,52 +285,446 @@ void cb2Contact::Update(cb2ContactListener* listener)
 	{
 		const cb2Shape* shapeA = m_fixtureA->GetShape();
 		const cb2Shape* shapeB = m_fixtureB->GetShape();
-		touching = cb2TestOverlap(shapeA, m_indexA, shapeB, m_indexB, xfA, xfB);
+		touching = cb2TestOverlap(shapeA, m_indexA, shapeB, m_indexB, xfA, xfB, &m_simplexCache);
 
 		// Sensors don't generate manifolds.
 		m_manifold.pointCount = 0;
 	}
 	else
 	{
-		Evaluate(&m_manifold, xfA, xfB);
+		((T*)this)->Evaluate(&m_manifold, xfA, xfB);
 		touching = m_manifold.pointCount > 0;
+		MatchImpulses(oldManifold);
+	}
+
+	if (touching)
+	{
+		m_flags |= e_touchingFlag;
+	}
+	else
+	{
+		m_flags &= ~e_touchingFlag;
+	}
+}
+
+void cb2Contact::FinishManifold(const cb2Manifold& oldManifold)
+{
+	m_flags |= e_enabledFlag;
+	MatchImpulses(oldManifold);
+
+	if (m_manifold.pointCount > 0)
+	{
+		m_flags |= e_touchingFlag;
+	}
+	else
+	{
+		m_flags &= ~e_touchingFlag;
+	}
+}
+
+void cb2Contact::UpdateManifold(const cb2Manifold& oldManifold)
+{
+	switch (m_type)
+	{
+	case e_circleContact:
+		UpdateManifold<cb2CircleContact>(oldManifold);
+		break;
+
+	case e_polygonAndCircleContact:
+		UpdateManifold<cb2PolygonAndCircleContact>(oldManifold);
+		break;
+
+	case e_polygonContact:
+		UpdateManifold<cb2PolygonContact>(oldManifold);
+		break;
+
+	case e_edgeAndCircleContact:
+		UpdateManifold<cb2EdgeAndCircleContact>(oldManifold);
+		break;
+
+	case e_edgeAndPolygonContact:
+		UpdateManifold<cb2EdgeAndPolygonContact>(oldManifold);
+		break;
+
+	case e_chainAndCircleContact:
+		UpdateManifold<cb2ChainAndCircleContact>(oldManifold);
+		break;
+
+	case e_chainAndPolygonContact:
+		UpdateManifold<cb2ChainAndPolygonContact>(oldManifold);
+		break;
+
+	case e_capsuleAndCircleContact:
+		UpdateManifold<cb2CapsuleAndCircleContact>(oldManifold);
+		break;
+
+	case e_capsuleContact:
+		UpdateManifold<cb2CapsuleContact>(oldManifold);
+		break;
+
+	case e_polygonAndCapsuleContact:
+		UpdateManifold<cb2PolygonAndCapsuleContact>(oldManifold);
+		break;
+
+	case e_edgeAndCapsuleContact:
+		UpdateManifold<cb2EdgeAndCapsuleContact>(oldManifold);
+		break;
+
+	case e_chainAndCapsuleContact:
+		UpdateManifold<cb2ChainAndCapsuleContact>(oldManifold);
+		break;
+
+	case e_heightfieldAndCircleContact:
+		UpdateManifold<cb2HeightfieldAndCircleContact>(oldManifold);
+		break;
+
+	case e_heightfieldAndPolygonContact:
+		UpdateManifold<cb2HeightfieldAndPolygonContact>(oldManifold);
+		break;
+
+	case e_heightfieldAndCapsuleContact:
+		UpdateManifold<cb2HeightfieldAndCapsuleContact>(oldManifold);
+		break;
+
+	case e_compoundAndCircleContact:
+		UpdateManifold<cb2CompoundAndCircleContact>(oldManifold);
+		break;
+
+	case e_compoundAndPolygonContact:
+		UpdateManifold<cb2CompoundAndPolygonContact>(oldManifold);
+		break;
+
+	case e_compoundAndCapsuleContact:
+		UpdateManifold<cb2CompoundAndCapsuleContact>(oldManifold);
+		break;
+
+	case e_compoundContact:
+		UpdateManifold<cb2CompoundContact>(oldManifold);
+		break;
+
+	case e_edgeAndCompoundContact:
+		UpdateManifold<cb2EdgeAndCompoundContact>(oldManifold);
+		break;
+
+	case e_chainAndCompoundContact:
+		UpdateManifold<cb2ChainAndCompoundContact>(oldManifold);
+		break;
+
+	case e_heightfieldAndCompoundContact:
+		UpdateManifold<cb2HeightfieldAndCompoundContact>(oldManifold);
+		break;
+
+	default:
+		cb2Assert(false);
+		break;
+	}
+}
+
+void cb2Contact::Evaluate(cb2Manifold* manifold, const cb2Transform& xfA, const cb2Transform& xfB)
+{
+	switch (m_type)
+	{
+	case e_circleContact:
+		((cb2CircleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_polygonAndCircleContact:
+		((cb2PolygonAndCircleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_polygonContact:
+		((cb2PolygonContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_edgeAndCircleContact:
+		((cb2EdgeAndCircleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_edgeAndPolygonContact:
+		((cb2EdgeAndPolygonContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_chainAndCircleContact:
+		((cb2ChainAndCircleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_chainAndPolygonContact:
+		((cb2ChainAndPolygonContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_capsuleAndCircleContact:
+		((cb2CapsuleAndCircleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
 
-		// Match old contact ids to new contact ids and copy the
-		// stored impulses to warm start the solver.
-		for (int i = 0; i < m_manifold.pointCount; ++i)
+	case e_capsuleContact:
+		((cb2CapsuleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_polygonAndCapsuleContact:
+		((cb2PolygonAndCapsuleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_edgeAndCapsuleContact:
+		((cb2EdgeAndCapsuleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_chainAndCapsuleContact:
+		((cb2ChainAndCapsuleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_heightfieldAndCircleContact:
+		((cb2HeightfieldAndCircleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_heightfieldAndPolygonContact:
+		((cb2HeightfieldAndPolygonContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_heightfieldAndCapsuleContact:
+		((cb2HeightfieldAndCapsuleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_compoundAndCircleContact:
+		((cb2CompoundAndCircleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_compoundAndPolygonContact:
+		((cb2CompoundAndPolygonContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_compoundAndCapsuleContact:
+		((cb2CompoundAndCapsuleContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_compoundContact:
+		((cb2CompoundContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_edgeAndCompoundContact:
+		((cb2EdgeAndCompoundContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_chainAndCompoundContact:
+		((cb2ChainAndCompoundContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	case e_heightfieldAndCompoundContact:
+		((cb2HeightfieldAndCompoundContact*)this)->Evaluate(manifold, xfA, xfB);
+		break;
+
+	default:
+		cb2Assert(false);
+		break;
+	}
+}
+
+template <typename T>
+void cb2Contact::UpdateManifolds(cb2ContactUpdate* updates, const int* indices, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		cb2ContactUpdate* update = updates + indices[i];
+		update->contact->UpdateManifold<T>(update->oldManifold);
+	}
+}
+
+// Circle contacts collide inline, this is cb2CollideCircles followed by the
+// general warm start matching for a single point with id zero.
+template <>
+void cb2Contact::UpdateManifolds<cb2CircleContact>(cb2ContactUpdate* updates, const int* indices, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		cb2ContactUpdate* update = updates + indices[i];
+		cb2Contact* c = update->contact;
+
+		if (c->m_fixtureA->IsSensor() || c->m_fixtureB->IsSensor())
 		{
-			cb2ManifoldPoint* mp2 = m_manifold.points + i;
-			mp2->normalImpulse = 0.0f;
-			mp2->tangentImpulse = 0.0f;
-			cb2ContactID id2 = mp2->id;
+			c->UpdateManifold<cb2CircleContact>(update->oldManifold);
+			continue;
+		}
 
-			for (int j = 0; j < oldManifold.pointCount; ++j)
-			{
-				cb2ManifoldPoint* mp1 = oldManifold.points + j;
-
-				if (mp1->id.key == id2.key)
-				{
-					mp2->normalImpulse = mp1->normalImpulse;
-					mp2->tangentImpulse = mp1->tangentImpulse;
-					break;
-				}
-			}
+		const cb2CircleShape* circleA = (const cb2CircleShape*)c->m_fixtureA->GetShape();
+		const cb2CircleShape* circleB = (const cb2CircleShape*)c->m_fixtureB->GetShape();
+		const cb2Transform& xfA = c->m_fixtureA->GetBody()->GetTransform();
+		const cb2Transform& xfB = c->m_fixtureB->GetBody()->GetTransform();
+
+		c->m_flags |= e_enabledFlag;
+
+		cb2Manifold* manifold = &c->m_manifold;
+		ci::Vec2f d = cb2Mul(xfB, circleB->m_p) - cb2Mul(xfA, circleA->m_p);
+		float radius = circleA->m_radius + circleB->m_radius + c->m_speculativeDistance;
+		if (cb2Dot(d, d) > radius * radius)
+		{
+			manifold->pointCount = 0;
+			c->m_flags &= ~e_touchingFlag;
+			continue;
 		}
 
-		if (touching != wasTouching)
+		manifold->type = cb2Manifold::e_circles;
+		manifold->localPoint = circleA->m_p;
+		cb2::setZero(manifold->localNormal);
+		manifold->pointCount = 1;
+
+		cb2ManifoldPoint* mp = manifold->points + 0;
+		mp->localPoint = circleB->m_p;
+		mp->id.key = 0;
+		mp->normalImpulse = 0.0f;
+		mp->tangentImpulse = 0.0f;
+
+		const cb2Manifold& oldManifold = update->oldManifold;
+		for (int j = 0; j < oldManifold.pointCount; ++j)
 		{
-			bodyA->SetAwake(true);
-			bodyB->SetAwake(true);
+			if (oldManifold.points[j].id.key == 0)
+			{
+				mp->normalImpulse = oldManifold.points[j].normalImpulse;
+				mp->tangentImpulse = oldManifold.points[j].tangentImpulse;
+				break;
+			}
 		}
+
+		c->m_flags |= e_touchingFlag;
 	}
+}
 
-	if (touching)
+void cb2Contact::UpdateManifolds(Type type, cb2ContactUpdate* updates, const int* indices, int count)
+{
+	switch (type)
 	{
-		m_flags |= e_touchingFlag;
+	case e_circleContact:
+		UpdateManifolds<cb2CircleContact>(updates, indices, count);
+		break;
+
+	case e_polygonAndCircleContact:
+		UpdateManifolds<cb2PolygonAndCircleContact>(updates, indices, count);
+		break;
+
+	case e_polygonContact:
+		UpdateManifolds<cb2PolygonContact>(updates, indices, count);
+		break;
+
+	case e_edgeAndCircleContact:
+		UpdateManifolds<cb2EdgeAndCircleContact>(updates, indices, count);
+		break;
+
+	case e_edgeAndPolygonContact:
+		UpdateManifolds<cb2EdgeAndPolygonContact>(updates, indices, count);
+		break;
+
+	case e_chainAndCircleContact:
+		UpdateManifolds<cb2ChainAndCircleContact>(updates, indices, count);
+		break;
+
+	case e_chainAndPolygonContact:
+		UpdateManifolds<cb2ChainAndPolygonContact>(updates, indices, count);
+		break;
+
+	case e_capsuleAndCircleContact:
+		UpdateManifolds<cb2CapsuleAndCircleContact>(updates, indices, count);
+		break;
+
+	case e_capsuleContact:
+		UpdateManifolds<cb2CapsuleContact>(updates, indices, count);
+		break;
+
+	case e_polygonAndCapsuleContact:
+		UpdateManifolds<cb2PolygonAndCapsuleContact>(updates, indices, count);
+		break;
+
+	case e_edgeAndCapsuleContact:
+		UpdateManifolds<cb2EdgeAndCapsuleContact>(updates, indices, count);
+		break;
+
+	case e_chainAndCapsuleContact:
+		UpdateManifolds<cb2ChainAndCapsuleContact>(updates, indices, count);
+		break;
+
+	case e_heightfieldAndCircleContact:
+		UpdateManifolds<cb2HeightfieldAndCircleContact>(updates, indices, count);
+		break;
+
+	case e_heightfieldAndPolygonContact:
+		UpdateManifolds<cb2HeightfieldAndPolygonContact>(updates, indices, count);
+		break;
+
+	case e_heightfieldAndCapsuleContact:
+		UpdateManifolds<cb2HeightfieldAndCapsuleContact>(updates, indices, count);
+		break;
+
+	case e_compoundAndCircleContact:
+		UpdateManifolds<cb2CompoundAndCircleContact>(updates, indices, count);
+		break;
+
+	case e_compoundAndPolygonContact:
+		UpdateManifolds<cb2CompoundAndPolygonContact>(updates, indices, count);
+		break;
+
+	case e_compoundAndCapsuleContact:
+		UpdateManifolds<cb2CompoundAndCapsuleContact>(updates, indices, count);
+		break;
+
+	case e_compoundContact:
+		UpdateManifolds<cb2CompoundContact>(updates, indices, count);
+		break;
+
+	case e_edgeAndCompoundContact:
+		UpdateManifolds<cb2EdgeAndCompoundContact>(updates, indices, count);
+		break;
+
+	case e_chainAndCompoundContact:
+		UpdateManifolds<cb2ChainAndCompoundContact>(updates, indices, count);
+		break;
+
+	case e_heightfieldAndCompoundContact:
+		UpdateManifolds<cb2HeightfieldAndCompoundContact>(updates, indices, count);
+		break;
+
+	default:
+		cb2Assert(false);
+		break;
 	}
-	else
+}
+
+void cb2Contact::ReportUpdate(cb2ContactListener* listener, const cb2Manifold& oldManifold, bool wasTouching)
+{
+	bool touching = (m_flags & e_touchingFlag) == e_touchingFlag;
+	bool sensor = m_fixtureA->IsSensor() || m_fixtureB->IsSensor();
+
+	if (sensor == false && touching != wasTouching)
 	{
-		m_flags &= ~e_touchingFlag;
+		m_fixtureA->GetBody()->SetAwake(true);
+		m_fixtureB->GetBody()->SetAwake(true);
+	}
+
+	cb2World* world = m_fixtureA->GetBody()->GetWorld();
+	bool linked = m_islandLink != NULL;
+	if (world->m_persistentIslands && (touching && sensor == false) != linked)
+	{
+		if (linked)
+		{
+			world->m_islandGraph.UnlinkContact(this);
+		}
+		else
+		{
+			world->m_islandGraph.LinkContact(this);
+		}
+	}
+
+	cb2ContactEvents* events = world->m_contactEvents;
+	if (events && touching != wasTouching)
+	{
+		if (touching)
+		{
+			events->AddBegin(this);
+			if (sensor == false)
+			{
+				events->AddHit(this, world->m_hitEventThreshold);
+			}
+		}
+		else
+		{
+			events->AddEnd(this);
+		}
 	}
 
 	if (wasTouching == false && touching == true && listener)
@@ -21,8 +21,10 @@
 
 #include <CinderBox2D/Common/cb2Math.h>
 #include <CinderBox2D/Collision/cb2Collision.h>
+#include <CinderBox2D/Collision/cb2Distance.h>
 #include <CinderBox2D/Collision/Shapes/cb2Shape.h>
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2MaterialTable.h>
 
 class cb2Body;
 class cb2Contact;
@@ -31,6 +33,8 @@ class cb2World;
 class cb2BlockAllocator;
 class cb2StackAllocator;
 class cb2ContactListener;
+struct cb2PersistentIsland;
+struct cb2ContactUpdate;
 
 /// Friction mixing law. The idea is to allow either fixture to drive the restitution to zero.
 /// For example, anything slides on ice.
@@ -71,6 +75,15 @@ struct cb2ContactEdge
 	cb2ContactEdge* next;	///< the next contact edge in the body's contact list
 };
 
+// Links a touching contact into the contact list of its persistent island.
+// See cb2IslandGraph.
+struct cb2ContactIslandLink
+{
+	cb2PersistentIsland* island;
+	cb2Contact* prev;
+	cb2Contact* next;
+};
+
 /// The class manages contact between two shapes. A contact exists for each overlapping
 /// AABB in the broad-phase (except if filtered). Therefore a contact object may exist
 /// that has no contact points.
@@ -122,7 +135,8 @@ public:
 	/// Get the friction.
 	float GetFriction() const;
 
-	/// Reset the friction mixture to the default value.
+	/// Reset the friction mixture to the default value. With materials on both fixtures
+	/// this is the friction of their pair, see cb2World::SetMaterial.
 	void ResetFriction();
 
 	/// Override the default restitution mixture. You can call this in cb2ContactListener::PreSolve.
@@ -141,8 +155,39 @@ public:
 	/// Get the desired tangent speed. In meters per second.
 	float GetTangentSpeed() const;
 
+	/// The shape pair handled by a contact. The order matches the registers.
+	enum Type
+	{
+		e_circleContact,
+		e_polygonAndCircleContact,
+		e_polygonContact,
+		e_edgeAndCircleContact,
+		e_edgeAndPolygonContact,
+		e_chainAndCircleContact,
+		e_chainAndPolygonContact,
+		e_capsuleAndCircleContact,
+		e_capsuleContact,
+		e_polygonAndCapsuleContact,
+		e_edgeAndCapsuleContact,
+		e_chainAndCapsuleContact,
+		e_heightfieldAndCircleContact,
+		e_heightfieldAndPolygonContact,
+		e_heightfieldAndCapsuleContact,
+		e_compoundAndCircleContact,
+		e_compoundAndPolygonContact,
+		e_compoundAndCapsuleContact,
+		e_compoundContact,
+		e_edgeAndCompoundContact,
+		e_chainAndCompoundContact,
+		e_heightfieldAndCompoundContact,
+		e_contactTypeCount
+	};
+
+	/// Get the shape pair type of this contact.
+	Type GetType() const;
+
 	/// Evaluate this contact with your own manifold and transforms.
-	virtual void Evaluate(cb2Manifold* manifold, const cb2Transform& xfA, const cb2Transform& xfB) = 0;
+	void Evaluate(cb2Manifold* manifold, const cb2Transform& xfA, const cb2Transform& xfB);
 
 protected:
 	friend class cb2ContactManager;
@@ -150,6 +195,9 @@ protected:
 	friend class cb2ContactSolver;
 	friend class cb2Body;
 	friend class cb2Fixture;
+	friend class cb2TOIScheduler;
+	friend class cb2Island;
+	friend class cb2IslandGraph;
 
 	// Flags stored in m_flags
 	enum
@@ -170,12 +218,24 @@ protected:
 		e_bulletHitFlag		= 0x0010,
 
 		// This contact has a valid TOI in m_toi
-		e_toiFlag			= 0x0020
+		e_toiFlag			= 0x0020,
+
+		// Contact reduction left this contact out of the solver this step
+		e_reducedFlag		= 0x0040,
+
+		// A fixture of this contact wants PostSolve, see cb2Fixture::SetReportPostSolve
+		e_postSolveFlag		= 0x0080
 	};
 
 	/// Flag this contact for filtering. Filtering will occur the next time step.
 	void FlagForFiltering();
 
+	/// Get the surface of the fixtures, from the material table if both have a material.
+	cb2MaterialPair MixMaterials() const;
+
+	/// Reset the friction, restitution and tangent speed from the fixtures.
+	void UpdateMaterial();
+
 	static void AddType(cb2ContactCreateFcn* createFcn, cb2ContactDestroyFcn* destroyFcn,
 						cb2Shape::Type typeA, cb2Shape::Type typeB);
 	static void InitializeRegisters();
@@ -185,19 +245,56 @@ protected:
 
 	cb2Contact() : m_fixtureA(NULL), m_fixtureB(NULL) {}
 	cb2Contact(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB);
-	virtual ~cb2Contact() {}
+	~cb2Contact() {}
 
 	void Update(cb2ContactListener* listener);
 
+	// Update split in two for the parallel collide. UpdateManifold only writes
+	// to this contact, ReportUpdate wakes the bodies and calls the listener.
+	void UpdateManifold(const cb2Manifold& oldManifold);
+	void ReportUpdate(cb2ContactListener* listener, const cb2Manifold& oldManifold, bool wasTouching);
+
+	// Warm start the points of a manifold computed elsewhere from the old manifold
+	// and set the touching state, as UpdateManifold does after Evaluate.
+	void FinishManifold(const cb2Manifold& oldManifold);
+
+	// Copy the impulses of the old points to the new points with the same id.
+	void MatchImpulses(const cb2Manifold& oldManifold);
+
+	// UpdateManifold for a known contact class T, so Evaluate is a direct call.
+	template <typename T>
+	void UpdateManifold(const cb2Manifold& oldManifold);
+
+	// Update the manifolds of the buffered contacts updates[indices[i]], which all have the given type.
+	static void UpdateManifolds(Type type, cb2ContactUpdate* updates, const int* indices, int count);
+
+	template <typename T>
+	static void UpdateManifolds(cb2ContactUpdate* updates, const int* indices, int count);
+
 	static cb2ContactRegister s_registers[cb2Shape::e_typeCount][cb2Shape::e_typeCount];
 	static bool s_initialized;
 
-	unsigned int m_flags;
+	// The persistent island this contact links, or NULL.
+	cb2PersistentIsland* GetPersistentIsland() const { return m_islandLink ? m_islandLink->island : NULL; }
+
+	// The members are ordered by size so there is no padding. There are many contacts
+	// and each one is one block of the allocator, so a few bytes move a contact down
+	// a block size.
+	unsigned short m_flags;
+	unsigned char m_type;
+	unsigned char m_toiCount;
+
+	// Index in the contiguous contact array of the contact manager.
+	int m_arrayIndex;
 
 	// World pool and list pointers.
 	cb2Contact* m_prev;
 	cb2Contact* m_next;
 
+	// Set while the contact is touching and links a persistent island. The links
+	// are rarely used, so they are kept out of the contact.
+	cb2ContactIslandLink* m_islandLink;
+
 	// Nodes for connecting bodies.
 	cb2ContactEdge m_nodeA;
 	cb2ContactEdge m_nodeB;
@@ -205,20 +302,36 @@ protected:
 	cb2Fixture* m_fixtureA;
 	cb2Fixture* m_fixtureB;
 
+	// Index in the awake contacts of the contact manager, or -1.
+	int m_awakeIndex;
+
 	int m_indexA;
 	int m_indexB;
 
 	cb2Manifold m_manifold;
 
-	int m_toiCount;
 	float m_toi;
 
+	// Position of this contact in the TOI scan, used to break ties between equal TOIs.
+	int m_toiKey;
+
+	// GJK simplex of the last sensor overlap test or time of impact, kept between steps.
+	cb2SimplexCache m_simplexCache;
+
+	// Manifold points are kept up to this far apart when speculative contacts are enabled.
+	float m_speculativeDistance;
+
 	float m_friction;
 	float m_restitution;
 
 	float m_tangentSpeed;
 };
 
+inline cb2Contact::Type cb2Contact::GetType() const
+{
+	return (Type)m_type;
+}
+
 inline cb2Manifold* cb2Contact::GetManifold()
 {
 	return &m_manifold;
@@ -318,7 +431,7 @@ inline float cb2Contact::GetFriction() const
 
 inline void cb2Contact::ResetFriction()
 {
-	m_friction = cb2MixFriction(m_fixtureA->m_friction, m_fixtureB->m_friction);
+	m_friction = MixMaterials().friction;
 }
 
 inline void cb2Contact::SetRestitution(float restitution)
@@ -333,7 +446,7 @@ inline float cb2Contact::GetRestitution() const
 
 inline void cb2Contact::ResetRestitution()
 {
-	m_restitution = cb2MixRestitution(m_fixtureA->m_restitution, m_fixtureB->m_restitution);
+	m_restitution = MixMaterials().restitution;
 }
 
 inline void cb2Contact::SetTangentSpeed(float speed)
@@ -23,9 +23,13 @@
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
 #include <CinderBox2D/Dynamics/cb2World.h>
 #include <CinderBox2D/Common/cb2StackAllocator.h>
+#include <CinderBox2D/Common/cb2Simd.h>
 
 #define CB2_DEBUG_SOLVER 0
 
+// Constraints that do not fit in these colors are solved one at a time.
+const int cb2_maxSolverColors = 16;
+
 struct cb2ContactPositionConstraint
 {
 	ci::Vec2f localPoints[cb2_maxManifoldPoints];
@@ -41,6 +45,75 @@ struct cb2ContactPositionConstraint
 	int pointCount;
 };
 
+struct cb2WideContactPoint
+{
+	float rAx[cb2_simdWidth], rAy[cb2_simdWidth];
+	float rBx[cb2_simdWidth], rBy[cb2_simdWidth];
+	float normalImpulse[cb2_simdWidth];
+	float tangentImpulse[cb2_simdWidth];
+	float normalMass[cb2_simdWidth];
+	float tangentMass[cb2_simdWidth];
+	float velocityBias[cb2_simdWidth];
+};
+
+// Up to four velocity constraints that share no dynamic body, stored by lane.
+// Unused lanes have zero mass and repeat the bodies of lane zero.
+struct cb2WideContactConstraint
+{
+	cb2WideContactPoint points[cb2_maxManifoldPoints];
+	float normalX[cb2_simdWidth], normalY[cb2_simdWidth];
+	float invMassA[cb2_simdWidth], invIA[cb2_simdWidth];
+	float invMassB[cb2_simdWidth], invIB[cb2_simdWidth];
+	float friction[cb2_simdWidth];
+	float tangentSpeed[cb2_simdWidth];
+	int indexA[cb2_simdWidth];
+	int indexB[cb2_simdWidth];
+	int constraints[cb2_simdWidth];
+	int count;
+};
+
+// The state of a soft contact point that is kept through the substeps.
+struct cb2SoftContactPoint
+{
+	// The anchors in body frames, to track the separation as the bodies move.
+	ci::Vec2f localAnchorA;
+	ci::Vec2f localAnchorB;
+	float separation;
+	float relativeVelocity;
+	float maxNormalImpulse;
+};
+
+// Contact stiffness of the soft step solver, capped at a quarter of the substep rate.
+const float cb2_contactHertz = 30.0f;
+
+// Soft contacts are heavily damped so they do not bounce.
+const float cb2_contactDampingRatio = 10.0f;
+
+// The soft step solver pushes overlapping shapes apart at most this fast, in meters per second.
+const float cb2_contactPushVelocity = 3.0f;
+
+// The coefficients of a damped spring solved implicitly over a time step.
+struct cb2Softness
+{
+	float biasRate;
+	float massScale;
+	float impulseScale;
+};
+
+static cb2Softness cb2MakeSoftness(float hertz, float dampingRatio, float h)
+{
+	float omega = 2.0f * cb2_pi * hertz;
+	float a1 = 2.0f * dampingRatio + h * omega;
+	float a2 = h * omega * a1;
+	float a3 = 1.0f / (1.0f + a2);
+
+	cb2Softness softness;
+	softness.biasRate = omega / a1;
+	softness.massScale = a2 * a3;
+	softness.impulseScale = a3;
+	return softness;
+}
+
 cb2ContactSolver::cb2ContactSolver(cb2ContactSolverDef* def)
 {
 	m_step = def->step;
@@ -74,8 +147,8 @@ cb2ContactSolver::cb2ContactSolver(cb2ContactSolverDef* def)
 		vc->friction = contact->m_friction;
 		vc->restitution = contact->m_restitution;
 		vc->tangentSpeed = contact->m_tangentSpeed;
-		vc->indexA = bodyA->m_islandIndex;
-		vc->indexB = bodyB->m_islandIndex;
+		vc->indexA = bodyA->GetIslandIndex(def->staticBodies, def->staticCount);
+		vc->indexB = bodyB->GetIslandIndex(def->staticBodies, def->staticCount);
 		vc->invMassA = bodyA->m_invMass;
 		vc->invMassB = bodyB->m_invMass;
 		vc->invIA = bodyA->m_invI;
@@ -86,8 +159,8 @@ cb2ContactSolver::cb2ContactSolver(cb2ContactSolverDef* def)
 		cb2::setZero(vc->normalMass);
 
 		cb2ContactPositionConstraint* pc = m_positionConstraints + i;
-		pc->indexA = bodyA->m_islandIndex;
-		pc->indexB = bodyB->m_islandIndex;
+		pc->indexA = vc->indexA;
+		pc->indexB = vc->indexB;
 		pc->invMassA = bodyA->m_invMass;
 		pc->invMassB = bodyB->m_invMass;
 		pc->localCenterA = bodyA->m_sweep.localCenter;
@@ -126,14 +199,218 @@ cb2ContactSolver::cb2ContactSolver(cb2ContactSolverDef* def)
 			pc->localPoints[j] = cp->localPoint;
 		}
 	}
+
+	m_wideConstraints = NULL;
+	m_wideCount = 0;
+	m_overflowConstraints = NULL;
+	m_overflowCount = 0;
+	m_softPoints = NULL;
+	if (m_step.wideContactSolver)
+	{
+		ColorConstraints();
+	}
 }
 
 cb2ContactSolver::~cb2ContactSolver()
 {
+	if (m_softPoints)
+	{
+		m_allocator->Free(m_softPoints);
+	}
+	if (m_wideConstraints)
+	{
+		m_allocator->Free(m_overflowConstraints);
+		m_allocator->Free(m_wideConstraints);
+	}
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
 
+// Greedy graph coloring. Bodies without mass are never written by the solver,
+// so they may appear in several lanes of the same batch.
+void cb2ContactSolver::ColorConstraints()
+{
+	// Each color adds at most one partially filled batch.
+	int wideCapacity = m_count / cb2_simdWidth + cb2_maxSolverColors;
+	m_wideConstraints = (cb2WideContactConstraint*)m_allocator->Allocate(wideCapacity * sizeof(cb2WideContactConstraint));
+	m_overflowConstraints = (int*)m_allocator->Allocate(m_count * sizeof(int));
+
+	int bodyCount = 0;
+	for (int i = 0; i < m_count; ++i)
+	{
+		const cb2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		bodyCount = cb2Max(bodyCount, cb2Max(vc->indexA, vc->indexB) + 1);
+	}
+
+	unsigned int* bodyColors = (unsigned int*)m_allocator->Allocate(bodyCount * sizeof(unsigned int));
+	memset(bodyColors, 0, bodyCount * sizeof(unsigned int));
+	int* colors = (int*)m_allocator->Allocate(m_count * sizeof(int));
+
+	for (int i = 0; i < m_count; ++i)
+	{
+		const cb2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		bool staticA = vc->invMassA == 0.0f && vc->invIA == 0.0f;
+		bool staticB = vc->invMassB == 0.0f && vc->invIB == 0.0f;
+
+		unsigned int used = 0;
+		if (staticA == false)
+		{
+			used |= bodyColors[vc->indexA];
+		}
+		if (staticB == false)
+		{
+			used |= bodyColors[vc->indexB];
+		}
+
+		int color = 0;
+		while (color < cb2_maxSolverColors && (used & (1u << color)))
+		{
+			++color;
+		}
+
+		colors[i] = color;
+		if (color == cb2_maxSolverColors)
+		{
+			m_overflowConstraints[m_overflowCount++] = i;
+			continue;
+		}
+
+		if (staticA == false)
+		{
+			bodyColors[vc->indexA] |= 1u << color;
+		}
+		if (staticB == false)
+		{
+			bodyColors[vc->indexB] |= 1u << color;
+		}
+	}
+
+	// Fill the batches color by color, keeping the constraint order within a color.
+	for (int color = 0; color < cb2_maxSolverColors; ++color)
+	{
+		cb2WideContactConstraint* wc = NULL;
+		for (int i = 0; i < m_count; ++i)
+		{
+			if (colors[i] != color)
+			{
+				continue;
+			}
+
+			if (wc == NULL || wc->count == cb2_simdWidth)
+			{
+				cb2Assert(m_wideCount < wideCapacity);
+				wc = m_wideConstraints + m_wideCount++;
+				wc->count = 0;
+			}
+
+			wc->constraints[wc->count++] = i;
+		}
+	}
+
+	m_allocator->Free(colors);
+	m_allocator->Free(bodyColors);
+}
+
+// Copy the initialized velocity constraints into the batches.
+void cb2ContactSolver::PackWideConstraints()
+{
+	for (int i = 0; i < m_wideCount; ++i)
+	{
+		cb2WideContactConstraint* wc = m_wideConstraints + i;
+		for (int lane = 0; lane < cb2_simdWidth; ++lane)
+		{
+			if (lane >= wc->count)
+			{
+				wc->indexA[lane] = wc->indexA[0];
+				wc->indexB[lane] = wc->indexB[0];
+				wc->normalX[lane] = 0.0f;
+				wc->normalY[lane] = 0.0f;
+				wc->invMassA[lane] = 0.0f;
+				wc->invIA[lane] = 0.0f;
+				wc->invMassB[lane] = 0.0f;
+				wc->invIB[lane] = 0.0f;
+				wc->friction[lane] = 0.0f;
+				wc->tangentSpeed[lane] = 0.0f;
+				for (int j = 0; j < cb2_maxManifoldPoints; ++j)
+				{
+					cb2WideContactPoint* wp = wc->points + j;
+					wp->rAx[lane] = 0.0f;
+					wp->rAy[lane] = 0.0f;
+					wp->rBx[lane] = 0.0f;
+					wp->rBy[lane] = 0.0f;
+					wp->normalImpulse[lane] = 0.0f;
+					wp->tangentImpulse[lane] = 0.0f;
+					wp->normalMass[lane] = 0.0f;
+					wp->tangentMass[lane] = 0.0f;
+					wp->velocityBias[lane] = 0.0f;
+				}
+				continue;
+			}
+
+			const cb2ContactVelocityConstraint* vc = m_velocityConstraints + wc->constraints[lane];
+			wc->indexA[lane] = vc->indexA;
+			wc->indexB[lane] = vc->indexB;
+			wc->normalX[lane] = vc->normal.x;
+			wc->normalY[lane] = vc->normal.y;
+			wc->invMassA[lane] = vc->invMassA;
+			wc->invIA[lane] = vc->invIA;
+			wc->invMassB[lane] = vc->invMassB;
+			wc->invIB[lane] = vc->invIB;
+			wc->friction[lane] = vc->friction;
+			wc->tangentSpeed[lane] = vc->tangentSpeed;
+
+			for (int j = 0; j < cb2_maxManifoldPoints; ++j)
+			{
+				cb2WideContactPoint* wp = wc->points + j;
+				if (j < vc->pointCount)
+				{
+					const cb2VelocityConstraintPoint* vcp = vc->points + j;
+					wp->rAx[lane] = vcp->rA.x;
+					wp->rAy[lane] = vcp->rA.y;
+					wp->rBx[lane] = vcp->rB.x;
+					wp->rBy[lane] = vcp->rB.y;
+					wp->normalImpulse[lane] = vcp->normalImpulse;
+					wp->tangentImpulse[lane] = vcp->tangentImpulse;
+					wp->normalMass[lane] = vcp->normalMass;
+					wp->tangentMass[lane] = vcp->tangentMass;
+					wp->velocityBias[lane] = vcp->velocityBias;
+				}
+				else
+				{
+					// A missing point has no mass, so it never gets an impulse.
+					wp->rAx[lane] = 0.0f;
+					wp->rAy[lane] = 0.0f;
+					wp->rBx[lane] = 0.0f;
+					wp->rBy[lane] = 0.0f;
+					wp->normalImpulse[lane] = 0.0f;
+					wp->tangentImpulse[lane] = 0.0f;
+					wp->normalMass[lane] = 0.0f;
+					wp->tangentMass[lane] = 0.0f;
+					wp->velocityBias[lane] = 0.0f;
+				}
+			}
+		}
+	}
+}
+
+// Copy the accumulated impulses back for StoreImpulses and the post solve report.
+void cb2ContactSolver::UnpackWideConstraints()
+{
+	for (int i = 0; i < m_wideCount; ++i)
+	{
+		const cb2WideContactConstraint* wc = m_wideConstraints + i;
+		for (int lane = 0; lane < wc->count; ++lane)
+		{
+			cb2ContactVelocityConstraint* vc = m_velocityConstraints + wc->constraints[lane];
+			for (int j = 0; j < vc->pointCount; ++j)
+			{
+				vc->points[j].normalImpulse = wc->points[j].normalImpulse[lane];
+				vc->points[j].tangentImpulse = wc->points[j].tangentImpulse[lane];
+			}
+		}
+	}
+}
+
 // Initialize position dependent portions of the velocity constraints.
 void cb2ContactSolver::InitializeVelocityConstraints()
 {
@@ -175,7 +452,26 @@ void cb2ContactSolver::InitializeVelocityConstraints()
 		xfB.p = cB - cb2Mul(xfB.q, localCenterB);
 
 		cb2WorldManifold worldManifold;
-		worldManifold.Initialize(manifold, xfA, radiusA, xfB, radiusB);
+		if (pc->type == cb2Manifold::e_circles)
+		{
+			// Circles have a single point. Same as cb2WorldManifold::Initialize.
+			ci::Vec2f normal(1.0f, 0.0f);
+			ci::Vec2f pointA = cb2Mul(xfA, manifold->localPoint);
+			ci::Vec2f pointB = cb2Mul(xfB, manifold->points[0].localPoint);
+			if (cb2DistanceSquared(pointA, pointB) > cb2_epsilon * cb2_epsilon)
+			{
+				normal = pointB - pointA;
+				normal.normalize();
+			}
+
+			worldManifold.normal = normal;
+			worldManifold.points[0] = 0.5f * ((pointA + radiusA * normal) + (pointB - radiusB * normal));
+			worldManifold.separations[0] = cb2Dot(pointB - pointA, normal) - radiusA - radiusB;
+		}
+		else
+		{
+			worldManifold.Initialize(manifold, xfA, radiusA, xfB, radiusB);
+		}
 
 		vc->normal = worldManifold.normal;
 
@@ -206,7 +502,12 @@ void cb2ContactSolver::InitializeVelocityConstraints()
 			// Setup a velocity bias for restitution.
 			vcp->velocityBias = 0.0f;
 			float vRel = cb2Dot(vc->normal, vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA));
-			if (vRel < -cb2_velocityThreshold)
+			if (m_step.speculativeContacts && worldManifold.separations[j] > 0.0f)
+			{
+				// A speculative point. The shapes may approach by the gap within the step.
+				vcp->velocityBias = -worldManifold.separations[j] * m_step.inv_dt;
+			}
+			else if (vRel < -cb2_velocityThreshold)
 			{
 				vcp->velocityBias = -vc->restitution * vRel;
 			}
@@ -244,6 +545,11 @@ void cb2ContactSolver::InitializeVelocityConstraints()
 			}
 		}
 	}
+
+	if (m_wideConstraints)
+	{
+		PackWideConstraints();
+	}
 }
 
 void cb2ContactSolver::WarmStart()
@@ -286,318 +592,591 @@ void cb2ContactSolver::WarmStart()
 	}
 }
 
-void cb2ContactSolver::SolveVelocityConstraints()
+float cb2ContactSolver::SolveVelocityConstraints()
 {
+	if (m_wideConstraints)
+	{
+		return SolveWideVelocityConstraints();
+	}
+
+	float maxImpulse = 0.0f;
 	for (int i = 0; i < m_count; ++i)
 	{
-		cb2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		maxImpulse = cb2Max(maxImpulse, SolveVelocityConstraint(m_velocityConstraints + i));
+	}
+	return maxImpulse;
+}
 
-		int indexA = vc->indexA;
-		int indexB = vc->indexB;
-		float mA = vc->invMassA;
-		float iA = vc->invIA;
-		float mB = vc->invMassB;
-		float iB = vc->invIB;
-		int pointCount = vc->pointCount;
+// One point kernel, used by circles and other single point manifolds. The
+// operations are the same as the general loop below.
+float cb2ContactSolver::SolvePointVelocityConstraint(cb2ContactVelocityConstraint* vc)
+{
+	int indexA = vc->indexA;
+	int indexB = vc->indexB;
+	float mA = vc->invMassA;
+	float iA = vc->invIA;
+	float mB = vc->invMassB;
+	float iB = vc->invIB;
+	cb2VelocityConstraintPoint* vcp = vc->points + 0;
+
+	ci::Vec2f vA = m_velocities[indexA].v;
+	float wA = m_velocities[indexA].w;
+	ci::Vec2f vB = m_velocities[indexB].v;
+	float wB = m_velocities[indexB].w;
+
+	ci::Vec2f normal = vc->normal;
+	ci::Vec2f tangent = cb2Cross(normal, 1.0f);
+	float maxImpulse;
+
+	// Tangent constraint.
+	{
+		ci::Vec2f dv = vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA);
 
-		ci::Vec2f vA = m_velocities[indexA].v;
-		float wA = m_velocities[indexA].w;
-		ci::Vec2f vB = m_velocities[indexB].v;
-		float wB = m_velocities[indexB].w;
+		float vt = cb2Dot(dv, tangent) - vc->tangentSpeed;
+		float lambda = vcp->tangentMass * (-vt);
 
-		ci::Vec2f normal = vc->normal;
-		ci::Vec2f tangent = cb2Cross(normal, 1.0f);
-		float friction = vc->friction;
+		float maxFriction = vc->friction * vcp->normalImpulse;
+		float newImpulse = cb2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+		lambda = newImpulse - vcp->tangentImpulse;
+		vcp->tangentImpulse = newImpulse;
+		maxImpulse = cb2Abs(lambda);
 
-		cb2Assert(pointCount == 1 || pointCount == 2);
+		ci::Vec2f P = lambda * tangent;
 
-		// Solve tangent constraints first because non-penetration is more important
-		// than friction.
-		for (int j = 0; j < pointCount; ++j)
-		{
-			cb2VelocityConstraintPoint* vcp = vc->points + j;
+		vA -= mA * P;
+		wA -= iA * cb2Cross(vcp->rA, P);
 
-			// Relative velocity at contact
-			ci::Vec2f dv = vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA);
+		vB += mB * P;
+		wB += iB * cb2Cross(vcp->rB, P);
+	}
 
-			// Compute tangent force
-			float vt = cb2Dot(dv, tangent) - vc->tangentSpeed;
-			float lambda = vcp->tangentMass * (-vt);
+	// Normal constraint.
+	{
+		ci::Vec2f dv = vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA);
 
-			// cb2Clamp the accumulated force
-			float maxFriction = friction * vcp->normalImpulse;
-			float newImpulse = cb2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
-			lambda = newImpulse - vcp->tangentImpulse;
-			vcp->tangentImpulse = newImpulse;
+		float vn = cb2Dot(dv, normal);
+		float lambda = -vcp->normalMass * (vn - vcp->velocityBias);
 
-			// Apply contact impulse
-			ci::Vec2f P = lambda * tangent;
+		float newImpulse = cb2Max(vcp->normalImpulse + lambda, 0.0f);
+		lambda = newImpulse - vcp->normalImpulse;
+		vcp->normalImpulse = newImpulse;
+		maxImpulse = cb2Max(maxImpulse, cb2Abs(lambda));
 
-			vA -= mA * P;
-			wA -= iA * cb2Cross(vcp->rA, P);
+		ci::Vec2f P = lambda * normal;
+		vA -= mA * P;
+		wA -= iA * cb2Cross(vcp->rA, P);
 
-			vB += mB * P;
-			wB += iB * cb2Cross(vcp->rB, P);
-		}
+		vB += mB * P;
+		wB += iB * cb2Cross(vcp->rB, P);
+	}
 
-		// Solve normal constraints
-		if (vc->pointCount == 1)
-		{
-			cb2VelocityConstraintPoint* vcp = vc->points + 0;
+	if (mA != 0.0f || iA != 0.0f)
+	{
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+	}
 
-			// Relative velocity at contact
-			ci::Vec2f dv = vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA);
+	if (mB != 0.0f || iB != 0.0f)
+	{
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
 
-			// Compute normal impulse
-			float vn = cb2Dot(dv, normal);
-			float lambda = -vcp->normalMass * (vn - vcp->velocityBias);
+	return maxImpulse;
+}
 
-			// cb2Clamp the accumulated impulse
-			float newImpulse = cb2Max(vcp->normalImpulse + lambda, 0.0f);
-			lambda = newImpulse - vcp->normalImpulse;
-			vcp->normalImpulse = newImpulse;
+float cb2ContactSolver::SolveVelocityConstraint(cb2ContactVelocityConstraint* vc)
+{
+	if (vc->pointCount == 1)
+	{
+		return SolvePointVelocityConstraint(vc);
+	}
 
-			// Apply contact impulse
-			ci::Vec2f P = lambda * normal;
-			vA -= mA * P;
-			wA -= iA * cb2Cross(vcp->rA, P);
+	int indexA = vc->indexA;
+	int indexB = vc->indexB;
+	float mA = vc->invMassA;
+	float iA = vc->invIA;
+	float mB = vc->invMassB;
+	float iB = vc->invIB;
+	int pointCount = vc->pointCount;
+
+	ci::Vec2f vA = m_velocities[indexA].v;
+	float wA = m_velocities[indexA].w;
+	ci::Vec2f vB = m_velocities[indexB].v;
+	float wB = m_velocities[indexB].w;
+
+	ci::Vec2f normal = vc->normal;
+	ci::Vec2f tangent = cb2Cross(normal, 1.0f);
+	float friction = vc->friction;
+
+	cb2Assert(pointCount == 1 || pointCount == 2);
+
+	// The block solver does not track its impulse changes, compare after.
+	float maxImpulse = 0.0f;
+	float oldNormalImpulse[cb2_maxManifoldPoints];
+	for (int j = 0; j < pointCount; ++j)
+	{
+		oldNormalImpulse[j] = vc->points[j].normalImpulse;
+	}
 
-			vB += mB * P;
-			wB += iB * cb2Cross(vcp->rB, P);
-		}
-		else
-		{
-			// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
-			// Build the mini LCP for this contact patch
-			//
-			// vn = A * x + b, vn >= 0, , vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
-			//
-			// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
-			// b = vn0 - velocityBias
-			//
-			// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
-			// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
-			// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
-			// solution that satisfies the problem is chosen.
-			// 
-			// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
-			// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
-			//
-			// Substitute:
-			// 
-			// x = a + d
-			// 
-			// a := old total impulse
-			// x := new total impulse
-			// d := incremental impulse 
-			//
-			// For the current iteration we extend the formula for the incremental impulse
-			// to compute the new total impulse:
-			//
-			// vn = A * d + b
-			//    = A * (x - a) + b
-			//    = A * x + b - A * a
-			//    = A * x + b'
-			// b' = b - A * a;
+	// Solve tangent constraints first because non-penetration is more important
+	// than friction.
+	for (int j = 0; j < pointCount; ++j)
+	{
+		cb2VelocityConstraintPoint* vcp = vc->points + j;
 
-			cb2VelocityConstraintPoint* cp1 = vc->points + 0;
-			cb2VelocityConstraintPoint* cp2 = vc->points + 1;
+		// Relative velocity at contact
+		ci::Vec2f dv = vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA);
 
-			ci::Vec2f a(cp1->normalImpulse, cp2->normalImpulse);
-			cb2Assert(a.x >= 0.0f && a.y >= 0.0f);
+		// Compute tangent force
+		float vt = cb2Dot(dv, tangent) - vc->tangentSpeed;
+		float lambda = vcp->tangentMass * (-vt);
 
-			// Relative velocity at contact
-			ci::Vec2f dv1 = vB + cb2Cross(wB, cp1->rB) - vA - cb2Cross(wA, cp1->rA);
-			ci::Vec2f dv2 = vB + cb2Cross(wB, cp2->rB) - vA - cb2Cross(wA, cp2->rA);
+		// cb2Clamp the accumulated force
+		float maxFriction = friction * vcp->normalImpulse;
+		float newImpulse = cb2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+		lambda = newImpulse - vcp->tangentImpulse;
+		vcp->tangentImpulse = newImpulse;
+		maxImpulse = cb2Max(maxImpulse, cb2Abs(lambda));
+
+		// Apply contact impulse
+		ci::Vec2f P = lambda * tangent;
+
+		vA -= mA * P;
+		wA -= iA * cb2Cross(vcp->rA, P);
+
+		vB += mB * P;
+		wB += iB * cb2Cross(vcp->rB, P);
+	}
+
+	// Solve normal constraints
+	if (vc->pointCount == 1)
+	{
+		cb2VelocityConstraintPoint* vcp = vc->points + 0;
+
+		// Relative velocity at contact
+		ci::Vec2f dv = vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA);
 
-			// Compute normal velocity
-			float vn1 = cb2Dot(dv1, normal);
-			float vn2 = cb2Dot(dv2, normal);
+		// Compute normal impulse
+		float vn = cb2Dot(dv, normal);
+		float lambda = -vcp->normalMass * (vn - vcp->velocityBias);
 
-			ci::Vec2f b;
-			b.x = vn1 - cp1->velocityBias;
-			b.y = vn2 - cp2->velocityBias;
+		// cb2Clamp the accumulated impulse
+		float newImpulse = cb2Max(vcp->normalImpulse + lambda, 0.0f);
+		lambda = newImpulse - vcp->normalImpulse;
+		vcp->normalImpulse = newImpulse;
 
-			// Compute b'
-			b -= cb2Mul(vc->K, a);
+		// Apply contact impulse
+		ci::Vec2f P = lambda * normal;
+		vA -= mA * P;
+		wA -= iA * cb2Cross(vcp->rA, P);
 
-			const float k_errorTol = 1e-3f;
-			CB2_NOT_USED(k_errorTol);
+		vB += mB * P;
+		wB += iB * cb2Cross(vcp->rB, P);
+	}
+	else
+	{
+		// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
+		// Build the mini LCP for this contact patch
+		//
+		// vn = A * x + b, vn >= 0, , vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
+		//
+		// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
+		// b = vn0 - velocityBias
+		//
+		// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
+		// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
+		// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
+		// solution that satisfies the problem is chosen.
+		// 
+		// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
+		// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
+		//
+		// Substitute:
+		// 
+		// x = a + d
+		// 
+		// a := old total impulse
+		// x := new total impulse
+		// d := incremental impulse 
+		//
+		// For the current iteration we extend the formula for the incremental impulse
+		// to compute the new total impulse:
+		//
+		// vn = A * d + b
+		//    = A * (x - a) + b
+		//    = A * x + b - A * a
+		//    = A * x + b'
+		// b' = b - A * a;
+
+		cb2VelocityConstraintPoint* cp1 = vc->points + 0;
+		cb2VelocityConstraintPoint* cp2 = vc->points + 1;
+
+		ci::Vec2f a(cp1->normalImpulse, cp2->normalImpulse);
+		cb2Assert(a.x >= 0.0f && a.y >= 0.0f);
+
+		// Relative velocity at contact
+		ci::Vec2f dv1 = vB + cb2Cross(wB, cp1->rB) - vA - cb2Cross(wA, cp1->rA);
+		ci::Vec2f dv2 = vB + cb2Cross(wB, cp2->rB) - vA - cb2Cross(wA, cp2->rA);
+
+		// Compute normal velocity
+		float vn1 = cb2Dot(dv1, normal);
+		float vn2 = cb2Dot(dv2, normal);
+
+		ci::Vec2f b;
+		b.x = vn1 - cp1->velocityBias;
+		b.y = vn2 - cp2->velocityBias;
+
+		// Compute b'
+		b -= cb2Mul(vc->K, a);
+
+		const float k_errorTol = 1e-3f;
+		CB2_NOT_USED(k_errorTol);
+
+		for (;;)
+		{
+			//
+			// Case 1: vn = 0
+			//
+			// 0 = A * x + b'
+			//
+			// Solve for x:
+			//
+			// x = - inv(A) * b'
+			//
+			ci::Vec2f x = - cb2Mul(vc->normalMass, b);
 
-			for (;;)
+			if (x.x >= 0.0f && x.y >= 0.0f)
 			{
-				//
-				// Case 1: vn = 0
-				//
-				// 0 = A * x + b'
-				//
-				// Solve for x:
-				//
-				// x = - inv(A) * b'
-				//
-				ci::Vec2f x = - cb2Mul(vc->normalMass, b);
-
-				if (x.x >= 0.0f && x.y >= 0.0f)
-				{
-					// Get the incremental impulse
-					ci::Vec2f d = x - a;
+				// Get the incremental impulse
+				ci::Vec2f d = x - a;
 
-					// Apply incremental impulse
-					ci::Vec2f P1 = d.x * normal;
-					ci::Vec2f P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (cb2Cross(cp1->rA, P1) + cb2Cross(cp2->rA, P2));
+				// Apply incremental impulse
+				ci::Vec2f P1 = d.x * normal;
+				ci::Vec2f P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (cb2Cross(cp1->rA, P1) + cb2Cross(cp2->rA, P2));
 
-					vB += mB * (P1 + P2);
-					wB += iB * (cb2Cross(cp1->rB, P1) + cb2Cross(cp2->rB, P2));
+				vB += mB * (P1 + P2);
+				wB += iB * (cb2Cross(cp1->rB, P1) + cb2Cross(cp2->rB, P2));
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
 #if CB2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + cb2Cross(wB, cp1->rB) - vA - cb2Cross(wA, cp1->rA);
-					dv2 = vB + cb2Cross(wB, cp2->rB) - vA - cb2Cross(wA, cp2->rA);
+				// Postconditions
+				dv1 = vB + cb2Cross(wB, cp1->rB) - vA - cb2Cross(wA, cp1->rA);
+				dv2 = vB + cb2Cross(wB, cp2->rB) - vA - cb2Cross(wA, cp2->rA);
 
-					// Compute normal velocity
-					vn1 = cb2Dot(dv1, normal);
-					vn2 = cb2Dot(dv2, normal);
+				// Compute normal velocity
+				vn1 = cb2Dot(dv1, normal);
+				vn2 = cb2Dot(dv2, normal);
 
-					cb2Assert(cb2Abs(vn1 - cp1->velocityBias) < k_errorTol);
-					cb2Assert(cb2Abs(vn2 - cp2->velocityBias) < k_errorTol);
+				cb2Assert(cb2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+				cb2Assert(cb2Abs(vn2 - cp2->velocityBias) < k_errorTol);
 #endif
-					break;
-				}
+				break;
+			}
 
-				//
-				// Case 2: vn1 = 0 and x2 = 0
-				//
-				//   0 = a11 * x1 + a12 * 0 + b1' 
-				// vn2 = a21 * x1 + a22 * 0 + cb2'
-				//
-				x.x = - cp1->normalMass * b.x;
-				x.y = 0.0f;
-				vn1 = 0.0f;
-				vn2 = vc->K.m10 * x.x + b.y;
-
-				if (x.x >= 0.0f && vn2 >= 0.0f)
-				{
-					// Get the incremental impulse
-					ci::Vec2f d = x - a;
+			//
+			// Case 2: vn1 = 0 and x2 = 0
+			//
+			//   0 = a11 * x1 + a12 * 0 + b1' 
+			// vn2 = a21 * x1 + a22 * 0 + cb2'
+			//
+			x.x = - cp1->normalMass * b.x;
+			x.y = 0.0f;
+			vn1 = 0.0f;
+			vn2 = vc->K.m10 * x.x + b.y;
 
-					// Apply incremental impulse
-					ci::Vec2f P1 = d.x * normal;
-					ci::Vec2f P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (cb2Cross(cp1->rA, P1) + cb2Cross(cp2->rA, P2));
+			if (x.x >= 0.0f && vn2 >= 0.0f)
+			{
+				// Get the incremental impulse
+				ci::Vec2f d = x - a;
+
+				// Apply incremental impulse
+				ci::Vec2f P1 = d.x * normal;
+				ci::Vec2f P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (cb2Cross(cp1->rA, P1) + cb2Cross(cp2->rA, P2));
 
-					vB += mB * (P1 + P2);
-					wB += iB * (cb2Cross(cp1->rB, P1) + cb2Cross(cp2->rB, P2));
+				vB += mB * (P1 + P2);
+				wB += iB * (cb2Cross(cp1->rB, P1) + cb2Cross(cp2->rB, P2));
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
 #if CB2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + cb2Cross(wB, cp1->rB) - vA - cb2Cross(wA, cp1->rA);
+				// Postconditions
+				dv1 = vB + cb2Cross(wB, cp1->rB) - vA - cb2Cross(wA, cp1->rA);
 
-					// Compute normal velocity
-					vn1 = cb2Dot(dv1, normal);
+				// Compute normal velocity
+				vn1 = cb2Dot(dv1, normal);
 
-					cb2Assert(cb2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+				cb2Assert(cb2Abs(vn1 - cp1->velocityBias) < k_errorTol);
 #endif
-					break;
-				}
+				break;
+			}
 
 
-				//
-				// Case 3: vn2 = 0 and x1 = 0
-				//
-				// vn1 = a11 * 0 + a12 * x2 + b1' 
-				//   0 = a21 * 0 + a22 * x2 + cb2'
-				//
-				x.x = 0.0f;
-				x.y = - cp2->normalMass * b.y;
-				vn1 = vc->K.m01 * x.y + b.x;
-				vn2 = 0.0f;
+			//
+			// Case 3: vn2 = 0 and x1 = 0
+			//
+			// vn1 = a11 * 0 + a12 * x2 + b1' 
+			//   0 = a21 * 0 + a22 * x2 + cb2'
+			//
+			x.x = 0.0f;
+			x.y = - cp2->normalMass * b.y;
+			vn1 = vc->K.m01 * x.y + b.x;
+			vn2 = 0.0f;
 
-				if (x.y >= 0.0f && vn1 >= 0.0f)
-				{
-					// Resubstitute for the incremental impulse
-					ci::Vec2f d = x - a;
+			if (x.y >= 0.0f && vn1 >= 0.0f)
+			{
+				// Resubstitute for the incremental impulse
+				ci::Vec2f d = x - a;
 
-					// Apply incremental impulse
-					ci::Vec2f P1 = d.x * normal;
-					ci::Vec2f P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (cb2Cross(cp1->rA, P1) + cb2Cross(cp2->rA, P2));
+				// Apply incremental impulse
+				ci::Vec2f P1 = d.x * normal;
+				ci::Vec2f P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (cb2Cross(cp1->rA, P1) + cb2Cross(cp2->rA, P2));
 
-					vB += mB * (P1 + P2);
-					wB += iB * (cb2Cross(cp1->rB, P1) + cb2Cross(cp2->rB, P2));
+				vB += mB * (P1 + P2);
+				wB += iB * (cb2Cross(cp1->rB, P1) + cb2Cross(cp2->rB, P2));
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
 #if CB2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv2 = vB + cb2Cross(wB, cp2->rB) - vA - cb2Cross(wA, cp2->rA);
+				// Postconditions
+				dv2 = vB + cb2Cross(wB, cp2->rB) - vA - cb2Cross(wA, cp2->rA);
 
-					// Compute normal velocity
-					vn2 = cb2Dot(dv2, normal);
+				// Compute normal velocity
+				vn2 = cb2Dot(dv2, normal);
 
-					cb2Assert(cb2Abs(vn2 - cp2->velocityBias) < k_errorTol);
+				cb2Assert(cb2Abs(vn2 - cp2->velocityBias) < k_errorTol);
 #endif
-					break;
-				}
-
-				//
-				// Case 4: x1 = 0 and x2 = 0
-				// 
-				// vn1 = b1
-				// vn2 = cb2;
-				x.x = 0.0f;
-				x.y = 0.0f;
-				vn1 = b.x;
-				vn2 = b.y;
-
-				if (vn1 >= 0.0f && vn2 >= 0.0f )
-				{
-					// Resubstitute for the incremental impulse
-					ci::Vec2f d = x - a;
+				break;
+			}
 
-					// Apply incremental impulse
-					ci::Vec2f P1 = d.x * normal;
-					ci::Vec2f P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (cb2Cross(cp1->rA, P1) + cb2Cross(cp2->rA, P2));
+			//
+			// Case 4: x1 = 0 and x2 = 0
+			// 
+			// vn1 = b1
+			// vn2 = cb2;
+			x.x = 0.0f;
+			x.y = 0.0f;
+			vn1 = b.x;
+			vn2 = b.y;
+
+			if (vn1 >= 0.0f && vn2 >= 0.0f )
+			{
+				// Resubstitute for the incremental impulse
+				ci::Vec2f d = x - a;
 
-					vB += mB * (P1 + P2);
-					wB += iB * (cb2Cross(cp1->rB, P1) + cb2Cross(cp2->rB, P2));
+				// Apply incremental impulse
+				ci::Vec2f P1 = d.x * normal;
+				ci::Vec2f P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (cb2Cross(cp1->rA, P1) + cb2Cross(cp2->rA, P2));
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				vB += mB * (P1 + P2);
+				wB += iB * (cb2Cross(cp1->rB, P1) + cb2Cross(cp2->rB, P2));
 
-					break;
-				}
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-				// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
 				break;
 			}
+
+			// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
+			break;
 		}
+	}
 
+	// Bodies without mass keep their velocity, see SolvePositionConstraint.
+	if (mA != 0.0f || iA != 0.0f)
+	{
 		m_velocities[indexA].v = vA;
 		m_velocities[indexA].w = wA;
+	}
+
+	if (mB != 0.0f || iB != 0.0f)
+	{
 		m_velocities[indexB].v = vB;
 		m_velocities[indexB].w = wB;
 	}
+
+	for (int j = 0; j < pointCount; ++j)
+	{
+		maxImpulse = cb2Max(maxImpulse, cb2Abs(vc->points[j].normalImpulse - oldNormalImpulse[j]));
+	}
+	return maxImpulse;
+}
+
+float cb2ContactSolver::SolveWideVelocityConstraints()
+{
+	cb2FloatW maxImpulseW = cb2ZeroW();
+	for (int i = 0; i < m_wideCount; ++i)
+	{
+		cb2WideContactConstraint* wc = m_wideConstraints + i;
+
+		float bodyData[6][cb2_simdWidth];
+		for (int lane = 0; lane < cb2_simdWidth; ++lane)
+		{
+			const cb2Velocity& velocityA = m_velocities[wc->indexA[lane]];
+			const cb2Velocity& velocityB = m_velocities[wc->indexB[lane]];
+			bodyData[0][lane] = velocityA.v.x;
+			bodyData[1][lane] = velocityA.v.y;
+			bodyData[2][lane] = velocityA.w;
+			bodyData[3][lane] = velocityB.v.x;
+			bodyData[4][lane] = velocityB.v.y;
+			bodyData[5][lane] = velocityB.w;
+		}
+
+		cb2FloatW vAx = cb2LoadW(bodyData[0]);
+		cb2FloatW vAy = cb2LoadW(bodyData[1]);
+		cb2FloatW wA = cb2LoadW(bodyData[2]);
+		cb2FloatW vBx = cb2LoadW(bodyData[3]);
+		cb2FloatW vBy = cb2LoadW(bodyData[4]);
+		cb2FloatW wB = cb2LoadW(bodyData[5]);
+
+		cb2FloatW mA = cb2LoadW(wc->invMassA);
+		cb2FloatW iA = cb2LoadW(wc->invIA);
+		cb2FloatW mB = cb2LoadW(wc->invMassB);
+		cb2FloatW iB = cb2LoadW(wc->invIB);
+
+		// tangent = cb2Cross(normal, 1.0f)
+		cb2FloatW normalX = cb2LoadW(wc->normalX);
+		cb2FloatW normalY = cb2LoadW(wc->normalY);
+		cb2FloatW tangentX = normalY;
+		cb2FloatW tangentY = cb2SubW(cb2ZeroW(), normalX);
+		cb2FloatW friction = cb2LoadW(wc->friction);
+		cb2FloatW tangentSpeed = cb2LoadW(wc->tangentSpeed);
+
+		// Solve tangent constraints first because non-penetration is more important
+		// than friction.
+		for (int j = 0; j < cb2_maxManifoldPoints; ++j)
+		{
+			cb2WideContactPoint* wp = wc->points + j;
+			cb2FloatW rAx = cb2LoadW(wp->rAx);
+			cb2FloatW rAy = cb2LoadW(wp->rAy);
+			cb2FloatW rBx = cb2LoadW(wp->rBx);
+			cb2FloatW rBy = cb2LoadW(wp->rBy);
+
+			// Relative velocity at contact
+			cb2FloatW dvx = cb2SubW(cb2SubW(vBx, cb2MulW(wB, rBy)), cb2SubW(vAx, cb2MulW(wA, rAy)));
+			cb2FloatW dvy = cb2SubW(cb2AddW(vBy, cb2MulW(wB, rBx)), cb2AddW(vAy, cb2MulW(wA, rAx)));
+
+			// Compute tangent force
+			cb2FloatW vt = cb2SubW(cb2AddW(cb2MulW(dvx, tangentX), cb2MulW(dvy, tangentY)), tangentSpeed);
+			cb2FloatW lambda = cb2MulW(cb2LoadW(wp->tangentMass), cb2SubW(cb2ZeroW(), vt));
+
+			// Clamp the accumulated force
+			cb2FloatW maxFriction = cb2MulW(friction, cb2LoadW(wp->normalImpulse));
+			cb2FloatW oldImpulse = cb2LoadW(wp->tangentImpulse);
+			cb2FloatW newImpulse = cb2AddW(oldImpulse, lambda);
+			newImpulse = cb2MaxW(cb2SubW(cb2ZeroW(), maxFriction), cb2MinW(newImpulse, maxFriction));
+			lambda = cb2SubW(newImpulse, oldImpulse);
+			cb2StoreW(wp->tangentImpulse, newImpulse);
+			maxImpulseW = cb2MaxW(maxImpulseW, cb2AbsW(lambda));
+
+			// Apply contact impulse
+			cb2FloatW Px = cb2MulW(lambda, tangentX);
+			cb2FloatW Py = cb2MulW(lambda, tangentY);
+
+			vAx = cb2SubW(vAx, cb2MulW(mA, Px));
+			vAy = cb2SubW(vAy, cb2MulW(mA, Py));
+			wA = cb2SubW(wA, cb2MulW(iA, cb2SubW(cb2MulW(rAx, Py), cb2MulW(rAy, Px))));
+
+			vBx = cb2AddW(vBx, cb2MulW(mB, Px));
+			vBy = cb2AddW(vBy, cb2MulW(mB, Py));
+			wB = cb2AddW(wB, cb2MulW(iB, cb2SubW(cb2MulW(rBx, Py), cb2MulW(rBy, Px))));
+		}
+
+		// Solve normal constraints one point at a time.
+		for (int j = 0; j < cb2_maxManifoldPoints; ++j)
+		{
+			cb2WideContactPoint* wp = wc->points + j;
+			cb2FloatW rAx = cb2LoadW(wp->rAx);
+			cb2FloatW rAy = cb2LoadW(wp->rAy);
+			cb2FloatW rBx = cb2LoadW(wp->rBx);
+			cb2FloatW rBy = cb2LoadW(wp->rBy);
+
+			// Relative velocity at contact
+			cb2FloatW dvx = cb2SubW(cb2SubW(vBx, cb2MulW(wB, rBy)), cb2SubW(vAx, cb2MulW(wA, rAy)));
+			cb2FloatW dvy = cb2SubW(cb2AddW(vBy, cb2MulW(wB, rBx)), cb2AddW(vAy, cb2MulW(wA, rAx)));
+
+			// Compute normal impulse
+			cb2FloatW vn = cb2AddW(cb2MulW(dvx, normalX), cb2MulW(dvy, normalY));
+			cb2FloatW lambda = cb2MulW(cb2LoadW(wp->normalMass), cb2SubW(cb2LoadW(wp->velocityBias), vn));
+
+			// Clamp the accumulated impulse
+			cb2FloatW oldImpulse = cb2LoadW(wp->normalImpulse);
+			cb2FloatW newImpulse = cb2MaxW(cb2AddW(oldImpulse, lambda), cb2ZeroW());
+			lambda = cb2SubW(newImpulse, oldImpulse);
+			cb2StoreW(wp->normalImpulse, newImpulse);
+			maxImpulseW = cb2MaxW(maxImpulseW, cb2AbsW(lambda));
+
+			// Apply contact impulse
+			cb2FloatW Px = cb2MulW(lambda, normalX);
+			cb2FloatW Py = cb2MulW(lambda, normalY);
+
+			vAx = cb2SubW(vAx, cb2MulW(mA, Px));
+			vAy = cb2SubW(vAy, cb2MulW(mA, Py));
+			wA = cb2SubW(wA, cb2MulW(iA, cb2SubW(cb2MulW(rAx, Py), cb2MulW(rAy, Px))));
+
+			vBx = cb2AddW(vBx, cb2MulW(mB, Px));
+			vBy = cb2AddW(vBy, cb2MulW(mB, Py));
+			wB = cb2AddW(wB, cb2MulW(iB, cb2SubW(cb2MulW(rBx, Py), cb2MulW(rBy, Px))));
+		}
+
+		cb2StoreW(bodyData[0], vAx);
+		cb2StoreW(bodyData[1], vAy);
+		cb2StoreW(bodyData[2], wA);
+		cb2StoreW(bodyData[3], vBx);
+		cb2StoreW(bodyData[4], vBy);
+		cb2StoreW(bodyData[5], wB);
+
+		// Lanes are written in order, so a massless body shared by several
+		// lanes ends up with its unchanged velocity.
+		for (int lane = 0; lane < wc->count; ++lane)
+		{
+			cb2Velocity& velocityA = m_velocities[wc->indexA[lane]];
+			cb2Velocity& velocityB = m_velocities[wc->indexB[lane]];
+			velocityA.v.set(bodyData[0][lane], bodyData[1][lane]);
+			velocityA.w = bodyData[2][lane];
+			velocityB.v.set(bodyData[3][lane], bodyData[4][lane]);
+			velocityB.w = bodyData[5][lane];
+		}
+	}
+
+	float lanes[cb2_simdWidth];
+	cb2StoreW(lanes, maxImpulseW);
+	float maxImpulse = 0.0f;
+	for (int lane = 0; lane < cb2_simdWidth; ++lane)
+	{
+		maxImpulse = cb2Max(maxImpulse, lanes[lane]);
+	}
+
+	for (int i = 0; i < m_overflowCount; ++i)
+	{
+		maxImpulse = cb2Max(maxImpulse, SolveVelocityConstraint(m_velocityConstraints + m_overflowConstraints[i]));
+	}
+	return maxImpulse;
 }
 
 void cb2ContactSolver::StoreImpulses()
 {
+	if (m_wideConstraints)
+	{
+		UnpackWideConstraints();
+	}
+
 	for (int i = 0; i < m_count; ++i)
 	{
 		cb2ContactVelocityConstraint* vc = m_velocityConstraints + i;
@@ -669,76 +1248,95 @@ bool cb2ContactSolver::SolvePositionConstraints()
 
 	for (int i = 0; i < m_count; ++i)
 	{
-		cb2ContactPositionConstraint* pc = m_positionConstraints + i;
+		minSeparation = cb2Min(minSeparation, SolvePositionConstraint(i));
+	}
 
-		int indexA = pc->indexA;
-		int indexB = pc->indexB;
-		ci::Vec2f localCenterA = pc->localCenterA;
-		float mA = pc->invMassA;
-		float iA = pc->invIA;
-		ci::Vec2f localCenterB = pc->localCenterB;
-		float mB = pc->invMassB;
-		float iB = pc->invIB;
-		int pointCount = pc->pointCount;
+	// We can't expect minSpeparation >= -cb2_linearSlop because we don't
+	// push the separation above -cb2_linearSlop.
+	return minSeparation >= -3.0f * cb2_linearSlop;
+}
 
-		ci::Vec2f cA = m_positions[indexA].c;
-		float aA = m_positions[indexA].a;
+// Returns the minimum separation, clamped to zero.
+float cb2ContactSolver::SolvePositionConstraint(int index)
+{
+	float minSeparation = 0.0f;
 
-		ci::Vec2f cB = m_positions[indexB].c;
-		float aB = m_positions[indexB].a;
+	cb2ContactPositionConstraint* pc = m_positionConstraints + index;
 
-		// Solve normal constraints
-		for (int j = 0; j < pointCount; ++j)
-		{
-			cb2Transform xfA, xfB;
-			xfA.q.set(aA);
-			xfB.q.set(aB);
-			xfA.p = cA - cb2Mul(xfA.q, localCenterA);
-			xfB.p = cB - cb2Mul(xfB.q, localCenterB);
+	int indexA = pc->indexA;
+	int indexB = pc->indexB;
+	ci::Vec2f localCenterA = pc->localCenterA;
+	float mA = pc->invMassA;
+	float iA = pc->invIA;
+	ci::Vec2f localCenterB = pc->localCenterB;
+	float mB = pc->invMassB;
+	float iB = pc->invIB;
+	int pointCount = pc->pointCount;
 
-			cb2PositionSolverManifold psm;
-			psm.Initialize(pc, xfA, xfB, j);
-			ci::Vec2f normal = psm.normal;
+	ci::Vec2f cA = m_positions[indexA].c;
+	float aA = m_positions[indexA].a;
 
-			ci::Vec2f point = psm.point;
-			float separation = psm.separation;
+	ci::Vec2f cB = m_positions[indexB].c;
+	float aB = m_positions[indexB].a;
 
-			ci::Vec2f rA = point - cA;
-			ci::Vec2f rB = point - cB;
+	// Solve normal constraints
+	for (int j = 0; j < pointCount; ++j)
+	{
+		cb2Transform xfA, xfB;
+		xfA.q.set(aA);
+		xfB.q.set(aB);
+		xfA.p = cA - cb2Mul(xfA.q, localCenterA);
+		xfB.p = cB - cb2Mul(xfB.q, localCenterB);
 
-			// Track max constraint error.
-			minSeparation = cb2Min(minSeparation, separation);
+		cb2PositionSolverManifold psm;
+		psm.Initialize(pc, xfA, xfB, j);
+		ci::Vec2f normal = psm.normal;
 
-			// Prevent large corrections and allow slop.
-			float C = cb2Clamp(cb2_baumgarte * (separation + cb2_linearSlop), -cb2_maxLinearCorrection, 0.0f);
+		ci::Vec2f point = psm.point;
+		float separation = psm.separation;
 
-			// Compute the effective mass.
-			float rnA = cb2Cross(rA, normal);
-			float rnB = cb2Cross(rB, normal);
-			float K = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+		ci::Vec2f rA = point - cA;
+		ci::Vec2f rB = point - cB;
 
-			// Compute normal impulse
-			float impulse = K > 0.0f ? - C / K : 0.0f;
+		// Track max constraint error.
+		minSeparation = cb2Min(minSeparation, separation);
 
-			ci::Vec2f P = impulse * normal;
+		// Prevent large corrections and allow slop.
+		float C = cb2Clamp(cb2_baumgarte * (separation + cb2_linearSlop), -cb2_maxLinearCorrection, 0.0f);
 
-			cA -= mA * P;
-			aA -= iA * cb2Cross(rA, P);
+		// Compute the effective mass.
+		float rnA = cb2Cross(rA, normal);
+		float rnB = cb2Cross(rB, normal);
+		float K = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
 
-			cB += mB * P;
-			aB += iB * cb2Cross(rB, P);
-		}
+		// Compute normal impulse
+		float impulse = K > 0.0f ? - C / K : 0.0f;
+
+		ci::Vec2f P = impulse * normal;
+
+		cA -= mA * P;
+		aA -= iA * cb2Cross(rA, P);
+
+		cB += mB * P;
+		aB += iB * cb2Cross(rB, P);
+	}
 
+	// Bodies without mass don't move. Skipping them lets batches solved
+	// on different threads share them.
+	if (mA != 0.0f || iA != 0.0f)
+	{
 		m_positions[indexA].c = cA;
 		m_positions[indexA].a = aA;
+	}
 
+	if (mB != 0.0f || iB != 0.0f)
+	{
 		m_positions[indexB].c = cB;
 		m_positions[indexB].a = aB;
 	}
 
-	// We can't expect minSpeparation >= -cb2_linearSlop because we don't
-	// push the separation above -cb2_linearSlop.
-	return minSeparation >= -3.0f * cb2_linearSlop;
+	return minSeparation;
+
 }
 
 // Sequential position solver for position constraints.
@@ -831,3 +1429,212 @@ bool cb2ContactSolver::SolveTOIPositionConstraints(int toiIndexA, int toiIndexB)
 	// push the separation above -cb2_linearSlop.
 	return minSeparation >= -1.5f * cb2_linearSlop;
 }
+
+void cb2ContactSolver::PrepareSoftConstraints()
+{
+	cb2Assert(m_wideConstraints == NULL);
+	m_softPoints = (cb2SoftContactPoint*)m_allocator->Allocate(m_count * cb2_maxManifoldPoints * sizeof(cb2SoftContactPoint));
+
+	for (int i = 0; i < m_count; ++i)
+	{
+		cb2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		cb2ContactPositionConstraint* pc = m_positionConstraints + i;
+
+		int indexA = vc->indexA;
+		int indexB = vc->indexB;
+
+		ci::Vec2f cA = m_positions[indexA].c;
+		float aA = m_positions[indexA].a;
+		ci::Vec2f vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+
+		ci::Vec2f cB = m_positions[indexB].c;
+		float aB = m_positions[indexB].a;
+		ci::Vec2f vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		cb2Transform xfA, xfB;
+		xfA.q.set(aA);
+		xfB.q.set(aB);
+		xfA.p = cA - cb2Mul(xfA.q, pc->localCenterA);
+		xfB.p = cB - cb2Mul(xfB.q, pc->localCenterB);
+
+		for (int j = 0; j < vc->pointCount; ++j)
+		{
+			cb2VelocityConstraintPoint* vcp = vc->points + j;
+			cb2SoftContactPoint* sp = m_softPoints + i * cb2_maxManifoldPoints + j;
+
+			cb2PositionSolverManifold psm;
+			psm.Initialize(pc, xfA, xfB, j);
+
+			sp->localAnchorA = cb2MulT(xfA.q, vcp->rA);
+			sp->localAnchorB = cb2MulT(xfB.q, vcp->rB);
+			sp->separation = psm.separation;
+			sp->relativeVelocity = cb2Dot(vc->normal, vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA));
+			sp->maxNormalImpulse = 0.0f;
+		}
+	}
+}
+
+// Sequential impulses on soft contacts. The normal and the anchors of the velocity
+// constraints stay fixed for the step; only the separation follows the bodies.
+void cb2ContactSolver::SolveSoftVelocityConstraints(bool useBias)
+{
+	float h = m_step.dt;
+	float inv_h = m_step.inv_dt;
+	float contactHertz = cb2Min(cb2_contactHertz, 0.25f * inv_h);
+	cb2Softness softness = cb2MakeSoftness(contactHertz, cb2_contactDampingRatio, h);
+
+	// Contacts with a static body have nothing else to give way, so they are stiffer.
+	cb2Softness staticSoftness = cb2MakeSoftness(2.0f * contactHertz, cb2_contactDampingRatio, h);
+
+	for (int i = 0; i < m_count; ++i)
+	{
+		cb2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+
+		int indexA = vc->indexA;
+		int indexB = vc->indexB;
+		float mA = vc->invMassA;
+		float iA = vc->invIA;
+		float mB = vc->invMassB;
+		float iB = vc->invIB;
+		int pointCount = vc->pointCount;
+
+		ci::Vec2f vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+		ci::Vec2f vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		ci::Vec2f cA = m_positions[indexA].c;
+		cb2Rot qA(m_positions[indexA].a);
+		ci::Vec2f cB = m_positions[indexB].c;
+		cb2Rot qB(m_positions[indexB].a);
+
+		ci::Vec2f normal = vc->normal;
+		ci::Vec2f tangent = cb2Cross(normal, 1.0f);
+		const cb2Softness& soft = (mA == 0.0f || mB == 0.0f) ? staticSoftness : softness;
+
+		for (int j = 0; j < pointCount; ++j)
+		{
+			cb2VelocityConstraintPoint* vcp = vc->points + j;
+			cb2SoftContactPoint* sp = m_softPoints + i * cb2_maxManifoldPoints + j;
+
+			// The current separation.
+			ci::Vec2f d = (cB + cb2Mul(qB, sp->localAnchorB)) - (cA + cb2Mul(qA, sp->localAnchorA));
+			float s = cb2Dot(d, normal) + sp->separation;
+
+			float bias = 0.0f;
+			float massScale = 1.0f;
+			float impulseScale = 0.0f;
+			if (s > 0.0f)
+			{
+				// Speculative: the shapes may approach by the gap.
+				bias = s * inv_h;
+			}
+			else if (useBias)
+			{
+				bias = cb2Max(soft.biasRate * s, -cb2_contactPushVelocity);
+				massScale = soft.massScale;
+				impulseScale = soft.impulseScale;
+			}
+
+			ci::Vec2f dv = vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA);
+			float vn = cb2Dot(dv, normal);
+
+			float impulse = -vcp->normalMass * massScale * (vn + bias) - impulseScale * vcp->normalImpulse;
+			float newImpulse = cb2Max(vcp->normalImpulse + impulse, 0.0f);
+			impulse = newImpulse - vcp->normalImpulse;
+			vcp->normalImpulse = newImpulse;
+			sp->maxNormalImpulse = cb2Max(sp->maxNormalImpulse, impulse);
+
+			ci::Vec2f P = impulse * normal;
+			vA -= mA * P;
+			wA -= iA * cb2Cross(vcp->rA, P);
+			vB += mB * P;
+			wB += iB * cb2Cross(vcp->rB, P);
+		}
+
+		// Friction uses the normal impulses of this pass.
+		for (int j = 0; j < pointCount; ++j)
+		{
+			cb2VelocityConstraintPoint* vcp = vc->points + j;
+
+			ci::Vec2f dv = vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA);
+			float vt = cb2Dot(dv, tangent) - vc->tangentSpeed;
+
+			float lambda = vcp->tangentMass * (-vt);
+			float maxFriction = vc->friction * vcp->normalImpulse;
+			float newImpulse = cb2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+			lambda = newImpulse - vcp->tangentImpulse;
+			vcp->tangentImpulse = newImpulse;
+
+			ci::Vec2f P = lambda * tangent;
+			vA -= mA * P;
+			wA -= iA * cb2Cross(vcp->rA, P);
+			vB += mB * P;
+			wB += iB * cb2Cross(vcp->rB, P);
+		}
+
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
+}
+
+// Restitution after the substeps, on the relative velocity from before the step.
+// Points that never pushed are skipped, they did not collide.
+void cb2ContactSolver::ApplySoftRestitution()
+{
+	for (int i = 0; i < m_count; ++i)
+	{
+		cb2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		if (vc->restitution == 0.0f)
+		{
+			continue;
+		}
+
+		int indexA = vc->indexA;
+		int indexB = vc->indexB;
+		float mA = vc->invMassA;
+		float iA = vc->invIA;
+		float mB = vc->invMassB;
+		float iB = vc->invIB;
+
+		ci::Vec2f vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+		ci::Vec2f vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		ci::Vec2f normal = vc->normal;
+
+		for (int j = 0; j < vc->pointCount; ++j)
+		{
+			cb2VelocityConstraintPoint* vcp = vc->points + j;
+			cb2SoftContactPoint* sp = m_softPoints + i * cb2_maxManifoldPoints + j;
+			if (sp->relativeVelocity > -cb2_velocityThreshold || sp->maxNormalImpulse == 0.0f)
+			{
+				continue;
+			}
+
+			ci::Vec2f dv = vB + cb2Cross(wB, vcp->rB) - vA - cb2Cross(wA, vcp->rA);
+			float vn = cb2Dot(dv, normal);
+
+			float impulse = -vcp->normalMass * (vn + vc->restitution * sp->relativeVelocity);
+			float newImpulse = cb2Max(vcp->normalImpulse + impulse, 0.0f);
+			impulse = newImpulse - vcp->normalImpulse;
+			vcp->normalImpulse = newImpulse;
+
+			ci::Vec2f P = impulse * normal;
+			vA -= mA * P;
+			wA -= iA * cb2Cross(vcp->rA, P);
+			vB += mB * P;
+			wB += iB * cb2Cross(vcp->rB, P);
+		}
+
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
+}
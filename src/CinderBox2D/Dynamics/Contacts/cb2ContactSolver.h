@@ -27,6 +27,8 @@ class cb2Contact;
 class cb2Body;
 class cb2StackAllocator;
 struct cb2ContactPositionConstraint;
+struct cb2WideContactConstraint;
+struct cb2SoftContactPoint;
 
 struct cb2VelocityConstraintPoint
 {
@@ -63,6 +65,8 @@ struct cb2ContactSolverDef
 	int count;
 	cb2Position* positions;
 	cb2Velocity* velocities;
+	cb2Body** staticBodies;
+	int staticCount;
 	cb2StackAllocator* allocator;
 };
 
@@ -75,12 +79,34 @@ public:
 	void InitializeVelocityConstraints();
 
 	void WarmStart();
-	void SolveVelocityConstraints();
+
+	// Run one velocity pass and return the largest change of an accumulated impulse.
+	float SolveVelocityConstraints();
 	void StoreImpulses();
 
 	bool SolvePositionConstraints();
 	bool SolveTOIPositionConstraints(int toiIndexA, int toiIndexB);
 
+	// Solve a single constraint. These are used to solve colored batches of
+	// a large island on several threads. See cb2Island::ColorConstraints.
+	float SolveVelocityConstraint(cb2ContactVelocityConstraint* vc);
+	float SolvePointVelocityConstraint(cb2ContactVelocityConstraint* vc);
+	float SolvePositionConstraint(int index);
+
+	// The wide solver colors the constraints so that no two lanes of a
+	// batch share a body, see cb2TimeStep::wideContactSolver.
+	void ColorConstraints();
+	void PackWideConstraints();
+	float SolveWideVelocityConstraints();
+	void UnpackWideConstraints();
+
+	// The soft step solver, see cb2World::SetSolverType. The step of the solver is
+	// a substep. Prepare after InitializeVelocityConstraints, warm start and solve
+	// with the bias once per substep, then relax without it.
+	void PrepareSoftConstraints();
+	void SolveSoftVelocityConstraints(bool useBias);
+	void ApplySoftRestitution();
+
 	cb2TimeStep m_step;
 	cb2Position* m_positions;
 	cb2Velocity* m_velocities;
@@ -89,6 +115,13 @@ public:
 	cb2ContactVelocityConstraint* m_velocityConstraints;
 	cb2Contact** m_contacts;
 	int m_count;
+
+	cb2WideContactConstraint* m_wideConstraints;
+	int m_wideCount;
+	int* m_overflowConstraints;
+	int m_overflowCount;
+
+	cb2SoftContactPoint* m_softPoints;
 };
 
 #endif
@@ -37,6 +37,7 @@ void cb2EdgeAndCircleContact::Destroy(cb2Contact* contact, cb2BlockAllocator* al
 cb2EdgeAndCircleContact::cb2EdgeAndCircleContact(cb2Fixture* fixtureA, cb2Fixture* fixtureB)
 : cb2Contact(fixtureA, 0, fixtureB, 0)
 {
+	m_type = e_edgeAndCircleContact;
 	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_edge);
 	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_circle);
 }
@@ -45,5 +46,5 @@ void cb2EdgeAndCircleContact::Evaluate(cb2Manifold* manifold, const cb2Transform
 {
 	cb2CollideEdgeAndCircle(	manifold,
 								(cb2EdgeShape*)m_fixtureA->GetShape(), xfA,
-								(cb2CircleShape*)m_fixtureB->GetShape(), xfB);
+								(cb2CircleShape*)m_fixtureB->GetShape(), xfB, m_speculativeDistance);
 }
@@ -37,6 +37,7 @@ void cb2EdgeAndPolygonContact::Destroy(cb2Contact* contact, cb2BlockAllocator* a
 cb2EdgeAndPolygonContact::cb2EdgeAndPolygonContact(cb2Fixture* fixtureA, cb2Fixture* fixtureB)
 : cb2Contact(fixtureA, 0, fixtureB, 0)
 {
+	m_type = e_edgeAndPolygonContact;
 	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_edge);
 	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_polygon);
 }
@@ -45,5 +46,5 @@ void cb2EdgeAndPolygonContact::Evaluate(cb2Manifold* manifold, const cb2Transfor
 {
 	cb2CollideEdgeAndPolygon(	manifold,
 								(cb2EdgeShape*)m_fixtureA->GetShape(), xfA,
-								(cb2PolygonShape*)m_fixtureB->GetShape(), xfB);
+								(cb2PolygonShape*)m_fixtureB->GetShape(), xfB, m_speculativeDistance);
 }
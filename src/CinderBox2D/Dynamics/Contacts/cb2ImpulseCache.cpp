@@ -0,0 +1,438 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Dynamics/Contacts/cb2ImpulseCache.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
+#include <algorithm>
+
+// A new point takes the impulse of a cached point this close, in meters.
+const float cb2_impulseCacheDistance = 0.1f;
+
+// The normals of the two points must be within about 25 degrees.
+const float cb2_impulseCacheNormalDot = 0.9f;
+
+// Is there a point with this id in the manifold?
+static bool cb2HasPoint(const cb2Manifold* manifold, cb2ContactID id)
+{
+	if (manifold == NULL)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < manifold->pointCount; ++i)
+	{
+		if (manifold->points[i].id.key == id.key)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// The world points and normal of a manifold at the current body transforms.
+static void cb2ComputeWorldManifold(cb2WorldManifold* worldManifold, const cb2Contact* contact, const cb2Manifold& manifold)
+{
+	const cb2Fixture* fixtureA = contact->GetFixtureA();
+	const cb2Fixture* fixtureB = contact->GetFixtureB();
+	worldManifold->Initialize(&manifold, fixtureA->GetBody()->GetTransform(), fixtureA->GetShape()->m_radius,
+							fixtureB->GetBody()->GetTransform(), fixtureB->GetShape()->m_radius);
+}
+
+cb2ImpulseCache::cb2ImpulseCache()
+{
+	m_capacity = 16;
+	m_count = 0;
+	m_stamp = 0;
+	AllocateEntries();
+}
+
+cb2ImpulseCache::~cb2ImpulseCache()
+{
+	cb2Free(m_entries);
+}
+
+unsigned int cb2ImpulseCache::Hash(const cb2Body* bodyA, const cb2Body* bodyB)
+{
+	// Finalizer of MurmurHash3 on the combined addresses.
+	unsigned long long key = (unsigned long long)(size_t)bodyA * 0x9e3779b97f4a7c15ULL ^ (unsigned long long)(size_t)bodyB;
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (unsigned int)key;
+}
+
+int cb2ImpulseCache::FindSlot(const cb2Body* bodyA, const cb2Body* bodyB) const
+{
+	int mask = m_capacity - 1;
+	int slot = (int)(Hash(bodyA, bodyB) & (unsigned int)mask);
+	while (m_entries[slot].bodyA != NULL && (m_entries[slot].bodyA != bodyA || m_entries[slot].bodyB != bodyB))
+	{
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+void cb2ImpulseCache::AllocateEntries()
+{
+	// A slot is empty while its first body is NULL.
+	m_entries = (cb2ImpulseCacheEntry*)cb2Alloc(m_capacity * sizeof(cb2ImpulseCacheEntry));
+	for (int i = 0; i < m_capacity; ++i)
+	{
+		m_entries[i].bodyA = NULL;
+		m_entries[i].bodyB = NULL;
+		m_entries[i].impulseCount = 0;
+	}
+}
+
+void cb2ImpulseCache::Rebuild(int capacity)
+{
+	cb2ImpulseCacheEntry* oldEntries = m_entries;
+	int oldCapacity = m_capacity;
+
+	m_capacity = capacity;
+	m_count = 0;
+	AllocateEntries();
+
+	for (int i = 0; i < oldCapacity; ++i)
+	{
+		const cb2ImpulseCacheEntry* oldEntry = oldEntries + i;
+		if (oldEntry->bodyA == NULL)
+		{
+			continue;
+		}
+
+		cb2ImpulseCacheEntry entry;
+		entry.bodyA = oldEntry->bodyA;
+		entry.bodyB = oldEntry->bodyB;
+		entry.impulseCount = 0;
+		for (int j = 0; j < oldEntry->impulseCount; ++j)
+		{
+			if (IsLive(oldEntry->impulses[j]))
+			{
+				entry.impulses[entry.impulseCount++] = oldEntry->impulses[j];
+			}
+		}
+
+		if (entry.impulseCount > 0)
+		{
+			m_entries[FindSlot(entry.bodyA, entry.bodyB)] = entry;
+			++m_count;
+		}
+	}
+
+	cb2Free(oldEntries);
+}
+
+void cb2ImpulseCache::Advance()
+{
+	++m_stamp;
+	if (m_count > 0)
+	{
+		Rebuild(m_capacity);
+	}
+}
+
+void cb2ImpulseCache::Store(const cb2Contact* contact, const cb2Manifold& manifold, const cb2Manifold* keptManifold)
+{
+	if (manifold.pointCount == 0)
+	{
+		return;
+	}
+
+	const cb2Body* bodyA = contact->GetFixtureA()->GetBody();
+	const cb2Body* bodyB = contact->GetFixtureB()->GetBody();
+	cb2WorldManifold worldManifold;
+	bool computed = false;
+
+	for (int i = 0; i < manifold.pointCount; ++i)
+	{
+		const cb2ManifoldPoint* mp = manifold.points + i;
+		if ((mp->normalImpulse == 0.0f && mp->tangentImpulse == 0.0f) || cb2HasPoint(keptManifold, mp->id))
+		{
+			continue;
+		}
+
+		if (computed == false)
+		{
+			cb2ComputeWorldManifold(&worldManifold, contact, manifold);
+			computed = true;
+		}
+
+		cb2CachedImpulse impulse;
+		impulse.point = worldManifold.points[i];
+		impulse.normal = worldManifold.normal;
+		impulse.normalImpulse = mp->normalImpulse;
+		impulse.tangentImpulse = mp->tangentImpulse;
+		impulse.stamp = m_stamp;
+
+		// Swapping the bodies only flips the normal, the impulses stay the same.
+		const cb2Body* lowerBody = bodyA;
+		const cb2Body* upperBody = bodyB;
+		if (bodyB < bodyA)
+		{
+			lowerBody = bodyB;
+			upperBody = bodyA;
+			impulse.normal = -impulse.normal;
+		}
+
+		// Keep the table at most half full so probes stay short.
+		if (2 * (m_count + 1) > m_capacity)
+		{
+			Rebuild(2 * m_capacity);
+		}
+
+		int slot = FindSlot(lowerBody, upperBody);
+		cb2ImpulseCacheEntry* entry = m_entries + slot;
+		if (entry->bodyA == NULL)
+		{
+			entry->bodyA = lowerBody;
+			entry->bodyB = upperBody;
+			entry->impulseCount = 0;
+			++m_count;
+		}
+
+		if (entry->impulseCount < cb2_maxCachedImpulses)
+		{
+			entry->impulses[entry->impulseCount++] = impulse;
+		}
+		else
+		{
+			// Replace the oldest impulse.
+			int oldest = 0;
+			for (int j = 1; j < cb2_maxCachedImpulses; ++j)
+			{
+				if (entry->impulses[j].stamp < entry->impulses[oldest].stamp)
+				{
+					oldest = j;
+				}
+			}
+			entry->impulses[oldest] = impulse;
+		}
+	}
+}
+
+int cb2ImpulseCache::Restore(cb2Contact* contact, const cb2Manifold& oldManifold)
+{
+	cb2Manifold* manifold = contact->GetManifold();
+	if (m_count == 0 || manifold->pointCount == 0)
+	{
+		return 0;
+	}
+
+	const cb2Body* bodyA = contact->GetFixtureA()->GetBody();
+	const cb2Body* bodyB = contact->GetFixtureB()->GetBody();
+	float sign = 1.0f;
+	if (bodyB < bodyA)
+	{
+		cb2Swap(bodyA, bodyB);
+		sign = -1.0f;
+	}
+
+	cb2ImpulseCacheEntry* entry = m_entries + FindSlot(bodyA, bodyB);
+	if (entry->bodyA == NULL)
+	{
+		return 0;
+	}
+
+	cb2WorldManifold worldManifold;
+	bool computed = false;
+	int restoredCount = 0;
+
+	for (int i = 0; i < manifold->pointCount && entry->impulseCount > 0; ++i)
+	{
+		cb2ManifoldPoint* mp = manifold->points + i;
+		if (cb2HasPoint(&oldManifold, mp->id))
+		{
+			continue;
+		}
+
+		if (computed == false)
+		{
+			cb2ComputeWorldManifold(&worldManifold, contact, *manifold);
+			computed = true;
+		}
+
+		ci::Vec2f normal = sign * worldManifold.normal;
+		int best = -1;
+		float bestDistanceSquared = cb2_impulseCacheDistance * cb2_impulseCacheDistance;
+		for (int j = 0; j < entry->impulseCount; ++j)
+		{
+			const cb2CachedImpulse& impulse = entry->impulses[j];
+			float distanceSquared = cb2DistanceSquared(impulse.point, worldManifold.points[i]);
+			if (IsLive(impulse) && distanceSquared < bestDistanceSquared && cb2Dot(impulse.normal, normal) > cb2_impulseCacheNormalDot)
+			{
+				best = j;
+				bestDistanceSquared = distanceSquared;
+			}
+		}
+
+		if (best == -1)
+		{
+			continue;
+		}
+
+		// Each cached impulse warm starts one point.
+		mp->normalImpulse = entry->impulses[best].normalImpulse;
+		mp->tangentImpulse = entry->impulses[best].tangentImpulse;
+		entry->impulses[best] = entry->impulses[--entry->impulseCount];
+		++restoredCount;
+	}
+
+	return restoredCount;
+}
+
+void cb2ImpulseCache::RemoveBody(const cb2Body* body)
+{
+	if (m_count == 0)
+	{
+		return;
+	}
+
+	// Another body may be created at the same address, so its impulses go now.
+	// The emptied entries stay in the table until Advance rebuilds it.
+	for (int i = 0; i < m_capacity; ++i)
+	{
+		cb2ImpulseCacheEntry* entry = m_entries + i;
+		if (entry->bodyA == body || entry->bodyB == body)
+		{
+			entry->impulseCount = 0;
+		}
+	}
+}
+
+void cb2ImpulseCache::RemoveBodies(cb2Body** bodies, int count)
+{
+	if (m_count == 0 || count == 0)
+	{
+		return;
+	}
+
+	std::sort(bodies, bodies + count);
+	for (int i = 0; i < m_capacity; ++i)
+	{
+		cb2ImpulseCacheEntry* entry = m_entries + i;
+		if (entry->bodyA == NULL)
+		{
+			continue;
+		}
+
+		if (std::binary_search(bodies, bodies + count, entry->bodyA) ||
+			std::binary_search(bodies, bodies + count, entry->bodyB))
+		{
+			entry->impulseCount = 0;
+		}
+	}
+}
+
+void cb2ImpulseCache::WriteState(cb2SnapshotWriter* writer, const cb2SnapshotIndex& bodyIndex) const
+{
+	writer->Write(m_stamp);
+	writer->Write(m_count);
+	for (int i = 0; i < m_capacity; ++i)
+	{
+		const cb2ImpulseCacheEntry* entry = m_entries + i;
+		if (entry->bodyA == NULL)
+		{
+			continue;
+		}
+
+		writer->Write(bodyIndex.Find(entry->bodyA));
+		writer->Write(bodyIndex.Find(entry->bodyB));
+		writer->Write(entry->impulseCount);
+		writer->WriteBytes(entry->impulses, entry->impulseCount * sizeof(cb2CachedImpulse));
+	}
+}
+
+void cb2ImpulseCache::ReadState(cb2SnapshotReader* reader, cb2Body* const* bodies, int bodyCount)
+{
+	reader->Read(&m_stamp);
+	int count = reader->Read<int>();
+	Reset(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		int indexA = reader->Read<int>();
+		int indexB = reader->Read<int>();
+		cb2ImpulseCacheEntry entry;
+		entry.impulseCount = reader->Read<int>();
+		if (reader->HasFailed() || indexA < 0 || indexA >= bodyCount || indexB < 0 || indexB >= bodyCount ||
+			entry.impulseCount < 0 || entry.impulseCount > cb2_maxCachedImpulses)
+		{
+			reader->SetFailed();
+			return;
+		}
+		reader->ReadBytes(entry.impulses, entry.impulseCount * sizeof(cb2CachedImpulse));
+
+		Insert(entry, bodies[indexA], bodies[indexB]);
+	}
+}
+
+void cb2ImpulseCache::Copy(const cb2ImpulseCache& cache, const cb2CloneMap& map)
+{
+	Reset(cache.m_count);
+	m_stamp = cache.m_stamp;
+
+	for (int i = 0; i < cache.m_capacity; ++i)
+	{
+		const cb2ImpulseCacheEntry& entry = cache.m_entries[i];
+		if (entry.bodyA != NULL)
+		{
+			Insert(entry, map.Find(entry.bodyA), map.Find(entry.bodyB));
+		}
+	}
+}
+
+void cb2ImpulseCache::Reset(int count)
+{
+	int capacity = 16;
+	while (2 * count > capacity)
+	{
+		capacity *= 2;
+	}
+
+	cb2Free(m_entries);
+	m_capacity = capacity;
+	m_count = 0;
+	AllocateEntries();
+}
+
+void cb2ImpulseCache::Insert(const cb2ImpulseCacheEntry& entry, const cb2Body* bodyA, const cb2Body* bodyB)
+{
+	cb2Assert(m_count < m_capacity / 2);
+
+	// The bodies of another world may not have the same address order.
+	cb2ImpulseCacheEntry copy = entry;
+	copy.bodyA = bodyA;
+	copy.bodyB = bodyB;
+	if (bodyB < bodyA)
+	{
+		copy.bodyA = bodyB;
+		copy.bodyB = bodyA;
+		for (int i = 0; i < copy.impulseCount; ++i)
+		{
+			copy.impulses[i].normal = -copy.impulses[i].normal;
+		}
+	}
+
+	m_entries[FindSlot(copy.bodyA, copy.bodyB)] = copy;
+	++m_count;
+}
@@ -0,0 +1,121 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_IMPULSE_CACHE_H
+#define CB2_IMPULSE_CACHE_H
+
+#include <CinderBox2D/Common/cb2Math.h>
+#include <CinderBox2D/Collision/cb2Collision.h>
+
+class cb2Body;
+class cb2CloneMap;
+class cb2Contact;
+class cb2SnapshotIndex;
+class cb2SnapshotReader;
+class cb2SnapshotWriter;
+
+/// Most impulses kept for one pair of bodies.
+#define cb2_maxCachedImpulses	4
+
+/// The impulses of contact points that went away, kept by body pair for a step.
+/// A new point of a contact between the same bodies, close to a cached point and
+/// with a similar normal, is warm started from it. This carries the impulses over
+/// when a contact is destroyed and created again, or when a body slides from one
+/// child edge of a chain to the next.
+class cb2ImpulseCache
+{
+public:
+	cb2ImpulseCache();
+	~cb2ImpulseCache();
+
+	/// Start a new step. The impulses stored before the previous step are dropped.
+	void Advance();
+
+	/// Store the impulses of the points of a manifold of the contact that are not
+	/// in the kept manifold. Pass NULL to store all of them.
+	void Store(const cb2Contact* contact, const cb2Manifold& manifold, const cb2Manifold* keptManifold);
+
+	/// Warm start the points of the contact manifold that are not in the old
+	/// manifold. Returns the number of points that took a cached impulse.
+	int Restore(cb2Contact* contact, const cb2Manifold& oldManifold);
+
+	/// Drop the impulses of a body that is destroyed.
+	void RemoveBody(const cb2Body* body);
+
+	/// Drop the impulses of many bodies with one pass over the table. This sorts the bodies.
+	void RemoveBodies(cb2Body** bodies, int count);
+
+	/// Get the number of body pairs with cached impulses.
+	int GetCount() const { return m_count; }
+
+	/// Write the cached impulses into a world snapshot, with the bodies as their
+	/// index in the body list.
+	void WriteState(cb2SnapshotWriter* writer, const cb2SnapshotIndex& bodyIndex) const;
+
+	/// Replace the cached impulses with the ones of a world snapshot.
+	void ReadState(cb2SnapshotReader* reader, cb2Body* const* bodies, int bodyCount);
+
+	/// Make this cache a copy of the cache of another world, for a world clone.
+	void Copy(const cb2ImpulseCache& cache, const cb2CloneMap& map);
+
+private:
+
+	struct cb2CachedImpulse
+	{
+		ci::Vec2f point;
+		ci::Vec2f normal;
+		float normalImpulse;
+		float tangentImpulse;
+		int stamp;
+	};
+
+	struct cb2ImpulseCacheEntry
+	{
+		// The lower body address comes first, the normal points from bodyA to bodyB.
+		const cb2Body* bodyA;
+		const cb2Body* bodyB;
+		int impulseCount;
+		cb2CachedImpulse impulses[cb2_maxCachedImpulses];
+	};
+
+	static unsigned int Hash(const cb2Body* bodyA, const cb2Body* bodyB);
+
+	// Returns the slot holding the pair, or the empty slot where it belongs.
+	int FindSlot(const cb2Body* bodyA, const cb2Body* bodyB) const;
+
+	// Drop the old impulses and empty pairs and rehash the others into a table of the given size.
+	void Rebuild(int capacity);
+
+	// Empty the table and size it for this many pairs.
+	void Reset(int count);
+
+	// Allocate a table of m_capacity empty slots. The old table is not freed.
+	void AllocateEntries();
+
+	// Add the pair of an entry that refers to the bodies of another world.
+	void Insert(const cb2ImpulseCacheEntry& entry, const cb2Body* bodyA, const cb2Body* bodyB);
+
+	// Is the impulse from this step or the previous one?
+	bool IsLive(const cb2CachedImpulse& impulse) const { return impulse.stamp >= m_stamp - 1; }
+
+	cb2ImpulseCacheEntry* m_entries;
+	int m_capacity;
+	int m_count;
+	int m_stamp;
+};
+
+#endif
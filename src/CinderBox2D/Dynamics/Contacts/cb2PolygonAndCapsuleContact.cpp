@@ -0,0 +1,50 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/Contacts/cb2PolygonAndCapsuleContact.h>
+#include <CinderBox2D/Common/cb2BlockAllocator.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+
+#include <new>
+
+cb2Contact* cb2PolygonAndCapsuleContact::Create(cb2Fixture* fixtureA, int, cb2Fixture* fixtureB, int, cb2BlockAllocator* allocator)
+{
+	void* mem = allocator->Allocate(sizeof(cb2PolygonAndCapsuleContact));
+	return new (mem) cb2PolygonAndCapsuleContact(fixtureA, fixtureB);
+}
+
+void cb2PolygonAndCapsuleContact::Destroy(cb2Contact* contact, cb2BlockAllocator* allocator)
+{
+	((cb2PolygonAndCapsuleContact*)contact)->~cb2PolygonAndCapsuleContact();
+	allocator->Free(contact, sizeof(cb2PolygonAndCapsuleContact));
+}
+
+cb2PolygonAndCapsuleContact::cb2PolygonAndCapsuleContact(cb2Fixture* fixtureA, cb2Fixture* fixtureB)
+: cb2Contact(fixtureA, 0, fixtureB, 0)
+{
+	m_type = e_polygonAndCapsuleContact;
+	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_polygon);
+	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_capsule);
+}
+
+void cb2PolygonAndCapsuleContact::Evaluate(cb2Manifold* manifold, const cb2Transform& xfA, const cb2Transform& xfB)
+{
+	cb2CollidePolygonAndCapsule(	manifold,
+								(cb2PolygonShape*)m_fixtureA->GetShape(), xfA,
+								(cb2CapsuleShape*)m_fixtureB->GetShape(), xfB, m_speculativeDistance);
+}
@@ -37,6 +37,7 @@ void cb2PolygonAndCircleContact::Destroy(cb2Contact* contact, cb2BlockAllocator*
 cb2PolygonAndCircleContact::cb2PolygonAndCircleContact(cb2Fixture* fixtureA, cb2Fixture* fixtureB)
 : cb2Contact(fixtureA, 0, fixtureB, 0)
 {
+	m_type = e_polygonAndCircleContact;
 	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_polygon);
 	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_circle);
 }
@@ -45,5 +46,5 @@ void cb2PolygonAndCircleContact::Evaluate(cb2Manifold* manifold, const cb2Transf
 {
 	cb2CollidePolygonAndCircle(	manifold,
 								(cb2PolygonShape*)m_fixtureA->GetShape(), xfA,
-								(cb2CircleShape*)m_fixtureB->GetShape(), xfB);
+								(cb2CircleShape*)m_fixtureB->GetShape(), xfB, m_speculativeDistance);
 }
@@ -40,6 +40,8 @@ void cb2PolygonContact::Destroy(cb2Contact* contact, cb2BlockAllocator* allocato
 cb2PolygonContact::cb2PolygonContact(cb2Fixture* fixtureA, cb2Fixture* fixtureB)
 	: cb2Contact(fixtureA, 0, fixtureB, 0)
 {
+	m_type = e_polygonContact;
+	m_cache.state = cb2PolygonCache::e_empty;
 	cb2Assert(m_fixtureA->GetType() == cb2Shape::e_polygon);
 	cb2Assert(m_fixtureB->GetType() == cb2Shape::e_polygon);
 }
@@ -48,5 +50,5 @@ void cb2PolygonContact::Evaluate(cb2Manifold* manifold, const cb2Transform& xfA,
 {
 	cb2CollidePolygons(	manifold,
 						(cb2PolygonShape*)m_fixtureA->GetShape(), xfA,
-						(cb2PolygonShape*)m_fixtureB->GetShape(), xfB);
+						(cb2PolygonShape*)m_fixtureB->GetShape(), xfB, &m_cache, m_speculativeDistance);
 }
@@ -34,6 +34,9 @@ public:
 	~cb2PolygonContact() {}
 
 	void Evaluate(cb2Manifold* manifold, const cb2Transform& xfA, const cb2Transform& xfB);
+
+	// Separating axis or reference edge of the last evaluation.
+	cb2PolygonCache m_cache;
 };
 
 #endif
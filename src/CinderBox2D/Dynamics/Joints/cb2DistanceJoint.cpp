@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2DistanceJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // 1-D constrained system
@@ -61,8 +62,8 @@ cb2DistanceJoint::cb2DistanceJoint(const cb2DistanceJointDef* def)
 
 void cb2DistanceJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -259,3 +260,13 @@ void cb2DistanceJoint::Dump()
 	cb2Log("  jd.dampingRatio = %.15lef;\n", m_dampingRatio);
 	cb2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void cb2DistanceJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_impulse);
+}
+
+void cb2DistanceJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_impulse);
+}
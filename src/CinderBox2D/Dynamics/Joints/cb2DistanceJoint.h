@@ -104,11 +104,14 @@ public:
 protected:
 
 	friend class cb2Joint;
+	friend class cb2JointTreeSolver;
 	cb2DistanceJoint(const cb2DistanceJointDef* data);
 
 	void InitVelocityConstraints(const cb2SolverData& data);
 	void SolveVelocityConstraints(const cb2SolverData& data);
 	bool SolvePositionConstraints(const cb2SolverData& data);
+	void WriteState(cb2SnapshotWriter* writer) const;
+	void ReadState(cb2SnapshotReader* reader);
 
 	float m_frequencyHz;
 	float m_dampingRatio;
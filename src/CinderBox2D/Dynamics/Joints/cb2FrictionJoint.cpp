@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2FrictionJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // Point-to-point constraint
@@ -55,8 +56,8 @@ cb2FrictionJoint::cb2FrictionJoint(const cb2FrictionJointDef* def)
 
 void cb2FrictionJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -249,3 +250,15 @@ void cb2FrictionJoint::Dump()
 	cb2Log("  jd.maxTorque = %.15lef;\n", m_maxTorque);
 	cb2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void cb2FrictionJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_linearImpulse);
+	writer->Write(m_angularImpulse);
+}
+
+void cb2FrictionJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_linearImpulse);
+	reader->Read(&m_angularImpulse);
+}
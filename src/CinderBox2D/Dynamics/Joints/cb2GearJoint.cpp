@@ -20,6 +20,7 @@
 #include <CinderBox2D/Dynamics/Joints/cb2RevoluteJoint.h>
 #include <CinderBox2D/Dynamics/Joints/cb2PrismaticJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // Gear Joint:
@@ -128,10 +129,10 @@ cb2GearJoint::cb2GearJoint(const cb2GearJointDef* def)
 
 void cb2GearJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
-	m_indexC = m_bodyC->m_islandIndex;
-	m_indexD = m_bodyD->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexC = m_bodyC->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexD = m_bodyD->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_lcA = m_bodyA->m_sweep.localCenter;
 	m_lcB = m_bodyB->m_sweep.localCenter;
 	m_lcC = m_bodyC->m_sweep.localCenter;
@@ -415,3 +416,13 @@ void cb2GearJoint::Dump()
 	cb2Log("  jd.ratio = %.15lef;\n", m_ratio);
 	cb2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void cb2GearJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_impulse);
+}
+
+void cb2GearJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_impulse);
+}
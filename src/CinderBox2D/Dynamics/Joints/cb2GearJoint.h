@@ -83,6 +83,8 @@ protected:
 	void InitVelocityConstraints(const cb2SolverData& data);
 	void SolveVelocityConstraints(const cb2SolverData& data);
 	bool SolvePositionConstraints(const cb2SolverData& data);
+	void WriteState(cb2SnapshotWriter* writer) const;
+	void ReadState(cb2SnapshotReader* reader);
 
 	cb2Joint* m_joint1;
 	cb2Joint* m_joint2;
@@ -30,6 +30,7 @@
 #include <CinderBox2D/Dynamics/Joints/cb2MotorJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
 #include <CinderBox2D/Dynamics/cb2World.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Common/cb2BlockAllocator.h>
 
 #include <new>
@@ -180,6 +181,171 @@ void cb2Joint::Destroy(cb2Joint* joint, cb2BlockAllocator* allocator)
 	}
 }
 
+template <typename T>
+inline cb2Joint* cb2CopyJoint(const cb2Joint* joint, cb2BlockAllocator* allocator)
+{
+	void* mem = allocator->Allocate(sizeof(T));
+	return new (mem) T(*static_cast<const T*>(joint));
+}
+
+cb2Joint* cb2Joint::Clone(const cb2Joint* joint, const cb2CloneMap& map, cb2BlockAllocator* allocator)
+{
+	cb2Joint* clone = NULL;
+
+	switch (joint->m_type)
+	{
+	case e_distanceJoint:
+		clone = cb2CopyJoint<cb2DistanceJoint>(joint, allocator);
+		break;
+
+	case e_mouseJoint:
+		clone = cb2CopyJoint<cb2MouseJoint>(joint, allocator);
+		break;
+
+	case e_prismaticJoint:
+		clone = cb2CopyJoint<cb2PrismaticJoint>(joint, allocator);
+		break;
+
+	case e_revoluteJoint:
+		clone = cb2CopyJoint<cb2RevoluteJoint>(joint, allocator);
+		break;
+
+	case e_pulleyJoint:
+		clone = cb2CopyJoint<cb2PulleyJoint>(joint, allocator);
+		break;
+
+	case e_gearJoint:
+		{
+			cb2GearJoint* gear = (cb2GearJoint*)cb2CopyJoint<cb2GearJoint>(joint, allocator);
+			gear->m_joint1 = map.Find(gear->m_joint1);
+			gear->m_joint2 = map.Find(gear->m_joint2);
+			gear->m_bodyC = map.Find(gear->m_bodyC);
+			gear->m_bodyD = map.Find(gear->m_bodyD);
+			clone = gear;
+		}
+		break;
+
+	case e_wheelJoint:
+		clone = cb2CopyJoint<cb2WheelJoint>(joint, allocator);
+		break;
+
+	case e_weldJoint:
+		clone = cb2CopyJoint<cb2WeldJoint>(joint, allocator);
+		break;
+
+	case e_frictionJoint:
+		clone = cb2CopyJoint<cb2FrictionJoint>(joint, allocator);
+		break;
+
+	case e_ropeJoint:
+		clone = cb2CopyJoint<cb2RopeJoint>(joint, allocator);
+		break;
+
+	case e_motorJoint:
+		clone = cb2CopyJoint<cb2MotorJoint>(joint, allocator);
+		break;
+
+	default:
+		cb2Assert(false);
+		return NULL;
+	}
+
+	clone->m_prev = NULL;
+	clone->m_next = NULL;
+	clone->m_bodyA = map.Find(joint->m_bodyA);
+	clone->m_bodyB = map.Find(joint->m_bodyB);
+	clone->m_edgeA.joint = clone;
+	clone->m_edgeA.other = clone->m_bodyB;
+	clone->m_edgeA.prev = NULL;
+	clone->m_edgeA.next = NULL;
+	clone->m_edgeB.joint = clone;
+	clone->m_edgeB.other = clone->m_bodyA;
+	clone->m_edgeB.prev = NULL;
+	clone->m_edgeB.next = NULL;
+	clone->m_persistentIsland = NULL;
+	clone->m_islandPrev = NULL;
+	clone->m_islandNext = NULL;
+	clone->m_islandFlag = false;
+	return clone;
+}
+
+template <typename T>
+bool cb2Joint::SolveBatch(cb2Joint** joints, int count, const cb2SolverData& data, cb2JointPass pass)
+{
+	bool okay = true;
+	switch (pass)
+	{
+	case e_initVelocityPass:
+		for (int i = 0; i < count; ++i)
+		{
+			T* joint = (T*)joints[i];
+			joint->T::InitVelocityConstraints(data);
+		}
+		break;
+
+	case e_solveVelocityPass:
+		for (int i = 0; i < count; ++i)
+		{
+			T* joint = (T*)joints[i];
+			joint->T::SolveVelocityConstraints(data);
+		}
+		break;
+
+	case e_solvePositionPass:
+		for (int i = 0; i < count; ++i)
+		{
+			T* joint = (T*)joints[i];
+			bool jointOkay = joint->T::SolvePositionConstraints(data);
+			okay = okay && jointOkay;
+		}
+		break;
+	}
+	return okay;
+}
+
+bool cb2Joint::SolveBatch(cb2Joint** joints, int count, const cb2SolverData& data, cb2JointPass pass)
+{
+	switch (joints[0]->m_type)
+	{
+	case e_distanceJoint:
+		return SolveBatch<cb2DistanceJoint>(joints, count, data, pass);
+
+	case e_mouseJoint:
+		return SolveBatch<cb2MouseJoint>(joints, count, data, pass);
+
+	case e_prismaticJoint:
+		return SolveBatch<cb2PrismaticJoint>(joints, count, data, pass);
+
+	case e_revoluteJoint:
+		return SolveBatch<cb2RevoluteJoint>(joints, count, data, pass);
+
+	case e_pulleyJoint:
+		return SolveBatch<cb2PulleyJoint>(joints, count, data, pass);
+
+	case e_gearJoint:
+		return SolveBatch<cb2GearJoint>(joints, count, data, pass);
+
+	case e_wheelJoint:
+		return SolveBatch<cb2WheelJoint>(joints, count, data, pass);
+
+	case e_weldJoint:
+		return SolveBatch<cb2WeldJoint>(joints, count, data, pass);
+
+	case e_frictionJoint:
+		return SolveBatch<cb2FrictionJoint>(joints, count, data, pass);
+
+	case e_ropeJoint:
+		return SolveBatch<cb2RopeJoint>(joints, count, data, pass);
+
+	case e_motorJoint:
+		return SolveBatch<cb2MotorJoint>(joints, count, data, pass);
+
+	default:
+		cb2Assert(false);
+		return true;
+	}
+}
+
 cb2Joint::cb2Joint(const cb2JointDef* def)
 {
 	cb2Assert(def->bodyA != def->bodyB);
@@ -191,6 +357,12 @@ cb2Joint::cb2Joint(const cb2JointDef* def)
 	m_bodyB = def->bodyB;
 	m_index = 0;
 	m_collideConnected = def->collideConnected;
+	m_breakForce = def->breakForce;
+	m_breakTorque = def->breakTorque;
+	m_breakInvDt = 0.0f;
+	m_persistentIsland = NULL;
+	m_islandPrev = NULL;
+	m_islandNext = NULL;
 	m_islandFlag = false;
 	m_userData = def->userData;
 
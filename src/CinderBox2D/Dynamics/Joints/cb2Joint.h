@@ -25,6 +25,10 @@ class cb2Body;
 class cb2Joint;
 struct cb2SolverData;
 class cb2BlockAllocator;
+class cb2CloneMap;
+class cb2SnapshotReader;
+class cb2SnapshotWriter;
+struct cb2PersistentIsland;
 
 enum cb2JointType
 {
@@ -42,6 +46,14 @@ enum cb2JointType
 	e_motorJoint
 };
 
+// The solver passes over the joints of an island.
+enum cb2JointPass
+{
+	e_initVelocityPass,
+	e_solveVelocityPass,
+	e_solvePositionPass
+};
+
 enum cb2LimitState
 {
 	e_inactiveLimit,
@@ -80,6 +92,8 @@ struct cb2JointDef
 		bodyA = NULL;
 		bodyB = NULL;
 		collideConnected = false;
+		breakForce = cb2_maxFloat;
+		breakTorque = cb2_maxFloat;
 	}
 
 	/// The joint type is set automatically for concrete joint types.
@@ -96,6 +110,13 @@ struct cb2JointDef
 
 	/// set this flag to true if the attached bodies should collide.
 	bool collideConnected;
+
+	/// The joint breaks when its reaction force exceeds this, in Newtons. The world
+	/// destroys broken joints at the end of the step, see cb2ContactEvents::GetBreakEvents.
+	float breakForce;
+
+	/// The joint breaks when its reaction torque exceeds this, in N*m.
+	float breakTorque;
 };
 
 /// The base joint class. Joints are used to constraint two bodies together in
@@ -143,6 +164,15 @@ public:
 	/// the flag is only checked when fixture AABBs begin to overlap.
 	bool GetCollideConnected() const;
 
+	/// Set the reaction force the joint breaks at. Do not make the joints
+	/// of a gear joint breakable, destroy the gear joint first.
+	void SetBreakForce(float force);
+	float GetBreakForce() const;
+
+	/// Set the reaction torque the joint breaks at.
+	void SetBreakTorque(float torque);
+	float GetBreakTorque() const;
+
 	/// Dump this joint to the log file.
 	virtual void Dump() { cb2Log("// Dump is not supported for this joint type.\n"); }
 
@@ -153,11 +183,16 @@ protected:
 	friend class cb2World;
 	friend class cb2Body;
 	friend class cb2Island;
+	friend class cb2IslandGraph;
 	friend class cb2GearJoint;
 
 	static cb2Joint* Create(const cb2JointDef* def, cb2BlockAllocator* allocator);
 	static void Destroy(cb2Joint* joint, cb2BlockAllocator* allocator);
 
+	// Copy a joint for a world clone. The bodies and joints it refers to are looked up in
+	// the map, the list links and edges are left for the world to set.
+	static cb2Joint* Clone(const cb2Joint* joint, const cb2CloneMap& map, cb2BlockAllocator* allocator);
+
 	cb2Joint(const cb2JointDef* def);
 	virtual ~cb2Joint() {}
 
@@ -167,6 +202,18 @@ protected:
 	// This returns true if the position errors are within tolerance.
 	virtual bool SolvePositionConstraints(const cb2SolverData& data) = 0;
 
+	// Write and read the accumulated impulses and limit states of a world snapshot.
+	virtual void WriteState(cb2SnapshotWriter* writer) const { CB2_NOT_USED(writer); }
+	virtual void ReadState(cb2SnapshotReader* reader) { CB2_NOT_USED(reader); }
+
+	// Run a solver pass over joints that all have the same type, with direct calls
+	// instead of virtual ones. See cb2World::SetJointBatching. Returns true if the
+	// position errors of all the joints are within tolerance.
+	static bool SolveBatch(cb2Joint** joints, int count, const cb2SolverData& data, cb2JointPass pass);
+
+	template <typename T>
+	static bool SolveBatch(cb2Joint** joints, int count, const cb2SolverData& data, cb2JointPass pass);
+
 	cb2JointType m_type;
 	cb2Joint* m_prev;
 	cb2Joint* m_next;
@@ -177,9 +224,21 @@ protected:
 
 	int m_index;
 
+	// Set while the joint links a persistent island.
+	cb2PersistentIsland* m_persistentIsland;
+	cb2Joint* m_islandPrev;
+	cb2Joint* m_islandNext;
+
+	float m_breakForce;
+	float m_breakTorque;
+
 	bool m_islandFlag;
 	bool m_collideConnected;
 
+	// The inverse time step of the island solve that found the reaction above a break
+	// threshold, zero while the joint holds.
+	float m_breakInvDt;
+
 	void* m_userData;
 };
 
@@ -223,4 +282,24 @@ inline bool cb2Joint::GetCollideConnected() const
 	return m_collideConnected;
 }
 
+inline void cb2Joint::SetBreakForce(float force)
+{
+	m_breakForce = force;
+}
+
+inline float cb2Joint::GetBreakForce() const
+{
+	return m_breakForce;
+}
+
+inline void cb2Joint::SetBreakTorque(float torque)
+{
+	m_breakTorque = torque;
+}
+
+inline float cb2Joint::GetBreakTorque() const
+{
+	return m_breakTorque;
+}
+
 #endif
@@ -0,0 +1,659 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Dynamics/Joints/cb2JointTreeSolver.h>
+#include <CinderBox2D/Dynamics/Joints/cb2DistanceJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2RevoluteJoint.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2TimeStep.h>
+#include <CinderBox2D/Common/cb2StackAllocator.h>
+#include <memory.h>
+
+// A body or a joint of a joint tree.
+struct cb2JointTreeNode
+{
+	// 3 for a body, the constraint rows for a joint.
+	int dim;
+
+	// The parent node, -1 for a root.
+	int parent;
+
+	// Body nodes: the island index. Joint nodes: the island indices of the two
+	// bodies, -1 for ground.
+	int body;
+	int bodyA;
+	int bodyB;
+	cb2Joint* joint;
+
+	float invMass;
+	float invI;
+
+	// The inverse of the pivot block, and its product with the block of the parent.
+	float invD[3][3];
+	float L[3][3];
+};
+
+// The island indices and mass of the bodies of a joint the tree solver supports.
+struct cb2TreeJointInfo
+{
+	int indexA;
+	int indexB;
+	float invMassA;
+	float invIA;
+	float invMassB;
+	float invIB;
+	int dim;
+};
+
+bool cb2JointTreeSolver::GetJointInfo(cb2Joint* joint, cb2TreeJointInfo* info)
+{
+	switch (joint->GetType())
+	{
+	case e_revoluteJoint:
+		{
+			cb2RevoluteJoint* revolute = (cb2RevoluteJoint*)joint;
+			if (revolute->IsMotorEnabled() || (revolute->IsLimitEnabled() && revolute->m_limitState != e_inactiveLimit))
+			{
+				return false;
+			}
+
+			info->indexA = revolute->m_indexA;
+			info->indexB = revolute->m_indexB;
+			info->invMassA = revolute->m_invMassA;
+			info->invIA = revolute->m_invIA;
+			info->invMassB = revolute->m_invMassB;
+			info->invIB = revolute->m_invIB;
+			info->dim = 2;
+		}
+		return true;
+
+	case e_distanceJoint:
+		{
+			cb2DistanceJoint* distance = (cb2DistanceJoint*)joint;
+			info->indexA = distance->m_indexA;
+			info->indexB = distance->m_indexB;
+			info->invMassA = distance->m_invMassA;
+			info->invIA = distance->m_invIA;
+			info->invMassB = distance->m_invMassB;
+			info->invIB = distance->m_invIB;
+			info->dim = 1;
+		}
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+// Invert a symmetric block of size 1 to 3. The blocks of the joints are negative
+// definite, so there is no pivoting. A singular block is inverted to zero.
+static void cb2InvertBlock(float D[3][3], int dim, float invD[3][3])
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			invD[i][j] = 0.0f;
+		}
+	}
+
+	if (dim == 1)
+	{
+		invD[0][0] = D[0][0] != 0.0f ? 1.0f / D[0][0] : 0.0f;
+	}
+	else if (dim == 2)
+	{
+		float det = D[0][0] * D[1][1] - D[0][1] * D[1][0];
+		if (det != 0.0f)
+		{
+			det = 1.0f / det;
+		}
+		invD[0][0] = det * D[1][1];
+		invD[0][1] = -det * D[0][1];
+		invD[1][0] = -det * D[1][0];
+		invD[1][1] = det * D[0][0];
+	}
+	else
+	{
+		float c00 = D[1][1] * D[2][2] - D[1][2] * D[2][1];
+		float c01 = D[1][2] * D[2][0] - D[1][0] * D[2][2];
+		float c02 = D[1][0] * D[2][1] - D[1][1] * D[2][0];
+		float det = D[0][0] * c00 + D[0][1] * c01 + D[0][2] * c02;
+		if (det != 0.0f)
+		{
+			det = 1.0f / det;
+		}
+		invD[0][0] = det * c00;
+		invD[0][1] = det * (D[0][2] * D[2][1] - D[0][1] * D[2][2]);
+		invD[0][2] = det * (D[0][1] * D[1][2] - D[0][2] * D[1][1]);
+		invD[1][0] = det * c01;
+		invD[1][1] = det * (D[0][0] * D[2][2] - D[0][2] * D[2][0]);
+		invD[1][2] = det * (D[0][2] * D[1][0] - D[0][0] * D[1][2]);
+		invD[2][0] = det * c02;
+		invD[2][1] = det * (D[0][1] * D[2][0] - D[0][0] * D[2][1]);
+		invD[2][2] = det * (D[0][0] * D[1][1] - D[0][1] * D[1][0]);
+	}
+}
+
+// Union-find root with path halving.
+static int cb2FindRoot(int* sets, int i)
+{
+	while (sets[i] != i)
+	{
+		sets[i] = sets[sets[i]];
+		i = sets[i];
+	}
+	return i;
+}
+
+cb2JointTreeSolver::cb2JointTreeSolver(cb2StackAllocator* allocator)
+{
+	m_allocator = allocator;
+	m_nodes = NULL;
+	m_order = NULL;
+	m_nodeCount = 0;
+	m_rhs = NULL;
+	m_solution = NULL;
+}
+
+cb2JointTreeSolver::~cb2JointTreeSolver()
+{
+	if (m_nodes)
+	{
+		m_allocator->Free(m_solution);
+		m_allocator->Free(m_rhs);
+		m_allocator->Free(m_order);
+		m_allocator->Free(m_nodes);
+	}
+}
+
+int cb2JointTreeSolver::Initialize(int bodyCount, cb2Joint** joints, int jointCount, const cb2SolverData& data)
+{
+	CB2_NOT_USED(data);
+
+	// Pick the joints that keep the graph a forest, with ground as one more node.
+	cb2Joint** treeJoints = (cb2Joint**)m_allocator->Allocate(jointCount * sizeof(cb2Joint*));
+	int ground = bodyCount;
+	int* sets = (int*)m_allocator->Allocate((bodyCount + 1) * sizeof(int));
+	for (int i = 0; i <= bodyCount; ++i)
+	{
+		sets[i] = i;
+	}
+
+	int treeJointCount = 0;
+	int iterativeCount = 0;
+	for (int i = 0; i < jointCount; ++i)
+	{
+		cb2Joint* joint = joints[i];
+		cb2TreeJointInfo info;
+		bool tree = GetJointInfo(joint, &info);
+
+		bool dynamicA = joint->GetBodyA()->GetType() == cb2_dynamicBody;
+		bool dynamicB = joint->GetBodyB()->GetType() == cb2_dynamicBody;
+		if (tree && ((dynamicA && info.invIA == 0.0f) || (dynamicB && info.invIB == 0.0f)))
+		{
+			tree = false;
+		}
+
+		if (tree)
+		{
+			int rootA = cb2FindRoot(sets, dynamicA ? info.indexA : ground);
+			int rootB = cb2FindRoot(sets, dynamicB ? info.indexB : ground);
+			if (rootA == rootB)
+			{
+				tree = false;
+			}
+			else
+			{
+				sets[rootA] = rootB;
+			}
+		}
+
+		if (tree)
+		{
+			treeJoints[treeJointCount++] = joint;
+		}
+		else
+		{
+			joints[iterativeCount++] = joint;
+		}
+	}
+
+	for (int i = 0; i < treeJointCount; ++i)
+	{
+		joints[iterativeCount + i] = treeJoints[i];
+	}
+	m_allocator->Free(sets);
+	m_allocator->Free(treeJoints);
+
+	if (treeJointCount == 0)
+	{
+		return iterativeCount;
+	}
+
+	// A tree has at most one body more than it has joints.
+	int maxNodeCount = 3 * treeJointCount;
+	m_nodes = (cb2JointTreeNode*)m_allocator->Allocate(maxNodeCount * sizeof(cb2JointTreeNode));
+	m_order = (int*)m_allocator->Allocate(maxNodeCount * sizeof(int));
+	m_rhs = (float*)m_allocator->Allocate(3 * maxNodeCount * sizeof(float));
+	m_solution = (float*)m_allocator->Allocate(3 * maxNodeCount * sizeof(float));
+
+	int* bodyNodes = (int*)m_allocator->Allocate(bodyCount * sizeof(int));
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		bodyNodes[i] = -1;
+	}
+
+	// Joint nodes come first, then the body nodes.
+	m_nodeCount = treeJointCount;
+	for (int i = 0; i < treeJointCount; ++i)
+	{
+		cb2Joint* joint = joints[iterativeCount + i];
+		cb2TreeJointInfo info;
+		GetJointInfo(joint, &info);
+
+		cb2JointTreeNode* node = m_nodes + i;
+		node->dim = info.dim;
+		node->parent = -1;
+		node->body = -1;
+		node->joint = joint;
+		node->bodyA = joint->GetBodyA()->GetType() == cb2_dynamicBody ? info.indexA : -1;
+		node->bodyB = joint->GetBodyB()->GetType() == cb2_dynamicBody ? info.indexB : -1;
+
+		for (int side = 0; side < 2; ++side)
+		{
+			int index = side == 0 ? node->bodyA : node->bodyB;
+			if (index == -1 || bodyNodes[index] != -1)
+			{
+				continue;
+			}
+
+			cb2JointTreeNode* bodyNode = m_nodes + m_nodeCount;
+			bodyNode->dim = 3;
+			bodyNode->parent = -1;
+			bodyNode->body = index;
+			bodyNode->bodyA = -1;
+			bodyNode->bodyB = -1;
+			bodyNode->joint = NULL;
+			bodyNode->invMass = side == 0 ? info.invMassA : info.invMassB;
+			bodyNode->invI = side == 0 ? info.invIA : info.invIB;
+			bodyNodes[index] = m_nodeCount++;
+		}
+	}
+
+	// The joints of each body node, in compressed rows.
+	int bodyNodeCount = m_nodeCount - treeJointCount;
+	int* jointStarts = (int*)m_allocator->Allocate((bodyNodeCount + 1) * sizeof(int));
+	int* bodyJoints = (int*)m_allocator->Allocate(2 * treeJointCount * sizeof(int));
+	for (int i = 0; i <= bodyNodeCount; ++i)
+	{
+		jointStarts[i] = 0;
+	}
+
+	for (int i = 0; i < treeJointCount; ++i)
+	{
+		const cb2JointTreeNode* node = m_nodes + i;
+		if (node->bodyA != -1)
+		{
+			++jointStarts[bodyNodes[node->bodyA] - treeJointCount + 1];
+		}
+		if (node->bodyB != -1)
+		{
+			++jointStarts[bodyNodes[node->bodyB] - treeJointCount + 1];
+		}
+	}
+
+	for (int i = 0; i < bodyNodeCount; ++i)
+	{
+		jointStarts[i + 1] += jointStarts[i];
+	}
+
+	int* fill = (int*)m_allocator->Allocate(bodyNodeCount * sizeof(int));
+	for (int i = 0; i < bodyNodeCount; ++i)
+	{
+		fill[i] = jointStarts[i];
+	}
+
+	for (int i = 0; i < treeJointCount; ++i)
+	{
+		const cb2JointTreeNode* node = m_nodes + i;
+		if (node->bodyA != -1)
+		{
+			int b = bodyNodes[node->bodyA] - treeJointCount;
+			bodyJoints[fill[b]++] = i;
+		}
+		if (node->bodyB != -1)
+		{
+			int b = bodyNodes[node->bodyB] - treeJointCount;
+			bodyJoints[fill[b]++] = i;
+		}
+	}
+
+	// Breadth first from the roots. A joint to ground is the root of its tree,
+	// the trees that do not touch ground start at any body.
+	bool* visited = (bool*)m_allocator->Allocate(m_nodeCount * sizeof(bool));
+	for (int i = 0; i < m_nodeCount; ++i)
+	{
+		visited[i] = false;
+	}
+
+	int orderCount = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int i = 0; i < m_nodeCount; ++i)
+		{
+			const cb2JointTreeNode* root = m_nodes + i;
+			bool groundJoint = root->body == -1 && (root->bodyA == -1 || root->bodyB == -1);
+			if (visited[i] || (pass == 0 && groundJoint == false))
+			{
+				continue;
+			}
+
+			visited[i] = true;
+			int head = orderCount;
+			m_order[orderCount++] = i;
+			while (head < orderCount)
+			{
+				int index = m_order[head++];
+				const cb2JointTreeNode* node = m_nodes + index;
+				if (node->body == -1)
+				{
+					int sides[2] = { node->bodyA, node->bodyB };
+					for (int side = 0; side < 2; ++side)
+					{
+						if (sides[side] == -1)
+						{
+							continue;
+						}
+
+						int child = bodyNodes[sides[side]];
+						if (visited[child] == false)
+						{
+							visited[child] = true;
+							m_nodes[child].parent = index;
+							m_order[orderCount++] = child;
+						}
+					}
+				}
+				else
+				{
+					int b = index - treeJointCount;
+					for (int j = jointStarts[b]; j < jointStarts[b + 1]; ++j)
+					{
+						int child = bodyJoints[j];
+						if (visited[child] == false)
+						{
+							visited[child] = true;
+							m_nodes[child].parent = index;
+							m_order[orderCount++] = child;
+						}
+					}
+				}
+			}
+		}
+	}
+	cb2Assert(orderCount == m_nodeCount);
+
+	m_allocator->Free(visited);
+	m_allocator->Free(fill);
+	m_allocator->Free(bodyJoints);
+	m_allocator->Free(jointStarts);
+	m_allocator->Free(bodyNodes);
+
+	Factor();
+
+	return iterativeCount;
+}
+
+void cb2JointTreeSolver::GetJacobian(const cb2JointTreeNode* jointNode, int bodyIndex, float J[3][3]) const
+{
+	cb2Joint* joint = jointNode->joint;
+	float sign = bodyIndex == jointNode->bodyB ? 1.0f : -1.0f;
+
+	if (joint->GetType() == e_revoluteJoint)
+	{
+		// Cdot = vB + cross(wB, rB) - vA - cross(wA, rA)
+		const cb2RevoluteJoint* revolute = (const cb2RevoluteJoint*)joint;
+		ci::Vec2f r = sign > 0.0f ? revolute->m_rB : revolute->m_rA;
+		J[0][0] = sign;
+		J[0][1] = 0.0f;
+		J[0][2] = -sign * r.y;
+		J[1][0] = 0.0f;
+		J[1][1] = sign;
+		J[1][2] = sign * r.x;
+	}
+	else
+	{
+		// Cdot = dot(u, vB + cross(wB, rB) - vA - cross(wA, rA))
+		const cb2DistanceJoint* distance = (const cb2DistanceJoint*)joint;
+		ci::Vec2f r = sign > 0.0f ? distance->m_rB : distance->m_rA;
+		ci::Vec2f u = distance->m_u;
+		J[0][0] = sign * u.x;
+		J[0][1] = sign * u.y;
+		J[0][2] = sign * cb2Cross(r, u);
+	}
+}
+
+// The block of the system in the rows of a node and the columns of its parent.
+void cb2JointTreeSolver::GetOffDiagonal(const cb2JointTreeNode* node, const cb2JointTreeNode* parent, float A[3][3]) const
+{
+	if (node->body == -1)
+	{
+		GetJacobian(node, parent->body, A);
+		return;
+	}
+
+	float J[3][3];
+	GetJacobian(parent, node->body, J);
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < parent->dim; ++j)
+		{
+			A[i][j] = J[j][i];
+		}
+	}
+}
+
+// Block LDL' from the leaves to the roots. The children of a node come after it in
+// the order, so they are done before it.
+void cb2JointTreeSolver::Factor()
+{
+	// The pivot blocks are built in invD and inverted in place.
+	for (int i = 0; i < m_nodeCount; ++i)
+	{
+		cb2JointTreeNode* node = m_nodes + i;
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				node->invD[r][c] = 0.0f;
+			}
+		}
+
+		if (node->body != -1)
+		{
+			node->invD[0][0] = 1.0f / node->invMass;
+			node->invD[1][1] = 1.0f / node->invMass;
+			node->invD[2][2] = 1.0f / node->invI;
+		}
+		else if (node->joint->GetType() == e_distanceJoint)
+		{
+			// The softness of a spring.
+			node->invD[0][0] = -((cb2DistanceJoint*)node->joint)->m_gamma;
+		}
+	}
+
+	for (int k = m_nodeCount - 1; k >= 0; --k)
+	{
+		cb2JointTreeNode* node = m_nodes + m_order[k];
+		float D[3][3];
+		memcpy(D, node->invD, sizeof(D));
+		cb2InvertBlock(D, node->dim, node->invD);
+
+		if (node->parent == -1)
+		{
+			continue;
+		}
+
+		cb2JointTreeNode* parent = m_nodes + node->parent;
+		float A[3][3];
+		GetOffDiagonal(node, parent, A);
+
+		// L = invD * A
+		for (int r = 0; r < node->dim; ++r)
+		{
+			for (int c = 0; c < parent->dim; ++c)
+			{
+				float sum = 0.0f;
+				for (int j = 0; j < node->dim; ++j)
+				{
+					sum += node->invD[r][j] * A[j][c];
+				}
+				node->L[r][c] = sum;
+			}
+		}
+
+		// D(parent) -= A' * L
+		for (int r = 0; r < parent->dim; ++r)
+		{
+			for (int c = 0; c < parent->dim; ++c)
+			{
+				float sum = 0.0f;
+				for (int j = 0; j < node->dim; ++j)
+				{
+					sum += A[j][r] * node->L[j][c];
+				}
+				parent->invD[r][c] -= sum;
+			}
+		}
+	}
+}
+
+void cb2JointTreeSolver::Solve(const cb2SolverData& data)
+{
+	if (m_nodeCount == 0)
+	{
+		return;
+	}
+
+	// The right hand side: zero for the bodies, the velocity error for the joints.
+	for (int i = 0; i < m_nodeCount; ++i)
+	{
+		const cb2JointTreeNode* node = m_nodes + i;
+		float* rhs = m_rhs + 3 * i;
+		rhs[0] = 0.0f;
+		rhs[1] = 0.0f;
+		rhs[2] = 0.0f;
+		if (node->body != -1)
+		{
+			continue;
+		}
+
+		cb2Joint* joint = node->joint;
+		if (joint->GetType() == e_revoluteJoint)
+		{
+			const cb2RevoluteJoint* revolute = (const cb2RevoluteJoint*)joint;
+			const cb2Velocity& velocityA = data.velocities[revolute->m_indexA];
+			const cb2Velocity& velocityB = data.velocities[revolute->m_indexB];
+			ci::Vec2f Cdot = velocityB.v + cb2Cross(velocityB.w, revolute->m_rB) - velocityA.v - cb2Cross(velocityA.w, revolute->m_rA);
+			rhs[0] = -Cdot.x;
+			rhs[1] = -Cdot.y;
+		}
+		else
+		{
+			const cb2DistanceJoint* distance = (const cb2DistanceJoint*)joint;
+			const cb2Velocity& velocityA = data.velocities[distance->m_indexA];
+			const cb2Velocity& velocityB = data.velocities[distance->m_indexB];
+			ci::Vec2f vpA = velocityA.v + cb2Cross(velocityA.w, distance->m_rA);
+			ci::Vec2f vpB = velocityB.v + cb2Cross(velocityB.w, distance->m_rB);
+			float Cdot = cb2Dot(distance->m_u, vpB - vpA);
+			rhs[0] = -(Cdot + distance->m_bias + distance->m_gamma * distance->m_impulse);
+		}
+	}
+
+	// Forward: fold the children into their parents.
+	for (int k = m_nodeCount - 1; k >= 0; --k)
+	{
+		int index = m_order[k];
+		const cb2JointTreeNode* node = m_nodes + index;
+		if (node->parent == -1)
+		{
+			continue;
+		}
+
+		const float* y = m_rhs + 3 * index;
+		float* parentY = m_rhs + 3 * node->parent;
+		int parentDim = m_nodes[node->parent].dim;
+		for (int c = 0; c < parentDim; ++c)
+		{
+			float sum = 0.0f;
+			for (int j = 0; j < node->dim; ++j)
+			{
+				sum += node->L[j][c] * y[j];
+			}
+			parentY[c] -= sum;
+		}
+	}
+
+	// Backward: from the roots to the leaves.
+	for (int k = 0; k < m_nodeCount; ++k)
+	{
+		int index = m_order[k];
+		const cb2JointTreeNode* node = m_nodes + index;
+		const float* y = m_rhs + 3 * index;
+		float* x = m_solution + 3 * index;
+		const float* parentX = node->parent != -1 ? m_solution + 3 * node->parent : NULL;
+		int parentDim = node->parent != -1 ? m_nodes[node->parent].dim : 0;
+		for (int r = 0; r < node->dim; ++r)
+		{
+			float sum = 0.0f;
+			for (int j = 0; j < node->dim; ++j)
+			{
+				sum += node->invD[r][j] * y[j];
+			}
+			for (int j = 0; j < parentDim; ++j)
+			{
+				sum -= node->L[r][j] * parentX[j];
+			}
+			x[r] = sum;
+		}
+	}
+
+	// The body solutions are velocity changes, the joint solutions are negated impulses.
+	for (int i = 0; i < m_nodeCount; ++i)
+	{
+		const cb2JointTreeNode* node = m_nodes + i;
+		const float* x = m_solution + 3 * i;
+		if (node->body != -1)
+		{
+			cb2Velocity& velocity = data.velocities[node->body];
+			velocity.v.x += x[0];
+			velocity.v.y += x[1];
+			velocity.w += x[2];
+		}
+		else if (node->joint->GetType() == e_revoluteJoint)
+		{
+			cb2RevoluteJoint* revolute = (cb2RevoluteJoint*)node->joint;
+			revolute->m_impulse.x -= x[0];
+			revolute->m_impulse.y -= x[1];
+		}
+		else
+		{
+			((cb2DistanceJoint*)node->joint)->m_impulse -= x[0];
+		}
+	}
+}
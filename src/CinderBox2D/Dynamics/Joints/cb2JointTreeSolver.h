@@ -0,0 +1,67 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_JOINT_TREE_SOLVER_H
+#define CB2_JOINT_TREE_SOLVER_H
+
+#include <CinderBox2D/Common/cb2Math.h>
+
+class cb2Joint;
+class cb2StackAllocator;
+struct cb2SolverData;
+struct cb2JointTreeNode;
+struct cb2TreeJointInfo;
+
+/// Solves the velocity constraints of the joints of an island that form a tree
+/// exactly, in linear time. The bodies and joints are the nodes of a tree and the
+/// block system [M J'; J -C] is factored from the leaves to the roots once per step,
+/// after the joints initialized their velocity constraints (Baraff 1996).
+/// Revolute and distance joints are supported. Static and kinematic bodies are
+/// ground, and a tree may hang from ground by one joint. The joints that would
+/// close a loop, revolute joints with a motor or an active limit and the joints of
+/// bodies with fixed rotation are left to the iterative solver.
+class cb2JointTreeSolver
+{
+public:
+	cb2JointTreeSolver(cb2StackAllocator* allocator);
+	~cb2JointTreeSolver();
+
+	/// Pick the tree joints and factor the system. Moves the joints left to the
+	/// iterative solver to the front of the array and returns their count.
+	int Initialize(int bodyCount, cb2Joint** joints, int jointCount, const cb2SolverData& data);
+
+	/// Apply the impulses that satisfy the tree joints given the current velocities.
+	void Solve(const cb2SolverData& data);
+
+private:
+
+	static bool GetJointInfo(cb2Joint* joint, cb2TreeJointInfo* info);
+	void GetJacobian(const cb2JointTreeNode* jointNode, int bodyIndex, float J[3][3]) const;
+	void GetOffDiagonal(const cb2JointTreeNode* node, const cb2JointTreeNode* parent, float A[3][3]) const;
+	void Factor();
+
+	cb2StackAllocator* m_allocator;
+	cb2JointTreeNode* m_nodes;
+
+	// The nodes in breadth first order from the roots, so parents come first.
+	int* m_order;
+	int m_nodeCount;
+	float* m_rhs;
+	float* m_solution;
+};
+
+#endif
@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2MotorJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // Point-to-point constraint
@@ -59,8 +60,8 @@ cb2MotorJoint::cb2MotorJoint(const cb2MotorJointDef* def)
 
 void cb2MotorJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -301,3 +302,15 @@ void cb2MotorJoint::Dump()
 	cb2Log("  jd.correctionFactor = %.15lef;\n", m_correctionFactor);
 	cb2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void cb2MotorJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_linearImpulse);
+	writer->Write(m_angularImpulse);
+}
+
+void cb2MotorJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_linearImpulse);
+	reader->Read(&m_angularImpulse);
+}
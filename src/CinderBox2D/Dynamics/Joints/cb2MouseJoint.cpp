@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2MouseJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // p = attached point, m = mouse point
@@ -95,7 +96,7 @@ float cb2MouseJoint::GetDampingRatio() const
 
 void cb2MouseJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassB = m_bodyB->m_invMass;
 	m_invIB = m_bodyB->m_invI;
@@ -220,3 +221,15 @@ void cb2MouseJoint::ShiftOrigin(const ci::Vec2f& newOrigin)
 {
 	m_targetA -= newOrigin;
 }
+
+void cb2MouseJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_targetA);
+	writer->Write(m_impulse);
+}
+
+void cb2MouseJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_targetA);
+	reader->Read(&m_impulse);
+}
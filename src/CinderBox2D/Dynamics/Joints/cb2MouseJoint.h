@@ -103,6 +103,8 @@ protected:
 	void InitVelocityConstraints(const cb2SolverData& data);
 	void SolveVelocityConstraints(const cb2SolverData& data);
 	bool SolvePositionConstraints(const cb2SolverData& data);
+	void WriteState(cb2SnapshotWriter* writer) const;
+	void ReadState(cb2SnapshotReader* reader);
 
 	ci::Vec2f m_localAnchorB;
 	ci::Vec2f m_targetA;
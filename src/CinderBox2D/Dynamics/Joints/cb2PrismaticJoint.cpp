@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2PrismaticJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // Linear constraint (point-to-line)
@@ -121,8 +122,8 @@ cb2PrismaticJoint::cb2PrismaticJoint(const cb2PrismaticJointDef* def)
 
 void cb2PrismaticJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -618,3 +619,17 @@ void cb2PrismaticJoint::Dump()
 	cb2Log("  jd.maxMotorForce = %.15lef;\n", m_maxMotorForce);
 	cb2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void cb2PrismaticJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_impulse);
+	writer->Write(m_motorImpulse);
+	writer->Write(m_limitState);
+}
+
+void cb2PrismaticJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_impulse);
+	reader->Read(&m_motorImpulse);
+	reader->Read(&m_limitState);
+}
@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2PulleyJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // Pulley:
@@ -72,8 +73,8 @@ cb2PulleyJoint::cb2PulleyJoint(const cb2PulleyJointDef* def)
 
 void cb2PulleyJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -346,3 +347,13 @@ void cb2PulleyJoint::ShiftOrigin(const ci::Vec2f& newOrigin)
 	m_groundAnchorA -= newOrigin;
 	m_groundAnchorB -= newOrigin;
 }
+
+void cb2PulleyJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_impulse);
+}
+
+void cb2PulleyJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_impulse);
+}
@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2RevoluteJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // Point-to-point constraint
@@ -62,8 +63,8 @@ cb2RevoluteJoint::cb2RevoluteJoint(const cb2RevoluteJointDef* def)
 
 void cb2RevoluteJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -501,3 +502,17 @@ void cb2RevoluteJoint::Dump()
 	cb2Log("  jd.maxMotorTorque = %.15lef;\n", m_maxMotorTorque);
 	cb2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void cb2RevoluteJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_impulse);
+	writer->Write(m_motorImpulse);
+	writer->Write(m_limitState);
+}
+
+void cb2RevoluteJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_impulse);
+	reader->Read(&m_motorImpulse);
+	reader->Read(&m_limitState);
+}
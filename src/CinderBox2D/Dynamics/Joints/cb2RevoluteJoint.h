@@ -157,6 +157,7 @@ public:
 protected:
 	
 	friend class cb2Joint;
+	friend class cb2JointTreeSolver;
 	friend class cb2GearJoint;
 
 	cb2RevoluteJoint(const cb2RevoluteJointDef* def);
@@ -164,6 +165,8 @@ protected:
 	void InitVelocityConstraints(const cb2SolverData& data);
 	void SolveVelocityConstraints(const cb2SolverData& data);
 	bool SolvePositionConstraints(const cb2SolverData& data);
+	void WriteState(cb2SnapshotWriter* writer) const;
+	void ReadState(cb2SnapshotReader* reader);
 
 	// Solver shared
 	ci::Vec2f m_localAnchorA;
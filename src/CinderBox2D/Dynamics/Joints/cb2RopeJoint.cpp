@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2RopeJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 
@@ -45,8 +46,8 @@ cb2RopeJoint::cb2RopeJoint(const cb2RopeJointDef* def)
 
 void cb2RopeJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -240,3 +241,15 @@ void cb2RopeJoint::Dump()
 	cb2Log("  jd.maxLength = %.15lef;\n", m_maxLength);
 	cb2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void cb2RopeJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_impulse);
+	writer->Write(m_state);
+}
+
+void cb2RopeJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_impulse);
+	reader->Read(&m_state);
+}
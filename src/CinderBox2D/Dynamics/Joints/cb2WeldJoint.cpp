@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2WeldJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // Point-to-point constraint
@@ -57,8 +58,8 @@ cb2WeldJoint::cb2WeldJoint(const cb2WeldJointDef* def)
 
 void cb2WeldJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -326,3 +327,13 @@ void cb2WeldJoint::Dump()
 	cb2Log("  jd.dampingRatio = %.15lef;\n", m_dampingRatio);
 	cb2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void cb2WeldJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_impulse);
+}
+
+void cb2WeldJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_impulse);
+}
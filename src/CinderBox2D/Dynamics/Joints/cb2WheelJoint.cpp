@@ -18,6 +18,7 @@
 
 #include <CinderBox2D/Dynamics/Joints/cb2WheelJoint.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
 
 // Linear constraint (point-to-line)
@@ -76,8 +77,8 @@ cb2WheelJoint::cb2WheelJoint(const cb2WheelJointDef* def)
 
 void cb2WheelJoint::InitVelocityConstraints(const cb2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->GetIslandIndex(data.staticBodies, data.staticCount);
+	m_indexB = m_bodyB->GetIslandIndex(data.staticBodies, data.staticCount);
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -417,3 +418,17 @@ void cb2WheelJoint::Dump()
 	cb2Log("  jd.dampingRatio = %.15lef;\n", m_dampingRatio);
 	cb2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void cb2WheelJoint::WriteState(cb2SnapshotWriter* writer) const
+{
+	writer->Write(m_impulse);
+	writer->Write(m_motorImpulse);
+	writer->Write(m_springImpulse);
+}
+
+void cb2WheelJoint::ReadState(cb2SnapshotReader* reader)
+{
+	reader->Read(&m_impulse);
+	reader->Read(&m_motorImpulse);
+	reader->Read(&m_springImpulse);
+}
@@ -18,6 +18,8 @@
 
 #include <CinderBox2D/Dynamics/cb2Body.h>
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2RayQueries.h>
+#include <CinderBox2D/Dynamics/cb2SensorManager.h>
 #include <CinderBox2D/Dynamics/cb2World.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
 #include <CinderBox2D/Dynamics/Joints/cb2Joint.h>
@@ -58,6 +60,8 @@ cb2Body::cb2Body(const cb2BodyDef* bd, cb2World* world)
 
 	m_xf.p = bd->position;
 	m_xf.q.set(bd->angle);
+	m_xf0 = m_xf;
+	m_xf0Step = -1;
 
 	m_sweep.c0 = m_xf.p;
 	m_sweep.c = m_xf.p;
@@ -70,6 +74,16 @@ cb2Body::cb2Body(const cb2BodyDef* bd, cb2World* world)
 	m_prev = NULL;
 	m_next = NULL;
 
+	m_persistentIsland = NULL;
+	m_islandPrev = NULL;
+	m_islandNext = NULL;
+	m_awakeIndex = -1;
+	m_targetDriveList = -1;
+	m_id = -1;
+	m_lodLevel = -1;
+	m_currentLod = 0;
+	m_solveDebt = 0.0f;
+
 	m_linearVelocity = bd->linearVelocity;
 	m_angularVelocity = bd->angularVelocity;
 
@@ -136,6 +150,9 @@ void cb2Body::SetType(cb2BodyType type)
 
 	SetAwake(true);
 
+	// A static body may have been awake already.
+	AddToAwakeSet();
+
 	cb2::setZero(m_force);
 	m_torque = 0.0f;
 
@@ -149,11 +166,49 @@ void cb2Body::SetType(cb2BodyType type)
 	}
 	m_contactList = NULL;
 
+	// Static bodies are not part of persistent islands.
+	if (m_world->m_persistentIslands)
+	{
+		cb2IslandGraph* graph = &m_world->m_islandGraph;
+		for (cb2JointEdge* je = m_jointList; je; je = je->next)
+		{
+			if (je->joint->m_persistentIsland)
+			{
+				graph->UnlinkJoint(je->joint);
+			}
+		}
+
+		if (m_persistentIsland)
+		{
+			graph->RemoveBody(this);
+		}
+
+		if (m_type != cb2_staticBody)
+		{
+			graph->AddBody(this);
+		}
+
+		for (cb2JointEdge* je = m_jointList; je; je = je->next)
+		{
+			graph->LinkJoint(je->joint);
+		}
+	}
+
 	// Touch the proxies so that new contacts will be created (when appropriate)
+	// Proxies stay in the static tree only while the body is static.
 	cb2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+	bool isStatic = m_type == cb2_staticBody && broadPhase->GetStaticTree();
 	for (cb2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
 		int proxyCount = f->m_proxyCount;
+		if (proxyCount > 0 && cb2BroadPhase::IsStaticProxy(f->m_proxies[0].proxyId) != isStatic)
+		{
+			f->DestroyProxies(broadPhase);
+			f->CreateProxies(broadPhase, m_xf);
+			continue;
+		}
+
+		f->UpdateProxyKeys(broadPhase);
 		for (int i = 0; i < proxyCount; ++i)
 		{
 			broadPhase->TouchProxy(f->m_proxies[i].proxyId);
@@ -161,6 +216,26 @@ void cb2Body::SetType(cb2BodyType type)
 	}
 }
 
+void cb2Body::AddToAwakeSet()
+{
+	if (m_world->m_awakeBodies == NULL || m_type == cb2_staticBody)
+	{
+		return;
+	}
+
+	if (m_awakeIndex == -1)
+	{
+		m_world->AddAwakeBody(this);
+	}
+
+	// The contacts may have left the set while the body was asleep.
+	cb2ContactManager* contactManager = &m_world->m_contactManager;
+	for (cb2ContactEdge* ce = m_contactList; ce; ce = ce->next)
+	{
+		contactManager->AddAwakeContact(ce->contact);
+	}
+}
+
 cb2Fixture* cb2Body::CreateFixture(const cb2FixtureDef* def)
 {
 	cb2Assert(m_world->IsLocked() == false);
@@ -169,9 +244,22 @@ cb2Fixture* cb2Body::CreateFixture(const cb2FixtureDef* def)
 		return NULL;
 	}
 
+	void* memory = m_world->m_blockAllocator.Allocate(sizeof(cb2Fixture));
+	cb2Fixture* fixture = CreateFixture(memory, def);
+
+	// Adjust mass properties if needed.
+	if (fixture->m_density > 0.0f)
+	{
+		InvalidateMassData();
+	}
+
+	return fixture;
+}
+
+cb2Fixture* cb2Body::CreateFixture(void* memory, const cb2FixtureDef* def)
+{
 	cb2BlockAllocator* allocator = &m_world->m_blockAllocator;
 
-	void* memory = allocator->Allocate(sizeof(cb2Fixture));
 	cb2Fixture* fixture = new (memory) cb2Fixture;
 	fixture->Create(allocator, this, def);
 
@@ -181,18 +269,17 @@ cb2Fixture* cb2Body::CreateFixture(const cb2FixtureDef* def)
 		fixture->CreateProxies(broadPhase, m_xf);
 	}
 
+	if (fixture->m_isSensor && m_world->m_sensorManager)
+	{
+		m_world->m_sensorManager->AddSensor(fixture);
+	}
+
 	fixture->m_next = m_fixtureList;
 	m_fixtureList = fixture;
 	++m_fixtureCount;
 
 	fixture->m_body = this;
 
-	// Adjust mass properties if needed.
-	if (fixture->m_density > 0.0f)
-	{
-		ResetMassData();
-	}
-
 	// Let the world know we have a new fixture. This will cause new contacts
 	// to be created at the beginning of the next time step.
 	m_world->m_flags |= cb2World::e_newFixture;
@@ -256,6 +343,16 @@ void cb2Body::DestroyFixture(cb2Fixture* fixture)
 		}
 	}
 
+	if (m_world->m_sensorManager)
+	{
+		m_world->m_sensorManager->RemoveFixture(fixture, m_world->m_contactManager.m_contactListener);
+	}
+
+	if (m_world->m_rayQueries)
+	{
+		m_world->m_rayQueries->RemoveFixture(fixture);
+	}
+
 	cb2BlockAllocator* allocator = &m_world->m_blockAllocator;
 
 	if (m_flags & e_activeFlag)
@@ -273,11 +370,52 @@ void cb2Body::DestroyFixture(cb2Fixture* fixture)
 	--m_fixtureCount;
 
 	// Reset the mass data.
+	InvalidateMassData();
+}
+
+void cb2Body::InvalidateMassData()
+{
+	if (m_flags & e_editFlag)
+	{
+		m_flags |= e_massDirtyFlag;
+		m_world->m_flags |= cb2World::e_massDirty;
+		return;
+	}
+
 	ResetMassData();
 }
 
+void cb2Body::BeginFixtureEdit()
+{
+	cb2Assert(m_world->IsLocked() == false);
+	cb2Assert((m_flags & e_editFlag) == 0);
+	if (m_world->IsLocked() == true)
+	{
+		return;
+	}
+
+	m_flags |= e_editFlag;
+}
+
+void cb2Body::EndFixtureEdit()
+{
+	cb2Assert(m_world->IsLocked() == false);
+	if (m_world->IsLocked() == true)
+	{
+		return;
+	}
+
+	m_flags &= ~e_editFlag;
+	if (m_flags & e_massDirtyFlag)
+	{
+		ResetMassData();
+	}
+}
+
 void cb2Body::ResetMassData()
 {
+	m_flags &= ~e_massDirtyFlag;
+
 	// Compute mass data from shapes. Each shape has its own density.
 	m_mass = 0.0f;
 	m_invMass = 0.0f;
@@ -361,6 +499,9 @@ void cb2Body::SetMassData(const cb2MassData* massData)
 		return;
 	}
 
+	// The given mass replaces any pending update from the fixtures.
+	m_flags &= ~e_massDirtyFlag;
+
 	m_invMass = 0.0f;
 	m_I = 0.0f;
 	m_invI = 0.0f;
@@ -422,6 +563,7 @@ void cb2Body::SetTransform(const ci::Vec2f& position, float angle)
 
 	m_xf.q.set(angle);
 	m_xf.p = position;
+	m_xf0 = m_xf;
 
 	m_sweep.c = cb2Mul(m_xf, m_sweep.localCenter);
 	m_sweep.a = angle;
@@ -436,6 +578,34 @@ void cb2Body::SetTransform(const ci::Vec2f& position, float angle)
 	}
 }
 
+const cb2Transform& cb2Body::GetPreviousTransform() const
+{
+	return m_xf0Step == m_world->m_stepCount - 1 ? m_xf0 : m_xf;
+}
+
+cb2Transform cb2Body::GetInterpolatedTransform(float alpha) const
+{
+	const cb2Transform& xf0 = GetPreviousTransform();
+	cb2Transform xf;
+	xf.p = (1.0f - alpha) * xf0.p + alpha * m_xf.p;
+
+	// Blend the rotations and normalize, this is close to blending the angles for
+	// the small turns of one step.
+	float s = (1.0f - alpha) * xf0.q.s + alpha * m_xf.q.s;
+	float c = (1.0f - alpha) * xf0.q.c + alpha * m_xf.q.c;
+	float length = cb2Sqrt(s * s + c * c);
+	if (length > cb2_epsilon)
+	{
+		xf.q.s = s / length;
+		xf.q.c = c / length;
+	}
+	else
+	{
+		xf.q = m_xf.q;
+	}
+	return xf;
+}
+
 void cb2Body::SetPosition(ci::Vec2f& position)
 {
 	cb2Assert(m_world->IsLocked() == false);
@@ -445,6 +615,7 @@ void cb2Body::SetPosition(ci::Vec2f& position)
 	}
 
 	m_xf.p     = position;
+	m_xf0      = m_xf;
 	m_sweep.c  = cb2Mul(m_xf, m_sweep.localCenter);
 	m_sweep.c0 = m_sweep.c;
 
@@ -468,6 +639,19 @@ void cb2Body::SynchronizeFixtures()
 	}
 }
 
+void cb2Body::SynchronizeFixtures(const ci::Vec2f& prediction)
+{
+	cb2Transform xf1;
+	xf1.q.set(m_sweep.a0);
+	xf1.p = m_sweep.c0 - cb2Mul(xf1.q, m_sweep.localCenter);
+
+	cb2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+	for (cb2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		f->Synchronize(broadPhase, xf1, m_xf, prediction);
+	}
+}
+
 void cb2Body::SetActive(bool flag)
 {
 	cb2Assert(m_world->IsLocked() == false);
@@ -494,14 +678,7 @@ void cb2Body::SetActive(bool flag)
 	{
 		m_flags &= ~e_activeFlag;
 
-		// Destroy all proxies.
-		cb2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
-		for (cb2Fixture* f = m_fixtureList; f; f = f->m_next)
-		{
-			f->DestroyProxies(broadPhase);
-		}
-
-		// Destroy the attached contacts.
+		// Destroy the attached contacts first. They are found by their proxy ids.
 		cb2ContactEdge* ce = m_contactList;
 		while (ce)
 		{
@@ -510,6 +687,13 @@ void cb2Body::SetActive(bool flag)
 			m_world->m_contactManager.Destroy(ce0->contact);
 		}
 		m_contactList = NULL;
+
+		// Destroy all proxies.
+		cb2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+		for (cb2Fixture* f = m_fixtureList; f; f = f->m_next)
+		{
+			f->DestroyProxies(broadPhase);
+		}
 	}
 }
 
@@ -21,6 +21,7 @@
 
 #include <CinderBox2D/Common/cb2Math.h>
 #include <CinderBox2D/Collision/Shapes/cb2Shape.h>
+#include <CinderBox2D/Dynamics/cb2IslandGraph.h>
 #include <memory>
 
 class cb2Fixture;
@@ -164,6 +165,13 @@ public:
 	/// Get the body transform for the body's origin.
 	/// @return the world transform of the body's origin.
 	const cb2Transform& GetTransform() const;
+
+	/// Get the body transform before the last step run by cb2World::Advance. This is the
+	/// current transform if the body did not move in that step.
+	const cb2Transform& GetPreviousTransform() const;
+
+	/// Blend the previous and the current transform, see cb2World::GetInterpolationAlpha.
+	cb2Transform GetInterpolatedTransform(float alpha) const;
   
 	/// Set the world body origin position.
 	/// @param position the world position of the body's local origin.
@@ -256,6 +264,19 @@ public:
 	/// the mass and you later want to reset the mass.
 	void ResetMassData();
 
+	/// Begin adding or destroying many fixtures. Until EndFixtureEdit, CreateFixture and
+	/// DestroyFixture do not update the mass, so building a body of N fixtures computes
+	/// the mass once instead of N times. The mass is stale while editing. If the edit is
+	/// still open at the next time step, the step updates the mass.
+	/// @warning This function is locked during callbacks.
+	void BeginFixtureEdit();
+
+	/// End the fixture edit and update the mass if any fixture changed it.
+	void EndFixtureEdit();
+
+	/// Is a fixture edit open?
+	bool IsEditingFixtures() const;
+
 	/// Get the world coordinates of a point given the local coordinates.
 	/// @param localPoint a point on the body measured relative the the body's origin.
 	/// @return the same point expressed in world coordinates.
@@ -316,6 +337,19 @@ public:
 	/// Is this body treated like a bullet for continuous collision detection?
 	bool IsBullet() const;
 
+	/// Set the level of detail of this body, see cb2World::SetLodLevels. Use 0 for full
+	/// detail, a level of the world, or -1 to pick the level from the distance to the
+	/// nearest observer, which is the default.
+	void SetLodLevel(int level) { cb2Assert(level >= -1 && level <= cb2_maxLodLevels); m_lodLevel = level; }
+	int GetLodLevel() const { return m_lodLevel; }
+
+	/// Get the level of detail the island of this body was solved with in the last step.
+	int GetCurrentLod() const { return m_currentLod; }
+
+	/// Get the simulated time this body is behind the world, in seconds. This is the
+	/// time owed to the islands deferred by the solve budget, see cb2World::SetSolveBudget.
+	float GetSolveDebt() const { return m_solveDebt; }
+
 	/// You can disable sleeping on this body. If you disable sleeping, the
 	/// body will be woken.
 	void SetSleepingAllowed(bool flag);
@@ -385,6 +419,11 @@ public:
 	cb2World* GetWorld();
 	const cb2World* GetWorld() const;
 
+	/// Get the id of this body, in [0, cb2World::GetBodyIdCount()). The id does not
+	/// change while the body exists, and the ids of destroyed bodies are reused, so
+	/// they can index arrays kept next to the world.
+	int GetId() const { return m_id; }
+
 	/// Dump this body to a log file
 	void Dump();
 
@@ -395,6 +434,10 @@ private:
 	friend class cb2ContactManager;
 	friend class cb2ContactSolver;
 	friend class cb2Contact;
+	friend class cb2TOIScheduler;
+	friend class cb2TargetDrives;
+	friend struct cb2SensorQuery;
+	friend class cb2SynchronizeFixturesTask;
 	
 	friend class cb2DistanceJoint;
 	friend class cb2FrictionJoint;
@@ -407,6 +450,7 @@ private:
 	friend class cb2RopeJoint;
 	friend class cb2WeldJoint;
 	friend class cb2WheelJoint;
+	friend class cb2IslandGraph;
 
 	// m_flags
 	enum
@@ -417,15 +461,36 @@ private:
 		e_bulletFlag		= 0x0008,
 		e_fixedRotationFlag	= 0x0010,
 		e_activeFlag		= 0x0020,
-		e_toiFlag			= 0x0040
+		e_toiFlag			= 0x0040,
+		e_exportFlag		= 0x0080,
+		e_lodFlag			= 0x0100,	// out of continuous collision in this step
+		e_editFlag			= 0x0200,	// inside BeginFixtureEdit/EndFixtureEdit
+		e_massDirtyFlag		= 0x0400	// the mass waits for ResetMassData
 	};
 
 	cb2Body(const cb2BodyDef* bd, cb2World* world);
 	~cb2Body();
 
+	// Update the mass now, or at the end of the fixture edit.
+	void InvalidateMassData();
+
+	// Create a fixture in the given block without resetting the mass data.
+	cb2Fixture* CreateFixture(void* memory, const cb2FixtureDef* def);
+
 	void SynchronizeFixtures();
+
+	// Add a woken body and its contacts to the awake sets of the world, if it keeps them.
+	void AddToAwakeSet();
+
+	// Same as above, also covering the fixtures moved by the given translation.
+	void SynchronizeFixtures(const ci::Vec2f& prediction);
 	void SynchronizeTransform();
 
+	// Get the slot of this body in the island arrays. Static bodies shared with
+	// islands solved on other threads are sorted at the front of the island
+	// instead of carrying an island index.
+	int GetIslandIndex(cb2Body* const* staticBodies, int staticCount) const;
+
 	// This is used to prevent connected bodies from colliding.
 	// It may lie, depending on the collideConnected flag.
 	bool ShouldCollide(const cb2Body* other) const;
@@ -438,7 +503,29 @@ private:
 
 	int m_islandIndex;
 
+	// The persistent island of a non-static body. See cb2World::SetPersistentIslands.
+	cb2PersistentIsland* m_persistentIsland;
+	cb2Body* m_islandPrev;
+	cb2Body* m_islandNext;
+
+	// Index in the awake bodies of the world, or -1. See cb2World::SetAwakeSets.
+	int m_awakeIndex;
+
+	// The first target drive of the body, or -1. See cb2World::CreateTargetDrive.
+	int m_targetDriveList;
+
+	int m_id;
+
+	// The level of detail set by the user and the one of the last step.
+	int m_lodLevel;
+	int m_currentLod;
+
+	// The time owed by the solve budget.
+	float m_solveDebt;
+
 	cb2Transform m_xf;		// the body origin transform
+	cb2Transform m_xf0;		// the transform before the step m_xf0Step, see cb2World::Advance
+	int m_xf0Step;
 	cb2Sweep m_sweep;		// the swept motion for CCD
 
 	ci::Vec2f m_linearVelocity;
@@ -630,6 +717,11 @@ inline void cb2Body::SetBullet(bool flag)
 	}
 }
 
+inline bool cb2Body::IsEditingFixtures() const
+{
+	return (m_flags & e_editFlag) == e_editFlag;
+}
+
 inline bool cb2Body::IsBullet() const
 {
 	return (m_flags & e_bulletFlag) == e_bulletFlag;
@@ -643,6 +735,11 @@ inline void cb2Body::SetAwake(bool flag)
 		{
 			m_flags |= e_awakeFlag;
 			m_sleepTime = 0.0f;
+			if (m_persistentIsland)
+			{
+				m_persistentIsland->awake = true;
+			}
+			AddToAwakeSet();
 		}
 	}
 	else
@@ -842,6 +939,32 @@ inline void cb2Body::SynchronizeTransform()
 	m_xf.p = m_sweep.c - cb2Mul(m_xf.q, m_sweep.localCenter);
 }
 
+inline int cb2Body::GetIslandIndex(cb2Body* const* staticBodies, int staticCount) const
+{
+	if (m_type != cb2_staticBody || staticCount == 0)
+	{
+		return m_islandIndex;
+	}
+
+	int low = 0;
+	int high = staticCount - 1;
+	while (low < high)
+	{
+		int mid = (low + high) >> 1;
+		if (staticBodies[mid] < this)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	cb2Assert(staticBodies[low] == this);
+	return low;
+}
+
 inline void cb2Body::Advance(float alpha)
 {
 	// Advance to the new safe time. This doesn't sync the broad-phase.
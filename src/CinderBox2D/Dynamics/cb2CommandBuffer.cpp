@@ -0,0 +1,431 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2CommandBuffer.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
+#include <CinderBox2D/Dynamics/Joints/cb2DistanceJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2FrictionJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2GearJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2MotorJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2MouseJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2PrismaticJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2PulleyJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2RevoluteJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2RopeJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2WeldJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2WheelJoint.h>
+#include <CinderBox2D/Collision/cb2BroadPhase.h>
+#include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2HeightfieldShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CompoundShape.h>
+#include <string.h>
+
+// Building the tree top-down costs about as much as inserting a quarter of the proxies
+// it already holds, so smaller batches are inserted one by one.
+static const int cb2_minBulkProxyCount = 64;
+static const int cb2_bulkProxyRatio = 4;
+
+template <typename T>
+static void cb2Grow(T** array, int count, int* capacity)
+{
+	if (count < *capacity)
+	{
+		return;
+	}
+
+	T* oldArray = *array;
+	*capacity = cb2Max(2 * *capacity, 16);
+	*array = (T*)cb2Alloc(*capacity * sizeof(T));
+	if (oldArray)
+	{
+		memcpy(*array, oldArray, count * sizeof(T));
+		cb2Free(oldArray);
+	}
+}
+
+static int cb2GetJointDefSize(cb2JointType type)
+{
+	switch (type)
+	{
+	case e_revoluteJoint:	return sizeof(cb2RevoluteJointDef);
+	case e_prismaticJoint:	return sizeof(cb2PrismaticJointDef);
+	case e_distanceJoint:	return sizeof(cb2DistanceJointDef);
+	case e_pulleyJoint:		return sizeof(cb2PulleyJointDef);
+	case e_mouseJoint:		return sizeof(cb2MouseJointDef);
+	case e_gearJoint:		return sizeof(cb2GearJointDef);
+	case e_wheelJoint:		return sizeof(cb2WheelJointDef);
+	case e_weldJoint:		return sizeof(cb2WeldJointDef);
+	case e_frictionJoint:	return sizeof(cb2FrictionJointDef);
+	case e_ropeJoint:		return sizeof(cb2RopeJointDef);
+	case e_motorJoint:		return sizeof(cb2MotorJointDef);
+	default:
+		cb2Assert(false);
+		return 0;
+	}
+}
+
+// Free a shape copied with cb2Shape::Clone, as cb2Fixture::Destroy does.
+static void cb2FreeShape(cb2Shape* shape, cb2BlockAllocator* allocator)
+{
+	switch (shape->m_type)
+	{
+	case cb2Shape::e_circle:
+		{
+			cb2CircleShape* s = (cb2CircleShape*)shape;
+			s->~cb2CircleShape();
+			allocator->Free(s, sizeof(cb2CircleShape));
+		}
+		break;
+
+	case cb2Shape::e_edge:
+		{
+			cb2EdgeShape* s = (cb2EdgeShape*)shape;
+			s->~cb2EdgeShape();
+			allocator->Free(s, sizeof(cb2EdgeShape));
+		}
+		break;
+
+	case cb2Shape::e_polygon:
+		{
+			cb2PolygonShape* s = (cb2PolygonShape*)shape;
+			s->~cb2PolygonShape();
+			allocator->Free(s, sizeof(cb2PolygonShape));
+		}
+		break;
+
+	case cb2Shape::e_chain:
+		{
+			cb2ChainShape* s = (cb2ChainShape*)shape;
+			s->~cb2ChainShape();
+			allocator->Free(s, sizeof(cb2ChainShape));
+		}
+		break;
+
+	case cb2Shape::e_capsule:
+		{
+			cb2CapsuleShape* s = (cb2CapsuleShape*)shape;
+			s->~cb2CapsuleShape();
+			allocator->Free(s, sizeof(cb2CapsuleShape));
+		}
+		break;
+
+	case cb2Shape::e_heightfield:
+		{
+			cb2HeightfieldShape* s = (cb2HeightfieldShape*)shape;
+			s->~cb2HeightfieldShape();
+			allocator->Free(s, sizeof(cb2HeightfieldShape));
+		}
+		break;
+
+	case cb2Shape::e_compound:
+		{
+			cb2CompoundShape* s = (cb2CompoundShape*)shape;
+			s->~cb2CompoundShape();
+			allocator->Free(s, sizeof(cb2CompoundShape));
+		}
+		break;
+
+	default:
+		cb2Assert(false);
+		break;
+	}
+}
+
+cb2CommandBuffer::cb2CommandBuffer()
+{
+	m_bodies = NULL;
+	m_bodyCount = 0;
+	m_bodyCapacity = 0;
+
+	m_fixtures = NULL;
+	m_fixtureCount = 0;
+	m_fixtureCapacity = 0;
+
+	m_joints = NULL;
+	m_jointCount = 0;
+	m_jointCapacity = 0;
+
+	m_appliedBodyCount = 0;
+	m_appliedFixtureCount = 0;
+	m_appliedJointCount = 0;
+
+	m_destroyBodies = NULL;
+	m_destroyBodyCount = 0;
+	m_destroyBodyCapacity = 0;
+
+	m_destroyFixtures = NULL;
+	m_destroyFixtureCount = 0;
+	m_destroyFixtureCapacity = 0;
+
+	m_destroyJoints = NULL;
+	m_destroyJointCount = 0;
+	m_destroyJointCapacity = 0;
+}
+
+cb2CommandBuffer::~cb2CommandBuffer()
+{
+	FreeQueued();
+	cb2Free(m_bodies);
+	cb2Free(m_fixtures);
+	cb2Free(m_joints);
+	cb2Free(m_destroyBodies);
+	cb2Free(m_destroyFixtures);
+	cb2Free(m_destroyJoints);
+}
+
+int cb2CommandBuffer::CreateBody(const cb2BodyDef* def)
+{
+	cb2Grow(&m_bodies, m_bodyCount, &m_bodyCapacity);
+	cb2QueuedBody* queued = m_bodies + m_bodyCount;
+	queued->def = *def;
+	queued->body = NULL;
+	return m_bodyCount++;
+}
+
+int cb2CommandBuffer::CreateFixture(int bodyHandle, const cb2FixtureDef* def)
+{
+	cb2Assert(0 <= bodyHandle && bodyHandle < m_bodyCount);
+	cb2Assert(def->shape != NULL);
+
+	cb2Grow(&m_fixtures, m_fixtureCount, &m_fixtureCapacity);
+	cb2QueuedFixture* queued = m_fixtures + m_fixtureCount;
+	queued->def = *def;
+	queued->def.shape = def->shape->Clone(&m_allocator);
+	queued->body = NULL;
+	queued->bodyHandle = bodyHandle;
+	queued->fixture = NULL;
+	return m_fixtureCount++;
+}
+
+int cb2CommandBuffer::CreateFixture(cb2Body* body, const cb2FixtureDef* def)
+{
+	cb2Assert(body != NULL);
+	cb2Assert(def->shape != NULL);
+
+	cb2Grow(&m_fixtures, m_fixtureCount, &m_fixtureCapacity);
+	cb2QueuedFixture* queued = m_fixtures + m_fixtureCount;
+	queued->def = *def;
+	queued->def.shape = def->shape->Clone(&m_allocator);
+	queued->body = body;
+	queued->bodyHandle = -1;
+	queued->fixture = NULL;
+	return m_fixtureCount++;
+}
+
+int cb2CommandBuffer::CreateJoint(const cb2JointDef* def, int bodyHandleA, int bodyHandleB)
+{
+	cb2Assert(-1 <= bodyHandleA && bodyHandleA < m_bodyCount);
+	cb2Assert(-1 <= bodyHandleB && bodyHandleB < m_bodyCount);
+
+	int size = cb2GetJointDefSize(def->type);
+	void* mem = m_allocator.Allocate(size);
+	memcpy(mem, def, size);
+
+	cb2Grow(&m_joints, m_jointCount, &m_jointCapacity);
+	cb2QueuedJoint* queued = m_joints + m_jointCount;
+	queued->def = (cb2JointDef*)mem;
+	queued->bodyHandleA = bodyHandleA;
+	queued->bodyHandleB = bodyHandleB;
+	queued->joint = NULL;
+	return m_jointCount++;
+}
+
+void cb2CommandBuffer::DestroyBody(cb2Body* body)
+{
+	cb2Assert(body != NULL);
+	cb2Grow(&m_destroyBodies, m_destroyBodyCount, &m_destroyBodyCapacity);
+	m_destroyBodies[m_destroyBodyCount++] = body;
+}
+
+void cb2CommandBuffer::DestroyFixture(cb2Fixture* fixture)
+{
+	cb2Assert(fixture != NULL);
+	cb2Grow(&m_destroyFixtures, m_destroyFixtureCount, &m_destroyFixtureCapacity);
+	m_destroyFixtures[m_destroyFixtureCount++] = fixture;
+}
+
+void cb2CommandBuffer::DestroyJoint(cb2Joint* joint)
+{
+	cb2Assert(joint != NULL);
+	cb2Grow(&m_destroyJoints, m_destroyJointCount, &m_destroyJointCapacity);
+	m_destroyJoints[m_destroyJointCount++] = joint;
+}
+
+void cb2CommandBuffer::Apply(cb2World* world)
+{
+	cb2Assert(world->IsLocked() == false);
+	if (world->IsLocked())
+	{
+		return;
+	}
+
+	for (int i = 0; i < m_destroyJointCount; ++i)
+	{
+		world->DestroyJoint(m_destroyJoints[i]);
+	}
+	m_destroyJointCount = 0;
+
+	for (int i = 0; i < m_destroyFixtureCount; ++i)
+	{
+		cb2Fixture* fixture = m_destroyFixtures[i];
+		fixture->GetBody()->DestroyFixture(fixture);
+	}
+	m_destroyFixtureCount = 0;
+
+	world->DestroyBodies(m_destroyBodies, m_destroyBodyCount);
+	m_destroyBodyCount = 0;
+
+	for (int i = m_appliedBodyCount; i < m_bodyCount; ++i)
+	{
+		m_bodies[i].body = world->CreateBody(&m_bodies[i].def);
+	}
+	m_appliedBodyCount = m_bodyCount;
+
+	// Count the proxies to create, to choose between inserting and building the tree.
+	int proxyCount = 0;
+	for (int i = m_appliedFixtureCount; i < m_fixtureCount; ++i)
+	{
+		proxyCount += m_fixtures[i].def.shape->GetChildCount();
+	}
+
+	cb2BroadPhase* broadPhase = &world->m_contactManager.m_broadPhase;
+	bool bulk = broadPhase->IsBulkCreating() == false && proxyCount >= cb2_minBulkProxyCount &&
+				cb2_bulkProxyRatio * proxyCount >= broadPhase->GetProxyCount();
+	if (bulk)
+	{
+		broadPhase->BeginBulkCreate();
+	}
+
+	for (int i = m_appliedFixtureCount; i < m_fixtureCount; ++i)
+	{
+		cb2QueuedFixture* queued = m_fixtures + i;
+		if (queued->bodyHandle != -1)
+		{
+			queued->body = m_bodies[queued->bodyHandle].body;
+		}
+
+		// The mass of each body is computed once after all of its fixtures.
+		queued->endEdit = queued->body->IsEditingFixtures() == false;
+		if (queued->endEdit)
+		{
+			queued->body->BeginFixtureEdit();
+		}
+
+		queued->fixture = queued->body->CreateFixture(&queued->def);
+
+		// The fixture has its own copy of the shape.
+		cb2FreeShape(const_cast<cb2Shape*>(queued->def.shape), &m_allocator);
+		queued->def.shape = NULL;
+	}
+
+	for (int i = m_appliedFixtureCount; i < m_fixtureCount; ++i)
+	{
+		cb2QueuedFixture* queued = m_fixtures + i;
+		if (queued->endEdit)
+		{
+			queued->body->EndFixtureEdit();
+		}
+	}
+	m_appliedFixtureCount = m_fixtureCount;
+
+	if (bulk)
+	{
+		broadPhase->EndBulkCreate();
+	}
+
+	for (int i = m_appliedJointCount; i < m_jointCount; ++i)
+	{
+		cb2QueuedJoint* queued = m_joints + i;
+		cb2JointDef* def = queued->def;
+		if (queued->bodyHandleA != -1)
+		{
+			def->bodyA = m_bodies[queued->bodyHandleA].body;
+		}
+
+		if (queued->bodyHandleB != -1)
+		{
+			def->bodyB = m_bodies[queued->bodyHandleB].body;
+		}
+
+		queued->joint = world->CreateJoint(def);
+
+		m_allocator.Free(def, cb2GetJointDefSize(def->type));
+		queued->def = NULL;
+	}
+	m_appliedJointCount = m_jointCount;
+}
+
+cb2Body* cb2CommandBuffer::GetBody(int handle) const
+{
+	cb2Assert(0 <= handle && handle < m_bodyCount);
+	return m_bodies[handle].body;
+}
+
+cb2Fixture* cb2CommandBuffer::GetFixture(int handle) const
+{
+	cb2Assert(0 <= handle && handle < m_fixtureCount);
+	return m_fixtures[handle].fixture;
+}
+
+cb2Joint* cb2CommandBuffer::GetJoint(int handle) const
+{
+	cb2Assert(0 <= handle && handle < m_jointCount);
+	return m_joints[handle].joint;
+}
+
+void cb2CommandBuffer::Clear()
+{
+	FreeQueued();
+
+	m_bodyCount = 0;
+	m_fixtureCount = 0;
+	m_jointCount = 0;
+	m_appliedBodyCount = 0;
+	m_appliedFixtureCount = 0;
+	m_appliedJointCount = 0;
+	m_destroyBodyCount = 0;
+	m_destroyFixtureCount = 0;
+	m_destroyJointCount = 0;
+}
+
+bool cb2CommandBuffer::IsEmpty() const
+{
+	return m_appliedBodyCount == m_bodyCount && m_appliedFixtureCount == m_fixtureCount &&
+		m_appliedJointCount == m_jointCount && m_destroyBodyCount == 0 &&
+		m_destroyFixtureCount == 0 && m_destroyJointCount == 0;
+}
+
+void cb2CommandBuffer::FreeQueued()
+{
+	for (int i = m_appliedFixtureCount; i < m_fixtureCount; ++i)
+	{
+		cb2FreeShape(const_cast<cb2Shape*>(m_fixtures[i].def.shape), &m_allocator);
+	}
+	m_fixtureCount = m_appliedFixtureCount;
+
+	for (int i = m_appliedJointCount; i < m_jointCount; ++i)
+	{
+		cb2JointDef* def = m_joints[i].def;
+		m_allocator.Free(def, cb2GetJointDefSize(def->type));
+	}
+	m_jointCount = m_appliedJointCount;
+}
@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_COMMAND_BUFFER_H
+#define CB2_COMMAND_BUFFER_H
+
+#include <CinderBox2D/Common/cb2BlockAllocator.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+
+class cb2World;
+class cb2Joint;
+struct cb2JointDef;
+
+/// Collects the creation and destruction of bodies, fixtures and joints and makes
+/// them all at once, with cb2World::SubmitCommands at the next step or with Apply.
+/// The buffer can be filled while the world is locked, from callbacks or while a step
+/// started by cb2World::StepAsync runs. The definitions are copied, shapes included,
+/// so they can be reused at once. Creations return a handle; the object can be
+/// taken from the handle once the buffer was applied, until it is cleared.
+///
+/// Destructions are made first: joints, fixtures, then bodies. Then bodies are created,
+/// then fixtures, in one bulk load of the broad-phase when they are many, then joints.
+/// The new contacts are found by one pass at the start of the next step.
+class cb2CommandBuffer
+{
+public:
+	cb2CommandBuffer();
+	~cb2CommandBuffer();
+
+	/// Queue the creation of a body. Returns its handle.
+	int CreateBody(const cb2BodyDef* def);
+
+	/// Queue the creation of a fixture on a body of this buffer or on a body of the world.
+	/// Returns its handle.
+	int CreateFixture(int bodyHandle, const cb2FixtureDef* def);
+	int CreateFixture(cb2Body* body, const cb2FixtureDef* def);
+
+	/// Queue the creation of a joint. A body handle other than -1 replaces def->bodyA or
+	/// def->bodyB with a body of this buffer. Gear joints must refer to existing joints.
+	/// Returns its handle.
+	int CreateJoint(const cb2JointDef* def, int bodyHandleA = -1, int bodyHandleB = -1);
+
+	/// Queue destructions. The objects must still exist when the buffer is applied and
+	/// each must be queued once. Destroying a body also destroys its fixtures and joints.
+	void DestroyBody(cb2Body* body);
+	void DestroyFixture(cb2Fixture* fixture);
+	void DestroyJoint(cb2Joint* joint);
+
+	/// Make the queued changes now. The world must not be locked.
+	void Apply(cb2World* world);
+
+	/// Get the objects made for handles, after Apply.
+	cb2Body* GetBody(int handle) const;
+	cb2Fixture* GetFixture(int handle) const;
+	cb2Joint* GetJoint(int handle) const;
+
+	/// Forget the queued changes and the handles.
+	void Clear();
+
+	/// Has anything been queued since the last Apply?
+	bool IsEmpty() const;
+
+private:
+
+	struct cb2QueuedBody
+	{
+		cb2BodyDef def;
+		cb2Body* body;
+	};
+
+	struct cb2QueuedFixture
+	{
+		cb2FixtureDef def;
+		cb2Body* body;
+		int bodyHandle;
+		cb2Fixture* fixture;
+		bool endEdit;
+	};
+
+	struct cb2QueuedJoint
+	{
+		cb2JointDef* def;
+		int bodyHandleA;
+		int bodyHandleB;
+		cb2Joint* joint;
+	};
+
+	// Free the copied shapes and joint definitions of the creations not applied yet.
+	void FreeQueued();
+
+	cb2BlockAllocator m_allocator;
+
+	cb2QueuedBody* m_bodies;
+	int m_bodyCount;
+	int m_bodyCapacity;
+
+	cb2QueuedFixture* m_fixtures;
+	int m_fixtureCount;
+	int m_fixtureCapacity;
+
+	cb2QueuedJoint* m_joints;
+	int m_jointCount;
+	int m_jointCapacity;
+
+	// The creations before these were made by an earlier Apply and are kept for the handles.
+	int m_appliedBodyCount;
+	int m_appliedFixtureCount;
+	int m_appliedJointCount;
+
+	cb2Body** m_destroyBodies;
+	int m_destroyBodyCount;
+	int m_destroyBodyCapacity;
+
+	cb2Fixture** m_destroyFixtures;
+	int m_destroyFixtureCount;
+	int m_destroyFixtureCapacity;
+
+	cb2Joint** m_destroyJoints;
+	int m_destroyJointCount;
+	int m_destroyJointCapacity;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2ContactEvents.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
+#include <CinderBox2D/Dynamics/Joints/cb2Joint.h>
+#include <string.h>
+
+// Make room for one more event, doubling the capacity.
+template <typename T>
+static T* cb2AppendEvent(T** events, int* count, int* capacity)
+{
+	if (*count == *capacity)
+	{
+		T* old = *events;
+		*capacity = cb2Max(2 * *capacity, 64);
+		*events = (T*)cb2Alloc(*capacity * sizeof(T));
+		if (old)
+		{
+			memcpy(*events, old, *count * sizeof(T));
+			cb2Free(old);
+		}
+	}
+
+	return *events + (*count)++;
+}
+
+static void cb2FillTouchEvent(cb2ContactTouchEvent* event, const cb2Contact* contact)
+{
+	event->fixtureA = (cb2Fixture*)contact->GetFixtureA();
+	event->fixtureB = (cb2Fixture*)contact->GetFixtureB();
+	event->childIndexA = contact->GetChildIndexA();
+	event->childIndexB = contact->GetChildIndexB();
+}
+
+cb2ContactEvents::cb2ContactEvents()
+{
+	m_begins = NULL;
+	m_beginCount = 0;
+	m_beginCapacity = 0;
+	m_ends = NULL;
+	m_endCount = 0;
+	m_endCapacity = 0;
+	m_hits = NULL;
+	m_hitCount = 0;
+	m_hitCapacity = 0;
+	m_sensorBegins = NULL;
+	m_sensorBeginCount = 0;
+	m_sensorBeginCapacity = 0;
+	m_sensorEnds = NULL;
+	m_sensorEndCount = 0;
+	m_sensorEndCapacity = 0;
+	m_breaks = NULL;
+	m_breakCount = 0;
+	m_breakCapacity = 0;
+}
+
+cb2ContactEvents::~cb2ContactEvents()
+{
+	cb2Free(m_begins);
+	cb2Free(m_ends);
+	cb2Free(m_hits);
+	cb2Free(m_sensorBegins);
+	cb2Free(m_sensorEnds);
+	cb2Free(m_breaks);
+}
+
+void cb2ContactEvents::Clear()
+{
+	m_beginCount = 0;
+	m_endCount = 0;
+	m_hitCount = 0;
+	m_sensorBeginCount = 0;
+	m_sensorEndCount = 0;
+	m_breakCount = 0;
+}
+
+void cb2ContactEvents::AddBegin(const cb2Contact* contact)
+{
+	cb2FillTouchEvent(cb2AppendEvent(&m_begins, &m_beginCount, &m_beginCapacity), contact);
+}
+
+void cb2ContactEvents::AddEnd(const cb2Contact* contact)
+{
+	cb2FillTouchEvent(cb2AppendEvent(&m_ends, &m_endCount, &m_endCapacity), contact);
+}
+
+static void cb2FillSensorEvent(cb2ContactTouchEvent* event, cb2Fixture* sensor, int sensorChild,
+							   cb2Fixture* visitor, int visitorChild)
+{
+	event->fixtureA = sensor;
+	event->fixtureB = visitor;
+	event->childIndexA = sensorChild;
+	event->childIndexB = visitorChild;
+}
+
+void cb2ContactEvents::AddSensorBegin(cb2Fixture* sensor, int sensorChild, cb2Fixture* visitor, int visitorChild)
+{
+	cb2ContactTouchEvent* event = cb2AppendEvent(&m_sensorBegins, &m_sensorBeginCount, &m_sensorBeginCapacity);
+	cb2FillSensorEvent(event, sensor, sensorChild, visitor, visitorChild);
+}
+
+void cb2ContactEvents::AddSensorEnd(cb2Fixture* sensor, int sensorChild, cb2Fixture* visitor, int visitorChild)
+{
+	cb2ContactTouchEvent* event = cb2AppendEvent(&m_sensorEnds, &m_sensorEndCount, &m_sensorEndCapacity);
+	cb2FillSensorEvent(event, sensor, sensorChild, visitor, visitorChild);
+}
+
+void cb2ContactEvents::AddHit(cb2Contact* contact, float threshold)
+{
+	const cb2Body* bodyA = contact->GetFixtureA()->GetBody();
+	const cb2Body* bodyB = contact->GetFixtureB()->GetBody();
+	int pointCount = contact->GetManifold()->pointCount;
+	if (pointCount == 0)
+	{
+		return;
+	}
+
+	cb2WorldManifold worldManifold;
+	contact->GetWorldManifold(&worldManifold);
+
+	// The approach speed is the relative velocity of B towards A along the normal.
+	float bestSpeed = threshold;
+	int bestIndex = -1;
+	for (int i = 0; i < pointCount; ++i)
+	{
+		ci::Vec2f p = worldManifold.points[i];
+		ci::Vec2f vA = bodyA->GetLinearVelocityFromWorldPoint(p);
+		ci::Vec2f vB = bodyB->GetLinearVelocityFromWorldPoint(p);
+		float speed = -cb2Dot(vB - vA, worldManifold.normal);
+		if (speed > bestSpeed)
+		{
+			bestSpeed = speed;
+			bestIndex = i;
+		}
+	}
+
+	if (bestIndex == -1)
+	{
+		return;
+	}
+
+	cb2ContactHitEvent* event = cb2AppendEvent(&m_hits, &m_hitCount, &m_hitCapacity);
+	event->fixtureA = contact->GetFixtureA();
+	event->fixtureB = contact->GetFixtureB();
+	event->contact = contact;
+	event->point = worldManifold.points[bestIndex];
+	event->normal = worldManifold.normal;
+	event->approachSpeed = bestSpeed;
+	event->normalImpulse = 0.0f;
+}
+
+void cb2ContactEvents::FinishHits()
+{
+	for (int i = 0; i < m_hitCount; ++i)
+	{
+		cb2ContactHitEvent* event = m_hits + i;
+		const cb2Manifold* manifold = event->contact->GetManifold();
+		float impulse = 0.0f;
+		for (int j = 0; j < manifold->pointCount; ++j)
+		{
+			impulse = cb2Max(impulse, manifold->points[j].normalImpulse);
+		}
+		event->normalImpulse = impulse;
+	}
+}
+
+void cb2ContactEvents::AddBreak(cb2Joint* joint, float inv_dt)
+{
+	cb2JointBreakEvent* event = cb2AppendEvent(&m_breaks, &m_breakCount, &m_breakCapacity);
+	event->bodyA = joint->GetBodyA();
+	event->bodyB = joint->GetBodyB();
+	event->userData = joint->GetUserData();
+	event->anchor = joint->GetAnchorB();
+	event->force = joint->GetReactionForce(inv_dt);
+	event->torque = joint->GetReactionTorque(inv_dt);
+}
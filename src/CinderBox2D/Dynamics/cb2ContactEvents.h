@@ -0,0 +1,143 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_CONTACT_EVENTS_H
+#define CB2_CONTACT_EVENTS_H
+
+#include <CinderBox2D/Common/cb2Math.h>
+
+class cb2Body;
+class cb2Contact;
+class cb2Fixture;
+class cb2Joint;
+
+/// Two fixtures began or ceased to touch.
+struct cb2ContactTouchEvent
+{
+	cb2Fixture* fixtureA;
+	cb2Fixture* fixtureB;
+	int childIndexA;
+	int childIndexB;
+};
+
+/// Two solid fixtures began to touch faster than the hit threshold of the world.
+struct cb2ContactHitEvent
+{
+	cb2Fixture* fixtureA;
+	cb2Fixture* fixtureB;
+	cb2Contact* contact;	///< valid until the next step
+	ci::Vec2f point;		///< the contact point that approached fastest
+	ci::Vec2f normal;		///< world normal from A to B
+	float approachSpeed;	///< relative normal speed at the point, in meters per second
+	float normalImpulse;	///< the largest normal impulse the step stored at the contact, zero
+						///< if it began in a time of impact sub-step, which keeps no impulses
+};
+
+/// A joint broke under a reaction above its break force or torque, see
+/// cb2JointDef::breakForce. The joint was destroyed at the end of the step.
+struct cb2JointBreakEvent
+{
+	cb2Body* bodyA;
+	cb2Body* bodyB;
+	void* userData;			///< the user data of the joint
+	ci::Vec2f anchor;		///< the world anchor on body B
+	ci::Vec2f force;		///< the reaction force on body B, in Newtons
+	float torque;			///< the reaction torque on body B, in N*m
+};
+
+/// The contact events of the last step, in the order the listener would have seen them.
+/// Enable with cb2World::SetContactEvents. The events are recorded during the step without
+/// calling out of the engine, so they can be read in bulk after it, on any thread, while
+/// the world is not stepping. Contacts of fixtures destroyed outside the step give no end
+/// event, see cb2DestructionListener.
+class cb2ContactEvents
+{
+public:
+	cb2ContactEvents();
+	~cb2ContactEvents();
+
+	int GetBeginCount() const { return m_beginCount; }
+	const cb2ContactTouchEvent* GetBeginEvents() const { return m_begins; }
+
+	int GetEndCount() const { return m_endCount; }
+	const cb2ContactTouchEvent* GetEndEvents() const { return m_ends; }
+
+	int GetHitCount() const { return m_hitCount; }
+	const cb2ContactHitEvent* GetHitEvents() const { return m_hits; }
+
+	/// The overlaps of sensors without contacts, see cb2World::SetSensorOverlaps.
+	/// Fixture A is the sensor.
+	int GetSensorBeginCount() const { return m_sensorBeginCount; }
+	const cb2ContactTouchEvent* GetSensorBeginEvents() const { return m_sensorBegins; }
+
+	int GetSensorEndCount() const { return m_sensorEndCount; }
+	const cb2ContactTouchEvent* GetSensorEndEvents() const { return m_sensorEnds; }
+
+	/// The joints that broke in the last step.
+	int GetBreakCount() const { return m_breakCount; }
+	const cb2JointBreakEvent* GetBreakEvents() const { return m_breaks; }
+
+private:
+
+	friend class cb2World;
+	friend class cb2Contact;
+	friend class cb2ContactManager;
+	friend class cb2SensorManager;
+
+	void Clear();
+	void AddBegin(const cb2Contact* contact);
+	void AddEnd(const cb2Contact* contact);
+	void AddSensorBegin(cb2Fixture* sensor, int sensorChild, cb2Fixture* visitor, int visitorChild);
+	void AddSensorEnd(cb2Fixture* sensor, int sensorChild, cb2Fixture* visitor, int visitorChild);
+
+	// Add a hit if a point of the touching contact approaches faster than the threshold.
+	void AddHit(cb2Contact* contact, float threshold);
+
+	// Read the impulses of the hit contacts after the solver stored them.
+	void FinishHits();
+
+	// Add the break of a joint before the world destroys it. The reaction is measured
+	// over the time step of the island solve that broke it.
+	void AddBreak(cb2Joint* joint, float inv_dt);
+
+	cb2ContactTouchEvent* m_begins;
+	int m_beginCount;
+	int m_beginCapacity;
+
+	cb2ContactTouchEvent* m_ends;
+	int m_endCount;
+	int m_endCapacity;
+
+	cb2ContactHitEvent* m_hits;
+	int m_hitCount;
+	int m_hitCapacity;
+
+	cb2ContactTouchEvent* m_sensorBegins;
+	int m_sensorBeginCount;
+	int m_sensorBeginCapacity;
+
+	cb2ContactTouchEvent* m_sensorEnds;
+	int m_sensorEndCount;
+	int m_sensorEndCapacity;
+
+	cb2JointBreakEvent* m_breaks;
+	int m_breakCount;
+	int m_breakCapacity;
+};
+
+#endif
@@ -18,9 +18,16 @@
 
 #include <CinderBox2D/Dynamics/cb2ContactManager.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2ContactEvents.h>
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
 #include <CinderBox2D/Dynamics/cb2WorldCallbacks.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2ImpulseCache.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChildQuery.h>
+#include <CinderBox2D/Common/cb2ThreadPool.h>
+#include <CinderBox2D/Common/cb2Profiler.h>
+#include <new>
 
 cb2ContactFilter cb2_defaultFilter;
 cb2ContactListener cb2_defaultListener;
@@ -29,9 +36,44 @@ cb2ContactManager::cb2ContactManager()
 {
 	m_contactList = NULL;
 	m_contactCount = 0;
+	m_contactArray = NULL;
+	m_contactArrayCapacity = 0;
+	m_awakeContacts = NULL;
+	m_awakeContactCount = 0;
+	m_awakeContactCapacity = 0;
 	m_contactFilter = &cb2_defaultFilter;
+	m_broadPhase.SetFilterRejection(true);
 	m_contactListener = &cb2_defaultListener;
+	m_profiler = NULL;
 	m_allocator = NULL;
+	m_createdCount = 0;
+	m_destroyedCount = 0;
+	m_sensorOverlaps = false;
+	m_speculativeTime = 0.0f;
+
+	m_threadPool = NULL;
+	m_updateBuffer = NULL;
+	m_updateOrder = NULL;
+	m_updateCapacity = 0;
+	m_updateCount = 0;
+	m_impulseCache = NULL;
+
+	m_collideBackend = NULL;
+	m_collideJobs = NULL;
+	m_collideJobCapacity = 0;
+}
+
+cb2ContactManager::~cb2ContactManager()
+{
+	cb2Free(m_contactArray);
+	cb2Free(m_awakeContacts);
+	if (m_updateBuffer)
+	{
+		cb2Free(m_updateBuffer);
+		cb2Free(m_updateOrder);
+	}
+	cb2Free(m_collideJobs);
+	SetImpulseCache(false);
 }
 
 void cb2ContactManager::Destroy(cb2Contact* c)
@@ -46,6 +88,41 @@ void cb2ContactManager::Destroy(cb2Contact* c)
 		m_contactListener->EndContact(c);
 	}
 
+	// Contacts destroyed with their fixtures or bodies outside the step end without an event.
+	cb2World* world = bodyA->GetWorld();
+	if (world->m_contactEvents && world->IsLocked() && c->IsTouching())
+	{
+		world->m_contactEvents->AddEnd(c);
+	}
+
+	++m_destroyedCount;
+
+	if (c->m_islandLink)
+	{
+		bodyA->GetWorld()->m_islandGraph.UnlinkContact(c);
+	}
+
+	if (c->m_awakeIndex != -1)
+	{
+		RemoveAwakeContact(c);
+	}
+
+	if (m_impulseCache && c->IsTouching())
+	{
+		m_impulseCache->Store(c, c->m_manifold, NULL);
+	}
+
+	// Contacts are destroyed before their proxies, so the ids are still valid.
+	// Children of a chain with a child tree are not in the pair set.
+	const cb2FixtureProxy* proxyA = fixtureA->GetProxy(c->GetChildIndexA());
+	const cb2FixtureProxy* proxyB = fixtureB->GetProxy(c->GetChildIndexB());
+	if (proxyA->childIndex != cb2ChainShape::e_allChildren && proxyB->childIndex != cb2ChainShape::e_allChildren)
+	{
+		bool removed = m_pairSet.RemovePair(proxyA->proxyId, proxyB->proxyId);
+		cb2Assert(removed);
+		CB2_NOT_USED(removed);
+	}
+
 	// Remove from the world.
 	if (c->m_prev)
 	{
@@ -62,6 +139,14 @@ void cb2ContactManager::Destroy(cb2Contact* c)
 		m_contactList = c->m_next;
 	}
 
+	// Swap the last contact into the hole.
+	if (m_contactArray)
+	{
+		cb2Contact* last = m_contactArray[m_contactCount - 1];
+		m_contactArray[c->m_arrayIndex] = last;
+		last->m_arrayIndex = c->m_arrayIndex;
+	}
+
 	// Remove from body 1
 	if (c->m_nodeA.prev)
 	{
@@ -99,78 +184,660 @@ void cb2ContactManager::Destroy(cb2Contact* c)
 	--m_contactCount;
 }
 
+void cb2ContactManager::Clear()
+{
+	cb2ContactListener* listener = m_contactListener;
+	cb2ImpulseCache* impulseCache = m_impulseCache;
+	m_contactListener = NULL;
+	m_impulseCache = NULL;
+
+	while (m_contactList)
+	{
+		Destroy(m_contactList);
+	}
+
+	m_contactListener = listener;
+	m_impulseCache = impulseCache;
+}
+
+cb2Contact* cb2ContactManager::RestoreContact(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB)
+{
+	cb2Contact* c = cb2Contact::Create(fixtureA, indexA, fixtureB, indexB, m_allocator);
+	if (c == NULL)
+	{
+		return NULL;
+	}
+	cb2Assert(c->GetFixtureA() == fixtureA);
+
+	const cb2FixtureProxy* proxyA = fixtureA->GetProxy(indexA);
+	const cb2FixtureProxy* proxyB = fixtureB->GetProxy(indexB);
+	if (proxyA->childIndex != cb2ChainShape::e_allChildren && proxyB->childIndex != cb2ChainShape::e_allChildren)
+	{
+		m_pairSet.AddPair(proxyA->proxyId, proxyB->proxyId);
+	}
+
+	InsertContact(c);
+	return c;
+}
+
+// Number of contacts handed to a thread at a time by the parallel collide.
+const int cb2_collideGrainSize = 32;
+
+// Updates buffered contact manifolds on the thread pool.
+class cb2UpdateManifoldsTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		manager->UpdateManifolds(begin, end);
+	}
+
+	cb2ContactManager* manager;
+};
+
+void cb2ContactManager::SetContiguous(bool flag)
+{
+	if (flag == IsContiguous())
+	{
+		return;
+	}
+
+	cb2Free(m_contactArray);
+	m_contactArray = NULL;
+	m_contactArrayCapacity = 0;
+
+	if (flag == false)
+	{
+		return;
+	}
+
+	m_contactArrayCapacity = cb2Max(m_contactCount, 64);
+	m_contactArray = (cb2Contact**)cb2Alloc(m_contactArrayCapacity * sizeof(cb2Contact*));
+
+	int i = 0;
+	for (cb2Contact* c = m_contactList; c; c = c->m_next)
+	{
+		c->m_arrayIndex = i;
+		m_contactArray[i] = c;
+		++i;
+	}
+}
+
+void cb2ContactManager::SetImpulseCache(bool flag)
+{
+	if (flag == HasImpulseCache())
+	{
+		return;
+	}
+
+	if (flag)
+	{
+		void* mem = cb2Alloc(sizeof(cb2ImpulseCache));
+		m_impulseCache = new (mem) cb2ImpulseCache;
+	}
+	else
+	{
+		m_impulseCache->~cb2ImpulseCache();
+		cb2Free(m_impulseCache);
+		m_impulseCache = NULL;
+	}
+}
+
+void cb2ContactManager::SetAwakeContacts(bool flag)
+{
+	if (flag == HasAwakeContacts())
+	{
+		return;
+	}
+
+	for (cb2Contact* c = m_contactList; c; c = c->m_next)
+	{
+		c->m_awakeIndex = -1;
+	}
+
+	cb2Free(m_awakeContacts);
+	m_awakeContacts = NULL;
+	m_awakeContactCount = 0;
+	m_awakeContactCapacity = 0;
+
+	if (flag == false)
+	{
+		return;
+	}
+
+	m_awakeContactCapacity = cb2Max(m_contactCount, 64);
+	m_awakeContacts = (cb2Contact**)cb2Alloc(m_awakeContactCapacity * sizeof(cb2Contact*));
+
+	for (cb2Contact* c = m_contactList; c; c = c->m_next)
+	{
+		if (IsAwake(c))
+		{
+			AddAwakeContact(c);
+		}
+	}
+}
+
+void cb2ContactManager::Reserve(int proxyCount, int contactCount)
+{
+	m_broadPhase.Reserve(proxyCount, contactCount);
+	m_pairSet.Reserve(contactCount);
+
+	if (m_contactArray && contactCount > m_contactArrayCapacity)
+	{
+		cb2Contact** oldArray = m_contactArray;
+		m_contactArrayCapacity = contactCount;
+		m_contactArray = (cb2Contact**)cb2Alloc(m_contactArrayCapacity * sizeof(cb2Contact*));
+		memcpy(m_contactArray, oldArray, m_contactCount * sizeof(cb2Contact*));
+		cb2Free(oldArray);
+	}
+
+	if (m_awakeContacts && contactCount > m_awakeContactCapacity)
+	{
+		cb2Contact** oldContacts = m_awakeContacts;
+		m_awakeContactCapacity = contactCount;
+		m_awakeContacts = (cb2Contact**)cb2Alloc(m_awakeContactCapacity * sizeof(cb2Contact*));
+		memcpy(m_awakeContacts, oldContacts, m_awakeContactCount * sizeof(cb2Contact*));
+		cb2Free(oldContacts);
+	}
+
+	if (contactCount > m_updateCapacity)
+	{
+		cb2ContactUpdate* oldBuffer = m_updateBuffer;
+		m_updateCapacity = contactCount;
+		m_updateBuffer = (cb2ContactUpdate*)cb2Alloc(m_updateCapacity * sizeof(cb2ContactUpdate));
+		if (oldBuffer)
+		{
+			memcpy(m_updateBuffer, oldBuffer, m_updateCount * sizeof(cb2ContactUpdate));
+			cb2Free(oldBuffer);
+			cb2Free(m_updateOrder);
+		}
+		m_updateOrder = (int*)cb2Alloc(m_updateCapacity * sizeof(int));
+	}
+}
+
+bool cb2ContactManager::IsAwake(const cb2Contact* c)
+{
+	const cb2Body* bodyA = c->m_fixtureA->GetBody();
+	const cb2Body* bodyB = c->m_fixtureB->GetBody();
+	bool activeA = bodyA->IsAwake() && bodyA->m_type != cb2_staticBody;
+	bool activeB = bodyB->IsAwake() && bodyB->m_type != cb2_staticBody;
+	return activeA || activeB;
+}
+
+void cb2ContactManager::AddAwakeContact(cb2Contact* c)
+{
+	cb2Assert(m_awakeContacts != NULL);
+	if (c->m_awakeIndex != -1)
+	{
+		return;
+	}
+
+	if (m_awakeContactCount == m_awakeContactCapacity)
+	{
+		cb2Contact** oldContacts = m_awakeContacts;
+		m_awakeContactCapacity *= 2;
+		m_awakeContacts = (cb2Contact**)cb2Alloc(m_awakeContactCapacity * sizeof(cb2Contact*));
+		memcpy(m_awakeContacts, oldContacts, m_awakeContactCount * sizeof(cb2Contact*));
+		cb2Free(oldContacts);
+	}
+
+	c->m_awakeIndex = m_awakeContactCount;
+	m_awakeContacts[m_awakeContactCount] = c;
+	++m_awakeContactCount;
+}
+
+void cb2ContactManager::RemoveAwakeContact(cb2Contact* c)
+{
+	cb2Assert(0 <= c->m_awakeIndex && c->m_awakeIndex < m_awakeContactCount);
+
+	// Swap the last contact into the hole.
+	cb2Contact* last = m_awakeContacts[m_awakeContactCount - 1];
+	m_awakeContacts[c->m_awakeIndex] = last;
+	last->m_awakeIndex = c->m_awakeIndex;
+	c->m_awakeIndex = -1;
+	--m_awakeContactCount;
+}
+
 // This is the top level collision call for the time step. Here
 // all the narrow phase collision is processed for the world
 // contact list.
 void cb2ContactManager::Collide()
 {
+	if (m_impulseCache)
+	{
+		m_impulseCache->Advance();
+	}
+
+	// Without a thread pool or a backend the manifolds are updated as the contacts are
+	// filtered, so a body woken by a contact is awake for the contacts after it.
+	bool updateNow = m_threadPool == NULL && m_collideBackend == NULL;
+
 	// Update awake contacts.
-	cb2Contact* c = m_contactList;
-	while (c)
-	{
-		cb2Fixture* fixtureA = c->GetFixtureA();
-		cb2Fixture* fixtureB = c->GetFixtureB();
-		int indexA = c->GetChildIndexA();
-		int indexB = c->GetChildIndexB();
-		cb2Body* bodyA = fixtureA->GetBody();
-		cb2Body* bodyB = fixtureB->GetBody();
-		 
-		// Is this contact flagged for filtering?
-		if (c->m_flags & cb2Contact::e_filterFlag)
+	if (m_awakeContacts)
+	{
+		// A contact leaving the set is replaced by the last one, which is updated next.
+		// The contacts between sleeping bodies are not filtered until they wake up.
+		int i = 0;
+		while (i < m_awakeContactCount)
 		{
-			// Should these bodies collide?
-			if (bodyB->ShouldCollide(bodyA) == false)
+			cb2Contact* c = m_awakeContacts[i];
+			if (IsAwake(c) == false)
 			{
-				cb2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
+				// Invalidate the TOI here, SolveTOI only resets the awake contacts.
+				c->m_flags &= ~(cb2Contact::e_toiFlag | cb2Contact::e_islandFlag);
+				c->m_toiCount = 0;
+				c->m_toi = 1.0f;
+				RemoveAwakeContact(c);
 				continue;
 			}
 
-			// Check user filtering.
-			if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
+			if (CollideContact(c, updateNow))
 			{
-				cb2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
-				continue;
+				++i;
+			}
+		}
+	}
+	else if (m_contactArray)
+	{
+		// A destroyed contact is replaced by the last one, which is updated next.
+		int i = 0;
+		while (i < m_contactCount)
+		{
+			if (CollideContact(m_contactArray[i], updateNow))
+			{
+				++i;
 			}
+		}
+	}
+	else
+	{
+		cb2Contact* c = m_contactList;
+		while (c)
+		{
+			cb2Contact* next = c->GetNext();
+			CollideContact(c, updateNow);
+			c = next;
+		}
+	}
+
+	if (m_updateCount > 0)
+	{
+		if (updateNow == false)
+		{
+			SortUpdates();
+
+			int cpuCount = m_collideBackend ? OffloadManifolds() : m_updateCount;
+			if (m_threadPool)
+			{
+				cb2UpdateManifoldsTask task;
+				task.manager = this;
+				m_threadPool->ParallelFor(&task, cpuCount, cb2_collideGrainSize);
+			}
+			else
+			{
+				UpdateManifolds(0, cpuCount);
+			}
+		}
+
+		// All the lost points are stored before any is restored, so a point can move
+		// to a contact that comes earlier in the buffer.
+		if (m_impulseCache)
+		{
+			for (int i = 0; i < m_updateCount; ++i)
+			{
+				cb2ContactUpdate* update = m_updateBuffer + i;
+				m_impulseCache->Store(update->contact, update->oldManifold, &update->contact->m_manifold);
+			}
+
+			for (int i = 0; i < m_updateCount; ++i)
+			{
+				cb2ContactUpdate* update = m_updateBuffer + i;
+				m_impulseCache->Restore(update->contact, update->oldManifold);
+			}
+		}
+
+		for (int i = 0; i < m_updateCount; ++i)
+		{
+			cb2ContactUpdate* update = m_updateBuffer + i;
+			update->contact->ReportUpdate(m_contactListener, update->oldManifold, update->wasTouching);
+		}
+
+		m_updateCount = 0;
+	}
+}
+
+bool cb2ContactManager::CollideContact(cb2Contact* c, bool updateNow)
+{
+	cb2Fixture* fixtureA = c->GetFixtureA();
+	cb2Fixture* fixtureB = c->GetFixtureB();
+	cb2Body* bodyA = fixtureA->GetBody();
+	cb2Body* bodyB = fixtureB->GetBody();
+
+	// Is this contact flagged for filtering?
+	if (c->m_flags & cb2Contact::e_filterFlag)
+	{
+		// Should these bodies collide?
+		if (bodyB->ShouldCollide(bodyA) == false)
+		{
+			Destroy(c);
+			return false;
+		}
+
+		// Check user filtering.
+		if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
+		{
+			Destroy(c);
+			return false;
+		}
+
+		// The layers may no longer collide.
+		if (m_broadPhase.ShouldCollideLayers(fixtureA->m_filter.layer, fixtureB->m_filter.layer) == false)
+		{
+			Destroy(c);
+			return false;
+		}
+
+		// A fixture became a sensor that is tracked without contacts.
+		if (m_sensorOverlaps && (fixtureA->m_isSensor || fixtureB->m_isSensor))
+		{
+			Destroy(c);
+			return false;
+		}
+
+		// Clear the filtering flag.
+		c->m_flags &= ~cb2Contact::e_filterFlag;
+	}
+
+	bool activeA = bodyA->IsAwake() && bodyA->m_type != cb2_staticBody;
+	bool activeB = bodyB->IsAwake() && bodyB->m_type != cb2_staticBody;
+
+	// At least one body must be awake and it must be dynamic or kinematic.
+	if (activeA == false && activeB == false)
+	{
+		return true;
+	}
+
+	bool overlap = TestOverlap(c);
+
+	// Here we destroy contacts that cease to overlap in the broad-phase.
+	if (overlap == false)
+	{
+		Destroy(c);
+		return false;
+	}
 
-			// Clear the filtering flag.
-			c->m_flags &= ~cb2Contact::e_filterFlag;
+	// The contact persists.
+	c->m_speculativeDistance = m_speculativeTime > 0.0f ? ComputeSpeculativeDistance(c) : 0.0f;
+	BufferUpdate(c);
+
+	if (updateNow)
+	{
+		cb2ContactUpdate* update = m_updateBuffer + m_updateCount - 1;
+		c->UpdateManifold(update->oldManifold);
+
+		// Wake the bodies here rather than in ReportUpdate, as Update does.
+		if (c->IsTouching() != update->wasTouching && fixtureA->m_isSensor == false && fixtureB->m_isSensor == false)
+		{
+			bodyA->SetAwake(true);
+			bodyB->SetAwake(true);
 		}
+	}
+	return true;
+}
+
+void cb2ContactManager::ComputeSweptChildAABB(cb2AABB* aabb, const cb2Fixture* fixture, int childIndex)
+{
+	const cb2Body* body = fixture->GetBody();
+	const cb2Shape* shape = fixture->GetShape();
+	shape->ComputeAABB(aabb, body->m_xf, childIndex);
+
+	if (body->m_type != cb2_staticBody)
+	{
+		cb2Transform xf0;
+		body->m_sweep.GetTransform(&xf0, 0.0f);
+
+		cb2AABB aabb0;
+		shape->ComputeAABB(&aabb0, xf0, childIndex);
+		aabb->Combine(aabb0);
+	}
+
+	ci::Vec2f r(cb2_aabbExtension, cb2_aabbExtension);
+	aabb->lowerBound -= r;
+	aabb->upperBound += r;
+}
+
+// Box of the rotated box, as the shapes with a single proxy compute it.
+static cb2AABB cb2ComputeLocalAABB(const cb2AABB& aabb, const cb2Transform& transform)
+{
+	ci::Vec2f c = cb2MulT(transform, aabb.GetCenter());
+	ci::Vec2f h = aabb.GetExtents();
+	ci::Vec2f r(cb2Abs(transform.q.c) * h.x + cb2Abs(transform.q.s) * h.y,
+				cb2Abs(transform.q.s) * h.x + cb2Abs(transform.q.c) * h.y);
+
+	cb2AABB local;
+	local.lowerBound = c - r;
+	local.upperBound = c + r;
+	return local;
+}
+
+cb2AABB cb2ContactManager::ComputeSweptLocalAABB(const cb2Body* body, const cb2AABB& aabb)
+{
+	cb2Transform xf0;
+	body->m_sweep.GetTransform(&xf0, 0.0f);
+
+	cb2AABB local = cb2ComputeLocalAABB(aabb, body->m_xf);
+	local.Combine(cb2ComputeLocalAABB(aabb, xf0));
+	return local;
+}
+
+// Query the children of a shape with a single proxy against a world box over the
+// sweep of its body. A static body did not move, so its transform is used as is.
+template <typename T>
+static void cb2QuerySweptChildren(const cb2Fixture* fixture, T* callback, const cb2AABB& aabb)
+{
+	const cb2Body* body = fixture->GetBody();
+	if (body->GetType() == cb2_staticBody)
+	{
+		cb2QueryChildren(fixture->GetShape(), callback, aabb, body->GetTransform());
+		return;
+	}
+
+	cb2Transform identity;
+	identity.SetIdentity();
+	cb2QueryChildren(fixture->GetShape(), callback, cb2ContactManager::ComputeSweptLocalAABB(body, aabb), identity);
+}
+
+// Test one child like cb2QuerySweptChildren.
+static bool cb2TestSweptChildOverlap(const cb2Fixture* fixture, int childIndex, const cb2AABB& aabb)
+{
+	const cb2Body* body = fixture->GetBody();
+	if (body->GetType() == cb2_staticBody)
+	{
+		return cb2TestChildOverlap(fixture->GetShape(), childIndex, aabb, body->GetTransform());
+	}
+
+	cb2Transform identity;
+	identity.SetIdentity();
+	return cb2TestChildOverlap(fixture->GetShape(), childIndex, cb2ContactManager::ComputeSweptLocalAABB(body, aabb), identity);
+}
+
+bool cb2ContactManager::TestOverlap(cb2Contact* c) const
+{
+	cb2Fixture* fixtureA = c->GetFixtureA();
+	cb2Fixture* fixtureB = c->GetFixtureB();
+	int indexA = c->GetChildIndexA();
+	int indexB = c->GetChildIndexB();
+	const cb2FixtureProxy* proxyA = fixtureA->GetProxy(indexA);
+	const cb2FixtureProxy* proxyB = fixtureB->GetProxy(indexB);
+
+	if (proxyA->childIndex == cb2ChainShape::e_allChildren && proxyB->childIndex == cb2ChainShape::e_allChildren)
+	{
+		// The swept box of child A against child B over its sweep, as in AddChildPairs.
+		cb2AABB aabb;
+		ComputeSweptChildAABB(&aabb, fixtureA, indexA);
+		return cb2TestSweptChildOverlap(fixtureB, indexB, aabb);
+	}
+
+	if (proxyA->childIndex == cb2ChainShape::e_allChildren)
+	{
+		return cb2TestSweptChildOverlap(fixtureA, indexA, m_broadPhase.GetFatAABB(proxyB->proxyId));
+	}
+
+	if (proxyB->childIndex == cb2ChainShape::e_allChildren)
+	{
+		return cb2TestSweptChildOverlap(fixtureB, indexB, m_broadPhase.GetFatAABB(proxyA->proxyId));
+	}
 
-		bool activeA = bodyA->IsAwake() && bodyA->m_type != cb2_staticBody;
-		bool activeB = bodyB->IsAwake() && bodyB->m_type != cb2_staticBody;
+	return m_broadPhase.TestOverlap(proxyA->proxyId, proxyB->proxyId);
+}
 
-		// At least one body must be awake and it must be dynamic or kinematic.
-		if (activeA == false && activeB == false)
+float cb2ContactManager::ComputeSpeculativeDistance(cb2Contact* c) const
+{
+	// Bound the closing speed of the shapes by the relative linear velocity and by the
+	// rotation of each proxy box about its body's center of mass.
+	cb2Fixture* fixtureA = c->GetFixtureA();
+	cb2Fixture* fixtureB = c->GetFixtureB();
+	cb2Body* bodyA = fixtureA->GetBody();
+	cb2Body* bodyB = fixtureB->GetBody();
+
+	const cb2AABB& aabbA = fixtureA->GetProxy(c->GetChildIndexA())->aabb;
+	const cb2AABB& aabbB = fixtureB->GetProxy(c->GetChildIndexB())->aabb;
+	float radiusA = (aabbA.GetCenter() - bodyA->m_sweep.c).length() + aabbA.GetExtents().length();
+	float radiusB = (aabbB.GetCenter() - bodyB->m_sweep.c).length() + aabbB.GetExtents().length();
+
+	float speed = (bodyB->m_linearVelocity - bodyA->m_linearVelocity).length() +
+		cb2Abs(bodyA->m_angularVelocity) * radiusA + cb2Abs(bodyB->m_angularVelocity) * radiusB;
+
+	// The solver does not move a body further than cb2_maxTranslation per step.
+	return cb2Min(m_speculativeTime * speed, 2.0f * cb2_maxTranslation);
+}
+
+void cb2ContactManager::SortUpdates()
+{
+	// Counting sort, which keeps the list order within each type.
+	int counts[cb2Contact::e_contactTypeCount] = {0};
+	for (int i = 0; i < m_updateCount; ++i)
+	{
+		++counts[m_updateBuffer[i].contact->GetType()];
+	}
+
+	int offsets[cb2Contact::e_contactTypeCount];
+	m_updateGroups[0] = 0;
+	for (int type = 0; type < cb2Contact::e_contactTypeCount; ++type)
+	{
+		offsets[type] = m_updateGroups[type];
+		m_updateGroups[type + 1] = m_updateGroups[type] + counts[type];
+	}
+
+	for (int i = 0; i < m_updateCount; ++i)
+	{
+		m_updateOrder[offsets[m_updateBuffer[i].contact->GetType()]++] = i;
+	}
+}
+
+void cb2ContactManager::UpdateManifolds(int begin, int end)
+{
+	for (int type = 0; type < cb2Contact::e_contactTypeCount; ++type)
+	{
+		int lower = cb2Max(begin, m_updateGroups[type]);
+		int upper = cb2Min(end, m_updateGroups[type + 1]);
+		if (lower < upper)
 		{
-			c = c->GetNext();
-			continue;
+			cb2Contact::UpdateManifolds((cb2Contact::Type)type, m_updateBuffer, m_updateOrder + lower, upper - lower);
 		}
+	}
+}
+
+int cb2ContactManager::OffloadManifolds()
+{
+	if (m_collideJobCapacity < m_updateCount)
+	{
+		cb2Free(m_collideJobs);
+		m_collideJobCapacity = cb2Max(2 * m_collideJobCapacity, m_updateCount);
+		m_collideJobs = (cb2CollideJob*)cb2Alloc(m_collideJobCapacity * sizeof(cb2CollideJob));
+	}
+
+	// The updates the backend did not take are packed to the front of the order,
+	// keeping the groups by type for UpdateManifolds.
+	int cpuCount = 0;
+	int begin = m_updateGroups[0];
+	for (int type = 0; type < cb2Contact::e_contactTypeCount; ++type)
+	{
+		int end = m_updateGroups[type + 1];
+		m_updateGroups[type] = cpuCount;
+
+		int jobCount = 0;
+		for (int i = begin; i < end; ++i)
+		{
+			cb2Contact* c = m_updateBuffer[m_updateOrder[i]].contact;
+			if (c->m_fixtureA->m_isSensor || c->m_fixtureB->m_isSensor)
+			{
+				continue;
+			}
 
-		int proxyIdA = fixtureA->m_proxies[indexA].proxyId;
-		int proxyIdB = fixtureB->m_proxies[indexB].proxyId;
-		bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+			cb2CollideJob* job = m_collideJobs + jobCount++;
+			job->contact = c;
+			job->shapeA = c->m_fixtureA->m_shape;
+			job->indexA = c->m_indexA;
+			job->shapeB = c->m_fixtureB->m_shape;
+			job->indexB = c->m_indexB;
+			job->xfA = c->m_fixtureA->m_body->m_xf;
+			job->xfB = c->m_fixtureB->m_body->m_xf;
+			job->speculativeDistance = c->m_speculativeDistance;
+			job->manifold = &c->m_manifold;
+		}
 
-		// Here we destroy contacts that cease to overlap in the broad-phase.
-		if (overlap == false)
+		bool offloaded = jobCount > 0 && m_collideBackend->Collide(type, m_collideJobs, jobCount);
+		for (int i = begin; i < end; ++i)
 		{
-			cb2Contact* cNuke = c;
-			c = cNuke->GetNext();
-			Destroy(cNuke);
-			continue;
+			cb2ContactUpdate* update = m_updateBuffer + m_updateOrder[i];
+			cb2Contact* c = update->contact;
+			if (offloaded && c->m_fixtureA->m_isSensor == false && c->m_fixtureB->m_isSensor == false)
+			{
+				c->FinishManifold(update->oldManifold);
+			}
+			else
+			{
+				m_updateOrder[cpuCount++] = m_updateOrder[i];
+			}
 		}
 
-		// The contact persists.
-		c->Update(m_contactListener);
-		c = c->GetNext();
+		begin = end;
 	}
+	m_updateGroups[cb2Contact::e_contactTypeCount] = cpuCount;
+
+	return cpuCount;
+}
+
+void cb2ContactManager::BufferUpdate(cb2Contact* c)
+{
+	if (m_updateCount == m_updateCapacity)
+	{
+		cb2ContactUpdate* oldBuffer = m_updateBuffer;
+		m_updateCapacity = cb2Max(2 * m_updateCapacity, 64);
+		m_updateBuffer = (cb2ContactUpdate*)cb2Alloc(m_updateCapacity * sizeof(cb2ContactUpdate));
+		if (oldBuffer)
+		{
+			memcpy(m_updateBuffer, oldBuffer, m_updateCount * sizeof(cb2ContactUpdate));
+			cb2Free(oldBuffer);
+			cb2Free(m_updateOrder);
+		}
+
+		// The order is rebuilt for every collide pass.
+		m_updateOrder = (int*)cb2Alloc(m_updateCapacity * sizeof(int));
+	}
+
+	cb2ContactUpdate* update = m_updateBuffer + m_updateCount;
+	update->contact = c;
+	update->oldManifold = c->m_manifold;
+	update->wasTouching = c->IsTouching();
+	++m_updateCount;
 }
 
 void cb2ContactManager::FindNewContacts()
 {
+	cb2ProfileZone zone(m_profiler, "UpdatePairs", m_broadPhase.GetMoveCount());
 	m_broadPhase.UpdatePairs(this);
 }
 
@@ -194,33 +861,29 @@ void cb2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 		return;
 	}
 
-	// TODO_ERIN use a hash table to remove a potential bottleneck when both
-	// bodies have a lot of contacts.
-	// Does a contact already exist?
-	cb2ContactEdge* edge = bodyB->GetContactList();
-	while (edge)
+	// Sensors may be tracked without contacts.
+	if (m_sensorOverlaps && (fixtureA->m_isSensor || fixtureB->m_isSensor))
 	{
-		if (edge->other == bodyA)
-		{
-			cb2Fixture* fA = edge->contact->GetFixtureA();
-			cb2Fixture* fB = edge->contact->GetFixtureB();
-			int iA = edge->contact->GetChildIndexA();
-			int iB = edge->contact->GetChildIndexB();
+		return;
+	}
 
-			if (fA == fixtureA && fB == fixtureB && iA == indexA && iB == indexB)
-			{
-				// A contact already exists.
-				return;
-			}
+	// A shape with a single proxy pairs its children instead.
+	if (indexA == cb2ChainShape::e_allChildren)
+	{
+		AddChildPairs(proxyA, proxyB);
+		return;
+	}
 
-			if (fA == fixtureB && fB == fixtureA && iA == indexB && iB == indexA)
-			{
-				// A contact already exists.
-				return;
-			}
-		}
+	if (indexB == cb2ChainShape::e_allChildren)
+	{
+		AddChildPairs(proxyB, proxyA);
+		return;
+	}
 
-		edge = edge->next;
+	// Does a contact already exist?
+	if (m_pairSet.ContainsPair(proxyA->proxyId, proxyB->proxyId))
+	{
+		return;
 	}
 
 	// Does a joint override collision? Is at least one body dynamic?
@@ -242,15 +905,169 @@ void cb2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 		return;
 	}
 
-	// Contact creation may swap fixtures.
-	fixtureA = c->GetFixtureA();
-	fixtureB = c->GetFixtureB();
-	indexA = c->GetChildIndexA();
-	indexB = c->GetChildIndexB();
-	bodyA = fixtureA->GetBody();
-	bodyB = fixtureB->GetBody();
+	m_pairSet.AddPair(proxyA->proxyId, proxyB->proxyId);
+
+	InsertContact(c);
+}
+
+struct cb2ChildPairCallback
+{
+	bool QueryCallback(int childIndex)
+	{
+		return manager->AddChildContact(chainFixture, childIndex, proxy->fixture, proxy->childIndex);
+	}
+
+	cb2ContactManager* manager;
+	cb2Fixture* chainFixture;
+	cb2FixtureProxy* proxy;
+};
+
+// Pairs one child of a shape with the children of another shape that both use a
+// single proxy, such as a compound resting on a chain.
+struct cb2ChildChildPairCallback
+{
+	bool QueryCallback(int childIndex)
+	{
+		cb2ChildQueryCallback inner;
+		inner.manager = manager;
+		inner.fixtureA = fixtureA;
+		inner.indexA = childIndex;
+		inner.fixtureB = fixtureB;
+		inner.valid = true;
+
+		cb2AABB aabb;
+		cb2ContactManager::ComputeSweptChildAABB(&aabb, fixtureA, childIndex);
+		cb2QuerySweptChildren(fixtureB, &inner, aabb);
+		return inner.valid;
+	}
+
+	struct cb2ChildQueryCallback
+	{
+		bool QueryCallback(int childIndex)
+		{
+			valid = manager->AddChildContact(fixtureA, indexA, fixtureB, childIndex);
+			return valid;
+		}
+
+		cb2ContactManager* manager;
+		cb2Fixture* fixtureA;
+		int indexA;
+		cb2Fixture* fixtureB;
+		bool valid;
+	};
+
+	cb2ContactManager* manager;
+	cb2Fixture* fixtureA;
+	cb2Fixture* fixtureB;
+};
+
+void cb2ContactManager::AddChildPairs(cb2FixtureProxy* chainProxy, cb2FixtureProxy* proxy)
+{
+	cb2Fixture* chainFixture = chainProxy->fixture;
+	cb2Fixture* fixture = proxy->fixture;
+	cb2Body* chainBody = chainFixture->GetBody();
+	cb2Body* body = fixture->GetBody();
+
+	// Does a joint override collision? Is at least one body dynamic?
+	if (body->ShouldCollide(chainBody) == false)
+	{
+		return;
+	}
+
+	// Check user filtering.
+	if (m_contactFilter && m_contactFilter->ShouldCollide(chainFixture, fixture) == false)
+	{
+		return;
+	}
+
+	if (proxy->childIndex == cb2ChainShape::e_allChildren)
+	{
+		// The contacts put the lower shape type first. Walk its children on the outside
+		// so the child boxes are tested the same way as in TestOverlap.
+		if (fixture->GetType() < chainFixture->GetType())
+		{
+			cb2Swap(chainProxy, proxy);
+			cb2Swap(chainFixture, fixture);
+			cb2Swap(chainBody, body);
+		}
+
+		cb2ChildChildPairCallback callback;
+		callback.manager = this;
+		callback.fixtureA = chainFixture;
+		callback.fixtureB = fixture;
+
+		cb2QuerySweptChildren(chainFixture, &callback, m_broadPhase.GetFatAABB(proxy->proxyId));
+		return;
+	}
+
+	cb2ChildPairCallback callback;
+	callback.manager = this;
+	callback.chainFixture = chainFixture;
+	callback.proxy = proxy;
+
+	cb2QuerySweptChildren(chainFixture, &callback, m_broadPhase.GetFatAABB(proxy->proxyId));
+}
+
+bool cb2ContactManager::AddChildContact(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB)
+{
+	// Does a contact already exist? Walk the contacts of a body that is not static,
+	// a chain or heightfield body usually has many more.
+	cb2Body* body = fixtureB->GetBody();
+	if (body->GetType() == cb2_staticBody)
+	{
+		body = fixtureA->GetBody();
+	}
+
+	for (cb2ContactEdge* edge = body->GetContactList(); edge; edge = edge->next)
+	{
+		cb2Contact* c = edge->contact;
+		if (c->GetFixtureA() == fixtureA && c->GetChildIndexA() == indexA &&
+			c->GetFixtureB() == fixtureB && c->GetChildIndexB() == indexB)
+		{
+			return true;
+		}
+
+		if (c->GetFixtureA() == fixtureB && c->GetChildIndexA() == indexB &&
+			c->GetFixtureB() == fixtureA && c->GetChildIndexB() == indexA)
+		{
+			return true;
+		}
+	}
+
+	cb2Contact* c = cb2Contact::Create(fixtureA, indexA, fixtureB, indexB, m_allocator);
+	if (c == NULL)
+	{
+		// There is no contact type for this pair, so no child collides.
+		return false;
+	}
+
+	InsertContact(c);
+	return true;
+}
+
+void cb2ContactManager::InsertContact(cb2Contact* c)
+{
+	cb2Fixture* fixtureA = c->GetFixtureA();
+	cb2Fixture* fixtureB = c->GetFixtureB();
+	cb2Body* bodyA = fixtureA->GetBody();
+	cb2Body* bodyB = fixtureB->GetBody();
 
 	// Insert into the world.
+	if (m_contactArray)
+	{
+		if (m_contactCount == m_contactArrayCapacity)
+		{
+			cb2Contact** oldArray = m_contactArray;
+			m_contactArrayCapacity *= 2;
+			m_contactArray = (cb2Contact**)cb2Alloc(m_contactArrayCapacity * sizeof(cb2Contact*));
+			memcpy(m_contactArray, oldArray, m_contactCount * sizeof(cb2Contact*));
+			cb2Free(oldArray);
+		}
+
+		c->m_arrayIndex = m_contactCount;
+		m_contactArray[m_contactCount] = c;
+	}
+
 	c->m_prev = NULL;
 	c->m_next = m_contactList;
 	if (m_contactList != NULL)
@@ -292,5 +1109,11 @@ void cb2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
    	bodyB->SetAwake(true);
 	}
 
+	if (m_awakeContacts && IsAwake(c))
+	{
+		AddAwakeContact(c);
+	}
+
 	++m_contactCount;
+	++m_createdCount;
 }
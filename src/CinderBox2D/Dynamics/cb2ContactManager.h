@@ -20,33 +20,208 @@
 #define CB2_CONTACT_MANAGER_H
 
 #include <CinderBox2D/Collision/cb2BroadPhase.h>
+#include <CinderBox2D/Common/cb2PairSet.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
 
-class cb2Contact;
 class cb2ContactFilter;
 class cb2ContactListener;
 class cb2BlockAllocator;
+class cb2ThreadPool;
+class cb2ImpulseCache;
+class cb2Profiler;
+class cb2Fixture;
+class cb2CollideBackend;
+struct cb2CollideJob;
+struct cb2FixtureProxy;
+
+extern cb2ContactFilter cb2_defaultFilter;
+
+// A contact whose manifold is updated after the collide pass.
+struct cb2ContactUpdate
+{
+	cb2Contact* contact;
+	cb2Manifold oldManifold;
+	bool wasTouching;
+};
 
 // Delegate of cb2World.
 class cb2ContactManager
 {
 public:
 	cb2ContactManager();
+	~cb2ContactManager();
 
 	// Broad-phase callback.
 	void AddPair(void* proxyUserDataA, void* proxyUserDataB);
 
+	// Pair the overlapping children of a shape with a single proxy with another proxy.
+	// When the other proxy also covers all children of its shape, the children of both are paired.
+	void AddChildPairs(cb2FixtureProxy* chainProxy, cb2FixtureProxy* proxy);
+
+	// Returns false if the pair has no contact type.
+	bool AddChildContact(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB);
+
+	// Link a new contact into the world and the island graph.
+	void InsertContact(cb2Contact* c);
+
+	// Do the child proxies of a contact overlap? This matches the test of AddChildPairs
+	// for shapes with a single proxy.
+	bool TestOverlap(cb2Contact* c) const;
+
+	// The fat box of one child of a shape with a single proxy over the sweep of its
+	// body, as Synchronize computes the boxes of the other proxies.
+	static void ComputeSweptChildAABB(cb2AABB* aabb, const cb2Fixture* fixture, int childIndex);
+
+	// A world box in the local frame of a body at the start of its sweep and at its
+	// transform. The children of the shapes with a single proxy are tested against it
+	// with the identity transform.
+	static cb2AABB ComputeSweptLocalAABB(const cb2Body* body, const cb2AABB& aabb);
+
 	void FindNewContacts();
 
 	void Destroy(cb2Contact* c);
 
+	// Destroy all contacts without calling the listener or storing impulses.
+	void Clear();
+
+	// Create a contact of a world snapshot and link it like a new pair. The fixtures
+	// must be in the order of the contact that was saved.
+	cb2Contact* RestoreContact(cb2Fixture* fixtureA, int indexA, cb2Fixture* fixtureB, int indexB);
+
 	void Collide();
+
+	// Grow the broad-phase, the pair set and the contact arrays for the given counts.
+	void Reserve(int proxyCount, int contactCount);
+
+	// Keep the contacts in a dense array as well as in the list, so the internal
+	// passes over all contacts are linear scans.
+	void SetContiguous(bool flag);
+	bool IsContiguous() const { return m_contactArray != NULL; }
+
+	// Iterate the contacts, in array order when the contacts are contiguous.
+	// The next contact does not depend on loading the current one.
+	cb2Contact* GetFirstContact(int* index) const;
+	cb2Contact* GetNextContact(cb2Contact* c, int* index) const;
+
+	// Keep a dense set of the contacts with an awake body. Contacts join the set when
+	// one of their bodies wakes up and leave it when Collide finds both asleep.
+	void SetAwakeContacts(bool flag);
+	bool HasAwakeContacts() const { return m_awakeContacts != NULL; }
+	void AddAwakeContact(cb2Contact* c);
+	void RemoveAwakeContact(cb2Contact* c);
+
+	// Keep the impulses of lost contact points by body pair to warm start new
+	// points. See cb2ImpulseCache.
+	void SetImpulseCache(bool flag);
+	bool HasImpulseCache() const { return m_impulseCache != NULL; }
+
+	// At least one body must be awake and it must be dynamic or kinematic.
+	static bool IsAwake(const cb2Contact* c);
+
+	// Iterate the contacts that may have an awake body. These are the awake contacts
+	// when the set is kept, otherwise all contacts.
+	cb2Contact* GetFirstAwakeContact(int* index) const;
+	cb2Contact* GetNextAwakeContact(cb2Contact* c, int* index) const;
+
+	void BufferUpdate(cb2Contact* c);
+
+	// Group the buffered updates by contact type in m_updateOrder.
+	void SortUpdates();
+	void UpdateManifolds(int begin, int end);
+
+	// Hand the buffered updates to the collide backend by type. The ones it did not
+	// take stay in m_updateOrder. Returns their count.
+	int OffloadManifolds();
+
+	// Filter a contact and buffer its update. With updateNow its manifold is also
+	// updated at once. Returns false if the contact was destroyed.
+	bool CollideContact(cb2Contact* c, bool updateNow);
+
+	// How far the shapes of a contact can approach each other in the time step.
+	float ComputeSpeculativeDistance(cb2Contact* c) const;
             
 	cb2BroadPhase m_broadPhase;
+
+	// The proxy id pairs of all contacts, so AddPair finds existing contacts in O(1).
+	cb2PairSet m_pairSet;
+
 	cb2Contact* m_contactList;
 	int m_contactCount;
+	cb2Contact** m_contactArray;
+	int m_contactArrayCapacity;
+	cb2Contact** m_awakeContacts;
+	int m_awakeContactCount;
+	int m_awakeContactCapacity;
 	cb2ContactFilter* m_contactFilter;
 	cb2ContactListener* m_contactListener;
+	cb2Profiler* m_profiler;
 	cb2BlockAllocator* m_allocator;
+
+	// Contacts created and destroyed since the world last reset the counts.
+	int m_createdCount;
+	int m_destroyedCount;
+
+	// Sensors create no contacts, see cb2World::SetSensorOverlaps.
+	bool m_sensorOverlaps;
+
+	// The time step when speculative contacts are enabled, otherwise zero.
+	float m_speculativeTime;
+
+	// Manifolds are updated one contact type at a time, on the pool when it is set,
+	// and the listener is called afterwards in contact list order.
+	cb2ThreadPool* m_threadPool;
+	cb2ContactUpdate* m_updateBuffer;
+	int* m_updateOrder;
+	int m_updateCapacity;
+	int m_updateCount;
+	int m_updateGroups[cb2Contact::e_contactTypeCount + 1];
+
+	// When set, Collide and Destroy store the impulses of lost points here.
+	cb2ImpulseCache* m_impulseCache;
+
+	cb2CollideBackend* m_collideBackend;
+	cb2CollideJob* m_collideJobs;
+	int m_collideJobCapacity;
 };
 
+inline cb2Contact* cb2ContactManager::GetFirstContact(int* index) const
+{
+	*index = 0;
+	if (m_contactArray)
+	{
+		return m_contactCount > 0 ? m_contactArray[0] : NULL;
+	}
+	return m_contactList;
+}
+
+inline cb2Contact* cb2ContactManager::GetNextContact(cb2Contact* c, int* index) const
+{
+	++*index;
+	if (m_contactArray)
+	{
+		return *index < m_contactCount ? m_contactArray[*index] : NULL;
+	}
+	return c->GetNext();
+}
+
+inline cb2Contact* cb2ContactManager::GetFirstAwakeContact(int* index) const
+{
+	if (m_awakeContacts)
+	{
+		*index = 0;
+		return m_awakeContactCount > 0 ? m_awakeContacts[0] : NULL;
+	}
+	return GetFirstContact(index);
+}
+
+inline cb2Contact* cb2ContactManager::GetNextAwakeContact(cb2Contact* c, int* index) const
+{
+	if (m_awakeContacts)
+	{
+		++*index;
+		return *index < m_awakeContactCount ? m_awakeContacts[*index] : NULL;
+	}
+	return GetNextContact(c, index);
+}
+
 #endif
@@ -18,10 +18,14 @@
 
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
+#include <CinderBox2D/Dynamics/cb2SensorManager.h>
 #include <CinderBox2D/Dynamics/cb2World.h>
 #include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2HeightfieldShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CompoundShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
 #include <CinderBox2D/Collision/cb2BroadPhase.h>
 #include <CinderBox2D/Collision/cb2Collision.h>
@@ -43,6 +47,8 @@ void cb2Fixture::Create(cb2BlockAllocator* allocator, cb2Body* body, const cb2Fi
 	m_userData = def->userData;
 	m_friction = def->friction;
 	m_restitution = def->restitution;
+	cb2Assert(-1 <= def->material && def->material < cb2_maxMaterials);
+	m_material = def->material;
 
 	m_body = body;
 	m_next = NULL;
@@ -50,6 +56,8 @@ void cb2Fixture::Create(cb2BlockAllocator* allocator, cb2Body* body, const cb2Fi
 	m_filter = def->filter;
 
 	m_isSensor = def->isSensor;
+	m_reportPostSolve = def->reportPostSolve;
+	m_sensorIndex = -1;
 
 	m_shape = def->shape->Clone(allocator);
 
@@ -111,6 +119,30 @@ void cb2Fixture::Destroy(cb2BlockAllocator* allocator)
 		}
 		break;
 
+	case cb2Shape::e_capsule:
+		{
+			cb2CapsuleShape* s = (cb2CapsuleShape*)m_shape;
+			s->~cb2CapsuleShape();
+			allocator->Free(s, sizeof(cb2CapsuleShape));
+		}
+		break;
+
+	case cb2Shape::e_heightfield:
+		{
+			cb2HeightfieldShape* s = (cb2HeightfieldShape*)m_shape;
+			s->~cb2HeightfieldShape();
+			allocator->Free(s, sizeof(cb2HeightfieldShape));
+		}
+		break;
+
+	case cb2Shape::e_compound:
+		{
+			cb2CompoundShape* s = (cb2CompoundShape*)m_shape;
+			s->~cb2CompoundShape();
+			allocator->Free(s, sizeof(cb2CompoundShape));
+		}
+		break;
+
 	default:
 		cb2Assert(false);
 		break;
@@ -119,6 +151,23 @@ void cb2Fixture::Destroy(cb2BlockAllocator* allocator)
 	m_shape = NULL;
 }
 
+// Pad of the proxy bounds over the child AABBs, covering the rounding of both.
+const float cb2_proxyBoundPad = 0.1f * cb2_linearSlop;
+
+// A box that covers the child of a proxy at a transform.
+static inline cb2AABB cb2ComputeProxyBound(const cb2FixtureProxy* proxy, const cb2Transform& xf)
+{
+	ci::Vec2f c = cb2Mul(xf, proxy->localCenter);
+	ci::Vec2f h = proxy->localExtents;
+	float rx = cb2Min(cb2Abs(xf.q.c) * h.x + cb2Abs(xf.q.s) * h.y, proxy->localRadius) + cb2_proxyBoundPad;
+	float ry = cb2Min(cb2Abs(xf.q.s) * h.x + cb2Abs(xf.q.c) * h.y, proxy->localRadius) + cb2_proxyBoundPad;
+
+	cb2AABB bound;
+	bound.lowerBound.set(c.x - rx, c.y - ry);
+	bound.upperBound.set(c.x + rx, c.y + ry);
+	return bound;
+}
+
 void cb2Fixture::CreateProxies(cb2BroadPhase* broadPhase, const cb2Transform& xf)
 {
 	cb2Assert(m_proxyCount == 0);
@@ -126,13 +175,63 @@ void cb2Fixture::CreateProxies(cb2BroadPhase* broadPhase, const cb2Transform& xf
 	// Create proxies in the broad-phase.
 	m_proxyCount = m_shape->GetChildCount();
 
+	// A chain with a child tree, a heightfield or a compound uses one proxy and the
+	// contact manager resolves the children.
+	bool allChildren = m_shape->GetType() == cb2Shape::e_heightfield || m_shape->GetType() == cb2Shape::e_compound ||
+		(m_shape->GetType() == cb2Shape::e_chain && ((cb2ChainShape*)m_shape)->GetChildTree() != NULL);
+	if (allChildren)
+	{
+		m_proxyCount = 1;
+	}
+
+	cb2Transform identity;
+	identity.SetIdentity();
+
 	for (int i = 0; i < m_proxyCount; ++i)
 	{
 		cb2FixtureProxy* proxy = m_proxies + i;
-		m_shape->ComputeAABB(&proxy->aabb, xf, i);
-		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy);
+		proxy->childIndex = allChildren ? cb2ChainShape::e_allChildren : i;
+		m_shape->ComputeAABB(&proxy->aabb, xf, proxy->childIndex);
+		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy, m_body->GetType() == cb2_staticBody, m_filter.layer);
 		proxy->fixture = this;
-		proxy->childIndex = i;
+
+		cb2AABB local;
+		m_shape->ComputeAABB(&local, identity, proxy->childIndex);
+		proxy->localCenter = local.GetCenter();
+		proxy->localExtents = local.GetExtents();
+
+		// A circle is its own bounding circle.
+		proxy->localRadius = m_shape->GetType() == cb2Shape::e_circle ? m_shape->m_radius : proxy->localExtents.length();
+	}
+
+	UpdateProxyKeys(broadPhase);
+}
+
+void cb2Fixture::UpdateProxyKeys(cb2BroadPhase* broadPhase)
+{
+	cb2ProxyKey key;
+	key.owner = m_body->GetId();
+	key.categoryBits = m_filter.categoryBits;
+	key.maskBits = m_filter.maskBits;
+	key.groupIndex = m_filter.groupIndex;
+	key.layer = (unsigned char)m_filter.layer;
+	key.flags = 0;
+	if (m_body->GetType() != cb2_dynamicBody)
+	{
+		key.flags |= cb2ProxyKey::e_fixedFlag;
+	}
+	if (m_body->GetType() == cb2_staticBody)
+	{
+		key.flags |= cb2ProxyKey::e_staticFlag;
+	}
+	if (m_isSensor)
+	{
+		key.flags |= cb2ProxyKey::e_sensorFlag;
+	}
+
+	for (int i = 0; i < m_proxyCount; ++i)
+	{
+		broadPhase->SetProxyKey(m_proxies[i].proxyId, key);
 	}
 }
 
@@ -160,6 +259,22 @@ void cb2Fixture::Synchronize(cb2BroadPhase* broadPhase, const cb2Transform& tran
 	{
 		cb2FixtureProxy* proxy = m_proxies + i;
 
+		// The broad-phase keeps the proxy if its fat AABB still contains the cheap
+		// cover of the swept child.
+		cb2AABB bound1 = cb2ComputeProxyBound(proxy, transform1);
+		cb2AABB bound2 = cb2ComputeProxyBound(proxy, transform2);
+		cb2AABB bound;
+		bound.Combine(bound1, bound2);
+		if (broadPhase->GetFatAABB(proxy->proxyId).Contains(bound))
+		{
+			proxy->aabb = bound;
+			if (proxy->childIndex == cb2ChainShape::e_allChildren)
+			{
+				broadPhase->TouchProxy(proxy->proxyId);
+			}
+			continue;
+		}
+
 		// Compute an AABB that covers the swept shape (may miss some rotation effect).
 		cb2AABB aabb1, aabb2;
 		m_shape->ComputeAABB(&aabb1, transform1, proxy->childIndex);
@@ -170,13 +285,122 @@ void cb2Fixture::Synchronize(cb2BroadPhase* broadPhase, const cb2Transform& tran
 		ci::Vec2f displacement = transform2.p - transform1.p;
 
 		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement);
+
+		// The children move inside the proxy, so their pairs are found again.
+		if (proxy->childIndex == cb2ChainShape::e_allChildren)
+		{
+			broadPhase->TouchProxy(proxy->proxyId);
+		}
+	}
+}
+
+void cb2Fixture::Synchronize(cb2BroadPhase* broadPhase, const cb2Transform& transform1, const cb2Transform& transform2,
+							 const ci::Vec2f& prediction)
+{
+	for (int i = 0; i < m_proxyCount; ++i)
+	{
+		cb2FixtureProxy* proxy = m_proxies + i;
+
+		cb2AABB bound1 = cb2ComputeProxyBound(proxy, transform1);
+		cb2AABB bound2 = cb2ComputeProxyBound(proxy, transform2);
+		cb2AABB bound, bound3;
+		bound.Combine(bound1, bound2);
+		bound3.lowerBound = bound2.lowerBound + prediction;
+		bound3.upperBound = bound2.upperBound + prediction;
+		bound3.Combine(bound, bound3);
+		if (broadPhase->GetFatAABB(proxy->proxyId).Contains(bound3))
+		{
+			proxy->aabb = bound;
+			if (proxy->childIndex == cb2ChainShape::e_allChildren)
+			{
+				broadPhase->TouchProxy(proxy->proxyId);
+			}
+			continue;
+		}
+
+		cb2AABB aabb1, aabb2;
+		m_shape->ComputeAABB(&aabb1, transform1, proxy->childIndex);
+		m_shape->ComputeAABB(&aabb2, transform2, proxy->childIndex);
+	
+		proxy->aabb.Combine(aabb1, aabb2);
+
+		// The broad-phase also covers the next step, so the contact exists before the impact.
+		cb2AABB aabb3;
+		aabb3.lowerBound = aabb2.lowerBound + prediction;
+		aabb3.upperBound = aabb2.upperBound + prediction;
+		aabb3.Combine(proxy->aabb, aabb3);
+
+		ci::Vec2f displacement = transform2.p - transform1.p;
+
+		broadPhase->MoveProxy(proxy->proxyId, aabb3, displacement);
+
+		if (proxy->childIndex == cb2ChainShape::e_allChildren)
+		{
+			broadPhase->TouchProxy(proxy->proxyId);
+		}
+	}
+}
+
+void cb2Fixture::PrepareSynchronize(const cb2BroadPhase* broadPhase, const cb2Transform& transform1, const cb2Transform& transform2,
+									const ci::Vec2f* prediction, cb2ProxyMove* moves)
+{
+	for (int i = 0; i < m_proxyCount; ++i)
+	{
+		cb2FixtureProxy* proxy = m_proxies + i;
+		cb2ProxyMove* move = moves + i;
+		move->proxyId = proxy->proxyId;
+		move->touch = proxy->childIndex == cb2ChainShape::e_allChildren;
+
+		// The same tests as Synchronize, so the results do not depend on the path.
+		cb2AABB bound1 = cb2ComputeProxyBound(proxy, transform1);
+		cb2AABB bound2 = cb2ComputeProxyBound(proxy, transform2);
+		cb2AABB bound, cover;
+		bound.Combine(bound1, bound2);
+		cover = bound;
+		if (prediction)
+		{
+			cb2AABB bound3;
+			bound3.lowerBound = bound2.lowerBound + *prediction;
+			bound3.upperBound = bound2.upperBound + *prediction;
+			cover.Combine(bound, bound3);
+		}
+
+		if (broadPhase->GetFatAABB(proxy->proxyId).Contains(cover))
+		{
+			proxy->aabb = bound;
+			move->move = false;
+			continue;
+		}
+
+		cb2AABB aabb1, aabb2;
+		m_shape->ComputeAABB(&aabb1, transform1, proxy->childIndex);
+		m_shape->ComputeAABB(&aabb2, transform2, proxy->childIndex);
+
+		proxy->aabb.Combine(aabb1, aabb2);
+		move->aabb = proxy->aabb;
+		if (prediction)
+		{
+			cb2AABB aabb3;
+			aabb3.lowerBound = aabb2.lowerBound + *prediction;
+			aabb3.upperBound = aabb2.upperBound + *prediction;
+			move->aabb.Combine(proxy->aabb, aabb3);
+		}
+
+		move->displacement = transform2.p - transform1.p;
+		move->move = true;
 	}
 }
 
 void cb2Fixture::SetFilterData(const cb2Filter& filter)
 {
+	cb2Assert(0 <= filter.layer && filter.layer < cb2_maxLayers);
 	m_filter = filter;
 
+	if (m_body != NULL && m_body->GetWorld() != NULL)
+	{
+		UpdateProxyKeys(&m_body->GetWorld()->m_contactManager.m_broadPhase);
+	}
+
 	Refilter();
 }
 
@@ -217,12 +441,79 @@ void cb2Fixture::Refilter()
 	}
 }
 
+void cb2Fixture::SetMaterial(int material)
+{
+	cb2Assert(-1 <= material && material < cb2_maxMaterials);
+	m_material = material;
+
+	for (cb2ContactEdge* edge = m_body->GetContactList(); edge; edge = edge->next)
+	{
+		cb2Contact* contact = edge->contact;
+		if (contact->m_fixtureA == this || contact->m_fixtureB == this)
+		{
+			contact->UpdateMaterial();
+		}
+	}
+}
+
 void cb2Fixture::SetSensor(bool sensor)
 {
 	if (sensor != m_isSensor)
 	{
 		m_body->SetAwake(true);
 		m_isSensor = sensor;
+		UpdateProxyKeys(&m_body->GetWorld()->m_contactManager.m_broadPhase);
+
+		// The contacts of a new sensor are destroyed by the next collide and a fixture
+		// that is no longer a sensor finds its pairs again.
+		cb2World* world = m_body->GetWorld();
+		if (world->m_sensorManager)
+		{
+			if (sensor)
+			{
+				world->m_sensorManager->AddSensor(this);
+			}
+			else
+			{
+				world->m_sensorManager->RemoveSensor(this, world->m_contactManager.m_contactListener);
+			}
+			Refilter();
+		}
+	}
+}
+
+void cb2Fixture::SetReportPostSolve(bool flag)
+{
+	if (flag == m_reportPostSolve)
+	{
+		return;
+	}
+
+	m_reportPostSolve = flag;
+	if (m_body == NULL)
+	{
+		return;
+	}
+
+	cb2ContactEdge* edge = m_body->GetContactList();
+	while (edge)
+	{
+		cb2Contact* contact = edge->contact;
+		cb2Fixture* fixtureA = contact->GetFixtureA();
+		cb2Fixture* fixtureB = contact->GetFixtureB();
+		if (fixtureA == this || fixtureB == this)
+		{
+			if (fixtureA->m_reportPostSolve || fixtureB->m_reportPostSolve)
+			{
+				contact->m_flags |= cb2Contact::e_postSolveFlag;
+			}
+			else
+			{
+				contact->m_flags &= ~cb2Contact::e_postSolveFlag;
+			}
+		}
+
+		edge = edge->next;
 	}
 }
 
@@ -231,11 +522,14 @@ void cb2Fixture::Dump(int bodyIndex)
 	cb2Log("    cb2FixtureDef fd;\n");
 	cb2Log("    fd.friction = %.15lef;\n", m_friction);
 	cb2Log("    fd.restitution = %.15lef;\n", m_restitution);
+	cb2Log("    fd.material = %d;\n", m_material);
 	cb2Log("    fd.density = %.15lef;\n", m_density);
 	cb2Log("    fd.isSensor = bool(%d);\n", m_isSensor);
+	cb2Log("    fd.reportPostSolve = bool(%d);\n", m_reportPostSolve);
 	cb2Log("    fd.filter.categoryBits = unsigned short(%d);\n", m_filter.categoryBits);
 	cb2Log("    fd.filter.maskBits = unsigned short(%d);\n", m_filter.maskBits);
 	cb2Log("    fd.filter.groupIndex = short(%d);\n", m_filter.groupIndex);
+	cb2Log("    fd.filter.layer = %d;\n", m_filter.layer);
 
 	switch (m_shape->m_type)
 	{
@@ -292,6 +586,50 @@ void cb2Fixture::Dump(int bodyIndex)
 		}
 		break;
 
+	case cb2Shape::e_capsule:
+		{
+			cb2CapsuleShape* s = (cb2CapsuleShape*)m_shape;
+			cb2Log("    cb2CapsuleShape shape;\n");
+			cb2Log("    shape.m_radius = %.15lef;\n", s->m_radius);
+			cb2Log("    shape.m_vertex1.set(%.15lef, %.15lef);\n", s->m_vertex1.x, s->m_vertex1.y);
+			cb2Log("    shape.m_vertex2.set(%.15lef, %.15lef);\n", s->m_vertex2.x, s->m_vertex2.y);
+		}
+		break;
+
+	case cb2Shape::e_heightfield:
+		{
+			cb2HeightfieldShape* s = (cb2HeightfieldShape*)m_shape;
+			cb2Log("    cb2HeightfieldShape shape;\n");
+			cb2Log("    float hs[%d];\n", s->m_count);
+			for (int i = 0; i < s->m_count; ++i)
+			{
+				cb2Log("    hs[%d] = %.15lef;\n", i, s->m_heights[i]);
+			}
+			cb2Log("    shape.Create(hs, %d, %.15lef);\n", s->m_count, s->m_spacing);
+		}
+		break;
+
+	case cb2Shape::e_compound:
+		{
+			cb2CompoundShape* s = (cb2CompoundShape*)m_shape;
+			cb2Log("    cb2CompoundShape shape;\n");
+			cb2Log("    cb2PolygonShape pieces[%d];\n", s->m_count);
+			for (int i = 0; i < s->m_count; ++i)
+			{
+				const cb2PolygonShape* piece = s->GetChild(i);
+				cb2Log("    {\n");
+				cb2Log("      ci::Vec2f vs[%d];\n", cb2_maxPolygonVertices);
+				for (int j = 0; j < piece->m_count; ++j)
+				{
+					cb2Log("      vs[%d].set(%.15lef, %.15lef);\n", j, piece->m_vertices[j].x, piece->m_vertices[j].y);
+				}
+				cb2Log("      pieces[%d].SetConvex(vs, %d);\n", i, piece->m_count);
+				cb2Log("    }\n");
+			}
+			cb2Log("    shape.Create(pieces, %d);\n", s->m_count);
+		}
+		break;
+
 	default:
 		return;
 	}
@@ -22,11 +22,13 @@
 #include <CinderBox2D/Dynamics/cb2Body.h>
 #include <CinderBox2D/Collision/cb2Collision.h>
 #include <CinderBox2D/Collision/Shapes/cb2Shape.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
 
 class cb2BlockAllocator;
 class cb2Body;
 class cb2BroadPhase;
 class cb2Fixture;
+struct cb2ProxyMove;
 
 /// This holds contact filtering data.
 struct cb2Filter
@@ -36,6 +38,7 @@ struct cb2Filter
 		categoryBits = 0x0001;
 		maskBits = 0xFFFF;
 		groupIndex = 0;
+		layer = 0;
 	}
 
 	/// The collision category bits. Normally you would just set one bit.
@@ -49,6 +52,11 @@ struct cb2Filter
 	/// or always collide (positive). Zero means no collision group. Non-zero group
 	/// filtering always wins against the mask bits.
 	short groupIndex;
+
+	/// The layer of the layer collision matrix, in [0, cb2_maxLayers). Unlike the bits
+	/// above, the layer is tested by the broad-phase before any contact is made.
+	/// See cb2World::SetLayerCollision.
+	int layer;
 };
 
 /// A fixture definition is used to create a fixture. This class defines an
@@ -62,8 +70,10 @@ struct cb2FixtureDef
 		userData = NULL;
 		friction = 0.2f;
 		restitution = 0.0f;
+		material = -1;
 		density = 0.0f;
 		isSensor = false;
+		reportPostSolve = true;
 	}
 
 	/// The shape, this must be set. The shape will be cloned, so you
@@ -79,6 +89,10 @@ struct cb2FixtureDef
 	/// The restitution (elasticity) usually in the range [0,1].
 	float restitution;
 
+	/// The material of the material table of the world, or -1 to use the friction and
+	/// restitution above. See cb2World::SetMaterial.
+	int material;
+
 	/// The density, usually in kg/m^2.
 	float density;
 
@@ -86,17 +100,29 @@ struct cb2FixtureDef
 	/// response.
 	bool isSensor;
 
+	/// Clear this if the contact listener does not need PostSolve for this fixture.
+	/// A contact is reported if either of its fixtures wants it.
+	bool reportPostSolve;
+
 	/// Contact filtering data.
 	cb2Filter filter;
 };
 
 /// This proxy is used internally to connect fixtures to the broad-phase.
+/// The child index is cb2ChainShape::e_allChildren for a chain with a child tree, a heightfield
+/// or a compound.
 struct cb2FixtureProxy
 {
 	cb2AABB aabb;
 	cb2Fixture* fixture;
 	int childIndex;
 	int proxyId;
+
+	// The child box in body space and a bounding radius about its center, so a
+	// cover of the child at any transform needs no call to the shape.
+	ci::Vec2f localCenter;
+	ci::Vec2f localExtents;
+	float localRadius;
 };
 
 /// A fixture is used to attach a shape to a body for collision detection. A fixture
@@ -113,7 +139,8 @@ public:
 
 	/// Get the child shape. You can modify the child shape, however you should not change the
 	/// number of vertices because this will crash some collision caching mechanisms.
-	/// Manipulating the shape may lead to non-physical behavior.
+	/// Manipulating the shape may lead to non-physical behavior. The proxies keep the child
+	/// bounds in body space, so deactivate and activate the body after growing the shape.
 	cb2Shape* GetShape();
 	const cb2Shape* GetShape() const;
 
@@ -124,6 +151,10 @@ public:
 	/// @return the true if the shape is a sensor.
 	bool IsSensor() const;
 
+	/// Set if the contacts of this fixture are reported to cb2ContactListener::PostSolve.
+	void SetReportPostSolve(bool flag);
+	bool GetReportPostSolve() const;
+
 	/// Set the contact filtering data. This will not update contacts until the next time
 	/// step when either parent body is active and awake.
 	/// This automatically calls Refilter.
@@ -187,9 +218,14 @@ public:
 	/// existing contacts.
 	void SetRestitution(float restitution);
 
+	/// Set the material of this fixture, or -1 for none. See cb2FixtureDef::material.
+	/// This updates the friction, restitution and tangent speed of the existing contacts.
+	void SetMaterial(int material);
+	int GetMaterial() const { return m_material; }
+
 	/// Get the fixture's AABB. This AABB may be enlarge and/or stale.
 	/// If you need a more accurate AABB, compute it using the shape and
-	/// the body transform.
+	/// the body transform. All children of a chain with a child tree share one AABB.
 	const cb2AABB& GetAABB(int childIndex) const;
 
 	/// Dump this fixture to the log file.
@@ -201,6 +237,9 @@ protected:
 	friend class cb2World;
 	friend class cb2Contact;
 	friend class cb2ContactManager;
+	friend class cb2QuerySnapshot;
+	friend class cb2SensorManager;
+	friend class cb2SynchronizeFixturesTask;
 
 	cb2Fixture();
 
@@ -213,8 +252,24 @@ protected:
 	void CreateProxies(cb2BroadPhase* broadPhase, const cb2Transform& xf);
 	void DestroyProxies(cb2BroadPhase* broadPhase);
 
+	// Give the proxies the body id, body type, sensor flag and filter of this fixture.
+	void UpdateProxyKeys(cb2BroadPhase* broadPhase);
+
 	void Synchronize(cb2BroadPhase* broadPhase, const cb2Transform& xf1, const cb2Transform& xf2);
 
+	// Get the proxy that covers a child.
+	cb2FixtureProxy* GetProxy(int childIndex) const;
+
+	// Same as above, also covering the shape at xf2 moved by the predicted translation.
+	void Synchronize(cb2BroadPhase* broadPhase, const cb2Transform& xf1, const cb2Transform& xf2,
+					 const ci::Vec2f& prediction);
+
+	// The first half of Synchronize, safe to run on several bodies at once. This updates the
+	// proxy boxes and writes one entry per proxy to moves, which the caller applies in order
+	// with cb2BroadPhase::MoveProxy and TouchProxy. The prediction may be NULL.
+	void PrepareSynchronize(const cb2BroadPhase* broadPhase, const cb2Transform& xf1, const cb2Transform& xf2,
+							const ci::Vec2f* prediction, cb2ProxyMove* moves);
+
 	float m_density;
 
 	cb2Fixture* m_next;
@@ -224,6 +279,7 @@ protected:
 
 	float m_friction;
 	float m_restitution;
+	int m_material;
 
 	cb2FixtureProxy* m_proxies;
 	int m_proxyCount;
@@ -231,6 +287,10 @@ protected:
 	cb2Filter m_filter;
 
 	bool m_isSensor;
+	bool m_reportPostSolve;
+
+	// The index in the sensor manager, or -1. See cb2World::SetSensorOverlaps.
+	int m_sensorIndex;
 
 	void* m_userData;
 };
@@ -255,6 +315,11 @@ inline bool cb2Fixture::IsSensor() const
 	return m_isSensor;
 }
 
+inline bool cb2Fixture::GetReportPostSolve() const
+{
+	return m_reportPostSolve;
+}
+
 inline const cb2Filter& cb2Fixture::GetFilterData() const
 {
 	return m_filter;
@@ -336,10 +401,20 @@ inline void cb2Fixture::GetMassData(cb2MassData* massData) const
 	m_shape->ComputeMass(massData, m_density);
 }
 
+inline cb2FixtureProxy* cb2Fixture::GetProxy(int childIndex) const
+{
+	cb2Assert(0 <= childIndex && childIndex < m_shape->GetChildCount());
+	if (m_proxies[0].childIndex == cb2ChainShape::e_allChildren)
+	{
+		return m_proxies;
+	}
+	return m_proxies + childIndex;
+}
+
 inline const cb2AABB& cb2Fixture::GetAABB(int childIndex) const
 {
-	cb2Assert(0 <= childIndex && childIndex < m_proxyCount);
-	return m_proxies[childIndex].aabb;
+	cb2Assert(m_proxyCount > 0);
+	return GetProxy(childIndex)->aabb;
 }
 
 #endif
@@ -20,12 +20,19 @@
 #include <CinderBox2D/Dynamics/cb2Island.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2TargetDrives.h>
 #include <CinderBox2D/Dynamics/cb2World.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2ContactSolver.h>
 #include <CinderBox2D/Dynamics/Joints/cb2Joint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2JointTreeSolver.h>
+#include <CinderBox2D/Common/cb2Simd.h>
 #include <CinderBox2D/Common/cb2StackAllocator.h>
+#include <CinderBox2D/Common/cb2ThreadPool.h>
 #include <CinderBox2D/Common/cb2Timer.h>
+#include <CinderBox2D/Common/cb2Profiler.h>
+#include <memory.h>
+#include <algorithm>
 
 /*
 Position Correction Notes
@@ -145,6 +152,14 @@ This might be faster than computing sin+cos.
 However, we can compute sin+cos of the same angle fast.
 */
 
+// With early sleep, an island that rested for this many steps skips the position
+// iterations. A body rests while it is below the sleep tolerances.
+const int cb2_restingSteps = 4;
+
+// With early sleep, a resting island with all speeds below this fraction of the sleep
+// tolerances falls asleep after this fraction of cb2_timeToSleep.
+const float cb2_earlySleepFraction = 0.25f;
+
 cb2Island::cb2Island(
 	int bodyCapacity,
 	int contactCapacity,
@@ -155,12 +170,28 @@ cb2Island::cb2Island(
 	m_bodyCapacity = bodyCapacity;
 	m_contactCapacity = contactCapacity;
 	m_jointCapacity	 = jointCapacity;
+	m_staticCount = 0;
 	m_bodyCount = 0;
 	m_contactCount = 0;
 	m_jointCount = 0;
 
 	m_allocator = allocator;
 	m_listener = listener;
+	m_impulses = NULL;
+	m_splitPending = false;
+	m_maxSleepTime = 0.0f;
+
+	m_targetDrives = NULL;
+	m_profiler = NULL;
+	m_threadIndex = 0;
+
+	m_threadPool = NULL;
+	m_colors = NULL;
+	m_colorJoints = NULL;
+	m_colorContacts = NULL;
+	m_threadSeparations = NULL;
+	m_threadJointsOkay = NULL;
+	m_threadImpulses = NULL;
 
 	m_bodies = (cb2Body**)m_allocator->Allocate(bodyCapacity * sizeof(cb2Body*));
 	m_contacts = (cb2Contact**)m_allocator->Allocate(contactCapacity	 * sizeof(cb2Contact*));
@@ -182,45 +213,81 @@ cb2Island::~cb2Island()
 
 void cb2Island::Solve(cb2Profile* profile, const cb2TimeStep& step, const ci::Vec2f& gravity, bool allowSleep)
 {
+	cb2ProfileZone zone(m_profiler, "Island", m_bodyCount - m_staticCount, m_threadIndex);
+
+	if (step.spatialOrdering)
+	{
+		SortSpatially();
+	}
+
+	if (step.jointBatching)
+	{
+		SortJoints();
+	}
+
+	if (step.solverType == cb2_softStepSolver)
+	{
+		SolveSoftStep(profile, step, gravity, allowSleep);
+		return;
+	}
+
 	cb2Timer timer;
 
 	float h = step.dt;
 
+	// The island rest time is the shortest rest time of its bodies.
+	float restTime = cb2_maxFloat;
+
 	// Integrate velocities and apply damping. Initialize the body state.
-	for (int i = 0; i < m_bodyCount; ++i)
+	if (step.batchIntegration)
 	{
-		cb2Body* b = m_bodies[i];
+		IntegrateVelocities(h, gravity, &restTime);
+	}
+	else
+	{
+		for (int i = 0; i < m_bodyCount; ++i)
+		{
+			cb2Body* b = m_bodies[i];
 
-		ci::Vec2f c = b->m_sweep.c;
-		float a = b->m_sweep.a;
-		ci::Vec2f v = b->m_linearVelocity;
-		float w = b->m_angularVelocity;
+			if (b->m_type != cb2_staticBody)
+			{
+				restTime = cb2Min(restTime, (b->m_flags & cb2Body::e_autoSleepFlag) ? b->m_sleepTime : 0.0f);
+			}
 
-		// Store positions for continuous collision.
-		b->m_sweep.c0 = b->m_sweep.c;
-		b->m_sweep.a0 = b->m_sweep.a;
+			ci::Vec2f c = b->m_sweep.c;
+			float a = b->m_sweep.a;
+			ci::Vec2f v = b->m_linearVelocity;
+			float w = b->m_angularVelocity;
 
-		if (b->m_type == cb2_dynamicBody)
-		{
-			// Integrate velocities.
-			v += h * (b->m_gravityScale * gravity + b->m_invMass * b->m_force);
-			w += h * b->m_invI * b->m_torque;
+			// Store positions for continuous collision. Shared static bodies never move.
+			if (i >= m_staticCount)
+			{
+				b->m_sweep.c0 = b->m_sweep.c;
+				b->m_sweep.a0 = b->m_sweep.a;
+			}
 
-			// Apply damping.
-			// ODE: dv/dt + c * v = 0
-			// Solution: v(t) = v0 * exp(-c * t)
-			// Time step: v(t + dt) = v0 * exp(-c * (t + dt)) = v0 * exp(-c * t) * exp(-c * dt) = v * exp(-c * dt)
-			// v2 = exp(-c * dt) * v1
-			// Pade approximation:
-			// v2 = v1 * 1 / (1 + c * dt)
-			v *= 1.0f / (1.0f + h * b->m_linearDamping);
-			w *= 1.0f / (1.0f + h * b->m_angularDamping);
-		}
+			if (b->m_type == cb2_dynamicBody)
+			{
+				// Integrate velocities.
+				v += h * (b->m_gravityScale * gravity + b->m_invMass * b->m_force);
+				w += h * b->m_invI * b->m_torque;
+
+				// Apply damping.
+				// ODE: dv/dt + c * v = 0
+				// Solution: v(t) = v0 * exp(-c * t)
+				// Time step: v(t + dt) = v0 * exp(-c * (t + dt)) = v0 * exp(-c * t) * exp(-c * dt) = v * exp(-c * dt)
+				// v2 = exp(-c * dt) * v1
+				// Pade approximation:
+				// v2 = v1 * 1 / (1 + c * dt)
+				v *= 1.0f / (1.0f + h * b->m_linearDamping);
+				w *= 1.0f / (1.0f + h * b->m_angularDamping);
+			}
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+			m_positions[i].c = c;
+			m_positions[i].a = a;
+			m_velocities[i].v = v;
+			m_velocities[i].w = w;
+		}
 	}
 
 	timer.Reset();
@@ -230,14 +297,30 @@ void cb2Island::Solve(cb2Profile* profile, const cb2TimeStep& step, const ci::Ve
 	solverData.step = step;
 	solverData.positions = m_positions;
 	solverData.velocities = m_velocities;
+	solverData.staticBodies = m_bodies;
+	solverData.staticCount = m_staticCount;
+
+	// Leave the reduced contacts out while solving.
+	int contactCount = m_contactCount;
+	if (step.contactReduction)
+	{
+		m_contactCount = ReduceContacts();
+	}
 
 	// Initialize velocity constraints.
 	cb2ContactSolverDef contactSolverDef;
 	contactSolverDef.step = step;
+	if (m_threadPool)
+	{
+		// Wide batches are not split across threads.
+		contactSolverDef.step.wideContactSolver = false;
+	}
 	contactSolverDef.contacts = m_contacts;
 	contactSolverDef.count = m_contactCount;
 	contactSolverDef.positions = m_positions;
 	contactSolverDef.velocities = m_velocities;
+	contactSolverDef.staticBodies = m_bodies;
+	contactSolverDef.staticCount = m_staticCount;
 	contactSolverDef.allocator = m_allocator;
 
 	cb2ContactSolver contactSolver(&contactSolverDef);
@@ -248,74 +331,104 @@ void cb2Island::Solve(cb2Profile* profile, const cb2TimeStep& step, const ci::Ve
 		contactSolver.WarmStart();
 	}
 	
-	for (int i = 0; i < m_jointCount; ++i)
+	SolveJoints(solverData, e_initVelocityPass);
+	int targetDrives = m_targetDrives ? m_targetDrives->InitVelocityConstraints(m_bodies, m_staticCount, m_bodyCount, solverData) : -1;
+
+	// Leave the joint trees out of the iterations, they are solved directly.
+	cb2JointTreeSolver treeSolver(m_allocator);
+	int jointCount = m_jointCount;
+	if (step.directJointSolver && m_threadPool == NULL)
 	{
-		m_joints[i]->InitVelocityConstraints(solverData);
+		m_jointCount = treeSolver.Initialize(m_bodyCount, m_joints, m_jointCount, solverData);
+	}
+
+	if (m_threadPool)
+	{
+		ColorConstraints(&contactSolver);
 	}
 
 	profile->solveInit = timer.GetMilliseconds();
 
 	// Solve velocity constraints
 	timer.Reset();
-	for (int i = 0; i < step.velocityIterations; ++i)
+	bool trackJoints = step.impulseTolerance > 0.0f;
+	int velocityIterations = 0;
+	while (velocityIterations < step.velocityIterations)
 	{
-		for (int j = 0; j < m_jointCount; ++j)
+		++velocityIterations;
+
+		float maxImpulse = 0.0f;
+		if (m_threadPool)
 		{
-			m_joints[j]->SolveVelocityConstraints(solverData);
+			maxImpulse = SolveVelocityColors(&contactSolver, solverData, trackJoints);
 		}
+		else
+		{
+			treeSolver.Solve(solverData);
 
-		contactSolver.SolveVelocityConstraints();
-	}
-
-	// Store impulses for warm starting
-	contactSolver.StoreImpulses();
-	profile->solveVelocity = timer.GetMilliseconds();
+			if (trackJoints)
+			{
+				for (int j = 0; j < m_jointCount; ++j)
+				{
+					maxImpulse = cb2Max(maxImpulse, SolveJointVelocity(m_joints[j], solverData));
+				}
+			}
+			else
+			{
+				SolveJoints(solverData, e_solveVelocityPass);
+			}
 
-	// Integrate positions
-	for (int i = 0; i < m_bodyCount; ++i)
-	{
-		ci::Vec2f c = m_positions[i].c;
-		float a = m_positions[i].a;
-		ci::Vec2f v = m_velocities[i].v;
-		float w = m_velocities[i].w;
+			maxImpulse = cb2Max(maxImpulse, contactSolver.SolveVelocityConstraints());
+		}
 
-		// Check for large velocities
-		ci::Vec2f translation = h * v;
-		if (cb2Dot(translation, translation) > cb2_maxTranslationSquared)
+		if (targetDrives != -1)
 		{
-			float ratio = cb2_maxTranslation / translation.length();
-			v *= ratio;
+			m_targetDrives->SolveVelocityConstraints(targetDrives, solverData);
 		}
 
-		float rotation = h * w;
-		if (rotation * rotation > cb2_maxRotationSquared)
+		if (maxImpulse < step.impulseTolerance)
 		{
-			float ratio = cb2_maxRotation / cb2Abs(rotation);
-			w *= ratio;
+			// Converged.
+			break;
 		}
+	}
+	profile->velocityIterations = velocityIterations;
+	profile->maxVelocityIterations = velocityIterations;
+	m_jointCount = jointCount;
+	profile->jointsBroken = CheckBrokenJoints(step.inv_dt);
 
-		// Integrate
-		c += h * v;
-		a += h * w;
+	// Store impulses for warm starting
+	contactSolver.StoreImpulses();
+	profile->solveVelocity = timer.GetMilliseconds();
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+	// Integrate positions
+	IntegratePositions(h, step.batchIntegration);
+
+	// A resting island has no approaching contacts left to push apart.
+	int positionIterations = step.positionIterations;
+	bool positionSolved = false;
+	if (step.earlySleep && allowSleep && restTime >= cb2_restingSteps * h)
+	{
+		positionIterations = 0;
+		positionSolved = true;
 	}
 
 	// Solve position constraints
 	timer.Reset();
-	bool positionSolved = false;
-	for (int i = 0; i < step.positionIterations; ++i)
+	profile->positionIterations = 0;
+	for (int i = 0; i < positionIterations; ++i)
 	{
-		bool contactsOkay = contactSolver.SolvePositionConstraints();
-
+		++profile->positionIterations;
+		bool contactsOkay = true;
 		bool jointsOkay = true;
-		for (int i = 0; i < m_jointCount; ++i)
+		if (m_threadPool)
 		{
-			bool jointOkay = m_joints[i]->SolvePositionConstraints(solverData);
-			jointsOkay = jointsOkay && jointOkay;
+			SolvePositionColors(&contactSolver, solverData, &contactsOkay, &jointsOkay);
+		}
+		else
+		{
+			contactsOkay = contactSolver.SolvePositionConstraints();
+			jointsOkay = SolveJoints(solverData, e_solvePositionPass);
 		}
 
 		if (contactsOkay && jointsOkay)
@@ -326,8 +439,29 @@ void cb2Island::Solve(cb2Profile* profile, const cb2TimeStep& step, const ci::Ve
 		}
 	}
 
+	if (m_threadPool)
+	{
+		FreeColors();
+	}
+
 	// Copy state buffers back to the bodies
-	for (int i = 0; i < m_bodyCount; ++i)
+	StoreState();
+
+	profile->solvePosition = timer.GetMilliseconds();
+
+	int constraintCount = m_contactCount;
+	m_contactCount = contactCount;
+	Report(contactSolver.m_velocityConstraints, constraintCount, step.postSolveThreshold);
+
+	if (allowSleep)
+	{
+		UpdateSleep(step, positionSolved);
+	}
+}
+
+void cb2Island::StoreState()
+{
+	for (int i = m_staticCount; i < m_bodyCount; ++i)
 	{
 		cb2Body* body = m_bodies[i];
 		body->m_sweep.c = m_positions[i].c;
@@ -336,112 +470,482 @@ void cb2Island::Solve(cb2Profile* profile, const cb2TimeStep& step, const ci::Ve
 		body->m_angularVelocity = m_velocities[i].w;
 		body->SynchronizeTransform();
 	}
+}
 
-	profile->solvePosition = timer.GetMilliseconds();
+void cb2Island::UpdateSleep(const cb2TimeStep& step, bool positionSolved)
+{
+	float h = step.dt;
+	float minSleepTime = cb2_maxFloat;
+	m_maxSleepTime = 0.0f;
 
-	Report(contactSolver.m_velocityConstraints);
+	const float linTolSqr = cb2_linearSleepTolerance * cb2_linearSleepTolerance;
+	const float angTolSqr = cb2_angularSleepTolerance * cb2_angularSleepTolerance;
 
-	if (allowSleep)
+	// Track the largest speeds relative to the tolerances for early sleep.
+	float maxLinSqr = 0.0f;
+	float maxAngSqr = 0.0f;
+
+	for (int i = 0; i < m_bodyCount; ++i)
 	{
-		float minSleepTime = cb2_maxFloat;
+		cb2Body* b = m_bodies[i];
+		if (b->GetType() == cb2_staticBody)
+		{
+			continue;
+		}
+
+		if ((b->m_flags & cb2Body::e_autoSleepFlag) == 0 ||
+			b->m_angularVelocity * b->m_angularVelocity > angTolSqr ||
+			cb2Dot(b->m_linearVelocity, b->m_linearVelocity) > linTolSqr)
+		{
+			b->m_sleepTime = 0.0f;
+			minSleepTime = 0.0f;
+		}
+		else
+		{
+			b->m_sleepTime += h;
+			minSleepTime = cb2Min(minSleepTime, b->m_sleepTime);
+			m_maxSleepTime = cb2Max(m_maxSleepTime, b->m_sleepTime);
+			maxLinSqr = cb2Max(maxLinSqr, cb2Dot(b->m_linearVelocity, b->m_linearVelocity));
+			maxAngSqr = cb2Max(maxAngSqr, b->m_angularVelocity * b->m_angularVelocity);
+		}
+	}
 
-		const float linTolSqr = cb2_linearSleepTolerance * cb2_linearSleepTolerance;
-		const float angTolSqr = cb2_angularSleepTolerance * cb2_angularSleepTolerance;
+	float timeToSleep = cb2_timeToSleep;
+	const float stillSqr = cb2_earlySleepFraction * cb2_earlySleepFraction;
+	if (step.earlySleep && maxLinSqr <= stillSqr * linTolSqr && maxAngSqr <= stillSqr * angTolSqr)
+	{
+		timeToSleep = cb2_earlySleepFraction * cb2_timeToSleep;
+	}
 
-		for (int i = 0; i < m_bodyCount; ++i)
+	// An island waiting to be split may hold several groups of bodies. Each
+	// group must be able to wake up on its own, so none of them sleeps yet.
+	if (minSleepTime >= timeToSleep && positionSolved && m_splitPending == false)
+	{
+		for (int i = m_staticCount; i < m_bodyCount; ++i)
 		{
 			cb2Body* b = m_bodies[i];
-			if (b->GetType() == cb2_staticBody)
-			{
-				continue;
-			}
+			b->SetAwake(false);
+		}
+	}
+}
 
-			if ((b->m_flags & cb2Body::e_autoSleepFlag) == 0 ||
-				b->m_angularVelocity * b->m_angularVelocity > angTolSqr ||
-				cb2Dot(b->m_linearVelocity, b->m_linearVelocity) > linTolSqr)
-			{
-				b->m_sleepTime = 0.0f;
-				minSleepTime = 0.0f;
-			}
-			else
-			{
-				b->m_sleepTime += h;
-				minSleepTime = cb2Min(minSleepTime, b->m_sleepTime);
-			}
+void cb2Island::IntegrateVelocities(float h, const ci::Vec2f& gravity, float* restTime)
+{
+	int n = m_bodyCount;
+	float* data = (float*)m_allocator->Allocate(8 * n * sizeof(float));
+	float* vx = data;
+	float* vy = data + n;
+	float* w = data + 2 * n;
+	float* ax = data + 3 * n;
+	float* ay = data + 4 * n;
+	float* aw = data + 5 * n;
+	float* linearDamping = data + 6 * n;
+	float* angularDamping = data + 7 * n;
+
+	// Gather. Bodies that are not dynamic get no acceleration and no damping,
+	// which leaves their velocity as it is.
+	for (int i = 0; i < n; ++i)
+	{
+		cb2Body* b = m_bodies[i];
+
+		if (b->m_type != cb2_staticBody)
+		{
+			*restTime = cb2Min(*restTime, (b->m_flags & cb2Body::e_autoSleepFlag) ? b->m_sleepTime : 0.0f);
 		}
 
-		if (minSleepTime >= cb2_timeToSleep && positionSolved)
+		// Store positions for continuous collision. Shared static bodies never move.
+		if (i >= m_staticCount)
 		{
-			for (int i = 0; i < m_bodyCount; ++i)
-			{
-				cb2Body* b = m_bodies[i];
-				b->SetAwake(false);
-			}
+			b->m_sweep.c0 = b->m_sweep.c;
+			b->m_sweep.a0 = b->m_sweep.a;
+		}
+
+		m_positions[i].c = b->m_sweep.c;
+		m_positions[i].a = b->m_sweep.a;
+
+		vx[i] = b->m_linearVelocity.x;
+		vy[i] = b->m_linearVelocity.y;
+		w[i] = b->m_angularVelocity;
+
+		if (b->m_type == cb2_dynamicBody)
+		{
+			ax[i] = b->m_gravityScale * gravity.x + b->m_invMass * b->m_force.x;
+			ay[i] = b->m_gravityScale * gravity.y + b->m_invMass * b->m_force.y;
+			aw[i] = b->m_invI * b->m_torque;
+			linearDamping[i] = b->m_linearDamping;
+			angularDamping[i] = b->m_angularDamping;
+		}
+		else
+		{
+			ax[i] = 0.0f;
+			ay[i] = 0.0f;
+			aw[i] = 0.0f;
+			linearDamping[i] = 0.0f;
+			angularDamping[i] = 0.0f;
 		}
 	}
+
+	// Integrate velocities and apply damping, as in Solve.
+	cb2FloatW hW = cb2SplatW(h);
+	cb2FloatW one = cb2SplatW(1.0f);
+	int i = 0;
+	for (; i + cb2_simdWidth <= n; i += cb2_simdWidth)
+	{
+		cb2FloatW linearScale = cb2DivW(one, cb2AddW(one, cb2MulW(hW, cb2LoadW(linearDamping + i))));
+		cb2FloatW angularScale = cb2DivW(one, cb2AddW(one, cb2MulW(hW, cb2LoadW(angularDamping + i))));
+		cb2StoreW(vx + i, cb2MulW(cb2AddW(cb2LoadW(vx + i), cb2MulW(hW, cb2LoadW(ax + i))), linearScale));
+		cb2StoreW(vy + i, cb2MulW(cb2AddW(cb2LoadW(vy + i), cb2MulW(hW, cb2LoadW(ay + i))), linearScale));
+		cb2StoreW(w + i, cb2MulW(cb2AddW(cb2LoadW(w + i), cb2MulW(hW, cb2LoadW(aw + i))), angularScale));
+	}
+
+	for (; i < n; ++i)
+	{
+		float linearScale = 1.0f / (1.0f + h * linearDamping[i]);
+		float angularScale = 1.0f / (1.0f + h * angularDamping[i]);
+		vx[i] = (vx[i] + h * ax[i]) * linearScale;
+		vy[i] = (vy[i] + h * ay[i]) * linearScale;
+		w[i] = (w[i] + h * aw[i]) * angularScale;
+	}
+
+	for (i = 0; i < n; ++i)
+	{
+		m_velocities[i].v.x = vx[i];
+		m_velocities[i].v.y = vy[i];
+		m_velocities[i].w = w[i];
+	}
+
+	m_allocator->Free(data);
 }
 
-void cb2Island::SolveTOI(const cb2TimeStep& subStep, int toiIndexA, int toiIndexB)
+int cb2Island::IntegratePositionsWide(float h)
 {
-	cb2Assert(toiIndexA < m_bodyCount);
-	cb2Assert(toiIndexB < m_bodyCount);
+	cb2FloatW hW = cb2SplatW(h);
+	cb2FloatW one = cb2SplatW(1.0f);
+	cb2FloatW maxTranslation = cb2SplatW(cb2_maxTranslation);
+	cb2FloatW maxTranslationSquared = cb2SplatW(cb2_maxTranslationSquared);
+	cb2FloatW maxRotation = cb2SplatW(cb2_maxRotation);
+	cb2FloatW maxRotationSquared = cb2SplatW(cb2_maxRotationSquared);
+
+	int i = 0;
+	for (; i + cb2_simdWidth <= m_bodyCount; i += cb2_simdWidth)
+	{
+		float cx[cb2_simdWidth], cy[cb2_simdWidth], a[cb2_simdWidth];
+		float vx[cb2_simdWidth], vy[cb2_simdWidth], w[cb2_simdWidth];
+		for (int j = 0; j < cb2_simdWidth; ++j)
+		{
+			cx[j] = m_positions[i + j].c.x;
+			cy[j] = m_positions[i + j].c.y;
+			a[j] = m_positions[i + j].a;
+			vx[j] = m_velocities[i + j].v.x;
+			vy[j] = m_velocities[i + j].v.y;
+			w[j] = m_velocities[i + j].w;
+		}
+
+		cb2FloatW vxW = cb2LoadW(vx);
+		cb2FloatW vyW = cb2LoadW(vy);
+		cb2FloatW wW = cb2LoadW(w);
+
+		// Check for large velocities. Lanes within the limits are scaled by one.
+		cb2FloatW tx = cb2MulW(hW, vxW);
+		cb2FloatW ty = cb2MulW(hW, vyW);
+		cb2FloatW translationSquared = cb2AddW(cb2MulW(tx, tx), cb2MulW(ty, ty));
+		cb2FloatW linearRatio = cb2DivW(maxTranslation, cb2SqrtW(translationSquared));
+		linearRatio = cb2SelectGreaterW(translationSquared, maxTranslationSquared, linearRatio, one);
+		vxW = cb2MulW(vxW, linearRatio);
+		vyW = cb2MulW(vyW, linearRatio);
+
+		cb2FloatW rotation = cb2MulW(hW, wW);
+		cb2FloatW angularRatio = cb2DivW(maxRotation, cb2AbsW(rotation));
+		angularRatio = cb2SelectGreaterW(cb2MulW(rotation, rotation), maxRotationSquared, angularRatio, one);
+		wW = cb2MulW(wW, angularRatio);
+
+		// Integrate
+		cb2StoreW(cx, cb2AddW(cb2LoadW(cx), cb2MulW(hW, vxW)));
+		cb2StoreW(cy, cb2AddW(cb2LoadW(cy), cb2MulW(hW, vyW)));
+		cb2StoreW(a, cb2AddW(cb2LoadW(a), cb2MulW(hW, wW)));
+		cb2StoreW(vx, vxW);
+		cb2StoreW(vy, vyW);
+		cb2StoreW(w, wW);
+
+		for (int j = 0; j < cb2_simdWidth; ++j)
+		{
+			m_positions[i + j].c.x = cx[j];
+			m_positions[i + j].c.y = cy[j];
+			m_positions[i + j].a = a[j];
+			m_velocities[i + j].v.x = vx[j];
+			m_velocities[i + j].v.y = vy[j];
+			m_velocities[i + j].w = w[j];
+		}
+	}
+
+	return i;
+}
+
+// Substeps with soft contacts. Each substep integrates velocities, solves with the
+// contact bias, integrates positions and relaxes the velocities without the bias.
+// The constraint anchors and normals are computed once for the step.
+void cb2Island::SolveSoftStep(cb2Profile* profile, const cb2TimeStep& step, const ci::Vec2f& gravity, bool allowSleep)
+{
+	cb2Timer timer;
+
+	int subStepCount = step.subStepCount;
+	float h = step.dt / subStepCount;
 
 	// Initialize the body state.
 	for (int i = 0; i < m_bodyCount; ++i)
 	{
 		cb2Body* b = m_bodies[i];
+
+		// Store positions for continuous collision. Shared static bodies never move.
+		if (i >= m_staticCount)
+		{
+			b->m_sweep.c0 = b->m_sweep.c;
+			b->m_sweep.a0 = b->m_sweep.a;
+		}
+
 		m_positions[i].c = b->m_sweep.c;
 		m_positions[i].a = b->m_sweep.a;
 		m_velocities[i].v = b->m_linearVelocity;
 		m_velocities[i].w = b->m_angularVelocity;
 	}
 
+	cb2TimeStep subStep = step;
+	subStep.dt = h;
+	subStep.inv_dt = subStepCount * step.inv_dt;
+	subStep.wideContactSolver = false;
+
+	cb2SolverData solverData;
+	solverData.step = subStep;
+	solverData.positions = m_positions;
+	solverData.velocities = m_velocities;
+	solverData.staticBodies = m_bodies;
+	solverData.staticCount = m_staticCount;
+
+	// Leave the reduced contacts out while solving.
+	int contactCount = m_contactCount;
+	if (step.contactReduction)
+	{
+		m_contactCount = ReduceContacts();
+	}
+
 	cb2ContactSolverDef contactSolverDef;
+	contactSolverDef.step = subStep;
 	contactSolverDef.contacts = m_contacts;
 	contactSolverDef.count = m_contactCount;
-	contactSolverDef.allocator = m_allocator;
-	contactSolverDef.step = subStep;
 	contactSolverDef.positions = m_positions;
 	contactSolverDef.velocities = m_velocities;
+	contactSolverDef.staticBodies = m_bodies;
+	contactSolverDef.staticCount = m_staticCount;
+	contactSolverDef.allocator = m_allocator;
+
 	cb2ContactSolver contactSolver(&contactSolverDef);
+	contactSolver.InitializeVelocityConstraints();
+	contactSolver.PrepareSoftConstraints();
 
-	// Solve position constraints.
-	for (int i = 0; i < subStep.positionIterations; ++i)
+	profile->solveInit = timer.GetMilliseconds();
+
+	timer.Reset();
+	for (int n = 0; n < subStepCount; ++n)
 	{
-		bool contactsOkay = contactSolver.SolveTOIPositionConstraints(toiIndexA, toiIndexB);
-		if (contactsOkay)
+		// Integrate velocities and apply damping.
+		for (int i = m_staticCount; i < m_bodyCount; ++i)
 		{
-			break;
+			cb2Body* b = m_bodies[i];
+			if (b->m_type != cb2_dynamicBody)
+			{
+				continue;
+			}
+
+			ci::Vec2f v = m_velocities[i].v;
+			float w = m_velocities[i].w;
+			v += h * (b->m_gravityScale * gravity + b->m_invMass * b->m_force);
+			w += h * b->m_invI * b->m_torque;
+			v *= 1.0f / (1.0f + h * b->m_linearDamping);
+			w *= 1.0f / (1.0f + h * b->m_angularDamping);
+			m_velocities[i].v = v;
+			m_velocities[i].w = w;
 		}
-	}
 
-#if 0
-	// Is the new position really safe?
-	for (int i = 0; i < m_contactCount; ++i)
-	{
-		cb2Contact* c = m_contacts[i];
-		cb2Fixture* fA = c->GetFixtureA();
-		cb2Fixture* fB = c->GetFixtureB();
+		// The impulses of the previous substep are a good guess for this one.
+		if (step.warmStarting || n > 0)
+		{
+			contactSolver.WarmStart();
+		}
 
-		cb2Body* bA = fA->GetBody();
-		cb2Body* bB = fB->GetBody();
+		// Only the first substep follows a change of the world time step.
+		solverData.step.dtRatio = n == 0 ? step.dtRatio : 1.0f;
+		solverData.step.warmStarting = step.warmStarting || n > 0;
+		SolveJoints(solverData, e_initVelocityPass);
+		int targetDrives = m_targetDrives ? m_targetDrives->InitVelocityConstraints(m_bodies, m_staticCount, m_bodyCount, solverData) : -1;
 
-		int indexA = c->GetChildIndexA();
-		int indexB = c->GetChildIndexB();
+		SolveJoints(solverData, e_solveVelocityPass);
+		if (targetDrives != -1)
+		{
+			m_targetDrives->SolveVelocityConstraints(targetDrives, solverData);
+		}
+		contactSolver.SolveSoftVelocityConstraints(true);
 
-		cb2DistanceInput input;
-		input.proxyA.set(fA->GetShape(), indexA);
-		input.proxyB.set(fB->GetShape(), indexB);
-		input.transformA = bA->GetTransform();
-		input.transformB = bB->GetTransform();
-		input.useRadii = false;
+		IntegratePositions(h, step.batchIntegration);
 
-		cb2DistanceOutput output;
-		cb2SimplexCache cache;
-		cache.count = 0;
-		cb2Distance(&output, &cache, &input);
+		// The joints have no soft bias, they keep one position pass per substep.
+		SolveJoints(solverData, e_solvePositionPass);
 
-		if (output.distance == 0 || cache.count == 3)
+		// Relax: remove the velocity added by the contact bias.
+		SolveJoints(solverData, e_solveVelocityPass);
+		if (targetDrives != -1)
+		{
+			m_targetDrives->SolveVelocityConstraints(targetDrives, solverData);
+		}
+		contactSolver.SolveSoftVelocityConstraints(false);
+	}
+
+	contactSolver.ApplySoftRestitution();
+
+	// The joint impulses are those of the last substep.
+	profile->jointsBroken = CheckBrokenJoints(subStepCount * step.inv_dt);
+
+	// Store impulses for warm starting
+	contactSolver.StoreImpulses();
+	profile->solveVelocity = timer.GetMilliseconds();
+	profile->solvePosition = 0.0f;
+	profile->velocityIterations = subStepCount;
+	profile->positionIterations = 0;
+	profile->maxVelocityIterations = subStepCount;
+
+	// Copy state buffers back to the bodies
+	StoreState();
+
+	int constraintCount = m_contactCount;
+	m_contactCount = contactCount;
+	Report(contactSolver.m_velocityConstraints, constraintCount, step.postSolveThreshold);
+
+	if (allowSleep)
+	{
+		UpdateSleep(step, true);
+	}
+}
+
+void cb2Island::IntegratePositions(float h, bool batch)
+{
+	// The batch kernel leaves the last few bodies to this loop.
+	int first = batch ? IntegratePositionsWide(h) : 0;
+	for (int i = first; i < m_bodyCount; ++i)
+	{
+		ci::Vec2f c = m_positions[i].c;
+		float a = m_positions[i].a;
+		ci::Vec2f v = m_velocities[i].v;
+		float w = m_velocities[i].w;
+
+		// Check for large velocities
+		ci::Vec2f translation = h * v;
+		if (cb2Dot(translation, translation) > cb2_maxTranslationSquared)
+		{
+			float ratio = cb2_maxTranslation / translation.length();
+			v *= ratio;
+		}
+
+		float rotation = h * w;
+		if (rotation * rotation > cb2_maxRotationSquared)
+		{
+			float ratio = cb2_maxRotation / cb2Abs(rotation);
+			w *= ratio;
+		}
+
+		// Integrate
+		c += h * v;
+		a += h * w;
+
+		m_positions[i].c = c;
+		m_positions[i].a = a;
+		m_velocities[i].v = v;
+		m_velocities[i].w = w;
+	}
+}
+
+float cb2Island::Defer(float dt, float maxDebt)
+{
+	float debt = 0.0f;
+	for (int i = 0; i < m_bodyCount; ++i)
+	{
+		cb2Body* b = m_bodies[i];
+		if (b->m_type == cb2_staticBody)
+		{
+			continue;
+		}
+
+		// Moving the bodies without their constraints would let a pile sink into itself.
+		b->m_sweep.c0 = b->m_sweep.c;
+		b->m_sweep.a0 = b->m_sweep.a;
+		b->m_flags |= cb2Body::e_lodFlag;
+		b->m_solveDebt = cb2Min(b->m_solveDebt + dt, maxDebt);
+		debt = cb2Max(debt, b->m_solveDebt);
+	}
+	return 1000.0f * debt;
+}
+
+void cb2Island::SolveTOI(const cb2TimeStep& subStep, int toiIndexA, int toiIndexB)
+{
+	cb2Assert(toiIndexA < m_bodyCount);
+	cb2Assert(toiIndexB < m_bodyCount);
+
+	// Initialize the body state.
+	for (int i = 0; i < m_bodyCount; ++i)
+	{
+		cb2Body* b = m_bodies[i];
+		m_positions[i].c = b->m_sweep.c;
+		m_positions[i].a = b->m_sweep.a;
+		m_velocities[i].v = b->m_linearVelocity;
+		m_velocities[i].w = b->m_angularVelocity;
+	}
+
+	cb2ContactSolverDef contactSolverDef;
+	contactSolverDef.contacts = m_contacts;
+	contactSolverDef.count = m_contactCount;
+	contactSolverDef.allocator = m_allocator;
+	contactSolverDef.step = subStep;
+	contactSolverDef.positions = m_positions;
+	contactSolverDef.velocities = m_velocities;
+	contactSolverDef.staticBodies = NULL;
+	contactSolverDef.staticCount = 0;
+	cb2ContactSolver contactSolver(&contactSolverDef);
+
+	// Solve position constraints.
+	for (int i = 0; i < subStep.positionIterations; ++i)
+	{
+		bool contactsOkay = contactSolver.SolveTOIPositionConstraints(toiIndexA, toiIndexB);
+		if (contactsOkay)
+		{
+			break;
+		}
+	}
+
+#if 0
+	// Is the new position really safe?
+	for (int i = 0; i < m_contactCount; ++i)
+	{
+		cb2Contact* c = m_contacts[i];
+		cb2Fixture* fA = c->GetFixtureA();
+		cb2Fixture* fB = c->GetFixtureB();
+
+		cb2Body* bA = fA->GetBody();
+		cb2Body* bB = fB->GetBody();
+
+		int indexA = c->GetChildIndexA();
+		int indexB = c->GetChildIndexB();
+
+		cb2DistanceInput input;
+		input.proxyA.set(fA->GetShape(), indexA);
+		input.proxyB.set(fB->GetShape(), indexB);
+		input.transformA = bA->GetTransform();
+		input.transformB = bB->GetTransform();
+		input.useRadii = false;
+
+		cb2DistanceOutput output;
+		cb2SimplexCache cache;
+		cache.count = 0;
+		cb2Distance(&output, &cache, &input);
+
+		if (output.distance == 0 || cache.count == 3)
 		{
 			cache.count += 0;
 		}
@@ -510,10 +1014,34 @@ void cb2Island::SolveTOI(const cb2TimeStep& subStep, int toiIndexA, int toiIndex
 		body->SynchronizeTransform();
 	}
 
-	Report(contactSolver.m_velocityConstraints);
+	Report(contactSolver.m_velocityConstraints, m_contactCount, subStep.postSolveThreshold);
 }
 
-void cb2Island::Report(const cb2ContactVelocityConstraint* constraints)
+int cb2Island::CheckBrokenJoints(float inv_dt)
+{
+	int brokenCount = 0;
+	for (int i = 0; i < m_jointCount; ++i)
+	{
+		cb2Joint* joint = m_joints[i];
+		if (joint->m_breakForce == cb2_maxFloat && joint->m_breakTorque == cb2_maxFloat)
+		{
+			continue;
+		}
+
+		float force = joint->m_breakForce;
+		float torque = joint->m_breakTorque;
+		if (joint->GetReactionForce(inv_dt).lengthSquared() > force * force ||
+			cb2Abs(joint->GetReactionTorque(inv_dt)) > torque)
+		{
+			joint->m_breakInvDt = inv_dt;
+			++brokenCount;
+		}
+	}
+
+	return brokenCount;
+}
+
+void cb2Island::Report(const cb2ContactVelocityConstraint* constraints, int constraintCount, float threshold)
 {
 	if (m_listener == NULL)
 	{
@@ -524,16 +1052,768 @@ void cb2Island::Report(const cb2ContactVelocityConstraint* constraints)
 	{
 		cb2Contact* c = m_contacts[i];
 
-		const cb2ContactVelocityConstraint* vc = constraints + i;
-		
 		cb2ContactImpulse impulse;
-		impulse.count = vc->pointCount;
-		for (int j = 0; j < vc->pointCount; ++j)
+		impulse.count = 0;
+		bool report = (c->m_flags & cb2Contact::e_postSolveFlag) != 0;
+		if (report && i < constraintCount)
+		{
+			const cb2ContactVelocityConstraint* vc = constraints + i;
+			float maxImpulse = 0.0f;
+			for (int j = 0; j < vc->pointCount; ++j)
+			{
+				impulse.normalImpulses[j] = vc->points[j].normalImpulse;
+				impulse.tangentImpulses[j] = vc->points[j].tangentImpulse;
+				maxImpulse = cb2Max(maxImpulse, vc->points[j].normalImpulse);
+			}
+			impulse.count = vc->pointCount;
+			report = maxImpulse >= threshold;
+		}
+		else if (report)
+		{
+			impulse.count = c->GetManifold()->pointCount;
+			for (int j = 0; j < impulse.count; ++j)
+			{
+				impulse.normalImpulses[j] = 0.0f;
+				impulse.tangentImpulses[j] = 0.0f;
+			}
+			report = threshold <= 0.0f;
+		}
+
+		if (report == false)
+		{
+			impulse.count = 0;
+			if (m_impulses)
+			{
+				m_impulses[i] = impulse;
+			}
+			continue;
+		}
+
+		if (m_impulses)
 		{
-			impulse.normalImpulses[j] = vc->points[j].normalImpulse;
-			impulse.tangentImpulses[j] = vc->points[j].tangentImpulse;
+			m_impulses[i] = impulse;
+			continue;
 		}
 
 		m_listener->PostSolve(c, &impulse);
 	}
 }
+
+// Body pairs with at least this many touching contacts are reduced.
+const int cb2_reductionMinContacts = 4;
+
+// Contacts in the same normal group have normals closer than this cosine.
+const float cb2_reductionNormalDot = 0.95f;
+
+// Contacts beyond this many normal groups of a pair are always kept.
+const int cb2_maxReductionGroups = 4;
+
+// The contacts kept for one normal direction of a body pair.
+struct cb2ReductionGroup
+{
+	ci::Vec2f normal;
+	cb2Contact* deepest;
+	cb2Contact* lowest;
+	cb2Contact* highest;
+	float separation;
+	float lowerT;
+	float upperT;
+};
+
+int cb2Island::ReduceContacts()
+{
+	for (int i = 0; i < m_contactCount; ++i)
+	{
+		m_contacts[i]->m_flags &= ~cb2Contact::e_reducedFlag;
+	}
+
+	// A pair is reduced from its dynamic or kinematic body with the lowest island index.
+	// All contacts of the pair are on this body and in this island.
+	int reducedCount = 0;
+	for (int i = m_staticCount; i < m_bodyCount; ++i)
+	{
+		// The serial solver also adds static bodies, their other contacts are in other islands.
+		cb2Body* b = m_bodies[i];
+		if (b->GetType() == cb2_staticBody)
+		{
+			continue;
+		}
+
+		for (cb2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+		{
+			cb2Body* other = ce->other;
+			if ((ce->contact->m_flags & cb2Contact::e_islandFlag) == 0 ||
+				(other->GetType() != cb2_staticBody && other->m_islandIndex < b->m_islandIndex))
+			{
+				continue;
+			}
+
+			// Start each pair at its first contact.
+			bool first = true;
+			for (cb2ContactEdge* pe = b->m_contactList; pe != ce; pe = pe->next)
+			{
+				if (pe->other == other && (pe->contact->m_flags & cb2Contact::e_islandFlag))
+				{
+					first = false;
+					break;
+				}
+			}
+
+			if (first == false)
+			{
+				continue;
+			}
+
+			int pairCount = 0;
+			for (cb2ContactEdge* pe = ce; pe; pe = pe->next)
+			{
+				if (pe->other == other && (pe->contact->m_flags & cb2Contact::e_islandFlag))
+				{
+					++pairCount;
+				}
+			}
+
+			if (pairCount < cb2_reductionMinContacts)
+			{
+				continue;
+			}
+
+			// Group the contacts by normal and find the deepest contact and the
+			// outermost contacts along the tangent of each group.
+			cb2ReductionGroup groups[cb2_maxReductionGroups];
+			int groupCount = 0;
+			for (cb2ContactEdge* pe = ce; pe; pe = pe->next)
+			{
+				cb2Contact* c = pe->contact;
+				if (pe->other != other || (c->m_flags & cb2Contact::e_islandFlag) == 0)
+				{
+					continue;
+				}
+
+				cb2WorldManifold worldManifold;
+				c->GetWorldManifold(&worldManifold);
+				int pointCount = c->GetManifold()->pointCount;
+
+				// Orient the normals from this body.
+				ci::Vec2f normal = c->GetFixtureA()->GetBody() == b ? worldManifold.normal : -worldManifold.normal;
+
+				int g = 0;
+				while (g < groupCount && cb2Dot(groups[g].normal, normal) < cb2_reductionNormalDot)
+				{
+					++g;
+				}
+
+				if (g == cb2_maxReductionGroups)
+				{
+					continue;
+				}
+
+				c->m_flags |= cb2Contact::e_reducedFlag;
+
+				cb2ReductionGroup* group = groups + g;
+				if (g == groupCount)
+				{
+					group->normal = normal;
+					group->deepest = NULL;
+					group->lowest = NULL;
+					group->highest = NULL;
+					group->separation = cb2_maxFloat;
+					group->lowerT = cb2_maxFloat;
+					group->upperT = -cb2_maxFloat;
+					++groupCount;
+				}
+
+				ci::Vec2f tangent = cb2Cross(group->normal, 1.0f);
+				for (int j = 0; j < pointCount; ++j)
+				{
+					float t = cb2Dot(tangent, worldManifold.points[j]);
+					if (worldManifold.separations[j] < group->separation)
+					{
+						group->separation = worldManifold.separations[j];
+						group->deepest = c;
+					}
+
+					if (t < group->lowerT)
+					{
+						group->lowerT = t;
+						group->lowest = c;
+					}
+
+					if (t > group->upperT)
+					{
+						group->upperT = t;
+						group->highest = c;
+					}
+				}
+			}
+
+			for (int g = 0; g < groupCount; ++g)
+			{
+				groups[g].deepest->m_flags &= ~cb2Contact::e_reducedFlag;
+				groups[g].lowest->m_flags &= ~cb2Contact::e_reducedFlag;
+				groups[g].highest->m_flags &= ~cb2Contact::e_reducedFlag;
+			}
+
+			// The left out contacts are not warm started when they come back.
+			for (cb2ContactEdge* pe = ce; pe; pe = pe->next)
+			{
+				cb2Contact* c = pe->contact;
+				if (pe->other != other || (c->m_flags & cb2Contact::e_islandFlag) == 0 ||
+					(c->m_flags & cb2Contact::e_reducedFlag) == 0)
+				{
+					continue;
+				}
+
+				cb2Manifold* manifold = c->GetManifold();
+				for (int j = 0; j < manifold->pointCount; ++j)
+				{
+					manifold->points[j].normalImpulse = 0.0f;
+					manifold->points[j].tangentImpulse = 0.0f;
+				}
+				++reducedCount;
+			}
+		}
+	}
+
+	if (reducedCount == 0)
+	{
+		return m_contactCount;
+	}
+
+	// Move the solved contacts to the front.
+	int count = 0;
+	for (int i = 0; i < m_contactCount; ++i)
+	{
+		cb2Contact* c = m_contacts[i];
+		if (c->m_flags & cb2Contact::e_reducedFlag)
+		{
+			continue;
+		}
+
+		m_contacts[i] = m_contacts[count];
+		m_contacts[count] = c;
+		++count;
+	}
+
+	cb2Assert(count == m_contactCount - reducedCount);
+	return count;
+}
+
+// Colors the constraint graph greedily. Joints write both of their bodies.
+// Contacts only read bodies without mass, so contacts on the same static or
+// kinematic body can share a color.
+void cb2Island::ColorConstraints(const cb2ContactSolver* contactSolver)
+{
+	const int colorCount = cb2_maxIslandColors + 1;
+	m_colors = (cb2IslandColor*)m_allocator->Allocate(colorCount * sizeof(cb2IslandColor));
+	m_colorJoints = (int*)m_allocator->Allocate(m_jointCount * sizeof(int));
+	m_colorContacts = (int*)m_allocator->Allocate(m_contactCount * sizeof(int));
+
+	int threadCount = m_threadPool->GetThreadCount();
+	m_threadSeparations = (float*)m_allocator->Allocate(threadCount * sizeof(float));
+	m_threadJointsOkay = (bool*)m_allocator->Allocate(threadCount * sizeof(bool));
+	m_threadImpulses = (float*)m_allocator->Allocate(threadCount * sizeof(float));
+
+	unsigned int* writeColors = (unsigned int*)m_allocator->Allocate(m_bodyCount * sizeof(unsigned int));
+	unsigned int* readColors = (unsigned int*)m_allocator->Allocate(m_bodyCount * sizeof(unsigned int));
+	int* jointColors = (int*)m_allocator->Allocate(m_jointCount * sizeof(int));
+	int* contactColors = (int*)m_allocator->Allocate(m_contactCount * sizeof(int));
+	memset(writeColors, 0, m_bodyCount * sizeof(unsigned int));
+	memset(readColors, 0, m_bodyCount * sizeof(unsigned int));
+	memset(m_colors, 0, colorCount * sizeof(cb2IslandColor));
+
+	for (int i = 0; i < m_jointCount; ++i)
+	{
+		cb2Joint* joint = m_joints[i];
+
+		// Gear joints touch four bodies.
+		if (joint->m_type == e_gearJoint)
+		{
+			jointColors[i] = cb2_maxIslandColors;
+			m_colors[cb2_maxIslandColors].jointCount += 1;
+			continue;
+		}
+
+		int indexA = joint->m_bodyA->GetIslandIndex(m_bodies, m_staticCount);
+		int indexB = joint->m_bodyB->GetIslandIndex(m_bodies, m_staticCount);
+		unsigned int used = writeColors[indexA] | readColors[indexA] | writeColors[indexB] | readColors[indexB];
+
+		int color = 0;
+		while (color < cb2_maxIslandColors && (used & (1u << color)))
+		{
+			++color;
+		}
+
+		if (color < cb2_maxIslandColors)
+		{
+			writeColors[indexA] |= 1u << color;
+			writeColors[indexB] |= 1u << color;
+		}
+
+		jointColors[i] = color;
+		m_colors[color].jointCount += 1;
+	}
+
+	for (int i = 0; i < m_contactCount; ++i)
+	{
+		const cb2ContactVelocityConstraint* vc = contactSolver->m_velocityConstraints + i;
+		bool readA = vc->invMassA == 0.0f && vc->invIA == 0.0f;
+		bool readB = vc->invMassB == 0.0f && vc->invIB == 0.0f;
+		int indexA = vc->indexA;
+		int indexB = vc->indexB;
+
+		unsigned int used = writeColors[indexA] | writeColors[indexB];
+		if (readA == false)
+		{
+			used |= readColors[indexA];
+		}
+		if (readB == false)
+		{
+			used |= readColors[indexB];
+		}
+
+		int color = 0;
+		while (color < cb2_maxIslandColors && (used & (1u << color)))
+		{
+			++color;
+		}
+
+		if (color < cb2_maxIslandColors)
+		{
+			if (readA)
+			{
+				readColors[indexA] |= 1u << color;
+			}
+			else
+			{
+				writeColors[indexA] |= 1u << color;
+			}
+
+			if (readB)
+			{
+				readColors[indexB] |= 1u << color;
+			}
+			else
+			{
+				writeColors[indexB] |= 1u << color;
+			}
+		}
+
+		contactColors[i] = color;
+		m_colors[color].contactCount += 1;
+	}
+
+	int jointIndex = 0;
+	int contactIndex = 0;
+	for (int i = 0; i < colorCount; ++i)
+	{
+		cb2IslandColor* color = m_colors + i;
+		color->jointIndex = jointIndex;
+		color->contactIndex = contactIndex;
+		jointIndex += color->jointCount;
+		contactIndex += color->contactCount;
+		color->jointCount = 0;
+		color->contactCount = 0;
+	}
+
+	// Keep the island order within each color.
+	for (int i = 0; i < m_jointCount; ++i)
+	{
+		cb2IslandColor* color = m_colors + jointColors[i];
+		m_colorJoints[color->jointIndex + color->jointCount++] = i;
+	}
+
+	for (int i = 0; i < m_contactCount; ++i)
+	{
+		cb2IslandColor* color = m_colors + contactColors[i];
+		m_colorContacts[color->contactIndex + color->contactCount++] = i;
+	}
+
+	m_allocator->Free(contactColors);
+	m_allocator->Free(jointColors);
+	m_allocator->Free(readColors);
+	m_allocator->Free(writeColors);
+}
+
+void cb2Island::FreeColors()
+{
+	m_allocator->Free(m_threadImpulses);
+	m_allocator->Free(m_threadJointsOkay);
+	m_allocator->Free(m_threadSeparations);
+	m_allocator->Free(m_colorContacts);
+	m_allocator->Free(m_colorJoints);
+	m_allocator->Free(m_colors);
+	m_colors = NULL;
+}
+
+float cb2Island::SolveColorVelocities(const cb2IslandColor* color, int begin, int end,
+									cb2ContactSolver* contactSolver, const cb2SolverData& data, bool trackJoints)
+{
+	float maxImpulse = 0.0f;
+	for (int i = begin; i < end; ++i)
+	{
+		if (i < color->jointCount)
+		{
+			cb2Joint* joint = m_joints[m_colorJoints[color->jointIndex + i]];
+			if (trackJoints)
+			{
+				maxImpulse = cb2Max(maxImpulse, SolveJointVelocity(joint, data));
+			}
+			else
+			{
+				joint->SolveVelocityConstraints(data);
+			}
+		}
+		else
+		{
+			int index = m_colorContacts[color->contactIndex + i - color->jointCount];
+			maxImpulse = cb2Max(maxImpulse, contactSolver->SolveVelocityConstraint(contactSolver->m_velocityConstraints + index));
+		}
+	}
+	return maxImpulse;
+}
+
+// A body and its Morton code.
+struct cb2IslandBodyKey
+{
+	unsigned int key;
+	int index;
+};
+
+inline bool cb2IslandBodyKeyLessThan(const cb2IslandBodyKey& a, const cb2IslandBodyKey& b)
+{
+	return a.key < b.key || (a.key == b.key && a.index < b.index);
+}
+
+// The first moving body of a constraint in the island order, -1 for none.
+int cb2Island::GetFirstIndex(const cb2Body* bodyA, const cb2Body* bodyB)
+{
+	int indexA = bodyA->GetType() == cb2_staticBody ? -1 : bodyA->m_islandIndex;
+	int indexB = bodyB->GetType() == cb2_staticBody ? -1 : bodyB->m_islandIndex;
+	if (indexA == -1 || (indexB != -1 && indexB < indexA))
+	{
+		return indexB;
+	}
+	return indexA;
+}
+
+void cb2Island::SortSpatially()
+{
+	// Small islands fit in the cache in any order.
+	int count = m_bodyCount - m_staticCount;
+	if (count < 32)
+	{
+		return;
+	}
+
+	cb2Body** bodies = m_bodies + m_staticCount;
+	cb2AABB bounds;
+	bounds.lowerBound = bodies[0]->m_sweep.c;
+	bounds.upperBound = bodies[0]->m_sweep.c;
+	for (int i = 1; i < count; ++i)
+	{
+		bounds.lowerBound = cb2Min(bounds.lowerBound, bodies[i]->m_sweep.c);
+		bounds.upperBound = cb2Max(bounds.upperBound, bodies[i]->m_sweep.c);
+	}
+
+	ci::Vec2f extent = bounds.upperBound - bounds.lowerBound;
+	float scaleX = extent.x > 0.0f ? 65535.0f / extent.x : 0.0f;
+	float scaleY = extent.y > 0.0f ? 65535.0f / extent.y : 0.0f;
+
+	cb2IslandBodyKey* keys = (cb2IslandBodyKey*)m_allocator->Allocate(count * sizeof(cb2IslandBodyKey));
+	for (int i = 0; i < count; ++i)
+	{
+		ci::Vec2f p = bodies[i]->m_sweep.c - bounds.lowerBound;
+		unsigned int x = (unsigned int)(scaleX * p.x);
+		unsigned int y = (unsigned int)(scaleY * p.y);
+		keys[i].key = cb2SpreadBits(x) | (cb2SpreadBits(y) << 1);
+		keys[i].index = i;
+	}
+	std::sort(keys, keys + count, cb2IslandBodyKeyLessThan);
+
+	cb2Body** sorted = (cb2Body**)m_allocator->Allocate(count * sizeof(cb2Body*));
+	for (int i = 0; i < count; ++i)
+	{
+		sorted[i] = bodies[keys[i].index];
+		sorted[i]->m_islandIndex = m_staticCount + i;
+	}
+	memcpy(bodies, sorted, count * sizeof(cb2Body*));
+	m_allocator->Free(sorted);
+	m_allocator->Free(keys);
+
+	// Counting sort of the contacts and joints by their first body, keeping the island
+	// order for each body.
+	int itemCapacity = cb2Max(m_contactCount, m_jointCount);
+	void** items = (void**)m_allocator->Allocate(cb2Max(itemCapacity, 1) * sizeof(void*));
+	int* starts = (int*)m_allocator->Allocate((m_bodyCount + 1) * sizeof(int));
+	int* firstIndices = (int*)m_allocator->Allocate(cb2Max(itemCapacity, 1) * sizeof(int));
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		int itemCount = pass == 0 ? m_contactCount : m_jointCount;
+		void** source = pass == 0 ? (void**)m_contacts : (void**)m_joints;
+		if (itemCount < 2)
+		{
+			continue;
+		}
+
+		memset(starts, 0, (m_bodyCount + 1) * sizeof(int));
+		for (int i = 0; i < itemCount; ++i)
+		{
+			int index = pass == 0 ?
+				GetFirstIndex(m_contacts[i]->m_nodeA.other, m_contacts[i]->m_nodeB.other) :
+				GetFirstIndex(m_joints[i]->m_bodyA, m_joints[i]->m_bodyB);
+			firstIndices[i] = index + 1;
+			++starts[index + 1];
+		}
+
+		int start = 0;
+		for (int i = 0; i <= m_bodyCount; ++i)
+		{
+			int n = starts[i];
+			starts[i] = start;
+			start += n;
+		}
+
+		for (int i = 0; i < itemCount; ++i)
+		{
+			items[starts[firstIndices[i]]++] = source[i];
+		}
+		memcpy(source, items, itemCount * sizeof(void*));
+	}
+	m_allocator->Free(firstIndices);
+	m_allocator->Free(starts);
+	m_allocator->Free(items);
+}
+
+// Counting sort of the joints by type, keeping the island order within a type.
+void cb2Island::SortJoints()
+{
+	if (m_jointCount < 2)
+	{
+		return;
+	}
+
+	const int typeCount = e_motorJoint + 1;
+	int typeStarts[typeCount];
+	for (int i = 0; i < typeCount; ++i)
+	{
+		typeStarts[i] = 0;
+	}
+
+	for (int i = 0; i < m_jointCount; ++i)
+	{
+		++typeStarts[m_joints[i]->m_type];
+	}
+
+	int start = 0;
+	for (int i = 0; i < typeCount; ++i)
+	{
+		int count = typeStarts[i];
+		typeStarts[i] = start;
+		start += count;
+	}
+
+	cb2Joint** joints = (cb2Joint**)m_allocator->Allocate(m_jointCount * sizeof(cb2Joint*));
+	for (int i = 0; i < m_jointCount; ++i)
+	{
+		joints[typeStarts[m_joints[i]->m_type]++] = m_joints[i];
+	}
+	memcpy(m_joints, joints, m_jointCount * sizeof(cb2Joint*));
+	m_allocator->Free(joints);
+}
+
+// Run a solver pass over the joints, in runs of one type when they are batched.
+// Returns true if the position errors of all the joints are within tolerance.
+bool cb2Island::SolveJoints(const cb2SolverData& data, cb2JointPass pass)
+{
+	bool okay = true;
+	if (data.step.jointBatching)
+	{
+		int begin = 0;
+		while (begin < m_jointCount)
+		{
+			int end = begin + 1;
+			while (end < m_jointCount && m_joints[end]->m_type == m_joints[begin]->m_type)
+			{
+				++end;
+			}
+
+			bool batchOkay = cb2Joint::SolveBatch(m_joints + begin, end - begin, data, pass);
+			okay = okay && batchOkay;
+			begin = end;
+		}
+		return okay;
+	}
+
+	for (int i = 0; i < m_jointCount; ++i)
+	{
+		cb2Joint* joint = m_joints[i];
+		switch (pass)
+		{
+		case e_initVelocityPass:
+			joint->InitVelocityConstraints(data);
+			break;
+
+		case e_solveVelocityPass:
+			joint->SolveVelocityConstraints(data);
+			break;
+
+		case e_solvePositionPass:
+			{
+				bool jointOkay = joint->SolvePositionConstraints(data);
+				okay = okay && jointOkay;
+			}
+			break;
+		}
+	}
+	return okay;
+}
+
+// The joints do not report their impulses, so the impulse of a pass is taken
+// from the momentum change of the joint bodies.
+float cb2Island::SolveJointVelocity(cb2Joint* joint, const cb2SolverData& data)
+{
+	// Only dynamic bodies have a mass, and the index of a shared static body may
+	// belong to another island.
+	cb2Body* bodies[2] = { joint->m_bodyA, joint->m_bodyB };
+	cb2Velocity oldVelocities[2];
+	for (int i = 0; i < 2; ++i)
+	{
+		if (bodies[i]->m_type == cb2_dynamicBody)
+		{
+			oldVelocities[i] = data.velocities[bodies[i]->m_islandIndex];
+		}
+	}
+
+	joint->SolveVelocityConstraints(data);
+
+	float maxImpulse = 0.0f;
+	for (int i = 0; i < 2; ++i)
+	{
+		cb2Body* b = bodies[i];
+		if (b->m_type == cb2_dynamicBody)
+		{
+			const cb2Velocity& velocity = data.velocities[b->m_islandIndex];
+			maxImpulse = cb2Max(maxImpulse, b->m_mass * (velocity.v - oldVelocities[i].v).length());
+			maxImpulse = cb2Max(maxImpulse, b->m_I * cb2Abs(velocity.w - oldVelocities[i].w));
+		}
+	}
+	return maxImpulse;
+}
+
+bool cb2Island::SolveColorPositions(const cb2IslandColor* color, int begin, int end,
+									cb2ContactSolver* contactSolver, const cb2SolverData& data, float* minSeparation)
+{
+	bool jointsOkay = true;
+	for (int i = begin; i < end; ++i)
+	{
+		if (i < color->jointCount)
+		{
+			bool jointOkay = m_joints[m_colorJoints[color->jointIndex + i]]->SolvePositionConstraints(data);
+			jointsOkay = jointsOkay && jointOkay;
+		}
+		else
+		{
+			int index = m_colorContacts[color->contactIndex + i - color->jointCount];
+			*minSeparation = cb2Min(*minSeparation, contactSolver->SolvePositionConstraint(index));
+		}
+	}
+	return jointsOkay;
+}
+
+// Number of constraints handed to a thread at a time.
+const int cb2_colorGrainSize = 16;
+
+// Solves one color of an island on the thread pool.
+class cb2SolveColorTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		if (positions)
+		{
+			bool jointsOkay = island->SolveColorPositions(color, begin, end, contactSolver, *data,
+														island->m_threadSeparations + threadIndex);
+			island->m_threadJointsOkay[threadIndex] = island->m_threadJointsOkay[threadIndex] && jointsOkay;
+		}
+		else
+		{
+			float maxImpulse = island->SolveColorVelocities(color, begin, end, contactSolver, *data, trackJoints);
+			island->m_threadImpulses[threadIndex] = cb2Max(island->m_threadImpulses[threadIndex], maxImpulse);
+		}
+	}
+
+	cb2Island* island;
+	const cb2IslandColor* color;
+	cb2ContactSolver* contactSolver;
+	const cb2SolverData* data;
+	bool positions;
+	bool trackJoints;
+};
+
+float cb2Island::SolveVelocityColors(cb2ContactSolver* contactSolver, const cb2SolverData& data, bool trackJoints)
+{
+	int threadCount = m_threadPool->GetThreadCount();
+	for (int i = 0; i < threadCount; ++i)
+	{
+		m_threadImpulses[i] = 0.0f;
+	}
+
+	cb2SolveColorTask task;
+	task.island = this;
+	task.contactSolver = contactSolver;
+	task.data = &data;
+	task.positions = false;
+	task.trackJoints = trackJoints;
+
+	for (int i = 0; i < cb2_maxIslandColors; ++i)
+	{
+		task.color = m_colors + i;
+		m_threadPool->ParallelFor(&task, task.color->jointCount + task.color->contactCount, cb2_colorGrainSize);
+	}
+
+	// The overflow color is solved in order on this thread.
+	const cb2IslandColor* overflow = m_colors + cb2_maxIslandColors;
+	float maxImpulse = SolveColorVelocities(overflow, 0, overflow->jointCount + overflow->contactCount, contactSolver, data, trackJoints);
+
+	for (int i = 0; i < threadCount; ++i)
+	{
+		maxImpulse = cb2Max(maxImpulse, m_threadImpulses[i]);
+	}
+	return maxImpulse;
+}
+
+void cb2Island::SolvePositionColors(cb2ContactSolver* contactSolver, const cb2SolverData& data, bool* contactsOkay, bool* jointsOkay)
+{
+	int threadCount = m_threadPool->GetThreadCount();
+	for (int i = 0; i < threadCount; ++i)
+	{
+		m_threadSeparations[i] = 0.0f;
+		m_threadJointsOkay[i] = true;
+	}
+
+	cb2SolveColorTask task;
+	task.island = this;
+	task.contactSolver = contactSolver;
+	task.data = &data;
+	task.positions = true;
+
+	for (int i = 0; i < cb2_maxIslandColors; ++i)
+	{
+		task.color = m_colors + i;
+		m_threadPool->ParallelFor(&task, task.color->jointCount + task.color->contactCount, cb2_colorGrainSize);
+	}
+
+	const cb2IslandColor* overflow = m_colors + cb2_maxIslandColors;
+	float minSeparation = 0.0f;
+	*jointsOkay = SolveColorPositions(overflow, 0, overflow->jointCount + overflow->contactCount, contactSolver, data, &minSeparation);
+
+	for (int i = 0; i < threadCount; ++i)
+	{
+		minSeparation = cb2Min(minSeparation, m_threadSeparations[i]);
+		*jointsOkay = *jointsOkay && m_threadJointsOkay[i];
+	}
+
+	// Same tolerance as cb2ContactSolver::SolvePositionConstraints.
+	*contactsOkay = minSeparation >= -3.0f * cb2_linearSlop;
+}
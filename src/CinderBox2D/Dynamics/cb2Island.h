@@ -22,14 +22,33 @@
 #include <CinderBox2D/Common/cb2Math.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
+#include <CinderBox2D/Dynamics/Joints/cb2Joint.h>
 
 class cb2Contact;
 class cb2Joint;
 class cb2StackAllocator;
 class cb2ContactListener;
+class cb2ContactSolver;
+class cb2ThreadPool;
+class cb2Profiler;
+class cb2TargetDrives;
 struct cb2ContactVelocityConstraint;
+struct cb2ContactImpulse;
 struct cb2Profile;
 
+/// Colors beyond this are solved on the calling thread.
+const int cb2_maxIslandColors = 24;
+
+/// Constraints of one color share no body that either of them writes,
+/// so they can be solved on several threads.
+struct cb2IslandColor
+{
+	int jointIndex;
+	int jointCount;
+	int contactIndex;
+	int contactCount;
+};
+
 /// This is an internal class.
 class cb2Island
 {
@@ -40,6 +59,7 @@ public:
 
 	void Clear()
 	{
+		m_staticCount = 0;
 		m_bodyCount = 0;
 		m_contactCount = 0;
 		m_jointCount = 0;
@@ -49,6 +69,22 @@ public:
 
 	void SolveTOI(const cb2TimeStep& subStep, int toiIndexA, int toiIndexB);
 
+	/// Keep the bodies still instead of solving them and add the time step to the time
+	/// they owe, up to maxDebt. Returns the most time owed, in milliseconds.
+	float Defer(float dt, float maxDebt);
+
+	/// Add a static body that other islands may be solving at the same time.
+	/// These must come first, sorted by address. See cb2Body::GetIslandIndex.
+	void AddStatic(cb2Body* body)
+	{
+		cb2Assert(m_bodyCount == m_staticCount && m_bodyCount < m_bodyCapacity);
+		cb2Assert(body->GetType() == cb2_staticBody);
+		cb2Assert(m_staticCount == 0 || m_bodies[m_staticCount - 1] < body);
+		m_bodies[m_bodyCount] = body;
+		++m_bodyCount;
+		++m_staticCount;
+	}
+
 	void Add(cb2Body* body)
 	{
 		cb2Assert(m_bodyCount < m_bodyCapacity);
@@ -69,11 +105,90 @@ public:
 		m_joints[m_jointCount++] = joint;
 	}
 
-	void Report(const cb2ContactVelocityConstraint* constraints);
+	// Initialize the body state with gravity and damping applied, as a gather
+	// into flat arrays and a loop over them. See cb2World::SetBatchIntegration.
+	void IntegrateVelocities(float h, const ci::Vec2f& gravity, float* restTime);
+
+	// Solve with the soft step solver, see cb2World::SetSolverType.
+	void SolveSoftStep(cb2Profile* profile, const cb2TimeStep& step, const ci::Vec2f& gravity, bool allowSleep);
+
+	// Integrate the positions of the bodies with the velocity clamps.
+	void IntegratePositions(float h, bool batch);
+
+	// Integrate positions in groups of cb2_simdWidth bodies. Returns the number
+	// of bodies done; IntegratePositions does the rest.
+	int IntegratePositionsWide(float h);
+
+	// Copy the solver state to the bodies.
+	void StoreState();
+
+	// Advance the body sleep times and put the island to sleep when it is at rest.
+	void UpdateSleep(const cb2TimeStep& step, bool positionSolved);
+
+	// Flag the joints whose reaction after the velocity solve is above their break
+	// force or torque. Returns the number of joints that broke.
+	int CheckBrokenJoints(float inv_dt);
+
+	// Constraints beyond the count report zero impulses. Contacts that no fixture wants
+	// reported, or whose largest normal impulse is below the threshold, are skipped.
+	void Report(const cb2ContactVelocityConstraint* constraints, int constraintCount, float threshold);
+
+	// Flag the contacts left out by contact reduction and move the others to the
+	// front. Returns the number of contacts to solve. See cb2World::SetContactReduction.
+	int ReduceContacts();
+
+	// Sort the bodies along a Morton curve, then the contacts and joints by their first
+	// body, for cb2TimeStep::spatialOrdering.
+	void SortSpatially();
+	static int GetFirstIndex(const cb2Body* bodyA, const cb2Body* bodyB);
+
+	// Group the joints by type for cb2TimeStep::jointBatching.
+	void SortJoints();
+
+	// Run a solver pass over the joints. See cb2Joint::SolveBatch.
+	bool SolveJoints(const cb2SolverData& data, cb2JointPass pass);
+
+	// Solve the velocity constraints of a joint and return the impulse it applied.
+	// Used when the velocity iterations stop at cb2TimeStep::impulseTolerance.
+	float SolveJointVelocity(cb2Joint* joint, const cb2SolverData& data);
+
+	// Used by Solve when the island has a thread pool.
+	void ColorConstraints(const cb2ContactSolver* contactSolver);
+	void FreeColors();
+	float SolveVelocityColors(cb2ContactSolver* contactSolver, const cb2SolverData& data, bool trackJoints);
+	void SolvePositionColors(cb2ContactSolver* contactSolver, const cb2SolverData& data, bool* contactsOkay, bool* jointsOkay);
+	float SolveColorVelocities(const cb2IslandColor* color, int begin, int end, cb2ContactSolver* contactSolver, const cb2SolverData& data, bool trackJoints);
+	bool SolveColorPositions(const cb2IslandColor* color, int begin, int end, cb2ContactSolver* contactSolver, const cb2SolverData& data, float* minSeparation);
 
 	cb2StackAllocator* m_allocator;
 	cb2ContactListener* m_listener;
 
+	// When set, post solve impulses are stored here instead of being reported.
+	// Skipped contacts store a count of zero.
+	cb2ContactImpulse* m_impulses;
+
+	// When set, the island does not fall asleep. Solve reports the longest
+	// body sleep time so the world can pick an island to split.
+	// See cb2World::SetPersistentIslands.
+	bool m_splitPending;
+	float m_maxSleepTime;
+
+	// When set, the target drives of the island bodies are solved with the joints.
+	cb2TargetDrives* m_targetDrives;
+
+	// When set, Solve is reported as a zone on the timeline of this thread.
+	cb2Profiler* m_profiler;
+	int m_threadIndex;
+
+	// When set, the constraints are colored and each color is solved on the pool.
+	cb2ThreadPool* m_threadPool;
+	cb2IslandColor* m_colors;
+	int* m_colorJoints;
+	int* m_colorContacts;
+	float* m_threadSeparations;
+	bool* m_threadJointsOkay;
+	float* m_threadImpulses;
+
 	cb2Body** m_bodies;
 	cb2Contact** m_contacts;
 	cb2Joint** m_joints;
@@ -81,6 +196,7 @@ public:
 	cb2Position* m_positions;
 	cb2Velocity* m_velocities;
 
+	int m_staticCount;
 	int m_bodyCount;
 	int m_jointCount;
 	int m_contactCount;
@@ -0,0 +1,456 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2IslandGraph.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
+#include <CinderBox2D/Dynamics/Joints/cb2Joint.h>
+#include <CinderBox2D/Common/cb2BlockAllocator.h>
+#include <CinderBox2D/Common/cb2StackAllocator.h>
+
+cb2IslandGraph::cb2IslandGraph(cb2BlockAllocator* allocator)
+{
+	m_allocator = allocator;
+	m_islandList = NULL;
+	m_islandCount = 0;
+}
+
+cb2PersistentIsland* cb2IslandGraph::CreateIsland()
+{
+	void* mem = m_allocator->Allocate(sizeof(cb2PersistentIsland));
+	cb2PersistentIsland* island = (cb2PersistentIsland*)mem;
+	island->bodyList = NULL;
+	island->contactList = NULL;
+	island->jointList = NULL;
+	island->bodyCount = 0;
+	island->contactCount = 0;
+	island->jointCount = 0;
+	island->constraintRemoveCount = 0;
+	island->awake = false;
+	island->solved = false;
+	island->visitStep = -1;
+
+	island->prev = NULL;
+	island->next = m_islandList;
+	if (m_islandList)
+	{
+		m_islandList->prev = island;
+	}
+	m_islandList = island;
+	++m_islandCount;
+
+	return island;
+}
+
+void cb2IslandGraph::DestroyIsland(cb2PersistentIsland* island)
+{
+	if (island->prev)
+	{
+		island->prev->next = island->next;
+	}
+
+	if (island->next)
+	{
+		island->next->prev = island->prev;
+	}
+
+	if (island == m_islandList)
+	{
+		m_islandList = island->next;
+	}
+
+	--m_islandCount;
+	m_allocator->Free(island, sizeof(cb2PersistentIsland));
+}
+
+void cb2IslandGraph::AddBody(cb2Body* body)
+{
+	cb2Assert(body->m_persistentIsland == NULL);
+	cb2Assert(body->GetType() != cb2_staticBody);
+
+	cb2PersistentIsland* island = CreateIsland();
+	island->bodyList = body;
+	island->bodyCount = 1;
+	island->awake = body->IsAwake();
+
+	body->m_persistentIsland = island;
+	body->m_islandPrev = NULL;
+	body->m_islandNext = NULL;
+}
+
+void cb2IslandGraph::RemoveBody(cb2Body* body)
+{
+	cb2PersistentIsland* island = body->m_persistentIsland;
+	cb2Assert(island != NULL);
+
+	if (body->m_islandPrev)
+	{
+		body->m_islandPrev->m_islandNext = body->m_islandNext;
+	}
+
+	if (body->m_islandNext)
+	{
+		body->m_islandNext->m_islandPrev = body->m_islandPrev;
+	}
+
+	if (body == island->bodyList)
+	{
+		island->bodyList = body->m_islandNext;
+	}
+
+	body->m_persistentIsland = NULL;
+	body->m_islandPrev = NULL;
+	body->m_islandNext = NULL;
+
+	--island->bodyCount;
+	if (island->bodyCount == 0)
+	{
+		cb2Assert(island->contactCount == 0 && island->jointCount == 0);
+		DestroyIsland(island);
+		return;
+	}
+
+	// The body may have connected the remaining bodies.
+	++island->constraintRemoveCount;
+}
+
+cb2PersistentIsland* cb2IslandGraph::Merge(cb2PersistentIsland* islandA, cb2PersistentIsland* islandB)
+{
+	if (islandA == NULL || islandA == islandB)
+	{
+		return islandB;
+	}
+
+	if (islandB == NULL)
+	{
+		return islandA;
+	}
+
+	// Relabel the smaller island.
+	if (islandA->bodyCount < islandB->bodyCount)
+	{
+		cb2PersistentIsland* tmp = islandA;
+		islandA = islandB;
+		islandB = tmp;
+	}
+
+	cb2Body* lastBody = NULL;
+	for (cb2Body* b = islandB->bodyList; b; b = b->m_islandNext)
+	{
+		b->m_persistentIsland = islandA;
+		lastBody = b;
+	}
+
+	if (lastBody)
+	{
+		lastBody->m_islandNext = islandA->bodyList;
+		if (islandA->bodyList)
+		{
+			islandA->bodyList->m_islandPrev = lastBody;
+		}
+		islandA->bodyList = islandB->bodyList;
+	}
+
+	cb2Contact* lastContact = NULL;
+	for (cb2Contact* c = islandB->contactList; c; c = c->m_islandLink->next)
+	{
+		c->m_islandLink->island = islandA;
+		lastContact = c;
+	}
+
+	if (lastContact)
+	{
+		lastContact->m_islandLink->next = islandA->contactList;
+		if (islandA->contactList)
+		{
+			islandA->contactList->m_islandLink->prev = lastContact;
+		}
+		islandA->contactList = islandB->contactList;
+	}
+
+	cb2Joint* lastJoint = NULL;
+	for (cb2Joint* j = islandB->jointList; j; j = j->m_islandNext)
+	{
+		j->m_persistentIsland = islandA;
+		lastJoint = j;
+	}
+
+	if (lastJoint)
+	{
+		lastJoint->m_islandNext = islandA->jointList;
+		if (islandA->jointList)
+		{
+			islandA->jointList->m_islandPrev = lastJoint;
+		}
+		islandA->jointList = islandB->jointList;
+	}
+
+	islandA->bodyCount += islandB->bodyCount;
+	islandA->contactCount += islandB->contactCount;
+	islandA->jointCount += islandB->jointCount;
+	islandA->constraintRemoveCount += islandB->constraintRemoveCount;
+	islandA->awake = islandA->awake || islandB->awake;
+	islandA->solved = islandA->solved || islandB->solved;
+	islandA->visitStep = cb2Max(islandA->visitStep, islandB->visitStep);
+
+	DestroyIsland(islandB);
+	return islandA;
+}
+
+void cb2IslandGraph::LinkContact(cb2Contact* contact)
+{
+	cb2Assert(contact->m_islandLink == NULL);
+
+	cb2Body* bodyA = contact->m_fixtureA->GetBody();
+	cb2Body* bodyB = contact->m_fixtureB->GetBody();
+	cb2PersistentIsland* island = Merge(bodyA->m_persistentIsland, bodyB->m_persistentIsland);
+	if (island == NULL)
+	{
+		return;
+	}
+
+	void* mem = m_allocator->Allocate(sizeof(cb2ContactIslandLink));
+	cb2ContactIslandLink* link = (cb2ContactIslandLink*)mem;
+	link->island = island;
+	link->prev = NULL;
+	link->next = island->contactList;
+	contact->m_islandLink = link;
+	if (island->contactList)
+	{
+		island->contactList->m_islandLink->prev = contact;
+	}
+	island->contactList = contact;
+	++island->contactCount;
+}
+
+void cb2IslandGraph::UnlinkContact(cb2Contact* contact)
+{
+	cb2ContactIslandLink* link = contact->m_islandLink;
+	cb2Assert(link != NULL);
+	cb2PersistentIsland* island = link->island;
+
+	if (link->prev)
+	{
+		link->prev->m_islandLink->next = link->next;
+	}
+
+	if (link->next)
+	{
+		link->next->m_islandLink->prev = link->prev;
+	}
+
+	if (contact == island->contactList)
+	{
+		island->contactList = link->next;
+	}
+
+	m_allocator->Free(link, sizeof(cb2ContactIslandLink));
+	contact->m_islandLink = NULL;
+
+	--island->contactCount;
+	++island->constraintRemoveCount;
+}
+
+void cb2IslandGraph::LinkJoint(cb2Joint* joint)
+{
+	cb2Assert(joint->m_persistentIsland == NULL);
+
+	cb2PersistentIsland* island = Merge(joint->m_bodyA->m_persistentIsland, joint->m_bodyB->m_persistentIsland);
+	if (island == NULL)
+	{
+		return;
+	}
+
+	joint->m_persistentIsland = island;
+	joint->m_islandPrev = NULL;
+	joint->m_islandNext = island->jointList;
+	if (island->jointList)
+	{
+		island->jointList->m_islandPrev = joint;
+	}
+	island->jointList = joint;
+	++island->jointCount;
+}
+
+void cb2IslandGraph::UnlinkJoint(cb2Joint* joint)
+{
+	cb2PersistentIsland* island = joint->m_persistentIsland;
+	cb2Assert(island != NULL);
+
+	if (joint->m_islandPrev)
+	{
+		joint->m_islandPrev->m_islandNext = joint->m_islandNext;
+	}
+
+	if (joint->m_islandNext)
+	{
+		joint->m_islandNext->m_islandPrev = joint->m_islandPrev;
+	}
+
+	if (joint == island->jointList)
+	{
+		island->jointList = joint->m_islandNext;
+	}
+
+	joint->m_persistentIsland = NULL;
+	joint->m_islandPrev = NULL;
+	joint->m_islandNext = NULL;
+
+	--island->jointCount;
+	++island->constraintRemoveCount;
+}
+
+void cb2IslandGraph::SplitIsland(cb2PersistentIsland* island, cb2StackAllocator* allocator)
+{
+	int bodyCount = island->bodyCount;
+	cb2Body** bodies = (cb2Body**)allocator->Allocate(bodyCount * sizeof(cb2Body*));
+	cb2Body** stack = (cb2Body**)allocator->Allocate(bodyCount * sizeof(cb2Body*));
+
+	// Members still pointing at the old island have not been visited.
+	int index = 0;
+	for (cb2Body* b = island->bodyList; b; b = b->m_islandNext)
+	{
+		bodies[index++] = b;
+	}
+	cb2Assert(index == bodyCount);
+
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		cb2Body* seed = bodies[i];
+		if (seed->m_persistentIsland != island)
+		{
+			continue;
+		}
+
+		cb2PersistentIsland* part = CreateIsland();
+		part->awake = island->awake;
+		part->solved = island->solved;
+		part->visitStep = island->visitStep;
+
+		int stackCount = 0;
+		stack[stackCount++] = seed;
+		seed->m_persistentIsland = part;
+
+		// Perform a depth first search (DFS) on the linked constraints.
+		while (stackCount > 0)
+		{
+			cb2Body* b = stack[--stackCount];
+
+			b->m_islandPrev = NULL;
+			b->m_islandNext = part->bodyList;
+			if (part->bodyList)
+			{
+				part->bodyList->m_islandPrev = b;
+			}
+			part->bodyList = b;
+			++part->bodyCount;
+
+			for (cb2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+			{
+				cb2ContactIslandLink* link = ce->contact->m_islandLink;
+				if (link == NULL || link->island != island)
+				{
+					continue;
+				}
+
+				link->island = part;
+				link->prev = NULL;
+				link->next = part->contactList;
+				if (part->contactList)
+				{
+					part->contactList->m_islandLink->prev = ce->contact;
+				}
+				part->contactList = ce->contact;
+				++part->contactCount;
+
+				cb2Body* other = ce->other;
+				if (other->m_persistentIsland == island)
+				{
+					cb2Assert(stackCount < bodyCount);
+					stack[stackCount++] = other;
+					other->m_persistentIsland = part;
+				}
+			}
+
+			for (cb2JointEdge* je = b->m_jointList; je; je = je->next)
+			{
+				cb2Joint* joint = je->joint;
+				if (joint->m_persistentIsland != island)
+				{
+					continue;
+				}
+
+				joint->m_persistentIsland = part;
+				joint->m_islandPrev = NULL;
+				joint->m_islandNext = part->jointList;
+				if (part->jointList)
+				{
+					part->jointList->m_islandPrev = joint;
+				}
+				part->jointList = joint;
+				++part->jointCount;
+
+				cb2Body* other = je->other;
+				if (other->m_persistentIsland == island)
+				{
+					cb2Assert(stackCount < bodyCount);
+					stack[stackCount++] = other;
+					other->m_persistentIsland = part;
+				}
+			}
+		}
+	}
+
+	allocator->Free(stack);
+	allocator->Free(bodies);
+
+	DestroyIsland(island);
+}
+
+void cb2IslandGraph::Clear()
+{
+	cb2PersistentIsland* island = m_islandList;
+	while (island)
+	{
+		for (cb2Body* b = island->bodyList; b; b = b->m_islandNext)
+		{
+			b->m_persistentIsland = NULL;
+		}
+
+		cb2Contact* c = island->contactList;
+		while (c)
+		{
+			cb2ContactIslandLink* link = c->m_islandLink;
+			c->m_islandLink = NULL;
+			c = link->next;
+			m_allocator->Free(link, sizeof(cb2ContactIslandLink));
+		}
+
+		for (cb2Joint* j = island->jointList; j; j = j->m_islandNext)
+		{
+			j->m_persistentIsland = NULL;
+		}
+
+		cb2PersistentIsland* island0 = island;
+		island = island->next;
+		m_allocator->Free(island0, sizeof(cb2PersistentIsland));
+	}
+
+	m_islandList = NULL;
+	m_islandCount = 0;
+}
@@ -0,0 +1,102 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_ISLAND_GRAPH_H
+#define CB2_ISLAND_GRAPH_H
+
+class cb2Body;
+class cb2Contact;
+class cb2Joint;
+class cb2BlockAllocator;
+class cb2StackAllocator;
+
+/// A group of non-static bodies connected by touching contacts and joints.
+/// Contacts and joints to static bodies belong to the island of the other body.
+/// Removing a constraint may disconnect the island, which is only found out
+/// when it is split. See cb2World::SetPersistentIslands.
+struct cb2PersistentIsland
+{
+	cb2PersistentIsland* prev;
+	cb2PersistentIsland* next;
+
+	cb2Body* bodyList;
+	cb2Contact* contactList;
+	cb2Joint* jointList;
+
+	int bodyCount;
+	int contactCount;
+	int jointCount;
+
+	// Number of constraints and bodies removed since the island was built.
+	int constraintRemoveCount;
+
+	// False once the island fell asleep. Waking any of its bodies sets it again.
+	bool awake;
+
+	// Set while the bodies carry the island flags of the last solve.
+	bool solved;
+
+	// The last step that visited the island, see cb2World::SetSolveBudget.
+	int visitStep;
+};
+
+/// Keeps the islands of a world up to date as contacts begin and end, instead of
+/// searching the constraint graph every step. Islands are merged right away and
+/// split lazily.
+class cb2IslandGraph
+{
+public:
+	/// The islands are allocated from the world's block allocator and go away with it.
+	cb2IslandGraph(cb2BlockAllocator* allocator);
+
+	/// Give a non-static body its own island.
+	void AddBody(cb2Body* body);
+
+	/// Remove a body. Its contacts and joints must be unlinked first.
+	void RemoveBody(cb2Body* body);
+
+	/// Link a touching contact, merging the islands of its bodies.
+	void LinkContact(cb2Contact* contact);
+	void UnlinkContact(cb2Contact* contact);
+
+	/// Link a joint with at least one non-static body, merging the islands of its bodies.
+	void LinkJoint(cb2Joint* joint);
+	void UnlinkJoint(cb2Joint* joint);
+
+	/// Replace an island by its connected parts. The island is destroyed.
+	void SplitIsland(cb2PersistentIsland* island, cb2StackAllocator* allocator);
+
+	/// Destroy all islands and unlink everything.
+	void Clear();
+
+	cb2PersistentIsland* GetIslandList() { return m_islandList; }
+	int GetIslandCount() const { return m_islandCount; }
+
+private:
+	cb2PersistentIsland* CreateIsland();
+	void DestroyIsland(cb2PersistentIsland* island);
+
+	// Move the smaller island into the larger one and return the larger one.
+	cb2PersistentIsland* Merge(cb2PersistentIsland* islandA, cb2PersistentIsland* islandB);
+
+	cb2BlockAllocator* m_allocator;
+	cb2PersistentIsland* m_islandList;
+	int m_islandCount;
+};
+
+#endif
@@ -0,0 +1,464 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2Level.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
+#include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+#include <new>
+#include <memory.h>
+
+// The first bytes of a level file.
+const unsigned int cb2_levelMagic = 0x4C324243;
+const int cb2_levelVersion = 1;
+
+// Sections of a level start on this boundary.
+const int cb2_levelAlignment = 16;
+
+struct cb2LevelHeader
+{
+	unsigned int magic;
+	int version;
+	int size;
+	int proxySize;
+	int nodeSize;
+	int chainCount;
+	int chainOffset;
+	int shapeCount;
+	int shapeOffset;
+};
+
+struct cb2LevelFixture
+{
+	float friction;
+	float restitution;
+	cb2Filter filter;
+	int isSensor;
+};
+
+// A chain with the offsets of its vertices and of the arrays of its child tree.
+struct cb2LevelChain
+{
+	cb2LevelFixture fixture;
+	float radius;
+	int vertexOffset;
+	int vertexCount;
+	cb2AABB localAABB;
+	ci::Vec2f prevVertex;
+	ci::Vec2f nextVertex;
+	int hasPrevVertex;
+	int hasNextVertex;
+	int proxyOffset;
+	int proxyCount;
+	int nodeOffset;
+	int nodeCount;
+	int root;
+};
+
+// A circle or polygon. The circle center is in centroid.
+struct cb2LevelShape
+{
+	cb2LevelFixture fixture;
+	int type;
+	float radius;
+	int count;
+	ci::Vec2f centroid;
+	ci::Vec2f vertices[cb2_maxPolygonVertices];
+	ci::Vec2f normals[cb2_maxPolygonVertices];
+};
+
+static int cb2AlignLevelOffset(int offset)
+{
+	return (offset + cb2_levelAlignment - 1) & ~(cb2_levelAlignment - 1);
+}
+
+static bool cb2SamePoint(const ci::Vec2f& a, const ci::Vec2f& b)
+{
+	return a.x == b.x && a.y == b.y;
+}
+
+static bool cb2SameFixture(const cb2Fixture* a, const cb2Fixture* b)
+{
+	const cb2Filter& filterA = a->GetFilterData();
+	const cb2Filter& filterB = b->GetFilterData();
+	return a->GetFriction() == b->GetFriction() && a->GetRestitution() == b->GetRestitution() &&
+		a->IsSensor() == b->IsSensor() && filterA.categoryBits == filterB.categoryBits &&
+		filterA.maskBits == filterB.maskBits && filterA.groupIndex == filterB.groupIndex &&
+		filterA.layer == filterB.layer;
+}
+
+// Can the edge of b follow the edge of a in one chain without changing the collision?
+static bool cb2CanJoinEdges(const cb2Fixture* a, const cb2Fixture* b)
+{
+	if (a->GetType() != cb2Shape::e_edge || b->GetType() != cb2Shape::e_edge || cb2SameFixture(a, b) == false)
+	{
+		return false;
+	}
+
+	const cb2EdgeShape* edgeA = (const cb2EdgeShape*)a->GetShape();
+	const cb2EdgeShape* edgeB = (const cb2EdgeShape*)b->GetShape();
+	return edgeA->m_radius == edgeB->m_radius && cb2SamePoint(edgeA->m_vertex2, edgeB->m_vertex1) &&
+		edgeA->m_hasVertex3 && cb2SamePoint(edgeA->m_vertex3, edgeB->m_vertex2) &&
+		edgeB->m_hasVertex0 && cb2SamePoint(edgeB->m_vertex0, edgeA->m_vertex1);
+}
+
+static void cb2WriteLevelFixture(cb2LevelFixture* record, const cb2Fixture* fixture)
+{
+	record->friction = fixture->GetFriction();
+	record->restitution = fixture->GetRestitution();
+	record->filter = fixture->GetFilterData();
+	record->isSensor = fixture->IsSensor() ? 1 : 0;
+}
+
+static void cb2ReadLevelFixture(cb2FixtureDef* def, const cb2LevelFixture& record)
+{
+	def->friction = record.friction;
+	def->restitution = record.restitution;
+	def->filter = record.filter;
+	def->isSensor = record.isSensor != 0;
+	def->density = 0.0f;
+}
+
+int cb2BakeLevel(const cb2Body* body, void* buffer, int capacity)
+{
+	// The fixtures in the order they were created.
+	int fixtureCount = 0;
+	for (const cb2Fixture* f = body->GetFixtureList(); f; f = f->GetNext())
+	{
+		++fixtureCount;
+	}
+
+	const cb2Fixture** fixtures = (const cb2Fixture**)cb2Alloc(cb2Max(fixtureCount, 1) * sizeof(cb2Fixture*));
+	int index = fixtureCount;
+	for (const cb2Fixture* f = body->GetFixtureList(); f; f = f->GetNext())
+	{
+		fixtures[--index] = f;
+	}
+
+	// Each chain of the level with its fixture. Runs of connected edges become new chains.
+	const cb2ChainShape** chains = (const cb2ChainShape**)cb2Alloc(cb2Max(fixtureCount, 1) * sizeof(cb2ChainShape*));
+	const cb2Fixture** chainFixtures = (const cb2Fixture**)cb2Alloc(cb2Max(fixtureCount, 1) * sizeof(cb2Fixture*));
+	cb2ChainShape** edgeChains = (cb2ChainShape**)cb2Alloc(cb2Max(fixtureCount, 1) * sizeof(cb2ChainShape*));
+	ci::Vec2f* vertices = (ci::Vec2f*)cb2Alloc((fixtureCount + 1) * sizeof(ci::Vec2f));
+	int chainCount = 0;
+	int edgeChainCount = 0;
+	int shapeCount = 0;
+	for (int i = 0; i < fixtureCount; ++i)
+	{
+		const cb2Fixture* fixture = fixtures[i];
+		switch (fixture->GetType())
+		{
+		case cb2Shape::e_chain:
+			chains[chainCount] = (const cb2ChainShape*)fixture->GetShape();
+			chainFixtures[chainCount] = fixture;
+			++chainCount;
+			break;
+
+		case cb2Shape::e_edge:
+			{
+				int first = i;
+				const cb2EdgeShape* edge = (const cb2EdgeShape*)fixture->GetShape();
+				int vertexCount = 0;
+				vertices[vertexCount++] = edge->m_vertex1;
+				vertices[vertexCount++] = edge->m_vertex2;
+				while (i + 1 < fixtureCount && cb2CanJoinEdges(fixtures[i], fixtures[i + 1]))
+				{
+					++i;
+					vertices[vertexCount++] = ((const cb2EdgeShape*)fixtures[i]->GetShape())->m_vertex2;
+				}
+
+				const cb2EdgeShape* firstEdge = (const cb2EdgeShape*)fixtures[first]->GetShape();
+				const cb2EdgeShape* lastEdge = (const cb2EdgeShape*)fixtures[i]->GetShape();
+				void* mem = cb2Alloc(sizeof(cb2ChainShape));
+				cb2ChainShape* chain = new (mem) cb2ChainShape;
+				chain->CreateChain(vertices, vertexCount);
+				chain->m_radius = firstEdge->m_radius;
+				if (firstEdge->m_hasVertex0)
+				{
+					chain->SetPrevVertex(firstEdge->m_vertex0);
+				}
+				if (lastEdge->m_hasVertex3)
+				{
+					chain->SetNextVertex(lastEdge->m_vertex3);
+				}
+
+				edgeChains[edgeChainCount++] = chain;
+				chains[chainCount] = chain;
+				chainFixtures[chainCount] = fixtures[first];
+				++chainCount;
+			}
+			break;
+
+		default:
+			++shapeCount;
+			break;
+		}
+	}
+	cb2Free(vertices);
+
+	// Lay out the sections.
+	int chainOffset = cb2AlignLevelOffset(sizeof(cb2LevelHeader));
+	int shapeOffset = cb2AlignLevelOffset(chainOffset + chainCount * sizeof(cb2LevelChain));
+	int size = cb2AlignLevelOffset(shapeOffset + shapeCount * sizeof(cb2LevelShape));
+	for (int i = 0; i < chainCount; ++i)
+	{
+		const cb2ChainShape* chain = chains[i];
+		size = cb2AlignLevelOffset(size + chain->m_count * sizeof(ci::Vec2f));
+		const cb2StaticTree* tree = chain->GetChildTree();
+		if (tree)
+		{
+			cb2StaticTreeView view;
+			tree->GetView(&view);
+			size = cb2AlignLevelOffset(size + view.proxyCount * sizeof(cb2StaticProxy));
+			size = cb2AlignLevelOffset(size + view.nodeCount * sizeof(cb2StaticTreeNode));
+		}
+	}
+
+	if (size <= capacity)
+	{
+		char* data = (char*)buffer;
+		memset(data, 0, size);
+
+		cb2LevelHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic = cb2_levelMagic;
+		header.version = cb2_levelVersion;
+		header.size = size;
+		header.proxySize = sizeof(cb2StaticProxy);
+		header.nodeSize = sizeof(cb2StaticTreeNode);
+		header.chainCount = chainCount;
+		header.chainOffset = chainOffset;
+		header.shapeCount = shapeCount;
+		header.shapeOffset = shapeOffset;
+		memcpy(data, &header, sizeof(header));
+
+		int offset = cb2AlignLevelOffset(shapeOffset + shapeCount * sizeof(cb2LevelShape));
+		for (int i = 0; i < chainCount; ++i)
+		{
+			const cb2ChainShape* chain = chains[i];
+			cb2LevelChain record = cb2LevelChain();
+			cb2WriteLevelFixture(&record.fixture, chainFixtures[i]);
+			record.radius = chain->m_radius;
+			record.vertexOffset = offset;
+			record.vertexCount = chain->m_count;
+			record.prevVertex = chain->m_prevVertex;
+			record.nextVertex = chain->m_nextVertex;
+			record.hasPrevVertex = chain->m_hasPrevVertex ? 1 : 0;
+			record.hasNextVertex = chain->m_hasNextVertex ? 1 : 0;
+			record.root = cb2StaticTree::e_nullNode;
+
+			// The same box as the chain computes for itself.
+			record.localAABB.lowerBound = chain->m_vertices[0];
+			record.localAABB.upperBound = chain->m_vertices[0];
+			for (int j = 1; j < chain->m_count; ++j)
+			{
+				record.localAABB.lowerBound = cb2Min(record.localAABB.lowerBound, chain->m_vertices[j]);
+				record.localAABB.upperBound = cb2Max(record.localAABB.upperBound, chain->m_vertices[j]);
+			}
+
+			memcpy(data + offset, chain->m_vertices, chain->m_count * sizeof(ci::Vec2f));
+			offset = cb2AlignLevelOffset(offset + chain->m_count * sizeof(ci::Vec2f));
+
+			const cb2StaticTree* tree = chain->GetChildTree();
+			if (tree)
+			{
+				cb2StaticTreeView view;
+				tree->GetView(&view);
+				record.proxyOffset = offset;
+				record.proxyCount = view.proxyCount;
+				memcpy(data + offset, view.proxies, view.proxyCount * sizeof(cb2StaticProxy));
+				offset = cb2AlignLevelOffset(offset + view.proxyCount * sizeof(cb2StaticProxy));
+
+				record.nodeOffset = offset;
+				record.nodeCount = view.nodeCount;
+				record.root = view.root;
+				memcpy(data + offset, view.nodes, view.nodeCount * sizeof(cb2StaticTreeNode));
+				offset = cb2AlignLevelOffset(offset + view.nodeCount * sizeof(cb2StaticTreeNode));
+			}
+
+			memcpy(data + chainOffset + i * sizeof(cb2LevelChain), &record, sizeof(record));
+		}
+		cb2Assert(offset == size);
+
+		int shapeIndex = 0;
+		for (int i = 0; i < fixtureCount; ++i)
+		{
+			const cb2Fixture* fixture = fixtures[i];
+			if (fixture->GetType() != cb2Shape::e_circle && fixture->GetType() != cb2Shape::e_polygon)
+			{
+				continue;
+			}
+
+			cb2LevelShape record = cb2LevelShape();
+			cb2WriteLevelFixture(&record.fixture, fixture);
+			record.type = fixture->GetType();
+			record.radius = fixture->GetShape()->m_radius;
+			if (fixture->GetType() == cb2Shape::e_circle)
+			{
+				record.centroid = ((const cb2CircleShape*)fixture->GetShape())->m_p;
+			}
+			else
+			{
+				const cb2PolygonShape* polygon = (const cb2PolygonShape*)fixture->GetShape();
+				record.count = polygon->m_count;
+				record.centroid = polygon->m_centroid;
+				memcpy(record.vertices, polygon->m_vertices, sizeof(record.vertices));
+				memcpy(record.normals, polygon->m_normals, sizeof(record.normals));
+			}
+
+			memcpy(data + shapeOffset + shapeIndex * sizeof(cb2LevelShape), &record, sizeof(record));
+			++shapeIndex;
+		}
+	}
+
+	for (int i = 0; i < edgeChainCount; ++i)
+	{
+		edgeChains[i]->~cb2ChainShape();
+		cb2Free(edgeChains[i]);
+	}
+	cb2Free(edgeChains);
+	cb2Free(chainFixtures);
+	cb2Free(chains);
+	cb2Free(fixtures);
+
+	return size;
+}
+
+// Is the range [offset, offset + count * elementSize) inside the level?
+static bool cb2IsLevelRange(int offset, int count, int elementSize, int size)
+{
+	return offset >= 0 && count >= 0 && offset <= size && count <= (size - offset) / elementSize;
+}
+
+cb2Body* cb2AttachLevel(cb2World* world, const void* level, int size)
+{
+	const char* data = (const char*)level;
+	if (data == NULL || ((size_t)data & (cb2_levelAlignment - 1)) != 0 || size < (int)sizeof(cb2LevelHeader))
+	{
+		return NULL;
+	}
+
+	const cb2LevelHeader* header = (const cb2LevelHeader*)data;
+	if (header->magic != cb2_levelMagic || header->version != cb2_levelVersion || header->size != size ||
+		header->proxySize != (int)sizeof(cb2StaticProxy) || header->nodeSize != (int)sizeof(cb2StaticTreeNode) ||
+		cb2IsLevelRange(header->chainOffset, header->chainCount, sizeof(cb2LevelChain), size) == false ||
+		cb2IsLevelRange(header->shapeOffset, header->shapeCount, sizeof(cb2LevelShape), size) == false)
+	{
+		return NULL;
+	}
+
+	const cb2LevelChain* chains = (const cb2LevelChain*)(data + header->chainOffset);
+	for (int i = 0; i < header->chainCount; ++i)
+	{
+		const cb2LevelChain* chain = chains + i;
+		bool hasTree = chain->proxyCount > 0;
+		if (chain->vertexCount < 2 ||
+			cb2IsLevelRange(chain->vertexOffset, chain->vertexCount, sizeof(ci::Vec2f), size) == false ||
+			(hasTree && chain->proxyCount != chain->vertexCount - 1) ||
+			cb2IsLevelRange(chain->proxyOffset, chain->proxyCount, sizeof(cb2StaticProxy), size) == false ||
+			cb2IsLevelRange(chain->nodeOffset, chain->nodeCount, sizeof(cb2StaticTreeNode), size) == false ||
+			(hasTree && (chain->root < 0 || chain->root >= chain->nodeCount)))
+		{
+			return NULL;
+		}
+	}
+
+	const cb2LevelShape* shapes = (const cb2LevelShape*)(data + header->shapeOffset);
+	for (int i = 0; i < header->shapeCount; ++i)
+	{
+		const cb2LevelShape* shape = shapes + i;
+		if ((shape->type != cb2Shape::e_circle && shape->type != cb2Shape::e_polygon) ||
+			(shape->type == cb2Shape::e_polygon && (shape->count < 3 || shape->count > cb2_maxPolygonVertices)))
+		{
+			return NULL;
+		}
+	}
+
+	cb2BodyDef bodyDef;
+	cb2Body* body = world->CreateBody(&bodyDef);
+	if (body == NULL)
+	{
+		return NULL;
+	}
+
+	world->BeginBulkLoad();
+
+	for (int i = 0; i < header->chainCount; ++i)
+	{
+		const cb2LevelChain* record = chains + i;
+		cb2StaticTreeView view;
+		view.proxies = (const cb2StaticProxy*)(data + record->proxyOffset);
+		view.proxyCount = record->proxyCount;
+		view.nodes = (const cb2StaticTreeNode*)(data + record->nodeOffset);
+		view.nodeCount = record->nodeCount;
+		view.root = record->root;
+
+		cb2ChainShape chain;
+		chain.CreateView((const ci::Vec2f*)(data + record->vertexOffset), record->vertexCount, record->localAABB,
+			record->proxyCount > 0 ? &view : NULL);
+		chain.m_radius = record->radius;
+		if (record->hasPrevVertex)
+		{
+			chain.SetPrevVertex(record->prevVertex);
+		}
+		if (record->hasNextVertex)
+		{
+			chain.SetNextVertex(record->nextVertex);
+		}
+
+		cb2FixtureDef fixtureDef;
+		cb2ReadLevelFixture(&fixtureDef, record->fixture);
+		fixtureDef.shape = &chain;
+		body->CreateFixture(&fixtureDef);
+	}
+
+	for (int i = 0; i < header->shapeCount; ++i)
+	{
+		const cb2LevelShape* record = shapes + i;
+		cb2CircleShape circle;
+		cb2PolygonShape polygon;
+		cb2FixtureDef fixtureDef;
+		cb2ReadLevelFixture(&fixtureDef, record->fixture);
+
+		if (record->type == cb2Shape::e_circle)
+		{
+			circle.m_radius = record->radius;
+			circle.m_p = record->centroid;
+			fixtureDef.shape = &circle;
+		}
+		else
+		{
+			// The derived data was computed when baking.
+			polygon.m_radius = record->radius;
+			polygon.m_count = record->count;
+			polygon.m_centroid = record->centroid;
+			memcpy(polygon.m_vertices, record->vertices, sizeof(polygon.m_vertices));
+			memcpy(polygon.m_normals, record->normals, sizeof(polygon.m_normals));
+			fixtureDef.shape = &polygon;
+		}
+
+		body->CreateFixture(&fixtureDef);
+	}
+
+	world->EndBulkLoad();
+	return body;
+}
@@ -0,0 +1,44 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_LEVEL_H
+#define CB2_LEVEL_H
+
+#include <CinderBox2D/Common/cb2Settings.h>
+
+class cb2Body;
+class cb2World;
+
+/// Bake the fixtures of a static body into a level file that can be attached to
+/// worlds without building anything. The file holds offsets instead of pointers, so it
+/// can be memory mapped anywhere. Chains are stored with the tree of their child
+/// edges, and runs of connected edges are stored as chains. Other shapes are stored
+/// with their derived data, so attaching them computes nothing. The file layout
+/// depends on the pointer size and byte order of the machine that baked it.
+/// Returns the number of bytes the level needs; nothing is written when the capacity
+/// is smaller.
+int cb2BakeLevel(const cb2Body* body, void* buffer, int capacity);
+
+/// Create a static body with the fixtures of a baked level. The chains use the vertices
+/// and child trees of the level in place, so the level memory must stay mapped while
+/// any world uses it. Several worlds can share one level. The level must be aligned to
+/// 16 bytes, as mapped memory is. Returns NULL if the level is damaged or was baked
+/// on a different kind of machine.
+cb2Body* cb2AttachLevel(cb2World* world, const void* level, int size);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2MaterialTable.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
+
+cb2MaterialTable::cb2MaterialTable()
+{
+	// The materials start with the defaults of cb2FixtureDef.
+	cb2FixtureDef def;
+	for (int i = 0; i < cb2_maxMaterials; ++i)
+	{
+		m_friction[i] = def.friction;
+		m_restitution[i] = def.restitution;
+		m_changed[i] = false;
+	}
+
+	for (int i = 0; i < cb2_maxMaterials; ++i)
+	{
+		for (int j = 0; j < cb2_maxMaterials; ++j)
+		{
+			m_custom[i * cb2_maxMaterials + j] = false;
+			MixPair(i, j);
+		}
+	}
+
+	m_hasChanges = false;
+}
+
+void cb2MaterialTable::MixPair(int materialA, int materialB)
+{
+	cb2MaterialPair* pair = m_pairs + materialA * cb2_maxMaterials + materialB;
+	pair->friction = cb2MixFriction(m_friction[materialA], m_friction[materialB]);
+	pair->restitution = cb2MixRestitution(m_restitution[materialA], m_restitution[materialB]);
+	pair->tangentSpeed = 0.0f;
+}
+
+void cb2MaterialTable::SetMaterial(int material, float friction, float restitution)
+{
+	cb2Assert(0 <= material && material < cb2_maxMaterials);
+	m_friction[material] = friction;
+	m_restitution[material] = restitution;
+
+	for (int i = 0; i < cb2_maxMaterials; ++i)
+	{
+		if (m_custom[material * cb2_maxMaterials + i] == false)
+		{
+			MixPair(material, i);
+			MixPair(i, material);
+		}
+	}
+
+	m_changed[material] = true;
+	m_hasChanges = true;
+}
+
+void cb2MaterialTable::SetPair(int materialA, int materialB, const cb2MaterialPair& pair)
+{
+	cb2Assert(0 <= materialA && materialA < cb2_maxMaterials);
+	cb2Assert(0 <= materialB && materialB < cb2_maxMaterials);
+	m_pairs[materialA * cb2_maxMaterials + materialB] = pair;
+	m_pairs[materialB * cb2_maxMaterials + materialA] = pair;
+	m_custom[materialA * cb2_maxMaterials + materialB] = true;
+	m_custom[materialB * cb2_maxMaterials + materialA] = true;
+
+	m_changed[materialA] = true;
+	m_changed[materialB] = true;
+	m_hasChanges = true;
+}
+
+void cb2MaterialTable::ResetPair(int materialA, int materialB)
+{
+	cb2Assert(0 <= materialA && materialA < cb2_maxMaterials);
+	cb2Assert(0 <= materialB && materialB < cb2_maxMaterials);
+	m_custom[materialA * cb2_maxMaterials + materialB] = false;
+	m_custom[materialB * cb2_maxMaterials + materialA] = false;
+	MixPair(materialA, materialB);
+	MixPair(materialB, materialA);
+
+	m_changed[materialA] = true;
+	m_changed[materialB] = true;
+	m_hasChanges = true;
+}
+
+void cb2MaterialTable::ClearChanges()
+{
+	for (int i = 0; i < cb2_maxMaterials; ++i)
+	{
+		m_changed[i] = false;
+	}
+	m_hasChanges = false;
+}
@@ -0,0 +1,77 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_MATERIAL_TABLE_H
+#define CB2_MATERIAL_TABLE_H
+
+#include <CinderBox2D/Common/cb2Settings.h>
+
+/// The surface of a contact between two materials.
+struct cb2MaterialPair
+{
+	float friction;
+	float restitution;
+
+	/// The tangent speed of the contact, see cb2Contact::SetTangentSpeed.
+	float tangentSpeed;
+};
+
+/// The friction and restitution of each material and of each pair of materials, so a
+/// contact between fixtures with materials looks up its surface instead of mixing it.
+/// A pair mixes the values of its two materials unless it was set on its own. The
+/// changed materials are flagged, so only their contacts are updated.
+class cb2MaterialTable
+{
+public:
+	cb2MaterialTable();
+
+	/// Set the friction and restitution of a material. The pairs of the material that
+	/// were not set are mixed again.
+	void SetMaterial(int material, float friction, float restitution);
+	float GetFriction(int material) const { return m_friction[material]; }
+	float GetRestitution(int material) const { return m_restitution[material]; }
+
+	/// Set the surface of a pair of materials, in both orders.
+	void SetPair(int materialA, int materialB, const cb2MaterialPair& pair);
+
+	/// Mix the surface of a pair from its materials again.
+	void ResetPair(int materialA, int materialB);
+
+	const cb2MaterialPair& GetPair(int materialA, int materialB) const
+	{
+		return m_pairs[materialA * cb2_maxMaterials + materialB];
+	}
+
+	/// Was the material changed since the last call to ClearChanges?
+	bool IsChanged(int material) const { return m_changed[material]; }
+	bool HasChanges() const { return m_hasChanges; }
+	void ClearChanges();
+
+private:
+
+	void MixPair(int materialA, int materialB);
+
+	float m_friction[cb2_maxMaterials];
+	float m_restitution[cb2_maxMaterials];
+	cb2MaterialPair m_pairs[cb2_maxMaterials * cb2_maxMaterials];
+	bool m_custom[cb2_maxMaterials * cb2_maxMaterials];
+	bool m_changed[cb2_maxMaterials];
+	bool m_hasChanges;
+};
+
+#endif
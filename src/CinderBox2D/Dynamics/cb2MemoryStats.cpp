@@ -0,0 +1,44 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2MemoryStats.h>
+#include <CinderBox2D/Common/cb2Profiler.h>
+
+void cb2ReportMemoryStats(const cb2MemoryStats& stats, cb2Profiler* profiler)
+{
+	if (profiler == NULL)
+	{
+		return;
+	}
+
+	profiler->ReportCounter("memory total bytes", stats.totalBytes);
+	profiler->ReportCounter("memory block chunks", stats.block.chunkCount);
+	profiler->ReportCounter("memory block used bytes", stats.block.usedBytes);
+	profiler->ReportCounter("memory large bytes", stats.block.largeBytes);
+	profiler->ReportCounter("memory broad-phase bytes", stats.broadPhase.bytes);
+	profiler->ReportCounter("memory tree nodes", stats.broadPhase.treeNodeCount);
+	profiler->ReportCounter("memory tree node capacity", stats.broadPhase.treeNodeCapacity);
+	profiler->ReportCounter("memory move capacity", stats.broadPhase.moveCapacity);
+	profiler->ReportCounter("memory pair capacity", stats.broadPhase.pairCapacity);
+	profiler->ReportCounter("memory stack capacity", stats.stackCapacity);
+	profiler->ReportCounter("memory stack high-water", stats.stackMaxAllocation);
+	profiler->ReportCounter("memory bodies", stats.bodyCount);
+	profiler->ReportCounter("memory fixtures", stats.fixtureCount);
+	profiler->ReportCounter("memory contacts", stats.contactCount);
+	profiler->ReportCounter("memory joints", stats.jointCount);
+}
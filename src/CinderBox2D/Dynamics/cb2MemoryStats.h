@@ -0,0 +1,58 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_MEMORY_STATS_H
+#define CB2_MEMORY_STATS_H
+
+#include <CinderBox2D/Common/cb2BlockAllocator.h>
+#include <CinderBox2D/Collision/cb2BroadPhase.h>
+#include <CinderBox2D/Collision/Shapes/cb2Shape.h>
+#include <CinderBox2D/Dynamics/Joints/cb2Joint.h>
+
+class cb2Profiler;
+
+/// The number of joint types, for tables indexed by cb2JointType.
+#define cb2_jointTypeCount	(e_motorJoint + 1)
+
+/// The memory of a world and the objects it holds, see cb2World::GetMemoryStats.
+/// Bodies, fixtures, contacts and joints live in the blocks of the block allocator.
+struct cb2MemoryStats
+{
+	cb2BlockAllocatorStats block;
+	cb2BroadPhaseMemory broadPhase;
+
+	int stackCapacity;			///< the stack allocators of the world and the pool threads
+	int stackMaxAllocation;		///< the high-water mark of the largest stack allocator
+
+	int bodyCount;
+	int fixtureCount;
+	int proxyCount;
+	int contactCount;
+	int contactCounts[cb2Shape::e_typeCount][cb2Shape::e_typeCount];	///< by the types of fixture A and B
+	int jointCount;
+	int jointCounts[cb2_jointTypeCount];
+
+	/// The bytes the world holds in its allocators and the broad-phase. Memory owned
+	/// by the optional subsystems, such as particle systems, is not included.
+	int totalBytes;
+};
+
+/// Send memory statistics to a profiler as counters, such as "memory total bytes".
+void cb2ReportMemoryStats(const cb2MemoryStats& stats, cb2Profiler* profiler);
+
+#endif
@@ -0,0 +1,177 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2ProfileStats.h>
+#include <CinderBox2D/Common/cb2Math.h>
+#include <algorithm>
+#include <stddef.h>
+
+struct cb2ProfileFieldDef
+{
+	const char* name;
+	int offset;
+	int type;
+};
+
+enum
+{
+	e_floatField,
+	e_intField,
+	e_boolField
+};
+
+static const cb2ProfileFieldDef s_profileFields[cb2_profileFieldCount] =
+{
+	{ "step", offsetof(cb2Profile, step), e_floatField },
+	{ "collide", offsetof(cb2Profile, collide), e_floatField },
+	{ "solve", offsetof(cb2Profile, solve), e_floatField },
+	{ "solveInit", offsetof(cb2Profile, solveInit), e_floatField },
+	{ "solveVelocity", offsetof(cb2Profile, solveVelocity), e_floatField },
+	{ "solvePosition", offsetof(cb2Profile, solvePosition), e_floatField },
+	{ "broadphase", offsetof(cb2Profile, broadphase), e_floatField },
+	{ "solveTOI", offsetof(cb2Profile, solveTOI), e_floatField },
+	{ "particles", offsetof(cb2Profile, particles), e_floatField },
+	{ "toiCompute", offsetof(cb2Profile, toiCompute), e_floatField },
+	{ "toiSolve", offsetof(cb2Profile, toiSolve), e_floatField },
+	{ "toiEventCount", offsetof(cb2Profile, toiEventCount), e_intField },
+	{ "toiCallCount", offsetof(cb2Profile, toiCallCount), e_intField },
+	{ "toiIterations", offsetof(cb2Profile, toiIterations), e_intField },
+	{ "toiRootIterations", offsetof(cb2Profile, toiRootIterations), e_intField },
+	{ "toiDeferred", offsetof(cb2Profile, toiDeferred), e_boolField },
+	{ "maxStackAllocation", offsetof(cb2Profile, maxStackAllocation), e_intField },
+	{ "velocityIterations", offsetof(cb2Profile, velocityIterations), e_intField },
+	{ "positionIterations", offsetof(cb2Profile, positionIterations), e_intField },
+	{ "maxVelocityIterations", offsetof(cb2Profile, maxVelocityIterations), e_intField },
+	{ "islandCount", offsetof(cb2Profile, islandCount), e_intField },
+	{ "islandContactCount", offsetof(cb2Profile, islandContactCount), e_intField },
+	{ "deferredIslands", offsetof(cb2Profile, deferredIslands), e_intField },
+	{ "maxSolveDebt", offsetof(cb2Profile, maxSolveDebt), e_floatField },
+	{ "jointsBroken", offsetof(cb2Profile, jointsBroken), e_intField },
+	{ "contactsCreated", offsetof(cb2Profile, contactsCreated), e_intField },
+	{ "contactsDestroyed", offsetof(cb2Profile, contactsDestroyed), e_intField },
+	{ "treeQueries", offsetof(cb2Profile, treeQueries), e_intField }
+};
+
+static float cb2GetProfileValue(const cb2Profile& profile, const cb2ProfileFieldDef& def)
+{
+	const char* p = (const char*)&profile + def.offset;
+	switch (def.type)
+	{
+	case e_floatField:
+		return *(const float*)p;
+
+	case e_intField:
+		return (float)*(const int*)p;
+
+	default:
+		return *(const bool*)p ? 1.0f : 0.0f;
+	}
+}
+
+// The value at a nearest rank percentile of sorted values.
+static float cb2GetPercentile(const float* values, int count, float percentile)
+{
+	int rank = (int)ceilf(percentile * count) - 1;
+	return values[cb2Clamp(rank, 0, count - 1)];
+}
+
+cb2ProfileStats::cb2ProfileStats()
+{
+	m_samples = NULL;
+	m_values = NULL;
+	m_capacity = 0;
+	m_count = 0;
+	m_next = 0;
+}
+
+cb2ProfileStats::~cb2ProfileStats()
+{
+	cb2Free(m_samples);
+	cb2Free(m_values);
+}
+
+void cb2ProfileStats::SetWindow(int stepCount)
+{
+	cb2Assert(stepCount >= 0);
+	cb2Free(m_samples);
+	cb2Free(m_values);
+	m_samples = NULL;
+	m_values = NULL;
+	m_capacity = stepCount;
+	if (m_capacity > 0)
+	{
+		m_samples = (cb2Profile*)cb2Alloc(m_capacity * sizeof(cb2Profile));
+		m_values = (float*)cb2Alloc(m_capacity * sizeof(float));
+	}
+	Clear();
+}
+
+void cb2ProfileStats::Add(const cb2Profile& profile)
+{
+	if (m_capacity == 0)
+	{
+		return;
+	}
+
+	m_samples[m_next] = profile;
+	m_next = m_next + 1 < m_capacity ? m_next + 1 : 0;
+	m_count = cb2Min(m_count + 1, m_capacity);
+}
+
+void cb2ProfileStats::Clear()
+{
+	m_count = 0;
+	m_next = 0;
+}
+
+cb2ProfileStat cb2ProfileStats::GetStat(cb2ProfileField field) const
+{
+	cb2Assert(0 <= field && field < cb2_profileFieldCount);
+
+	cb2ProfileStat stat;
+	stat.min = stat.max = stat.mean = 0.0f;
+	stat.p50 = stat.p95 = stat.p99 = 0.0f;
+	if (m_count == 0)
+	{
+		return stat;
+	}
+
+	// The order of the samples does not matter, the window holds the newest.
+	const cb2ProfileFieldDef& def = s_profileFields[field];
+	float sum = 0.0f;
+	for (int i = 0; i < m_count; ++i)
+	{
+		m_values[i] = cb2GetProfileValue(m_samples[i], def);
+		sum += m_values[i];
+	}
+
+	std::sort(m_values, m_values + m_count);
+	stat.min = m_values[0];
+	stat.max = m_values[m_count - 1];
+	stat.mean = sum / m_count;
+	stat.p50 = cb2GetPercentile(m_values, m_count, 0.50f);
+	stat.p95 = cb2GetPercentile(m_values, m_count, 0.95f);
+	stat.p99 = cb2GetPercentile(m_values, m_count, 0.99f);
+	return stat;
+}
+
+const char* cb2ProfileStats::GetFieldName(cb2ProfileField field)
+{
+	cb2Assert(0 <= field && field < cb2_profileFieldCount);
+	return s_profileFields[field].name;
+}
@@ -0,0 +1,107 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_PROFILE_STATS_H
+#define CB2_PROFILE_STATS_H
+
+#include <CinderBox2D/Dynamics/cb2TimeStep.h>
+
+/// The fields of cb2Profile, in declaration order.
+enum cb2ProfileField
+{
+	cb2_profileStep = 0,
+	cb2_profileCollide,
+	cb2_profileSolve,
+	cb2_profileSolveInit,
+	cb2_profileSolveVelocity,
+	cb2_profileSolvePosition,
+	cb2_profileBroadphase,
+	cb2_profileSolveTOI,
+	cb2_profileParticles,
+	cb2_profileTOICompute,
+	cb2_profileTOISolve,
+	cb2_profileTOIEventCount,
+	cb2_profileTOICallCount,
+	cb2_profileTOIIterations,
+	cb2_profileTOIRootIterations,
+	cb2_profileTOIDeferred,
+	cb2_profileMaxStackAllocation,
+	cb2_profileVelocityIterations,
+	cb2_profilePositionIterations,
+	cb2_profileMaxVelocityIterations,
+	cb2_profileIslandCount,
+	cb2_profileIslandContactCount,
+	cb2_profileDeferredIslands,
+	cb2_profileMaxSolveDebt,
+	cb2_profileJointsBroken,
+	cb2_profileContactsCreated,
+	cb2_profileContactsDestroyed,
+	cb2_profileTreeQueries,
+	cb2_profileFieldCount
+};
+
+/// Statistics of one profile field over the window. Percentiles use the nearest rank.
+struct cb2ProfileStat
+{
+	float min;
+	float max;
+	float mean;
+	float p50;
+	float p95;
+	float p99;
+};
+
+/// Keeps the profiles of the last steps in a ring so statistics can be computed
+/// over a rolling window. Adding a step is a copy, the statistics are computed
+/// when they are queried.
+class cb2ProfileStats
+{
+public:
+	cb2ProfileStats();
+	~cb2ProfileStats();
+
+	/// Set the number of steps kept. Zero disables the collector. This clears the samples.
+	void SetWindow(int stepCount);
+	int GetWindow() const { return m_capacity; }
+
+	/// Add the profile of a step, replacing the oldest once the window is full.
+	void Add(const cb2Profile& profile);
+
+	/// Drop all samples.
+	void Clear();
+
+	/// Get the number of samples in the window.
+	int GetSampleCount() const { return m_count; }
+
+	/// Compute the statistics of a field. All values are zero without samples.
+	/// This uses a scratch buffer, so do not call it concurrently.
+	cb2ProfileStat GetStat(cb2ProfileField field) const;
+
+	/// Get the name of a field, as in cb2Profile.
+	static const char* GetFieldName(cb2ProfileField field);
+
+private:
+
+	cb2Profile* m_samples;
+	float* m_values;
+	int m_capacity;
+	int m_count;
+	int m_next;
+};
+
+#endif
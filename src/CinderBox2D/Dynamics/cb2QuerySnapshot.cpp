@@ -0,0 +1,125 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2QuerySnapshot.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
+#include <CinderBox2D/Dynamics/cb2WorldCallbacks.h>
+
+cb2QuerySnapshot::cb2QuerySnapshot()
+{
+	m_proxies = NULL;
+	m_proxyCapacity = 0;
+	m_stepCount = 0;
+	m_readerCount = 0;
+}
+
+cb2QuerySnapshot::~cb2QuerySnapshot()
+{
+	cb2Free(m_proxies);
+}
+
+void cb2QuerySnapshot::Capture(const cb2World* world, int stepCount)
+{
+	const cb2BroadPhase& broadPhase = world->GetContactManager().m_broadPhase;
+	m_broadPhase.CopyTrees(broadPhase);
+	m_stepCount = stepCount;
+
+	int proxyCount = broadPhase.GetProxyCount();
+	if (m_proxyCapacity < proxyCount)
+	{
+		cb2Free(m_proxies);
+		m_proxyCapacity = cb2Max(proxyCount, 2 * m_proxyCapacity);
+		m_proxies = (cb2SnapshotProxy*)cb2Alloc(m_proxyCapacity * sizeof(cb2SnapshotProxy));
+	}
+
+	// Point the copied proxies at frozen fixture state instead of the live fixture proxies.
+	int count = 0;
+	for (const cb2Body* b = world->GetBodyList(); b; b = b->GetNext())
+	{
+		const cb2Transform& xf = b->GetTransform();
+		for (const cb2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+		{
+			for (int i = 0; i < f->m_proxyCount; ++i)
+			{
+				cb2Assert(count < proxyCount);
+				cb2SnapshotProxy* proxy = m_proxies + count;
+				proxy->fixture = (cb2Fixture*)f;
+				proxy->shape = f->GetShape();
+				proxy->xf = xf;
+				proxy->childIndex = f->m_proxies[i].childIndex;
+				m_broadPhase.SetUserData(f->m_proxies[i].proxyId, proxy);
+				++count;
+			}
+		}
+	}
+}
+
+struct cb2SnapshotQueryWrapper
+{
+	bool QueryCallback(int proxyId)
+	{
+		return callback->ReportFixture(snapshot->GetProxy(proxyId)->fixture);
+	}
+
+	const cb2QuerySnapshot* snapshot;
+	cb2QueryCallback* callback;
+};
+
+void cb2QuerySnapshot::QueryAABB(cb2QueryCallback* callback, const cb2AABB& aabb) const
+{
+	cb2SnapshotQueryWrapper wrapper;
+	wrapper.snapshot = this;
+	wrapper.callback = callback;
+	m_broadPhase.Query(&wrapper, aabb);
+}
+
+struct cb2SnapshotRayCastWrapper
+{
+	float RayCastCallback(const cb2RayCastInput& input, int proxyId)
+	{
+		const cb2SnapshotProxy* proxy = snapshot->GetProxy(proxyId);
+		cb2RayCastOutput output;
+		bool hit = proxy->shape->RayCast(&output, input, proxy->xf, proxy->childIndex);
+
+		if (hit)
+		{
+			float fraction = output.fraction;
+			ci::Vec2f point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+			return callback->ReportFixture(proxy->fixture, point, output.normal, fraction);
+		}
+
+		return input.maxFraction;
+	}
+
+	const cb2QuerySnapshot* snapshot;
+	cb2RayCastCallback* callback;
+};
+
+void cb2QuerySnapshot::RayCast(cb2RayCastCallback* callback, const ci::Vec2f& point1, const ci::Vec2f& point2) const
+{
+	cb2SnapshotRayCastWrapper wrapper;
+	wrapper.snapshot = this;
+	wrapper.callback = callback;
+	cb2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+	m_broadPhase.RayCast(&wrapper, input);
+}
@@ -0,0 +1,87 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_QUERY_SNAPSHOT_H
+#define CB2_QUERY_SNAPSHOT_H
+
+#include <CinderBox2D/Collision/cb2BroadPhase.h>
+#include <atomic>
+
+class cb2Fixture;
+class cb2QueryCallback;
+class cb2RayCastCallback;
+class cb2Shape;
+class cb2World;
+
+/// The state of one fixture proxy frozen in a snapshot.
+struct cb2SnapshotProxy
+{
+	cb2Fixture* fixture;
+	const cb2Shape* shape;
+	cb2Transform xf;
+	int childIndex;
+};
+
+/// A frozen, read-only copy of the broad-phase trees and fixture transforms of a world.
+/// Queries and ray casts of a snapshot can run on any thread while the world steps,
+/// because they never touch the live tree or bodies. Shapes are shared with the world,
+/// so fixtures must not be destroyed while a snapshot is in use. Reported fixtures are
+/// handles: their user data can be read, but their bodies may be changing.
+/// Get snapshots from cb2World::AcquireQuerySnapshot.
+class cb2QuerySnapshot
+{
+public:
+
+	/// Query the snapshot for all fixtures that potentially overlap the provided AABB.
+	void QueryAABB(cb2QueryCallback* callback, const cb2AABB& aabb) const;
+
+	/// Ray-cast the snapshot for all fixtures in the path of the ray. The fixtures
+	/// are tested at their transforms when the snapshot was taken.
+	void RayCast(cb2RayCastCallback* callback, const ci::Vec2f& point1, const ci::Vec2f& point2) const;
+
+	/// Get the frozen state of a proxy reported by the broad-phase of this snapshot.
+	const cb2SnapshotProxy* GetProxy(int proxyId) const;
+
+	/// Get the step count of the world when the snapshot was taken.
+	int GetStepCount() const { return m_stepCount; }
+
+private:
+
+	friend class cb2World;
+
+	cb2QuerySnapshot();
+	~cb2QuerySnapshot();
+
+	void Capture(const cb2World* world, int stepCount);
+
+	cb2BroadPhase m_broadPhase;
+
+	cb2SnapshotProxy* m_proxies;
+	int m_proxyCapacity;
+
+	int m_stepCount;
+
+	mutable std::atomic<int> m_readerCount;
+};
+
+inline const cb2SnapshotProxy* cb2QuerySnapshot::GetProxy(int proxyId) const
+{
+	return (const cb2SnapshotProxy*)m_broadPhase.GetUserData(proxyId);
+}
+
+#endif
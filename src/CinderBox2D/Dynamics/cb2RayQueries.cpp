@@ -0,0 +1,107 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2RayQueries.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
+#include <string.h>
+
+cb2RayQueries::cb2RayQueries()
+{
+	m_queries = NULL;
+	m_capacity = 0;
+	m_count = 0;
+	m_freeList = -1;
+}
+
+cb2RayQueries::~cb2RayQueries()
+{
+	cb2Free(m_queries);
+}
+
+int cb2RayQueries::Create()
+{
+	if (m_freeList == -1)
+	{
+		int capacity = cb2Max(2 * m_capacity, 16);
+		cb2RayQuery* old = m_queries;
+		m_queries = (cb2RayQuery*)cb2Alloc(capacity * sizeof(cb2RayQuery));
+		if (old)
+		{
+			memcpy(m_queries, old, m_capacity * sizeof(cb2RayQuery));
+			cb2Free(old);
+		}
+
+		// Thread the new slots onto the free list in order.
+		for (int i = capacity - 1; i >= m_capacity; --i)
+		{
+			m_queries[i].fixture = NULL;
+			m_queries[i].next = m_freeList;
+			m_freeList = i;
+		}
+		m_capacity = capacity;
+	}
+
+	int index = m_freeList;
+	cb2RayQuery* query = m_queries + index;
+	m_freeList = query->next;
+
+	query->fixture = NULL;
+	query->childIndex = 0;
+	query->next = e_used;
+	++m_count;
+	return index;
+}
+
+void cb2RayQueries::Destroy(int index)
+{
+	cb2Assert(0 <= index && index < m_capacity && m_queries[index].next == e_used);
+	cb2RayQuery* query = m_queries + index;
+	query->fixture = NULL;
+	query->next = m_freeList;
+	m_freeList = index;
+	--m_count;
+}
+
+void cb2RayQueries::RemoveFixture(cb2Fixture* fixture)
+{
+	for (int i = 0; i < m_capacity; ++i)
+	{
+		if (m_queries[i].fixture == fixture)
+		{
+			m_queries[i].fixture = NULL;
+		}
+	}
+}
+
+void cb2RayQueries::Copy(const cb2RayQueries& other, const cb2CloneMap& map)
+{
+	cb2Free(m_queries);
+	m_queries = NULL;
+	if (other.m_capacity > 0)
+	{
+		m_queries = (cb2RayQuery*)cb2Alloc(other.m_capacity * sizeof(cb2RayQuery));
+		memcpy(m_queries, other.m_queries, other.m_capacity * sizeof(cb2RayQuery));
+	}
+	for (int i = 0; i < other.m_capacity; ++i)
+	{
+		m_queries[i].fixture = map.Find(other.m_queries[i].fixture);
+	}
+	m_capacity = other.m_capacity;
+	m_count = other.m_count;
+	m_freeList = other.m_freeList;
+}
@@ -0,0 +1,73 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_RAY_QUERIES_H
+#define CB2_RAY_QUERIES_H
+
+#include <CinderBox2D/Common/cb2Math.h>
+
+class cb2CloneMap;
+class cb2Fixture;
+
+/// The fixture a persistent ray hit last time it was cast.
+struct cb2RayQuery
+{
+	cb2Fixture* fixture;		///< NULL when the last cast missed
+	int childIndex;
+	int next;					///< the next free slot, or -2 while in use
+};
+
+/// The persistent rays of a world, see cb2World::CreateRayQuery. The slots are reused,
+/// so a ray is known by its slot. The fixture of a slot is forgotten when it is destroyed.
+class cb2RayQueries
+{
+public:
+	cb2RayQueries();
+	~cb2RayQueries();
+
+	int Create();
+	void Destroy(int query);
+
+	cb2RayQuery& GetQuery(int query)
+	{
+		cb2Assert(0 <= query && query < m_capacity && m_queries[query].next == e_used);
+		return m_queries[query];
+	}
+
+	int GetCount() const { return m_count; }
+
+	/// Forget a fixture that is about to be destroyed. This scans all slots.
+	void RemoveFixture(cb2Fixture* fixture);
+
+	/// Copy the rays of another world, keeping the slots.
+	void Copy(const cb2RayQueries& other, const cb2CloneMap& map);
+
+private:
+
+	enum
+	{
+		e_used = -2
+	};
+
+	cb2RayQuery* m_queries;
+	int m_capacity;
+	int m_count;
+	int m_freeList;
+};
+
+#endif
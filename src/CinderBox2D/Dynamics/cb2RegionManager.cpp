@@ -0,0 +1,706 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Dynamics/cb2RegionManager.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2HeightfieldShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CompoundShape.h>
+#include <new>
+#include <math.h>
+#include <string.h>
+
+// The data of a cell is a run of body records. Each record is the body state, its mass
+// data and its fixtures with their shapes.
+
+enum
+{
+	cb2_regionAwake			= 0x01,
+	cb2_regionAllowSleep	= 0x02,
+	cb2_regionFixedRotation	= 0x04,
+	cb2_regionBullet		= 0x08,
+	cb2_regionActive		= 0x10
+};
+
+// Chains, heightfields and compounds longer than this are taken as damaged data.
+const int cb2_regionMaxChainVertices = 1 << 20;
+
+// The derived data of a polygon is saved too, so nothing is computed again.
+static void cb2WritePolygon(cb2SnapshotWriter* writer, const cb2PolygonShape* polygon)
+{
+	writer->Write(polygon->m_count);
+	writer->Write(polygon->m_centroid);
+	writer->WriteBytes(polygon->m_vertices, polygon->m_count * sizeof(ci::Vec2f));
+	writer->WriteBytes(polygon->m_normals, polygon->m_count * sizeof(ci::Vec2f));
+}
+
+static void cb2WriteShape(cb2SnapshotWriter* writer, const cb2Shape* shape)
+{
+	writer->Write((unsigned char)shape->m_type);
+	writer->Write(shape->m_radius);
+
+	switch (shape->m_type)
+	{
+	case cb2Shape::e_circle:
+		{
+			const cb2CircleShape* circle = (const cb2CircleShape*)shape;
+			writer->Write(circle->m_p);
+		}
+		break;
+
+	case cb2Shape::e_edge:
+		{
+			const cb2EdgeShape* edge = (const cb2EdgeShape*)shape;
+			writer->Write(edge->m_vertex0);
+			writer->Write(edge->m_vertex1);
+			writer->Write(edge->m_vertex2);
+			writer->Write(edge->m_vertex3);
+			writer->Write(edge->m_hasVertex0);
+			writer->Write(edge->m_hasVertex3);
+		}
+		break;
+
+	case cb2Shape::e_capsule:
+		{
+			const cb2CapsuleShape* capsule = (const cb2CapsuleShape*)shape;
+			writer->Write(capsule->m_vertex1);
+			writer->Write(capsule->m_vertex2);
+		}
+		break;
+
+	case cb2Shape::e_polygon:
+		cb2WritePolygon(writer, (const cb2PolygonShape*)shape);
+		break;
+
+	case cb2Shape::e_chain:
+		{
+			// Chains of an attached level are saved with a copy of their vertices.
+			const cb2ChainShape* chain = (const cb2ChainShape*)shape;
+			writer->Write(chain->m_count);
+			writer->WriteBytes(chain->m_vertices, chain->m_count * sizeof(ci::Vec2f));
+			writer->Write(chain->m_prevVertex);
+			writer->Write(chain->m_nextVertex);
+			writer->Write(chain->m_hasPrevVertex);
+			writer->Write(chain->m_hasNextVertex);
+		}
+		break;
+
+	case cb2Shape::e_heightfield:
+		{
+			const cb2HeightfieldShape* heightfield = (const cb2HeightfieldShape*)shape;
+			writer->Write(heightfield->m_count);
+			writer->Write(heightfield->m_spacing);
+			writer->WriteBytes(heightfield->m_heights, heightfield->m_count * sizeof(float));
+		}
+		break;
+
+	case cb2Shape::e_compound:
+		{
+			const cb2CompoundShape* compound = (const cb2CompoundShape*)shape;
+			writer->Write(compound->m_count);
+			for (int i = 0; i < compound->m_count; ++i)
+			{
+				cb2WritePolygon(writer, compound->GetChild(i));
+			}
+		}
+		break;
+
+	default:
+		cb2Assert(false);
+		break;
+	}
+}
+
+static void cb2WriteBody(cb2SnapshotWriter* writer, const cb2Body* body, const ci::Vec2f& corner)
+{
+	unsigned char flags = 0;
+	flags |= body->IsAwake() ? cb2_regionAwake : 0;
+	flags |= body->IsSleepingAllowed() ? cb2_regionAllowSleep : 0;
+	flags |= body->IsFixedRotation() ? cb2_regionFixedRotation : 0;
+	flags |= body->IsBullet() ? cb2_regionBullet : 0;
+	flags |= body->IsActive() ? cb2_regionActive : 0;
+
+	writer->Write((unsigned char)body->GetType());
+	writer->Write(flags);
+	writer->Write(body->GetPosition() - corner);
+	writer->Write(body->GetAngle());
+	writer->Write(body->GetLinearVelocity());
+	writer->Write(body->GetAngularVelocity());
+	writer->Write(body->GetLinearDamping());
+	writer->Write(body->GetAngularDamping());
+	writer->Write(body->GetGravityScale());
+	writer->Write(body->GetUserData());
+
+	// A mass set by SetMassData is kept.
+	cb2MassData massData;
+	body->GetMassData(&massData);
+	writer->Write(massData.mass);
+	writer->Write(massData.center);
+	writer->Write(massData.I);
+
+	int fixtureCount = 0;
+	for (const cb2Fixture* f = body->GetFixtureList(); f; f = f->GetNext())
+	{
+		++fixtureCount;
+	}
+	writer->Write(fixtureCount);
+
+	for (const cb2Fixture* f = body->GetFixtureList(); f; f = f->GetNext())
+	{
+		const cb2Filter& filter = f->GetFilterData();
+		writer->Write(f->GetFriction());
+		writer->Write(f->GetRestitution());
+		writer->Write(f->GetMaterial());
+		writer->Write(f->GetDensity());
+		writer->Write(f->IsSensor());
+		writer->Write(f->GetReportPostSolve());
+		writer->Write(filter.categoryBits);
+		writer->Write(filter.maskBits);
+		writer->Write(filter.groupIndex);
+		writer->Write(filter.layer);
+		writer->Write(f->GetUserData());
+		cb2WriteShape(writer, f->GetShape());
+	}
+}
+
+// Returns false for damaged data.
+static bool cb2ReadPolygon(cb2SnapshotReader* reader, cb2PolygonShape* polygon)
+{
+	reader->Read(&polygon->m_count);
+	if (polygon->m_count < 3 || polygon->m_count > cb2_maxPolygonVertices)
+	{
+		reader->SetFailed();
+		return false;
+	}
+	reader->Read(&polygon->m_centroid);
+	reader->ReadBytes(polygon->m_vertices, polygon->m_count * sizeof(ci::Vec2f));
+	reader->ReadBytes(polygon->m_normals, polygon->m_count * sizeof(ci::Vec2f));
+	return reader->HasFailed() == false;
+}
+
+// Read a shape into the storage for its type. Returns NULL for damaged data. The
+// vertices of a chain, the heights of a heightfield or the pieces of a compound are
+// read into samples, which the caller frees.
+static const cb2Shape* cb2ReadShape(cb2SnapshotReader* reader, cb2CircleShape* circle, cb2EdgeShape* edge,
+									cb2PolygonShape* polygon, cb2CapsuleShape* capsule, cb2ChainShape* chain,
+									cb2HeightfieldShape* heightfield, cb2CompoundShape* compound, void** samples)
+{
+	unsigned char type = reader->Read<unsigned char>();
+	float radius = reader->Read<float>();
+
+	switch (type)
+	{
+	case cb2Shape::e_circle:
+		circle->m_radius = radius;
+		reader->Read(&circle->m_p);
+		return reader->HasFailed() ? NULL : circle;
+
+	case cb2Shape::e_edge:
+		edge->m_radius = radius;
+		reader->Read(&edge->m_vertex0);
+		reader->Read(&edge->m_vertex1);
+		reader->Read(&edge->m_vertex2);
+		reader->Read(&edge->m_vertex3);
+		reader->Read(&edge->m_hasVertex0);
+		reader->Read(&edge->m_hasVertex3);
+		return reader->HasFailed() ? NULL : edge;
+
+	case cb2Shape::e_capsule:
+		capsule->m_radius = radius;
+		reader->Read(&capsule->m_vertex1);
+		reader->Read(&capsule->m_vertex2);
+		return reader->HasFailed() ? NULL : capsule;
+
+	case cb2Shape::e_polygon:
+		polygon->m_radius = radius;
+		return cb2ReadPolygon(reader, polygon) ? polygon : NULL;
+
+	case cb2Shape::e_chain:
+		{
+			int count = reader->Read<int>();
+			if (count < 2 || count > cb2_regionMaxChainVertices)
+			{
+				reader->SetFailed();
+				return NULL;
+			}
+
+			ci::Vec2f* vertices = (ci::Vec2f*)cb2Alloc(count * sizeof(ci::Vec2f));
+			*samples = vertices;
+			reader->ReadBytes(vertices, count * sizeof(ci::Vec2f));
+			ci::Vec2f prevVertex = reader->Read<ci::Vec2f>();
+			ci::Vec2f nextVertex = reader->Read<ci::Vec2f>();
+			bool hasPrevVertex = reader->Read<bool>();
+			bool hasNextVertex = reader->Read<bool>();
+			if (reader->HasFailed() || chain == NULL)
+			{
+				return reader->HasFailed() ? NULL : chain;
+			}
+
+			chain->CreateChain(vertices, count);
+			chain->m_radius = radius;
+			if (hasPrevVertex)
+			{
+				chain->SetPrevVertex(prevVertex);
+			}
+			if (hasNextVertex)
+			{
+				chain->SetNextVertex(nextVertex);
+			}
+			return chain;
+		}
+
+	case cb2Shape::e_heightfield:
+		{
+			int count = reader->Read<int>();
+			float spacing = reader->Read<float>();
+			if (count < 2 || count > cb2_regionMaxChainVertices || (spacing > cb2_linearSlop) == false)
+			{
+				reader->SetFailed();
+				return NULL;
+			}
+
+			float* heights = (float*)cb2Alloc(count * sizeof(float));
+			*samples = heights;
+			reader->ReadBytes(heights, count * sizeof(float));
+			if (reader->HasFailed() || heightfield == NULL)
+			{
+				return reader->HasFailed() ? NULL : heightfield;
+			}
+
+			heightfield->Create(heights, count, spacing);
+			heightfield->m_radius = radius;
+			return heightfield;
+		}
+
+	case cb2Shape::e_compound:
+		{
+			int count = reader->Read<int>();
+			if (count < 1 || count > cb2_regionMaxChainVertices)
+			{
+				reader->SetFailed();
+				return NULL;
+			}
+
+			cb2PolygonShape* pieces = (cb2PolygonShape*)cb2Alloc(count * sizeof(cb2PolygonShape));
+			*samples = pieces;
+			for (int i = 0; i < count; ++i)
+			{
+				new (pieces + i) cb2PolygonShape;
+				if (cb2ReadPolygon(reader, pieces + i) == false)
+				{
+					return NULL;
+				}
+			}
+
+			if (compound == NULL)
+			{
+				return compound;
+			}
+
+			compound->m_radius = radius;
+			compound->Create(pieces, count);
+			return compound;
+		}
+
+	default:
+		reader->SetFailed();
+		return NULL;
+	}
+}
+
+// Read a body record. With no world the record is only checked. Returns false for damaged data.
+static bool cb2ReadBody(cb2SnapshotReader* reader, cb2World* world, const ci::Vec2f& corner, cb2Body** body)
+{
+	cb2BodyDef bd;
+	unsigned char type = reader->Read<unsigned char>();
+	unsigned char flags = reader->Read<unsigned char>();
+	bd.position = corner + reader->Read<ci::Vec2f>();
+	reader->Read(&bd.angle);
+	reader->Read(&bd.linearVelocity);
+	reader->Read(&bd.angularVelocity);
+	reader->Read(&bd.linearDamping);
+	reader->Read(&bd.angularDamping);
+	reader->Read(&bd.gravityScale);
+	reader->Read(&bd.userData);
+
+	cb2MassData massData;
+	reader->Read(&massData.mass);
+	reader->Read(&massData.center);
+	reader->Read(&massData.I);
+
+	int fixtureCount = reader->Read<int>();
+	if (reader->HasFailed() || type > cb2_dynamicBody || fixtureCount < 0)
+	{
+		reader->SetFailed();
+		return false;
+	}
+
+	bd.type = (cb2BodyType)type;
+	bd.awake = (flags & cb2_regionAwake) != 0;
+	bd.allowSleep = (flags & cb2_regionAllowSleep) != 0;
+	bd.fixedRotation = (flags & cb2_regionFixedRotation) != 0;
+	bd.bullet = (flags & cb2_regionBullet) != 0;
+	bd.active = (flags & cb2_regionActive) != 0;
+
+	cb2Body* b = world ? world->CreateBody(&bd) : NULL;
+	if (b)
+	{
+		b->BeginFixtureEdit();
+	}
+
+	for (int i = 0; i < fixtureCount; ++i)
+	{
+		cb2FixtureDef fd;
+		reader->Read(&fd.friction);
+		reader->Read(&fd.restitution);
+		reader->Read(&fd.material);
+		reader->Read(&fd.density);
+		reader->Read(&fd.isSensor);
+		reader->Read(&fd.reportPostSolve);
+		reader->Read(&fd.filter.categoryBits);
+		reader->Read(&fd.filter.maskBits);
+		reader->Read(&fd.filter.groupIndex);
+		reader->Read(&fd.filter.layer);
+		reader->Read(&fd.userData);
+		if (fd.filter.layer < 0 || fd.filter.layer >= cb2_maxLayers || fd.material < -1 || fd.material >= cb2_maxMaterials)
+		{
+			reader->SetFailed();
+		}
+
+		cb2CircleShape circle;
+		cb2EdgeShape edge;
+		cb2PolygonShape polygon;
+		cb2CapsuleShape capsule;
+		cb2ChainShape chain;
+		cb2HeightfieldShape heightfield;
+		cb2CompoundShape compound;
+		void* samples = NULL;
+		fd.shape = reader->HasFailed() ? NULL : cb2ReadShape(reader, &circle, &edge, &polygon, &capsule,
+															 b ? &chain : NULL, b ? &heightfield : NULL,
+															 b ? &compound : NULL, &samples);
+		if (b && fd.shape)
+		{
+			b->CreateFixture(&fd);
+		}
+		cb2Free(samples);
+
+		if (reader->HasFailed())
+		{
+			break;
+		}
+	}
+
+	if (reader->HasFailed())
+	{
+		if (b)
+		{
+			world->DestroyBody(b);
+		}
+		return false;
+	}
+
+	if (b && bd.type == cb2_dynamicBody)
+	{
+		b->SetMassData(&massData);
+	}
+
+	if (b)
+	{
+		b->EndFixtureEdit();
+	}
+
+	*body = b;
+	return true;
+}
+
+cb2RegionManager::cb2RegionManager(cb2World* world, float cellSize)
+{
+	cb2Assert(cellSize > 0.0f);
+	m_world = world;
+	m_listener = NULL;
+	m_cellSize = cellSize;
+	m_lowerX = 0;
+	m_lowerY = 0;
+	m_upperX = -1;
+	m_upperY = -1;
+	m_hasActiveArea = false;
+	m_cellCount = 0;
+	m_cellCapacity = 0;
+	m_cells = NULL;
+}
+
+cb2RegionManager::~cb2RegionManager()
+{
+	for (int i = 0; i < m_cellCount; ++i)
+	{
+		cb2Free(m_cells[i].data);
+	}
+	cb2Free(m_cells);
+}
+
+void cb2RegionManager::GetCell(const ci::Vec2f& point, int* x, int* y) const
+{
+	ci::Vec2d p = m_world->ToGlobal(point);
+	*x = (int)floor(p.x / m_cellSize);
+	*y = (int)floor(p.y / m_cellSize);
+}
+
+ci::Vec2f cb2RegionManager::GetCellCorner(int x, int y) const
+{
+	return m_world->ToLocal(ci::Vec2d((double)x * m_cellSize, (double)y * m_cellSize));
+}
+
+bool cb2RegionManager::IsCellActive(int x, int y) const
+{
+	return m_lowerX <= x && x <= m_upperX && m_lowerY <= y && y <= m_upperY;
+}
+
+void cb2RegionManager::ShiftOrigin(int cellX, int cellY)
+{
+	m_world->ShiftOrigin(ci::Vec2f(cellX * m_cellSize, cellY * m_cellSize));
+}
+
+void cb2RegionManager::SetActiveArea(const cb2AABB& area)
+{
+	cb2Assert(m_world->IsLocked() == false);
+	if (m_world->IsLocked())
+	{
+		return;
+	}
+
+	GetCell(area.lowerBound, &m_lowerX, &m_lowerY);
+	GetCell(area.upperBound, &m_upperX, &m_upperY);
+	m_hasActiveArea = true;
+
+	// Save the bodies that are now outside.
+	cb2Body* b = m_world->GetBodyList();
+	while (b)
+	{
+		cb2Body* next = b->GetNext();
+
+		int x, y;
+		GetCell(b->GetPosition(), &x, &y);
+		if (IsCellActive(x, y) == false && b->GetJointList() == NULL &&
+			(m_listener == NULL || m_listener->ShouldStreamOut(b)))
+		{
+			StreamOut(b, x, y);
+		}
+
+		b = next;
+	}
+
+	// Bring back the saved bodies of the active cells.
+	for (int x = m_lowerX; x <= m_upperX; ++x)
+	{
+		int index = FindCell(x, m_lowerY);
+		while (index < m_cellCount && m_cells[index].x == x && m_cells[index].y <= m_upperY)
+		{
+			StreamIn(index);
+		}
+	}
+}
+
+void cb2RegionManager::StreamOut(cb2Body* body, int x, int y)
+{
+	if (m_listener)
+	{
+		m_listener->BodyStreamedOut(body);
+	}
+
+	ci::Vec2f corner = GetCellCorner(x, y);
+	cb2SnapshotWriter measure(NULL, 0);
+	cb2WriteBody(&measure, body, corner);
+
+	cb2RegionCell* cell = GetOrAddCell(x, y);
+	int size = cell->size + measure.GetSize();
+	if (size > cell->capacity)
+	{
+		char* oldData = cell->data;
+		cell->capacity = cb2Max(2 * cell->capacity, size);
+		cell->data = (char*)cb2Alloc(cell->capacity);
+		if (oldData)
+		{
+			memcpy(cell->data, oldData, cell->size);
+			cb2Free(oldData);
+		}
+	}
+
+	cb2SnapshotWriter writer(cell->data + cell->size, cell->capacity - cell->size);
+	cb2WriteBody(&writer, body, corner);
+	cb2Assert(writer.IsComplete());
+	cell->size = size;
+
+	m_world->DestroyBody(body);
+}
+
+void cb2RegionManager::StreamIn(int index)
+{
+	// The cell is removed first, so the next cell of the column takes its index.
+	cb2RegionCell cell = m_cells[index];
+	RemoveCell(index);
+
+	ci::Vec2f corner = GetCellCorner(cell.x, cell.y);
+	cb2SnapshotReader reader(cell.data, cell.size);
+	while (reader.GetOffset() < cell.size)
+	{
+		cb2Body* body = NULL;
+		if (cb2ReadBody(&reader, m_world, corner, &body) == false)
+		{
+			// The data was checked when it was given, so this is not expected.
+			cb2Assert(false);
+			break;
+		}
+
+		if (m_listener)
+		{
+			m_listener->BodyStreamedIn(body);
+		}
+	}
+
+	cb2Free(cell.data);
+}
+
+const void* cb2RegionManager::GetCellData(int x, int y, int* size) const
+{
+	int index = FindCell(x, y);
+	if (index == m_cellCount || m_cells[index].x != x || m_cells[index].y != y)
+	{
+		*size = 0;
+		return NULL;
+	}
+
+	*size = m_cells[index].size;
+	return m_cells[index].data;
+}
+
+bool cb2RegionManager::SetCellData(int x, int y, const void* data, int size)
+{
+	if (m_hasActiveArea && IsCellActive(x, y))
+	{
+		return false;
+	}
+
+	// Check the records before taking them.
+	cb2SnapshotReader reader(data, size);
+	while (reader.GetOffset() < size)
+	{
+		cb2Body* body = NULL;
+		if (cb2ReadBody(&reader, NULL, ci::Vec2f(0.0f, 0.0f), &body) == false)
+		{
+			return false;
+		}
+	}
+
+	ReleaseCellData(x, y);
+	if (size == 0)
+	{
+		return true;
+	}
+
+	cb2RegionCell* cell = GetOrAddCell(x, y);
+	cell->data = (char*)cb2Alloc(size);
+	cell->size = size;
+	cell->capacity = size;
+	memcpy(cell->data, data, size);
+	return true;
+}
+
+void cb2RegionManager::ReleaseCellData(int x, int y)
+{
+	int index = FindCell(x, y);
+	if (index < m_cellCount && m_cells[index].x == x && m_cells[index].y == y)
+	{
+		cb2Free(m_cells[index].data);
+		RemoveCell(index);
+	}
+}
+
+int cb2RegionManager::GetStoredSize() const
+{
+	int size = 0;
+	for (int i = 0; i < m_cellCount; ++i)
+	{
+		size += m_cells[i].size;
+	}
+	return size;
+}
+
+// Get the index of the first cell that is not before (x, y).
+int cb2RegionManager::FindCell(int x, int y) const
+{
+	int low = 0;
+	int high = m_cellCount;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		const cb2RegionCell* cell = m_cells + mid;
+		if (cell->x < x || (cell->x == x && cell->y < y))
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+cb2RegionManager::cb2RegionCell* cb2RegionManager::GetOrAddCell(int x, int y)
+{
+	int index = FindCell(x, y);
+	if (index < m_cellCount && m_cells[index].x == x && m_cells[index].y == y)
+	{
+		return m_cells + index;
+	}
+
+	if (m_cellCount == m_cellCapacity)
+	{
+		cb2RegionCell* oldCells = m_cells;
+		m_cellCapacity = cb2Max(2 * m_cellCapacity, 16);
+		m_cells = (cb2RegionCell*)cb2Alloc(m_cellCapacity * sizeof(cb2RegionCell));
+		if (oldCells)
+		{
+			memcpy(m_cells, oldCells, m_cellCount * sizeof(cb2RegionCell));
+			cb2Free(oldCells);
+		}
+	}
+
+	memmove(m_cells + index + 1, m_cells + index, (m_cellCount - index) * sizeof(cb2RegionCell));
+	++m_cellCount;
+
+	cb2RegionCell* cell = m_cells + index;
+	cell->x = x;
+	cell->y = y;
+	cell->data = NULL;
+	cell->size = 0;
+	cell->capacity = 0;
+	return cell;
+}
+
+void cb2RegionManager::RemoveCell(int index)
+{
+	memmove(m_cells + index, m_cells + index + 1, (m_cellCount - index - 1) * sizeof(cb2RegionCell));
+	--m_cellCount;
+}
@@ -0,0 +1,130 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_REGION_MANAGER_H
+#define CB2_REGION_MANAGER_H
+
+#include <CinderBox2D/Collision/cb2Collision.h>
+
+class cb2Body;
+class cb2World;
+
+/// Implement this class to choose the bodies that are streamed and to be told when
+/// they leave and enter the world.
+class cb2RegionListener
+{
+public:
+	virtual ~cb2RegionListener() {}
+
+	/// Return false to keep a body in the world when it is outside the active area.
+	virtual bool ShouldStreamOut(cb2Body* body) { CB2_NOT_USED(body); return true; }
+
+	/// Called before a body is saved and destroyed. Drop your references to it here.
+	virtual void BodyStreamedOut(cb2Body* body) { CB2_NOT_USED(body); }
+
+	/// Called after a body was created again from the data of its cell.
+	virtual void BodyStreamedIn(cb2Body* body) { CB2_NOT_USED(body); }
+};
+
+/// Splits the plane into square cells and keeps only the bodies of the active cells
+/// in the world, so the cost of a step and of ShiftOrigin follows the active area
+/// instead of the size of the map. The bodies of the other cells are saved into the
+/// data of their cell with the snapshot writer and destroyed, and are created again
+/// when their cell becomes active. A body belongs to the cell that holds its origin
+/// when it leaves the active area, so bodies that move across a border are moved to the
+/// cell they end up in. Bodies with joints are never streamed out. Positions are saved
+/// relative to their cell, so the data of a cell does not depend on the world origin.
+/// Body and fixture user data are saved as is.
+class cb2RegionManager
+{
+public:
+	/// The world must outlive the manager.
+	cb2RegionManager(cb2World* world, float cellSize);
+	~cb2RegionManager();
+
+	/// Register a listener. The listener is owned by you and must remain in scope.
+	void SetListener(cb2RegionListener* listener) { m_listener = listener; }
+
+	/// Make the cells overlapping this box active. The bodies outside are streamed out
+	/// and the saved bodies of the cells that became active are streamed in.
+	/// @warning this should be called outside of a time step.
+	void SetActiveArea(const cb2AABB& area);
+
+	/// Is a cell in the active area?
+	bool IsCellActive(int x, int y) const;
+
+	/// Get the cell that holds a point given in world coordinates.
+	void GetCell(const ci::Vec2f& point, int* x, int* y) const;
+
+	/// Shift the world origin by whole cells, see cb2World::ShiftOrigin. The cells keep
+	/// their coordinates, so an origin kept near the active area keeps positions precise
+	/// however far the area is from the first origin. The cells follow the origin of the
+	/// world, so the large world mode of cb2World::SetOriginCellSize works as well.
+	void ShiftOrigin(int cellX, int cellY);
+
+	/// Get the saved data of a cell, so it can be written out. Returns NULL when the cell
+	/// has no saved bodies.
+	const void* GetCellData(int x, int y, int* size) const;
+
+	/// Give a cell the data it had when it was written out, replacing any saved bodies.
+	/// Returns false if the data is damaged or the cell is active.
+	bool SetCellData(int x, int y, const void* data, int size);
+
+	/// Forget the saved bodies of a cell, for instance once its data was written out.
+	void ReleaseCellData(int x, int y);
+
+	/// Get the number of cells with saved bodies and the bytes they hold.
+	int GetStoredCellCount() const { return m_cellCount; }
+	int GetStoredSize() const;
+
+	float GetCellSize() const { return m_cellSize; }
+
+private:
+
+	struct cb2RegionCell
+	{
+		int x, y;
+		char* data;
+		int size;
+		int capacity;
+	};
+
+	int FindCell(int x, int y) const;
+	cb2RegionCell* GetOrAddCell(int x, int y);
+	void RemoveCell(int index);
+
+	void StreamOut(cb2Body* body, int x, int y);
+	void StreamIn(int index);
+
+	ci::Vec2f GetCellCorner(int x, int y) const;
+
+	cb2World* m_world;
+	cb2RegionListener* m_listener;
+	float m_cellSize;
+
+	// The active cells are [lowerX, upperX] x [lowerY, upperY].
+	int m_lowerX, m_lowerY;
+	int m_upperX, m_upperY;
+	bool m_hasActiveArea;
+
+	// Sorted by x, then y.
+	cb2RegionCell* m_cells;
+	int m_cellCount;
+	int m_cellCapacity;
+};
+
+#endif
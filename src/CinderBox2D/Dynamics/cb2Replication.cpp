@@ -0,0 +1,501 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2Replication.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
+#include <math.h>
+#include <string.h>
+
+// An update is a flags byte and a record count, then per record the body id, a
+// flags byte and the deltas of the quantized values against the baseline. Counts
+// and ids are varints, deltas are zigzag varints, so small deltas take one byte.
+enum
+{
+	e_replicationFull	= 0x01,
+	e_replicationAwake	= 0x01
+};
+
+static void cb2WriteVarint(cb2SnapshotWriter& writer, unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		writer.Write<unsigned char>((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	writer.Write<unsigned char>((unsigned char)value);
+}
+
+static unsigned int cb2ReadVarint(cb2SnapshotReader& reader)
+{
+	unsigned int value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		unsigned char byte = reader.Read<unsigned char>();
+		value |= (unsigned int)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+
+	// More than five bytes.
+	reader.SetFailed();
+	return 0;
+}
+
+// The deltas wrap around in unsigned arithmetic, so any pair of values has one.
+static void cb2WriteDelta(cb2SnapshotWriter& writer, int value, int base)
+{
+	unsigned int delta = (unsigned int)value - (unsigned int)base;
+	cb2WriteVarint(writer, (delta << 1) ^ (0u - (delta >> 31)));
+}
+
+static int cb2ReadDelta(cb2SnapshotReader& reader, int base)
+{
+	unsigned int zigzag = cb2ReadVarint(reader);
+	unsigned int delta = (zigzag >> 1) ^ (0u - (zigzag & 1));
+	return (int)((unsigned int)base + delta);
+}
+
+static int cb2Quantize(float value, float precision)
+{
+	// Keep the value in range of an int.
+	float q = cb2Clamp(value / precision, -2147483520.0f, 2147483520.0f);
+	return (int)floorf(q + 0.5f);
+}
+
+cb2ReplicationEncoder::cb2ReplicationEncoder(const cb2World* world, const cb2ReplicationDef& def)
+{
+	cb2Assert(world != NULL);
+	cb2Assert(def.positionPrecision > 0.0f && def.anglePrecision > 0.0f && def.velocityPrecision > 0.0f);
+	m_world = world;
+	m_def = def;
+
+	m_clients = NULL;
+	m_clientCapacity = 0;
+	m_clientCount = 0;
+	m_freeList = -1;
+
+	m_records = NULL;
+	m_recordCount = 0;
+	m_recordCapacity = 0;
+}
+
+cb2ReplicationEncoder::~cb2ReplicationEncoder()
+{
+	for (int i = 0; i < m_clientCapacity; ++i)
+	{
+		if (m_clients[i].next == e_used)
+		{
+			cb2Free(m_clients[i].baselines);
+			cb2Free(m_clients[i].awakeIds);
+		}
+	}
+	cb2Free(m_clients);
+	cb2Free(m_records);
+}
+
+int cb2ReplicationEncoder::AddClient()
+{
+	if (m_freeList == -1)
+	{
+		int capacity = cb2Max(2 * m_clientCapacity, 16);
+		Client* old = m_clients;
+		m_clients = (Client*)cb2Alloc(capacity * sizeof(Client));
+		if (old)
+		{
+			memcpy(m_clients, old, m_clientCapacity * sizeof(Client));
+			cb2Free(old);
+		}
+
+		// Thread the new slots onto the free list in order.
+		for (int i = capacity - 1; i >= m_clientCapacity; --i)
+		{
+			m_clients[i].next = m_freeList;
+			m_freeList = i;
+		}
+		m_clientCapacity = capacity;
+	}
+
+	int index = m_freeList;
+	Client* client = m_clients + index;
+	m_freeList = client->next;
+
+	client->baselines = NULL;
+	client->baselineCapacity = 0;
+	client->awakeIds = NULL;
+	client->awakeCount = 0;
+	client->awakeCapacity = 0;
+	client->stamp = 0;
+	client->full = true;
+	client->next = e_used;
+	++m_clientCount;
+	return index;
+}
+
+void cb2ReplicationEncoder::RemoveClient(int index)
+{
+	cb2Assert(0 <= index && index < m_clientCapacity && m_clients[index].next == e_used);
+	Client* client = m_clients + index;
+	cb2Free(client->baselines);
+	cb2Free(client->awakeIds);
+	client->next = m_freeList;
+	m_freeList = index;
+	--m_clientCount;
+}
+
+void cb2ReplicationEncoder::ResetClient(int index)
+{
+	cb2Assert(0 <= index && index < m_clientCapacity && m_clients[index].next == e_used);
+	m_clients[index].full = true;
+}
+
+void cb2ReplicationEncoder::Quantize(const cb2Body* body, int* values) const
+{
+	ci::Vec2f p = body->GetPosition();
+	ci::Vec2f v = body->GetLinearVelocity();
+	values[cb2ReplicationBaseline::e_positionX] = cb2Quantize(p.x, m_def.positionPrecision);
+	values[cb2ReplicationBaseline::e_positionY] = cb2Quantize(p.y, m_def.positionPrecision);
+	values[cb2ReplicationBaseline::e_angle] = cb2Quantize(body->GetAngle(), m_def.anglePrecision);
+	values[cb2ReplicationBaseline::e_velocityX] = cb2Quantize(v.x, m_def.velocityPrecision);
+	values[cb2ReplicationBaseline::e_velocityY] = cb2Quantize(v.y, m_def.velocityPrecision);
+	values[cb2ReplicationBaseline::e_angularVelocity] = cb2Quantize(body->GetAngularVelocity(), m_def.velocityPrecision);
+}
+
+bool cb2ReplicationEncoder::HasChanged(const cb2Body* body, const cb2ReplicationBaseline& baseline) const
+{
+	const int* values = baseline.values;
+	ci::Vec2f p = body->GetPosition();
+	ci::Vec2f v = body->GetLinearVelocity();
+
+	ci::Vec2f dp = p - m_def.positionPrecision * ci::Vec2f(
+		(float)values[cb2ReplicationBaseline::e_positionX],
+		(float)values[cb2ReplicationBaseline::e_positionY]);
+	if (dp.lengthSquared() > m_def.positionThreshold * m_def.positionThreshold)
+	{
+		return true;
+	}
+
+	float da = body->GetAngle() - m_def.anglePrecision * values[cb2ReplicationBaseline::e_angle];
+	if (cb2Abs(da) > m_def.angleThreshold)
+	{
+		return true;
+	}
+
+	ci::Vec2f dv = v - m_def.velocityPrecision * ci::Vec2f(
+		(float)values[cb2ReplicationBaseline::e_velocityX],
+		(float)values[cb2ReplicationBaseline::e_velocityY]);
+	if (dv.lengthSquared() > m_def.velocityThreshold * m_def.velocityThreshold)
+	{
+		return true;
+	}
+
+	float dw = body->GetAngularVelocity() - m_def.velocityPrecision * values[cb2ReplicationBaseline::e_angularVelocity];
+	return cb2Abs(dw) > m_def.velocityThreshold;
+}
+
+void cb2ReplicationEncoder::AddRecord(const cb2Body* body, bool awake)
+{
+	if (m_recordCount == m_recordCapacity)
+	{
+		Record* old = m_records;
+		m_recordCapacity = cb2Max(2 * m_recordCapacity, 64);
+		m_records = (Record*)cb2Alloc(m_recordCapacity * sizeof(Record));
+		if (old)
+		{
+			memcpy(m_records, old, m_recordCount * sizeof(Record));
+			cb2Free(old);
+		}
+	}
+
+	Record* record = m_records + m_recordCount++;
+	record->id = body->GetId();
+	Quantize(body, record->values);
+	record->awake = awake;
+}
+
+int cb2ReplicationEncoder::Encode(int index, void* buffer, int capacity)
+{
+	cb2Assert(0 <= index && index < m_clientCapacity && m_clients[index].next == e_used);
+	Client* client = m_clients + index;
+
+	// Grow the baselines to the ids of the world. New ids start from zero on
+	// both sides.
+	int idCount = m_world->GetBodyIdCount();
+	if (client->baselineCapacity < idCount)
+	{
+		int newCapacity = cb2Max(2 * client->baselineCapacity, idCount);
+		cb2ReplicationBaseline* old = client->baselines;
+		client->baselines = (cb2ReplicationBaseline*)cb2Alloc(newCapacity * sizeof(cb2ReplicationBaseline));
+		if (old)
+		{
+			memcpy(client->baselines, old, client->baselineCapacity * sizeof(cb2ReplicationBaseline));
+			cb2Free(old);
+		}
+		memset(client->baselines + client->baselineCapacity, 0,
+			(newCapacity - client->baselineCapacity) * sizeof(cb2ReplicationBaseline));
+		client->baselineCapacity = newCapacity;
+	}
+
+	// Every encode gets a new stamp, so the stamps of an update that did not fit
+	// are never mistaken for the ones of the next.
+	int stamp = ++client->stamp;
+	bool full = client->full;
+	m_recordCount = 0;
+
+	if (full)
+	{
+		for (const cb2Body* b = m_world->GetBodyList(); b; b = b->GetNext())
+		{
+			if (b->GetType() != cb2_staticBody)
+			{
+				AddRecord(b, b->IsAwake());
+			}
+		}
+	}
+	else
+	{
+		// Awake bodies that changed, or that were asleep on the client.
+		int awakeIndex;
+		for (cb2Body* b = m_world->GetFirstAwakeBody(&awakeIndex); b; b = m_world->GetNextAwakeBody(b, &awakeIndex))
+		{
+			if (b->GetType() == cb2_staticBody || b->IsAwake() == false)
+			{
+				continue;
+			}
+
+			cb2ReplicationBaseline& baseline = client->baselines[b->GetId()];
+			baseline.stamp = stamp;
+			if (baseline.awake == false || HasChanged(b, baseline))
+			{
+				AddRecord(b, true);
+			}
+		}
+
+		// Bodies that fell asleep since the last encode get their rest pose.
+		for (int i = 0; i < client->awakeCount; ++i)
+		{
+			int id = client->awakeIds[i];
+			cb2ReplicationBaseline& baseline = client->baselines[id];
+			if (baseline.stamp == stamp)
+			{
+				continue;
+			}
+
+			const cb2Body* b = m_world->GetBody(id);
+			if (b && b->GetType() != cb2_staticBody)
+			{
+				AddRecord(b, false);
+			}
+		}
+	}
+
+	// Write the update.
+	const cb2ReplicationBaseline zero = cb2ReplicationBaseline();
+	cb2SnapshotWriter writer(buffer, capacity);
+	writer.Write<unsigned char>(full ? e_replicationFull : 0);
+	cb2WriteVarint(writer, m_recordCount);
+	for (int i = 0; i < m_recordCount; ++i)
+	{
+		const Record& record = m_records[i];
+		const cb2ReplicationBaseline& baseline = full ? zero : client->baselines[record.id];
+		cb2WriteVarint(writer, record.id);
+		writer.Write<unsigned char>(record.awake ? e_replicationAwake : 0);
+		for (int j = 0; j < cb2ReplicationBaseline::e_valueCount; ++j)
+		{
+			cb2WriteDelta(writer, record.values[j], baseline.values[j]);
+		}
+	}
+
+	if (writer.IsComplete() == false)
+	{
+		return writer.GetSize();
+	}
+
+	// Commit what the client now has.
+	if (full)
+	{
+		memset(client->baselines, 0, client->baselineCapacity * sizeof(cb2ReplicationBaseline));
+		client->full = false;
+	}
+
+	for (int i = 0; i < client->awakeCount; ++i)
+	{
+		client->baselines[client->awakeIds[i]].awake = false;
+	}
+
+	if (client->awakeCapacity < m_recordCount + client->awakeCount)
+	{
+		int* old = client->awakeIds;
+		client->awakeCapacity = cb2Max(2 * client->awakeCapacity, m_recordCount + client->awakeCount);
+		client->awakeIds = (int*)cb2Alloc(client->awakeCapacity * sizeof(int));
+		if (old)
+		{
+			memcpy(client->awakeIds, old, client->awakeCount * sizeof(int));
+			cb2Free(old);
+		}
+	}
+
+	// An awake body that was not sent keeps its baseline and stays awake.
+	int awakeCount = 0;
+	if (full == false)
+	{
+		for (int i = 0; i < client->awakeCount; ++i)
+		{
+			int id = client->awakeIds[i];
+			if (client->baselines[id].stamp == stamp)
+			{
+				client->baselines[id].awake = true;
+				client->awakeIds[awakeCount++] = id;
+			}
+		}
+	}
+
+	for (int i = 0; i < m_recordCount; ++i)
+	{
+		const Record& record = m_records[i];
+		cb2ReplicationBaseline& baseline = client->baselines[record.id];
+		memcpy(baseline.values, record.values, sizeof(baseline.values));
+		baseline.stamp = stamp;
+		if (record.awake && baseline.awake == false)
+		{
+			baseline.awake = true;
+			client->awakeIds[awakeCount++] = record.id;
+		}
+	}
+	client->awakeCount = awakeCount;
+
+	return writer.GetSize();
+}
+
+cb2ReplicationDecoder::cb2ReplicationDecoder(cb2World* world, const cb2ReplicationDef& def)
+{
+	cb2Assert(world != NULL);
+	m_world = world;
+	m_def = def;
+	m_baselines = NULL;
+	m_baselineCapacity = 0;
+}
+
+cb2ReplicationDecoder::~cb2ReplicationDecoder()
+{
+	cb2Free(m_baselines);
+}
+
+void cb2ReplicationDecoder::Reserve(int count)
+{
+	if (count <= m_baselineCapacity)
+	{
+		return;
+	}
+
+	const int n = cb2ReplicationBaseline::e_valueCount;
+	int capacity = cb2Max(2 * m_baselineCapacity, count);
+	int* old = m_baselines;
+	m_baselines = (int*)cb2Alloc(capacity * n * sizeof(int));
+	if (old)
+	{
+		memcpy(m_baselines, old, m_baselineCapacity * n * sizeof(int));
+		cb2Free(old);
+	}
+	memset(m_baselines + m_baselineCapacity * n, 0, (capacity - m_baselineCapacity) * n * sizeof(int));
+	m_baselineCapacity = capacity;
+}
+
+bool cb2ReplicationDecoder::Apply(const void* data, int size)
+{
+	cb2Assert(m_world->IsLocked() == false);
+	if (m_world->IsLocked())
+	{
+		return false;
+	}
+
+	const int n = cb2ReplicationBaseline::e_valueCount;
+
+	// Check the whole update before changing anything.
+	cb2SnapshotReader check(data, size);
+	check.Read<unsigned char>();
+	unsigned int recordCount = cb2ReadVarint(check);
+	if (recordCount > (unsigned int)size)
+	{
+		return false;
+	}
+
+	int idCount = 0;
+	for (unsigned int i = 0; i < recordCount && check.HasFailed() == false; ++i)
+	{
+		unsigned int id = cb2ReadVarint(check);
+		if (id >= (unsigned int)m_def.maxBodyIdCount)
+		{
+			return false;
+		}
+		idCount = cb2Max(idCount, (int)id + 1);
+		check.Read<unsigned char>();
+		for (int j = 0; j < n; ++j)
+		{
+			cb2ReadVarint(check);
+		}
+	}
+
+	if (check.HasFailed() || check.GetOffset() != size)
+	{
+		return false;
+	}
+
+	Reserve(idCount);
+
+	cb2SnapshotReader reader(data, size);
+	unsigned char flags = reader.Read<unsigned char>();
+	cb2ReadVarint(reader);
+	if (flags & e_replicationFull)
+	{
+		memset(m_baselines, 0, m_baselineCapacity * n * sizeof(int));
+	}
+
+	for (unsigned int i = 0; i < recordCount; ++i)
+	{
+		int id = (int)cb2ReadVarint(reader);
+		bool awake = (reader.Read<unsigned char>() & e_replicationAwake) != 0;
+		int* values = m_baselines + id * n;
+		for (int j = 0; j < n; ++j)
+		{
+			values[j] = cb2ReadDelta(reader, values[j]);
+		}
+
+		cb2Body* body = m_world->GetBody(id);
+		if (body == NULL || body->GetType() == cb2_staticBody)
+		{
+			continue;
+		}
+
+		ci::Vec2f position(
+			m_def.positionPrecision * values[cb2ReplicationBaseline::e_positionX],
+			m_def.positionPrecision * values[cb2ReplicationBaseline::e_positionY]);
+		ci::Vec2f velocity(
+			m_def.velocityPrecision * values[cb2ReplicationBaseline::e_velocityX],
+			m_def.velocityPrecision * values[cb2ReplicationBaseline::e_velocityY]);
+		body->SetTransform(position, m_def.anglePrecision * values[cb2ReplicationBaseline::e_angle]);
+		body->SetLinearVelocity(velocity);
+		body->SetAngularVelocity(m_def.velocityPrecision * values[cb2ReplicationBaseline::e_angularVelocity]);
+		body->SetAwake(awake);
+	}
+
+	return true;
+}
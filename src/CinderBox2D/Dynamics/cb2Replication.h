@@ -0,0 +1,181 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_REPLICATION_H
+#define CB2_REPLICATION_H
+
+#include <CinderBox2D/Common/cb2Math.h>
+
+class cb2Body;
+class cb2World;
+
+/// Replication definitions set how body state is quantized and when it is sent.
+/// The encoder and the decoder of a stream must use the same precisions.
+struct cb2ReplicationDef
+{
+	cb2ReplicationDef()
+	{
+		positionPrecision = 1.0f / 1024.0f;
+		anglePrecision = 1.0f / 4096.0f;
+		velocityPrecision = 1.0f / 256.0f;
+		positionThreshold = 0.01f;
+		angleThreshold = 0.01f;
+		velocityThreshold = 0.05f;
+		maxBodyIdCount = 1 << 20;
+	}
+
+	/// The quantization step of positions, in meters.
+	float positionPrecision;
+
+	/// The quantization step of angles, in radians.
+	float anglePrecision;
+
+	/// The quantization step of linear and angular velocities.
+	float velocityPrecision;
+
+	/// An awake body is sent when its position moved this far from what the client has.
+	float positionThreshold;
+
+	/// An awake body is sent when its angle turned this far from what the client has.
+	float angleThreshold;
+
+	/// An awake body is sent when a velocity changed this much from what the client has.
+	float velocityThreshold;
+
+	/// The decoder rejects updates with a body id of this or more.
+	int maxBodyIdCount;
+};
+
+/// The quantized state of a body as a client has it.
+struct cb2ReplicationBaseline
+{
+	enum
+	{
+		e_positionX = 0,
+		e_positionY,
+		e_angle,
+		e_velocityX,
+		e_velocityY,
+		e_angularVelocity,
+		e_valueCount
+	};
+
+	int values[e_valueCount];
+	int stamp;				///< the encode that last saw the body awake
+	bool awake;
+};
+
+/// Encodes the body state of a server world for many clients. Each client has a
+/// baseline of what it was sent, and an update holds only the awake bodies that
+/// moved beyond the thresholds, as deltas of quantized values. A body that falls
+/// asleep is sent once more with its rest pose, then costs nothing until it wakes.
+/// The first update of a client, and the first after ResetClient, holds every
+/// non-static body.
+///
+/// Updates must be applied in order and none may be lost, since each one is a
+/// delta against the previous. Call ResetClient when an update was dropped.
+/// Bodies are known by their id, see cb2Body::GetId, so the client world must have
+/// matching ids. A sleeping body that is moved is not sent until it wakes.
+class cb2ReplicationEncoder
+{
+public:
+	cb2ReplicationEncoder(const cb2World* world, const cb2ReplicationDef& def);
+	~cb2ReplicationEncoder();
+
+	/// Add a client. Returns the client slot, which is reused after RemoveClient.
+	int AddClient();
+	void RemoveClient(int client);
+
+	/// Forget what a client has, so its next update holds every body.
+	void ResetClient(int client);
+
+	int GetClientCount() const { return m_clientCount; }
+
+	/// Write the next update of a client into a buffer. Returns the size of the
+	/// update. If this exceeds the capacity nothing is committed, so call again
+	/// with a larger buffer. A NULL buffer measures the update.
+	int Encode(int client, void* buffer, int capacity);
+
+private:
+
+	struct Client
+	{
+		cb2ReplicationBaseline* baselines;
+		int baselineCapacity;
+		int* awakeIds;			///< the bodies awake at the last encode
+		int awakeCount;
+		int awakeCapacity;
+		int stamp;
+		bool full;
+		int next;				///< the next free slot, or e_used
+	};
+
+	struct Record
+	{
+		int id;
+		int values[cb2ReplicationBaseline::e_valueCount];
+		bool awake;
+	};
+
+	enum
+	{
+		e_used = -2
+	};
+
+	void Quantize(const cb2Body* body, int* values) const;
+	bool HasChanged(const cb2Body* body, const cb2ReplicationBaseline& baseline) const;
+	void AddRecord(const cb2Body* body, bool awake);
+
+	const cb2World* m_world;
+	cb2ReplicationDef m_def;
+
+	Client* m_clients;
+	int m_clientCapacity;
+	int m_clientCount;
+	int m_freeList;
+
+	// The records of the update being encoded.
+	Record* m_records;
+	int m_recordCount;
+	int m_recordCapacity;
+};
+
+/// Applies the updates of a cb2ReplicationEncoder client to a client world.
+class cb2ReplicationDecoder
+{
+public:
+	cb2ReplicationDecoder(cb2World* world, const cb2ReplicationDef& def);
+	~cb2ReplicationDecoder();
+
+	/// Apply an update. Sets the transform, velocities and sleep state of the
+	/// bodies it holds. Ids without a body are skipped but still tracked. Returns
+	/// false and changes nothing if the update is damaged. The world must not be locked.
+	bool Apply(const void* data, int size);
+
+private:
+
+	void Reserve(int count);
+
+	cb2World* m_world;
+	cb2ReplicationDef m_def;
+
+	int* m_baselines;		///< the quantized values of each id
+	int m_baselineCapacity;
+};
+
+#endif
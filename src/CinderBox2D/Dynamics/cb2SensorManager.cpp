@@ -0,0 +1,473 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2SensorManager.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2ContactEvents.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
+#include <CinderBox2D/Dynamics/cb2WorldCallbacks.h>
+#include <CinderBox2D/Collision/cb2BroadPhase.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChildQuery.h>
+#include <CinderBox2D/Common/cb2ThreadPool.h>
+#include <algorithm>
+#include <string.h>
+
+// Number of sensors handed to a thread at a time.
+const int cb2_sensorGrainSize = 16;
+
+// Order by sensor child, visitor proxy, and visitor child. Overlaps of different fixtures
+// compare equal if a proxy id was reused, Update tells them apart by the fixture.
+static int cb2CompareOverlaps(const cb2SensorOverlap& a, const cb2SensorOverlap& b)
+{
+	if (a.sensorChild != b.sensorChild)
+	{
+		return a.sensorChild < b.sensorChild ? -1 : 1;
+	}
+
+	if (a.visitorProxyId != b.visitorProxyId)
+	{
+		return a.visitorProxyId < b.visitorProxyId ? -1 : 1;
+	}
+
+	if (a.visitorChild != b.visitorChild)
+	{
+		return a.visitorChild < b.visitorChild ? -1 : 1;
+	}
+
+	return 0;
+}
+
+static bool cb2OverlapLessThan(const cb2SensorOverlap& a, const cb2SensorOverlap& b)
+{
+	return cb2CompareOverlaps(a, b) < 0;
+}
+
+// Collects the candidates of one sensor proxy.
+struct cb2SensorQuery
+{
+	bool QueryCallback(int proxyId);
+	void Test(int sensorChild, int visitorChild);
+
+	const cb2BroadPhase* broadPhase;
+	cb2Sensor* sensor;
+	const cb2Body* sensorBody;
+	const cb2FixtureProxy* sensorProxy;
+	const cb2FixtureProxy* visitorProxy;
+};
+
+// Tests the children of a chain with a child tree against one child of the other shape.
+struct cb2SensorChildQuery
+{
+	bool QueryCallback(int childIndex)
+	{
+		if (sensorChain)
+		{
+			query->Test(childIndex, otherChild);
+		}
+		else
+		{
+			query->Test(otherChild, childIndex);
+		}
+		return true;
+	}
+
+	cb2SensorQuery* query;
+	int otherChild;
+	bool sensorChain;
+};
+
+// Tests the children of a sensor and a visitor that both use a single proxy.
+struct cb2SensorChildChildQuery
+{
+	bool QueryCallback(int childIndex)
+	{
+		cb2SensorChildQuery childQuery;
+		childQuery.query = query;
+		childQuery.otherChild = childIndex;
+		childQuery.sensorChain = false;
+
+		const cb2Fixture* visitor = query->visitorProxy->fixture;
+		cb2AABB aabb;
+		query->sensor->fixture->GetShape()->ComputeAABB(&aabb, query->sensorBody->GetTransform(), childIndex);
+		cb2QueryChildren(visitor->GetShape(), &childQuery, aabb, visitor->GetBody()->GetTransform());
+		return true;
+	}
+
+	cb2SensorQuery* query;
+};
+
+bool cb2SensorQuery::QueryCallback(int proxyId)
+{
+	const cb2FixtureProxy* proxy = (const cb2FixtureProxy*)broadPhase->GetUserData(proxyId);
+	const cb2Fixture* visitor = proxy->fixture;
+	const cb2Body* body = visitor->GetBody();
+
+	// Sensors do not sense each other. The body and layer rules match the contacts.
+	if (visitor->IsSensor() || body == sensorBody || body->ShouldCollide(sensorBody) == false)
+	{
+		return true;
+	}
+
+	if (broadPhase->ShouldCollideLayers(sensor->fixture->GetFilterData().layer, visitor->GetFilterData().layer) == false)
+	{
+		return true;
+	}
+
+	visitorProxy = proxy;
+
+	bool sensorChain = sensorProxy->childIndex == cb2ChainShape::e_allChildren;
+	bool visitorChain = proxy->childIndex == cb2ChainShape::e_allChildren;
+	if (sensorChain && visitorChain)
+	{
+		cb2SensorChildChildQuery childQuery;
+		childQuery.query = this;
+		cb2QueryChildren(sensor->fixture->GetShape(), &childQuery, proxy->aabb, sensorBody->GetTransform());
+		return true;
+	}
+
+	if (sensorChain || visitorChain)
+	{
+		cb2SensorChildQuery childQuery;
+		childQuery.query = this;
+		childQuery.sensorChain = sensorChain;
+		if (sensorChain)
+		{
+			childQuery.otherChild = proxy->childIndex;
+			cb2QueryChildren(sensor->fixture->GetShape(), &childQuery, proxy->aabb, sensorBody->GetTransform());
+		}
+		else
+		{
+			childQuery.otherChild = sensorProxy->childIndex;
+			cb2QueryChildren(visitor->GetShape(), &childQuery, sensorProxy->aabb, body->GetTransform());
+		}
+		return true;
+	}
+
+	if (cb2TestOverlap(sensorProxy->aabb, proxy->aabb))
+	{
+		Test(sensorProxy->childIndex, proxy->childIndex);
+	}
+	return true;
+}
+
+void cb2SensorQuery::Test(int sensorChild, int visitorChild)
+{
+	const cb2Fixture* visitor = visitorProxy->fixture;
+	bool touching = cb2TestOverlap(sensor->fixture->GetShape(), sensorChild, visitor->GetShape(), visitorChild,
+								   sensorBody->GetTransform(), visitor->GetBody()->GetTransform());
+	if (touching == false)
+	{
+		return;
+	}
+
+	if (sensor->candidateCount < sensor->candidateCapacity)
+	{
+		cb2SensorOverlap* overlap = sensor->candidates + sensor->candidateCount;
+		overlap->visitor = (cb2Fixture*)visitor;
+		overlap->visitorProxyId = visitorProxy->proxyId;
+		overlap->sensorChild = sensorChild;
+		overlap->visitorChild = visitorChild;
+	}
+	++sensor->candidateCount;
+}
+
+// Finds the candidates of the sensors on the thread pool.
+class cb2FindSensorOverlapsTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		for (int i = begin; i < end; ++i)
+		{
+			manager->FindOverlaps(sensors + i, broadPhase);
+		}
+	}
+
+	const cb2SensorManager* manager;
+	cb2Sensor* sensors;
+	const cb2BroadPhase* broadPhase;
+};
+
+cb2SensorManager::cb2SensorManager()
+{
+	m_sensors = NULL;
+	m_sensorCount = 0;
+	m_sensorCapacity = 0;
+}
+
+cb2SensorManager::~cb2SensorManager()
+{
+	for (int i = 0; i < m_sensorCount; ++i)
+	{
+		m_sensors[i].fixture->m_sensorIndex = -1;
+		cb2Free(m_sensors[i].overlaps);
+		cb2Free(m_sensors[i].candidates);
+	}
+	cb2Free(m_sensors);
+}
+
+void cb2SensorManager::AddSensor(cb2Fixture* fixture)
+{
+	cb2Assert(fixture->m_sensorIndex == -1);
+	if (m_sensorCount == m_sensorCapacity)
+	{
+		cb2Sensor* oldSensors = m_sensors;
+		m_sensorCapacity = cb2Max(2 * m_sensorCapacity, 16);
+		m_sensors = (cb2Sensor*)cb2Alloc(m_sensorCapacity * sizeof(cb2Sensor));
+		if (oldSensors)
+		{
+			memcpy(m_sensors, oldSensors, m_sensorCount * sizeof(cb2Sensor));
+			cb2Free(oldSensors);
+		}
+	}
+
+	cb2Sensor* sensor = m_sensors + m_sensorCount;
+	sensor->fixture = fixture;
+	sensor->overlaps = NULL;
+	sensor->overlapCount = 0;
+	sensor->overlapCapacity = 0;
+	sensor->candidates = NULL;
+	sensor->candidateCount = 0;
+	sensor->candidateCapacity = 0;
+	fixture->m_sensorIndex = m_sensorCount;
+	++m_sensorCount;
+}
+
+void cb2SensorManager::RemoveSensor(cb2Fixture* fixture, cb2ContactListener* listener)
+{
+	int index = fixture->m_sensorIndex;
+	cb2Assert(0 <= index && index < m_sensorCount);
+	cb2Sensor* sensor = m_sensors + index;
+	if (listener)
+	{
+		for (int i = 0; i < sensor->overlapCount; ++i)
+		{
+			listener->EndSensorOverlap(fixture, sensor->overlaps[i].visitor);
+		}
+	}
+
+	cb2Free(sensor->overlaps);
+	cb2Free(sensor->candidates);
+	fixture->m_sensorIndex = -1;
+
+	// Swap the last sensor into the hole.
+	--m_sensorCount;
+	if (index < m_sensorCount)
+	{
+		*sensor = m_sensors[m_sensorCount];
+		sensor->fixture->m_sensorIndex = index;
+	}
+}
+
+void cb2SensorManager::RemoveFixture(cb2Fixture* fixture, cb2ContactListener* listener)
+{
+	if (fixture->m_sensorIndex != -1)
+	{
+		RemoveSensor(fixture, listener);
+	}
+
+	// A fixture that became a sensor since the last update can still be a visitor.
+	for (int i = 0; i < m_sensorCount; ++i)
+	{
+		cb2Sensor* sensor = m_sensors + i;
+		int count = 0;
+		for (int j = 0; j < sensor->overlapCount; ++j)
+		{
+			if (sensor->overlaps[j].visitor != fixture)
+			{
+				sensor->overlaps[count++] = sensor->overlaps[j];
+			}
+			else if (listener)
+			{
+				listener->EndSensorOverlap(sensor->fixture, fixture);
+			}
+		}
+		sensor->overlapCount = count;
+	}
+}
+
+void cb2SensorManager::FindOverlaps(cb2Sensor* sensor, const cb2BroadPhase* broadPhase) const
+{
+	sensor->candidateCount = 0;
+
+	cb2SensorQuery query;
+	query.broadPhase = broadPhase;
+	query.sensor = sensor;
+	query.sensorBody = sensor->fixture->GetBody();
+	query.visitorProxy = NULL;
+
+	const cb2Fixture* fixture = sensor->fixture;
+	for (int i = 0; i < fixture->m_proxyCount; ++i)
+	{
+		query.sensorProxy = fixture->m_proxies + i;
+		broadPhase->Query(&query, query.sensorProxy->aabb);
+	}
+}
+
+void cb2SensorManager::Update(const cb2BroadPhase* broadPhase, cb2ContactFilter* filter, cb2ContactListener* listener,
+							  cb2ContactEvents* events, cb2ThreadPool* pool)
+{
+	if (m_sensorCount == 0)
+	{
+		return;
+	}
+
+	if (pool && m_sensorCount > cb2_sensorGrainSize)
+	{
+		cb2FindSensorOverlapsTask task;
+		task.manager = this;
+		task.sensors = m_sensors;
+		task.broadPhase = broadPhase;
+		pool->ParallelFor(&task, m_sensorCount, cb2_sensorGrainSize);
+	}
+	else
+	{
+		for (int i = 0; i < m_sensorCount; ++i)
+		{
+			FindOverlaps(m_sensors + i, broadPhase);
+		}
+	}
+
+	// The listener may not destroy fixtures, so the sensors stay in place.
+	for (int i = 0; i < m_sensorCount; ++i)
+	{
+		cb2Sensor* sensor = m_sensors + i;
+		if (sensor->candidateCount > sensor->candidateCapacity)
+		{
+			cb2Free(sensor->candidates);
+			sensor->candidateCapacity = cb2Max(2 * sensor->candidateCapacity, sensor->candidateCount);
+			sensor->candidates = (cb2SensorOverlap*)cb2Alloc(sensor->candidateCapacity * sizeof(cb2SensorOverlap));
+			FindOverlaps(sensor, broadPhase);
+			cb2Assert(sensor->candidateCount <= sensor->candidateCapacity);
+		}
+
+		std::sort(sensor->candidates, sensor->candidates + sensor->candidateCount, cb2OverlapLessThan);
+		ReportChanges(sensor, filter, listener, events);
+	}
+}
+
+void cb2SensorManager::ReportChanges(cb2Sensor* sensor, cb2ContactFilter* filter, cb2ContactListener* listener,
+									 cb2ContactEvents* events)
+{
+	cb2Fixture* fixture = sensor->fixture;
+	const cb2SensorOverlap* overlaps = sensor->overlaps;
+	cb2SensorOverlap* candidates = sensor->candidates;
+	int overlapCount = sensor->overlapCount;
+	int candidateCount = sensor->candidateCount;
+
+	// Merge the sorted overlaps and candidates. The kept candidates are compacted in place.
+	int i = 0;
+	int j = 0;
+	int keptCount = 0;
+	while (i < overlapCount || j < candidateCount)
+	{
+		int order;
+		if (i == overlapCount)
+		{
+			order = 1;
+		}
+		else if (j == candidateCount)
+		{
+			order = -1;
+		}
+		else
+		{
+			order = cb2CompareOverlaps(overlaps[i], candidates[j]);
+		}
+
+		if (order == 0 && overlaps[i].visitor == candidates[j].visitor)
+		{
+			candidates[keptCount++] = candidates[j];
+			++i;
+			++j;
+			continue;
+		}
+
+		if (order <= 0)
+		{
+			const cb2SensorOverlap* overlap = overlaps + i;
+			if (listener)
+			{
+				listener->EndSensorOverlap(fixture, overlap->visitor);
+			}
+			if (events)
+			{
+				events->AddSensorEnd(fixture, overlap->sensorChild, overlap->visitor, overlap->visitorChild);
+			}
+			++i;
+			continue;
+		}
+
+		// A new overlap goes through the user filter once, like a new contact.
+		cb2SensorOverlap* candidate = candidates + j;
+		++j;
+		if (filter && filter->ShouldCollide(fixture, candidate->visitor) == false)
+		{
+			continue;
+		}
+
+		if (listener)
+		{
+			listener->BeginSensorOverlap(fixture, candidate->visitor);
+		}
+		if (events)
+		{
+			events->AddSensorBegin(fixture, candidate->sensorChild, candidate->visitor, candidate->visitorChild);
+		}
+		candidates[keptCount++] = *candidate;
+	}
+
+	// The kept candidates become the overlaps.
+	cb2SensorOverlap* oldOverlaps = sensor->overlaps;
+	int oldCapacity = sensor->overlapCapacity;
+	sensor->overlaps = candidates;
+	sensor->overlapCount = keptCount;
+	sensor->overlapCapacity = sensor->candidateCapacity;
+	sensor->candidates = oldOverlaps;
+	sensor->candidateCount = 0;
+	sensor->candidateCapacity = oldCapacity;
+}
+
+void cb2SensorManager::Copy(const cb2SensorManager& other, const cb2CloneMap& map)
+{
+	cb2Assert(m_sensorCount == 0);
+	for (int i = 0; i < other.m_sensorCount; ++i)
+	{
+		const cb2Sensor* source = other.m_sensors + i;
+		cb2Fixture* fixture = map.Find(source->fixture);
+		fixture->m_sensorIndex = -1;
+		AddSensor(fixture);
+
+		cb2Sensor* sensor = m_sensors + m_sensorCount - 1;
+		if (source->overlapCount == 0)
+		{
+			continue;
+		}
+
+		sensor->overlaps = (cb2SensorOverlap*)cb2Alloc(source->overlapCount * sizeof(cb2SensorOverlap));
+		sensor->overlapCapacity = source->overlapCount;
+		sensor->overlapCount = source->overlapCount;
+		for (int j = 0; j < source->overlapCount; ++j)
+		{
+			sensor->overlaps[j] = source->overlaps[j];
+			sensor->overlaps[j].visitor = map.Find(source->overlaps[j].visitor);
+		}
+	}
+}
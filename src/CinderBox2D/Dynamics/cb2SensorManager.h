@@ -0,0 +1,96 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_SENSOR_MANAGER_H
+#define CB2_SENSOR_MANAGER_H
+
+#include <CinderBox2D/Common/cb2Settings.h>
+
+class cb2BroadPhase;
+class cb2CloneMap;
+class cb2ContactEvents;
+class cb2ContactFilter;
+class cb2ContactListener;
+class cb2Fixture;
+class cb2ThreadPool;
+
+// A fixture child overlapping a child of a sensor.
+struct cb2SensorOverlap
+{
+	cb2Fixture* visitor;
+	int visitorProxyId;
+	int sensorChild;
+	int visitorChild;
+};
+
+// A sensor fixture and its overlaps, sorted by sensor child, visitor proxy and
+// visitor child. The candidates are the overlaps found by the current update.
+struct cb2Sensor
+{
+	cb2Fixture* fixture;
+	cb2SensorOverlap* overlaps;
+	int overlapCount;
+	int overlapCapacity;
+	cb2SensorOverlap* candidates;
+	int candidateCount;
+	int candidateCapacity;
+};
+
+// Tracks the fixtures overlapping each sensor without creating contacts. Delegate
+// of cb2World, see cb2World::SetSensorOverlaps.
+class cb2SensorManager
+{
+public:
+	cb2SensorManager();
+	~cb2SensorManager();
+
+	void AddSensor(cb2Fixture* fixture);
+
+	// Forget a sensor. The listener gets the end of its overlaps, unless it is NULL.
+	void RemoveSensor(cb2Fixture* fixture, cb2ContactListener* listener);
+
+	// Forget the overlaps of a fixture that is about to be destroyed, and the fixture
+	// itself if it is a sensor. This scans the overlaps of all sensors.
+	void RemoveFixture(cb2Fixture* fixture, cb2ContactListener* listener);
+
+	// Find the overlaps of all sensors, on the pool when it is set, then report the
+	// overlaps that began and ended in sensor order.
+	void Update(const cb2BroadPhase* broadPhase, cb2ContactFilter* filter, cb2ContactListener* listener,
+				cb2ContactEvents* events, cb2ThreadPool* pool);
+
+	// Fill the candidates of a sensor. The count can exceed the capacity, in which
+	// case Update grows the buffer and runs the sensor again.
+	void FindOverlaps(cb2Sensor* sensor, const cb2BroadPhase* broadPhase) const;
+
+	// Copy the sensors and overlaps of another world, see cb2World::Clone.
+	void Copy(const cb2SensorManager& other, const cb2CloneMap& map);
+
+	int GetSensorCount() const { return m_sensorCount; }
+	const cb2Sensor* GetSensor(int index) const { return m_sensors + index; }
+
+private:
+
+	void ReportChanges(cb2Sensor* sensor, cb2ContactFilter* filter, cb2ContactListener* listener,
+						cb2ContactEvents* events);
+
+	cb2Sensor* m_sensors;
+	int m_sensorCount;
+	int m_sensorCapacity;
+};
+
+#endif
@@ -0,0 +1,204 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
+#include <CinderBox2D/Common/cb2Math.h>
+#include <algorithm>
+
+struct cb2IndexEntryLess
+{
+	template <typename T>
+	bool operator()(const T& a, const T& b) const
+	{
+		return a.object < b.object;
+	}
+};
+
+cb2SnapshotIndex::cb2SnapshotIndex(const void* const* objects, int count)
+{
+	m_count = count;
+	m_entries = (cb2IndexEntry*)cb2Alloc(cb2Max(count, 1) * sizeof(cb2IndexEntry));
+	for (int i = 0; i < count; ++i)
+	{
+		m_entries[i].object = objects[i];
+		m_entries[i].index = i;
+	}
+	std::sort(m_entries, m_entries + count, cb2IndexEntryLess());
+}
+
+cb2SnapshotIndex::~cb2SnapshotIndex()
+{
+	cb2Free(m_entries);
+}
+
+int cb2SnapshotIndex::Find(const void* object) const
+{
+	int low = 0;
+	int high = m_count;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		if (m_entries[mid].object < object)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	if (low < m_count && m_entries[low].object == object)
+	{
+		return m_entries[low].index;
+	}
+	return -1;
+}
+
+// A delta is the size of the snapshot followed by runs. Each run is the number of
+// bytes equal to the base, the number of bytes that differ and those bytes xor the
+// base. Bytes past the end of the base are compared with zero. Counts are 7 bit
+// variable length integers.
+
+static void cb2WriteCount(cb2SnapshotWriter* writer, unsigned int count)
+{
+	while (count >= 0x80)
+	{
+		writer->Write((unsigned char)(count | 0x80));
+		count >>= 7;
+	}
+	writer->Write((unsigned char)count);
+}
+
+static unsigned int cb2ReadCount(cb2SnapshotReader* reader)
+{
+	unsigned int count = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		unsigned char byte = reader->Read<unsigned char>();
+		count |= (unsigned int)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			break;
+		}
+	}
+	return count;
+}
+
+static inline unsigned char cb2BaseByte(const unsigned char* base, int baseSize, int i)
+{
+	return i < baseSize ? base[i] : 0;
+}
+
+// Runs of equal bytes shorter than this are folded into the bytes that differ.
+const int cb2_deltaMinEqualRun = 4;
+
+int cb2EncodeSnapshotDelta(const void* base, int baseSize, const void* snapshot, int size, void* delta, int capacity)
+{
+	const unsigned char* a = (const unsigned char*)base;
+	const unsigned char* b = (const unsigned char*)snapshot;
+
+	cb2SnapshotWriter writer(delta, capacity);
+	cb2WriteCount(&writer, (unsigned int)size);
+
+	int i = 0;
+	while (i < size)
+	{
+		int equalStart = i;
+		while (i < size && b[i] == cb2BaseByte(a, baseSize, i))
+		{
+			++i;
+		}
+		int equalCount = i - equalStart;
+
+		int diffStart = i;
+		while (i < size)
+		{
+			// Stop at a long enough run of equal bytes.
+			int run = 0;
+			while (i + run < size && run < cb2_deltaMinEqualRun && b[i + run] == cb2BaseByte(a, baseSize, i + run))
+			{
+				++run;
+			}
+
+			if (run == cb2_deltaMinEqualRun || i + run == size)
+			{
+				break;
+			}
+
+			i += run + 1;
+		}
+		int diffCount = i - diffStart;
+
+		cb2WriteCount(&writer, (unsigned int)equalCount);
+		cb2WriteCount(&writer, (unsigned int)diffCount);
+		for (int j = diffStart; j < diffStart + diffCount; ++j)
+		{
+			writer.Write((unsigned char)(b[j] ^ cb2BaseByte(a, baseSize, j)));
+		}
+	}
+
+	return writer.GetSize();
+}
+
+int cb2DecodeSnapshotDelta(const void* base, int baseSize, const void* delta, int deltaSize, void* snapshot, int capacity)
+{
+	const unsigned char* a = (const unsigned char*)base;
+	unsigned char* b = (unsigned char*)snapshot;
+
+	cb2SnapshotReader reader(delta, deltaSize);
+	int size = (int)cb2ReadCount(&reader);
+	if (reader.HasFailed() || size < 0)
+	{
+		return 0;
+	}
+
+	if (size > capacity)
+	{
+		return size;
+	}
+
+	int i = 0;
+	while (i < size)
+	{
+		int equalCount = (int)cb2ReadCount(&reader);
+		int diffCount = (int)cb2ReadCount(&reader);
+		if (reader.HasFailed() || equalCount < 0 || diffCount < 0 || equalCount > size - i || diffCount > size - i - equalCount)
+		{
+			return 0;
+		}
+
+		for (int j = i; j < i + equalCount; ++j)
+		{
+			b[j] = cb2BaseByte(a, baseSize, j);
+		}
+		i += equalCount;
+
+		for (int j = i; j < i + diffCount; ++j)
+		{
+			b[j] = reader.Read<unsigned char>() ^ cb2BaseByte(a, baseSize, j);
+		}
+		i += diffCount;
+
+		if (reader.HasFailed())
+		{
+			return 0;
+		}
+	}
+
+	return size;
+}
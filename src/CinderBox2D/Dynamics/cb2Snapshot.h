@@ -0,0 +1,176 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_SNAPSHOT_H
+#define CB2_SNAPSHOT_H
+
+#include <CinderBox2D/Common/cb2Settings.h>
+#include <memory.h>
+
+/// Writes the data of a world snapshot into a caller buffer. Writes past the
+/// capacity are counted but not stored, so a writer with no buffer measures the
+/// size of a snapshot.
+class cb2SnapshotWriter
+{
+public:
+	cb2SnapshotWriter(void* buffer, int capacity)
+	{
+		m_buffer = (char*)buffer;
+		m_capacity = buffer ? capacity : 0;
+		m_size = 0;
+	}
+
+	void WriteBytes(const void* data, int size)
+	{
+		if (m_size + size <= m_capacity)
+		{
+			memcpy(m_buffer + m_size, data, size);
+		}
+		m_size += size;
+	}
+
+	template <typename T>
+	void Write(const T& value)
+	{
+		WriteBytes(&value, sizeof(T));
+	}
+
+	/// Get the number of bytes written, including the ones that did not fit.
+	int GetSize() const { return m_size; }
+
+	/// Did everything fit in the buffer?
+	bool IsComplete() const { return m_size <= m_capacity; }
+
+private:
+	char* m_buffer;
+	int m_capacity;
+	int m_size;
+};
+
+/// Reads the data of a world snapshot. Reads past the end return zeros and
+/// mark the reader as failed.
+class cb2SnapshotReader
+{
+public:
+	cb2SnapshotReader(const void* buffer, int size)
+	{
+		m_buffer = (const char*)buffer;
+		m_size = size;
+		m_offset = 0;
+		m_failed = false;
+	}
+
+	void ReadBytes(void* data, int size)
+	{
+		if (m_failed || m_offset + size > m_size)
+		{
+			memset(data, 0, size);
+			m_failed = true;
+			return;
+		}
+
+		memcpy(data, m_buffer + m_offset, size);
+		m_offset += size;
+	}
+
+	template <typename T>
+	void Read(T* value)
+	{
+		ReadBytes(value, sizeof(T));
+	}
+
+	template <typename T>
+	T Read()
+	{
+		T value;
+		ReadBytes(&value, sizeof(T));
+		return value;
+	}
+
+	/// Get the number of bytes read.
+	int GetOffset() const { return m_offset; }
+
+	/// Did a read run past the end of the snapshot?
+	bool HasFailed() const { return m_failed; }
+
+	/// Mark the snapshot as damaged. Later reads return zeros.
+	void SetFailed() { m_failed = true; }
+
+private:
+	const char* m_buffer;
+	int m_size;
+	int m_offset;
+	bool m_failed;
+};
+
+/// Finds the index of an object in a list, so snapshots can refer to bodies and
+/// fixtures by their place in the world instead of their address.
+class cb2SnapshotIndex
+{
+public:
+	cb2SnapshotIndex(const void* const* objects, int count);
+	~cb2SnapshotIndex();
+
+	/// Get the index of an object, or -1 if it is not in the list.
+	int Find(const void* object) const;
+
+private:
+	struct cb2IndexEntry
+	{
+		const void* object;
+		int index;
+	};
+
+	cb2IndexEntry* m_entries;
+	int m_count;
+};
+
+/// Maps the bodies, fixtures and joints of a world to their copies in a clone.
+class cb2CloneMap
+{
+public:
+	cb2CloneMap(const void* const* objects, void* const* copies, int count)
+		: m_index(objects, count)
+	{
+		m_copies = copies;
+	}
+
+	/// Get the copy of an object, or NULL for NULL or an object that was not copied.
+	template <typename T>
+	T* Find(const T* object) const
+	{
+		int index = m_index.Find(object);
+		return index == -1 ? NULL : (T*)m_copies[index];
+	}
+
+private:
+	cb2SnapshotIndex m_index;
+	void* const* m_copies;
+};
+
+/// Encode a snapshot as the difference from an earlier snapshot of the same world.
+/// Bodies, joints and proxies keep their place in a snapshot, so the unchanged
+/// ones cost a few bytes. Returns the number of bytes the delta needs; nothing is
+/// written when the capacity is smaller.
+int cb2EncodeSnapshotDelta(const void* base, int baseSize, const void* snapshot, int size, void* delta, int capacity);
+
+/// Rebuild a snapshot from its base and a delta made by cb2EncodeSnapshotDelta.
+/// Returns the size of the snapshot, or 0 if the delta is damaged. Nothing is
+/// written when the capacity is smaller than the returned size.
+int cb2DecodeSnapshotDelta(const void* base, int baseSize, const void* delta, int deltaSize, void* snapshot, int capacity);
+
+#endif
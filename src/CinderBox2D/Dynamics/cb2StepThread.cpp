@@ -0,0 +1,92 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Dynamics/cb2StepThread.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
+
+cb2StepThread::cb2StepThread(cb2World* world)
+{
+	m_world = world;
+	m_started = false;
+	m_quit = false;
+	m_done.store(true);
+	m_dt = 0.0f;
+	m_velocityIterations = 0;
+	m_positionIterations = 0;
+	m_thread = std::thread(&cb2StepThread::Main, this);
+}
+
+cb2StepThread::~cb2StepThread()
+{
+	Wait();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_startCondition.notify_one();
+	m_thread.join();
+}
+
+void cb2StepThread::Start(float dt, int velocityIterations, int positionIterations)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		cb2Assert(m_started == false && IsDone());
+		m_dt = dt;
+		m_velocityIterations = velocityIterations;
+		m_positionIterations = positionIterations;
+		m_done.store(false, std::memory_order_relaxed);
+		m_started = true;
+	}
+	m_startCondition.notify_one();
+}
+
+void cb2StepThread::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_started)
+	{
+		m_doneCondition.wait(lock);
+	}
+}
+
+void cb2StepThread::Main()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		while (m_started == false && m_quit == false)
+		{
+			m_startCondition.wait(lock);
+		}
+
+		if (m_quit)
+		{
+			return;
+		}
+
+		lock.unlock();
+		m_world->Step(m_dt, m_velocityIterations, m_positionIterations);
+		m_world->CaptureBodyStates();
+		lock.lock();
+
+		m_started = false;
+		m_done.store(true, std::memory_order_release);
+		m_doneCondition.notify_all();
+	}
+}
@@ -0,0 +1,65 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_STEP_THREAD_H
+#define CB2_STEP_THREAD_H
+
+#include <CinderBox2D/Common/cb2Settings.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class cb2World;
+
+/// A thread that runs the time steps started by cb2World::StepAsync.
+/// The client does not interact with this directly.
+class cb2StepThread
+{
+public:
+	cb2StepThread(cb2World* world);
+	~cb2StepThread();
+
+	/// Start a step. The previous step must have been waited for.
+	void Start(float dt, int velocityIterations, int positionIterations);
+
+	/// Wait for the step to finish. Returns at once when no step was started.
+	void Wait();
+
+	/// Is the step done? True when no step was started.
+	bool IsDone() const { return m_done.load(std::memory_order_acquire); }
+
+private:
+
+	void Main();
+
+	cb2World* m_world;
+	std::thread m_thread;
+
+	std::mutex m_mutex;
+	std::condition_variable m_startCondition;
+	std::condition_variable m_doneCondition;
+	bool m_started;
+	bool m_quit;
+	std::atomic<bool> m_done;
+
+	float m_dt;
+	int m_velocityIterations;
+	int m_positionIterations;
+};
+
+#endif
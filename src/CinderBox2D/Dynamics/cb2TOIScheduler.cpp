@@ -0,0 +1,424 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2TOIScheduler.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2TimeStep.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
+#include <CinderBox2D/Common/cb2ThreadPool.h>
+#include <CinderBox2D/Common/cb2Timer.h>
+#include <algorithm>
+#include <memory.h>
+
+// TOI computations per pool range. They are expensive, so ranges are small.
+const int cb2_toiGrainSize = 8;
+
+// Smaller batches, such as most of those after an event, are cheaper on the calling thread.
+const int cb2_toiParallelCount = 128;
+
+// The standard heap functions keep the largest element on top, so compare in reverse.
+static bool cb2EventGreaterThan(const cb2TOIEvent& a, const cb2TOIEvent& b)
+{
+	if (a.alpha != b.alpha)
+	{
+		return a.alpha > b.alpha;
+	}
+	return a.key > b.key;
+}
+
+class cb2ComputeTOIsTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		scheduler->ComputeTOIs(begin, end);
+	}
+
+	cb2TOIScheduler* scheduler;
+};
+
+bool cb2TOIScheduler::CandidateLessThan(const cb2Contact* a, const cb2Contact* b)
+{
+	return a->m_toiKey < b->m_toiKey;
+}
+
+cb2TOIScheduler::cb2TOIScheduler()
+{
+	m_candidateCapacity = 64;
+	m_candidateCount = 0;
+	m_candidates = (cb2Contact**)cb2Alloc(m_candidateCapacity * sizeof(cb2Contact*));
+
+	m_preparedCapacity = 64;
+	m_preparedCount = 0;
+	m_prepared = (cb2TOICandidate*)cb2Alloc(m_preparedCapacity * sizeof(cb2TOICandidate));
+
+	m_watchCapacity = 16;
+	m_watchCount = 0;
+	m_watched = (cb2Body**)cb2Alloc(m_watchCapacity * sizeof(cb2Body*));
+
+	m_heapCapacity = 64;
+	m_heapCount = 0;
+	m_heap = (cb2TOIEvent*)cb2Alloc(m_heapCapacity * sizeof(cb2TOIEvent));
+
+	m_maxSubSteps = cb2_maxSubSteps;
+	m_bulletsOnly = false;
+
+	m_computeTime = 0.0f;
+	m_callCount = 0;
+	m_iterations = 0;
+	m_rootIterations = 0;
+}
+
+cb2TOIScheduler::~cb2TOIScheduler()
+{
+	cb2Free(m_candidates);
+	cb2Free(m_prepared);
+	cb2Free(m_watched);
+	cb2Free(m_heap);
+}
+
+void cb2TOIScheduler::Clear()
+{
+	m_candidateCount = 0;
+	m_preparedCount = 0;
+	m_watchCount = 0;
+	m_heapCount = 0;
+
+	m_computeTime = 0.0f;
+	m_callCount = 0;
+	m_iterations = 0;
+	m_rootIterations = 0;
+}
+
+void cb2TOIScheduler::SetMaxSubSteps(int count)
+{
+	// The TOI count of a contact is a byte.
+	cb2Assert(count >= 0 && count < 255);
+	m_maxSubSteps = count;
+}
+
+void cb2TOIScheduler::AddCandidate(cb2Contact* contact)
+{
+	if (m_candidateCount == m_candidateCapacity)
+	{
+		cb2Contact** old = m_candidates;
+		m_candidateCapacity *= 2;
+		m_candidates = (cb2Contact**)cb2Alloc(m_candidateCapacity * sizeof(cb2Contact*));
+		memcpy(m_candidates, old, m_candidateCount * sizeof(cb2Contact*));
+		cb2Free(old);
+	}
+
+	m_candidates[m_candidateCount] = contact;
+	++m_candidateCount;
+}
+
+void cb2TOIScheduler::AddBodyContacts(cb2Body* body)
+{
+	// Static bodies are never active, so their contacts change with the other body.
+	if (body->m_type == cb2_staticBody)
+	{
+		return;
+	}
+
+	for (cb2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
+	{
+		AddCandidate(ce->contact);
+	}
+}
+
+void cb2TOIScheduler::WatchNeighbors(cb2Body* body)
+{
+	// Updating the contacts of a dynamic body can wake the bodies it touches.
+	if (body->m_type != cb2_dynamicBody)
+	{
+		return;
+	}
+
+	for (cb2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
+	{
+		cb2Body* other = ce->other;
+		if (other->m_type == cb2_staticBody || other->IsAwake())
+		{
+			continue;
+		}
+
+		if (m_watchCount == m_watchCapacity)
+		{
+			cb2Body** old = m_watched;
+			m_watchCapacity *= 2;
+			m_watched = (cb2Body**)cb2Alloc(m_watchCapacity * sizeof(cb2Body*));
+			memcpy(m_watched, old, m_watchCount * sizeof(cb2Body*));
+			cb2Free(old);
+		}
+
+		m_watched[m_watchCount] = other;
+		++m_watchCount;
+	}
+}
+
+void cb2TOIScheduler::Update(cb2ThreadPool* threadPool)
+{
+	// Sleeping bodies that were woken now take part.
+	for (int i = 0; i < m_watchCount; ++i)
+	{
+		if (m_watched[i]->IsAwake())
+		{
+			AddBodyContacts(m_watched[i]);
+		}
+	}
+	m_watchCount = 0;
+
+	// Drop the candidates that have a valid TOI or need none. This does not depend on order.
+	int pendingCount = 0;
+	for (int i = 0; i < m_candidateCount; ++i)
+	{
+		cb2Contact* c = m_candidates[i];
+
+		// Is this contact disabled?
+		if (c->IsEnabled() == false)
+		{
+			continue;
+		}
+
+		// Prevent excessive sub-stepping.
+		if (c->m_toiCount > m_maxSubSteps)
+		{
+			continue;
+		}
+
+		// Does this contact have a valid cached TOI? Then it is already queued.
+		if (c->m_flags & cb2Contact::e_toiFlag)
+		{
+			continue;
+		}
+
+		cb2Fixture* fA = c->GetFixtureA();
+		cb2Fixture* fB = c->GetFixtureB();
+
+		// Is there a sensor?
+		if (fA->IsSensor() || fB->IsSensor())
+		{
+			continue;
+		}
+
+		cb2Body* bA = fA->GetBody();
+		cb2Body* bB = fB->GetBody();
+
+		cb2BodyType typeA = bA->m_type;
+		cb2BodyType typeB = bB->m_type;
+		cb2Assert(typeA == cb2_dynamicBody || typeB == cb2_dynamicBody);
+
+		// Bodies at a level of detail without continuous collision keep their motion.
+		bool activeA = bA->IsAwake() && typeA != cb2_staticBody && (bA->m_flags & cb2Body::e_lodFlag) == 0;
+		bool activeB = bB->IsAwake() && typeB != cb2_staticBody && (bB->m_flags & cb2Body::e_lodFlag) == 0;
+
+		// Is at least one body active (awake and dynamic or kinematic)?
+		if (activeA == false && activeB == false)
+		{
+			continue;
+		}
+
+		bool collideA = bA->IsBullet() || (typeA != cb2_dynamicBody && m_bulletsOnly == false);
+		bool collideB = bB->IsBullet() || (typeB != cb2_dynamicBody && m_bulletsOnly == false);
+
+		// Are these two non-bullet dynamic bodies?
+		if (collideA == false && collideB == false)
+		{
+			continue;
+		}
+
+		m_candidates[pendingCount] = c;
+		++pendingCount;
+	}
+
+	// Visit the rest in scan order, since advancing the sweeps depends on it.
+	std::sort(m_candidates, m_candidates + pendingCount, CandidateLessThan);
+
+	if (m_preparedCapacity < pendingCount)
+	{
+		cb2Free(m_prepared);
+		while (m_preparedCapacity < pendingCount)
+		{
+			m_preparedCapacity *= 2;
+		}
+		m_prepared = (cb2TOICandidate*)cb2Alloc(m_preparedCapacity * sizeof(cb2TOICandidate));
+	}
+
+	m_preparedCount = 0;
+	for (int i = 0; i < pendingCount; ++i)
+	{
+		cb2Contact* c = m_candidates[i];
+		if (i > 0 && c == m_candidates[i - 1])
+		{
+			continue;
+		}
+
+		cb2Fixture* fA = c->GetFixtureA();
+		cb2Fixture* fB = c->GetFixtureB();
+		cb2Body* bA = fA->GetBody();
+		cb2Body* bB = fB->GetBody();
+
+		// Put the sweeps onto the same time interval.
+		float alpha0 = bA->m_sweep.alpha0;
+
+		if (bA->m_sweep.alpha0 < bB->m_sweep.alpha0)
+		{
+			alpha0 = bB->m_sweep.alpha0;
+			bA->m_sweep.Advance(alpha0);
+		}
+		else if (bB->m_sweep.alpha0 < bA->m_sweep.alpha0)
+		{
+			alpha0 = bA->m_sweep.alpha0;
+			bB->m_sweep.Advance(alpha0);
+		}
+
+		cb2Assert(alpha0 < 1.0f);
+
+		// Copy the sweeps now. Later candidates may advance the same bodies.
+		cb2TOICandidate* candidate = m_prepared + m_preparedCount;
+		++m_preparedCount;
+		candidate->contact = c;
+		candidate->input.proxyA.set(fA->GetShape(), c->GetChildIndexA());
+		candidate->input.proxyB.set(fB->GetShape(), c->GetChildIndexB());
+		candidate->input.sweepA = bA->m_sweep;
+		candidate->input.sweepB = bB->m_sweep;
+		candidate->input.tMax = 1.0f;
+		candidate->alpha0 = alpha0;
+		candidate->alpha = 1.0f;
+	}
+
+	m_candidateCount = 0;
+
+	cb2Timer timer;
+
+	if (threadPool && m_preparedCount >= cb2_toiParallelCount)
+	{
+		cb2ComputeTOIsTask task;
+		task.scheduler = this;
+		threadPool->ParallelFor(&task, m_preparedCount, cb2_toiGrainSize);
+	}
+	else
+	{
+		ComputeTOIs(0, m_preparedCount);
+	}
+
+	m_computeTime += timer.GetMilliseconds();
+	m_callCount += m_preparedCount;
+
+	for (int i = 0; i < m_preparedCount; ++i)
+	{
+		cb2TOICandidate* candidate = m_prepared + i;
+		m_iterations += candidate->iterations;
+		m_rootIterations += candidate->rootIterations;
+
+		cb2Contact* c = candidate->contact;
+		c->m_toi = candidate->alpha;
+		c->m_flags |= cb2Contact::e_toiFlag;
+		Push(candidate->alpha, c);
+	}
+
+	m_preparedCount = 0;
+}
+
+void cb2TOIScheduler::ComputeTOIs(int begin, int end)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		cb2TOICandidate* candidate = m_prepared + i;
+
+		// Compute the time of impact in interval [0, minTOI]
+		cb2TOIOutput output;
+		cb2TimeOfImpact(&output, &candidate->input, &candidate->contact->m_simplexCache);
+		candidate->iterations = output.iterations;
+		candidate->rootIterations = output.rootIterations;
+
+		// Beta is the fraction of the remaining portion of the sweep.
+		float beta = output.t;
+		if (output.state == cb2TOIOutput::e_touching)
+		{
+			candidate->alpha = cb2Min(candidate->alpha0 + (1.0f - candidate->alpha0) * beta, 1.0f);
+		}
+		else
+		{
+			candidate->alpha = 1.0f;
+		}
+	}
+}
+
+void cb2TOIScheduler::AddProfile(cb2Profile* profile) const
+{
+	profile->toiCompute += m_computeTime;
+	profile->toiCallCount += m_callCount;
+	profile->toiIterations += m_iterations;
+	profile->toiRootIterations += m_rootIterations;
+}
+
+cb2Contact* cb2TOIScheduler::PopMin(float* alpha)
+{
+	while (m_heapCount > 0)
+	{
+		cb2TOIEvent top = m_heap[0];
+		std::pop_heap(m_heap, m_heap + m_heapCount, cb2EventGreaterThan);
+		--m_heapCount;
+
+		if (IsValid(top))
+		{
+			*alpha = top.alpha;
+			return top.contact;
+		}
+	}
+
+	return NULL;
+}
+
+void cb2TOIScheduler::Push(float alpha, cb2Contact* contact)
+{
+	// Only events inside the step can be the next one.
+	if (alpha >= 1.0f)
+	{
+		return;
+	}
+
+	if (m_heapCount == m_heapCapacity)
+	{
+		cb2TOIEvent* old = m_heap;
+		m_heapCapacity *= 2;
+		m_heap = (cb2TOIEvent*)cb2Alloc(m_heapCapacity * sizeof(cb2TOIEvent));
+		memcpy(m_heap, old, m_heapCount * sizeof(cb2TOIEvent));
+		cb2Free(old);
+	}
+
+	cb2TOIEvent* e = m_heap + m_heapCount;
+	e->alpha = alpha;
+	e->key = contact->m_toiKey;
+	e->contact = contact;
+	++m_heapCount;
+	std::push_heap(m_heap, m_heap + m_heapCount, cb2EventGreaterThan);
+}
+
+bool cb2TOIScheduler::IsValid(const cb2TOIEvent& e) const
+{
+	// Events go stale when their contact is disabled, invalidated or recomputed.
+	const cb2Contact* c = e.contact;
+	return c->IsEnabled() &&
+		c->m_toiCount <= m_maxSubSteps &&
+		(c->m_flags & cb2Contact::e_toiFlag) &&
+		c->m_toi == e.alpha;
+}
@@ -0,0 +1,126 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_TOI_SCHEDULER_H
+#define CB2_TOI_SCHEDULER_H
+
+#include <CinderBox2D/Collision/cb2TimeOfImpact.h>
+
+class cb2Body;
+class cb2Contact;
+class cb2ThreadPool;
+struct cb2Profile;
+
+/// A contact waiting for its time of impact, with the sweeps it is computed from.
+struct cb2TOICandidate
+{
+	cb2Contact* contact;
+	cb2TOIInput input;
+	float alpha0;
+	float alpha;
+	int iterations;
+	int rootIterations;
+};
+
+/// A queued time of impact. Ties are broken by the contact's scan key.
+struct cb2TOIEvent
+{
+	float alpha;
+	int key;
+	cb2Contact* contact;
+};
+
+/// Finds the time of impact events of a step in order. The TOIs of a batch of
+/// candidate contacts are computed together, on a thread pool when one is given,
+/// and kept in a min-heap. After an event only the contacts of the bodies it
+/// moved or woke need to be offered again.
+/// Events come out in the same order as a full scan of the contact list,
+/// provided each contact's m_toiKey is its position in that scan.
+class cb2TOIScheduler
+{
+public:
+	cb2TOIScheduler();
+	~cb2TOIScheduler();
+
+	/// Remove all candidates and queued events and reset the statistics.
+	void Clear();
+
+	/// Set the maximum number of TOI events of a contact per step.
+	void SetMaxSubSteps(int count);
+	int GetMaxSubSteps() const { return m_maxSubSteps; }
+
+	/// Only sweep contacts with a bullet. The default also sweeps dynamic bodies
+	/// against static and kinematic ones.
+	void SetBulletsOnly(bool flag) { m_bulletsOnly = flag; }
+
+	/// Offer a contact. Duplicates are ignored.
+	void AddCandidate(cb2Contact* contact);
+
+	/// Offer the contacts of a body, unless it is static.
+	void AddBodyContacts(cb2Body* body);
+
+	/// Remember the sleeping bodies touching a dynamic body. The next update
+	/// offers the contacts of those that have been woken since.
+	void WatchNeighbors(cb2Body* body);
+
+	/// Compute the TOIs of the candidates that do not have a valid one and queue
+	/// them. This advances body sweeps onto a common time interval, in key order.
+	void Update(cb2ThreadPool* threadPool);
+
+	/// Remove and return the first event that is still valid, or NULL.
+	cb2Contact* PopMin(float* alpha);
+
+	/// Compute the TOIs of the prepared candidates [begin, end).
+	void ComputeTOIs(int begin, int end);
+
+	/// Add the TOI computations since the last clear to the profile.
+	void AddProfile(cb2Profile* profile) const;
+
+private:
+
+	static bool CandidateLessThan(const cb2Contact* a, const cb2Contact* b);
+
+	void Push(float alpha, cb2Contact* contact);
+	bool IsValid(const cb2TOIEvent& e) const;
+
+	cb2Contact** m_candidates;
+	int m_candidateCount;
+	int m_candidateCapacity;
+
+	cb2TOICandidate* m_prepared;
+	int m_preparedCount;
+	int m_preparedCapacity;
+
+	cb2Body** m_watched;
+	int m_watchCount;
+	int m_watchCapacity;
+
+	cb2TOIEvent* m_heap;
+	int m_heapCount;
+	int m_heapCapacity;
+
+	int m_maxSubSteps;
+	bool m_bulletsOnly;
+
+	float m_computeTime;
+	int m_callCount;
+	int m_iterations;
+	int m_rootIterations;
+};
+
+#endif
@@ -0,0 +1,281 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Dynamics/cb2TargetDrives.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
+#include <CinderBox2D/Dynamics/cb2TimeStep.h>
+#include <string.h>
+
+cb2TargetDrives::cb2TargetDrives()
+{
+	m_drives = NULL;
+	m_capacity = 0;
+	m_count = 0;
+	m_freeList = -1;
+}
+
+cb2TargetDrives::~cb2TargetDrives()
+{
+	cb2Free(m_drives);
+}
+
+void cb2TargetDrives::Reserve(int capacity)
+{
+	if (capacity <= m_capacity)
+	{
+		return;
+	}
+
+	cb2TargetDrive* old = m_drives;
+	m_drives = (cb2TargetDrive*)cb2Alloc(capacity * sizeof(cb2TargetDrive));
+	if (old)
+	{
+		memcpy(m_drives, old, m_capacity * sizeof(cb2TargetDrive));
+		cb2Free(old);
+	}
+
+	// Thread the new slots onto the free list in order.
+	for (int i = capacity - 1; i >= m_capacity; --i)
+	{
+		m_drives[i].body = NULL;
+		m_drives[i].bodyNext = m_freeList;
+		m_freeList = i;
+	}
+	m_capacity = capacity;
+}
+
+int cb2TargetDrives::Create(const cb2TargetDriveDef* def)
+{
+	cb2Body* body = def->body;
+	cb2Assert(body != NULL && body->GetType() == cb2_dynamicBody);
+	cb2Assert(cb2::isValid(def->target));
+	cb2Assert(cb2::isValid(def->maxForce) && def->maxForce >= 0.0f);
+	cb2Assert(cb2::isValid(def->frequencyHz) && def->frequencyHz >= 0.0f);
+	cb2Assert(cb2::isValid(def->dampingRatio) && def->dampingRatio >= 0.0f);
+
+	if (m_freeList == -1)
+	{
+		Reserve(cb2Max(2 * m_capacity, 16));
+	}
+
+	int index = m_freeList;
+	cb2TargetDrive* drive = m_drives + index;
+	m_freeList = drive->bodyNext;
+
+	drive->body = body;
+	drive->localAnchor = cb2MulT(body->GetTransform(), def->target);
+	drive->target = def->target;
+	drive->maxForce = def->maxForce;
+	drive->frequencyHz = def->frequencyHz;
+	drive->dampingRatio = def->dampingRatio;
+	cb2::setZero(drive->impulse);
+	drive->islandNext = -1;
+
+	drive->bodyNext = body->m_targetDriveList;
+	body->m_targetDriveList = index;
+	++m_count;
+
+	body->SetAwake(true);
+	return index;
+}
+
+void cb2TargetDrives::Destroy(int index)
+{
+	cb2Assert(0 <= index && index < m_capacity && m_drives[index].body != NULL);
+	cb2TargetDrive* drive = m_drives + index;
+
+	// Unlink from the drives of the body.
+	int* link = &drive->body->m_targetDriveList;
+	while (*link != index)
+	{
+		cb2Assert(*link != -1);
+		link = &m_drives[*link].bodyNext;
+	}
+	*link = drive->bodyNext;
+
+	drive->body = NULL;
+	drive->bodyNext = m_freeList;
+	m_freeList = index;
+	--m_count;
+}
+
+void cb2TargetDrives::DestroyBodyDrives(cb2Body* body)
+{
+	while (body->m_targetDriveList != -1)
+	{
+		Destroy(body->m_targetDriveList);
+	}
+}
+
+void cb2TargetDrives::SetTargets(const int* drives, const ci::Vec2f* targets, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		int index = drives[i];
+		cb2Assert(0 <= index && index < m_capacity && m_drives[index].body != NULL);
+		cb2TargetDrive* drive = m_drives + index;
+		if (drive->target == targets[i])
+		{
+			continue;
+		}
+
+		drive->target = targets[i];
+		if (drive->body->IsAwake() == false)
+		{
+			drive->body->SetAwake(true);
+		}
+	}
+}
+
+void cb2TargetDrives::ShiftOrigin(const ci::Vec2f& newOrigin)
+{
+	for (int i = 0; i < m_capacity; ++i)
+	{
+		if (m_drives[i].body)
+		{
+			m_drives[i].target -= newOrigin;
+		}
+	}
+}
+
+void cb2TargetDrives::Copy(const cb2TargetDrives& other, const cb2CloneMap& map)
+{
+	cb2Free(m_drives);
+	m_drives = NULL;
+	m_capacity = 0;
+	m_freeList = -1;
+	Reserve(other.m_capacity);
+
+	if (m_capacity > 0)
+	{
+		memcpy(m_drives, other.m_drives, m_capacity * sizeof(cb2TargetDrive));
+	}
+	for (int i = 0; i < m_capacity; ++i)
+	{
+		m_drives[i].body = map.Find(other.m_drives[i].body);
+	}
+	m_count = other.m_count;
+	m_freeList = other.m_freeList;
+}
+
+int cb2TargetDrives::InitVelocityConstraints(cb2Body* const* bodies, int first, int count, const cb2SolverData& data)
+{
+	int head = -1;
+	for (int i = first; i < count; ++i)
+	{
+		cb2Body* body = bodies[i];
+		if (body->m_type != cb2_dynamicBody)
+		{
+			continue;
+		}
+
+		for (int index = body->m_targetDriveList; index != -1; index = m_drives[index].bodyNext)
+		{
+			cb2TargetDrive* drive = m_drives + index;
+			drive->islandNext = head;
+			head = index;
+
+			// The same soft constraint as cb2MouseJoint.
+			drive->indexB = body->m_islandIndex;
+			drive->invMassB = body->m_invMass;
+			drive->invIB = body->m_invI;
+
+			ci::Vec2f cB = data.positions[drive->indexB].c;
+			float aB = data.positions[drive->indexB].a;
+			ci::Vec2f vB = data.velocities[drive->indexB].v;
+			float wB = data.velocities[drive->indexB].w;
+
+			cb2Rot qB(aB);
+
+			float mass = body->m_mass;
+			float omega = 2.0f * cb2_pi * drive->frequencyHz;
+			float d = 2.0f * mass * drive->dampingRatio * omega;
+			float k = mass * (omega * omega);
+
+			float h = data.step.dt;
+			cb2Assert(d + h * k > cb2_epsilon);
+			drive->gamma = h * (d + h * k);
+			if (drive->gamma != 0.0f)
+			{
+				drive->gamma = 1.0f / drive->gamma;
+			}
+			float beta = h * k * drive->gamma;
+
+			drive->rB = cb2Mul(qB, drive->localAnchor - body->m_sweep.localCenter);
+			ci::Vec2f rB = drive->rB;
+
+			ci::Matrix22f K;
+			K.m00 = drive->invMassB + drive->invIB * rB.y * rB.y + drive->gamma;
+			K.m01 = -drive->invIB * rB.x * rB.y;
+			K.m10 = K.m01;
+			K.m11 = drive->invMassB + drive->invIB * rB.x * rB.x + drive->gamma;
+			drive->mass = K.inverted();
+
+			drive->C = beta * (cB + rB - drive->target);
+
+			// Cheat with some damping
+			wB *= 0.98f;
+
+			if (data.step.warmStarting)
+			{
+				drive->impulse *= data.step.dtRatio;
+				vB += drive->invMassB * drive->impulse;
+				wB += drive->invIB * cb2Cross(rB, drive->impulse);
+			}
+			else
+			{
+				cb2::setZero(drive->impulse);
+			}
+
+			data.velocities[drive->indexB].v = vB;
+			data.velocities[drive->indexB].w = wB;
+		}
+	}
+
+	return head;
+}
+
+void cb2TargetDrives::SolveVelocityConstraints(int index, const cb2SolverData& data)
+{
+	for (; index != -1; index = m_drives[index].islandNext)
+	{
+		cb2TargetDrive* drive = m_drives + index;
+		ci::Vec2f vB = data.velocities[drive->indexB].v;
+		float wB = data.velocities[drive->indexB].w;
+
+		// Cdot = v + cross(w, r)
+		ci::Vec2f Cdot = vB + cb2Cross(wB, drive->rB);
+		ci::Vec2f impulse = cb2Mul(drive->mass, -(Cdot + drive->C + drive->gamma * drive->impulse));
+
+		ci::Vec2f oldImpulse = drive->impulse;
+		drive->impulse += impulse;
+		float maxImpulse = data.step.dt * drive->maxForce;
+		if (drive->impulse.lengthSquared() > maxImpulse * maxImpulse)
+		{
+			drive->impulse *= maxImpulse / drive->impulse.length();
+		}
+		impulse = drive->impulse - oldImpulse;
+
+		vB += drive->invMassB * impulse;
+		wB += drive->invIB * cb2Cross(drive->rB, impulse);
+
+		data.velocities[drive->indexB].v = vB;
+		data.velocities[drive->indexB].w = wB;
+	}
+}
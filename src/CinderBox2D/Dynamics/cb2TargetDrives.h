@@ -0,0 +1,131 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_TARGET_DRIVES_H
+#define CB2_TARGET_DRIVES_H
+
+#include <CinderBox2D/Common/cb2Math.h>
+
+class cb2Body;
+class cb2CloneMap;
+struct cb2SolverData;
+
+/// Target drive definitions are used to create target drives, see cb2World::CreateTargetDrive.
+struct cb2TargetDriveDef
+{
+	cb2TargetDriveDef()
+	{
+		body = NULL;
+		cb2::setZero(target);
+		maxForce = 0.0f;
+		frequencyHz = 5.0f;
+		dampingRatio = 0.7f;
+	}
+
+	/// The dynamic body that is pulled.
+	cb2Body* body;
+
+	/// The initial world target point. The body is grabbed at this point.
+	ci::Vec2f target;
+
+	/// The maximum constraint force that can be exerted
+	/// to move the candidate body. Usually you will express
+	/// as some multiple of the weight (multiplier * mass * gravity).
+	float maxForce;
+
+	/// The response speed.
+	float frequencyHz;
+
+	/// The damping ratio. 0 = no damping, 1 = critical damping.
+	float dampingRatio;
+};
+
+/// A soft point constraint that pulls a point of a body towards a target, like
+/// cb2MouseJoint, kept in a pool instead of the joint list.
+struct cb2TargetDrive
+{
+	cb2Body* body;				///< NULL while the slot is free
+	ci::Vec2f localAnchor;
+	ci::Vec2f target;
+	float maxForce;
+	float frequencyHz;
+	float dampingRatio;
+	ci::Vec2f impulse;
+
+	int bodyNext;				///< the next drive of the body, or the next free slot
+	int islandNext;				///< the next drive of the island being solved
+
+	// Solver temporaries
+	int indexB;
+	ci::Vec2f rB;
+	ci::Matrix22f mass;
+	ci::Vec2f C;
+	float gamma;
+	float invMassB;
+	float invIB;
+};
+
+/// The target drives of a world. The slots are reused, so creating and destroying
+/// drives allocates only when the pool grows, and a drive is known by its slot.
+/// The drives of a body are solved by the island of the body.
+class cb2TargetDrives
+{
+public:
+	cb2TargetDrives();
+	~cb2TargetDrives();
+
+	int Create(const cb2TargetDriveDef* def);
+	void Destroy(int drive);
+
+	/// Destroy the drives of a body that is being destroyed.
+	void DestroyBodyDrives(cb2Body* body);
+
+	/// Set the targets of several drives. A drive whose target moved wakes its body.
+	void SetTargets(const int* drives, const ci::Vec2f* targets, int count);
+
+	const cb2TargetDrive& GetDrive(int drive) const
+	{
+		cb2Assert(0 <= drive && drive < m_capacity && m_drives[drive].body != NULL);
+		return m_drives[drive];
+	}
+
+	int GetCount() const { return m_count; }
+
+	void ShiftOrigin(const ci::Vec2f& newOrigin);
+
+	/// Copy the drives of another world, keeping the slots.
+	void Copy(const cb2TargetDrives& other, const cb2CloneMap& map);
+
+	/// Link the drives of the island bodies from first on and initialize their
+	/// constraints. Returns the first linked drive, or -1.
+	int InitVelocityConstraints(cb2Body* const* bodies, int first, int count, const cb2SolverData& data);
+
+	/// Solve the velocity constraints of the drives linked by InitVelocityConstraints.
+	void SolveVelocityConstraints(int drive, const cb2SolverData& data);
+
+private:
+
+	void Reserve(int capacity);
+
+	cb2TargetDrive* m_drives;
+	int m_capacity;
+	int m_count;
+	int m_freeList;
+};
+
+#endif
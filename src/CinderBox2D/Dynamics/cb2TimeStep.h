@@ -21,6 +21,8 @@
 
 #include <CinderBox2D/Common/cb2Math.h>
 
+class cb2Body;
+
 /// Profiling data. Times are in milliseconds.
 struct cb2Profile
 {
@@ -32,6 +34,33 @@ struct cb2Profile
 	float solvePosition;
 	float broadphase;
 	float solveTOI;
+	float particles;		// time spent stepping the particle systems
+	float toiCompute;		// time spent in cb2TimeOfImpact, part of solveTOI
+	float toiSolve;			// time spent solving TOI islands, part of solveTOI
+	int toiEventCount;		// TOI events solved or rejected
+	int toiCallCount;		// calls to cb2TimeOfImpact
+	int toiIterations;		// separating axes tried by those calls
+	int toiRootIterations;	// root finder iterations of those calls
+	bool toiDeferred;		// the TOI budget deferred the remaining events to the next step
+	int maxStackAllocation;	// high-water mark of the step stack allocators, in bytes
+	int velocityIterations;	// velocity passes run, summed over the islands
+	int positionIterations;	// position passes run, summed over the islands
+	int maxVelocityIterations;	// most velocity passes run by one island
+	int islandCount;		// islands solved
+	int islandContactCount;	// touching contacts solved by the islands
+	int deferredIslands;	// islands deferred by the solve budget
+	float maxSolveDebt;		// the most time owed by a deferred island, in milliseconds
+	int jointsBroken;		// joints broken by their break force or torque
+	int contactsCreated;	// contacts created since the last step
+	int contactsDestroyed;	// contacts destroyed since the last step
+	int treeQueries;		// broad-phase tree queries for new pairs
+};
+
+/// The kind of contact solver used by cb2World::Step.
+enum cb2SolverType
+{
+	cb2_iterativeSolver,	///< velocity iterations followed by position iterations
+	cb2_softStepSolver		///< substeps with soft contacts and relaxation
 };
 
 /// This is an internal structure.
@@ -43,6 +72,18 @@ struct cb2TimeStep
 	int velocityIterations;
 	int positionIterations;
 	bool warmStarting;
+	bool wideContactSolver;	// solve contacts four at a time
+	bool speculativeContacts;	// contact points may be apart, see cb2World::SetSpeculativeContacts
+	bool contactReduction;	// see cb2World::SetContactReduction
+	bool earlySleep;	// see cb2World::SetEarlySleep
+	bool batchIntegration;	// see cb2World::SetBatchIntegration
+	cb2SolverType solverType;	// see cb2World::SetSolverType
+	int subStepCount;	// substeps of the soft step solver
+	float impulseTolerance;	// see cb2World::SetImpulseTolerance
+	bool jointBatching;	// see cb2World::SetJointBatching
+	bool spatialOrdering;	// see cb2World::SetSpatialOrdering
+	bool directJointSolver;	// see cb2World::SetDirectJointSolver
+	float postSolveThreshold;	// see cb2World::SetPostSolveThreshold
 };
 
 /// This is an internal structure.
@@ -65,6 +106,8 @@ struct cb2SolverData
 	cb2TimeStep step;
 	cb2Position* positions;
 	cb2Velocity* velocities;
+	cb2Body** staticBodies;	///< static bodies shared with other islands, see cb2Body::GetIslandIndex
+	int staticCount;
 };
 
 #endif
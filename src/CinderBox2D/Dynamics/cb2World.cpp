@@ -18,23 +18,44 @@
 
 #include <CinderBox2D/Dynamics/cb2World.h>
 #include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2CommandBuffer.h>
+#include <CinderBox2D/Dynamics/cb2ContactEvents.h>
 #include <CinderBox2D/Dynamics/cb2Fixture.h>
 #include <CinderBox2D/Dynamics/cb2Island.h>
+#include <CinderBox2D/Dynamics/cb2MaterialTable.h>
+#include <CinderBox2D/Dynamics/cb2QuerySnapshot.h>
+#include <CinderBox2D/Dynamics/cb2SensorManager.h>
+#include <CinderBox2D/Dynamics/cb2Snapshot.h>
+#include <CinderBox2D/Dynamics/cb2StepThread.h>
+#include <CinderBox2D/Dynamics/cb2RayQueries.h>
+#include <CinderBox2D/Dynamics/cb2TargetDrives.h>
 #include <CinderBox2D/Dynamics/Joints/cb2PulleyJoint.h>
+#include <CinderBox2D/Dynamics/Joints/cb2RevoluteJoint.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2Contact.h>
 #include <CinderBox2D/Dynamics/Contacts/cb2ContactSolver.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2ImpulseCache.h>
+#include <CinderBox2D/Dynamics/Contacts/cb2PolygonContact.h>
+#include <CinderBox2D/Particle/cb2ParticleSystem.h>
 #include <CinderBox2D/Collision/cb2Collision.h>
 #include <CinderBox2D/Collision/cb2BroadPhase.h>
 #include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
 #include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2HeightfieldShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CompoundShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChildQuery.h>
 #include <CinderBox2D/Collision/cb2TimeOfImpact.h>
 #include <CinderBox2D/Common/cb2Draw.h>
+#include <CinderBox2D/Common/cb2ThreadPool.h>
 #include <CinderBox2D/Common/cb2Timer.h>
+#include <CinderBox2D/Common/cb2Profiler.h>
 #include <new>
+#include <stdio.h>
 
 cb2World::cb2World(const ci::Vec2f& gravity)
+	: m_islandGraph(&m_blockAllocator)
 {
 	m_destructionListener = NULL;
 	g_debugDraw = NULL;
@@ -45,12 +66,91 @@ cb2World::cb2World(const ci::Vec2f& gravity)
 	m_bodyCount = 0;
 	m_jointCount = 0;
 
+	m_stackAllocator = &m_ownStackAllocator;
+	m_threadPool = NULL;
+	m_threadAllocators = NULL;
+	m_splitIslands = false;
+	m_deterministic = false;
+	m_profiler = NULL;
+	m_persistentIslands = false;
+
+	m_awakeBodies = NULL;
+	m_awakeBodyCount = 0;
+	m_awakeBodyCapacity = 0;
+
+	m_freeBodyIds = NULL;
+
+	m_stepThread = NULL;
+	m_asyncStep = false;
+	for (int i = 0; i < 2; ++i)
+	{
+		m_bodyStates[i] = NULL;
+		m_bodyStateCount[i] = 0;
+		m_bodyStateCapacity[i] = 0;
+	}
+	m_frontBodyStates = 0;
+
+	m_commands = NULL;
+	m_commandCount = 0;
+	m_commandCapacity = 0;
+
+	m_commandBuffers = NULL;
+	m_commandBufferCount = 0;
+	m_commandBufferCapacity = 0;
+	m_freeBodyIdCount = 0;
+	m_freeBodyIdCapacity = 0;
+	m_bodyIdCount = 0;
+	m_bodiesById = NULL;
+	m_bodiesByIdCapacity = 0;
+
+	m_transforms = NULL;
+	m_transformBodies = NULL;
+	m_transformCapacity = 0;
+	m_transformCount = 0;
+
+	m_contactEvents = NULL;
+	m_sensorManager = NULL;
+	m_materials = NULL;
+	m_targetDrives = NULL;
+	m_rayQueries = NULL;
+	m_particleSystemList = NULL;
+	m_particleSystemCount = 0;
+	m_lodLevelCount = 0;
+	m_lodObserverCount = 0;
+	m_origin.set(0.0, 0.0);
+	m_originFocus.set(0.0, 0.0);
+	m_originCellSize = 0.0f;
+	m_solveBudget = 0.0f;
+	m_hitEventThreshold = 1.0f;
+
+	m_querySnapshots[0] = NULL;
+	m_querySnapshots[1] = NULL;
+	m_querySnapshots[2] = NULL;
+	m_publishedSnapshot = NULL;
+	m_stepCount = 0;
+
 	m_warmStarting = true;
+	m_wideContactSolver = false;
+	m_speculativeContacts = false;
+	m_contactReduction = false;
+	m_earlySleep = false;
+	m_impulseTolerance = 0.0f;
+	m_postSolveThreshold = 0.0f;
+	m_jointBatching = false;
+	m_spatialOrdering = false;
+	m_directJointSolver = false;
+	m_batchIntegration = false;
+	m_solverType = cb2_iterativeSolver;
+	m_subStepCount = 4;
 	m_continuousPhysics = true;
 	m_subStepping = false;
 
 	m_stepComplete = true;
 
+	m_maxTOIContacts = cb2_maxTOIContacts;
+	m_toiEventBudget = 0;
+	m_toiTimeBudget = 0.0f;
+
 	m_allowSleep = true;
 	m_gravity = gravity;
 
@@ -58,6 +158,12 @@ cb2World::cb2World(const ci::Vec2f& gravity)
 
 	m_inv_dt0 = 0.0f;
 
+	m_fixedTimeStep = 1.0f / 60.0f;
+	m_fixedVelocityIterations = 8;
+	m_fixedPositionIterations = 3;
+	m_maxFixedSteps = 5;
+	m_accumulator = 0.0f;
+
 	m_contactManager.m_allocator = &m_blockAllocator;
 
 	memset(&m_profile, 0, sizeof(cb2Profile));
@@ -65,6 +171,42 @@ cb2World::cb2World(const ci::Vec2f& gravity)
 
 cb2World::~cb2World()
 {
+	if (m_stepThread)
+	{
+		WaitStep();
+		m_stepThread->~cb2StepThread();
+		cb2Free(m_stepThread);
+	}
+	cb2Free(m_bodyStates[0]);
+	cb2Free(m_bodyStates[1]);
+	cb2Free(m_commands);
+	cb2Free(m_commandBuffers);
+
+	SetQuerySnapshots(false);
+	SetContactEvents(false);
+	SetSensorOverlaps(false);
+	cb2Free(m_materials);
+
+	if (m_targetDrives)
+	{
+		m_targetDrives->~cb2TargetDrives();
+		cb2Free(m_targetDrives);
+	}
+
+	if (m_rayQueries)
+	{
+		m_rayQueries->~cb2RayQueries();
+		cb2Free(m_rayQueries);
+	}
+
+	while (m_particleSystemList)
+	{
+		cb2ParticleSystem* ps = m_particleSystemList;
+		m_particleSystemList = ps->m_next;
+		ps->~cb2ParticleSystem();
+		cb2Free(ps);
+	}
+
 	// Some shapes allocate using cb2Alloc.
 	cb2Body* b = m_bodyList;
 	while (b)
@@ -82,1258 +224,5371 @@ cb2World::~cb2World()
 
 		b = bNext;
 	}
-}
 
-void cb2World::SetDestructionListener(cb2DestructionListener* listener)
-{
-	m_destructionListener = listener;
+	SetThreadCount(1);
+	cb2Free(m_awakeBodies);
+	cb2Free(m_freeBodyIds);
+	cb2Free(m_bodiesById);
+	cb2Free(m_transformBodies);
 }
 
-void cb2World::SetContactFilter(cb2ContactFilter* filter)
+void cb2World::SetSpeculativeContacts(bool flag)
 {
-	m_contactManager.m_contactFilter = filter;
+	m_speculativeContacts = flag;
+	m_toiScheduler.SetBulletsOnly(flag);
 }
 
-void cb2World::SetContactListener(cb2ContactListener* listener)
+void cb2World::SetTOIBudget(int maxEvents, float maxMilliseconds)
 {
-	m_contactManager.m_contactListener = listener;
+	cb2Assert(maxEvents >= 0 && maxMilliseconds >= 0.0f);
+	m_toiEventBudget = maxEvents;
+	m_toiTimeBudget = maxMilliseconds;
 }
 
-void cb2World::SetDebugDraw(cb2Draw* debugDraw)
+void cb2World::SetStackAllocator(cb2StackAllocator* allocator)
 {
-	g_debugDraw = debugDraw;
+	cb2Assert(IsLocked() == false);
+	m_stackAllocator = allocator ? allocator : &m_ownStackAllocator;
 }
 
-cb2Body* cb2World::CreateBody(const cb2BodyDef* def)
+void cb2World::SetThreadCount(int threadCount)
 {
 	cb2Assert(IsLocked() == false);
-	if (IsLocked())
+	cb2Assert(threadCount > 0);
+	if (IsLocked() || threadCount == GetThreadCount())
 	{
-		return NULL;
+		return;
 	}
 
-	void* mem = m_blockAllocator.Allocate(sizeof(cb2Body));
-	cb2Body* b = new (mem) cb2Body(def, this);
+	if (m_threadPool)
+	{
+		m_blockAllocator.SetThreadPool(NULL);
 
-	// Add to world doubly linked list.
-	b->m_prev = NULL;
-	b->m_next = m_bodyList;
-	if (m_bodyList)
+		for (int i = 0; i < m_threadPool->GetThreadCount(); ++i)
+		{
+			m_threadAllocators[i].~cb2StackAllocator();
+		}
+		cb2Free(m_threadAllocators);
+		m_threadAllocators = NULL;
+
+		m_threadPool->~cb2ThreadPool();
+		cb2Free(m_threadPool);
+		m_threadPool = NULL;
+	}
+
+	if (threadCount > 1)
 	{
-		m_bodyList->m_prev = b;
+		void* mem = cb2Alloc(sizeof(cb2ThreadPool));
+		m_threadPool = new (mem) cb2ThreadPool(threadCount);
+
+		m_threadAllocators = (cb2StackAllocator*)cb2Alloc(threadCount * sizeof(cb2StackAllocator));
+		for (int i = 0; i < threadCount; ++i)
+		{
+			new (m_threadAllocators + i) cb2StackAllocator();
+		}
+
+		m_blockAllocator.SetThreadPool(m_threadPool);
 	}
-	m_bodyList = b;
-	++m_bodyCount;
 
-	return b;
+	m_contactManager.m_threadPool = m_threadPool;
+	m_contactManager.m_broadPhase.SetThreadPool(m_threadPool);
 }
 
-void cb2World::DestroyBody(cb2Body* b)
+void cb2World::BeginBulkLoad()
 {
-	cb2Assert(m_bodyCount > 0);
 	cb2Assert(IsLocked() == false);
-	if (IsLocked())
+	m_contactManager.m_broadPhase.BeginBulkCreate();
+}
+
+void cb2World::EndBulkLoad()
+{
+	cb2Assert(IsLocked() == false);
+	m_contactManager.m_broadPhase.EndBulkCreate();
+}
+
+void cb2World::SetContactEvents(bool flag)
+{
+	cb2Assert(IsLocked() == false);
+	if (flag == (m_contactEvents != NULL))
 	{
 		return;
 	}
 
-	// Delete the attached joints.
-	cb2JointEdge* je = b->m_jointList;
-	while (je)
+	if (flag)
 	{
-		cb2JointEdge* je0 = je;
-		je = je->next;
-
-		if (m_destructionListener)
-		{
-			m_destructionListener->SayGoodbye(je0->joint);
-		}
+		void* mem = cb2Alloc(sizeof(cb2ContactEvents));
+		m_contactEvents = new (mem) cb2ContactEvents;
+		return;
+	}
 
-		DestroyJoint(je0->joint);
+	m_contactEvents->~cb2ContactEvents();
+	cb2Free(m_contactEvents);
+	m_contactEvents = NULL;
+}
 
-		b->m_jointList = je;
+void cb2World::SetLayerCollision(int layerA, int layerB, bool flag)
+{
+	cb2Assert(IsLocked() == false);
+	cb2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	if (broadPhase->ShouldCollideLayers(layerA, layerB) == flag)
+	{
+		return;
 	}
-	b->m_jointList = NULL;
 
-	// Delete the attached contacts.
-	cb2ContactEdge* ce = b->m_contactList;
-	while (ce)
+	broadPhase->SetLayerCollision(layerA, layerB, flag);
+
+	if (flag == false)
 	{
-		cb2ContactEdge* ce0 = ce;
-		ce = ce->next;
-		m_contactManager.Destroy(ce0->contact);
+		// The contacts between the layers are destroyed when they are next updated.
+		for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+		{
+			int a = c->m_fixtureA->m_filter.layer;
+			int b = c->m_fixtureB->m_filter.layer;
+			if ((a == layerA && b == layerB) || (a == layerB && b == layerA))
+			{
+				c->FlagForFiltering();
+			}
+		}
+		return;
 	}
-	b->m_contactList = NULL;
 
-	// Delete the attached fixtures. This destroys broad-phase proxies.
-	cb2Fixture* f = b->m_fixtureList;
-	while (f)
+	// Touch the proxies of both layers so the new pairs are found.
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
 	{
-		cb2Fixture* f0 = f;
-		f = f->m_next;
-
-		if (m_destructionListener)
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
 		{
-			m_destructionListener->SayGoodbye(f0);
+			if (f->m_filter.layer == layerA || f->m_filter.layer == layerB)
+			{
+				for (int i = 0; i < f->m_proxyCount; ++i)
+				{
+					broadPhase->TouchProxy(f->m_proxies[i].proxyId);
+				}
+			}
 		}
+	}
+}
 
-		f0->DestroyProxies(&m_contactManager.m_broadPhase);
-		f0->Destroy(&m_blockAllocator);
-		f0->~cb2Fixture();
-		m_blockAllocator.Free(f0, sizeof(cb2Fixture));
+bool cb2World::GetLayerCollision(int layerA, int layerB) const
+{
+	return m_contactManager.m_broadPhase.ShouldCollideLayers(layerA, layerB);
+}
 
-		b->m_fixtureList = f;
-		b->m_fixtureCount -= 1;
+cb2MaterialTable* cb2World::GetMaterials()
+{
+	if (m_materials == NULL)
+	{
+		void* mem = cb2Alloc(sizeof(cb2MaterialTable));
+		m_materials = new (mem) cb2MaterialTable;
 	}
-	b->m_fixtureList = NULL;
-	b->m_fixtureCount = 0;
+	return m_materials;
+}
 
-	// Remove world body list.
-	if (b->m_prev)
+void cb2World::SetMaterial(int material, float friction, float restitution)
+{
+	GetMaterials()->SetMaterial(material, friction, restitution);
+}
+
+void cb2World::SetMaterialPair(int materialA, int materialB, float friction, float restitution, float tangentSpeed)
+{
+	cb2MaterialPair pair;
+	pair.friction = friction;
+	pair.restitution = restitution;
+	pair.tangentSpeed = tangentSpeed;
+	GetMaterials()->SetPair(materialA, materialB, pair);
+}
+
+void cb2World::ResetMaterialPair(int materialA, int materialB)
+{
+	GetMaterials()->ResetPair(materialA, materialB);
+}
+
+void cb2World::UpdateMaterials()
+{
+	// Only the contacts of the changed materials are touched.
+	for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
 	{
-		b->m_prev->m_next = b->m_next;
+		int materialA = c->m_fixtureA->m_material;
+		int materialB = c->m_fixtureB->m_material;
+		if ((materialA >= 0 && m_materials->IsChanged(materialA)) ||
+			(materialB >= 0 && m_materials->IsChanged(materialB)))
+		{
+			c->UpdateMaterial();
+		}
 	}
+	m_materials->ClearChanges();
+}
 
-	if (b->m_next)
+int cb2World::CreateTargetDrive(const cb2TargetDriveDef* def)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
 	{
-		b->m_next->m_prev = b->m_prev;
+		return -1;
 	}
 
-	if (b == m_bodyList)
+	if (m_targetDrives == NULL)
 	{
-		m_bodyList = b->m_next;
+		void* mem = cb2Alloc(sizeof(cb2TargetDrives));
+		m_targetDrives = new (mem) cb2TargetDrives;
 	}
-
-	--m_bodyCount;
-	b->~cb2Body();
-	m_blockAllocator.Free(b, sizeof(cb2Body));
+	return m_targetDrives->Create(def);
 }
 
-cb2Joint* cb2World::CreateJoint(const cb2JointDef* def)
+void cb2World::DestroyTargetDrive(int drive)
 {
 	cb2Assert(IsLocked() == false);
 	if (IsLocked())
 	{
-		return NULL;
+		return;
 	}
 
-	cb2Joint* j = cb2Joint::Create(def, &m_blockAllocator);
+	m_targetDrives->Destroy(drive);
+}
 
-	// Connect to the world list.
-	j->m_prev = NULL;
-	j->m_next = m_jointList;
-	if (m_jointList)
+void cb2World::SetTargetDriveTargets(const int* drives, const ci::Vec2f* targets, int count)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked() || count == 0)
 	{
-		m_jointList->m_prev = j;
+		return;
 	}
-	m_jointList = j;
-	++m_jointCount;
 
-	// Connect to the bodies' doubly linked lists.
-	j->m_edgeA.joint = j;
-	j->m_edgeA.other = j->m_bodyB;
-	j->m_edgeA.prev = NULL;
-	j->m_edgeA.next = j->m_bodyA->m_jointList;
-	if (j->m_bodyA->m_jointList) j->m_bodyA->m_jointList->prev = &j->m_edgeA;
-	j->m_bodyA->m_jointList = &j->m_edgeA;
+	m_targetDrives->SetTargets(drives, targets, count);
+}
 
-	j->m_edgeB.joint = j;
-	j->m_edgeB.other = j->m_bodyA;
-	j->m_edgeB.prev = NULL;
-	j->m_edgeB.next = j->m_bodyB->m_jointList;
-	if (j->m_bodyB->m_jointList) j->m_bodyB->m_jointList->prev = &j->m_edgeB;
-	j->m_bodyB->m_jointList = &j->m_edgeB;
+const ci::Vec2f& cb2World::GetTargetDriveTarget(int drive) const
+{
+	return m_targetDrives->GetDrive(drive).target;
+}
 
-	cb2Body* bodyA = def->bodyA;
-	cb2Body* bodyB = def->bodyB;
+cb2Body* cb2World::GetTargetDriveBody(int drive) const
+{
+	return m_targetDrives->GetDrive(drive).body;
+}
 
-	// If the joint prevents collisions, then flag any contacts for filtering.
-	if (def->collideConnected == false)
+int cb2World::GetTargetDriveCount() const
+{
+	return m_targetDrives ? m_targetDrives->GetCount() : 0;
+}
+
+void cb2World::SetSensorOverlaps(bool flag)
+{
+	cb2Assert(IsLocked() == false);
+	if (flag == GetSensorOverlaps())
 	{
-		cb2ContactEdge* edge = bodyB->GetContactList();
-		while (edge)
+		return;
+	}
+
+	m_contactManager.m_sensorOverlaps = flag;
+	m_contactManager.m_broadPhase.SetSensorRejection(flag);
+
+	if (flag == false)
+	{
+		m_sensorManager->~cb2SensorManager();
+		cb2Free(m_sensorManager);
+		m_sensorManager = NULL;
+
+		// The proxies are touched so the sensors find their contacts again.
+		for (cb2Body* b = m_bodyList; b; b = b->m_next)
 		{
-			if (edge->other == bodyA)
+			for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
 			{
-				// Flag the contact for filtering at the next time step (where either
-				// body is awake).
-				edge->contact->FlagForFiltering();
+				if (f->m_isSensor)
+				{
+					f->Refilter();
+				}
 			}
-
-			edge = edge->next;
 		}
+		return;
 	}
 
-	// Note: creating a joint doesn't wake the bodies.
+	void* mem = cb2Alloc(sizeof(cb2SensorManager));
+	m_sensorManager = new (mem) cb2SensorManager;
 
-	return j;
+	cb2Contact* c = m_contactManager.m_contactList;
+	while (c)
+	{
+		cb2Contact* next = c->m_next;
+		if (c->m_fixtureA->m_isSensor || c->m_fixtureB->m_isSensor)
+		{
+			m_contactManager.Destroy(c);
+		}
+		c = next;
+	}
+
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			if (f->m_isSensor)
+			{
+				m_sensorManager->AddSensor(f);
+			}
+		}
+	}
 }
 
-void cb2World::DestroyJoint(cb2Joint* j)
+void cb2World::SetQuerySnapshots(bool flag)
 {
 	cb2Assert(IsLocked() == false);
-	if (IsLocked())
+	if (flag == GetQuerySnapshots())
 	{
 		return;
 	}
 
-	bool collideConnected = j->m_collideConnected;
-
-	// Remove from the doubly linked list.
-	if (j->m_prev)
+	if (flag)
 	{
-		j->m_prev->m_next = j->m_next;
+		for (int i = 0; i < 3; ++i)
+		{
+			void* mem = cb2Alloc(sizeof(cb2QuerySnapshot));
+			m_querySnapshots[i] = new (mem) cb2QuerySnapshot;
+		}
+
+		PublishQuerySnapshot();
+		return;
 	}
 
-	if (j->m_next)
+	m_publishedSnapshot = NULL;
+	for (int i = 0; i < 3; ++i)
 	{
-		j->m_next->m_prev = j->m_prev;
+		cb2Assert(m_querySnapshots[i]->m_readerCount == 0);
+		m_querySnapshots[i]->~cb2QuerySnapshot();
+		cb2Free(m_querySnapshots[i]);
+		m_querySnapshots[i] = NULL;
 	}
+}
 
-	if (j == m_jointList)
+// Capture into a buffer that is neither published nor held by a reader.
+void cb2World::PublishQuerySnapshot()
+{
+	cb2QuerySnapshot* published = m_publishedSnapshot;
+	for (int i = 0; i < 3; ++i)
 	{
-		m_jointList = j->m_next;
+		cb2QuerySnapshot* snapshot = m_querySnapshots[i];
+		if (snapshot == published || snapshot->m_readerCount != 0)
+		{
+			continue;
+		}
+
+		snapshot->Capture(this, m_stepCount);
+		m_publishedSnapshot = snapshot;
+		return;
 	}
+}
 
-	// Disconnect from island graph.
-	cb2Body* bodyA = j->m_bodyA;
-	cb2Body* bodyB = j->m_bodyB;
+const cb2QuerySnapshot* cb2World::AcquireQuerySnapshot() const
+{
+	for (;;)
+	{
+		cb2QuerySnapshot* snapshot = m_publishedSnapshot;
+		if (snapshot == NULL)
+		{
+			return NULL;
+		}
 
-	// Wake up connected bodies.
-	bodyA->SetAwake(true);
-	bodyB->SetAwake(true);
+		// The snapshot is only safe if it is still published after the reader is counted.
+		// Otherwise the step may already be writing into it.
+		++snapshot->m_readerCount;
+		if (m_publishedSnapshot == snapshot)
+		{
+			return snapshot;
+		}
+		--snapshot->m_readerCount;
+	}
+}
 
-	// Remove from body 1.
-	if (j->m_edgeA.prev)
+void cb2World::ReleaseQuerySnapshot(const cb2QuerySnapshot* snapshot) const
+{
+	cb2Assert(snapshot->m_readerCount > 0);
+	--snapshot->m_readerCount;
+}
+
+int cb2World::GetThreadCount() const
+{
+	return m_threadPool ? m_threadPool->GetThreadCount() : 1;
+}
+
+// FNV-1a over the bytes of a value.
+template <typename T>
+inline void cb2HashValue(unsigned int* hash, const T& value)
+{
+	const unsigned char* bytes = (const unsigned char*)&value;
+	for (int i = 0; i < (int)sizeof(T); ++i)
 	{
-		j->m_edgeA.prev->next = j->m_edgeA.next;
+		*hash = (*hash ^ bytes[i]) * 16777619u;
 	}
+}
 
-	if (j->m_edgeA.next)
+unsigned int cb2World::GetStateHash() const
+{
+	unsigned int hash = 2166136261u;
+	cb2HashValue(&hash, m_bodyCount);
+	cb2HashValue(&hash, m_contactManager.m_contactCount);
+	for (const cb2Body* b = m_bodyList; b; b = b->m_next)
 	{
-		j->m_edgeA.next->prev = j->m_edgeA.prev;
+		if (b->m_type == cb2_staticBody)
+		{
+			continue;
+		}
+
+		int awake = b->IsAwake() ? 1 : 0;
+		cb2HashValue(&hash, awake);
+		cb2HashValue(&hash, b->m_xf.p.x);
+		cb2HashValue(&hash, b->m_xf.p.y);
+		cb2HashValue(&hash, b->m_xf.q.s);
+		cb2HashValue(&hash, b->m_xf.q.c);
+		cb2HashValue(&hash, b->m_sweep.c0.x);
+		cb2HashValue(&hash, b->m_sweep.c0.y);
+		cb2HashValue(&hash, b->m_sweep.a0);
+		cb2HashValue(&hash, b->m_sweep.alpha0);
+		cb2HashValue(&hash, b->m_linearVelocity.x);
+		cb2HashValue(&hash, b->m_linearVelocity.y);
+		cb2HashValue(&hash, b->m_angularVelocity);
+		cb2HashValue(&hash, b->m_sleepTime);
 	}
+	return hash;
+}
 
-	if (&j->m_edgeA == bodyA->m_jointList)
+void cb2World::SetDestructionListener(cb2DestructionListener* listener)
+{
+	m_destructionListener = listener;
+}
+
+void cb2World::SetContactFilter(cb2ContactFilter* filter)
+{
+	m_contactManager.m_contactFilter = filter;
+
+	// Pairs are rejected by the proxy keys while the filter is the default one.
+	m_contactManager.m_broadPhase.SetFilterRejection(filter == &cb2_defaultFilter);
+}
+
+void cb2World::SetContactListener(cb2ContactListener* listener)
+{
+	m_contactManager.m_contactListener = listener;
+}
+
+void cb2World::SetCollideBackend(cb2CollideBackend* backend)
+{
+	m_contactManager.m_collideBackend = backend;
+}
+
+cb2CollideBackend* cb2World::GetCollideBackend() const
+{
+	return m_contactManager.m_collideBackend;
+}
+
+void cb2World::SetProfiler(cb2Profiler* profiler)
+{
+	m_profiler = profiler;
+	m_contactManager.m_profiler = profiler;
+}
+
+void cb2World::SetDebugDraw(cb2Draw* debugDraw)
+{
+	g_debugDraw = debugDraw;
+}
+
+cb2Body* cb2World::CreateBody(const cb2BodyDef* def)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
 	{
-		bodyA->m_jointList = j->m_edgeA.next;
+		return NULL;
 	}
 
-	j->m_edgeA.prev = NULL;
-	j->m_edgeA.next = NULL;
+	void* mem = m_blockAllocator.Allocate(sizeof(cb2Body));
+	cb2Body* b = new (mem) cb2Body(def, this);
+	AddBody(b);
+	return b;
+}
 
-	// Remove from body 2
-	if (j->m_edgeB.prev)
+void cb2World::CreateBodies(const cb2BodyDef* bodyDefs, int bodyCount, const cb2FixtureDef* fixtureDefs,
+							const int* fixtureCounts, cb2Body** bodies)
+{
+	cb2Assert(IsLocked() == false);
+	cb2Assert(bodyCount >= 0);
+	if (IsLocked() || bodyCount == 0)
 	{
-		j->m_edgeB.prev->next = j->m_edgeB.next;
+		return;
 	}
 
-	if (j->m_edgeB.next)
+	int fixtureCount = 0;
+	if (fixtureDefs)
 	{
-		j->m_edgeB.next->prev = j->m_edgeB.prev;
+		if (fixtureCounts)
+		{
+			for (int i = 0; i < bodyCount; ++i)
+			{
+				fixtureCount += fixtureCounts[i];
+			}
+		}
+		else
+		{
+			fixtureCount = bodyCount;
+		}
 	}
 
-	if (&j->m_edgeB == bodyB->m_jointList)
+	void** blocks = (void**)cb2Alloc((bodyCount + fixtureCount) * sizeof(void*));
+	void** fixtureBlocks = blocks + bodyCount;
+	m_blockAllocator.AllocateContiguous(sizeof(cb2Body), bodyCount, blocks);
+	m_blockAllocator.AllocateContiguous(sizeof(cb2Fixture), fixtureCount, fixtureBlocks);
+
+	cb2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	bool bulk = broadPhase->IsBulkCreating() == false;
+	if (bulk)
 	{
-		bodyB->m_jointList = j->m_edgeB.next;
+		broadPhase->BeginBulkCreate();
 	}
 
-	j->m_edgeB.prev = NULL;
-	j->m_edgeB.next = NULL;
-
-	cb2Joint::Destroy(j, &m_blockAllocator);
+	int fixtureIndex = 0;
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		cb2Body* b = new (blocks[i]) cb2Body(bodyDefs + i, this);
+		AddBody(b);
 
-	cb2Assert(m_jointCount > 0);
-	--m_jointCount;
+		int count = fixtureDefs ? (fixtureCounts ? fixtureCounts[i] : 1) : 0;
+		bool hasMass = false;
+		for (int j = 0; j < count; ++j)
+		{
+			const cb2FixtureDef* fd = fixtureDefs + fixtureIndex;
+			b->CreateFixture(fixtureBlocks[fixtureIndex], fd);
+			hasMass = hasMass || fd->density > 0.0f;
+			++fixtureIndex;
+		}
 
-	// If the joint prevents collisions, then flag any contacts for filtering.
-	if (collideConnected == false)
-	{
-		cb2ContactEdge* edge = bodyB->GetContactList();
-		while (edge)
+		if (hasMass)
 		{
-			if (edge->other == bodyA)
-			{
-				// Flag the contact for filtering at the next time step (where either
-				// body is awake).
-				edge->contact->FlagForFiltering();
-			}
+			b->ResetMassData();
+		}
 
-			edge = edge->next;
+		if (bodies)
+		{
+			bodies[i] = b;
 		}
 	}
+
+	if (bulk)
+	{
+		broadPhase->EndBulkCreate();
+	}
+
+	cb2Free(blocks);
 }
 
-//
-void cb2World::SetAllowSleeping(bool flag)
+void cb2World::AddBody(cb2Body* b)
 {
-	if (flag == m_allowSleep)
+	b->m_id = AllocateBodyId();
+	SetBodyById(b);
+
+	// Add to world doubly linked list.
+	b->m_prev = NULL;
+	b->m_next = m_bodyList;
+	if (m_bodyList)
 	{
-		return;
+		m_bodyList->m_prev = b;
 	}
+	m_bodyList = b;
+	++m_bodyCount;
 
-	m_allowSleep = flag;
-	if (m_allowSleep == false)
+	if (m_persistentIslands && b->m_type != cb2_staticBody)
 	{
-		for (cb2Body* b = m_bodyList; b; b = b->m_next)
-		{
-			b->SetAwake(true);
-		}
+		m_islandGraph.AddBody(b);
+	}
+
+	if (m_awakeBodies && b->IsAwake())
+	{
+		b->AddToAwakeSet();
 	}
 }
 
-// Find islands, integrate and solve constraints, solve position constraints
-void cb2World::Solve(const cb2TimeStep& step)
+void cb2World::DestroyBody(cb2Body* b)
 {
-	m_profile.solveInit = 0.0f;
-	m_profile.solveVelocity = 0.0f;
-	m_profile.solvePosition = 0.0f;
+	cb2Assert(m_bodyCount > 0);
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
 
-	// Size the island for the worst case.
-	cb2Island island(m_bodyCount,
-					m_contactManager.m_contactCount,
-					m_jointCount,
-					&m_stackAllocator,
-					m_contactManager.m_contactListener);
+	// Delete the attached joints.
+	cb2JointEdge* je = b->m_jointList;
+	while (je)
+	{
+		cb2JointEdge* je0 = je;
+		je = je->next;
 
-	// Clear all the island flags.
-	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+		if (m_destructionListener)
+		{
+			m_destructionListener->SayGoodbye(je0->joint);
+		}
+
+		DestroyJoint(je0->joint);
+
+		b->m_jointList = je;
+	}
+	b->m_jointList = NULL;
+
+	if (m_targetDrives)
 	{
-		b->m_flags &= ~cb2Body::e_islandFlag;
+		m_targetDrives->DestroyBodyDrives(b);
 	}
-	for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+
+	// Delete the attached contacts.
+	cb2ContactEdge* ce = b->m_contactList;
+	while (ce)
 	{
-		c->m_flags &= ~cb2Contact::e_islandFlag;
+		cb2ContactEdge* ce0 = ce;
+		ce = ce->next;
+		m_contactManager.Destroy(ce0->contact);
 	}
-	for (cb2Joint* j = m_jointList; j; j = j->m_next)
+	b->m_contactList = NULL;
+
+	if (m_contactManager.m_impulseCache)
 	{
-		j->m_islandFlag = false;
+		m_contactManager.m_impulseCache->RemoveBody(b);
 	}
 
-	// Build and simulate all awake islands.
-	int stackSize = m_bodyCount;
-	cb2Body** stack = (cb2Body**)m_stackAllocator.Allocate(stackSize * sizeof(cb2Body*));
-	for (cb2Body* seed = m_bodyList; seed; seed = seed->m_next)
+	// Delete the attached fixtures. This destroys broad-phase proxies.
+	cb2Fixture* f = b->m_fixtureList;
+	while (f)
 	{
-		if (seed->m_flags & cb2Body::e_islandFlag)
+		cb2Fixture* f0 = f;
+		f = f->m_next;
+
+		if (m_destructionListener)
 		{
-			continue;
+			m_destructionListener->SayGoodbye(f0);
 		}
 
-		if (seed->IsAwake() == false || seed->IsActive() == false)
+		if (m_sensorManager)
 		{
-			continue;
+			m_sensorManager->RemoveFixture(f0, m_contactManager.m_contactListener);
 		}
 
-		// The seed can be dynamic or kinematic.
-		if (seed->GetType() == cb2_staticBody)
+		if (m_rayQueries)
 		{
-			continue;
+			m_rayQueries->RemoveFixture(f0);
 		}
 
-		// Reset island and stack.
-		island.Clear();
-		int stackCount = 0;
-		stack[stackCount++] = seed;
-		seed->m_flags |= cb2Body::e_islandFlag;
-
-		// Perform a depth first search (DFS) on the constraint graph.
-		while (stackCount > 0)
-		{
-			// Grab the next body off the stack and add it to the island.
-			cb2Body* b = stack[--stackCount];
-			cb2Assert(b->IsActive() == true);
-			island.Add(b);
+		f0->DestroyProxies(&m_contactManager.m_broadPhase);
+		f0->Destroy(&m_blockAllocator);
+		f0->~cb2Fixture();
+		m_blockAllocator.Free(f0, sizeof(cb2Fixture));
 
-			// Make sure the body is awake.
-			b->SetAwake(true);
+		b->m_fixtureList = f;
+		b->m_fixtureCount -= 1;
+	}
+	b->m_fixtureList = NULL;
+	b->m_fixtureCount = 0;
 
-			// To keep islands as small as possible, we don't
-			// propagate islands across static bodies.
-			if (b->GetType() == cb2_staticBody)
-			{
-				continue;
-			}
+	if (b->m_persistentIsland)
+	{
+		m_islandGraph.RemoveBody(b);
+	}
 
-			// Search all contacts connected to this body.
-			for (cb2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
-			{
-				cb2Contact* contact = ce->contact;
+	if (b->m_awakeIndex != -1)
+	{
+		RemoveAwakeBody(b);
+	}
 
-				// Has this contact already been added to an island?
-				if (contact->m_flags & cb2Contact::e_islandFlag)
-				{
-					continue;
-				}
+	// Remove world body list.
+	if (b->m_prev)
+	{
+		b->m_prev->m_next = b->m_next;
+	}
 
-				// Is this contact solid and touching?
-				if (contact->IsEnabled() == false ||
-					contact->IsTouching() == false)
-				{
-					continue;
-				}
-
-				// Skip sensors.
-				bool sensorA = contact->m_fixtureA->m_isSensor;
-				bool sensorB = contact->m_fixtureB->m_isSensor;
-				if (sensorA || sensorB)
-				{
-					continue;
-				}
-
-				island.Add(contact);
-				contact->m_flags |= cb2Contact::e_islandFlag;
-
-				cb2Body* other = ce->other;
+	if (b->m_next)
+	{
+		b->m_next->m_prev = b->m_prev;
+	}
 
-				// Was the other body already added to this island?
-				if (other->m_flags & cb2Body::e_islandFlag)
-				{
-					continue;
-				}
+	if (b == m_bodyList)
+	{
+		m_bodyList = b->m_next;
+	}
 
-				cb2Assert(stackCount < stackSize);
-				stack[stackCount++] = other;
-				other->m_flags |= cb2Body::e_islandFlag;
-			}
+	--m_bodyCount;
+	m_bodiesById[b->m_id] = NULL;
+	FreeBodyId(b->m_id);
+	b->~cb2Body();
+	m_blockAllocator.Free(b, sizeof(cb2Body));
+}
 
-			// Search all joints connect to this body.
-			for (cb2JointEdge* je = b->m_jointList; je; je = je->next)
-			{
-				if (je->joint->m_islandFlag == true)
-				{
-					continue;
-				}
+void cb2World::DestroyBodies(cb2Body** bodies, int count)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked() || count == 0)
+	{
+		return;
+	}
 
-				cb2Body* other = je->other;
+	// The impulses stored while the contacts go would be dropped with the bodies anyway.
+	cb2ImpulseCache* impulseCache = m_contactManager.m_impulseCache;
+	m_contactManager.m_impulseCache = NULL;
 
-				// Don't simulate joints connected to inactive bodies.
-				if (other->IsActive() == false)
-				{
-					continue;
-				}
+	if (impulseCache)
+	{
+		impulseCache->RemoveBodies(bodies, count);
+	}
 
-				island.Add(je->joint);
-				je->joint->m_islandFlag = true;
+	for (int i = 0; i < count; ++i)
+	{
+		DestroyBody(bodies[i]);
+	}
 
-				if (other->m_flags & cb2Body::e_islandFlag)
-				{
-					continue;
-				}
+	m_contactManager.m_impulseCache = impulseCache;
+}
 
-				cb2Assert(stackCount < stackSize);
-				stack[stackCount++] = other;
-				other->m_flags |= cb2Body::e_islandFlag;
-			}
-		}
+// Reuse the most recently freed id, so ids stay dense.
+int cb2World::AllocateBodyId()
+{
+	if (m_freeBodyIdCount > 0)
+	{
+		--m_freeBodyIdCount;
+		return m_freeBodyIds[m_freeBodyIdCount];
+	}
 
-		cb2Profile profile;
-		island.Solve(&profile, step, m_gravity, m_allowSleep);
-		m_profile.solveInit += profile.solveInit;
-		m_profile.solveVelocity += profile.solveVelocity;
-		m_profile.solvePosition += profile.solvePosition;
+	return m_bodyIdCount++;
+}
 
-		// Post solve cleanup.
-		for (int i = 0; i < island.m_bodyCount; ++i)
+void cb2World::SetBodyById(cb2Body* b)
+{
+	if (b->m_id >= m_bodiesByIdCapacity)
+	{
+		cb2Body** oldBodies = m_bodiesById;
+		int oldCapacity = m_bodiesByIdCapacity;
+		m_bodiesByIdCapacity = cb2Max(2 * m_bodiesByIdCapacity, cb2Max(b->m_id + 1, 16));
+		m_bodiesById = (cb2Body**)cb2Alloc(m_bodiesByIdCapacity * sizeof(cb2Body*));
+		if (oldBodies)
 		{
-			// Allow static bodies to participate in other islands.
-			cb2Body* b = island.m_bodies[i];
-			if (b->GetType() == cb2_staticBody)
-			{
-				b->m_flags &= ~cb2Body::e_islandFlag;
-			}
+			memcpy(m_bodiesById, oldBodies, oldCapacity * sizeof(cb2Body*));
+			cb2Free(oldBodies);
 		}
+		memset(m_bodiesById + oldCapacity, 0, (m_bodiesByIdCapacity - oldCapacity) * sizeof(cb2Body*));
 	}
 
-	m_stackAllocator.Free(stack);
+	m_bodiesById[b->m_id] = b;
+}
 
+void cb2World::FreeBodyId(int id)
+{
+	if (m_freeBodyIdCount == m_freeBodyIdCapacity)
 	{
-		cb2Timer timer;
-		// Synchronize fixtures, check for out of range bodies.
-		for (cb2Body* b = m_bodyList; b; b = b->GetNext())
+		int* oldIds = m_freeBodyIds;
+		m_freeBodyIdCapacity = cb2Max(2 * m_freeBodyIdCapacity, 16);
+		m_freeBodyIds = (int*)cb2Alloc(m_freeBodyIdCapacity * sizeof(int));
+		if (oldIds)
 		{
-			// If a body was not in an island then it did not move.
-			if ((b->m_flags & cb2Body::e_islandFlag) == 0)
-			{
-				continue;
-			}
+			memcpy(m_freeBodyIds, oldIds, m_freeBodyIdCount * sizeof(int));
+			cb2Free(oldIds);
+		}
+	}
 
-			if (b->GetType() == cb2_staticBody)
-			{
-				continue;
-			}
+	m_freeBodyIds[m_freeBodyIdCount] = id;
+	++m_freeBodyIdCount;
+}
 
-			// Update fixtures (for broad-phase).
-			b->SynchronizeFixtures();
-		}
+void cb2World::SetTransformBuffer(cb2BodyTransform* buffer, int capacity)
+{
+	cb2Assert(IsLocked() == false);
+	cb2Assert(buffer == NULL || capacity >= 0);
 
-		// Look for new contacts.
-		m_contactManager.FindNewContacts();
-		m_profile.broadphase = timer.GetMilliseconds();
+	cb2Free(m_transformBodies);
+	m_transformBodies = NULL;
+	m_transforms = buffer;
+	m_transformCapacity = buffer ? capacity : 0;
+	m_transformCount = 0;
+
+	if (m_transformCapacity > 0)
+	{
+		m_transformBodies = (cb2Body**)cb2Alloc(m_transformCapacity * sizeof(cb2Body*));
 	}
 }
 
-// Find TOI contacts and solve them.
-void cb2World::SolveTOI(const cb2TimeStep& step)
+// Write the id and the transform of the bodies that are about to move. The bodies
+// are marked, so the ones woken during the step can be told apart at the end.
+void cb2World::BeginTransformExport()
 {
-	cb2Island island(2 * cb2_maxTOIContacts, cb2_maxTOIContacts, 0, &m_stackAllocator, m_contactManager.m_contactListener);
+	m_transformCount = 0;
 
-	if (m_stepComplete)
+	int bodyIndex;
+	for (cb2Body* b = GetFirstAwakeBody(&bodyIndex); b; b = GetNextAwakeBody(b, &bodyIndex))
 	{
-		for (cb2Body* b = m_bodyList; b; b = b->m_next)
+		if (b->m_type == cb2_staticBody || b->IsAwake() == false)
 		{
-			b->m_flags &= ~cb2Body::e_islandFlag;
-			b->m_sweep.alpha0 = 0.0f;
+			continue;
 		}
 
-		for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+		if (m_transformCount == m_transformCapacity)
 		{
-			// Invalidate TOI
-			c->m_flags &= ~(cb2Contact::e_toiFlag | cb2Contact::e_islandFlag);
-			c->m_toiCount = 0;
-			c->m_toi = 1.0f;
+			break;
 		}
+
+		cb2BodyTransform* entry = m_transforms + m_transformCount;
+		entry->id = b->m_id;
+		entry->previous = b->m_xf;
+		m_transformBodies[m_transformCount] = b;
+		++m_transformCount;
+		b->m_flags |= cb2Body::e_exportFlag;
 	}
+}
 
-	// Find TOI events and solve them.
-	for (;;)
+void cb2World::EndTransformExport()
+{
+	// Bodies woken during the step are not marked. Their sweep started where they rested.
+	int startCount = m_transformCount;
+	int bodyIndex;
+	for (cb2Body* b = GetFirstAwakeBody(&bodyIndex); b && m_transformCount < m_transformCapacity; b = GetNextAwakeBody(b, &bodyIndex))
 	{
-		// Find the first TOI.
-		cb2Contact* minContact = NULL;
-		float minAlpha = 1.0f;
-
-		for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+		if (b->m_type == cb2_staticBody || b->IsAwake() == false || (b->m_flags & cb2Body::e_exportFlag))
 		{
-			// Is this contact disabled?
-			if (c->IsEnabled() == false)
-			{
-				continue;
-			}
-
-			// Prevent excessive sub-stepping.
-			if (c->m_toiCount > cb2_maxSubSteps)
-			{
-				continue;
-			}
+			continue;
+		}
 
-			float alpha = 1.0f;
-			if (c->m_flags & cb2Contact::e_toiFlag)
-			{
-				// This contact has a valid cached TOI.
-				alpha = c->m_toi;
-			}
-			else
-			{
-				cb2Fixture* fA = c->GetFixtureA();
-				cb2Fixture* fB = c->GetFixtureB();
+		cb2BodyTransform* entry = m_transforms + m_transformCount;
+		entry->id = b->m_id;
+		entry->previous.q.set(b->m_sweep.a0);
+		entry->previous.p = b->m_sweep.c0 - cb2Mul(entry->previous.q, b->m_sweep.localCenter);
+		entry->current = b->m_xf;
+		++m_transformCount;
+	}
 
-				// Is there a sensor?
-				if (fA->IsSensor() || fB->IsSensor())
-				{
-					continue;
-				}
+	for (int i = 0; i < startCount; ++i)
+	{
+		cb2Body* b = m_transformBodies[i];
+		m_transforms[i].current = b->m_xf;
+		b->m_flags &= ~cb2Body::e_exportFlag;
+	}
+}
 
-				cb2Body* bA = fA->GetBody();
-				cb2Body* bB = fB->GetBody();
+cb2Joint* cb2World::CreateJoint(const cb2JointDef* def)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return NULL;
+	}
 
-				cb2BodyType typeA = bA->m_type;
-				cb2BodyType typeB = bB->m_type;
-				cb2Assert(typeA == cb2_dynamicBody || typeB == cb2_dynamicBody);
+	cb2Joint* j = cb2Joint::Create(def, &m_blockAllocator);
 
-				bool activeA = bA->IsAwake() && typeA != cb2_staticBody;
-				bool activeB = bB->IsAwake() && typeB != cb2_staticBody;
+	// Connect to the world list.
+	j->m_prev = NULL;
+	j->m_next = m_jointList;
+	if (m_jointList)
+	{
+		m_jointList->m_prev = j;
+	}
+	m_jointList = j;
+	++m_jointCount;
 
-				// Is at least one body active (awake and dynamic or kinematic)?
-				if (activeA == false && activeB == false)
-				{
-					continue;
-				}
+	// Connect to the bodies' doubly linked lists.
+	j->m_edgeA.joint = j;
+	j->m_edgeA.other = j->m_bodyB;
+	j->m_edgeA.prev = NULL;
+	j->m_edgeA.next = j->m_bodyA->m_jointList;
+	if (j->m_bodyA->m_jointList) j->m_bodyA->m_jointList->prev = &j->m_edgeA;
+	j->m_bodyA->m_jointList = &j->m_edgeA;
 
-				bool collideA = bA->IsBullet() || typeA != cb2_dynamicBody;
-				bool collideB = bB->IsBullet() || typeB != cb2_dynamicBody;
+	j->m_edgeB.joint = j;
+	j->m_edgeB.other = j->m_bodyA;
+	j->m_edgeB.prev = NULL;
+	j->m_edgeB.next = j->m_bodyB->m_jointList;
+	if (j->m_bodyB->m_jointList) j->m_bodyB->m_jointList->prev = &j->m_edgeB;
+	j->m_bodyB->m_jointList = &j->m_edgeB;
 
-				// Are these two non-bullet dynamic bodies?
-				if (collideA == false && collideB == false)
-				{
-					continue;
-				}
+	if (m_persistentIslands)
+	{
+		m_islandGraph.LinkJoint(j);
+	}
 
-				// Compute the TOI for this contact.
-				// Put the sweeps onto the same time interval.
-				float alpha0 = bA->m_sweep.alpha0;
+	cb2Body* bodyA = def->bodyA;
+	cb2Body* bodyB = def->bodyB;
 
-				if (bA->m_sweep.alpha0 < bB->m_sweep.alpha0)
-				{
-					alpha0 = bB->m_sweep.alpha0;
-					bA->m_sweep.Advance(alpha0);
-				}
-				else if (bB->m_sweep.alpha0 < bA->m_sweep.alpha0)
-				{
-					alpha0 = bA->m_sweep.alpha0;
-					bB->m_sweep.Advance(alpha0);
-				}
+	// If the joint prevents collisions, then flag any contacts for filtering.
+	if (def->collideConnected == false)
+	{
+		cb2ContactEdge* edge = bodyB->GetContactList();
+		while (edge)
+		{
+			if (edge->other == bodyA)
+			{
+				// Flag the contact for filtering at the next time step (where either
+				// body is awake).
+				edge->contact->FlagForFiltering();
+			}
 
-				cb2Assert(alpha0 < 1.0f);
+			edge = edge->next;
+		}
+	}
 
-				int indexA = c->GetChildIndexA();
-				int indexB = c->GetChildIndexB();
+	// Note: creating a joint doesn't wake the bodies.
 
-				// Compute the time of impact in interval [0, minTOI]
-				cb2TOIInput input;
-				input.proxyA.set(fA->GetShape(), indexA);
-				input.proxyB.set(fB->GetShape(), indexB);
-				input.sweepA = bA->m_sweep;
-				input.sweepB = bB->m_sweep;
-				input.tMax = 1.0f;
+	return j;
+}
 
-				cb2TOIOutput output;
-				cb2TimeOfImpact(&output, &input);
+void cb2World::DestroyJoint(cb2Joint* j)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
 
-				// Beta is the fraction of the remaining portion of the .
-				float beta = output.t;
-				if (output.state == cb2TOIOutput::e_touching)
-				{
-					alpha = cb2Min(alpha0 + (1.0f - alpha0) * beta, 1.0f);
-				}
-				else
-				{
-					alpha = 1.0f;
-				}
+	bool collideConnected = j->m_collideConnected;
 
-				c->m_toi = alpha;
-				c->m_flags |= cb2Contact::e_toiFlag;
-			}
+	if (j->m_persistentIsland)
+	{
+		m_islandGraph.UnlinkJoint(j);
+	}
 
-			if (alpha < minAlpha)
-			{
-				// This is the minimum TOI found so far.
-				minContact = c;
-				minAlpha = alpha;
-			}
-		}
+	// Remove from the doubly linked list.
+	if (j->m_prev)
+	{
+		j->m_prev->m_next = j->m_next;
+	}
 
-		if (minContact == NULL || 1.0f - 10.0f * cb2_epsilon < minAlpha)
-		{
-			// No more TOI events. Done!
-			m_stepComplete = true;
-			break;
-		}
+	if (j->m_next)
+	{
+		j->m_next->m_prev = j->m_prev;
+	}
 
-		// Advance the bodies to the TOI.
-		cb2Fixture* fA = minContact->GetFixtureA();
-		cb2Fixture* fB = minContact->GetFixtureB();
-		cb2Body* bA = fA->GetBody();
-		cb2Body* bB = fB->GetBody();
+	if (j == m_jointList)
+	{
+		m_jointList = j->m_next;
+	}
+
+	// Disconnect from island graph.
+	cb2Body* bodyA = j->m_bodyA;
+	cb2Body* bodyB = j->m_bodyB;
+
+	// Wake up connected bodies.
+	bodyA->SetAwake(true);
+	bodyB->SetAwake(true);
+
+	// Remove from body 1.
+	if (j->m_edgeA.prev)
+	{
+		j->m_edgeA.prev->next = j->m_edgeA.next;
+	}
+
+	if (j->m_edgeA.next)
+	{
+		j->m_edgeA.next->prev = j->m_edgeA.prev;
+	}
+
+	if (&j->m_edgeA == bodyA->m_jointList)
+	{
+		bodyA->m_jointList = j->m_edgeA.next;
+	}
+
+	j->m_edgeA.prev = NULL;
+	j->m_edgeA.next = NULL;
+
+	// Remove from body 2
+	if (j->m_edgeB.prev)
+	{
+		j->m_edgeB.prev->next = j->m_edgeB.next;
+	}
+
+	if (j->m_edgeB.next)
+	{
+		j->m_edgeB.next->prev = j->m_edgeB.prev;
+	}
+
+	if (&j->m_edgeB == bodyB->m_jointList)
+	{
+		bodyB->m_jointList = j->m_edgeB.next;
+	}
+
+	j->m_edgeB.prev = NULL;
+	j->m_edgeB.next = NULL;
+
+	cb2Joint::Destroy(j, &m_blockAllocator);
+
+	cb2Assert(m_jointCount > 0);
+	--m_jointCount;
+
+	// If the joint prevents collisions, then flag any contacts for filtering.
+	if (collideConnected == false)
+	{
+		cb2ContactEdge* edge = bodyB->GetContactList();
+		while (edge)
+		{
+			if (edge->other == bodyA)
+			{
+				// Flag the contact for filtering at the next time step (where either
+				// body is awake).
+				edge->contact->FlagForFiltering();
+			}
+
+			edge = edge->next;
+		}
+	}
+}
+
+cb2ParticleSystem* cb2World::CreateParticleSystem(const cb2ParticleSystemDef* def)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return NULL;
+	}
+
+	void* mem = cb2Alloc(sizeof(cb2ParticleSystem));
+	cb2ParticleSystem* ps = new (mem) cb2ParticleSystem(def, this);
+
+	// Add to world doubly linked list.
+	ps->m_prev = NULL;
+	ps->m_next = m_particleSystemList;
+	if (m_particleSystemList)
+	{
+		m_particleSystemList->m_prev = ps;
+	}
+	m_particleSystemList = ps;
+	++m_particleSystemCount;
+
+	return ps;
+}
+
+void cb2World::DestroyParticleSystem(cb2ParticleSystem* ps)
+{
+	cb2Assert(m_particleSystemCount > 0);
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	// Remove from the world list.
+	if (ps->m_prev)
+	{
+		ps->m_prev->m_next = ps->m_next;
+	}
+
+	if (ps->m_next)
+	{
+		ps->m_next->m_prev = ps->m_prev;
+	}
+
+	if (ps == m_particleSystemList)
+	{
+		m_particleSystemList = ps->m_next;
+	}
+
+	--m_particleSystemCount;
+
+	ps->~cb2ParticleSystem();
+	cb2Free(ps);
+}
+
+//
+void cb2World::SetAllowSleeping(bool flag)
+{
+	if (flag == m_allowSleep)
+	{
+		return;
+	}
+
+	m_allowSleep = flag;
+	if (m_allowSleep == false)
+	{
+		for (cb2Body* b = m_bodyList; b; b = b->m_next)
+		{
+			b->SetAwake(true);
+		}
+	}
+}
+
+void cb2World::DestroyBrokenJoints()
+{
+	cb2Joint* j = m_jointList;
+	while (j)
+	{
+		cb2Joint* next = j->m_next;
+		if (j->m_breakInvDt > 0.0f)
+		{
+			if (m_contactEvents)
+			{
+				m_contactEvents->AddBreak(j, j->m_breakInvDt);
+			}
+
+			if (m_destructionListener)
+			{
+				m_destructionListener->SayGoodbye(j);
+			}
+
+			DestroyJoint(j);
+		}
+		j = next;
+	}
+}
+
+// Find islands, integrate and solve constraints, solve position constraints
+void cb2World::Solve(const cb2TimeStep& step)
+{
+	m_profile.solveInit = 0.0f;
+	m_profile.solveVelocity = 0.0f;
+	m_profile.solvePosition = 0.0f;
+	m_profile.velocityIterations = 0;
+	m_profile.positionIterations = 0;
+	m_profile.maxVelocityIterations = 0;
+	m_profile.islandCount = 0;
+	m_profile.islandContactCount = 0;
+	m_profile.deferredIslands = 0;
+	m_profile.maxSolveDebt = 0.0f;
+	m_profile.jointsBroken = 0;
+	m_solveTimer.Reset();
+
+	// The time step of each level of detail.
+	for (int i = 1; i <= m_lodLevelCount; ++i)
+	{
+		const cb2LodLevel& level = m_lodLevels[i - 1];
+		cb2TimeStep& lodStep = m_lodSteps[i];
+		lodStep = step;
+		lodStep.dt = step.dt * level.stepInterval;
+		lodStep.inv_dt = step.inv_dt / level.stepInterval;
+		lodStep.velocityIterations = cb2Min(step.velocityIterations, level.velocityIterations);
+		lodStep.positionIterations = cb2Min(step.positionIterations, level.positionIterations);
+		lodStep.subStepCount = cb2Min(step.subStepCount, level.velocityIterations);
+	}
+
+	if (m_persistentIslands)
+	{
+		SolvePersistentIslands(step);
+	}
+	else if (m_threadPool)
+	{
+		SolveIslandsParallel(step);
+	}
+	else
+	{
+		SolveIslands(step);
+	}
+
+	{
+		cb2ProfileZone zone(m_profiler, "Broadphase");
+		cb2Timer timer;
+		// Synchronize fixtures, check for out of range bodies.
+		int bodyIndex;
+		if (m_threadPool)
+		{
+			SynchronizeFixturesParallel(step);
+		}
+		else
+		{
+			for (cb2Body* b = GetFirstAwakeBody(&bodyIndex); b; b = GetNextAwakeBody(b, &bodyIndex))
+			{
+				if (NeedsSynchronize(b) == false)
+				{
+					continue;
+				}
+
+				// Update fixtures (for broad-phase).
+				if (step.speculativeContacts)
+				{
+					b->SynchronizeFixtures(step.dt * b->m_linearVelocity);
+				}
+				else
+				{
+					b->SynchronizeFixtures();
+				}
+			}
+		}
+
+		// Drop the bodies that fell asleep and the static bodies SolveTOI advanced.
+		// They are reset as SolveTOI resets the awake bodies, which is where a body
+		// leaving the set would miss it.
+		if (m_awakeBodies)
+		{
+			int i = 0;
+			while (i < m_awakeBodyCount)
+			{
+				cb2Body* b = m_awakeBodies[i];
+				if (b->IsAwake() && b->m_type != cb2_staticBody)
+				{
+					++i;
+					continue;
+				}
+
+				b->m_flags &= ~cb2Body::e_islandFlag;
+				b->m_sweep.alpha0 = 0.0f;
+				RemoveAwakeBody(b);
+			}
+		}
+
+		// Look for new contacts.
+		m_contactManager.FindNewContacts();
+		m_profile.broadphase = timer.GetMilliseconds();
+	}
+}
+
+// An island is as detailed as its most detailed body. The islands that skip steps
+// are spread over the steps by their smallest body id, which stays the same while
+// the island does. An island that owes time is solved in any case, with some of
+// the time it owes added to its time step, and it is not deferred again so the
+// budget cannot starve it.
+int cb2World::PrepareIsland(cb2Body* const* bodies, int count, const cb2TimeStep& step, cb2TimeStep* islandStep, bool* owesTime)
+{
+	int lod = m_lodLevelCount;
+	int minId = -1;
+	float debt = 0.0f;
+	for (int i = 0; i < count; ++i)
+	{
+		const cb2Body* b = bodies[i];
+		if (b->m_type == cb2_staticBody)
+		{
+			continue;
+		}
+
+		debt = cb2Max(debt, b->m_solveDebt);
+		if (lod == 0)
+		{
+			continue;
+		}
+
+		int level = b->m_lodLevel;
+		if (level < 0)
+		{
+			level = 0;
+			if (m_lodObserverCount > 0)
+			{
+				float distanceSquared = cb2_maxFloat;
+				for (int j = 0; j < m_lodObserverCount; ++j)
+				{
+					distanceSquared = cb2Min(distanceSquared, cb2DistanceSquared(b->m_sweep.c, m_lodObservers[j]));
+				}
+
+				while (level < m_lodLevelCount && m_lodLevels[level].distance * m_lodLevels[level].distance <= distanceSquared)
+				{
+					++level;
+				}
+			}
+		}
+
+		lod = cb2Min(lod, level);
+		minId = minId < 0 ? b->m_id : cb2Min(minId, b->m_id);
+	}
+
+	bool due = true;
+	bool continuous = true;
+	if (lod > 0)
+	{
+		const cb2LodLevel& level = m_lodLevels[lod - 1];
+		due = (m_stepCount + minId) % level.stepInterval == 0;
+		continuous = due && level.continuous;
+	}
+
+	float catchUp = cb2Min(debt, cb2_maxCatchUpSteps * step.dt);
+	bool solve = due || catchUp > 0.0f;
+	*owesTime = catchUp > 0.0f;
+
+	for (int i = 0; i < count; ++i)
+	{
+		cb2Body* b = bodies[i];
+		if (b->m_type == cb2_staticBody)
+		{
+			continue;
+		}
+
+		b->m_currentLod = lod;
+		b->m_solveDebt = cb2Max(b->m_solveDebt - catchUp, 0.0f);
+		if (continuous)
+		{
+			b->m_flags &= ~cb2Body::e_lodFlag;
+		}
+		else
+		{
+			b->m_flags |= cb2Body::e_lodFlag;
+		}
+
+		// A skipped island keeps still, so the broad-phase and continuous collision
+		// see no motion.
+		if (solve == false)
+		{
+			b->m_sweep.c0 = b->m_sweep.c;
+			b->m_sweep.a0 = b->m_sweep.a;
+		}
+	}
+
+	if (solve == false)
+	{
+		return -1;
+	}
+
+	*islandStep = lod > 0 ? m_lodSteps[lod] : step;
+	if (catchUp > 0.0f)
+	{
+		islandStep->dt = (due ? islandStep->dt : 0.0f) + catchUp;
+		islandStep->inv_dt = 1.0f / islandStep->dt;
+	}
+	return lod;
+}
+
+bool cb2World::IsOverSolveBudget() const
+{
+	return m_solveBudget > 0.0f && m_deterministic == false && m_solveTimer.GetMilliseconds() > m_solveBudget;
+}
+
+// The awake bodies as island seeds. With a solve budget the bodies that owe time
+// come first, so the islands deferred by the last step are solved before the budget
+// runs out again.
+cb2Body* cb2World::GetNextSeed(cb2Body* b, int* index, int* pass) const
+{
+	b = GetNextAwakeBody(b, index);
+	if (b == NULL && *pass == 0)
+	{
+		*pass = 1;
+		b = GetFirstAwakeBody(index);
+	}
+	return b;
+}
+
+void cb2World::SolveIslands(const cb2TimeStep& step)
+{
+	// Size the island for the worst case.
+	cb2Island island(m_bodyCount,
+					m_contactManager.m_contactCount,
+					m_jointCount,
+					m_stackAllocator,
+					m_contactManager.m_contactListener);
+	island.m_profiler = m_profiler;
+	island.m_targetDrives = m_targetDrives;
+
+	// Clear the island flags. The bodies and contacts outside the awake sets are
+	// clear already, and joints are cleared after their island is solved.
+	int bodyIndex;
+	for (cb2Body* b = GetFirstAwakeBody(&bodyIndex); b; b = GetNextAwakeBody(b, &bodyIndex))
+	{
+		b->m_flags &= ~cb2Body::e_islandFlag;
+	}
+	int contactIndex;
+	for (cb2Contact* c = m_contactManager.GetFirstAwakeContact(&contactIndex); c; c = m_contactManager.GetNextAwakeContact(c, &contactIndex))
+	{
+		c->m_flags &= ~cb2Contact::e_islandFlag;
+	}
+
+	// Build and simulate all awake islands.
+	int stackSize = m_bodyCount;
+	cb2Body** stack = (cb2Body**)m_stackAllocator->Allocate(stackSize * sizeof(cb2Body*));
+	int pass = m_solveBudget > 0.0f ? 0 : 1;
+	for (cb2Body* seed = GetFirstAwakeBody(&bodyIndex); seed; seed = GetNextSeed(seed, &bodyIndex, &pass))
+	{
+		if (seed->m_flags & cb2Body::e_islandFlag)
+		{
+			continue;
+		}
+
+		if (pass == 0 && seed->m_solveDebt == 0.0f)
+		{
+			continue;
+		}
+
+		if (seed->IsAwake() == false || seed->IsActive() == false)
+		{
+			continue;
+		}
+
+		// The seed can be dynamic or kinematic.
+		if (seed->GetType() == cb2_staticBody)
+		{
+			continue;
+		}
+
+		// Reset island and stack.
+		island.Clear();
+		int stackCount = 0;
+		stack[stackCount++] = seed;
+		seed->m_flags |= cb2Body::e_islandFlag;
+
+		// Perform a depth first search (DFS) on the constraint graph.
+		while (stackCount > 0)
+		{
+			// Grab the next body off the stack and add it to the island.
+			cb2Body* b = stack[--stackCount];
+			cb2Assert(b->IsActive() == true);
+			island.Add(b);
+
+			// Make sure the body is awake.
+			b->SetAwake(true);
+
+			// To keep islands as small as possible, we don't
+			// propagate islands across static bodies.
+			if (b->GetType() == cb2_staticBody)
+			{
+				continue;
+			}
+
+			// Search all contacts connected to this body.
+			for (cb2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+			{
+				cb2Contact* contact = ce->contact;
+
+				// Has this contact already been added to an island?
+				if (contact->m_flags & cb2Contact::e_islandFlag)
+				{
+					continue;
+				}
+
+				// Is this contact solid and touching?
+				if (contact->IsEnabled() == false ||
+					contact->IsTouching() == false)
+				{
+					continue;
+				}
+
+				// Skip sensors.
+				bool sensorA = contact->m_fixtureA->m_isSensor;
+				bool sensorB = contact->m_fixtureB->m_isSensor;
+				if (sensorA || sensorB)
+				{
+					continue;
+				}
+
+				island.Add(contact);
+				contact->m_flags |= cb2Contact::e_islandFlag;
+
+				cb2Body* other = ce->other;
+
+				// Was the other body already added to this island?
+				if (other->m_flags & cb2Body::e_islandFlag)
+				{
+					continue;
+				}
+
+				cb2Assert(stackCount < stackSize);
+				stack[stackCount++] = other;
+				other->m_flags |= cb2Body::e_islandFlag;
+			}
+
+			// Search all joints connect to this body.
+			for (cb2JointEdge* je = b->m_jointList; je; je = je->next)
+			{
+				if (je->joint->m_islandFlag == true)
+				{
+					continue;
+				}
+
+				cb2Body* other = je->other;
+
+				// Don't simulate joints connected to inactive bodies.
+				if (other->IsActive() == false)
+				{
+					continue;
+				}
+
+				island.Add(je->joint);
+				je->joint->m_islandFlag = true;
+
+				if (other->m_flags & cb2Body::e_islandFlag)
+				{
+					continue;
+				}
+
+				cb2Assert(stackCount < stackSize);
+				stack[stackCount++] = other;
+				other->m_flags |= cb2Body::e_islandFlag;
+			}
+		}
+
+		// Islands far from the observers may sit out this step, and the islands found
+		// once the solve budget is used up are deferred.
+		cb2TimeStep islandStep = step;
+		bool owesTime = false;
+		int lod = m_lodLevelCount > 0 || m_solveBudget > 0.0f ? PrepareIsland(island.m_bodies, island.m_bodyCount, step, &islandStep, &owesTime) : 0;
+		if (lod >= 0 && owesTime == false && IsOverSolveBudget())
+		{
+			float debt = island.Defer(islandStep.dt, cb2_maxSolveDebtSteps * step.dt);
+			m_profile.maxSolveDebt = cb2Max(m_profile.maxSolveDebt, debt);
+			++m_profile.deferredIslands;
+		}
+		else if (lod >= 0)
+		{
+			cb2Profile profile;
+			island.Solve(&profile, islandStep, m_gravity, m_allowSleep);
+			m_profile.solveInit += profile.solveInit;
+			m_profile.solveVelocity += profile.solveVelocity;
+			m_profile.solvePosition += profile.solvePosition;
+			m_profile.velocityIterations += profile.velocityIterations;
+			m_profile.positionIterations += profile.positionIterations;
+			m_profile.maxVelocityIterations = cb2Max(m_profile.maxVelocityIterations, profile.maxVelocityIterations);
+			m_profile.islandCount += 1;
+			m_profile.islandContactCount += island.m_contactCount;
+			m_profile.jointsBroken += profile.jointsBroken;
+		}
+
+		// Post solve cleanup.
+		for (int i = 0; i < island.m_bodyCount; ++i)
+		{
+			// Allow static bodies to participate in other islands.
+			cb2Body* b = island.m_bodies[i];
+			if (b->GetType() == cb2_staticBody)
+			{
+				b->m_flags &= ~cb2Body::e_islandFlag;
+			}
+		}
+
+		for (int i = 0; i < island.m_jointCount; ++i)
+		{
+			island.m_joints[i]->m_islandFlag = false;
+		}
+	}
+
+	m_stackAllocator->Free(stack);
+}
+
+void cb2World::SetAwakeSets(bool flag)
+{
+	cb2Assert(IsLocked() == false);
+	if (flag == GetAwakeSets())
+	{
+		return;
+	}
+
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b->m_awakeIndex = -1;
+	}
+
+	cb2Free(m_awakeBodies);
+	m_awakeBodies = NULL;
+	m_awakeBodyCount = 0;
+	m_awakeBodyCapacity = 0;
+	m_contactManager.SetAwakeContacts(flag);
+
+	if (flag == false)
+	{
+		return;
+	}
+
+	m_awakeBodyCapacity = cb2Max(m_bodyCount, 64);
+	m_awakeBodies = (cb2Body**)cb2Alloc(m_awakeBodyCapacity * sizeof(cb2Body*));
+
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if (b->IsAwake() && b->m_type != cb2_staticBody)
+		{
+			AddAwakeBody(b);
+		}
+	}
+}
+
+void cb2World::SetSolverType(cb2SolverType type, int subStepCount)
+{
+	cb2Assert(subStepCount > 0);
+	m_solverType = type;
+	m_subStepCount = subStepCount;
+}
+
+void cb2World::Reserve(int bodyCount, int fixtureCount, int proxyCount, int contactCount, int jointCount)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	m_blockAllocator.Reserve(sizeof(cb2Body), bodyCount);
+	m_blockAllocator.Reserve(sizeof(cb2Fixture), fixtureCount);
+	m_blockAllocator.Reserve(sizeof(cb2FixtureProxy), fixtureCount);
+	m_blockAllocator.Reserve(sizeof(cb2PolygonShape), fixtureCount);
+	m_blockAllocator.Reserve(sizeof(cb2PolygonContact), contactCount);
+	m_blockAllocator.Reserve(sizeof(cb2RevoluteJoint), jointCount);
+	if (m_persistentIslands)
+	{
+		m_blockAllocator.Reserve(sizeof(cb2PersistentIsland), bodyCount);
+	}
+
+	m_contactManager.Reserve(proxyCount, contactCount);
+
+	if (m_awakeBodies && bodyCount > m_awakeBodyCapacity)
+	{
+		cb2Body** oldBodies = m_awakeBodies;
+		m_awakeBodyCapacity = bodyCount;
+		m_awakeBodies = (cb2Body**)cb2Alloc(m_awakeBodyCapacity * sizeof(cb2Body*));
+		memcpy(m_awakeBodies, oldBodies, m_awakeBodyCount * sizeof(cb2Body*));
+		cb2Free(oldBodies);
+	}
+
+	// One island of everything: the island arrays, the traversal stack and the
+	// contact solver. The position constraints are smaller than the velocity constraints.
+	int stackSize = bodyCount * (2 * sizeof(cb2Body*) + sizeof(cb2Position) + sizeof(cb2Velocity));
+	stackSize += contactCount * (sizeof(cb2Contact*) + 2 * sizeof(cb2ContactVelocityConstraint));
+	stackSize += jointCount * sizeof(cb2Joint*);
+	m_stackAllocator->Reserve(stackSize);
+}
+
+void cb2World::AddAwakeBody(cb2Body* body)
+{
+	cb2Assert(body->m_awakeIndex == -1);
+
+	if (m_awakeBodyCount == m_awakeBodyCapacity)
+	{
+		cb2Body** oldBodies = m_awakeBodies;
+		m_awakeBodyCapacity *= 2;
+		m_awakeBodies = (cb2Body**)cb2Alloc(m_awakeBodyCapacity * sizeof(cb2Body*));
+		memcpy(m_awakeBodies, oldBodies, m_awakeBodyCount * sizeof(cb2Body*));
+		cb2Free(oldBodies);
+	}
+
+	body->m_awakeIndex = m_awakeBodyCount;
+	m_awakeBodies[m_awakeBodyCount] = body;
+	++m_awakeBodyCount;
+}
+
+void cb2World::RemoveAwakeBody(cb2Body* body)
+{
+	cb2Assert(0 <= body->m_awakeIndex && body->m_awakeIndex < m_awakeBodyCount);
+
+	// Swap the last body into the hole.
+	cb2Body* last = m_awakeBodies[m_awakeBodyCount - 1];
+	m_awakeBodies[body->m_awakeIndex] = last;
+	last->m_awakeIndex = body->m_awakeIndex;
+	body->m_awakeIndex = -1;
+	--m_awakeBodyCount;
+}
+
+void cb2World::SetLodLevels(const cb2LodLevel* levels, int count)
+{
+	cb2Assert(0 <= count && count <= cb2_maxLodLevels);
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		cb2Assert(i == 0 || levels[i - 1].distance <= levels[i].distance);
+		cb2Assert(levels[i].velocityIterations >= 1 && levels[i].positionIterations >= 0);
+		cb2Assert(levels[i].stepInterval >= 1);
+		m_lodLevels[i] = levels[i];
+	}
+	m_lodLevelCount = count;
+
+	// The bodies are at full detail until their islands are solved again.
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b->m_flags &= ~cb2Body::e_lodFlag;
+		b->m_currentLod = 0;
+	}
+}
+
+void cb2World::SetLodObservers(const ci::Vec2f* points, int count)
+{
+	cb2Assert(0 <= count && count <= cb2_maxLodObservers);
+	count = cb2Min(count, cb2_maxLodObservers);
+	for (int i = 0; i < count; ++i)
+	{
+		m_lodObservers[i] = points[i];
+	}
+	m_lodObserverCount = count;
+}
+
+void cb2World::SetPersistentIslands(bool flag)
+{
+	cb2Assert(IsLocked() == false);
+	if (flag == m_persistentIslands)
+	{
+		return;
+	}
+
+	m_persistentIslands = flag;
+	if (m_persistentIslands == false)
+	{
+		m_islandGraph.Clear();
+		return;
+	}
+
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if (b->m_type != cb2_staticBody)
+		{
+			m_islandGraph.AddBody(b);
+		}
+	}
+
+	for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+	{
+		if (c->IsTouching() && c->m_fixtureA->m_isSensor == false && c->m_fixtureB->m_isSensor == false)
+		{
+			m_islandGraph.LinkContact(c);
+		}
+	}
+
+	for (cb2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		m_islandGraph.LinkJoint(j);
+	}
+}
+
+static cb2PersistentIsland* cb2NextIsland(cb2PersistentIsland* pi, cb2PersistentIsland* first, int* pass)
+{
+	pi = pi->next;
+	if (pi == NULL && *pass == 0)
+	{
+		*pass = 1;
+		pi = first;
+	}
+	return pi;
+}
+
+// Same as SolveIslands, but the islands come from the island graph. Islands
+// that lost a constraint do not fall asleep. Instead the one with the sleepiest
+// body is split after the solve, at most one per step.
+void cb2World::SolvePersistentIslands(const cb2TimeStep& step)
+{
+	// Size the island for the worst case.
+	cb2Island island(m_bodyCount,
+					m_contactManager.m_contactCount,
+					m_jointCount,
+					m_stackAllocator,
+					m_contactManager.m_contactListener);
+	island.m_profiler = m_profiler;
+	island.m_targetDrives = m_targetDrives;
+
+	cb2PersistentIsland* splitIsland = NULL;
+	float splitSleepTime = 0.0f;
+
+	// With a solve budget the islands that owe time come first, see GetNextSeed.
+	cb2PersistentIsland* islandList = m_islandGraph.GetIslandList();
+	int pass = m_solveBudget > 0.0f ? 0 : 1;
+	for (cb2PersistentIsland* pi = islandList; pi; pi = cb2NextIsland(pi, islandList, &pass))
+	{
+		if (pi->visitStep == m_stepCount)
+		{
+			continue;
+		}
+
+		if (pass == 0 && (pi->bodyList == NULL || pi->bodyList->m_solveDebt == 0.0f))
+		{
+			continue;
+		}
+		pi->visitStep = m_stepCount;
+
+		// The island is simulated if one of its active bodies is awake.
+		if (pi->awake)
+		{
+			pi->awake = false;
+			for (cb2Body* b = pi->bodyList; b; b = b->m_islandNext)
+			{
+				if (b->IsAwake() && b->IsActive())
+				{
+					pi->awake = true;
+					break;
+				}
+			}
+		}
+
+		if (pi->awake == false)
+		{
+			// The bodies did not move since the island fell asleep.
+			if (pi->solved)
+			{
+				for (cb2Body* b = pi->bodyList; b; b = b->m_islandNext)
+				{
+					b->m_flags &= ~cb2Body::e_islandFlag;
+				}
+				pi->solved = false;
+			}
+			continue;
+		}
+
+		island.Clear();
+
+		for (cb2Body* b = pi->bodyList; b; b = b->m_islandNext)
+		{
+			if (b->IsActive() == false)
+			{
+				continue;
+			}
+
+			island.Add(b);
+			b->SetAwake(true);
+			b->m_flags |= cb2Body::e_islandFlag;
+		}
+
+		// Static bodies join each island they touch.
+		for (cb2Contact* contact = pi->contactList; contact; contact = contact->m_islandLink->next)
+		{
+			if (contact->IsEnabled() == false || contact->IsTouching() == false)
+			{
+				continue;
+			}
+
+			island.Add(contact);
+			contact->m_flags |= cb2Contact::e_islandFlag;
+
+			cb2Body* bodies[2] = { contact->m_fixtureA->m_body, contact->m_fixtureB->m_body };
+			for (int i = 0; i < 2; ++i)
+			{
+				cb2Body* other = bodies[i];
+				if ((other->m_flags & cb2Body::e_islandFlag) == 0)
+				{
+					cb2Assert(other->GetType() == cb2_staticBody);
+					island.Add(other);
+					other->SetAwake(true);
+					other->m_flags |= cb2Body::e_islandFlag;
+				}
+			}
+		}
+
+		for (cb2Joint* joint = pi->jointList; joint; joint = joint->m_islandNext)
+		{
+			// Don't simulate joints connected to inactive bodies.
+			cb2Body* bodies[2] = { joint->m_bodyA, joint->m_bodyB };
+			if (bodies[0]->IsActive() == false || bodies[1]->IsActive() == false)
+			{
+				continue;
+			}
+
+			island.Add(joint);
+
+			for (int i = 0; i < 2; ++i)
+			{
+				cb2Body* other = bodies[i];
+				if ((other->m_flags & cb2Body::e_islandFlag) == 0)
+				{
+					cb2Assert(other->GetType() == cb2_staticBody);
+					island.Add(other);
+					other->SetAwake(true);
+					other->m_flags |= cb2Body::e_islandFlag;
+				}
+			}
+		}
+
+		island.m_splitPending = pi->constraintRemoveCount > 0;
+
+		// Islands far from the observers may sit out this step, and the islands found
+		// once the solve budget is used up are deferred.
+		cb2TimeStep islandStep = step;
+		bool owesTime = false;
+		int lod = m_lodLevelCount > 0 || m_solveBudget > 0.0f ? PrepareIsland(island.m_bodies, island.m_bodyCount, step, &islandStep, &owesTime) : 0;
+		if (lod >= 0 && owesTime == false && IsOverSolveBudget())
+		{
+			float debt = island.Defer(islandStep.dt, cb2_maxSolveDebtSteps * step.dt);
+			m_profile.maxSolveDebt = cb2Max(m_profile.maxSolveDebt, debt);
+			++m_profile.deferredIslands;
+		}
+		else if (lod >= 0)
+		{
+			cb2Profile profile;
+			island.Solve(&profile, islandStep, m_gravity, m_allowSleep);
+			m_profile.solveInit += profile.solveInit;
+			m_profile.solveVelocity += profile.solveVelocity;
+			m_profile.solvePosition += profile.solvePosition;
+			m_profile.velocityIterations += profile.velocityIterations;
+			m_profile.positionIterations += profile.positionIterations;
+			m_profile.maxVelocityIterations = cb2Max(m_profile.maxVelocityIterations, profile.maxVelocityIterations);
+			m_profile.islandCount += 1;
+			m_profile.islandContactCount += island.m_contactCount;
+			m_profile.jointsBroken += profile.jointsBroken;
+		}
+		pi->solved = true;
+
+		// Post solve cleanup.
+		for (int i = 0; i < island.m_bodyCount; ++i)
+		{
+			// Allow static bodies to participate in other islands.
+			cb2Body* b = island.m_bodies[i];
+			if (b->GetType() == cb2_staticBody)
+			{
+				b->m_flags &= ~cb2Body::e_islandFlag;
+			}
+			else if (b->IsAwake() == false)
+			{
+				// The whole island fell asleep.
+				pi->awake = false;
+			}
+		}
+
+		for (int i = 0; i < island.m_contactCount; ++i)
+		{
+			island.m_contacts[i]->m_flags &= ~cb2Contact::e_islandFlag;
+		}
+
+		if (island.m_splitPending && island.m_maxSleepTime > splitSleepTime)
+		{
+			splitIsland = pi;
+			splitSleepTime = island.m_maxSleepTime;
+		}
+	}
+
+	if (splitIsland)
+	{
+		m_islandGraph.SplitIsland(splitIsland, m_stackAllocator);
+	}
+}
+
+// An island found by the depth first search in SolveIslandsParallel. The
+// ranges index the shared body, contact, and joint arrays.
+struct cb2IslandRange
+{
+	int bodyIndex;
+	int staticCount;
+	int bodyCount;
+	int contactIndex;
+	int contactCount;
+	int jointIndex;
+	int jointCount;
+	bool split;
+	int lod;	// the level of detail, -1 if the island sits out this step
+	bool owesTime;
+	cb2TimeStep step;
+};
+
+// Islands with at least this many constraints are split across the threads
+// when cb2World::SetSplitIslands is enabled.
+const int cb2_minSplitIslandConstraints = 256;
+
+// Solves islands on the thread pool. Each thread uses its own stack allocator
+// and profile. Post solve impulses are stored for the caller to report. With a
+// pool, only the split islands are solved and they use the pool themselves.
+void cb2World::SetKinematicStates(const cb2KinematicState* states, int count)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked() || count <= 0)
+	{
+		return;
+	}
+
+	cb2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	int moveCount = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		for (cb2Fixture* f = states[i].body->m_fixtureList; f; f = f->m_next)
+		{
+			moveCount += f->m_proxyCount;
+		}
+	}
+
+	cb2ProxyMove* moves = (cb2ProxyMove*)m_stackAllocator->Allocate(cb2Max(moveCount, 1) * sizeof(cb2ProxyMove));
+	cb2ProxyMove* move = moves;
+	for (int i = 0; i < count; ++i)
+	{
+		const cb2KinematicState* state = states + i;
+		cb2Body* b = state->body;
+		cb2Assert(b->m_type == cb2_kinematicBody);
+		cb2Assert(cb2::isValid(state->position) && cb2::isValid(state->angle));
+
+		b->m_xf.q.set(state->angle);
+		b->m_xf.p = state->position;
+		b->m_xf0 = b->m_xf;
+
+		b->m_sweep.c = cb2Mul(b->m_xf, b->m_sweep.localCenter);
+		b->m_sweep.a = state->angle;
+		b->m_sweep.c0 = b->m_sweep.c;
+		b->m_sweep.a0 = state->angle;
+
+		b->SetLinearVelocity(state->linearVelocity);
+		b->SetAngularVelocity(state->angularVelocity);
+
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			f->PrepareSynchronize(broadPhase, b->m_xf, b->m_xf, NULL, move);
+			move += f->m_proxyCount;
+		}
+	}
+
+	broadPhase->MoveProxies(moves, moveCount);
+	m_stackAllocator->Free(moves);
+}
+
+bool cb2World::NeedsSynchronize(const cb2Body* b)
+{
+	// If a body was not in an island then it did not move.
+	if ((b->m_flags & cb2Body::e_islandFlag) == 0)
+	{
+		return false;
+	}
+
+	if (b->GetType() == cb2_staticBody)
+	{
+		return false;
+	}
+
+	// The sweep did not advance, so the proxies still cover the body. This skips
+	// kinematic bodies at rest.
+	return b->m_sweep.c0 != b->m_sweep.c || b->m_sweep.a0 != b->m_sweep.a;
+}
+
+class cb2SynchronizeFixturesTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		for (int i = begin; i < end; ++i)
+		{
+			cb2Body* b = bodies[i];
+			cb2Transform xf1;
+			xf1.q.set(b->m_sweep.a0);
+			xf1.p = b->m_sweep.c0 - cb2Mul(xf1.q, b->m_sweep.localCenter);
+
+			ci::Vec2f prediction = dt * b->m_linearVelocity;
+			cb2ProxyMove* bodyMoves = moves + offsets[i];
+			for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+			{
+				f->PrepareSynchronize(broadPhase, xf1, b->m_xf, speculative ? &prediction : NULL, bodyMoves);
+				bodyMoves += f->m_proxyCount;
+			}
+		}
+	}
+
+	cb2Body** bodies;
+	const int* offsets;
+	cb2ProxyMove* moves;
+	const cb2BroadPhase* broadPhase;
+	float dt;
+	bool speculative;
+};
+
+void cb2World::SynchronizeFixturesParallel(const cb2TimeStep& step)
+{
+	cb2Body** bodies = (cb2Body**)m_stackAllocator->Allocate(cb2Max(m_bodyCount, 1) * sizeof(cb2Body*));
+	int* offsets = (int*)m_stackAllocator->Allocate((m_bodyCount + 1) * sizeof(int));
+	int bodyCount = 0;
+	int moveCount = 0;
+	int bodyIndex;
+	for (cb2Body* b = GetFirstAwakeBody(&bodyIndex); b; b = GetNextAwakeBody(b, &bodyIndex))
+	{
+		if (NeedsSynchronize(b) == false)
+		{
+			continue;
+		}
+
+		offsets[bodyCount] = moveCount;
+		bodies[bodyCount++] = b;
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			moveCount += f->m_proxyCount;
+		}
+	}
+
+	cb2ProxyMove* moves = (cb2ProxyMove*)m_stackAllocator->Allocate(cb2Max(moveCount, 1) * sizeof(cb2ProxyMove));
+
+	cb2SynchronizeFixturesTask task;
+	task.bodies = bodies;
+	task.offsets = offsets;
+	task.moves = moves;
+	task.broadPhase = &m_contactManager.m_broadPhase;
+	task.dt = step.dt;
+	task.speculative = step.speculativeContacts;
+	m_threadPool->ParallelFor(&task, bodyCount, 32);
+
+	// Only the proxies that left their fat AABB change the trees. They are moved in
+	// the order of the serial path, so the pairs do not depend on the thread count.
+	cb2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	for (int i = 0; i < moveCount; ++i)
+	{
+		const cb2ProxyMove* move = moves + i;
+		if (move->move)
+		{
+			broadPhase->MoveProxy(move->proxyId, move->aabb, move->displacement);
+		}
+		if (move->touch)
+		{
+			broadPhase->TouchProxy(move->proxyId);
+		}
+	}
+
+	m_stackAllocator->Free(moves);
+	m_stackAllocator->Free(offsets);
+	m_stackAllocator->Free(bodies);
+}
+
+class cb2SolveIslandsTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			const cb2IslandRange* range = ranges + i;
+			if (range->split == (pool == NULL))
+			{
+				continue;
+			}
+
+			if (range->lod < 0)
+			{
+				for (int j = 0; j < range->contactCount; ++j)
+				{
+					impulses[range->contactIndex + j].count = 0;
+				}
+				continue;
+			}
+
+			cb2Island island(range->bodyCount, range->contactCount, range->jointCount,
+							allocators + threadIndex, listener);
+			island.m_impulses = impulses + range->contactIndex;
+			island.m_threadPool = pool;
+			island.m_profiler = profiler;
+			island.m_targetDrives = targetDrives;
+			island.m_threadIndex = threadIndex;
+
+			cb2Body** islandBodies = bodies + range->bodyIndex;
+			for (int j = 0; j < range->staticCount; ++j)
+			{
+				island.AddStatic(islandBodies[j]);
+			}
+			for (int j = range->staticCount; j < range->bodyCount; ++j)
+			{
+				island.Add(islandBodies[j]);
+			}
+			for (int j = 0; j < range->contactCount; ++j)
+			{
+				island.Add(contacts[range->contactIndex + j]);
+			}
+			for (int j = 0; j < range->jointCount; ++j)
+			{
+				island.Add(joints[range->jointIndex + j]);
+			}
+
+			cb2Profile* threadProfile = profiles + threadIndex;
+			if (budget > 0.0f && range->owesTime == false && timer->GetMilliseconds() > budget)
+			{
+				for (int j = 0; j < range->contactCount; ++j)
+				{
+					impulses[range->contactIndex + j].count = 0;
+				}
+
+				float debt = island.Defer(range->step.dt, maxDebt);
+				threadProfile->maxSolveDebt = cb2Max(threadProfile->maxSolveDebt, debt);
+				threadProfile->deferredIslands += 1;
+				continue;
+			}
+
+			cb2Profile profile;
+			island.Solve(&profile, range->step, gravity, allowSleep);
+
+			// Contact reduction may reorder the contacts, keep the impulses matched.
+			memcpy(contacts + range->contactIndex, island.m_contacts, range->contactCount * sizeof(cb2Contact*));
+
+			threadProfile->solveInit += profile.solveInit;
+			threadProfile->solveVelocity += profile.solveVelocity;
+			threadProfile->solvePosition += profile.solvePosition;
+			threadProfile->velocityIterations += profile.velocityIterations;
+			threadProfile->positionIterations += profile.positionIterations;
+			threadProfile->maxVelocityIterations = cb2Max(threadProfile->maxVelocityIterations, profile.maxVelocityIterations);
+			threadProfile->islandCount += 1;
+			threadProfile->islandContactCount += range->contactCount;
+			threadProfile->jointsBroken += profile.jointsBroken;
+		}
+	}
+
+	const cb2Timer* timer;
+	float budget;
+	float maxDebt;
+	ci::Vec2f gravity;
+	bool allowSleep;
+	cb2ContactListener* listener;
+	cb2Profiler* profiler;
+	cb2TargetDrives* targetDrives;
+	cb2ThreadPool* pool;
+	cb2StackAllocator* allocators;
+	cb2Profile* profiles;
+	const cb2IslandRange* ranges;
+	cb2Body** bodies;
+	cb2Contact** contacts;
+	cb2Joint** joints;
+	cb2ContactImpulse* impulses;
+};
+
+// Same search as SolveIslands, but the islands are recorded first and then
+// solved concurrently on the thread pool.
+void cb2World::SolveIslandsParallel(const cb2TimeStep& step)
+{
+	int contactCount = m_contactManager.m_contactCount;
+
+	// Clear the island flags. The bodies and contacts outside the awake sets are
+	// clear already, and joints are cleared after their island is solved.
+	int bodyIndex;
+	for (cb2Body* b = GetFirstAwakeBody(&bodyIndex); b; b = GetNextAwakeBody(b, &bodyIndex))
+	{
+		b->m_flags &= ~cb2Body::e_islandFlag;
+	}
+	int contactIndex;
+	for (cb2Contact* c = m_contactManager.GetFirstAwakeContact(&contactIndex); c; c = m_contactManager.GetNextAwakeContact(c, &contactIndex))
+	{
+		c->m_flags &= ~cb2Contact::e_islandFlag;
+	}
+
+	// A static body is repeated in every island that touches it, and each
+	// repeat is reached through a different contact or joint.
+	int bodyCapacity = m_bodyCount + contactCount + m_jointCount;
+	cb2Body** bodies = (cb2Body**)m_stackAllocator->Allocate(bodyCapacity * sizeof(cb2Body*));
+	cb2Contact** contacts = (cb2Contact**)m_stackAllocator->Allocate(contactCount * sizeof(cb2Contact*));
+	cb2Joint** joints = (cb2Joint**)m_stackAllocator->Allocate(m_jointCount * sizeof(cb2Joint*));
+	cb2IslandRange* ranges = (cb2IslandRange*)m_stackAllocator->Allocate(m_bodyCount * sizeof(cb2IslandRange));
+	int bodyCount = 0;
+	int islandContactCount = 0;
+	int islandJointCount = 0;
+	int islandCount = 0;
+
+	// Build all awake islands.
+	int stackSize = m_bodyCount;
+	cb2Body** stack = (cb2Body**)m_stackAllocator->Allocate(stackSize * sizeof(cb2Body*));
+	int pass = m_solveBudget > 0.0f ? 0 : 1;
+	for (cb2Body* seed = GetFirstAwakeBody(&bodyIndex); seed; seed = GetNextSeed(seed, &bodyIndex, &pass))
+	{
+		if (seed->m_flags & cb2Body::e_islandFlag)
+		{
+			continue;
+		}
+
+		if (pass == 0 && seed->m_solveDebt == 0.0f)
+		{
+			continue;
+		}
+
+		if (seed->IsAwake() == false || seed->IsActive() == false)
+		{
+			continue;
+		}
+
+		// The seed can be dynamic or kinematic.
+		if (seed->GetType() == cb2_staticBody)
+		{
+			continue;
+		}
+
+		cb2IslandRange* range = ranges + islandCount++;
+		range->bodyIndex = bodyCount;
+		range->contactIndex = islandContactCount;
+		range->jointIndex = islandJointCount;
+
+		int stackCount = 0;
+		stack[stackCount++] = seed;
+		seed->m_flags |= cb2Body::e_islandFlag;
+
+		// Perform a depth first search (DFS) on the constraint graph.
+		while (stackCount > 0)
+		{
+			// Grab the next body off the stack and add it to the island.
+			cb2Body* b = stack[--stackCount];
+			cb2Assert(b->IsActive() == true);
+			cb2Assert(bodyCount < bodyCapacity);
+			bodies[bodyCount++] = b;
+
+			// Make sure the body is awake.
+			b->SetAwake(true);
+
+			// To keep islands as small as possible, we don't
+			// propagate islands across static bodies.
+			if (b->GetType() == cb2_staticBody)
+			{
+				continue;
+			}
+
+			// Search all contacts connected to this body.
+			for (cb2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+			{
+				cb2Contact* contact = ce->contact;
+
+				// Has this contact already been added to an island?
+				if (contact->m_flags & cb2Contact::e_islandFlag)
+				{
+					continue;
+				}
+
+				// Is this contact solid and touching?
+				if (contact->IsEnabled() == false ||
+					contact->IsTouching() == false)
+				{
+					continue;
+				}
+
+				// Skip sensors.
+				bool sensorA = contact->m_fixtureA->m_isSensor;
+				bool sensorB = contact->m_fixtureB->m_isSensor;
+				if (sensorA || sensorB)
+				{
+					continue;
+				}
+
+				cb2Assert(islandContactCount < contactCount);
+				contacts[islandContactCount++] = contact;
+				contact->m_flags |= cb2Contact::e_islandFlag;
+
+				cb2Body* other = ce->other;
+
+				// Was the other body already added to this island?
+				if (other->m_flags & cb2Body::e_islandFlag)
+				{
+					continue;
+				}
+
+				cb2Assert(stackCount < stackSize);
+				stack[stackCount++] = other;
+				other->m_flags |= cb2Body::e_islandFlag;
+			}
+
+			// Search all joints connect to this body.
+			for (cb2JointEdge* je = b->m_jointList; je; je = je->next)
+			{
+				if (je->joint->m_islandFlag == true)
+				{
+					continue;
+				}
+
+				cb2Body* other = je->other;
+
+				// Don't simulate joints connected to inactive bodies.
+				if (other->IsActive() == false)
+				{
+					continue;
+				}
+
+				cb2Assert(islandJointCount < m_jointCount);
+				joints[islandJointCount++] = je->joint;
+				je->joint->m_islandFlag = true;
+
+				if (other->m_flags & cb2Body::e_islandFlag)
+				{
+					continue;
+				}
+
+				cb2Assert(stackCount < stackSize);
+				stack[stackCount++] = other;
+				other->m_flags |= cb2Body::e_islandFlag;
+			}
+		}
+
+		range->bodyCount = bodyCount - range->bodyIndex;
+		range->contactCount = islandContactCount - range->contactIndex;
+		range->jointCount = islandJointCount - range->jointIndex;
+		range->split = m_splitIslands && m_deterministic == false && range->contactCount + range->jointCount >= cb2_minSplitIslandConstraints;
+
+		// Move the static bodies to the front, sorted by address, and allow
+		// them to participate in other islands.
+		cb2Body** islandBodies = bodies + range->bodyIndex;
+		int staticCount = 0;
+		for (int i = 0; i < range->bodyCount; ++i)
+		{
+			cb2Body* b = islandBodies[i];
+			if (b->GetType() != cb2_staticBody)
+			{
+				continue;
+			}
+
+			b->m_flags &= ~cb2Body::e_islandFlag;
+
+			int j = staticCount;
+			islandBodies[i] = islandBodies[j];
+			while (j > 0 && islandBodies[j - 1] > b)
+			{
+				islandBodies[j] = islandBodies[j - 1];
+				--j;
+			}
+			islandBodies[j] = b;
+			++staticCount;
+		}
+		range->staticCount = staticCount;
+		range->step = step;
+		range->lod = 0;
+		range->owesTime = false;
+		if (m_lodLevelCount > 0 || m_solveBudget > 0.0f)
+		{
+			range->lod = PrepareIsland(islandBodies + staticCount, range->bodyCount - staticCount, step, &range->step, &range->owesTime);
+		}
+	}
+
+	m_stackAllocator->Free(stack);
+
+	for (int i = 0; i < islandJointCount; ++i)
+	{
+		joints[i]->m_islandFlag = false;
+	}
+
+	int threadCount = m_threadPool->GetThreadCount();
+	cb2Profile* profiles = (cb2Profile*)m_stackAllocator->Allocate(threadCount * sizeof(cb2Profile));
+	memset(profiles, 0, threadCount * sizeof(cb2Profile));
+	cb2ContactImpulse* impulses = (cb2ContactImpulse*)m_stackAllocator->Allocate(islandContactCount * sizeof(cb2ContactImpulse));
+
+	cb2SolveIslandsTask task;
+	task.timer = &m_solveTimer;
+	task.budget = m_deterministic ? 0.0f : m_solveBudget;
+	task.maxDebt = cb2_maxSolveDebtSteps * step.dt;
+	task.gravity = m_gravity;
+	task.allowSleep = m_allowSleep;
+	task.listener = m_contactManager.m_contactListener;
+	task.profiler = m_profiler;
+	task.targetDrives = m_targetDrives;
+	task.allocators = m_threadAllocators;
+	task.profiles = profiles;
+	task.ranges = ranges;
+	task.bodies = bodies;
+	task.contacts = contacts;
+	task.joints = joints;
+	task.impulses = impulses;
+	task.pool = NULL;
+	m_threadPool->ParallelFor(&task, islandCount, 1);
+
+	// Split islands are solved one at a time, each spread over the pool.
+	if (m_splitIslands && m_deterministic == false)
+	{
+		task.pool = m_threadPool;
+		task.Execute(0, islandCount, 0);
+	}
+
+	for (int i = 0; i < threadCount; ++i)
+	{
+		m_profile.solveInit += profiles[i].solveInit;
+		m_profile.solveVelocity += profiles[i].solveVelocity;
+		m_profile.solvePosition += profiles[i].solvePosition;
+		m_profile.velocityIterations += profiles[i].velocityIterations;
+		m_profile.positionIterations += profiles[i].positionIterations;
+		m_profile.maxVelocityIterations = cb2Max(m_profile.maxVelocityIterations, profiles[i].maxVelocityIterations);
+		m_profile.islandCount += profiles[i].islandCount;
+		m_profile.islandContactCount += profiles[i].islandContactCount;
+		m_profile.deferredIslands += profiles[i].deferredIslands;
+		m_profile.maxSolveDebt = cb2Max(m_profile.maxSolveDebt, profiles[i].maxSolveDebt);
+		m_profile.jointsBroken += profiles[i].jointsBroken;
+	}
+
+	// Islands that fell asleep put their static bodies to sleep. A static body shared by
+	// several islands sleeps if any of them does, where the serial solver leaves it as the
+	// last of its islands left it.
+	for (int i = 0; i < islandCount; ++i)
+	{
+		const cb2IslandRange* range = ranges + i;
+		if (bodies[range->bodyIndex + range->staticCount]->IsAwake())
+		{
+			continue;
+		}
+
+		for (int j = 0; j < range->staticCount; ++j)
+		{
+			bodies[range->bodyIndex + j]->SetAwake(false);
+		}
+	}
+
+	// Report in island order so the listener sees the same sequence as the serial solver.
+	cb2ContactListener* listener = m_contactManager.m_contactListener;
+	if (listener)
+	{
+		for (int i = 0; i < islandContactCount; ++i)
+		{
+			if (impulses[i].count > 0)
+			{
+				listener->PostSolve(contacts[i], impulses + i);
+			}
+		}
+	}
+
+	m_stackAllocator->Free(impulses);
+	m_stackAllocator->Free(profiles);
+	m_stackAllocator->Free(ranges);
+	m_stackAllocator->Free(joints);
+	m_stackAllocator->Free(contacts);
+	m_stackAllocator->Free(bodies);
+}
+
+// Find TOI contacts and solve them.
+void cb2World::SolveTOI(const cb2TimeStep& step)
+{
+	cb2Timer budgetTimer;
+	cb2Island island(2 * m_maxTOIContacts, m_maxTOIContacts, 0, m_stackAllocator, m_contactManager.m_contactListener);
+
+	if (m_stepComplete)
+	{
+		int bodyIndex;
+		for (cb2Body* b = GetFirstAwakeBody(&bodyIndex); b; b = GetNextAwakeBody(b, &bodyIndex))
+		{
+			b->m_flags &= ~cb2Body::e_islandFlag;
+			b->m_sweep.alpha0 = 0.0f;
+		}
+
+		int contactIndex;
+		for (cb2Contact* c = m_contactManager.GetFirstAwakeContact(&contactIndex); c; c = m_contactManager.GetNextAwakeContact(c, &contactIndex))
+		{
+			// Invalidate TOI
+			c->m_flags &= ~(cb2Contact::e_toiFlag | cb2Contact::e_islandFlag);
+			c->m_toiCount = 0;
+			c->m_toi = 1.0f;
+		}
+	}
+
+	// Key the contacts by their position in the contact list, so queued events
+	// come out in the order a scan of the list would find them.
+	m_toiScheduler.Clear();
+	int minKey = 0;
+	int maxKey = 0;
+	{
+		int contactIndex;
+		for (cb2Contact* c = m_contactManager.GetFirstAwakeContact(&contactIndex); c; c = m_contactManager.GetNextAwakeContact(c, &contactIndex))
+		{
+			c->m_toiKey = maxKey;
+			++maxKey;
+			m_toiScheduler.AddCandidate(c);
+		}
+	}
+
+	// Compute the missing TOIs of all contacts up front.
+	m_toiScheduler.Update(m_threadPool);
+
+	// Find TOI events and solve them.
+	for (;;)
+	{
+		// Find the first TOI.
+		float minAlpha = 1.0f;
+		cb2Contact* minContact = m_toiScheduler.PopMin(&minAlpha);
+
+		if (minContact == NULL || 1.0f - 10.0f * cb2_epsilon < minAlpha)
+		{
+			// No more TOI events. Done!
+			m_stepComplete = true;
+			break;
+		}
+
+		// Is the budget of this step used up? Then the next step continues from here.
+		if ((m_toiEventBudget > 0 && m_profile.toiEventCount >= m_toiEventBudget) ||
+			(m_toiTimeBudget > 0.0f && m_deterministic == false && budgetTimer.GetMilliseconds() >= m_toiTimeBudget))
+		{
+			m_stepComplete = false;
+			m_profile.toiDeferred = true;
+			break;
+		}
+
+		++m_profile.toiEventCount;
+
+		// Advance the bodies to the TOI.
+		cb2Fixture* fA = minContact->GetFixtureA();
+		cb2Fixture* fB = minContact->GetFixtureB();
+		cb2Body* bA = fA->GetBody();
+		cb2Body* bB = fB->GetBody();
 
 		cb2Sweep backup1 = bA->m_sweep;
 		cb2Sweep backup2 = bB->m_sweep;
 
-		bA->Advance(minAlpha);
-		bB->Advance(minAlpha);
+		// Updating the contacts below may wake bodies.
+		m_toiScheduler.WatchNeighbors(bA);
+		m_toiScheduler.WatchNeighbors(bB);
+
+		bA->Advance(minAlpha);
+		bB->Advance(minAlpha);
+
+		// The TOI contact likely has some new contact points.
+		minContact->Update(m_contactManager.m_contactListener);
+		minContact->m_flags &= ~cb2Contact::e_toiFlag;
+		++minContact->m_toiCount;
+
+		// Is the contact solid?
+		if (minContact->IsEnabled() == false || minContact->IsTouching() == false)
+		{
+			// Restore the sweeps.
+			minContact->SetEnabled(false);
+			bA->m_sweep = backup1;
+			bB->m_sweep = backup2;
+			bA->SynchronizeTransform();
+			bB->SynchronizeTransform();
+
+			// The update may have woken the bodies.
+			m_toiScheduler.AddBodyContacts(bA);
+			m_toiScheduler.AddBodyContacts(bB);
+			m_toiScheduler.Update(m_threadPool);
+			continue;
+		}
+
+		bA->SetAwake(true);
+		bB->SetAwake(true);
+
+		// A static body keeps the alpha of this event. It joins the awake set so the
+		// next step resets it with the awake bodies.
+		if (m_awakeBodies)
+		{
+			if (bA->m_type == cb2_staticBody && bA->m_awakeIndex == -1)
+			{
+				AddAwakeBody(bA);
+			}
+
+			if (bB->m_type == cb2_staticBody && bB->m_awakeIndex == -1)
+			{
+				AddAwakeBody(bB);
+			}
+		}
+
+		// Build the island
+		island.Clear();
+		island.Add(bA);
+		island.Add(bB);
+		island.Add(minContact);
+
+		bA->m_flags |= cb2Body::e_islandFlag;
+		bB->m_flags |= cb2Body::e_islandFlag;
+		minContact->m_flags |= cb2Contact::e_islandFlag;
+
+		// Get contacts on bodyA and bodyB.
+		cb2Body* bodies[2] = {bA, bB};
+		for (int i = 0; i < 2; ++i)
+		{
+			cb2Body* body = bodies[i];
+			if (body->m_type == cb2_dynamicBody)
+			{
+				for (cb2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
+				{
+					if (island.m_bodyCount == island.m_bodyCapacity)
+					{
+						break;
+					}
+
+					if (island.m_contactCount == island.m_contactCapacity)
+					{
+						break;
+					}
+
+					cb2Contact* contact = ce->contact;
+
+					// Has this contact already been added to the island?
+					if (contact->m_flags & cb2Contact::e_islandFlag)
+					{
+						continue;
+					}
+
+					// Only add static, kinematic, or bullet bodies.
+					cb2Body* other = ce->other;
+					if (other->m_type == cb2_dynamicBody &&
+						body->IsBullet() == false && other->IsBullet() == false)
+					{
+						continue;
+					}
+
+					// Bodies out of continuous collision keep their motion.
+					if (other->m_flags & cb2Body::e_lodFlag)
+					{
+						continue;
+					}
+
+					// Skip sensors.
+					bool sensorA = contact->m_fixtureA->m_isSensor;
+					bool sensorB = contact->m_fixtureB->m_isSensor;
+					if (sensorA || sensorB)
+					{
+						continue;
+					}
+
+					// Tentatively advance the body to the TOI.
+					cb2Sweep backup = other->m_sweep;
+					if ((other->m_flags & cb2Body::e_islandFlag) == 0)
+					{
+						other->Advance(minAlpha);
+					}
+
+					// Update the contact points
+					contact->Update(m_contactManager.m_contactListener);
+
+					// Was the contact disabled by the user?
+					if (contact->IsEnabled() == false)
+					{
+						other->m_sweep = backup;
+						other->SynchronizeTransform();
+						continue;
+					}
+
+					// Are there contact points?
+					if (contact->IsTouching() == false)
+					{
+						other->m_sweep = backup;
+						other->SynchronizeTransform();
+						continue;
+					}
+
+					// Add the contact to the island
+					contact->m_flags |= cb2Contact::e_islandFlag;
+					island.Add(contact);
+
+					// Has the other body already been added to the island?
+					if (other->m_flags & cb2Body::e_islandFlag)
+					{
+						continue;
+					}
+					
+					// Add the other body to the island.
+					other->m_flags |= cb2Body::e_islandFlag;
+
+					if (other->m_type != cb2_staticBody)
+					{
+						other->SetAwake(true);
+					}
+
+					island.Add(other);
+				}
+			}
+		}
+
+		cb2TimeStep subStep;
+		subStep.dt = (1.0f - minAlpha) * step.dt;
+		subStep.inv_dt = 1.0f / subStep.dt;
+		subStep.dtRatio = 1.0f;
+		subStep.positionIterations = 20;
+		subStep.velocityIterations = step.velocityIterations;
+		subStep.warmStarting = false;
+		subStep.wideContactSolver = false;
+		subStep.speculativeContacts = false;
+		subStep.contactReduction = false;
+		subStep.earlySleep = false;
+		subStep.batchIntegration = false;
+		subStep.solverType = cb2_iterativeSolver;
+		subStep.subStepCount = 1;
+		subStep.impulseTolerance = 0.0f;
+		subStep.jointBatching = false;
+		subStep.spatialOrdering = false;
+		subStep.directJointSolver = false;
+		subStep.postSolveThreshold = step.postSolveThreshold;
+		{
+			cb2Timer timer;
+			island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
+			m_profile.toiSolve += timer.GetMilliseconds();
+		}
+
+		// Reset island flags and synchronize broad-phase proxies.
+		for (int i = 0; i < island.m_bodyCount; ++i)
+		{
+			cb2Body* body = island.m_bodies[i];
+			body->m_flags &= ~cb2Body::e_islandFlag;
+
+			if (body->m_type != cb2_dynamicBody)
+			{
+				continue;
+			}
+
+			body->SynchronizeFixtures();
+
+			// Invalidate all contact TOIs on this displaced body.
+			for (cb2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
+			{
+				ce->contact->m_flags &= ~(cb2Contact::e_toiFlag | cb2Contact::e_islandFlag);
+			}
+			m_toiScheduler.AddBodyContacts(body);
+		}
+
+		// Commit fixture proxy movements to the broad-phase so that new contacts are created.
+		// Also, some contacts can be destroyed.
+		int oldContactCount = m_contactManager.m_contactCount;
+		m_contactManager.FindNewContacts();
+
+		// New contacts are prepended to the list, or appended when it is contiguous.
+		int newContactCount = m_contactManager.m_contactCount - oldContactCount;
+		if (m_contactManager.IsContiguous())
+		{
+			for (int i = oldContactCount; i < m_contactManager.m_contactCount; ++i)
+			{
+				cb2Contact* c = m_contactManager.m_contactArray[i];
+				c->m_toiKey = maxKey;
+				++maxKey;
+				m_toiScheduler.AddCandidate(c);
+			}
+		}
+		else
+		{
+			minKey -= newContactCount;
+			cb2Contact* c = m_contactManager.m_contactList;
+			for (int i = 0; i < newContactCount; ++i)
+			{
+				c->m_toiKey = minKey + i;
+				m_toiScheduler.AddCandidate(c);
+				c = c->GetNext();
+			}
+		}
+
+		// Only the contacts of the bodies this event moved or woke can have changed.
+		m_toiScheduler.AddCandidate(minContact);
+		m_toiScheduler.AddBodyContacts(bA);
+		m_toiScheduler.AddBodyContacts(bB);
+		m_toiScheduler.Update(m_threadPool);
+
+		if (m_subStepping)
+		{
+			m_stepComplete = false;
+			break;
+		}
+	}
+
+	m_toiScheduler.AddProfile(&m_profile);
+}
+
+void cb2World::StepAsync(float dt, int velocityIterations, int positionIterations)
+{
+	WaitStep();
+
+	if (m_stepThread == NULL)
+	{
+		void* mem = cb2Alloc(sizeof(cb2StepThread));
+		m_stepThread = new (mem) cb2StepThread(this);
+	}
+
+	// The commands are made here so the queue is free for the caller during the step.
+	ApplyCommands();
+
+	m_asyncStep = true;
+	m_stepThread->Start(dt, velocityIterations, positionIterations);
+}
+
+bool cb2World::IsStepDone() const
+{
+	return m_stepThread == NULL || m_stepThread->IsDone();
+}
+
+void cb2World::WaitStep()
+{
+	if (m_asyncStep == false)
+	{
+		return;
+	}
+
+	m_stepThread->Wait();
+	m_asyncStep = false;
+	m_frontBodyStates = 1 - m_frontBodyStates;
+}
+
+void cb2World::QueueCommand(const cb2BodyCommand& command)
+{
+	cb2Assert(command.body != NULL);
+	if (m_commandCount == m_commandCapacity)
+	{
+		cb2BodyCommand* oldCommands = m_commands;
+		m_commandCapacity = cb2Max(2 * m_commandCapacity, 64);
+		m_commands = (cb2BodyCommand*)cb2Alloc(m_commandCapacity * sizeof(cb2BodyCommand));
+		if (oldCommands)
+		{
+			memcpy(m_commands, oldCommands, m_commandCount * sizeof(cb2BodyCommand));
+			cb2Free(oldCommands);
+		}
+	}
+
+	m_commands[m_commandCount++] = command;
+}
+
+void cb2World::SubmitCommands(cb2CommandBuffer* buffer)
+{
+	cb2Assert(buffer != NULL);
+	if (m_commandBufferCount == m_commandBufferCapacity)
+	{
+		cb2CommandBuffer** oldBuffers = m_commandBuffers;
+		m_commandBufferCapacity = cb2Max(2 * m_commandBufferCapacity, 4);
+		m_commandBuffers = (cb2CommandBuffer**)cb2Alloc(m_commandBufferCapacity * sizeof(cb2CommandBuffer*));
+		if (oldBuffers)
+		{
+			memcpy(m_commandBuffers, oldBuffers, m_commandBufferCount * sizeof(cb2CommandBuffer*));
+			cb2Free(oldBuffers);
+		}
+	}
+
+	m_commandBuffers[m_commandBufferCount++] = buffer;
+}
+
+void cb2World::ApplyCommands()
+{
+	for (int i = 0; i < m_commandCount; ++i)
+	{
+		const cb2BodyCommand& command = m_commands[i];
+		cb2Body* b = command.body;
+		switch (command.type)
+		{
+		case cb2_applyForceCommand:
+			b->ApplyForce(command.vector, command.point, command.wake);
+			break;
+
+		case cb2_applyForceToCenterCommand:
+			b->ApplyForceToCenter(command.vector, command.wake);
+			break;
+
+		case cb2_applyTorqueCommand:
+			b->ApplyTorque(command.value, command.wake);
+			break;
+
+		case cb2_applyLinearImpulseCommand:
+			b->ApplyLinearImpulse(command.vector, command.point, command.wake);
+			break;
+
+		case cb2_applyAngularImpulseCommand:
+			b->ApplyAngularImpulse(command.value, command.wake);
+			break;
+
+		case cb2_setLinearVelocityCommand:
+			b->SetLinearVelocity(command.vector);
+			break;
+
+		case cb2_setAngularVelocityCommand:
+			b->SetAngularVelocity(command.value);
+			break;
+
+		case cb2_setTransformCommand:
+			b->SetTransform(command.point, command.value);
+			break;
+
+		case cb2_setAwakeCommand:
+			b->SetAwake(command.wake);
+			break;
+
+		case cb2_destroyBodyCommand:
+			DestroyBody(b);
+			break;
+
+		default:
+			cb2Assert(false);
+			break;
+		}
+	}
+
+	m_commandCount = 0;
+
+	for (int i = 0; i < m_commandBufferCount; ++i)
+	{
+		m_commandBuffers[i]->Apply(this);
+	}
+
+	m_commandBufferCount = 0;
+}
+
+// Called by the step thread after each step, while the caller reads the front buffer.
+void cb2World::CaptureBodyStates()
+{
+	int back = 1 - m_frontBodyStates;
+	if (m_bodyStateCapacity[back] < m_bodyIdCount)
+	{
+		cb2Free(m_bodyStates[back]);
+		m_bodyStateCapacity[back] = cb2Max(2 * m_bodyStateCapacity[back], m_bodyIdCount);
+		m_bodyStates[back] = (cb2BodyState*)cb2Alloc(m_bodyStateCapacity[back] * sizeof(cb2BodyState));
+	}
+
+	cb2BodyState* states = m_bodyStates[back];
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		cb2BodyState* state = states + b->m_id;
+		state->transform = b->m_xf;
+		state->linearVelocity = b->m_linearVelocity;
+		state->angularVelocity = b->m_angularVelocity;
+		state->awake = b->IsAwake();
+	}
+	m_bodyStateCount[back] = m_bodyIdCount;
+}
+
+void cb2World::Step(float dt, int velocityIterations, int positionIterations)
+{
+	// The commands of an asynchronous step were made by StepAsync.
+	if (m_asyncStep == false)
+	{
+		ApplyCommands();
+	}
+
+	if (m_originCellSize > 0.0f)
+	{
+		FollowOriginFocus();
+	}
+
+	cb2ProfileZone stepZone(m_profiler, "Step", m_bodyCount);
+	cb2Timer stepTimer;
+	m_contactManager.m_createdCount = 0;
+	m_contactManager.m_destroyedCount = 0;
+	m_contactManager.m_broadPhase.ResetQueryCount();
+
+	if (m_transforms)
+	{
+		BeginTransformExport();
+	}
+
+	if (m_contactEvents)
+	{
+		m_contactEvents->Clear();
+	}
+
+	// Bodies still inside a fixture edit get their mass before they move.
+	if (m_flags & e_massDirty)
+	{
+		for (cb2Body* b = m_bodyList; b; b = b->m_next)
+		{
+			if (b->m_flags & cb2Body::e_massDirtyFlag)
+			{
+				b->ResetMassData();
+			}
+		}
+		m_flags &= ~e_massDirty;
+	}
+
+	// If new fixtures were added, we need to find the new contacts.
+	if (m_flags & e_newFixture)
+	{
+		m_contactManager.FindNewContacts();
+		m_flags &= ~e_newFixture;
+	}
+
+	if (m_materials && m_materials->HasChanges())
+	{
+		UpdateMaterials();
+	}
+
+	m_flags |= e_locked;
+
+	cb2TimeStep step;
+	step.dt = dt;
+	step.velocityIterations	= velocityIterations;
+	step.positionIterations = positionIterations;
+	if (dt > 0.0f)
+	{
+		step.inv_dt = 1.0f / dt;
+	}
+	else
+	{
+		step.inv_dt = 0.0f;
+	}
+
+	step.dtRatio = m_inv_dt0 * dt;
+
+	step.warmStarting = m_warmStarting;
+	step.wideContactSolver = m_wideContactSolver;
+	step.speculativeContacts = m_speculativeContacts;
+	step.contactReduction = m_contactReduction;
+	step.earlySleep = m_earlySleep;
+	step.batchIntegration = m_batchIntegration;
+	step.solverType = m_solverType;
+	step.subStepCount = m_subStepCount;
+	step.impulseTolerance = m_impulseTolerance;
+	step.jointBatching = m_jointBatching;
+	step.spatialOrdering = m_spatialOrdering;
+	step.directJointSolver = m_directJointSolver;
+	step.postSolveThreshold = m_postSolveThreshold;
+	m_contactManager.m_speculativeTime = m_speculativeContacts ? dt : 0.0f;
+	
+	// Update contacts. This is where some contacts are destroyed.
+	{
+		cb2ProfileZone zone(m_profiler, "Collide", m_contactManager.m_contactCount);
+		cb2Timer timer;
+		m_contactManager.Collide();
+		m_profile.collide = timer.GetMilliseconds();
+	}
+
+	// Integrate velocities, solve velocity constraints, and integrate positions.
+	if (m_stepComplete && step.dt > 0.0f)
+	{
+		cb2ProfileZone zone(m_profiler, "Solve");
+		cb2Timer timer;
+		Solve(step);
+		m_profile.solve = timer.GetMilliseconds();
+	}
+
+	m_profile.toiCompute = 0.0f;
+	m_profile.toiSolve = 0.0f;
+	m_profile.toiEventCount = 0;
+	m_profile.toiCallCount = 0;
+	m_profile.toiIterations = 0;
+	m_profile.toiRootIterations = 0;
+	m_profile.toiDeferred = false;
+
+	// Handle TOI events.
+	if (m_continuousPhysics && step.dt > 0.0f)
+	{
+		cb2ProfileZone zone(m_profiler, "SolveTOI");
+		cb2Timer timer;
+		SolveTOI(step);
+		m_profile.solveTOI = timer.GetMilliseconds();
+	}
+
+	if (step.dt > 0.0f)
+	{
+		m_inv_dt0 = step.inv_dt;
+	}
+
+	// The particles collide with the bodies at the end of the step and push them with
+	// impulses, which act in the next step.
+	m_profile.particles = 0.0f;
+	if (m_particleSystemList && step.dt > 0.0f)
+	{
+		cb2ProfileZone zone(m_profiler, "Particles");
+		cb2Timer timer;
+		for (cb2ParticleSystem* ps = m_particleSystemList; ps; ps = ps->m_next)
+		{
+			ps->Step(step.dt, m_gravity, m_threadPool);
+		}
+		m_profile.particles = timer.GetMilliseconds();
+	}
+
+	if (m_flags & e_clearForces)
+	{
+		ClearForces();
+	}
+
+	// Sensors see where the step left the bodies.
+	if (m_sensorManager)
+	{
+		cb2ProfileZone zone(m_profiler, "Sensors", m_sensorManager->GetSensorCount());
+		m_sensorManager->Update(&m_contactManager.m_broadPhase, m_contactManager.m_contactFilter,
+								m_contactManager.m_contactListener, m_contactEvents, m_threadPool);
+	}
+
+	if (m_contactEvents)
+	{
+		m_contactEvents->FinishHits();
+	}
+
+	if (m_transforms)
+	{
+		EndTransformExport();
+	}
+
+	m_flags &= ~e_locked;
+
+	if (m_profile.jointsBroken > 0)
+	{
+		DestroyBrokenJoints();
+	}
+
+	++m_stepCount;
+	if (m_querySnapshots[0])
+	{
+		PublishQuerySnapshot();
+	}
+
+	// The thread allocators only exist with a thread pool.
+	m_profile.maxStackAllocation = m_stackAllocator->GetMaxAllocation();
+	int threadCount = m_threadPool ? m_threadPool->GetThreadCount() : 0;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		m_profile.maxStackAllocation = cb2Max(m_profile.maxStackAllocation, m_threadAllocators[i].GetMaxAllocation());
+	}
+
+	m_profile.contactsCreated = m_contactManager.m_createdCount;
+	m_profile.contactsDestroyed = m_contactManager.m_destroyedCount;
+	m_profile.treeQueries = m_contactManager.m_broadPhase.GetQueryCount();
+	m_profile.step = stepTimer.GetMilliseconds();
+	m_profileStats.Add(m_profile);
+
+	if (m_profiler)
+	{
+		m_profiler->ReportCounter("islands", m_profile.islandCount);
+		m_profiler->ReportCounter("island contacts", m_profile.islandContactCount);
+		m_profiler->ReportCounter("contacts created", m_profile.contactsCreated);
+		m_profiler->ReportCounter("contacts destroyed", m_profile.contactsDestroyed);
+		m_profiler->ReportCounter("tree queries", m_profile.treeQueries);
+		m_profiler->ReportCounter("toi events", m_profile.toiEventCount);
+	}
+}
+
+void cb2World::SetFixedStep(float timeStep, int velocityIterations, int positionIterations, int maxSteps)
+{
+	cb2Assert(timeStep > 0.0f && maxSteps > 0);
+	m_fixedTimeStep = timeStep;
+	m_fixedVelocityIterations = velocityIterations;
+	m_fixedPositionIterations = positionIterations;
+	m_maxFixedSteps = maxSteps;
+	m_accumulator = cb2Min(m_accumulator, timeStep);
+}
+
+int cb2World::Advance(float elapsed)
+{
+	cb2Assert(IsLocked() == false && m_asyncStep == false);
+	if (IsLocked() || m_asyncStep)
+	{
+		return 0;
+	}
+
+	m_accumulator += cb2Max(elapsed, 0.0f);
+
+	// Every step has the same length, so the time step ratio stays one and warm
+	// starting carries the impulses over unscaled.
+	int stepCount = 0;
+	bool clearForces = (m_flags & e_clearForces) == e_clearForces;
+	m_flags &= ~e_clearForces;
+	while (m_accumulator >= m_fixedTimeStep && stepCount < m_maxFixedSteps)
+	{
+		// The bodies that move keep their transform before the step; the others
+		// did not move, see cb2Body::GetPreviousTransform.
+		int bodyIndex;
+		for (cb2Body* b = GetFirstAwakeBody(&bodyIndex); b; b = GetNextAwakeBody(b, &bodyIndex))
+		{
+			b->m_xf0 = b->m_xf;
+			b->m_xf0Step = m_stepCount;
+		}
+
+		Step(m_fixedTimeStep, m_fixedVelocityIterations, m_fixedPositionIterations);
+		m_accumulator -= m_fixedTimeStep;
+		++stepCount;
+	}
+
+	if (clearForces)
+	{
+		m_flags |= e_clearForces;
+		ClearForces();
+	}
+
+	// Drop the time that did not fit, alpha stays in [0,1).
+	if (m_accumulator >= m_fixedTimeStep)
+	{
+		m_accumulator = 0.0f;
+	}
+
+	return stepCount;
+}
+
+void cb2World::ClearForces()
+{
+	// Sleeping bodies have no force.
+	int bodyIndex;
+	for (cb2Body* body = GetFirstAwakeBody(&bodyIndex); body; body = GetNextAwakeBody(body, &bodyIndex))
+	{
+		cb2::setZero(body->m_force);
+		body->m_torque = 0.0f;
+	}
+}
+
+struct cb2WorldQueryWrapper
+{
+	bool QueryCallback(int proxyId)
+	{
+		cb2FixtureProxy* proxy = (cb2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		return callback->ReportFixture(proxy->fixture);
+	}
+
+	const cb2BroadPhase* broadPhase;
+	cb2QueryCallback* callback;
+};
+
+void cb2World::QueryAABB(cb2QueryCallback* callback, const cb2AABB& aabb) const
+{
+	cb2WorldQueryWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.callback = callback;
+	m_contactManager.m_broadPhase.Query(&wrapper, aabb);
+}
+
+struct cb2WorldBatchQueryWrapper
+{
+	bool QueryCallback(int queryIndex, int proxyId)
+	{
+		if (hitCount == maxHits)
+		{
+			return false;
+		}
+
+		cb2FixtureProxy* proxy = (cb2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		hits[hitCount].queryIndex = queryIndex;
+		hits[hitCount].fixture = proxy->fixture;
+		hits[hitCount].childIndex = proxy->childIndex;
+		++hitCount;
+		return true;
+	}
+
+	const cb2BroadPhase* broadPhase;
+	cb2QueryHit* hits;
+	int hitCount;
+	int maxHits;
+};
+
+/// A query box keyed by the Morton code of its center.
+struct cb2QueryKey
+{
+	unsigned int key;
+	int index;
+};
+
+inline bool cb2QueryKeyLessThan(const cb2QueryKey& key1, const cb2QueryKey& key2)
+{
+	if (key1.key != key2.key)
+	{
+		return key1.key < key2.key;
+	}
+
+	return key1.index < key2.index;
+}
+
+// Order points along a Morton curve so that nearby points are next to each other.
+static void cb2ComputeLocalityOrder(const ci::Vec2f* points, int count, int* order)
+{
+	cb2AABB bounds;
+	bounds.lowerBound = points[0];
+	bounds.upperBound = points[0];
+	for (int i = 1; i < count; ++i)
+	{
+		bounds.lowerBound = cb2Min(bounds.lowerBound, points[i]);
+		bounds.upperBound = cb2Max(bounds.upperBound, points[i]);
+	}
+
+	ci::Vec2f extent = bounds.upperBound - bounds.lowerBound;
+	float scaleX = extent.x > 0.0f ? 65535.0f / extent.x : 0.0f;
+	float scaleY = extent.y > 0.0f ? 65535.0f / extent.y : 0.0f;
+
+	cb2QueryKey* keys = (cb2QueryKey*)cb2Alloc(count * sizeof(cb2QueryKey));
+	for (int i = 0; i < count; ++i)
+	{
+		ci::Vec2f p = points[i] - bounds.lowerBound;
+		unsigned int x = (unsigned int)(scaleX * p.x);
+		unsigned int y = (unsigned int)(scaleY * p.y);
+		keys[i].key = cb2SpreadBits(x) | (cb2SpreadBits(y) << 1);
+		keys[i].index = i;
+	}
+
+	std::sort(keys, keys + count, cb2QueryKeyLessThan);
+	for (int i = 0; i < count; ++i)
+	{
+		order[i] = keys[i].index;
+	}
+
+	cb2Free(keys);
+}
+
+int cb2World::QueryAABBs(const cb2AABB* aabbs, int count, cb2QueryHit* hits, int maxHits) const
+{
+	if (count <= 0 || maxHits <= 0)
+	{
+		return 0;
+	}
+
+	// Sort the queries by the location of their centers.
+	ci::Vec2f* centers = (ci::Vec2f*)cb2Alloc(count * (sizeof(ci::Vec2f) + sizeof(int)));
+	int* order = (int*)(centers + count);
+	for (int i = 0; i < count; ++i)
+	{
+		centers[i] = aabbs[i].GetCenter();
+	}
+	cb2ComputeLocalityOrder(centers, count, order);
+
+	cb2WorldBatchQueryWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.hits = hits;
+	wrapper.hitCount = 0;
+	wrapper.maxHits = maxHits;
+	m_contactManager.m_broadPhase.QueryBatch(&wrapper, aabbs, order, count);
+
+	cb2Free(centers);
+	return wrapper.hitCount;
+}
+
+struct cb2WorldRayCastWrapper
+{
+	float RayCastCallback(const cb2RayCastInput& input, int proxyId)
+	{
+		void* userData = broadPhase->GetUserData(proxyId);
+		cb2FixtureProxy* proxy = (cb2FixtureProxy*)userData;
+		cb2Fixture* fixture = proxy->fixture;
+		int index = proxy->childIndex;
+		cb2RayCastOutput output;
+		bool hit = fixture->RayCast(&output, input, index);
+
+		if (hit)
+		{
+			float fraction = output.fraction;
+			ci::Vec2f point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+			return callback->ReportFixture(fixture, point, output.normal, fraction);
+		}
+
+		return input.maxFraction;
+	}
+
+	const cb2BroadPhase* broadPhase;
+	cb2RayCastCallback* callback;
+};
+
+void cb2World::RayCast(cb2RayCastCallback* callback, const ci::Vec2f& point1, const ci::Vec2f& point2) const
+{
+	cb2WorldRayCastWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.callback = callback;
+	cb2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
+}
+
+struct cb2WorldBatchRayCastWrapper
+{
+	float RayCastCallback(int rayIndex, const cb2RayCastInput& input, int proxyId)
+	{
+		cb2FixtureProxy* proxy = (cb2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		cb2Fixture* fixture = proxy->fixture;
+		cb2RayCastOutput output;
+		bool hit = fixture->RayCast(&output, input, proxy->childIndex);
+
+		if (hit == false)
+		{
+			return input.maxFraction;
+		}
+
+		cb2RayCastHit result;
+		result.rayIndex = rayIndex;
+		result.fixture = fixture;
+		result.point = (1.0f - output.fraction) * input.p1 + output.fraction * input.p2;
+		result.normal = output.normal;
+		result.fraction = output.fraction;
+
+		switch (mode)
+		{
+		case cb2_rayCastClosest:
+			closest[rayIndex] = result;
+			if (childIndices)
+			{
+				childIndices[rayIndex] = proxy->childIndex;
+			}
+			return output.fraction;
+
+		case cb2_rayCastAny:
+			closest[rayIndex] = result;
+			return 0.0f;
+
+		default:
+			if (hitCount == maxHits)
+			{
+				return 0.0f;
+			}
+			hits[hitCount++] = result;
+			return input.maxFraction;
+		}
+	}
+
+	const cb2BroadPhase* broadPhase;
+	cb2RayCastMode mode;
+	cb2RayCastHit* closest;
+	cb2RayCastHit* hits;
+	int* childIndices;
+	int hitCount;
+	int maxHits;
+};
+
+int cb2World::RayCastBatch(const cb2RayCastInput* rays, int count, cb2RayCastMode mode, cb2RayCastHit* hits, int maxHits) const
+{
+	if (count <= 0 || maxHits <= 0)
+	{
+		return 0;
+	}
+
+	// Sort the rays by the location of their midpoints so packets are coherent.
+	ci::Vec2f* centers = (ci::Vec2f*)cb2Alloc(count * (sizeof(ci::Vec2f) + sizeof(int)));
+	int* order = (int*)(centers + count);
+	for (int i = 0; i < count; ++i)
+	{
+		centers[i] = rays[i].p1 + (0.5f * rays[i].maxFraction) * (rays[i].p2 - rays[i].p1);
+	}
+	cb2ComputeLocalityOrder(centers, count, order);
+
+	cb2WorldBatchRayCastWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.mode = mode;
+	wrapper.closest = NULL;
+	wrapper.hits = hits;
+	wrapper.childIndices = NULL;
+	wrapper.hitCount = 0;
+	wrapper.maxHits = maxHits;
+
+	if (mode == cb2_rayCastAll)
+	{
+		m_contactManager.m_broadPhase.RayCastBatch(&wrapper, rays, order, count);
+		cb2Free(centers);
+		return wrapper.hitCount;
+	}
+
+	// Keep the best hit of each ray, then write them in ray order.
+	wrapper.closest = (cb2RayCastHit*)cb2Alloc(count * sizeof(cb2RayCastHit));
+	for (int i = 0; i < count; ++i)
+	{
+		wrapper.closest[i].fixture = NULL;
+	}
+
+	m_contactManager.m_broadPhase.RayCastBatch(&wrapper, rays, order, count);
+
+	int hitCount = 0;
+	for (int i = 0; i < count && hitCount < maxHits; ++i)
+	{
+		if (wrapper.closest[i].fixture)
+		{
+			hits[hitCount++] = wrapper.closest[i];
+		}
+	}
+
+	cb2Free(wrapper.closest);
+	cb2Free(centers);
+	return hitCount;
+}
+
+int cb2World::CreateRayQuery()
+{
+	if (m_rayQueries == NULL)
+	{
+		void* mem = cb2Alloc(sizeof(cb2RayQueries));
+		m_rayQueries = new (mem) cb2RayQueries;
+	}
+	return m_rayQueries->Create();
+}
+
+void cb2World::DestroyRayQuery(int query)
+{
+	m_rayQueries->Destroy(query);
+}
+
+int cb2World::GetRayQueryCount() const
+{
+	return m_rayQueries ? m_rayQueries->GetCount() : 0;
+}
+
+int cb2World::CastRayQueries(const int* queries, const cb2RayCastInput* rays, int count, cb2RayCastHit* hits)
+{
+	cb2Assert(IsLocked() == false);
+	if (IsLocked() || count <= 0)
+	{
+		return 0;
+	}
+
+	// Clip each ray to the fixture it hit last time and sort the rays for the packets.
+	cb2RayCastInput* clipped = (cb2RayCastInput*)cb2Alloc(count * (sizeof(cb2RayCastInput) + sizeof(ci::Vec2f) + sizeof(int)));
+	ci::Vec2f* centers = (ci::Vec2f*)(clipped + count);
+	int* order = (int*)(centers + count);
+	for (int i = 0; i < count; ++i)
+	{
+		const cb2RayCastInput& input = rays[i];
+		clipped[i] = input;
+		hits[i].rayIndex = i;
+		hits[i].fixture = NULL;
+
+		const cb2RayQuery& query = m_rayQueries->GetQuery(queries[i]);
+		cb2Fixture* fixture = query.fixture;
+		cb2RayCastOutput output;
+		if (fixture && fixture->m_proxyCount > 0 && fixture->RayCast(&output, input, query.childIndex))
+		{
+			hits[i].fixture = fixture;
+			hits[i].point = (1.0f - output.fraction) * input.p1 + output.fraction * input.p2;
+			hits[i].normal = output.normal;
+			hits[i].fraction = output.fraction;
+			clipped[i].maxFraction = output.fraction;
+		}
+
+		centers[i] = input.p1 + (0.5f * clipped[i].maxFraction) * (input.p2 - input.p1);
+	}
+	cb2ComputeLocalityOrder(centers, count, order);
+
+	cb2WorldBatchRayCastWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.mode = cb2_rayCastClosest;
+	wrapper.closest = hits;
+	wrapper.hits = NULL;
+	wrapper.hitCount = 0;
+	wrapper.maxHits = 0;
+	wrapper.childIndices = (int*)cb2Alloc(count * sizeof(int));
+	for (int i = 0; i < count; ++i)
+	{
+		wrapper.childIndices[i] = m_rayQueries->GetQuery(queries[i]).childIndex;
+	}
+	m_contactManager.m_broadPhase.RayCastBatch(&wrapper, clipped, order, count);
+
+	// Remember the closest hits for the next cast.
+	int hitCount = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		cb2RayQuery& query = m_rayQueries->GetQuery(queries[i]);
+		query.fixture = hits[i].fixture;
+		query.childIndex = wrapper.childIndices[i];
+		hitCount += hits[i].fixture != NULL;
+	}
+
+	cb2Free(wrapper.childIndices);
+	cb2Free(clipped);
+	return hitCount;
+}
+
+struct cb2WorldShapeCastWrapper;
+
+struct cb2WorldShapeCastChildWrapper
+{
+	bool QueryCallback(int childIndex);
+
+	cb2WorldShapeCastWrapper* wrapper;
+	cb2Fixture* fixture;
+	int castIndex;
+	bool proceed;
+};
+
+struct cb2WorldShapeCastWrapper
+{
+	bool QueryCallback(int castIndex, int proxyId)
+	{
+		cb2FixtureProxy* proxy = (cb2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		if (proxy->childIndex != cb2ChainShape::e_allChildren)
+		{
+			return CastChild(castIndex, proxy->fixture, proxy->childIndex);
+		}
+
+		// Cast against the chain children inside the swept box.
+		cb2WorldShapeCastChildWrapper childWrapper;
+		childWrapper.wrapper = this;
+		childWrapper.fixture = proxy->fixture;
+		childWrapper.castIndex = castIndex;
+		childWrapper.proceed = true;
+
+		cb2QueryChildren(proxy->fixture->GetShape(), &childWrapper, aabbs[castIndex], proxy->fixture->GetBody()->GetTransform());
+		return childWrapper.proceed;
+	}
+
+	bool CastChild(int castIndex, cb2Fixture* fixture, int childIndex)
+	{
+		cb2ShapeCastHit* best = closest ? closest + castIndex : NULL;
+		if (mode == cb2_rayCastAny && best->fixture)
+		{
+			return true;
+		}
+
+		if (mode == cb2_rayCastAll && hitCount == maxHits)
+		{
+			return false;
+		}
+
+		const cb2ShapeCastInput* cast = casts + castIndex;
+
+		cb2ShapeCastPairInput input;
+		input.proxyA.set(fixture->GetShape(), childIndex);
+		input.proxyB = proxies[castIndex];
+		input.transformA = fixture->GetBody()->GetTransform();
+		input.transformB = cast->transform;
+		input.translationB = cast->translation;
+		input.maxFraction = best && best->fixture ? best->fraction : cast->maxFraction;
+
+		cb2SimplexCache cache;
+		cache.count = 0;
+		cb2ShapeCastOutput output;
+		if (cb2ShapeCast(&output, &input, &cache) == false)
+		{
+			return true;
+		}
 
-		// The TOI contact likely has some new contact points.
-		minContact->Update(m_contactManager.m_contactListener);
-		minContact->m_flags &= ~cb2Contact::e_toiFlag;
-		++minContact->m_toiCount;
+		cb2ShapeCastHit result;
+		result.castIndex = castIndex;
+		result.fixture = fixture;
+		result.point = output.point;
+		result.normal = output.normal;
+		result.fraction = output.fraction;
 
-		// Is the contact solid?
-		if (minContact->IsEnabled() == false || minContact->IsTouching() == false)
+		if (best)
 		{
-			// Restore the sweeps.
-			minContact->SetEnabled(false);
-			bA->m_sweep = backup1;
-			bB->m_sweep = backup2;
-			bA->SynchronizeTransform();
-			bB->SynchronizeTransform();
-			continue;
+			*best = result;
+		}
+		else
+		{
+			hits[hitCount++] = result;
 		}
+		return true;
+	}
 
-		bA->SetAwake(true);
-		bB->SetAwake(true);
+	const cb2BroadPhase* broadPhase;
+	const cb2ShapeCastInput* casts;
+	const cb2AABB* aabbs;
+	const cb2DistanceProxy* proxies;
+	cb2RayCastMode mode;
+	cb2ShapeCastHit* closest;
+	cb2ShapeCastHit* hits;
+	int hitCount;
+	int maxHits;
+};
 
-		// Build the island
-		island.Clear();
-		island.Add(bA);
-		island.Add(bB);
-		island.Add(minContact);
+inline bool cb2WorldShapeCastChildWrapper::QueryCallback(int childIndex)
+{
+	proceed = wrapper->CastChild(castIndex, fixture, childIndex);
+	return proceed;
+}
 
-		bA->m_flags |= cb2Body::e_islandFlag;
-		bB->m_flags |= cb2Body::e_islandFlag;
-		minContact->m_flags |= cb2Contact::e_islandFlag;
+int cb2World::ShapeCastBatch(const cb2ShapeCastInput* casts, int count, cb2RayCastMode mode, cb2ShapeCastHit* hits, int maxHits) const
+{
+	if (count <= 0 || maxHits <= 0)
+	{
+		return 0;
+	}
 
-		// Get contacts on bodyA and bodyB.
-		cb2Body* bodies[2] = {bA, bB};
-		for (int i = 0; i < 2; ++i)
+	// Swept boxes and distance proxies of the casts, sorted by location like QueryAABBs.
+	int size = count * (sizeof(cb2AABB) + sizeof(cb2DistanceProxy) + sizeof(ci::Vec2f) + sizeof(int));
+	cb2AABB* aabbs = (cb2AABB*)cb2Alloc(size);
+	cb2DistanceProxy* proxies = (cb2DistanceProxy*)(aabbs + count);
+	ci::Vec2f* centers = (ci::Vec2f*)(proxies + count);
+	int* order = (int*)(centers + count);
+	for (int i = 0; i < count; ++i)
+	{
+		const cb2ShapeCastInput* cast = casts + i;
+		cb2AABB aabb1, aabb2;
+		cast->shape->ComputeAABB(&aabb1, cast->transform, cast->childIndex);
+		ci::Vec2f d = cast->maxFraction * cast->translation;
+		aabb2.lowerBound = aabb1.lowerBound + d;
+		aabb2.upperBound = aabb1.upperBound + d;
+		aabbs[i].Combine(aabb1, aabb2);
+		centers[i] = aabbs[i].GetCenter();
+
+		new (proxies + i) cb2DistanceProxy();
+		proxies[i].set(cast->shape, cast->childIndex);
+	}
+	cb2ComputeLocalityOrder(centers, count, order);
+
+	cb2WorldShapeCastWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.casts = casts;
+	wrapper.aabbs = aabbs;
+	wrapper.proxies = proxies;
+	wrapper.mode = mode;
+	wrapper.closest = NULL;
+	wrapper.hits = hits;
+	wrapper.hitCount = 0;
+	wrapper.maxHits = maxHits;
+
+	if (mode == cb2_rayCastAll)
+	{
+		m_contactManager.m_broadPhase.QueryBatch(&wrapper, aabbs, order, count);
+		cb2Free(aabbs);
+		return wrapper.hitCount;
+	}
+
+	// Keep the best hit of each cast, then write them in cast order.
+	wrapper.closest = (cb2ShapeCastHit*)cb2Alloc(count * sizeof(cb2ShapeCastHit));
+	for (int i = 0; i < count; ++i)
+	{
+		wrapper.closest[i].fixture = NULL;
+	}
+
+	m_contactManager.m_broadPhase.QueryBatch(&wrapper, aabbs, order, count);
+
+	int hitCount = 0;
+	for (int i = 0; i < count && hitCount < maxHits; ++i)
+	{
+		if (wrapper.closest[i].fixture)
 		{
-			cb2Body* body = bodies[i];
-			if (body->m_type == cb2_dynamicBody)
+			hits[hitCount++] = wrapper.closest[i];
+		}
+	}
+
+	cb2Free(wrapper.closest);
+	cb2Free(aabbs);
+	return hitCount;
+}
+
+struct cb2WorldOverlapWrapper;
+
+struct cb2WorldOverlapChildWrapper
+{
+	bool QueryCallback(int childIndex);
+
+	cb2WorldOverlapWrapper* wrapper;
+	cb2Fixture* fixture;
+	int shapeIndex;
+	bool proceed;
+};
+
+struct cb2WorldOverlapWrapper
+{
+	bool QueryCallback(int shapeIndex, int proxyId)
+	{
+		cb2FixtureProxy* proxy = (cb2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		if (proxy->childIndex != cb2ChainShape::e_allChildren)
+		{
+			return TestChild(shapeIndex, proxy->fixture, proxy->childIndex);
+		}
+
+		// Test the chain children inside the shape box.
+		cb2WorldOverlapChildWrapper childWrapper;
+		childWrapper.wrapper = this;
+		childWrapper.fixture = proxy->fixture;
+		childWrapper.shapeIndex = shapeIndex;
+		childWrapper.proceed = true;
+
+		cb2QueryChildren(proxy->fixture->GetShape(), &childWrapper, aabbs[shapeIndex], proxy->fixture->GetBody()->GetTransform());
+		return childWrapper.proceed;
+	}
+
+	bool TestChild(int shapeIndex, cb2Fixture* fixture, int childIndex)
+	{
+		const cb2ShapeOverlapInput* shape = shapes + shapeIndex;
+		if (cb2TestOverlap(shape->shape, proxies[shapeIndex], shape->transform,
+			fixture->GetShape(), childIndex, fixture->GetBody()->GetTransform()) == false)
+		{
+			return true;
+		}
+
+		if (hitCount == maxHits)
+		{
+			return false;
+		}
+
+		hits[hitCount].queryIndex = shapeIndex;
+		hits[hitCount].fixture = fixture;
+		hits[hitCount].childIndex = childIndex;
+		++hitCount;
+		return true;
+	}
+
+	const cb2BroadPhase* broadPhase;
+	const cb2ShapeOverlapInput* shapes;
+	const cb2AABB* aabbs;
+	const cb2DistanceProxy* proxies;
+	cb2QueryHit* hits;
+	int hitCount;
+	int maxHits;
+};
+
+inline bool cb2WorldOverlapChildWrapper::QueryCallback(int childIndex)
+{
+	proceed = wrapper->TestChild(shapeIndex, fixture, childIndex);
+	return proceed;
+}
+
+int cb2World::OverlapShapes(const cb2ShapeOverlapInput* shapes, int count, cb2QueryHit* hits, int maxHits) const
+{
+	if (count <= 0 || maxHits <= 0)
+	{
+		return 0;
+	}
+
+	// Boxes and distance proxies of the shapes, sorted by location like QueryAABBs.
+	int size = count * (sizeof(cb2AABB) + sizeof(cb2DistanceProxy) + sizeof(ci::Vec2f) + sizeof(int));
+	cb2AABB* aabbs = (cb2AABB*)cb2Alloc(size);
+	cb2DistanceProxy* proxies = (cb2DistanceProxy*)(aabbs + count);
+	ci::Vec2f* centers = (ci::Vec2f*)(proxies + count);
+	int* order = (int*)(centers + count);
+	for (int i = 0; i < count; ++i)
+	{
+		const cb2ShapeOverlapInput* shape = shapes + i;
+		shape->shape->ComputeAABB(aabbs + i, shape->transform, shape->childIndex);
+		centers[i] = aabbs[i].GetCenter();
+
+		new (proxies + i) cb2DistanceProxy();
+		proxies[i].set(shape->shape, shape->childIndex);
+	}
+	cb2ComputeLocalityOrder(centers, count, order);
+
+	cb2WorldOverlapWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.shapes = shapes;
+	wrapper.aabbs = aabbs;
+	wrapper.proxies = proxies;
+	wrapper.hits = hits;
+	wrapper.hitCount = 0;
+	wrapper.maxHits = maxHits;
+	m_contactManager.m_broadPhase.QueryBatch(&wrapper, aabbs, order, count);
+
+	cb2Free(aabbs);
+	return wrapper.hitCount;
+}
+
+struct cb2WorldClosestWrapper;
+
+struct cb2WorldClosestChildWrapper
+{
+	bool QueryCallback(int childIndex);
+
+	cb2WorldClosestWrapper* wrapper;
+	cb2Fixture* fixture;
+};
+
+struct cb2WorldClosestWrapper
+{
+	float ClosestCallback(int proxyId)
+	{
+		cb2FixtureProxy* proxy = (cb2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		if (proxy->childIndex != cb2ChainShape::e_allChildren)
+		{
+			TestChild(proxy->fixture, proxy->childIndex);
+			return GetMaxDistance();
+		}
+
+		// Test the chain children in reach of the point.
+		cb2AABB aabb = proxy->aabb;
+		float radius = GetMaxDistance();
+		if (radius < cb2_maxFloat)
+		{
+			aabb.lowerBound = point - ci::Vec2f(radius, radius);
+			aabb.upperBound = point + ci::Vec2f(radius, radius);
+		}
+
+		cb2WorldClosestChildWrapper childWrapper;
+		childWrapper.wrapper = this;
+		childWrapper.fixture = proxy->fixture;
+		cb2QueryChildren(proxy->fixture->GetShape(), &childWrapper, aabb, proxy->fixture->GetBody()->GetTransform());
+		return GetMaxDistance();
+	}
+
+	void TestChild(cb2Fixture* fixture, int childIndex)
+	{
+		cb2DistanceInput input;
+		input.proxyA.set(fixture->GetShape(), childIndex);
+		input.proxyB = pointProxy;
+		input.transformA = fixture->GetBody()->GetTransform();
+		input.transformB.SetIdentity();
+		input.useRadii = true;
+
+		cb2SimplexCache cache;
+		cache.count = 0;
+		cb2DistanceOutput output;
+		cb2Distance(&output, &cache, &input);
+
+		// Insert the hit in distance order, dropping the farthest when full.
+		if (output.distance > maxDistance || (hitCount == maxHits && output.distance >= hits[hitCount - 1].distance))
+		{
+			return;
+		}
+
+		int i = hitCount < maxHits ? hitCount++ : hitCount - 1;
+		for (; i > 0 && hits[i - 1].distance > output.distance; --i)
+		{
+			hits[i] = hits[i - 1];
+		}
+		hits[i].fixture = fixture;
+		hits[i].childIndex = childIndex;
+		hits[i].point = output.pointA;
+		hits[i].distance = output.distance;
+	}
+
+	/// The search closes in on the farthest hit once enough fixtures are found.
+	float GetMaxDistance() const
+	{
+		return hitCount == maxHits ? hits[hitCount - 1].distance : maxDistance;
+	}
+
+	const cb2BroadPhase* broadPhase;
+	cb2DistanceProxy pointProxy;
+	ci::Vec2f point;
+	float maxDistance;
+	cb2ClosestFixture* hits;
+	int hitCount;
+	int maxHits;
+};
+
+inline bool cb2WorldClosestChildWrapper::QueryCallback(int childIndex)
+{
+	wrapper->TestChild(fixture, childIndex);
+	return true;
+}
+
+int cb2World::QueryClosest(const ci::Vec2f& point, float maxDistance, cb2ClosestFixture* hits, int maxHits) const
+{
+	if (maxHits <= 0 || maxDistance < 0.0f)
+	{
+		return 0;
+	}
+
+	cb2WorldClosestWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.pointProxy.m_buffer[0] = point;
+	wrapper.pointProxy.m_vertices = wrapper.pointProxy.m_buffer;
+	wrapper.pointProxy.m_count = 1;
+	wrapper.pointProxy.m_radius = 0.0f;
+	wrapper.point = point;
+	wrapper.maxDistance = maxDistance;
+	wrapper.hits = hits;
+	wrapper.hitCount = 0;
+	wrapper.maxHits = maxHits;
+	m_contactManager.m_broadPhase.QueryClosest(&wrapper, point, maxDistance);
+	return wrapper.hitCount;
+}
+
+bool cb2World::QueryClosest(const ci::Vec2f& point, float maxDistance, cb2ClosestFixture* hit) const
+{
+	return QueryClosest(point, maxDistance, hit, 1) == 1;
+}
+
+void cb2World::DrawShape(cb2Fixture* fixture, const cb2Transform& xf, const cb2Color& color, int childIndex)
+{
+	switch (fixture->GetType())
+	{
+	case cb2Shape::e_circle:
+		{
+			cb2CircleShape* circle = (cb2CircleShape*)fixture->GetShape();
+
+			ci::Vec2f center = cb2Mul(xf, circle->m_p);
+			float radius = circle->m_radius;
+			ci::Vec2f axis = cb2Mul(xf.q, ci::Vec2f(1.0f, 0.0f));
+
+			g_debugDraw->DrawSolidCircle(center, radius, axis, color);
+		}
+		break;
+
+	case cb2Shape::e_edge:
+		{
+			cb2EdgeShape* edge = (cb2EdgeShape*)fixture->GetShape();
+			ci::Vec2f v1 = cb2Mul(xf, edge->m_vertex1);
+			ci::Vec2f v2 = cb2Mul(xf, edge->m_vertex2);
+			g_debugDraw->DrawSegment(v1, v2, color);
+		}
+		break;
+
+	case cb2Shape::e_chain:
+		{
+			cb2ChainShape* chain = (cb2ChainShape*)fixture->GetShape();
+			int count = chain->m_count;
+			const ci::Vec2f* vertices = chain->m_vertices;
+
+			// A single child is the edge from vertex childIndex to the next.
+			int first = childIndex < 0 ? 0 : childIndex;
+			count = childIndex < 0 ? count : childIndex + 2;
+
+			ci::Vec2f v1 = cb2Mul(xf, vertices[first]);
+			for (int i = first + 1; i < count; ++i)
 			{
-				for (cb2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
+				ci::Vec2f v2 = cb2Mul(xf, vertices[i]);
+				g_debugDraw->DrawSegment(v1, v2, color);
+				g_debugDraw->DrawCircle(v1, 0.05f, color);
+				v1 = v2;
+			}
+		}
+		break;
+
+	case cb2Shape::e_heightfield:
+		{
+			cb2HeightfieldShape* heightfield = (cb2HeightfieldShape*)fixture->GetShape();
+			int first = childIndex < 0 ? 0 : childIndex;
+			int count = childIndex < 0 ? heightfield->m_count : childIndex + 2;
+
+			ci::Vec2f v1 = cb2Mul(xf, heightfield->GetVertex(first));
+			for (int i = first + 1; i < count; ++i)
+			{
+				ci::Vec2f v2 = cb2Mul(xf, heightfield->GetVertex(i));
+				g_debugDraw->DrawSegment(v1, v2, color);
+				v1 = v2;
+			}
+		}
+		break;
+
+	case cb2Shape::e_compound:
+		{
+			cb2CompoundShape* compound = (cb2CompoundShape*)fixture->GetShape();
+			int first = childIndex < 0 ? 0 : childIndex;
+			int count = childIndex < 0 ? compound->m_count : childIndex + 1;
+
+			for (int i = first; i < count; ++i)
+			{
+				const cb2PolygonShape* piece = compound->GetChild(i);
+				ci::Vec2f vertices[cb2_maxPolygonVertices];
+				for (int j = 0; j < piece->m_count; ++j)
 				{
-					if (island.m_bodyCount == island.m_bodyCapacity)
-					{
-						break;
-					}
+					vertices[j] = cb2Mul(xf, piece->m_vertices[j]);
+				}
+
+				g_debugDraw->DrawSolidPolygon(vertices, piece->m_count, color);
+			}
+		}
+		break;
+
+	case cb2Shape::e_polygon:
+		{
+			cb2PolygonShape* poly = (cb2PolygonShape*)fixture->GetShape();
+			int vertexCount = poly->m_count;
+			cb2Assert(vertexCount <= cb2_maxPolygonVertices);
+			ci::Vec2f vertices[cb2_maxPolygonVertices];
+
+			for (int i = 0; i < vertexCount; ++i)
+			{
+				vertices[i] = cb2Mul(xf, poly->m_vertices[i]);
+			}
+
+			g_debugDraw->DrawSolidPolygon(vertices, vertexCount, color);
+		}
+		break;
+
+	case cb2Shape::e_capsule:
+		{
+			cb2CapsuleShape* capsule = (cb2CapsuleShape*)fixture->GetShape();
+			ci::Vec2f v1 = cb2Mul(xf, capsule->m_vertex1);
+			ci::Vec2f v2 = cb2Mul(xf, capsule->m_vertex2);
+			float radius = capsule->m_radius;
+
+			// The outline is convex. Each cap is a half circle, turning from the
+			// right of the axis through the end of the capsule.
+			const int k_capSegments = 8;
+			ci::Vec2f vertices[2 * k_capSegments + 2];
+			ci::Vec2f axis = v2 - v1;
+			axis.normalize();
+			ci::Vec2f normal(axis.y, -axis.x);
+
+			for (int i = 0; i <= k_capSegments; ++i)
+			{
+				float angle = cb2_pi * i / k_capSegments;
+				ci::Vec2f d = cosf(angle) * normal + sinf(angle) * axis;
+				vertices[i] = v2 + radius * d;
+				vertices[k_capSegments + 1 + i] = v1 - radius * d;
+			}
+
+			g_debugDraw->DrawSolidPolygon(vertices, 2 * k_capSegments + 2, color);
+			g_debugDraw->DrawSegment(v1, v2, color);
+		}
+		break;
+            
+    default:
+        break;
+	}
+}
+
+void cb2World::DrawJoint(cb2Joint* joint)
+{
+	cb2Body* bodyA = joint->GetBodyA();
+	cb2Body* bodyB = joint->GetBodyB();
+	const cb2Transform& xf1 = bodyA->GetTransform();
+	const cb2Transform& xf2 = bodyB->GetTransform();
+	ci::Vec2f x1 = xf1.p;
+	ci::Vec2f x2 = xf2.p;
+	ci::Vec2f p1 = joint->GetAnchorA();
+	ci::Vec2f p2 = joint->GetAnchorB();
+
+	cb2Color color(0.5f, 0.8f, 0.8f);
+
+	switch (joint->GetType())
+	{
+	case e_distanceJoint:
+		g_debugDraw->DrawSegment(p1, p2, color);
+		break;
+
+	case e_pulleyJoint:
+		{
+			cb2PulleyJoint* pulley = (cb2PulleyJoint*)joint;
+			ci::Vec2f s1 = pulley->GetGroundAnchorA();
+			ci::Vec2f s2 = pulley->GetGroundAnchorB();
+			g_debugDraw->DrawSegment(s1, p1, color);
+			g_debugDraw->DrawSegment(s2, p2, color);
+			g_debugDraw->DrawSegment(s1, s2, color);
+		}
+		break;
 
-					if (island.m_contactCount == island.m_contactCapacity)
-					{
-						break;
-					}
+	case e_mouseJoint:
+		// don't draw this
+		break;
 
-					cb2Contact* contact = ce->contact;
+	default:
+		g_debugDraw->DrawSegment(x1, p1, color);
+		g_debugDraw->DrawSegment(p1, p2, color);
+		g_debugDraw->DrawSegment(x2, p2, color);
+	}
+}
 
-					// Has this contact already been added to the island?
-					if (contact->m_flags & cb2Contact::e_islandFlag)
-					{
-						continue;
-					}
+// The debug color of a body's shapes.
+static cb2Color cb2GetShapeColor(const cb2Body* b)
+{
+	if (b->IsActive() == false)
+	{
+		return cb2Color(0.5f, 0.5f, 0.3f);
+	}
+	else if (b->GetType() == cb2_staticBody)
+	{
+		return cb2Color(0.5f, 0.9f, 0.5f);
+	}
+	else if (b->GetType() == cb2_kinematicBody)
+	{
+		return cb2Color(0.5f, 0.5f, 0.9f);
+	}
+	else if (b->IsAwake() == false)
+	{
+		return cb2Color(0.6f, 0.6f, 0.6f);
+	}
+	return cb2Color(0.9f, 0.7f, 0.7f);
+}
 
-					// Only add static, kinematic, or bullet bodies.
-					cb2Body* other = ce->other;
-					if (other->m_type == cb2_dynamicBody &&
-						body->IsBullet() == false && other->IsBullet() == false)
-					{
-						continue;
-					}
+// Collects the proxies in the view of the debug draw.
+struct cb2WorldDrawWrapper
+{
+	bool QueryCallback(int proxyId)
+	{
+		proxies->Push((cb2FixtureProxy*)broadPhase->GetUserData(proxyId));
+		return true;
+	}
 
-					// Skip sensors.
-					bool sensorA = contact->m_fixtureA->m_isSensor;
-					bool sensorB = contact->m_fixtureB->m_isSensor;
-					if (sensorA || sensorB)
-					{
-						continue;
-					}
+	const cb2BroadPhase* broadPhase;
+	cb2GrowableStack<cb2FixtureProxy*, 256>* proxies;
+};
 
-					// Tentatively advance the body to the TOI.
-					cb2Sweep backup = other->m_sweep;
-					if ((other->m_flags & cb2Body::e_islandFlag) == 0)
-					{
-						other->Advance(minAlpha);
-					}
+static void cb2DrawAABB(cb2Draw* draw, const cb2AABB& aabb, const cb2Color& color)
+{
+	ci::Vec2f vs[4];
+	vs[0].set(aabb.lowerBound.x, aabb.lowerBound.y);
+	vs[1].set(aabb.upperBound.x, aabb.lowerBound.y);
+	vs[2].set(aabb.upperBound.x, aabb.upperBound.y);
+	vs[3].set(aabb.lowerBound.x, aabb.upperBound.y);
+	draw->DrawPolygon(vs, 4, color);
+}
 
-					// Update the contact points
-					contact->Update(m_contactManager.m_contactListener);
+void cb2World::DrawDebugData()
+{
+	if (g_debugDraw == NULL)
+	{
+		return;
+	}
 
-					// Was the contact disabled by the user?
-					if (contact->IsEnabled() == false)
-					{
-						other->m_sweep = backup;
-						other->SynchronizeTransform();
-						continue;
-					}
+	unsigned int flags = g_debugDraw->GetFlags();
+	cb2BroadPhase* bp = &m_contactManager.m_broadPhase;
 
-					// Are there contact points?
-					if (contact->IsTouching() == false)
-					{
-						other->m_sweep = backup;
-						other->SynchronizeTransform();
-						continue;
-					}
+	cb2AABB view;
+	bool culled = g_debugDraw->GetView(&view.lowerBound, &view.upperBound);
 
-					// Add the contact to the island
-					contact->m_flags |= cb2Contact::e_islandFlag;
-					island.Add(contact);
+	if (culled && (flags & (cb2Draw::e_shapeBit | cb2Draw::e_aabbBit)))
+	{
+		// Each visible child is drawn once, found through the tree instead of the body list.
+		cb2GrowableStack<cb2FixtureProxy*, 256> proxies;
+		cb2WorldDrawWrapper wrapper;
+		wrapper.broadPhase = bp;
+		wrapper.proxies = &proxies;
+		bp->Query(&wrapper, view);
+
+		cb2Color aabbColor(0.9f, 0.3f, 0.9f);
+		while (proxies.GetCount() > 0)
+		{
+			cb2FixtureProxy* proxy = proxies.Pop();
+			cb2Fixture* f = proxy->fixture;
+			cb2Body* b = f->GetBody();
 
-					// Has the other body already been added to the island?
-					if (other->m_flags & cb2Body::e_islandFlag)
-					{
-						continue;
-					}
-					
-					// Add the other body to the island.
-					other->m_flags |= cb2Body::e_islandFlag;
+			if (flags & cb2Draw::e_shapeBit)
+			{
+				DrawShape(f, b->GetTransform(), cb2GetShapeColor(b), f->GetType() == cb2Shape::e_chain ? proxy->childIndex : -1);
+			}
 
-					if (other->m_type != cb2_staticBody)
-					{
-						other->SetAwake(true);
-					}
+			if (flags & cb2Draw::e_aabbBit)
+			{
+				cb2DrawAABB(g_debugDraw, bp->GetFatAABB(proxy->proxyId), aabbColor);
+			}
+		}
+	}
 
-					island.Add(other);
-				}
+	if ((flags & cb2Draw::e_shapeBit) && culled == false)
+	{
+		for (cb2Body* b = m_bodyList; b; b = b->GetNext())
+		{
+			const cb2Transform& xf = b->GetTransform();
+			cb2Color color = cb2GetShapeColor(b);
+			for (cb2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+			{
+				DrawShape(f, xf, color, -1);
 			}
 		}
+	}
 
-		cb2TimeStep subStep;
-		subStep.dt = (1.0f - minAlpha) * step.dt;
-		subStep.inv_dt = 1.0f / subStep.dt;
-		subStep.dtRatio = 1.0f;
-		subStep.positionIterations = 20;
-		subStep.velocityIterations = step.velocityIterations;
-		subStep.warmStarting = false;
-		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
+	if (flags & cb2Draw::e_jointBit)
+	{
+		for (cb2Joint* j = m_jointList; j; j = j->GetNext())
+		{
+			if (culled)
+			{
+				// Skip joints whose bodies and anchors are all outside the view.
+				cb2AABB box;
+				box.lowerBound = cb2Min(j->GetBodyA()->GetPosition(), j->GetBodyB()->GetPosition());
+				box.upperBound = cb2Max(j->GetBodyA()->GetPosition(), j->GetBodyB()->GetPosition());
+				ci::Vec2f anchorA = j->GetAnchorA();
+				ci::Vec2f anchorB = j->GetAnchorB();
+				box.lowerBound = cb2Min(box.lowerBound, cb2Min(anchorA, anchorB));
+				box.upperBound = cb2Max(box.upperBound, cb2Max(anchorA, anchorB));
+				if (cb2TestOverlap(box, view) == false)
+				{
+					continue;
+				}
+			}
 
-		// Reset island flags and synchronize broad-phase proxies.
-		for (int i = 0; i < island.m_bodyCount; ++i)
+			DrawJoint(j);
+		}
+	}
+
+	if (flags & cb2Draw::e_pairBit)
+	{
+		cb2Color color(0.3f, 0.9f, 0.9f);
+		for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->GetNext())
 		{
-			cb2Body* body = island.m_bodies[i];
-			body->m_flags &= ~cb2Body::e_islandFlag;
+			//cb2Fixture* fixtureA = c->GetFixtureA();
+			//cb2Fixture* fixtureB = c->GetFixtureB();
 
-			if (body->m_type != cb2_dynamicBody)
+			//ci::Vec2f cA = fixtureA->GetAABB().GetCenter();
+			//ci::Vec2f cB = fixtureB->GetAABB().GetCenter();
+
+			//g_debugDraw->DrawSegment(cA, cB, color);
+		}
+	}
+
+	if ((flags & cb2Draw::e_aabbBit) && culled == false)
+	{
+		cb2Color color(0.9f, 0.3f, 0.9f);
+
+		for (cb2Body* b = m_bodyList; b; b = b->GetNext())
+		{
+			if (b->IsActive() == false)
 			{
 				continue;
 			}
 
-			body->SynchronizeFixtures();
+			for (cb2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+			{
+				for (int i = 0; i < f->m_proxyCount; ++i)
+				{
+					cb2FixtureProxy* proxy = f->m_proxies + i;
+					cb2DrawAABB(g_debugDraw, bp->GetFatAABB(proxy->proxyId), color);
+				}
+			}
+		}
+	}
 
-			// Invalidate all contact TOIs on this displaced body.
-			for (cb2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
+	if (flags & cb2Draw::e_centerOfMassBit)
+	{
+		for (cb2Body* b = m_bodyList; b; b = b->GetNext())
+		{
+			cb2Transform xf = b->GetTransform();
+			xf.p = b->GetWorldCenter();
+			if (culled)
 			{
-				ce->contact->m_flags &= ~(cb2Contact::e_toiFlag | cb2Contact::e_islandFlag);
+				cb2AABB point;
+				point.lowerBound = xf.p;
+				point.upperBound = xf.p;
+				if (cb2TestOverlap(point, view) == false)
+				{
+					continue;
+				}
 			}
+			g_debugDraw->DrawTransform(xf);
 		}
+	}
 
-		// Commit fixture proxy movements to the broad-phase so that new contacts are created.
-		// Also, some contacts can be destroyed.
-		m_contactManager.FindNewContacts();
+	if (flags & cb2Draw::e_particleBit)
+	{
+		for (cb2ParticleSystem* ps = m_particleSystemList; ps; ps = ps->m_next)
+		{
+			ps->Draw(g_debugDraw);
+		}
+	}
 
-		if (m_subStepping)
+	if ((flags & cb2Draw::e_profileBit) && m_profileStats.GetSampleCount() > 0)
+	{
+		// The timings, in milliseconds.
+		int y = 15;
+		for (int i = cb2_profileStep; i <= cb2_profileParticles; ++i)
 		{
-			m_stepComplete = false;
-			break;
+			cb2ProfileStat stat = m_profileStats.GetStat((cb2ProfileField)i);
+			char text[128];
+			snprintf(text, sizeof(text), "%-14s mean %6.2f  p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f",
+				cb2ProfileStats::GetFieldName((cb2ProfileField)i), stat.mean, stat.p50, stat.p95, stat.p99, stat.max);
+			g_debugDraw->DrawString(5, y, text);
+			y += 15;
 		}
 	}
 }
 
-void cb2World::Step(float dt, int velocityIterations, int positionIterations)
+int cb2World::GetProxyCount() const
 {
-	cb2Timer stepTimer;
+	return m_contactManager.m_broadPhase.GetProxyCount();
+}
 
-	// If new fixtures were added, we need to find the new contacts.
-	if (m_flags & e_newFixture)
-	{
-		m_contactManager.FindNewContacts();
-		m_flags &= ~e_newFixture;
-	}
+int cb2World::GetTreeHeight() const
+{
+	return m_contactManager.m_broadPhase.GetTreeHeight();
+}
 
-	m_flags |= e_locked;
+int cb2World::GetTreeBalance() const
+{
+	return m_contactManager.m_broadPhase.GetTreeBalance();
+}
 
-	cb2TimeStep step;
-	step.dt = dt;
-	step.velocityIterations	= velocityIterations;
-	step.positionIterations = positionIterations;
-	if (dt > 0.0f)
-	{
-		step.inv_dt = 1.0f / dt;
-	}
-	else
+float cb2World::GetTreeQuality() const
+{
+	return m_contactManager.m_broadPhase.GetTreeQuality();
+}
+
+void cb2World::ShiftOrigin(const ci::Vec2f& newOrigin)
+{
+	cb2Assert((m_flags & e_locked) == 0);
+	if ((m_flags & e_locked) == e_locked)
 	{
-		step.inv_dt = 0.0f;
+		return;
 	}
 
-	step.dtRatio = m_inv_dt0 * dt;
-
-	step.warmStarting = m_warmStarting;
-	
-	// Update contacts. This is where some contacts are destroyed.
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
 	{
-		cb2Timer timer;
-		m_contactManager.Collide();
-		m_profile.collide = timer.GetMilliseconds();
+		b->m_xf.p -= newOrigin;
+		b->m_xf0.p -= newOrigin;
+		b->m_sweep.c0 -= newOrigin;
+		b->m_sweep.c -= newOrigin;
 	}
 
-	// Integrate velocities, solve velocity constraints, and integrate positions.
-	if (m_stepComplete && step.dt > 0.0f)
+	for (cb2Joint* j = m_jointList; j; j = j->m_next)
 	{
-		cb2Timer timer;
-		Solve(step);
-		m_profile.solve = timer.GetMilliseconds();
+		j->ShiftOrigin(newOrigin);
 	}
 
-	// Handle TOI events.
-	if (m_continuousPhysics && step.dt > 0.0f)
+	for (cb2ParticleSystem* ps = m_particleSystemList; ps; ps = ps->m_next)
 	{
-		cb2Timer timer;
-		SolveTOI(step);
-		m_profile.solveTOI = timer.GetMilliseconds();
+		ps->ShiftOrigin(newOrigin);
 	}
 
-	if (step.dt > 0.0f)
+	for (int i = 0; i < m_lodObserverCount; ++i)
 	{
-		m_inv_dt0 = step.inv_dt;
+		m_lodObservers[i] -= newOrigin;
 	}
 
-	if (m_flags & e_clearForces)
+	if (m_targetDrives)
 	{
-		ClearForces();
+		m_targetDrives->ShiftOrigin(newOrigin);
 	}
 
-	m_flags &= ~e_locked;
+	m_contactManager.m_broadPhase.ShiftOrigin(newOrigin);
 
-	m_profile.step = stepTimer.GetMilliseconds();
+	m_origin.x += newOrigin.x;
+	m_origin.y += newOrigin.y;
 }
 
-void cb2World::ClearForces()
+ci::Vec2f cb2World::ToLocal(const ci::Vec2d& position) const
 {
-	for (cb2Body* body = m_bodyList; body; body = body->GetNext())
-	{
-		cb2::setZero(body->m_force);
-		body->m_torque = 0.0f;
-	}
+	return ci::Vec2f((float)(position.x - m_origin.x), (float)(position.y - m_origin.y));
 }
 
-struct cb2WorldQueryWrapper
+ci::Vec2d cb2World::ToGlobal(const ci::Vec2f& position) const
 {
-	bool QueryCallback(int proxyId)
-	{
-		cb2FixtureProxy* proxy = (cb2FixtureProxy*)broadPhase->GetUserData(proxyId);
-		return callback->ReportFixture(proxy->fixture);
-	}
+	return ci::Vec2d(m_origin.x + position.x, m_origin.y + position.y);
+}
 
-	const cb2BroadPhase* broadPhase;
-	cb2QueryCallback* callback;
-};
+void cb2World::SetOriginCellSize(float cellSize)
+{
+	cb2Assert(cb2::isValid(cellSize) && cellSize >= 0.0f);
+	m_originCellSize = cellSize;
+}
 
-void cb2World::QueryAABB(cb2QueryCallback* callback, const cb2AABB& aabb) const
+void cb2World::FollowOriginFocus()
 {
-	cb2WorldQueryWrapper wrapper;
-	wrapper.broadPhase = &m_contactManager.m_broadPhase;
-	wrapper.callback = callback;
-	m_contactManager.m_broadPhase.Query(&wrapper, aabb);
+	// The focus in cells from the current origin. Within a cell the origin stays put,
+	// so a focus moving about a cell border does not shift the world every step.
+	double x = (m_originFocus.x - m_origin.x) / m_originCellSize;
+	double y = (m_originFocus.y - m_origin.y) / m_originCellSize;
+	if (fabs(x) <= 1.0 && fabs(y) <= 1.0)
+	{
+		return;
+	}
+
+	// Whole cells keep the origin on the grid.
+	double cellX = floor(x + 0.5);
+	double cellY = floor(y + 0.5);
+	ShiftOrigin(ci::Vec2f((float)(cellX * m_originCellSize), (float)(cellY * m_originCellSize)));
 }
 
-struct cb2WorldRayCastWrapper
+void cb2World::GetMemoryStats(cb2MemoryStats* stats) const
 {
-	float RayCastCallback(const cb2RayCastInput& input, int proxyId)
+	memset(stats, 0, sizeof(cb2MemoryStats));
+	m_blockAllocator.GetStats(&stats->block);
+	m_contactManager.m_broadPhase.GetMemory(&stats->broadPhase);
+
+	stats->stackCapacity = m_stackAllocator->GetCapacity();
+	stats->stackMaxAllocation = m_stackAllocator->GetMaxAllocation();
+	int threadCount = m_threadPool ? m_threadPool->GetThreadCount() : 0;
+	for (int i = 0; i < threadCount; ++i)
 	{
-		void* userData = broadPhase->GetUserData(proxyId);
-		cb2FixtureProxy* proxy = (cb2FixtureProxy*)userData;
-		cb2Fixture* fixture = proxy->fixture;
-		int index = proxy->childIndex;
-		cb2RayCastOutput output;
-		bool hit = fixture->RayCast(&output, input, index);
+		stats->stackCapacity += m_threadAllocators[i].GetCapacity();
+		stats->stackMaxAllocation = cb2Max(stats->stackMaxAllocation, m_threadAllocators[i].GetMaxAllocation());
+	}
 
-		if (hit)
+	stats->bodyCount = m_bodyCount;
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
 		{
-			float fraction = output.fraction;
-			ci::Vec2f point = (1.0f - fraction) * input.p1 + fraction * input.p2;
-			return callback->ReportFixture(fixture, point, output.normal, fraction);
+			++stats->fixtureCount;
+			stats->proxyCount += f->m_proxyCount;
 		}
+	}
 
-		return input.maxFraction;
+	stats->contactCount = m_contactManager.m_contactCount;
+	for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->GetNext())
+	{
+		++stats->contactCounts[c->GetFixtureA()->GetType()][c->GetFixtureB()->GetType()];
 	}
 
-	const cb2BroadPhase* broadPhase;
-	cb2RayCastCallback* callback;
-};
+	stats->jointCount = m_jointCount;
+	for (cb2Joint* j = m_jointList; j; j = j->GetNext())
+	{
+		++stats->jointCounts[j->GetType()];
+	}
 
-void cb2World::RayCast(cb2RayCastCallback* callback, const ci::Vec2f& point1, const ci::Vec2f& point2) const
-{
-	cb2WorldRayCastWrapper wrapper;
-	wrapper.broadPhase = &m_contactManager.m_broadPhase;
-	wrapper.callback = callback;
-	cb2RayCastInput input;
-	input.maxFraction = 1.0f;
-	input.p1 = point1;
-	input.p2 = point2;
-	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
+	stats->totalBytes = stats->block.chunkBytes + stats->block.largeBytes + stats->broadPhase.bytes + stats->stackCapacity;
 }
 
-void cb2World::DrawShape(cb2Fixture* fixture, const cb2Transform& xf, const cb2Color& color)
+void cb2World::Dump()
 {
-	switch (fixture->GetType())
+	if ((m_flags & e_locked) == e_locked)
 	{
-	case cb2Shape::e_circle:
-		{
-			cb2CircleShape* circle = (cb2CircleShape*)fixture->GetShape();
+		return;
+	}
 
-			ci::Vec2f center = cb2Mul(xf, circle->m_p);
-			float radius = circle->m_radius;
-			ci::Vec2f axis = cb2Mul(xf.q, ci::Vec2f(1.0f, 0.0f));
+	cb2Log("ci::Vec2f g(%.15lef, %.15lef);\n", m_gravity.x, m_gravity.y);
+	cb2Log("m_world->SetGravity(g);\n");
 
-			g_debugDraw->DrawSolidCircle(center, radius, axis, color);
-		}
-		break;
+	cb2Log("cb2Body** bodies = (cb2Body**)cb2Alloc(%d * sizeof(cb2Body*));\n", m_bodyCount);
+	cb2Log("cb2Joint** joints = (cb2Joint**)cb2Alloc(%d * sizeof(cb2Joint*));\n", m_jointCount);
+	int i = 0;
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b->m_islandIndex = i;
+		b->Dump();
+		++i;
+	}
 
-	case cb2Shape::e_edge:
-		{
-			cb2EdgeShape* edge = (cb2EdgeShape*)fixture->GetShape();
-			ci::Vec2f v1 = cb2Mul(xf, edge->m_vertex1);
-			ci::Vec2f v2 = cb2Mul(xf, edge->m_vertex2);
-			g_debugDraw->DrawSegment(v1, v2, color);
-		}
-		break;
+	i = 0;
+	for (cb2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		j->m_index = i;
+		++i;
+	}
 
-	case cb2Shape::e_chain:
+	// First pass on joints, skip gear joints.
+	for (cb2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		if (j->m_type == e_gearJoint)
 		{
-			cb2ChainShape* chain = (cb2ChainShape*)fixture->GetShape();
-			int count = chain->m_count;
-			const ci::Vec2f* vertices = chain->m_vertices;
-
-			ci::Vec2f v1 = cb2Mul(xf, vertices[0]);
-			for (int i = 1; i < count; ++i)
-			{
-				ci::Vec2f v2 = cb2Mul(xf, vertices[i]);
-				g_debugDraw->DrawSegment(v1, v2, color);
-				g_debugDraw->DrawCircle(v1, 0.05f, color);
-				v1 = v2;
-			}
+			continue;
 		}
-		break;
-
-	case cb2Shape::e_polygon:
-		{
-			cb2PolygonShape* poly = (cb2PolygonShape*)fixture->GetShape();
-			int vertexCount = poly->m_count;
-			cb2Assert(vertexCount <= cb2_maxPolygonVertices);
-			ci::Vec2f vertices[cb2_maxPolygonVertices];
 
-			for (int i = 0; i < vertexCount; ++i)
-			{
-				vertices[i] = cb2Mul(xf, poly->m_vertices[i]);
-			}
+		cb2Log("{\n");
+		j->Dump();
+		cb2Log("}\n");
+	}
 
-			g_debugDraw->DrawSolidPolygon(vertices, vertexCount, color);
+	// Second pass on joints, only gear joints.
+	for (cb2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		if (j->m_type != e_gearJoint)
+		{
+			continue;
 		}
-		break;
-            
-    default:
-        break;
+
+		cb2Log("{\n");
+		j->Dump();
+		cb2Log("}\n");
 	}
+
+	cb2Log("cb2Free(joints);\n");
+	cb2Log("cb2Free(bodies);\n");
+	cb2Log("joints = NULL;\n");
+	cb2Log("bodies = NULL;\n");
 }
 
-void cb2World::DrawJoint(cb2Joint* joint)
+cb2World* cb2World::Clone() const
 {
-	cb2Body* bodyA = joint->GetBodyA();
-	cb2Body* bodyB = joint->GetBodyB();
-	const cb2Transform& xf1 = bodyA->GetTransform();
-	const cb2Transform& xf2 = bodyB->GetTransform();
-	ci::Vec2f x1 = xf1.p;
-	ci::Vec2f x2 = xf2.p;
-	ci::Vec2f p1 = joint->GetAnchorA();
-	ci::Vec2f p2 = joint->GetAnchorB();
+	cb2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return NULL;
+	}
 
-	cb2Color color(0.5f, 0.8f, 0.8f);
+	cb2World* world = new cb2World(m_gravity);
+
+	world->m_allowSleep = m_allowSleep;
+	world->m_warmStarting = m_warmStarting;
+	world->m_wideContactSolver = m_wideContactSolver;
+	world->m_contactReduction = m_contactReduction;
+	world->m_earlySleep = m_earlySleep;
+	world->m_batchIntegration = m_batchIntegration;
+	world->m_solverType = m_solverType;
+	world->m_subStepCount = m_subStepCount;
+	world->m_impulseTolerance = m_impulseTolerance;
+	world->m_postSolveThreshold = m_postSolveThreshold;
+	world->m_jointBatching = m_jointBatching;
+	world->m_spatialOrdering = m_spatialOrdering;
+	world->m_directJointSolver = m_directJointSolver;
+	world->m_continuousPhysics = m_continuousPhysics;
+	world->m_subStepping = m_subStepping;
+	world->m_maxTOIContacts = m_maxTOIContacts;
+	world->m_toiEventBudget = m_toiEventBudget;
+	world->m_toiTimeBudget = m_toiTimeBudget;
+	world->m_splitIslands = m_splitIslands;
+	world->m_deterministic = m_deterministic;
+	world->m_solveBudget = m_solveBudget;
+	world->SetLodLevels(m_lodLevels, m_lodLevelCount);
+	world->SetLodObservers(m_lodObservers, m_lodObserverCount);
+	world->m_origin = m_origin;
+	world->m_originFocus = m_originFocus;
+	world->m_originCellSize = m_originCellSize;
+	world->m_flags = m_flags;
+	world->m_inv_dt0 = m_inv_dt0;
+	world->m_fixedTimeStep = m_fixedTimeStep;
+	world->m_fixedVelocityIterations = m_fixedVelocityIterations;
+	world->m_fixedPositionIterations = m_fixedPositionIterations;
+	world->m_maxFixedSteps = m_maxFixedSteps;
+	world->m_accumulator = m_accumulator;
+	world->m_stepCount = m_stepCount;
+	world->m_stepComplete = m_stepComplete;
+	world->SetSpeculativeContacts(m_speculativeContacts);
+	world->SetMaxSubSteps(GetMaxSubSteps());
+	world->SetThreadCount(GetThreadCount());
+	world->SetAwakeSets(GetAwakeSets());
+	world->SetContiguousContacts(GetContiguousContacts());
+	world->SetImpulseCache(GetImpulseCache());
+	world->SetContactEvents(m_contactEvents != NULL);
+	world->m_hitEventThreshold = m_hitEventThreshold;
+	if (m_materials)
+	{
+		*world->GetMaterials() = *m_materials;
+	}
 
-	switch (joint->GetType())
+	// The copied bodies keep their ids.
+	world->m_bodyIdCount = m_bodyIdCount;
+	for (int i = 0; i < m_freeBodyIdCount; ++i)
 	{
-	case e_distanceJoint:
-		g_debugDraw->DrawSegment(p1, p2, color);
-		break;
+		world->FreeBodyId(m_freeBodyIds[i]);
+	}
 
-	case e_pulleyJoint:
+	world->m_destructionListener = m_destructionListener;
+	world->SetProfiler(m_profiler);
+	world->SetProfileWindow(GetProfileWindow());
+	cb2ContactManager* contactManager = &world->m_contactManager;
+	contactManager->m_contactFilter = m_contactManager.m_contactFilter;
+	contactManager->m_contactListener = m_contactManager.m_contactListener;
+	contactManager->m_speculativeTime = m_contactManager.m_speculativeTime;
+
+	// The objects of this world in list order, bodies then fixtures then joints,
+	// and the copies in the same order.
+	int fixtureCount = 0;
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		fixtureCount += b->m_fixtureCount;
+	}
+
+	int objectCount = m_bodyCount + fixtureCount + m_jointCount;
+	const void** objects = (const void**)cb2Alloc(cb2Max(objectCount, 1) * sizeof(void*));
+	void** copies = (void**)cb2Alloc(cb2Max(objectCount, 1) * sizeof(void*));
+	int objectIndex = 0;
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		objects[objectIndex++] = b;
+	}
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
 		{
-			cb2PulleyJoint* pulley = (cb2PulleyJoint*)joint;
-			ci::Vec2f s1 = pulley->GetGroundAnchorA();
-			ci::Vec2f s2 = pulley->GetGroundAnchorB();
-			g_debugDraw->DrawSegment(s1, p1, color);
-			g_debugDraw->DrawSegment(s2, p2, color);
-			g_debugDraw->DrawSegment(s1, s2, color);
+			objects[objectIndex++] = f;
 		}
-		break;
+	}
+	for (cb2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		objects[objectIndex++] = j;
+	}
+	memset(copies, 0, objectCount * sizeof(void*));
+	cb2CloneMap map(objects, copies, objectCount);
 
-	case e_mouseJoint:
-		// don't draw this
-		break;
+	// Copy the bodies as they are and link them in the same order.
+	cb2BlockAllocator* allocator = &world->m_blockAllocator;
+	cb2Body* prevBody = NULL;
+	objectIndex = 0;
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		void* mem = allocator->Allocate(sizeof(cb2Body));
+		cb2Body* body = new (mem) cb2Body(*b);
+		body->m_flags &= ~cb2Body::e_islandFlag;
+		body->m_awakeIndex = -1;
+		body->m_persistentIsland = NULL;
+		body->m_islandPrev = NULL;
+		body->m_islandNext = NULL;
+		body->m_world = world;
+		body->m_fixtureList = NULL;
+		body->m_jointList = NULL;
+		body->m_contactList = NULL;
+		body->m_prev = prevBody;
+		body->m_next = NULL;
+		if (prevBody)
+		{
+			prevBody->m_next = body;
+		}
+		else
+		{
+			world->m_bodyList = body;
+		}
+		prevBody = body;
+		copies[objectIndex++] = body;
+		world->SetBodyById(body);
+	}
+	world->m_bodyCount = m_bodyCount;
 
-	default:
-		g_debugDraw->DrawSegment(x1, p1, color);
-		g_debugDraw->DrawSegment(p1, p2, color);
-		g_debugDraw->DrawSegment(x2, p2, color);
+	// The fixtures keep their proxy ids, the broad-phase is copied as a whole below.
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		cb2Body* body = map.Find(b);
+		cb2Fixture** link = &body->m_fixtureList;
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			void* mem = allocator->Allocate(sizeof(cb2Fixture));
+			cb2Fixture* fixture = new (mem) cb2Fixture(*f);
+			fixture->m_body = body;
+			fixture->m_next = NULL;
+			fixture->m_shape = f->m_shape->Clone(allocator);
+
+			int childCount = f->m_shape->GetChildCount();
+			fixture->m_proxies = (cb2FixtureProxy*)allocator->Allocate(childCount * sizeof(cb2FixtureProxy));
+			memcpy(fixture->m_proxies, f->m_proxies, childCount * sizeof(cb2FixtureProxy));
+			for (int i = 0; i < childCount; ++i)
+			{
+				fixture->m_proxies[i].fixture = fixture;
+			}
+
+			*link = fixture;
+			link = &fixture->m_next;
+			copies[objectIndex++] = fixture;
+		}
 	}
-}
 
-void cb2World::DrawDebugData()
-{
-	if (g_debugDraw == NULL)
+	if (m_sensorManager)
 	{
-		return;
+		void* mem = cb2Alloc(sizeof(cb2SensorManager));
+		world->m_sensorManager = new (mem) cb2SensorManager;
+		world->m_sensorManager->Copy(*m_sensorManager, map);
+		contactManager->m_sensorOverlaps = true;
 	}
 
-	unsigned int flags = g_debugDraw->GetFlags();
+	cb2BroadPhase* broadPhase = &contactManager->m_broadPhase;
+	broadPhase->Copy(m_contactManager.m_broadPhase);
+	for (cb2Body* b = world->m_bodyList; b; b = b->m_next)
+	{
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			for (int i = 0; i < f->m_proxyCount; ++i)
+			{
+				broadPhase->SetUserData(f->m_proxies[i].proxyId, f->m_proxies + i);
+			}
+		}
+	}
 
-	if (flags & cb2Draw::e_shapeBit)
+	// A gear joint is created after its joints, so the joints are copied from the last
+	// in the list to the first.
+	if (m_jointCount > 0)
 	{
-		for (cb2Body* b = m_bodyList; b; b = b->GetNext())
+		int jointIndex = objectIndex + m_jointCount - 1;
+		cb2Joint* last = m_jointList;
+		while (last->m_next)
 		{
-			const cb2Transform& xf = b->GetTransform();
-			for (cb2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+			last = last->m_next;
+		}
+
+		for (cb2Joint* j = last; j; j = j->m_prev)
+		{
+			copies[jointIndex--] = cb2Joint::Clone(j, map, allocator);
+		}
+
+		cb2Joint* prevJoint = NULL;
+		for (cb2Joint* j = m_jointList; j; j = j->m_next)
+		{
+			cb2Joint* joint = map.Find(j);
+			joint->m_prev = prevJoint;
+			if (prevJoint)
+			{
+				prevJoint->m_next = joint;
+			}
+			else
+			{
+				world->m_jointList = joint;
+			}
+			prevJoint = joint;
+		}
+		world->m_jointCount = m_jointCount;
+
+		// Link the joint edges of each body in the same order.
+		for (cb2Body* b = m_bodyList; b; b = b->m_next)
+		{
+			cb2JointEdge* prevEdge = NULL;
+			for (cb2JointEdge* je = b->m_jointList; je; je = je->next)
 			{
-				if (b->IsActive() == false)
-				{
-					DrawShape(f, xf, cb2Color(0.5f, 0.5f, 0.3f));
-				}
-				else if (b->GetType() == cb2_staticBody)
-				{
-					DrawShape(f, xf, cb2Color(0.5f, 0.9f, 0.5f));
-				}
-				else if (b->GetType() == cb2_kinematicBody)
-				{
-					DrawShape(f, xf, cb2Color(0.5f, 0.5f, 0.9f));
-				}
-				else if (b->IsAwake() == false)
+				cb2Joint* joint = map.Find(je->joint);
+				cb2JointEdge* edge = je == &je->joint->m_edgeA ? &joint->m_edgeA : &joint->m_edgeB;
+				edge->prev = prevEdge;
+				if (prevEdge)
 				{
-					DrawShape(f, xf, cb2Color(0.6f, 0.6f, 0.6f));
+					prevEdge->next = edge;
 				}
 				else
 				{
-					DrawShape(f, xf, cb2Color(0.9f, 0.7f, 0.7f));
+					map.Find(b)->m_jointList = edge;
 				}
+				prevEdge = edge;
 			}
 		}
 	}
 
-	if (flags & cb2Draw::e_jointBit)
+	// Contacts are inserted at the head of the lists, so they are copied from the last
+	// in the list to the first.
+	int contactCount = m_contactManager.m_contactCount;
+	cb2Contact** contacts = (cb2Contact**)cb2Alloc(cb2Max(2 * contactCount, 1) * sizeof(cb2Contact*));
+	cb2Contact** contactCopies = contacts + contactCount;
+	int contactIndex = 0;
+	for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
 	{
-		for (cb2Joint* j = m_jointList; j; j = j->GetNext())
+		contacts[contactIndex++] = c;
+	}
+
+	for (int i = contactCount - 1; i >= 0; --i)
+	{
+		const cb2Contact* c = contacts[i];
+		cb2Contact* contact = contactManager->RestoreContact(map.Find(c->m_fixtureA), c->m_indexA,
+			map.Find(c->m_fixtureB), c->m_indexB);
+		cb2Assert(contact != NULL);
+		contact->m_flags = c->m_flags;
+		contact->m_manifold = c->m_manifold;
+		contact->m_toiCount = c->m_toiCount;
+		contact->m_toi = c->m_toi;
+		contact->m_toiKey = c->m_toiKey;
+		contact->m_simplexCache = c->m_simplexCache;
+		contact->m_speculativeDistance = c->m_speculativeDistance;
+		contact->m_friction = c->m_friction;
+		contact->m_restitution = c->m_restitution;
+		contact->m_tangentSpeed = c->m_tangentSpeed;
+		contactCopies[i] = contact;
+	}
+
+	// The contact array and the awake contacts in the same order.
+	if (contactManager->IsContiguous())
+	{
+		for (int i = 0; i < contactCount; ++i)
 		{
-			DrawJoint(j);
+			int index = contacts[i]->m_arrayIndex;
+			contactManager->m_contactArray[index] = contactCopies[i];
+			contactCopies[i]->m_arrayIndex = index;
 		}
 	}
 
-	if (flags & cb2Draw::e_pairBit)
+	if (contactManager->HasAwakeContacts())
 	{
-		cb2Color color(0.3f, 0.9f, 0.9f);
-		for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->GetNext())
+		for (int i = 0; i < contactCount; ++i)
 		{
-			//cb2Fixture* fixtureA = c->GetFixtureA();
-			//cb2Fixture* fixtureB = c->GetFixtureB();
-
-			//ci::Vec2f cA = fixtureA->GetAABB().GetCenter();
-			//ci::Vec2f cB = fixtureB->GetAABB().GetCenter();
+			contactCopies[i]->m_awakeIndex = -1;
+		}
+		contactManager->m_awakeContactCount = 0;
 
-			//g_debugDraw->DrawSegment(cA, cB, color);
+		cb2CloneMap contactMap((const void* const*)contacts, (void* const*)contactCopies, contactCount);
+		for (int i = 0; i < m_contactManager.m_awakeContactCount; ++i)
+		{
+			contactManager->AddAwakeContact(contactMap.Find(m_contactManager.m_awakeContacts[i]));
 		}
 	}
+	cb2Free(contacts);
 
-	if (flags & cb2Draw::e_aabbBit)
+	// New contacts wake their bodies, so the flags are copied again.
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
 	{
-		cb2Color color(0.9f, 0.3f, 0.9f);
-		cb2BroadPhase* bp = &m_contactManager.m_broadPhase;
+		cb2Body* body = map.Find(b);
+		body->m_flags = b->m_flags & ~cb2Body::e_islandFlag;
+		body->m_sleepTime = b->m_sleepTime;
+	}
 
-		for (cb2Body* b = m_bodyList; b; b = b->GetNext())
+	if (m_awakeBodies != NULL)
+	{
+		for (cb2Body* b = world->m_bodyList; b; b = b->m_next)
 		{
-			if (b->IsActive() == false)
-			{
-				continue;
-			}
+			b->m_awakeIndex = -1;
+		}
+		world->m_awakeBodyCount = 0;
 
-			for (cb2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
-			{
-				for (int i = 0; i < f->m_proxyCount; ++i)
-				{
-					cb2FixtureProxy* proxy = f->m_proxies + i;
-					cb2AABB aabb = bp->GetFatAABB(proxy->proxyId);
-					ci::Vec2f vs[4];
-					vs[0].set(aabb.lowerBound.x, aabb.lowerBound.y);
-					vs[1].set(aabb.upperBound.x, aabb.lowerBound.y);
-					vs[2].set(aabb.upperBound.x, aabb.upperBound.y);
-					vs[3].set(aabb.lowerBound.x, aabb.upperBound.y);
-
-					g_debugDraw->DrawPolygon(vs, 4, color);
-				}
-			}
+		for (int i = 0; i < m_awakeBodyCount; ++i)
+		{
+			world->AddAwakeBody(map.Find(m_awakeBodies[i]));
 		}
 	}
 
-	if (flags & cb2Draw::e_centerOfMassBit)
+	if (m_contactManager.HasImpulseCache())
 	{
-		for (cb2Body* b = m_bodyList; b; b = b->GetNext())
-		{
-			cb2Transform xf = b->GetTransform();
-			xf.p = b->GetWorldCenter();
-			g_debugDraw->DrawTransform(xf);
-		}
+		contactManager->m_impulseCache->Copy(*m_contactManager.m_impulseCache, map);
+	}
+
+	if (m_targetDrives)
+	{
+		void* mem = cb2Alloc(sizeof(cb2TargetDrives));
+		world->m_targetDrives = new (mem) cb2TargetDrives;
+		world->m_targetDrives->Copy(*m_targetDrives, map);
 	}
+
+	if (m_rayQueries)
+	{
+		void* mem = cb2Alloc(sizeof(cb2RayQueries));
+		world->m_rayQueries = new (mem) cb2RayQueries;
+		world->m_rayQueries->Copy(*m_rayQueries, map);
+	}
+
+	cb2Free(copies);
+	cb2Free(objects);
+
+	// The islands are linked again from the copied contacts.
+	world->SetPersistentIslands(m_persistentIslands);
+	world->SetQuerySnapshots(GetQuerySnapshots());
+
+	return world;
 }
 
-int cb2World::GetProxyCount() const
+// The first bytes of a world snapshot.
+const unsigned int cb2_snapshotMagic = 0x53324243;
+const int cb2_snapshotVersion = 2;
+
+// The world options a snapshot depends on.
+enum
 {
-	return m_contactManager.m_broadPhase.GetProxyCount();
-}
+	e_snapshotAwakeSets			= 0x0001,
+	e_snapshotContiguous		= 0x0002,
+	e_snapshotImpulseCache		= 0x0004
+};
 
-int cb2World::GetTreeHeight() const
+struct cb2SnapshotHeader
 {
-	return m_contactManager.m_broadPhase.GetTreeHeight();
-}
+	unsigned int magic;
+	int version;
+	int size;
+	int options;
+	int bodyCount;
+	int fixtureCount;
+	int proxyCount;
+	int jointCount;
+};
 
-int cb2World::GetTreeBalance() const
+// The saved state of a contact, read back before the contacts are created.
+struct cb2SnapshotContact
 {
-	return m_contactManager.m_broadPhase.GetTreeBalance();
-}
+	int fixtureA;
+	int indexA;
+	int fixtureB;
+	int indexB;
+	unsigned short flags;
+	cb2Manifold manifold;
+	unsigned char toiCount;
+	float toi;
+	int toiKey;
+	cb2SimplexCache simplexCache;
+	float speculativeDistance;
+	float friction;
+	float restitution;
+	float tangentSpeed;
+	int arrayIndex;
+	int awakeIndex;
+};
 
-float cb2World::GetTreeQuality() const
+int cb2World::GetSnapshotOptions() const
 {
-	return m_contactManager.m_broadPhase.GetTreeQuality();
+	int options = 0;
+	if (m_awakeBodies != NULL)
+	{
+		options |= e_snapshotAwakeSets;
+	}
+	if (m_contactManager.IsContiguous())
+	{
+		options |= e_snapshotContiguous;
+	}
+	if (m_contactManager.HasImpulseCache())
+	{
+		options |= e_snapshotImpulseCache;
+	}
+	return options;
 }
 
-void cb2World::ShiftOrigin(const ci::Vec2f& newOrigin)
+int cb2World::SaveSnapshot(void* buffer, int capacity) const
 {
-	cb2Assert((m_flags & e_locked) == 0);
-	if ((m_flags & e_locked) == e_locked)
+	if (m_persistentIslands)
 	{
-		return;
+		return 0;
 	}
 
+	// Bodies and fixtures are stored as their index in the world.
+	cb2Body** bodies = (cb2Body**)cb2Alloc(cb2Max(m_bodyCount, 1) * sizeof(cb2Body*));
+	int fixtureCount = 0;
+	int proxyCount = 0;
+	int bodyCount = 0;
 	for (cb2Body* b = m_bodyList; b; b = b->m_next)
 	{
-		b->m_xf.p -= newOrigin;
-		b->m_sweep.c0 -= newOrigin;
-		b->m_sweep.c -= newOrigin;
+		bodies[bodyCount++] = b;
+		fixtureCount += b->m_fixtureCount;
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			proxyCount += f->m_proxyCount;
+		}
+	}
+
+	cb2Fixture** fixtures = (cb2Fixture**)cb2Alloc(cb2Max(fixtureCount, 1) * sizeof(cb2Fixture*));
+	fixtureCount = 0;
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			fixtures[fixtureCount++] = f;
+		}
+	}
+
+	cb2SnapshotIndex bodyIndex((const void* const*)bodies, bodyCount);
+	cb2SnapshotIndex fixtureIndex((const void* const*)fixtures, fixtureCount);
+	cb2Free(fixtures);
+	cb2Free(bodies);
+
+	// The header is written last, when the size is known.
+	cb2SnapshotWriter writer(buffer, capacity);
+	cb2SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	writer.Write(header);
+
+	writer.Write(m_stepCount);
+	writer.Write(m_inv_dt0);
+	writer.Write(m_flags & e_newFixture);
+	writer.Write(m_stepComplete);
+
+	// The parts of fixed size come first, so a delta finds them at the same place.
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		writer.Write((unsigned short)(b->m_flags & ~cb2Body::e_islandFlag));
+		writer.Write(b->m_xf);
+		writer.Write(b->m_sweep);
+		writer.Write(b->m_linearVelocity);
+		writer.Write(b->m_angularVelocity);
+		writer.Write(b->m_force);
+		writer.Write(b->m_torque);
+		writer.Write(b->m_sleepTime);
 	}
 
 	for (cb2Joint* j = m_jointList; j; j = j->m_next)
 	{
-		j->ShiftOrigin(newOrigin);
+		j->WriteState(&writer);
 	}
 
-	m_contactManager.m_broadPhase.ShiftOrigin(newOrigin);
+	const cb2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			for (int i = 0; i < f->m_proxyCount; ++i)
+			{
+				const cb2FixtureProxy* proxy = f->m_proxies + i;
+				writer.Write(proxy->aabb);
+				writer.Write(broadPhase->GetFatAABB(proxy->proxyId));
+			}
+		}
+	}
+
+	writer.Write(broadPhase->GetMoveCount());
+	writer.WriteBytes(broadPhase->GetMoveBuffer(), broadPhase->GetMoveCount() * sizeof(int));
+
+	if (m_awakeBodies != NULL)
+	{
+		writer.Write(m_awakeBodyCount);
+		for (int i = 0; i < m_awakeBodyCount; ++i)
+		{
+			writer.Write(bodyIndex.Find(m_awakeBodies[i]));
+		}
+	}
+
+	// Contacts in list order. The awake contacts refer to their place in the list.
+	writer.Write(m_contactManager.m_contactCount);
+	for (cb2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+	{
+		writer.Write(fixtureIndex.Find(c->m_fixtureA));
+		writer.Write(c->m_indexA);
+		writer.Write(fixtureIndex.Find(c->m_fixtureB));
+		writer.Write(c->m_indexB);
+		writer.Write(c->m_flags);
+		writer.Write(c->m_manifold);
+		writer.Write(c->m_toiCount);
+		writer.Write(c->m_toi);
+		writer.Write(c->m_toiKey);
+		writer.Write(c->m_simplexCache);
+		writer.Write(c->m_speculativeDistance);
+		writer.Write(c->m_friction);
+		writer.Write(c->m_restitution);
+		writer.Write(c->m_tangentSpeed);
+		writer.Write(c->m_arrayIndex);
+		writer.Write(c->m_awakeIndex);
+	}
+
+	if (m_contactManager.HasImpulseCache())
+	{
+		m_contactManager.m_impulseCache->WriteState(&writer, bodyIndex);
+	}
+
+	header.magic = cb2_snapshotMagic;
+	header.version = cb2_snapshotVersion;
+	header.size = writer.GetSize();
+	header.options = GetSnapshotOptions();
+	header.bodyCount = m_bodyCount;
+	header.fixtureCount = fixtureCount;
+	header.proxyCount = proxyCount;
+	header.jointCount = m_jointCount;
+	if (writer.IsComplete())
+	{
+		memcpy(buffer, &header, sizeof(header));
+	}
+
+	return writer.GetSize();
 }
 
-void cb2World::Dump()
+bool cb2World::RestoreSnapshot(const void* buffer, int size)
 {
-	if ((m_flags & e_locked) == e_locked)
+	cb2Assert(IsLocked() == false);
+	if (IsLocked() || m_persistentIslands || buffer == NULL || size < (int)sizeof(cb2SnapshotHeader))
 	{
-		return;
+		return false;
 	}
 
-	cb2Log("ci::Vec2f g(%.15lef, %.15lef);\n", m_gravity.x, m_gravity.y);
-	cb2Log("m_world->SetGravity(g);\n");
+	cb2SnapshotReader reader(buffer, size);
+	cb2SnapshotHeader header;
+	reader.Read(&header);
 
-	cb2Log("cb2Body** bodies = (cb2Body**)cb2Alloc(%d * sizeof(cb2Body*));\n", m_bodyCount);
-	cb2Log("cb2Joint** joints = (cb2Joint**)cb2Alloc(%d * sizeof(cb2Joint*));\n", m_jointCount);
-	int i = 0;
+	int fixtureCount = 0;
+	int proxyCount = 0;
 	for (cb2Body* b = m_bodyList; b; b = b->m_next)
 	{
-		b->m_islandIndex = i;
-		b->Dump();
-		++i;
+		fixtureCount += b->m_fixtureCount;
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			proxyCount += f->m_proxyCount;
+		}
 	}
 
-	i = 0;
-	for (cb2Joint* j = m_jointList; j; j = j->m_next)
+	// The snapshot must come from this world, or from one built the same way.
+	if (header.magic != cb2_snapshotMagic || header.version != cb2_snapshotVersion || header.size != size ||
+		header.options != GetSnapshotOptions() || header.bodyCount != m_bodyCount ||
+		header.fixtureCount != fixtureCount || header.proxyCount != proxyCount || header.jointCount != m_jointCount)
 	{
-		j->m_index = i;
-		++i;
+		return false;
 	}
 
-	// First pass on joints, skip gear joints.
-	for (cb2Joint* j = m_jointList; j; j = j->m_next)
+	cb2Body** bodies = (cb2Body**)m_stackAllocator->Allocate(m_bodyCount * sizeof(cb2Body*));
+	cb2Fixture** fixtures = (cb2Fixture**)m_stackAllocator->Allocate(fixtureCount * sizeof(cb2Fixture*));
+	float* sleepTimes = (float*)m_stackAllocator->Allocate(m_bodyCount * sizeof(float));
+	unsigned short* bodyFlags = (unsigned short*)m_stackAllocator->Allocate(m_bodyCount * sizeof(unsigned short));
+	int bodyCount = 0;
+	fixtureCount = 0;
+	for (cb2Body* b = m_bodyList; b; b = b->m_next)
 	{
-		if (j->m_type == e_gearJoint)
+		bodies[bodyCount++] = b;
+		for (cb2Fixture* f = b->m_fixtureList; f; f = f->m_next)
 		{
-			continue;
+			fixtures[fixtureCount++] = f;
 		}
+	}
 
-		cb2Log("{\n");
-		j->Dump();
-		cb2Log("}\n");
+	// The contacts are rebuilt from the snapshot, without listener callbacks.
+	m_contactManager.Clear();
+
+	reader.Read(&m_stepCount);
+	reader.Read(&m_inv_dt0);
+	int newFixture = reader.Read<int>();
+	m_flags = (m_flags & ~e_newFixture) | (newFixture & e_newFixture);
+	reader.Read(&m_stepComplete);
+
+	for (int i = 0; i < m_bodyCount; ++i)
+	{
+		cb2Body* b = bodies[i];
+		reader.Read(bodyFlags + i);
+		reader.Read(&b->m_xf);
+		reader.Read(&b->m_sweep);
+		reader.Read(&b->m_linearVelocity);
+		reader.Read(&b->m_angularVelocity);
+		reader.Read(&b->m_force);
+		reader.Read(&b->m_torque);
+		reader.Read(sleepTimes + i);
 	}
 
-	// Second pass on joints, only gear joints.
 	for (cb2Joint* j = m_jointList; j; j = j->m_next)
 	{
-		if (j->m_type != e_gearJoint)
+		j->ReadState(&reader);
+	}
+
+	cb2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	for (int i = 0; i < fixtureCount; ++i)
+	{
+		cb2Fixture* f = fixtures[i];
+		for (int k = 0; k < f->m_proxyCount; ++k)
 		{
-			continue;
+			cb2FixtureProxy* proxy = f->m_proxies + k;
+			reader.Read(&proxy->aabb);
+			cb2AABB fatAABB = reader.Read<cb2AABB>();
+			if (memcmp(&fatAABB, &broadPhase->GetFatAABB(proxy->proxyId), sizeof(cb2AABB)) != 0)
+			{
+				broadPhase->SetFatAABB(proxy->proxyId, fatAABB);
+			}
 		}
+	}
 
-		cb2Log("{\n");
-		j->Dump();
-		cb2Log("}\n");
+	int moveCount = reader.Read<int>();
+	if (moveCount < 0 || moveCount > (size - reader.GetOffset()) / (int)sizeof(int))
+	{
+		reader.SetFailed();
+		moveCount = 0;
+	}
+	int* moveBuffer = (int*)m_stackAllocator->Allocate(moveCount * sizeof(int));
+	reader.ReadBytes(moveBuffer, moveCount * sizeof(int));
+	broadPhase->SetMoveBuffer(moveBuffer, reader.HasFailed() ? 0 : moveCount);
+	m_stackAllocator->Free(moveBuffer);
+
+	int awakeBodyCount = 0;
+	int* awakeBodies = NULL;
+	if (m_awakeBodies != NULL)
+	{
+		awakeBodyCount = reader.Read<int>();
+		if (awakeBodyCount < 0 || awakeBodyCount > m_bodyCount)
+		{
+			reader.SetFailed();
+			awakeBodyCount = 0;
+		}
+		awakeBodies = (int*)m_stackAllocator->Allocate(awakeBodyCount * sizeof(int));
+		reader.ReadBytes(awakeBodies, awakeBodyCount * sizeof(int));
 	}
 
-	cb2Log("cb2Free(joints);\n");
-	cb2Log("cb2Free(bodies);\n");
-	cb2Log("joints = NULL;\n");
-	cb2Log("bodies = NULL;\n");
+	// All contacts are read before any is created, so a damaged snapshot leaves none behind.
+	int contactCount = reader.Read<int>();
+	if (contactCount < 0 || contactCount > (size - reader.GetOffset()) / (int)(4 * sizeof(int)))
+	{
+		reader.SetFailed();
+		contactCount = 0;
+	}
+
+	cb2Contact** contacts = (cb2Contact**)m_stackAllocator->Allocate(contactCount * sizeof(cb2Contact*));
+	cb2SnapshotContact* records = (cb2SnapshotContact*)m_stackAllocator->Allocate(contactCount * sizeof(cb2SnapshotContact));
+	for (int i = 0; i < contactCount; ++i)
+	{
+		cb2SnapshotContact* record = records + i;
+		reader.Read(&record->fixtureA);
+		reader.Read(&record->indexA);
+		reader.Read(&record->fixtureB);
+		reader.Read(&record->indexB);
+		reader.Read(&record->flags);
+		reader.Read(&record->manifold);
+		reader.Read(&record->toiCount);
+		reader.Read(&record->toi);
+		reader.Read(&record->toiKey);
+		reader.Read(&record->simplexCache);
+		reader.Read(&record->speculativeDistance);
+		reader.Read(&record->friction);
+		reader.Read(&record->restitution);
+		reader.Read(&record->tangentSpeed);
+		reader.Read(&record->arrayIndex);
+		reader.Read(&record->awakeIndex);
+		contacts[i] = NULL;
+
+		if (record->fixtureA < 0 || record->fixtureA >= fixtureCount ||
+			record->fixtureB < 0 || record->fixtureB >= fixtureCount ||
+			record->indexA < 0 || record->indexA >= fixtures[record->fixtureA]->m_shape->GetChildCount() ||
+			record->indexB < 0 || record->indexB >= fixtures[record->fixtureB]->m_shape->GetChildCount())
+		{
+			reader.SetFailed();
+		}
+	}
+
+	// Contacts are inserted at the head of the lists, so they are created from the
+	// last one saved to the first to get the saved list order back.
+	bool valid = reader.HasFailed() == false;
+	for (int i = contactCount - 1; i >= 0 && valid; --i)
+	{
+		const cb2SnapshotContact* record = records + i;
+		cb2Contact* c = m_contactManager.RestoreContact(fixtures[record->fixtureA], record->indexA,
+			fixtures[record->fixtureB], record->indexB);
+		if (c == NULL)
+		{
+			valid = false;
+			break;
+		}
+
+		c->m_flags = record->flags;
+		c->m_manifold = record->manifold;
+		c->m_toiCount = record->toiCount;
+		c->m_toi = record->toi;
+		c->m_toiKey = record->toiKey;
+		c->m_simplexCache = record->simplexCache;
+		c->m_speculativeDistance = record->speculativeDistance;
+		c->m_friction = record->friction;
+		c->m_restitution = record->restitution;
+		c->m_tangentSpeed = record->tangentSpeed;
+		contacts[i] = c;
+	}
+
+	if (valid && m_contactManager.IsContiguous())
+	{
+		// Put the contact array back in the saved order.
+		cb2Contact** contactArray = m_contactManager.m_contactArray;
+		for (int i = 0; i < contactCount; ++i)
+		{
+			contactArray[i] = NULL;
+		}
+
+		for (int i = 0; i < contactCount; ++i)
+		{
+			int index = records[i].arrayIndex;
+			if (index < 0 || index >= contactCount || contactArray[index] != NULL)
+			{
+				valid = false;
+				break;
+			}
+			contactArray[index] = contacts[i];
+			contacts[i]->m_arrayIndex = index;
+		}
+
+		if (valid == false)
+		{
+			for (int i = 0; i < contactCount; ++i)
+			{
+				contactArray[i] = contacts[i];
+				contacts[i]->m_arrayIndex = i;
+			}
+		}
+	}
+
+	if (valid && m_contactManager.HasAwakeContacts())
+	{
+		// Rebuild the awake contact set in the saved order.
+		int awakeContactCount = 0;
+		for (int i = 0; i < contactCount; ++i)
+		{
+			contacts[i]->m_awakeIndex = -1;
+			if (records[i].awakeIndex != -1)
+			{
+				++awakeContactCount;
+			}
+		}
+		m_contactManager.m_awakeContactCount = 0;
+
+		int* awakeOrder = (int*)m_stackAllocator->Allocate(awakeContactCount * sizeof(int));
+		for (int i = 0; i < awakeContactCount; ++i)
+		{
+			awakeOrder[i] = -1;
+		}
+
+		for (int i = 0; i < contactCount; ++i)
+		{
+			int index = records[i].awakeIndex;
+			if (index == -1)
+			{
+				continue;
+			}
+
+			if (index < 0 || index >= awakeContactCount || awakeOrder[index] != -1)
+			{
+				valid = false;
+				continue;
+			}
+			awakeOrder[index] = i;
+		}
+
+		for (int i = 0; i < awakeContactCount; ++i)
+		{
+			if (awakeOrder[i] != -1)
+			{
+				m_contactManager.AddAwakeContact(contacts[awakeOrder[i]]);
+			}
+		}
+		m_stackAllocator->Free(awakeOrder);
+	}
+
+	m_stackAllocator->Free(records);
+	m_stackAllocator->Free(contacts);
+
+	// New contacts wake their bodies, so the saved flags are applied last.
+	for (int i = 0; i < m_bodyCount; ++i)
+	{
+		cb2Body* b = bodies[i];
+		b->m_flags = (b->m_flags & cb2Body::e_islandFlag) | (bodyFlags[i] & ~cb2Body::e_islandFlag);
+		b->m_sleepTime = sleepTimes[i];
+	}
+
+	if (m_awakeBodies != NULL)
+	{
+		for (int i = 0; i < m_bodyCount; ++i)
+		{
+			bodies[i]->m_awakeIndex = -1;
+		}
+		m_awakeBodyCount = 0;
+
+		for (int i = 0; i < awakeBodyCount; ++i)
+		{
+			int index = awakeBodies[i];
+			if (index < 0 || index >= m_bodyCount || bodies[index]->m_awakeIndex != -1)
+			{
+				valid = false;
+				continue;
+			}
+			AddAwakeBody(bodies[index]);
+		}
+		m_stackAllocator->Free(awakeBodies);
+	}
+
+	if (m_contactManager.HasImpulseCache())
+	{
+		m_contactManager.m_impulseCache->ReadState(&reader, bodies, m_bodyCount);
+	}
+
+	m_stackAllocator->Free(bodyFlags);
+	m_stackAllocator->Free(sleepTimes);
+	m_stackAllocator->Free(fixtures);
+	m_stackAllocator->Free(bodies);
+
+	return valid && reader.HasFailed() == false && reader.GetOffset() == size;
 }
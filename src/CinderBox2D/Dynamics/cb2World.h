@@ -22,18 +22,190 @@
 #include <CinderBox2D/Common/cb2Math.h>
 #include <CinderBox2D/Common/cb2BlockAllocator.h>
 #include <CinderBox2D/Common/cb2StackAllocator.h>
+#include <CinderBox2D/Common/cb2Timer.h>
 #include <CinderBox2D/Dynamics/cb2ContactManager.h>
+#include <CinderBox2D/Dynamics/cb2IslandGraph.h>
+#include <CinderBox2D/Dynamics/cb2TOIScheduler.h>
 #include <CinderBox2D/Dynamics/cb2WorldCallbacks.h>
 #include <CinderBox2D/Dynamics/cb2TimeStep.h>
+#include <CinderBox2D/Dynamics/cb2ProfileStats.h>
+#include <CinderBox2D/Dynamics/cb2MemoryStats.h>
+#include <atomic>
 
 struct cb2AABB;
 struct cb2BodyDef;
 struct cb2Color;
 struct cb2JointDef;
+struct cb2ParticleSystemDef;
+struct cb2RayCastInput;
 class cb2Body;
+class cb2CommandBuffer;
+class cb2ContactEvents;
 class cb2Draw;
 class cb2Fixture;
 class cb2Joint;
+class cb2MaterialTable;
+class cb2ParticleSystem;
+class cb2Profiler;
+class cb2SensorManager;
+class cb2StepThread;
+class cb2TargetDrives;
+struct cb2TargetDriveDef;
+class cb2QuerySnapshot;
+class cb2RayQueries;
+class cb2Shape;
+class cb2ThreadPool;
+
+/// A fixture found by a batched query, with the index of the query box and the
+/// child of the fixture whose proxy was hit.
+struct cb2QueryHit
+{
+	int queryIndex;
+	cb2Fixture* fixture;
+	int childIndex;
+};
+
+/// The transforms of a body before and after a step, see cb2World::SetTransformBuffer.
+struct cb2BodyTransform
+{
+	int id;					///< cb2Body::GetId
+	cb2Transform previous;
+	cb2Transform current;
+};
+
+/// The state of a body at the end of a step, see cb2World::GetBodyStates.
+struct cb2BodyState
+{
+	cb2Transform transform;
+	ci::Vec2f linearVelocity;
+	float angularVelocity;
+	bool awake;
+};
+
+/// The pose and velocity of a kinematic body, see cb2World::SetKinematicStates.
+struct cb2KinematicState
+{
+	cb2Body* body;
+	ci::Vec2f position;		///< the world position of the body origin
+	float angle;			///< the world rotation in radians
+	ci::Vec2f linearVelocity;
+	float angularVelocity;
+};
+
+/// The kinds of cb2BodyCommand.
+enum cb2BodyCommandType
+{
+	cb2_applyForceCommand,			///< force at point
+	cb2_applyForceToCenterCommand,	///< force
+	cb2_applyTorqueCommand,			///< value
+	cb2_applyLinearImpulseCommand,	///< impulse at point
+	cb2_applyAngularImpulseCommand,	///< value
+	cb2_setLinearVelocityCommand,	///< vector
+	cb2_setAngularVelocityCommand,	///< value
+	cb2_setTransformCommand,		///< position point and angle value
+	cb2_setAwakeCommand,			///< wake
+	cb2_destroyBodyCommand
+};
+
+/// A change to a body queued with cb2World::QueueCommand and made at the next step.
+struct cb2BodyCommand
+{
+	cb2BodyCommandType type;
+	cb2Body* body;
+	ci::Vec2f vector;
+	ci::Vec2f point;
+	float value;
+	bool wake;
+};
+
+/// The hits reported by a batched ray cast.
+enum cb2RayCastMode
+{
+	cb2_rayCastClosest,
+	cb2_rayCastAny,
+	cb2_rayCastAll
+};
+
+/// A fixture hit by a batched ray cast, with the index of the ray.
+struct cb2RayCastHit
+{
+	int rayIndex;
+	cb2Fixture* fixture;
+	ci::Vec2f point;
+	ci::Vec2f normal;
+	float fraction;
+};
+
+/// A shape swept through the world by ShapeCastBatch. The shape moves from
+/// transform to transform.p + maxFraction * translation without rotating.
+struct cb2ShapeCastInput
+{
+	const cb2Shape* shape;
+	int childIndex;
+	cb2Transform transform;
+	ci::Vec2f translation;
+	float maxFraction;
+};
+
+/// A shape placed in the world by OverlapShapes.
+struct cb2ShapeOverlapInput
+{
+	const cb2Shape* shape;
+	int childIndex;
+	cb2Transform transform;
+};
+
+/// A fixture hit by a batched shape cast, with the index of the cast. The point is on
+/// the fixture and the normal is the fixture surface normal, towards the cast shape.
+struct cb2ShapeCastHit
+{
+	int castIndex;
+	cb2Fixture* fixture;
+	ci::Vec2f point;
+	ci::Vec2f normal;
+	float fraction;
+};
+
+/// A fixture found by cb2World::QueryClosest. The point is the closest point of the
+/// fixture child, including the radius of the shape.
+struct cb2ClosestFixture
+{
+	cb2Fixture* fixture;
+	int childIndex;
+	ci::Vec2f point;
+	float distance;
+};
+
+/// A level of detail of the simulation, see cb2World::SetLodLevels. An island at this
+/// level is solved with at most these iterations, every few steps with a longer time
+/// step, and optionally without continuous collision.
+struct cb2LodLevel
+{
+	cb2LodLevel()
+	{
+		distance = 0.0f;
+		velocityIterations = 8;
+		positionIterations = 3;
+		stepInterval = 1;
+		continuous = true;
+	}
+
+	/// Bodies at least this far from the nearest observer use this level.
+	float distance;
+
+	/// The most velocity iterations, and substeps of the soft step solver.
+	int velocityIterations;
+
+	/// The most position iterations.
+	int positionIterations;
+
+	/// The island is solved once every this many steps, with a time step this many
+	/// times longer. Islands are spread over the steps by the id of their first body.
+	int stepInterval;
+
+	/// Do the bodies take part in continuous collision? Fast bodies may then tunnel.
+	bool continuous;
+};
 
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
@@ -61,6 +233,23 @@ public:
 	/// remain in scope.
 	void SetContactListener(cb2ContactListener* listener);
 
+	/// Compute the contact manifolds with your own backend, such as a compute device,
+	/// or pass NULL for the CPU path. A backend may decline any batch, which is then
+	/// collided on the CPU. The backend is owned by you and must remain in scope.
+	void SetCollideBackend(cb2CollideBackend* backend);
+	cb2CollideBackend* GetCollideBackend() const;
+
+	/// Only call PostSolve for contacts whose largest normal impulse reached this, in
+	/// newton-seconds. Zero reports every contact, which is the default. Contacts of
+	/// fixtures that clear cb2FixtureDef::reportPostSolve are skipped regardless.
+	void SetPostSolveThreshold(float impulse) { cb2Assert(impulse >= 0.0f); m_postSolveThreshold = impulse; }
+	float GetPostSolveThreshold() const { return m_postSolveThreshold; }
+
+	/// Register a profiler that receives the zones and counters of each step.
+	/// The profiler is owned by you and must remain in scope.
+	void SetProfiler(cb2Profiler* profiler);
+	cb2Profiler* GetProfiler() const { return m_profiler; }
+
 	/// Register a routine for debug drawing. The debug draw functions are called
 	/// inside with cb2World::DrawDebugData method. The debug draw object is owned
 	/// by you and must remain in scope.
@@ -71,6 +260,16 @@ public:
 	/// @warning This function is locked during callbacks.
 	cb2Body* CreateBody(const cb2BodyDef* def);
 
+	/// Create many bodies and their fixtures at once, for level loading and procedural
+	/// content. The bodies and the fixtures are allocated next to each other, the mass of
+	/// each body is computed once, and the broad-phase tree is built once for all the new
+	/// proxies, as in BeginBulkLoad. Body i gets the next fixtureCounts[i] fixtures of
+	/// fixtureDefs; pass NULL counts for one fixture per body, and NULL fixtureDefs for none.
+	/// @param bodies receives the new bodies, unless NULL.
+	/// @warning This function is locked during callbacks.
+	void CreateBodies(const cb2BodyDef* bodyDefs, int bodyCount, const cb2FixtureDef* fixtureDefs,
+					  const int* fixtureCounts, cb2Body** bodies);
+
 	/// Destroy a rigid body given a definition. No reference to the definition
 	/// is retained. This function is locked during callbacks.
 	/// @warning This automatically deletes all associated shapes and joints.
@@ -86,6 +285,23 @@ public:
 	/// @warning This function is locked during callbacks.
 	void DestroyJoint(cb2Joint* joint);
 
+	/// Create a particle system, stepped after the bodies in each time step.
+	/// No reference to the definition is retained.
+	/// @warning This function is locked during callbacks.
+	cb2ParticleSystem* CreateParticleSystem(const cb2ParticleSystemDef* def);
+
+	/// Destroy a particle system and all of its particles.
+	/// @warning This function is locked during callbacks.
+	void DestroyParticleSystem(cb2ParticleSystem* system);
+
+	/// Preallocate memory for the expected numbers of objects, typically at level load,
+	/// so that creating them and stepping do not allocate. Shapes are reserved at
+	/// polygon size, contacts at polygon contact size and joints at revolute joint size.
+	/// The step stack is sized from an estimate of the island and solver memory.
+	/// @param proxyCount the number of broad-phase proxies, one per child of each fixture.
+	/// @warning This function is locked during callbacks.
+	void Reserve(int bodyCount, int fixtureCount, int proxyCount, int contactCount, int jointCount);
+
 	/// Take a time step. This performs collision detection, integration,
 	/// and constraint solution.
 	/// @param timeStep the amount of time to simulate, this should not vary.
@@ -95,6 +311,64 @@ public:
 				int velocityIterations,
 				int positionIterations);
 
+	/// Set the fixed time step run by Advance.
+	/// @param maxSteps the most steps one call to Advance runs. Elapsed time beyond
+	/// that is dropped, so a slow frame cannot make the next one slower still.
+	void SetFixedStep(float timeStep, int velocityIterations, int positionIterations, int maxSteps);
+	float GetFixedTimeStep() const { return m_fixedTimeStep; }
+
+	/// Simulate the elapsed frame time with as many fixed steps as fit, see SetFixedStep.
+	/// The time left over is kept for the next call. The forces are applied over all the
+	/// steps and cleared after them when auto clear is enabled. Returns the number of
+	/// steps run.
+	int Advance(float elapsed);
+
+	/// Get how far the time left over by Advance is into the next step, in [0,1).
+	/// Draw a body at cb2Body::GetInterpolatedTransform of this to hide the steps.
+	float GetInterpolationAlpha() const { return m_fixedTimeStep > 0.0f ? m_accumulator / m_fixedTimeStep : 0.0f; }
+
+	/// Start a time step on a thread of the world and return at once, so the step runs
+	/// beside the caller. Until WaitStep returns, only GetBodyStates, QueueCommand,
+	/// SubmitCommands and IsStepDone may be called; the bodies themselves are being changed.
+	/// Listeners are called on the step thread. The queued commands and the submitted
+	/// command buffers are made before the step starts.
+	void StepAsync(float timeStep, int velocityIterations, int positionIterations);
+
+	/// Is the step started by StepAsync finished? WaitStep must still be called.
+	bool IsStepDone() const;
+
+	/// Wait for the step started by StepAsync. This returns at once when no step runs.
+	void WaitStep();
+
+	/// Get the state of the bodies at the end of the last step run by StepAsync, indexed
+	/// by cb2Body::GetId. These can be read while the next step runs; it fills the other
+	/// buffer, and WaitStep swaps the two. Entries of ids that were free at the end of
+	/// that step or are out of the count are meaningless.
+	const cb2BodyState* GetBodyStates() const { return m_bodyStates[m_frontBodyStates]; }
+	int GetBodyStateCount() const { return m_bodyStateCount[m_frontBodyStates]; }
+
+	/// Queue a change to a body, made at the start of the next step in the order queued.
+	/// This can be called while a step started by StepAsync runs, from the thread that
+	/// started it. Bodies destroyed by a command must not be used in later commands.
+	void QueueCommand(const cb2BodyCommand& command);
+
+	/// Set the transforms and velocities of many kinematic bodies, as cb2Body::SetTransform,
+	/// SetLinearVelocity and SetAngularVelocity would one by one. The proxies are moved
+	/// together afterwards, refitting the dynamic tree instead of reinserting each proxy
+	/// that left its fat AABB, see cb2BroadPhase::MoveProxies. New pairs are found by the
+	/// next step, as after SetTransform.
+	/// @warning this should be called outside of a time step.
+	void SetKinematicStates(const cb2KinematicState* states, int count);
+
+	/// Get the number of commands queued for the next step.
+	int GetCommandCount() const { return m_commandCount; }
+
+	/// Apply a command buffer at the start of the next step, after the queued commands.
+	/// Buffers are applied in the order submitted. This can be called while a step started
+	/// by StepAsync runs, from the thread that started it. The buffer is owned by you and
+	/// must remain in scope until it was applied.
+	void SubmitCommands(cb2CommandBuffer* buffer);
+
 	/// Manually clear the force buffer on all bodies. By default, forces are cleared automatically
 	/// after each call to Step. The default behavior is modified by calling SetAutoClearForces.
 	/// The purpose of this function is to support sub-stepping. Sub-stepping is often used to maintain
@@ -113,6 +387,16 @@ public:
 	/// @param aabb the query box.
 	void QueryAABB(cb2QueryCallback* callback, const cb2AABB& aabb) const;
 
+	/// Query the world with many AABBs at once. The hits are written to a flat array
+	/// without virtual calls. Queries are sorted by location and nearby boxes traverse
+	/// the tree together, so hits are grouped by neighborhood, not by query index.
+	/// @param aabbs the query boxes.
+	/// @param count the number of query boxes.
+	/// @param hits receives the fixtures that potentially overlap each box.
+	/// @param maxHits the capacity of hits.
+	/// @return the number of hits written. The batch stops early when hits is full.
+	int QueryAABBs(const cb2AABB* aabbs, int count, cb2QueryHit* hits, int maxHits) const;
+
 	/// Ray-cast the world for all fixtures in the path of the ray. Your callback
 	/// controls whether you get the closest point, any point, or n-points.
 	/// The ray-cast ignores shapes that contain the starting point.
@@ -121,6 +405,90 @@ public:
 	/// @param point2 the ray ending point
 	void RayCast(cb2RayCastCallback* callback, const ci::Vec2f& point1, const ci::Vec2f& point2) const;
 
+	/// Ray-cast the world with many segments at once. Rays are sorted by location and
+	/// traverse the tree in packets of four with SIMD slab tests. The ray-cast ignores
+	/// shapes that contain the starting point, as RayCast does.
+	/// @param rays the segments, each from p1 to p1 + maxFraction * (p2 - p1).
+	/// @param count the number of rays.
+	/// @param mode cb2_rayCastClosest and cb2_rayCastAny give at most one hit per ray, in ray order.
+	/// cb2_rayCastAll gives every hit, grouped by neighborhood.
+	/// @param hits receives the hits.
+	/// @param maxHits the capacity of hits.
+	/// @return the number of hits written.
+	int RayCastBatch(const cb2RayCastInput* rays, int count, cb2RayCastMode mode, cb2RayCastHit* hits, int maxHits) const;
+
+	/// Sweep many shapes through the world at once. Each cast queries the broad-phase with
+	/// its swept AABB and runs cb2ShapeCast against the candidate fixtures. The shape cast
+	/// ignores fixtures that the shape overlaps at the start, as RayCast does.
+	/// @param casts the swept shapes.
+	/// @param count the number of casts.
+	/// @param mode cb2_rayCastClosest and cb2_rayCastAny give at most one hit per cast, in cast order.
+	/// cb2_rayCastAll gives every hit, grouped by neighborhood.
+	/// @param hits receives the hits.
+	/// @param maxHits the capacity of hits.
+	/// @return the number of hits written.
+	int ShapeCastBatch(const cb2ShapeCastInput* casts, int count, cb2RayCastMode mode, cb2ShapeCastHit* hits, int maxHits) const;
+
+	/// Find the fixtures that overlap many shapes at once. Each shape queries the broad-phase
+	/// with its AABB and is tested against the candidate fixtures with cb2TestOverlap, which
+	/// has fast paths for circles and polygons. The distance proxy of each shape is built once.
+	/// @param shapes the placed shapes.
+	/// @param count the number of shapes.
+	/// @param hits receives the overlapping fixture children, with the shape index as the
+	/// query index. Hits are grouped by neighborhood, as in QueryAABBs.
+	/// @param maxHits the capacity of hits.
+	/// @return the number of hits written. The batch stops early when hits is full.
+	int OverlapShapes(const cb2ShapeOverlapInput* shapes, int count, cb2QueryHit* hits, int maxHits) const;
+
+	/// Find the fixtures closest to a point. The broad-phase trees are traversed nearest box
+	/// first and the exact distances of cb2Distance shrink the search as closer fixtures are
+	/// found, so usually only a few fixtures are tested. Fixtures that contain the point have
+	/// distance zero.
+	/// @param point the query point.
+	/// @param maxDistance the search radius. Use cb2_maxFloat for no limit, which is not
+	/// supported by the spatial hash and the sweep and prune broad-phases.
+	/// @param hits receives the closest fixture children, nearest first.
+	/// @param maxHits the number of fixtures to find.
+	/// @return the number of hits written.
+	int QueryClosest(const ci::Vec2f& point, float maxDistance, cb2ClosestFixture* hits, int maxHits) const;
+
+	/// Find the fixture closest to a point, see QueryClosest.
+	/// @return false if no fixture is within maxDistance.
+	bool QueryClosest(const ci::Vec2f& point, float maxDistance, cb2ClosestFixture* hit) const;
+
+	/// Create a persistent ray for rays that are cast again every step with small changes,
+	/// such as the whiskers of a vehicle. The ray remembers the fixture it hit last time.
+	/// Returns the handle of the ray.
+	int CreateRayQuery();
+
+	/// Destroy a persistent ray.
+	void DestroyRayQuery(int query);
+
+	/// Get the number of persistent rays.
+	int GetRayQueryCount() const;
+
+	/// Cast persistent rays for the closest hit, as RayCastBatch. Each ray first tests the
+	/// fixture it hit last time, so a coherent ray starts its traversal already clipped
+	/// to about the length of the new hit and skips most of the tree.
+	/// @param queries the persistent rays, from CreateRayQuery.
+	/// @param rays the segments to cast for the rays this time.
+	/// @param count the number of rays.
+	/// @param hits receives one hit per ray, in ray order. The fixture is NULL for a miss.
+	/// @return the number of rays that hit.
+	int CastRayQueries(const int* queries, const cb2RayCastInput* rays, int count, cb2RayCastHit* hits);
+
+	/// Enable/disable query snapshots. When enabled, each step ends by publishing a frozen
+	/// copy of the broad-phase trees and fixture transforms. Other threads can query it
+	/// without locks while the next step runs. Three buffers are kept, so a snapshot is only
+	/// skipped when readers still hold both older ones. Disable only when no snapshot is held.
+	void SetQuerySnapshots(bool flag);
+	bool GetQuerySnapshots() const { return m_querySnapshots[0] != NULL; }
+
+	/// Get the latest query snapshot from any thread. Returns NULL when snapshots are
+	/// disabled. The snapshot stays valid until it is given back with ReleaseQuerySnapshot.
+	const cb2QuerySnapshot* AcquireQuerySnapshot() const;
+	void ReleaseQuerySnapshot(const cb2QuerySnapshot* snapshot) const;
+
 	/// Get the world body list. With the returned body, use cb2Body::GetNext to get
 	/// the next body in the world list. A NULL body indicates the end of the list.
 	/// @return the head of the world body list.
@@ -133,6 +501,11 @@ public:
 	cb2Joint* GetJointList();
 	const cb2Joint* GetJointList() const;
 
+	/// Get the world particle system list. Use cb2ParticleSystem::GetNext to get
+	/// the next system. A NULL system indicates the end of the list.
+	cb2ParticleSystem* GetParticleSystemList() { return m_particleSystemList; }
+	const cb2ParticleSystem* GetParticleSystemList() const { return m_particleSystemList; }
+
 	/// Get the world contact list. With the returned contact, use cb2Contact::GetNext to get
 	/// the next contact in the world list. A NULL contact indicates the end of the list.
 	/// @return the head of the world contact list.
@@ -145,10 +518,84 @@ public:
 	void SetAllowSleeping(bool flag);
 	bool GetAllowSleeping() const { return m_allowSleep; }
 
+	/// Choose the solver. The soft step solver splits each step into substeps with
+	/// a single iteration each. Contacts are soft springs that push bodies apart
+	/// at a bounded speed, followed by a relaxation pass without the push. The
+	/// contact points are computed once per step and there are no contact position
+	/// iterations, so the iteration counts of Step are ignored by this solver.
+	/// Post solve impulses are those of the last substep.
+	void SetSolverType(cb2SolverType type, int subStepCount = 4);
+	cb2SolverType GetSolverType() const { return m_solverType; }
+	int GetSubStepCount() const { return m_subStepCount; }
+
+	/// Stop the velocity iterations of an island early once no constraint impulse
+	/// changed by more than this in one pass, in newton-seconds. Zero runs all
+	/// the iterations, which is the default. The passes run are in the profile.
+	void SetImpulseTolerance(float tolerance) { cb2Assert(tolerance >= 0.0f); m_impulseTolerance = tolerance; }
+	float GetImpulseTolerance() const { return m_impulseTolerance; }
+
+	/// Enable/disable joint batching. The islands sort their joints by type and run
+	/// each type with direct calls instead of virtual ones. The joints are then solved
+	/// in a different order, which changes the results slightly. Islands solved on
+	/// several threads keep their constraint colors.
+	void SetJointBatching(bool flag) { m_jointBatching = flag; }
+	bool GetJointBatching() const { return m_jointBatching; }
+
+	/// Enable/disable the spatial ordering of islands. Large islands sort their bodies
+	/// along a Morton curve of the body centers, then their contacts and joints by
+	/// their first body, so the solver reads and writes the body velocities mostly in
+	/// order. The constraints are then solved in a different order, which changes the
+	/// results slightly.
+	void SetSpatialOrdering(bool flag) { m_spatialOrdering = flag; }
+	bool GetSpatialOrdering() const { return m_spatialOrdering; }
+
+	/// Enable/disable the direct joint solver. The revolute and distance joints that
+	/// form trees are solved exactly every velocity iteration, so long chains do not
+	/// stretch. Joints that close loops, motors and limits still iterate, and so do
+	/// islands solved on several threads. The position iterations are unchanged.
+	void SetDirectJointSolver(bool flag) { m_directJointSolver = flag; }
+	bool GetDirectJointSolver() const { return m_directJointSolver; }
+
 	/// Enable/disable warm starting. For testing.
 	void SetWarmStarting(bool flag) { m_warmStarting = flag; }
 	bool GetWarmStarting() const { return m_warmStarting; }
 
+	/// Enable/disable the wide contact solver. Contacts are colored into batches
+	/// that share no body and solved four at a time with SIMD. The two points of
+	/// a manifold are solved one after the other instead of as a block.
+	void SetWideContactSolver(bool flag) { m_wideContactSolver = flag; }
+	bool GetWideContactSolver() const { return m_wideContactSolver; }
+
+	/// Enable/disable speculative contacts, a cheaper form of continuous collision.
+	/// Broad-phase proxies also cover the next step and manifold points are kept while
+	/// the shapes can still meet within the step. The solver lets such points close
+	/// their gap but not more. TOI sub-stepping is then only used for bullets.
+	/// The contact listener sees these contacts as touching up to one step early,
+	/// and restitution only acts once the shapes actually touch.
+	void SetSpeculativeContacts(bool flag);
+	bool GetSpeculativeContacts() const { return m_speculativeContacts; }
+
+	/// Enable/disable contact reduction. Between two bodies with many touching fixture
+	/// pairs, the solver only keeps the deepest contact and the two outermost contacts
+	/// along each contact normal. The other contacts report zero impulses.
+	/// This suits compound bodies such as ragdolls and tiled vehicles.
+	void SetContactReduction(bool flag) { m_contactReduction = flag; }
+	bool GetContactReduction() const { return m_contactReduction; }
+
+	/// Enable/disable early island sleep. An island whose bodies all stayed below the
+	/// sleep tolerances for a few steps skips the position iterations, and it falls
+	/// asleep after a fraction of cb2_timeToSleep once it is nearly still. Contact and
+	/// joint impulses are kept while asleep, so a woken island is warm started.
+	void SetEarlySleep(bool flag) { m_earlySleep = flag; }
+	bool GetEarlySleep() const { return m_earlySleep; }
+
+	/// Enable/disable batch integration. Each island then gathers the velocities,
+	/// accelerations and damping of its bodies into flat arrays and integrates them
+	/// with SIMD, four bodies at a time. Positions and the velocity clamps are
+	/// integrated the same way. The results are the same.
+	void SetBatchIntegration(bool flag) { m_batchIntegration = flag; }
+	bool GetBatchIntegration() const { return m_batchIntegration; }
+
 	/// Enable/disable continuous physics. For testing.
 	void SetContinuousPhysics(bool flag) { m_continuousPhysics = flag; }
 	bool GetContinuousPhysics() const { return m_continuousPhysics; }
@@ -157,15 +604,239 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Set the maximum number of TOI events of one contact per step. The default is cb2_maxSubSteps.
+	void SetMaxSubSteps(int count) { m_toiScheduler.SetMaxSubSteps(count); }
+	int GetMaxSubSteps() const { return m_toiScheduler.GetMaxSubSteps(); }
+
+	/// Set the maximum number of contacts solved with one TOI event. The default is cb2_maxTOIContacts.
+	void SetMaxTOIContacts(int count) { cb2Assert(count > 0); m_maxTOIContacts = count; }
+	int GetMaxTOIContacts() const { return m_maxTOIContacts; }
+
+	/// Limit the TOI events solved per step by count and by milliseconds spent in
+	/// continuous physics. Zero means no limit, which is the default. Once the budget
+	/// is used up the remaining events are deferred: like with sub-stepping, the next
+	/// Step solves them before the bodies are integrated again.
+	void SetTOIBudget(int maxEvents, float maxMilliseconds);
+	int GetTOIEventBudget() const { return m_toiEventBudget; }
+	float GetTOITimeBudget() const { return m_toiTimeBudget; }
+
+	/// Limit the milliseconds spent solving islands in each step. The islands found once
+	/// the budget is used up are deferred: their bodies keep still and owe the time step,
+	/// see cb2Body::GetSolveDebt. The next steps solve the islands that owe time first and
+	/// add up to cb2_maxCatchUpSteps time steps to them. Time owed beyond
+	/// cb2_maxSolveDebtSteps steps is dropped. Zero means no limit, which is the default.
+	/// Ignored in deterministic mode.
+	void SetSolveBudget(float milliseconds) { m_solveBudget = milliseconds; }
+	float GetSolveBudget() const { return m_solveBudget; }
+
+	/// Set the number of threads used by the time step, including the calling thread.
+	/// With more than one thread, contact manifolds are updated and islands are solved
+	/// concurrently. Contact callbacks are then reported in the serial order, but after
+	/// the whole phase, so callbacks see every manifold already updated. The default is one.
+	void SetThreadCount(int threadCount);
+	int GetThreadCount() const;
+
+	/// Use this stack allocator for the per step allocations instead of the one of the
+	/// world. Worlds stepped one after the other on the same thread can share one, since
+	/// the stack is empty between steps; see cb2WorldScheduler. Pass NULL to go back to
+	/// the allocator of the world.
+	/// @warning this should be called outside of a time step.
+	void SetStackAllocator(cb2StackAllocator* allocator);
+
+	/// Enable/disable splitting large islands across the threads. Their constraints
+	/// are colored into batches that share no body and each batch is solved in
+	/// parallel. This changes the order of the solver, so results differ from
+	/// solving the island on one thread. Only used with more than one thread.
+	void SetSplitIslands(bool flag) { m_splitIslands = flag; }
+	bool GetSplitIslands() const { return m_splitIslands; }
+
+	/// Enable/disable the deterministic mode. The results then only depend on the
+	/// calls made to the world, not on the thread count or on the time spent: islands
+	/// are not split and the TOI time budget is ignored. To match across platforms,
+	/// also build with CB2_DETERMINISTIC, see cb2Settings.h.
+	void SetDeterministic(bool flag) { m_deterministic = flag; }
+	bool GetDeterministic() const { return m_deterministic; }
+
+	/// Get a hash of the state of the bodies: transforms, sweeps, velocities and
+	/// sleep state, in body list order. Compare it between peers after each step to
+	/// detect a desync.
+	unsigned int GetStateHash() const;
+
+	/// Enable/disable persistent islands. The islands are then kept up to date as
+	/// contacts begin and end instead of being searched for every step, which saves
+	/// the search when most of a large world is awake. An island that lost a
+	/// constraint is only split when it is about to fall asleep, and it stays awake
+	/// until then. The islands are solved on the calling thread.
+	void SetPersistentIslands(bool flag);
+	bool GetPersistentIslands() const { return m_persistentIslands; }
+
+	/// Set the levels of detail of the simulation, at most cb2_maxLodLevels, by increasing
+	/// distance. Level 0 is full detail and levels 1 to count are the given ones. Each
+	/// island is solved at the most detailed level of its bodies, see cb2Body::SetLodLevel,
+	/// so a body near an observer brings what it touches to full detail. A count of zero
+	/// solves everything at full detail, which is the default.
+	/// @warning This function is locked during callbacks.
+	void SetLodLevels(const cb2LodLevel* levels, int count);
+	int GetLodLevelCount() const { return m_lodLevelCount; }
+
+	/// Set the points the levels of detail are measured from, at most cb2_maxLodObservers,
+	/// typically the cameras. Call it again as they move. Without observers the bodies
+	/// are at full detail unless they set their level.
+	void SetLodObservers(const ci::Vec2f* points, int count);
+	int GetLodObserverCount() const { return m_lodObserverCount; }
+
+	/// Get the number of persistent islands.
+	int GetIslandCount() const { return m_islandGraph.GetIslandCount(); }
+
+	/// Keep dense sets of the awake bodies and of the contacts with an awake body, so
+	/// the per step passes over bodies and contacts skip the sleeping ones. The sets
+	/// are updated when bodies wake up, and sleeping bodies and contacts are dropped
+	/// by the next pass that visits them. Bodies and contacts are then visited in a
+	/// different order, which changes the results and the order of contact callbacks.
+	void SetAwakeSets(bool flag);
+	bool GetAwakeSets() const { return m_awakeBodies != NULL; }
+
+	/// Get the number of bodies in the awake set. This may include bodies that fell
+	/// asleep during the last step and static bodies hit by a TOI event.
+	int GetAwakeBodyCount() const { return m_awakeBodyCount; }
+
+	/// Enable/disable the static tree for fixtures created on static bodies from now on.
+	/// Static fixtures are then kept in a separate four wide tree built with the surface
+	/// area heuristic, which makes pair finding and ray casts cheaper on large static levels.
+	void SetStaticTree(bool flag) { m_contactManager.m_broadPhase.SetStaticTree(flag); }
+	bool GetStaticTree() const { return m_contactManager.m_broadPhase.GetStaticTree(); }
+
+	/// Keep the contacts in a dense array as well as in the contact list. Collide, Solve and
+	/// SolveTOI then scan the array instead of chasing list pointers. The contact list and
+	/// the body contact edges stay valid. Contacts are then visited in a different order,
+	/// which changes the order of contact callbacks.
+	void SetContiguousContacts(bool flag) { m_contactManager.SetContiguous(flag); }
+	bool GetContiguousContacts() const { return m_contactManager.IsContiguous(); }
+
+	/// Enable/disable the impulse cache. The impulses of contact points that go away
+	/// are kept by body pair for a step, and a new point of the same bodies at about
+	/// the same place warm starts from them. This keeps warm starting when contacts are
+	/// destroyed and created again and when bodies slide over the child edges of chains.
+	void SetImpulseCache(bool flag) { m_contactManager.SetImpulseCache(flag); }
+	bool GetImpulseCache() const { return m_contactManager.HasImpulseCache(); }
+
+	/// Enable/disable sensor overlaps. Sensor fixtures then create no contacts. Each step
+	/// ends by querying the broad-phase with every sensor, on the thread pool, and the
+	/// overlaps that began and ended go to cb2ContactListener::BeginSensorOverlap and
+	/// EndSensorOverlap and to the contact events. Sensors do not sense other sensors.
+	/// Enabling destroys the contacts of sensors, disabling forgets the overlaps without
+	/// calling the listener.
+	void SetSensorOverlaps(bool flag);
+	bool GetSensorOverlaps() const { return m_sensorManager != NULL; }
+
+	/// Enable/disable collision between two layers of the layer matrix. See cb2Filter::layer.
+	/// All layers collide by default. Proxies on layers that do not collide are never
+	/// paired by the broad-phase, so the contact filter is not even called for them.
+	/// Existing contacts are destroyed at the next step, like after cb2Fixture::Refilter.
+	void SetLayerCollision(int layerA, int layerB, bool flag);
+	bool GetLayerCollision(int layerA, int layerB) const;
+
+	/// Set the friction and restitution of a material, in [0, cb2_maxMaterials). Fixtures
+	/// use it with cb2FixtureDef::material. A contact between two fixtures with materials
+	/// takes its friction, restitution and tangent speed from the entry of the pair, which
+	/// mixes the two materials unless it was set with SetMaterialPair. The contacts of the
+	/// changed materials are updated at the start of the next step, replacing the values
+	/// set on them. The materials start with the friction and restitution of cb2FixtureDef.
+	void SetMaterial(int material, float friction, float restitution);
+
+	/// Set the surface of the contacts between two materials.
+	void SetMaterialPair(int materialA, int materialB, float friction, float restitution, float tangentSpeed = 0.0f);
+
+	/// Mix the surface of the contacts between two materials from the materials again.
+	void ResetMaterialPair(int materialA, int materialB);
+
+	/// Get the material table, NULL until a material was set.
+	const cb2MaterialTable* GetMaterialTable() const { return m_materials; }
+
+	/// Create a target drive, a soft point constraint that pulls a point of a dynamic body
+	/// towards a target like cb2MouseJoint. The drives live in a pool instead of the joint
+	/// list, so creating and destroying them allocates nothing once the pool has grown,
+	/// and the targets of many drives are set in one call, as for multi-touch input. A
+	/// drive is solved in the island of its body. Returns the handle of the drive.
+	/// @warning This function is locked during callbacks.
+	int CreateTargetDrive(const cb2TargetDriveDef* def);
+
+	/// Destroy a target drive. Destroying a body destroys its drives.
+	/// @warning This function is locked during callbacks.
+	void DestroyTargetDrive(int drive);
+
+	/// Set the targets of several drives, in world coordinates. A drive whose target moved
+	/// wakes its body.
+	void SetTargetDriveTargets(const int* drives, const ci::Vec2f* targets, int count);
+	void SetTargetDriveTarget(int drive, const ci::Vec2f& target) { SetTargetDriveTargets(&drive, &target, 1); }
+
+	/// Get the target and the body of a drive.
+	const ci::Vec2f& GetTargetDriveTarget(int drive) const;
+	cb2Body* GetTargetDriveBody(int drive) const;
+
+	/// Get the number of target drives.
+	int GetTargetDriveCount() const;
+
+	/// Choose the broad-phase structure for fixtures outside the static tree. The spatial
+	/// hash beats the dynamic tree when there are many fixtures of similar size, such as
+	/// particle-like circles; pick a cell size near the fixture size. The sweep and prune
+	/// suits mostly static scenes with coherent motion. Call this before creating any fixture.
+	void SetBroadPhaseType(cb2BroadPhaseType type, float cellSize = 1.0f) { m_contactManager.m_broadPhase.SetType(type, cellSize); }
+	cb2BroadPhaseType GetBroadPhaseType() const { return m_contactManager.m_broadPhase.GetType(); }
+
+	/// Set the budget of the incremental broad-phase tree optimizer. Each step rebuilds one
+	/// subtree of at most this many leaves, which keeps tree quality from degrading over
+	/// long sessions. The default is zero, which turns the optimizer off.
+	void SetTreeOptimizeLeafCount(int leafCount) { m_contactManager.m_broadPhase.SetOptimizeLeafCount(leafCount); }
+	int GetTreeOptimizeLeafCount() const { return m_contactManager.m_broadPhase.GetOptimizeLeafCount(); }
+
+	/// Begin/end loading many fixtures. Fixtures created in between are not inserted into
+	/// the broad-phase tree one at a time. EndBulkLoad builds the tree top-down in O(n log n)
+	/// time, which also gives a better tree. Queries and ray casts miss these fixtures until then.
+	void BeginBulkLoad();
+	void EndBulkLoad();
+
 	/// Get the number of broad-phase proxies.
 	int GetProxyCount() const;
 
 	/// Get the number of bodies.
 	int GetBodyCount() const;
 
+	/// Get the upper bound of the body ids, see cb2Body::GetId.
+	int GetBodyIdCount() const { return m_bodyIdCount; }
+
+	/// Get the body with an id, or NULL if no body has it.
+	cb2Body* GetBody(int id) const;
+
+	/// Set a buffer that each step fills with the transforms of the bodies it moved: the
+	/// non-static bodies awake at the start of the step or woken during it. Renderers can
+	/// interpolate between the two transforms, and replication can send the entries as they
+	/// are. A body woken during the step gets the start of its swept motion as previous
+	/// transform. Entries past the capacity are dropped. Pass NULL to stop. The buffer is
+	/// owned by you and must remain in scope.
+	void SetTransformBuffer(cb2BodyTransform* buffer, int capacity);
+
+	/// Get the number of entries written to the transform buffer by the last step.
+	int GetTransformCount() const { return m_transformCount; }
+
+	/// Record the begin, end and hit events of each step in a buffer that can be read
+	/// after the step instead of, or besides, the contact listener callbacks.
+	void SetContactEvents(bool flag);
+
+	/// Get the contact events of the last step, or NULL if they are not recorded.
+	const cb2ContactEvents* GetContactEvents() const { return m_contactEvents; }
+
+	/// Set the approach speed, in meters per second, above which a new solid contact
+	/// gives a hit event. The default is one meter per second.
+	void SetHitEventThreshold(float speed) { m_hitEventThreshold = speed; }
+	float GetHitEventThreshold() const { return m_hitEventThreshold; }
+
 	/// Get the number of joints.
 	int GetJointCount() const;
 
+	/// Get the number of particle systems.
+	int GetParticleSystemCount() const { return m_particleSystemCount; }
+
 	/// Get the number of contacts (each may have 0 or more contact points).
 	int GetContactCount() const;
 
@@ -199,16 +870,81 @@ public:
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const ci::Vec2f& newOrigin);
 
+	/// Get the position of the origin in the large world. The shifts are summed in
+	/// double precision, so the origin is exact however far it moved.
+	const ci::Vec2d& GetOrigin() const { return m_origin; }
+
+	/// Convert a large world position to the float position relative to the origin
+	/// used by the bodies, the trees and the solver.
+	ci::Vec2f ToLocal(const ci::Vec2d& position) const;
+
+	/// Convert a position relative to the origin to a large world position.
+	ci::Vec2d ToGlobal(const ci::Vec2f& position) const;
+
+	/// Enable the large world mode. The world keeps its origin on a grid of square cells
+	/// near the focus, shifting it by whole cells at the start of a step when the focus
+	/// is more than a cell away. Positions near the focus then keep their precision however
+	/// far it travels, and the origin never has to be shifted by hand. Pass zero to stop.
+	void SetOriginCellSize(float cellSize);
+	float GetOriginCellSize() const { return m_originCellSize; }
+
+	/// Set the large world position the origin follows, such as the camera or the player.
+	void SetOriginFocus(const ci::Vec2d& focus) { m_originFocus = focus; }
+	const ci::Vec2d& GetOriginFocus() const { return m_originFocus; }
+
 	/// Get the contact manager for testing.
 	const cb2ContactManager& GetContactManager() const;
 
 	/// Get the current profile.
 	const cb2Profile& GetProfile() const;
 
+	/// Keep the profiles of the last steps for rolling statistics. Zero steps, the
+	/// default, disables the collector. The statistics are drawn by DrawDebugData
+	/// with cb2Draw::e_profileBit.
+	void SetProfileWindow(int stepCount) { m_profileStats.SetWindow(stepCount); }
+	int GetProfileWindow() const { return m_profileStats.GetWindow(); }
+
+	/// Get the rolling statistics of the profile.
+	const cb2ProfileStats& GetProfileStats() const { return m_profileStats; }
+
+	/// Get the memory of the world: the block allocator by size class, the trees and
+	/// buffers of the broad-phase, the stack allocators, and the objects by type. This
+	/// visits every body, contact and joint, so call it now and then, not every step.
+	/// Pass the result to cb2ReportMemoryStats to record it with a profiler.
+	/// @warning this should be called outside of a time step.
+	void GetMemoryStats(cb2MemoryStats* stats) const;
+
 	/// Dump the world into the log file.
 	/// @warning this should be called outside of a time step.
 	void Dump();
 
+	/// Make a copy of this world that can be stepped on its own, for prediction and look
+	/// ahead. Bodies, fixtures, joints and contacts are copied in bulk with their state
+	/// and the broad-phase is copied without inserting the proxies again, so stepping the
+	/// copy gives the same results as stepping this world. The options and listeners are
+	/// copied too, and the copy gets its own threads. User data is copied as is. Persistent
+	/// islands are linked again in the copy, so it solves them in another order and drifts
+	/// from this world. Particle systems are not copied. Delete the copy when done.
+	/// Returns NULL during a time step.
+	cb2World* Clone() const;
+
+	/// Save the simulation state into a binary snapshot: the body motion, joint impulses,
+	/// broad-phase boxes, and the contacts with their manifolds and warm starting impulses.
+	/// Bodies, fixtures and joints are not saved, they are referred to by their place in
+	/// the world lists. Returns the number of bytes the snapshot needs; nothing is written
+	/// when the capacity is smaller. Returns 0 when persistent islands are enabled.
+	/// See cb2EncodeSnapshotDelta to send snapshots as a difference from an earlier one.
+	int SaveSnapshot(void* buffer, int capacity) const;
+
+	/// Restore a snapshot made by SaveSnapshot. The world must have the same bodies,
+	/// fixtures and joints as when it was saved, created in the same order, and the same
+	/// awake set, contiguous contact and impulse cache options. Stepping then gives the
+	/// same results as stepping the saved world. No listener is called for the contacts
+	/// that are destroyed and recreated. Returns false if the snapshot does not match
+	/// the world; if it fails after the header checks the contacts may be lost.
+	/// @warning this should be called outside of a time step.
+	bool RestoreSnapshot(const void* buffer, int size);
+
 private:
 
 	// m_flags
@@ -216,22 +952,106 @@ private:
 	{
 		e_newFixture	= 0x0001,
 		e_locked		= 0x0002,
-		e_clearForces	= 0x0004
+		e_clearForces	= 0x0004,
+		e_massDirty		= 0x0008
 	};
 
 	friend class cb2Body;
+	friend class cb2CommandBuffer;
 	friend class cb2Fixture;
+	friend class cb2StepThread;
 	friend class cb2ContactManager;
 	friend class cb2Controller;
+	friend class cb2Contact;
+	friend class cb2ReplicationEncoder;
 
 	void Solve(const cb2TimeStep& step);
+
+	// Destroy the joints the islands found broken, in one pass at the end of the step.
+	void DestroyBrokenJoints();
+	void SolveIslands(const cb2TimeStep& step);
+	void SolvePersistentIslands(const cb2TimeStep& step);
+
+	void AddAwakeBody(cb2Body* body);
+	void RemoveAwakeBody(cb2Body* body);
+
+	// Iterate the bodies that may be awake. These are the awake bodies when the set is
+	// kept, otherwise all bodies.
+	cb2Body* GetFirstAwakeBody(int* index) const;
+	cb2Body* GetNextAwakeBody(cb2Body* b, int* index) const;
+	void SolveIslandsParallel(const cb2TimeStep& step);
+
+	// Did a body move in the islands, so its proxies need synchronizing?
+	static bool NeedsSynchronize(const cb2Body* b);
+
+	// Synchronize the fixtures of the moved bodies. The proxy boxes are found on the
+	// pool, then the proxies that left their fat AABB are moved in body order.
+	void SynchronizeFixturesParallel(const cb2TimeStep& step);
 	void SolveTOI(const cb2TimeStep& step);
 
+	// Pick the level of detail and the time step of an island. Returns -1 if the
+	// island sits out this step.
+	int PrepareIsland(cb2Body* const* bodies, int count, const cb2TimeStep& step, cb2TimeStep* islandStep, bool* owesTime);
+
+	// Shift the origin by whole cells towards the focus in the large world mode.
+	void FollowOriginFocus();
+
+	cb2MaterialTable* GetMaterials();
+	void UpdateMaterials();
+	bool IsOverSolveBudget() const;
+	cb2Body* GetNextSeed(cb2Body* b, int* index, int* pass) const;
+
+	void PublishQuerySnapshot();
+
+	// The options a snapshot depends on, see SaveSnapshot.
+	int GetSnapshotOptions() const;
+
+	int AllocateBodyId();
+	void FreeBodyId(int id);
+	void SetBodyById(cb2Body* b);
+
+	// Add a constructed body to the world list and the body sets.
+	void AddBody(cb2Body* b);
+
+	// Destroy many bodies with one pass over the impulse cache.
+	void DestroyBodies(cb2Body** bodies, int count);
+
+	void BeginTransformExport();
+	void EndTransformExport();
+
+	void ApplyCommands();
+	void CaptureBodyStates();
+
 	void DrawJoint(cb2Joint* joint);
-	void DrawShape(cb2Fixture* shape, const cb2Transform& xf, const cb2Color& color);
+	void DrawShape(cb2Fixture* shape, const cb2Transform& xf, const cb2Color& color, int childIndex);
 
 	cb2BlockAllocator m_blockAllocator;
-	cb2StackAllocator m_stackAllocator;
+	cb2StackAllocator m_ownStackAllocator;
+	cb2StackAllocator* m_stackAllocator;
+
+	// One stack allocator per pool thread, so islands can be solved concurrently.
+	cb2ThreadPool* m_threadPool;
+	cb2StackAllocator* m_threadAllocators;
+	bool m_splitIslands;
+	bool m_deterministic;
+
+	cb2Profiler* m_profiler;
+	cb2ProfileStats m_profileStats;
+
+	cb2IslandGraph m_islandGraph;
+	bool m_persistentIslands;
+
+	cb2Body** m_awakeBodies;
+	int m_awakeBodyCount;
+	int m_awakeBodyCapacity;
+
+	// Queued time of impact events of the current step.
+	cb2TOIScheduler m_toiScheduler;
+
+	// Triple buffered query snapshots. The published one is swapped atomically.
+	cb2QuerySnapshot* m_querySnapshots[3];
+	std::atomic<cb2QuerySnapshot*> m_publishedSnapshot;
+	int m_stepCount;
 
 	int m_flags;
 
@@ -243,6 +1063,57 @@ private:
 	int m_bodyCount;
 	int m_jointCount;
 
+	cb2ParticleSystem* m_particleSystemList;
+	int m_particleSystemCount;
+
+	// Ids in [0, m_bodyIdCount) that are not in use.
+	int* m_freeBodyIds;
+	int m_freeBodyIdCount;
+	int m_freeBodyIdCapacity;
+	int m_bodyIdCount;
+
+	// The bodies indexed by their id, NULL for free ids.
+	cb2Body** m_bodiesById;
+	int m_bodiesByIdCapacity;
+
+	// The transform buffer and the bodies of its entries.
+	cb2BodyTransform* m_transforms;
+	cb2Body** m_transformBodies;
+	int m_transformCapacity;
+	int m_transformCount;
+
+	// The step thread of StepAsync, created by the first call. The body states are
+	// double buffered, the step thread fills the back buffer.
+	cb2StepThread* m_stepThread;
+	bool m_asyncStep;
+	cb2BodyState* m_bodyStates[2];
+	int m_bodyStateCount[2];
+	int m_bodyStateCapacity[2];
+	int m_frontBodyStates;
+
+	// Commands queued for the next step.
+	cb2BodyCommand* m_commands;
+	int m_commandCount;
+	int m_commandCapacity;
+
+	// Command buffers submitted for the next step.
+	cb2CommandBuffer** m_commandBuffers;
+	int m_commandBufferCount;
+	int m_commandBufferCapacity;
+
+	cb2ContactEvents* m_contactEvents;
+	cb2SensorManager* m_sensorManager;
+	float m_hitEventThreshold;
+
+	// Made by the first material that is set.
+	cb2MaterialTable* m_materials;
+
+	// Made by the first target drive.
+	cb2TargetDrives* m_targetDrives;
+
+	// Made by the first persistent ray.
+	cb2RayQueries* m_rayQueries;
+
 	ci::Vec2f m_gravity;
 	bool m_allowSleep;
 
@@ -253,14 +1124,51 @@ private:
 	// support a variable time step.
 	float m_inv_dt0;
 
+	// The fixed step of Advance and the time not stepped yet.
+	float m_fixedTimeStep;
+	int m_fixedVelocityIterations;
+	int m_fixedPositionIterations;
+	int m_maxFixedSteps;
+	float m_accumulator;
+
 	// These are for debugging the solver.
 	bool m_warmStarting;
+	bool m_wideContactSolver;
+	bool m_speculativeContacts;
+	bool m_contactReduction;
+	bool m_earlySleep;
+	bool m_batchIntegration;
+	cb2SolverType m_solverType;
+	int m_subStepCount;
+	float m_impulseTolerance;
+	float m_postSolveThreshold;
+	bool m_jointBatching;
+	bool m_spatialOrdering;
+	bool m_directJointSolver;
 	bool m_continuousPhysics;
 	bool m_subStepping;
 
 	bool m_stepComplete;
 
+	int m_maxTOIContacts;
+	int m_toiEventBudget;
+	float m_toiTimeBudget;
+
+	float m_solveBudget;
+	cb2Timer m_solveTimer;
+
 	cb2Profile m_profile;
+
+	// Levels of detail, the time step for each level is set by Solve. Level 0 is full detail.
+	cb2LodLevel m_lodLevels[cb2_maxLodLevels];
+	int m_lodLevelCount;
+	ci::Vec2f m_lodObservers[cb2_maxLodObservers];
+	int m_lodObserverCount;
+	cb2TimeStep m_lodSteps[cb2_maxLodLevels + 1];
+
+	ci::Vec2d m_origin;
+	ci::Vec2d m_originFocus;
+	float m_originCellSize;
 };
 
 inline cb2Body* cb2World::GetBodyList()
@@ -293,6 +1201,31 @@ inline const cb2Contact* cb2World::GetContactList() const
 	return m_contactManager.m_contactList;
 }
 
+inline cb2Body* cb2World::GetFirstAwakeBody(int* index) const
+{
+	if (m_awakeBodies)
+	{
+		*index = 0;
+		return m_awakeBodyCount > 0 ? m_awakeBodies[0] : NULL;
+	}
+	return m_bodyList;
+}
+
+inline cb2Body* cb2World::GetNextAwakeBody(cb2Body* b, int* index) const
+{
+	if (m_awakeBodies)
+	{
+		++*index;
+		return *index < m_awakeBodyCount ? m_awakeBodies[*index] : NULL;
+	}
+	return b->GetNext();
+}
+
+inline cb2Body* cb2World::GetBody(int id) const
+{
+	return 0 <= id && id < m_bodiesByIdCapacity ? m_bodiesById[id] : NULL;
+}
+
 inline int cb2World::GetBodyCount() const
 {
 	return m_bodyCount;
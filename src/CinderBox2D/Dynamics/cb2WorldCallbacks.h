@@ -26,6 +26,7 @@ class cb2Fixture;
 class cb2Body;
 class cb2Joint;
 class cb2Contact;
+class cb2Shape;
 struct cb2ContactResult;
 struct cb2Manifold;
 
@@ -38,7 +39,8 @@ public:
 	virtual ~cb2DestructionListener() {}
 
 	/// Called when any joint is about to be destroyed due
-	/// to the destruction of one of its attached bodies.
+	/// to the destruction of one of its attached bodies, or
+	/// because it broke, see cb2JointDef::breakForce.
 	virtual void SayGoodbye(cb2Joint* joint) = 0;
 
 	/// Called when any fixture is about to be destroyed due
@@ -98,6 +100,9 @@ public:
 	/// Note: if you set the number of contact points to zero, you will not
 	/// get an EndContact callback. However, you may get a BeginContact callback
 	/// the next step.
+	/// Note: with a thread pool or a collide backend, bodies are woken after all
+	/// manifolds are updated, so a contact between bodies that another contact
+	/// wakes in the same step is first updated in the next step.
 	virtual void PreSolve(cb2Contact* contact, const cb2Manifold* oldManifold)
 	{
 		CB2_NOT_USED(contact);
@@ -115,6 +120,22 @@ public:
 		CB2_NOT_USED(contact);
 		CB2_NOT_USED(impulse);
 	}
+
+	/// Called when a solid fixture begins to overlap a sensor that has no contacts,
+	/// see cb2World::SetSensorOverlaps. You may not destroy fixtures in this callback.
+	virtual void BeginSensorOverlap(cb2Fixture* sensor, cb2Fixture* visitor)
+	{
+		CB2_NOT_USED(sensor);
+		CB2_NOT_USED(visitor);
+	}
+
+	/// Called when a solid fixture ceases to overlap a sensor that has no contacts,
+	/// and when either fixture is destroyed.
+	virtual void EndSensorOverlap(cb2Fixture* sensor, cb2Fixture* visitor)
+	{
+		CB2_NOT_USED(sensor);
+		CB2_NOT_USED(visitor);
+	}
 };
 
 /// Callback class for AABB queries.
@@ -151,4 +172,34 @@ public:
 									const ci::Vec2f& normal, float fraction) = 0;
 };
 
+/// A contact manifold to be computed by a cb2CollideBackend. The job holds copies
+/// of the transforms, so an array of jobs can be uploaded as it is.
+struct cb2CollideJob
+{
+	cb2Contact* contact;			///< the contact, for a backend that evaluates some jobs itself
+	const cb2Shape* shapeA;
+	int indexA;
+	const cb2Shape* shapeB;
+	int indexB;
+	cb2Transform xfA;
+	cb2Transform xfB;
+	float speculativeDistance;		///< points closer than this are kept as speculative
+	cb2Manifold* manifold;			///< the output
+};
+
+/// Implement this to compute contact manifolds somewhere else, such as on a compute
+/// device. See cb2World::SetCollideBackend. The manifolds are evaluated in batches
+/// of one shape pair type on the stepping thread. Sensors are not offloaded.
+class cb2CollideBackend
+{
+public:
+	virtual ~cb2CollideBackend() {}
+
+	/// Compute the manifolds of a batch of contacts that all have the same type, see
+	/// cb2Contact::Type, as cb2Contact::Evaluate would. The impulses of the points
+	/// need not be set, the engine matches them with the old manifold afterwards.
+	/// Return false to leave the whole batch to the CPU path.
+	virtual bool Collide(int contactType, cb2CollideJob* jobs, int count) = 0;
+};
+
 #endif
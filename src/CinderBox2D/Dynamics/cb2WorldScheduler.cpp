@@ -0,0 +1,223 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Dynamics/cb2WorldScheduler.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
+#include <CinderBox2D/Common/cb2StackAllocator.h>
+#include <CinderBox2D/Common/cb2Timer.h>
+#include <algorithm>
+#include <new>
+#include <string.h>
+
+// The weight of the last step in the running average.
+const float cb2_schedulerAverageWeight = 0.1f;
+
+// The smallest TOI time budget given to a world, so a world over budget still makes progress.
+const float cb2_schedulerMinTOIBudget = 0.01f;
+
+class cb2WorldStepTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			scheduler->StepWorld(scheduler->m_worlds + scheduler->m_order[i], scheduler->m_allocators + threadIndex);
+		}
+	}
+
+	cb2WorldScheduler* scheduler;
+};
+
+// Hand out the slowest worlds first.
+struct cb2SlowerWorld
+{
+	bool operator()(int a, int b) const
+	{
+		float timeA = worlds[a].averageStepTime;
+		float timeB = worlds[b].averageStepTime;
+		return timeA > timeB || (timeA == timeB && a < b);
+	}
+
+	const cb2ScheduledWorld* worlds;
+};
+
+cb2WorldScheduler::cb2WorldScheduler(int threadCount)
+	: m_threadPool(threadCount)
+{
+	int count = m_threadPool.GetThreadCount();
+	m_allocators = (cb2StackAllocator*)cb2Alloc(count * sizeof(cb2StackAllocator));
+	for (int i = 0; i < count; ++i)
+	{
+		new (m_allocators + i) cb2StackAllocator();
+	}
+
+	m_worlds = NULL;
+	m_worldCount = 0;
+	m_worldCapacity = 0;
+	m_order = NULL;
+	m_lastStepTime = 0.0f;
+}
+
+cb2WorldScheduler::~cb2WorldScheduler()
+{
+	cb2Free(m_order);
+	cb2Free(m_worlds);
+
+	for (int i = 0; i < m_threadPool.GetThreadCount(); ++i)
+	{
+		m_allocators[i].~cb2StackAllocator();
+	}
+	cb2Free(m_allocators);
+}
+
+void cb2WorldScheduler::AddWorld(cb2World* world, float timeStep, int velocityIterations, int positionIterations)
+{
+	cb2Assert(world->GetThreadCount() == 1);
+	cb2Assert(FindIndex(world) == -1);
+
+	if (m_worldCount == m_worldCapacity)
+	{
+		cb2ScheduledWorld* oldWorlds = m_worlds;
+		m_worldCapacity = cb2Max(2 * m_worldCapacity, 16);
+		m_worlds = (cb2ScheduledWorld*)cb2Alloc(m_worldCapacity * sizeof(cb2ScheduledWorld));
+		if (oldWorlds)
+		{
+			memcpy(m_worlds, oldWorlds, m_worldCount * sizeof(cb2ScheduledWorld));
+			cb2Free(oldWorlds);
+		}
+
+		cb2Free(m_order);
+		m_order = (int*)cb2Alloc(m_worldCapacity * sizeof(int));
+	}
+
+	cb2ScheduledWorld* scheduled = m_worlds + m_worldCount;
+	scheduled->world = world;
+	scheduled->timeStep = timeStep;
+	scheduled->velocityIterations = velocityIterations;
+	scheduled->positionIterations = positionIterations;
+	scheduled->budget = 0.0f;
+	scheduled->lastStepTime = 0.0f;
+	scheduled->averageStepTime = 0.0f;
+	scheduled->maxStepTime = 0.0f;
+	scheduled->stepCount = 0;
+	scheduled->overBudgetCount = 0;
+	++m_worldCount;
+}
+
+void cb2WorldScheduler::RemoveWorld(cb2World* world)
+{
+	int index = FindIndex(world);
+	if (index == -1)
+	{
+		return;
+	}
+
+	memmove(m_worlds + index, m_worlds + index + 1, (m_worldCount - index - 1) * sizeof(cb2ScheduledWorld));
+	--m_worldCount;
+}
+
+void cb2WorldScheduler::SetBudget(cb2World* world, float milliseconds)
+{
+	cb2Assert(milliseconds >= 0.0f);
+	int index = FindIndex(world);
+	cb2Assert(index != -1);
+	if (index != -1)
+	{
+		m_worlds[index].budget = milliseconds;
+	}
+}
+
+const cb2ScheduledWorld* cb2WorldScheduler::GetWorld(int index) const
+{
+	cb2Assert(0 <= index && index < m_worldCount);
+	return m_worlds + index;
+}
+
+const cb2ScheduledWorld* cb2WorldScheduler::FindWorld(const cb2World* world) const
+{
+	int index = FindIndex(world);
+	return index == -1 ? NULL : m_worlds + index;
+}
+
+int cb2WorldScheduler::FindIndex(const cb2World* world) const
+{
+	for (int i = 0; i < m_worldCount; ++i)
+	{
+		if (m_worlds[i].world == world)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+void cb2WorldScheduler::Step()
+{
+	cb2Timer timer;
+
+	for (int i = 0; i < m_worldCount; ++i)
+	{
+		m_order[i] = i;
+	}
+
+	cb2SlowerWorld slower;
+	slower.worlds = m_worlds;
+	std::sort(m_order, m_order + m_worldCount, slower);
+
+	// One world per range, so idle threads pick up the remaining worlds.
+	cb2WorldStepTask task;
+	task.scheduler = this;
+	m_threadPool.ParallelFor(&task, m_worldCount, 1);
+
+	m_lastStepTime = timer.GetMilliseconds();
+}
+
+void cb2WorldScheduler::StepWorld(cb2ScheduledWorld* scheduled, cb2StackAllocator* allocator)
+{
+	cb2World* world = scheduled->world;
+
+	if (scheduled->budget > 0.0f && scheduled->stepCount > 0)
+	{
+		const cb2Profile& profile = world->GetProfile();
+		float discrete = profile.step - profile.solveTOI;
+		world->SetTOIBudget(world->GetTOIEventBudget(), cb2Max(scheduled->budget - discrete, cb2_schedulerMinTOIBudget));
+	}
+
+	cb2Timer timer;
+	world->SetStackAllocator(allocator);
+	world->Step(scheduled->timeStep, scheduled->velocityIterations, scheduled->positionIterations);
+	world->SetStackAllocator(NULL);
+	float time = timer.GetMilliseconds();
+
+	scheduled->lastStepTime = time;
+	if (scheduled->stepCount == 0)
+	{
+		scheduled->averageStepTime = time;
+	}
+	else
+	{
+		scheduled->averageStepTime += cb2_schedulerAverageWeight * (time - scheduled->averageStepTime);
+	}
+	scheduled->maxStepTime = cb2Max(scheduled->maxStepTime, time);
+	++scheduled->stepCount;
+
+	if (scheduled->budget > 0.0f && time > scheduled->budget)
+	{
+		++scheduled->overBudgetCount;
+	}
+}
@@ -0,0 +1,113 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_WORLD_SCHEDULER_H
+#define CB2_WORLD_SCHEDULER_H
+
+#include <CinderBox2D/Common/cb2ThreadPool.h>
+
+class cb2StackAllocator;
+class cb2World;
+
+/// The step settings and statistics of a world stepped by a cb2WorldScheduler.
+/// Times are in milliseconds.
+struct cb2ScheduledWorld
+{
+	cb2World* world;
+	float timeStep;
+	int velocityIterations;
+	int positionIterations;
+
+	/// The time budget of a step, zero for none. See cb2WorldScheduler::SetBudget.
+	float budget;
+
+	/// The last step, the running average of the steps and the longest step.
+	float lastStepTime;
+	float averageStepTime;
+	float maxStepTime;
+
+	/// The number of steps, and of steps that took longer than the budget.
+	int stepCount;
+	int overBudgetCount;
+};
+
+/// Steps many independent worlds on one pool of threads, for servers that host many
+/// small simulations. Each Step of the scheduler steps every world once. The worlds
+/// are handed out to the threads one at a time, the slowest on average first, so a
+/// thread that is done takes the next world while the others are still busy. Worlds
+/// stepped on the same thread share its stack allocator, which stays warm in cache.
+/// Each world keeps its own block allocator because its objects outlive the step.
+class cb2WorldScheduler
+{
+public:
+	/// Create a scheduler with this many threads, including the calling thread.
+	cb2WorldScheduler(int threadCount);
+	~cb2WorldScheduler();
+
+	/// Add a world, stepped with these settings. The world must use one thread, see
+	/// cb2World::SetThreadCount, and is not owned by the scheduler.
+	void AddWorld(cb2World* world, float timeStep, int velocityIterations, int positionIterations);
+
+	/// Remove a world. Its statistics are forgotten.
+	void RemoveWorld(cb2World* world);
+
+	/// Set the time budget of the steps of a world. Zero means no limit, which is the
+	/// default. The time the last step spent outside continuous physics is taken from
+	/// the budget and the rest is given to cb2World::SetTOIBudget, so a world that runs
+	/// late defers its TOI events instead of holding up the tick. Steps over the budget
+	/// are counted in the statistics.
+	void SetBudget(cb2World* world, float milliseconds);
+
+	/// Step every world once and wait for all of them. Listeners of the worlds are
+	/// called on the thread that steps their world.
+	void Step();
+
+	/// Get the settings and statistics of the worlds, in the order they were added.
+	int GetWorldCount() const { return m_worldCount; }
+	const cb2ScheduledWorld* GetWorld(int index) const;
+
+	/// Get the settings and statistics of a world, or NULL if it was not added.
+	const cb2ScheduledWorld* FindWorld(const cb2World* world) const;
+
+	/// Get the duration of the last Step, over all the worlds.
+	float GetLastStepTime() const { return m_lastStepTime; }
+
+	int GetThreadCount() const { return m_threadPool.GetThreadCount(); }
+
+private:
+
+	friend class cb2WorldStepTask;
+
+	int FindIndex(const cb2World* world) const;
+	void StepWorld(cb2ScheduledWorld* scheduled, cb2StackAllocator* allocator);
+
+	cb2ThreadPool m_threadPool;
+
+	// One stack allocator per thread.
+	cb2StackAllocator* m_allocators;
+
+	cb2ScheduledWorld* m_worlds;
+	int m_worldCount;
+	int m_worldCapacity;
+
+	// The worlds in the order they are handed out.
+	int* m_order;
+
+	float m_lastStepTime;
+};
+
+#endif
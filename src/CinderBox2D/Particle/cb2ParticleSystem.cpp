@@ -0,0 +1,1201 @@
+/*
+* Copyright (c) 2006-2010 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <CinderBox2D/Particle/cb2ParticleSystem.h>
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChildQuery.h>
+#include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
+#include <CinderBox2D/Common/cb2Draw.h>
+#include <CinderBox2D/Common/cb2ThreadPool.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
+#include <memory.h>
+
+// The most neighbors kept per particle. A compressed fluid has about twenty within
+// the kernel radius, further ones are dropped.
+const int cb2_maxParticleNeighbors = 32;
+
+// Particles and grid cells per task range.
+const int cb2_particleGrainSize = 256;
+const int cb2_particleCellGrainSize = 32;
+
+// Relaxation of the density constraint, relative to the size of its gradient.
+const float cb2_particleRelaxation = 0.01f;
+
+template <typename T>
+static void cb2GrowParticleBuffer(T** buffer, int count, int capacity)
+{
+	T* oldBuffer = *buffer;
+	*buffer = (T*)cb2Alloc(capacity * sizeof(T));
+	if (oldBuffer)
+	{
+		memcpy(*buffer, oldBuffer, count * sizeof(T));
+		cb2Free(oldBuffer);
+	}
+}
+
+class cb2ParticlePredictTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		ci::Vec2f* xs = system->m_positions;
+		ci::Vec2f* x0s = system->m_oldPositions;
+		ci::Vec2f* vs = system->m_velocities;
+		for (int i = begin; i < end; ++i)
+		{
+			ci::Vec2f v = damping * (vs[i] + h * gravity);
+			vs[i] = v;
+			x0s[i] = xs[i];
+			xs[i] += h * v;
+		}
+	}
+
+	cb2ParticleSystem* system;
+	ci::Vec2f gravity;
+	float damping;
+	float h;
+};
+
+class cb2ParticleNeighborTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		for (int i = begin; i < end; ++i)
+		{
+			system->FindNeighbors(i);
+		}
+	}
+
+	cb2ParticleSystem* system;
+};
+
+class cb2ParticleContactTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			system->FindContacts(i, threadIndex);
+		}
+	}
+
+	cb2ParticleSystem* system;
+};
+
+class cb2ParticleDensityTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		for (int i = begin; i < end; ++i)
+		{
+			system->ComputeLambda(i);
+		}
+	}
+
+	cb2ParticleSystem* system;
+};
+
+// The constraints are projected in Jacobi fashion: every particle gathers its
+// correction from the old positions, then all corrections are applied.
+class cb2ParticleProjectTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		for (int i = begin; i < end; ++i)
+		{
+			if (apply)
+			{
+				system->ProjectContacts(i);
+			}
+			else
+			{
+				system->Project(i);
+			}
+		}
+	}
+
+	cb2ParticleSystem* system;
+	bool apply;
+};
+
+class cb2ParticleFinishTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		for (int i = begin; i < end; ++i)
+		{
+			system->Finish(i, inv_h);
+		}
+	}
+
+	cb2ParticleSystem* system;
+	float inv_h;
+};
+
+// The velocity of water blends towards the weighted mean of its water neighbors.
+class cb2ParticleViscosityTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		const ci::Vec2f* xs = system->GetPositionBuffer();
+		const ci::Vec2f* vs = system->GetVelocityBuffer();
+		const unsigned int* flags = system->GetFlagsBuffer();
+		for (int i = begin; i < end; ++i)
+		{
+			ci::Vec2f v = vs[i];
+			if (flags[i] & cb2_granularParticle)
+			{
+				velocities[i] = v;
+				continue;
+			}
+
+			ci::Vec2f sum(0.0f, 0.0f);
+			float weight = 0.0f;
+			const int* neighbors = neighborLists + i * cb2_maxParticleNeighbors;
+			for (int k = 0; k < neighborCounts[i]; ++k)
+			{
+				int j = neighbors[k];
+				if (flags[j] & cb2_granularParticle)
+				{
+					continue;
+				}
+
+				float w = 1.0f - (xs[j] - xs[i]).length() * inverseRadius;
+				if (w > 0.0f)
+				{
+					sum += w * vs[j];
+					weight += w;
+				}
+			}
+
+			velocities[i] = weight > 0.0f ? v + viscosity * (sum / weight - v) : v;
+		}
+	}
+
+	const cb2ParticleSystem* system;
+	const int* neighborLists;
+	const int* neighborCounts;
+	ci::Vec2f* velocities;
+	float inverseRadius;
+	float viscosity;
+};
+
+// Collects the fixture children under a cell box for fixtures that use one proxy.
+struct cb2ParticleChildQuery
+{
+	bool QueryCallback(int childIndex)
+	{
+		children[count++] = childIndex;
+		return count < capacity;
+	}
+
+	int* children;
+	int count;
+	int capacity;
+};
+
+cb2ParticleSystem::cb2ParticleSystem(const cb2ParticleSystemDef* def, cb2World* world)
+{
+	cb2Assert(def->radius > 0.0f);
+	cb2Assert(def->density > 0.0f);
+	cb2Assert(def->iterations >= 1);
+	cb2Assert(0.0f <= def->viscosity && def->viscosity <= 1.0f);
+
+	m_def = *def;
+	m_world = world;
+	m_threadPool = NULL;
+
+	m_diameter = 2.0f * def->radius;
+	m_mass = def->density * m_diameter * m_diameter;
+
+	// The kernels of position based fluids in two dimensions, over two diameters.
+	float h = 2.0f * m_diameter;
+	m_kernelRadius = h;
+	m_inverseCellSize = 1.0f / h;
+	m_poly6 = 4.0f / (cb2_pi * h * h * h * h * h * h * h * h);
+	m_spiky = 30.0f / (cb2_pi * h * h * h * h * h);
+
+	// The rest density is that of particles one diameter apart on a square grid.
+	m_restDensity = 0.0f;
+	int n = (int)(h / m_diameter);
+	for (int i = -n; i <= n; ++i)
+	{
+		for (int j = -n; j <= n; ++j)
+		{
+			float r2 = (i * i + j * j) * m_diameter * m_diameter;
+			if (r2 < h * h)
+			{
+				float d = h * h - r2;
+				m_restDensity += m_poly6 * d * d * d;
+			}
+		}
+	}
+
+	m_positions = NULL;
+	m_velocities = NULL;
+	m_flags = NULL;
+	m_userData = NULL;
+	m_count = 0;
+	m_capacity = 0;
+	m_hasZombies = false;
+
+	m_oldPositions = NULL;
+	m_deltas = NULL;
+	m_lambdas = NULL;
+	m_neighborCounts = NULL;
+	m_neighbors = NULL;
+	m_contactStarts = NULL;
+	m_particleBuckets = NULL;
+
+	m_bucketStarts = NULL;
+	m_bucketCapacity = 0;
+	m_sorted = NULL;
+	m_bucketMask = 0;
+	m_cells = NULL;
+	m_cellCount = 0;
+
+	m_hitCapacity = 256;
+	m_hits = (cb2QueryHit*)cb2Alloc(m_hitCapacity * sizeof(cb2QueryHit));
+	m_cellBoxes = NULL;
+	m_candidates = NULL;
+	m_sortedCandidates = NULL;
+	m_candidateStarts = NULL;
+	m_candidateCount = 0;
+	m_candidateCapacity = 0;
+
+	m_threadContacts = NULL;
+	m_threadContactCounts = NULL;
+	m_threadContactCapacities = NULL;
+	m_threadCount = 0;
+	m_contacts = NULL;
+	m_contactCount = 0;
+	m_contactCapacity = 0;
+
+	m_prev = NULL;
+	m_next = NULL;
+}
+
+cb2ParticleSystem::~cb2ParticleSystem()
+{
+	cb2Free(m_positions);
+	cb2Free(m_velocities);
+	cb2Free(m_flags);
+	cb2Free(m_userData);
+	cb2Free(m_oldPositions);
+	cb2Free(m_deltas);
+	cb2Free(m_lambdas);
+	cb2Free(m_neighborCounts);
+	cb2Free(m_neighbors);
+	cb2Free(m_contactStarts);
+	cb2Free(m_particleBuckets);
+	cb2Free(m_bucketStarts);
+	cb2Free(m_sorted);
+	cb2Free(m_cells);
+	cb2Free(m_hits);
+	cb2Free(m_cellBoxes);
+	cb2Free(m_candidates);
+	cb2Free(m_sortedCandidates);
+	cb2Free(m_candidateStarts);
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		cb2Free(m_threadContacts[i]);
+	}
+	cb2Free(m_threadContacts);
+	cb2Free(m_threadContactCounts);
+	cb2Free(m_threadContactCapacities);
+	cb2Free(m_contacts);
+}
+
+void cb2ParticleSystem::Reserve(int count)
+{
+	if (count <= m_capacity)
+	{
+		return;
+	}
+
+	int capacity = cb2Max(2 * m_capacity, count);
+	cb2GrowParticleBuffer(&m_positions, m_count, capacity);
+	cb2GrowParticleBuffer(&m_velocities, m_count, capacity);
+	cb2GrowParticleBuffer(&m_flags, m_count, capacity);
+	cb2GrowParticleBuffer(&m_userData, m_count, capacity);
+
+	// The scratch arrays hold nothing between steps.
+	cb2Free(m_oldPositions);
+	cb2Free(m_deltas);
+	cb2Free(m_lambdas);
+	cb2Free(m_neighborCounts);
+	cb2Free(m_neighbors);
+	cb2Free(m_contactStarts);
+	cb2Free(m_particleBuckets);
+	cb2Free(m_sorted);
+	cb2Free(m_cells);
+	cb2Free(m_cellBoxes);
+	cb2Free(m_candidateStarts);
+	m_oldPositions = (ci::Vec2f*)cb2Alloc(capacity * sizeof(ci::Vec2f));
+	m_deltas = (ci::Vec2f*)cb2Alloc(capacity * sizeof(ci::Vec2f));
+	m_lambdas = (float*)cb2Alloc(capacity * sizeof(float));
+	m_neighborCounts = (int*)cb2Alloc(capacity * sizeof(int));
+	m_neighbors = (int*)cb2Alloc(capacity * cb2_maxParticleNeighbors * sizeof(int));
+	m_contactStarts = (int*)cb2Alloc((capacity + 1) * sizeof(int));
+	m_particleBuckets = (int*)cb2Alloc(capacity * sizeof(int));
+	m_sorted = (int*)cb2Alloc(capacity * sizeof(int));
+	m_cells = (int*)cb2Alloc(capacity * sizeof(int));
+	m_cellBoxes = (cb2AABB*)cb2Alloc(capacity * sizeof(cb2AABB));
+	m_candidateStarts = (int*)cb2Alloc((capacity + 1) * sizeof(int));
+
+	m_capacity = capacity;
+}
+
+int cb2ParticleSystem::CreateParticle(const cb2ParticleDef& def)
+{
+	return CreateParticles(&def, 1);
+}
+
+int cb2ParticleSystem::CreateParticles(const cb2ParticleDef* defs, int count)
+{
+	cb2Assert(m_world->IsLocked() == false);
+	if (m_world->IsLocked())
+	{
+		return -1;
+	}
+
+	Reserve(m_count + count);
+
+	int first = m_count;
+	for (int i = 0; i < count; ++i)
+	{
+		const cb2ParticleDef& def = defs[i];
+		m_positions[m_count] = def.position;
+		m_velocities[m_count] = def.velocity;
+		m_flags[m_count] = def.flags;
+		m_userData[m_count] = def.userData;
+		m_hasZombies = m_hasZombies || (def.flags & cb2_zombieParticle) != 0;
+		++m_count;
+	}
+
+	return first;
+}
+
+int cb2ParticleSystem::CreateParticlesInShape(const cb2Shape& shape, const cb2Transform& transform, const cb2ParticleDef& def)
+{
+	cb2AABB aabb;
+	shape.ComputeAABB(&aabb, transform, 0);
+	for (int i = 1; i < shape.GetChildCount(); ++i)
+	{
+		cb2AABB childAABB;
+		shape.ComputeAABB(&childAABB, transform, i);
+		aabb.Combine(childAABB);
+	}
+
+	int first = m_count;
+	cb2ParticleDef particle = def;
+	float r = m_def.radius;
+	for (float y = aabb.lowerBound.y + r; y <= aabb.upperBound.y - r; y += m_diameter)
+	{
+		for (float x = aabb.lowerBound.x + r; x <= aabb.upperBound.x - r; x += m_diameter)
+		{
+			particle.position.set(x, y);
+			if (shape.TestPoint(transform, particle.position))
+			{
+				CreateParticle(particle);
+			}
+		}
+	}
+
+	return first;
+}
+
+void cb2ParticleSystem::DestroyParticle(int index)
+{
+	cb2Assert(0 <= index && index < m_count);
+	m_flags[index] |= cb2_zombieParticle;
+	m_hasZombies = true;
+}
+
+void cb2ParticleSystem::SetParticleFlags(int index, unsigned int flags)
+{
+	cb2Assert(0 <= index && index < m_count);
+	m_flags[index] = flags;
+	m_hasZombies = m_hasZombies || (flags & cb2_zombieParticle) != 0;
+}
+
+void cb2ParticleSystem::RemoveZombies()
+{
+	int count = 0;
+	for (int i = 0; i < m_count; ++i)
+	{
+		if (m_flags[i] & cb2_zombieParticle)
+		{
+			continue;
+		}
+
+		m_positions[count] = m_positions[i];
+		m_velocities[count] = m_velocities[i];
+		m_flags[count] = m_flags[i];
+		m_userData[count] = m_userData[i];
+		++count;
+	}
+
+	m_count = count;
+	m_hasZombies = false;
+}
+
+inline int cb2ParticleSystem::ComputeBucket(int x, int y) const
+{
+	unsigned int h = (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u;
+	return (int)(h & (unsigned int)m_bucketMask);
+}
+
+void cb2ParticleSystem::BuildGrid()
+{
+	// Twice as many buckets as particles keeps the distinct cells in a bucket few.
+	int bucketCount = 16;
+	while (bucketCount < 2 * m_count)
+	{
+		bucketCount *= 2;
+	}
+
+	if (bucketCount + 1 > m_bucketCapacity)
+	{
+		cb2Free(m_bucketStarts);
+		m_bucketCapacity = bucketCount + 1;
+		m_bucketStarts = (int*)cb2Alloc(m_bucketCapacity * sizeof(int));
+	}
+	m_bucketMask = bucketCount - 1;
+
+	// Counting sort of the particles by bucket.
+	memset(m_bucketStarts, 0, (bucketCount + 1) * sizeof(int));
+	for (int i = 0; i < m_count; ++i)
+	{
+		const ci::Vec2f& p = m_positions[i];
+		int b = ComputeBucket((int)floorf(p.x * m_inverseCellSize), (int)floorf(p.y * m_inverseCellSize));
+		m_particleBuckets[i] = b;
+		++m_bucketStarts[b + 1];
+	}
+
+	m_cellCount = 0;
+	for (int b = 0; b < bucketCount; ++b)
+	{
+		if (m_bucketStarts[b + 1] > 0)
+		{
+			m_cells[m_cellCount++] = b;
+		}
+		m_bucketStarts[b + 1] += m_bucketStarts[b];
+	}
+
+	// Fill with a moving cursor per bucket, then restore the starts.
+	for (int i = 0; i < m_count; ++i)
+	{
+		m_sorted[m_bucketStarts[m_particleBuckets[i]]++] = i;
+	}
+	for (int b = bucketCount; b > 0; --b)
+	{
+		m_bucketStarts[b] = m_bucketStarts[b - 1];
+	}
+	m_bucketStarts[0] = 0;
+}
+
+void cb2ParticleSystem::FindNeighbors(int index)
+{
+	const ci::Vec2f p = m_positions[index];
+	int x = (int)floorf(p.x * m_inverseCellSize);
+	int y = (int)floorf(p.y * m_inverseCellSize);
+	float h2 = m_kernelRadius * m_kernelRadius;
+
+	int* neighbors = m_neighbors + index * cb2_maxParticleNeighbors;
+	int count = 0;
+
+	// Cells of the block may share a bucket; each bucket is visited once.
+	int buckets[9];
+	int bucketCount = 0;
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			int b = ComputeBucket(x + dx, y + dy);
+			bool seen = false;
+			for (int k = 0; k < bucketCount; ++k)
+			{
+				seen = seen || buckets[k] == b;
+			}
+
+			if (seen)
+			{
+				continue;
+			}
+			buckets[bucketCount++] = b;
+
+			for (int k = m_bucketStarts[b]; k < m_bucketStarts[b + 1]; ++k)
+			{
+				int j = m_sorted[k];
+				if (j != index && (m_positions[j] - p).lengthSquared() < h2 && count < cb2_maxParticleNeighbors)
+				{
+					neighbors[count++] = j;
+				}
+			}
+		}
+	}
+
+	m_neighborCounts[index] = count;
+}
+
+// The fixtures near the particles, with one batched query of the world for all
+// occupied cells of the grid.
+void cb2ParticleSystem::FindCandidates()
+{
+	float margin = m_def.radius + m_diameter;
+	for (int c = 0; c < m_cellCount; ++c)
+	{
+		int b = m_cells[c];
+		cb2AABB box;
+		box.lowerBound = m_positions[m_sorted[m_bucketStarts[b]]];
+		box.upperBound = box.lowerBound;
+		for (int k = m_bucketStarts[b]; k < m_bucketStarts[b + 1]; ++k)
+		{
+			int i = m_sorted[k];
+			box.lowerBound = cb2Min(box.lowerBound, cb2Min(m_positions[i], m_oldPositions[i]));
+			box.upperBound = cb2Max(box.upperBound, cb2Max(m_positions[i], m_oldPositions[i]));
+		}
+
+		ci::Vec2f r(margin, margin);
+		box.lowerBound -= r;
+		box.upperBound += r;
+		m_cellBoxes[c] = box;
+	}
+
+	int hitCount = m_world->QueryAABBs(m_cellBoxes, m_cellCount, m_hits, m_hitCapacity);
+	while (hitCount == m_hitCapacity)
+	{
+		cb2Free(m_hits);
+		m_hitCapacity *= 2;
+		m_hits = (cb2QueryHit*)cb2Alloc(m_hitCapacity * sizeof(cb2QueryHit));
+		hitCount = m_world->QueryAABBs(m_cellBoxes, m_cellCount, m_hits, m_hitCapacity);
+	}
+
+	// Fixtures with one proxy for all children are replaced by the children under the box.
+	const int k_maxChildren = 64;
+	int children[k_maxChildren];
+
+	m_candidateCount = 0;
+	memset(m_candidateStarts, 0, (m_cellCount + 1) * sizeof(int));
+	for (int i = 0; i < hitCount; ++i)
+	{
+		const cb2QueryHit& hit = m_hits[i];
+		cb2Fixture* fixture = hit.fixture;
+		const cb2Filter& filter = fixture->GetFilterData();
+		if (fixture->IsSensor() || (filter.categoryBits & m_def.maskBits) == 0 || (filter.maskBits & m_def.categoryBits) == 0)
+		{
+			continue;
+		}
+
+		int childCount = 1;
+		children[0] = hit.childIndex;
+		if (hit.childIndex == cb2ChainShape::e_allChildren)
+		{
+			cb2ParticleChildQuery query;
+			query.children = children;
+			query.count = 0;
+			query.capacity = k_maxChildren;
+			cb2QueryChildren(fixture->GetShape(), &query, m_cellBoxes[hit.queryIndex], fixture->GetBody()->GetTransform());
+			childCount = query.count;
+		}
+
+		if (m_candidateCount + childCount > m_candidateCapacity)
+		{
+			int capacity = cb2Max(2 * m_candidateCapacity, m_candidateCount + childCount + 64);
+			cb2GrowParticleBuffer(&m_candidates, m_candidateCount, capacity);
+			cb2Free(m_sortedCandidates);
+			m_sortedCandidates = (cb2ParticleCandidate*)cb2Alloc(capacity * sizeof(cb2ParticleCandidate));
+			m_candidateCapacity = capacity;
+		}
+
+		for (int k = 0; k < childCount; ++k)
+		{
+			cb2ParticleCandidate* candidate = m_candidates + m_candidateCount++;
+			candidate->fixture = fixture;
+			candidate->childIndex = children[k];
+			candidate->cell = hit.queryIndex;
+			++m_candidateStarts[hit.queryIndex + 1];
+		}
+	}
+
+	// Group the candidates by cell.
+	for (int c = 0; c < m_cellCount; ++c)
+	{
+		m_candidateStarts[c + 1] += m_candidateStarts[c];
+	}
+	for (int i = 0; i < m_candidateCount; ++i)
+	{
+		m_sortedCandidates[m_candidateStarts[m_candidates[i].cell]++] = m_candidates[i];
+	}
+	for (int c = m_cellCount; c > 0; --c)
+	{
+		m_candidateStarts[c] = m_candidateStarts[c - 1];
+	}
+	m_candidateStarts[0] = 0;
+}
+
+// Collide a particle with a fixture child. Returns false if they are farther apart
+// than the margin, otherwise the surface point and normal of the fixture.
+// Edges have two sides, the normal is taken on the side of the start position p0
+// so that a particle pushed past the edge within the step is pushed back.
+static bool cb2CollideParticle(const cb2Fixture* fixture, int childIndex, const ci::Vec2f& p0, const ci::Vec2f& p,
+								float radius, float margin, ci::Vec2f* normal, ci::Vec2f* point)
+{
+	cb2CircleShape circle;
+	circle.m_radius = radius;
+
+	cb2Transform xfB;
+	xfB.q.SetIdentity();
+	xfB.p = p;
+
+	const cb2Shape* shape = fixture->GetShape();
+	const cb2Transform& xfA = fixture->GetBody()->GetTransform();
+	cb2Manifold manifold;
+	switch (shape->GetType())
+	{
+	case cb2Shape::e_circle:
+		cb2CollideCircles(&manifold, (const cb2CircleShape*)shape, xfA, &circle, xfB, margin);
+		break;
+
+	case cb2Shape::e_polygon:
+		cb2CollidePolygonAndCircle(&manifold, (const cb2PolygonShape*)shape, xfA, &circle, xfB, margin);
+		break;
+
+	case cb2Shape::e_edge:
+		cb2CollideEdgeAndCircle(&manifold, (const cb2EdgeShape*)shape, xfA, &circle, xfB, margin);
+		break;
+
+	case cb2Shape::e_chain:
+		{
+			cb2EdgeShape edge;
+			((const cb2ChainShape*)shape)->GetChildEdge(&edge, childIndex);
+			cb2CollideEdgeAndCircle(&manifold, &edge, xfA, &circle, xfB, margin);
+		}
+		break;
+
+	case cb2Shape::e_capsule:
+		cb2CollideCapsuleAndCircle(&manifold, (const cb2CapsuleShape*)shape, xfA, &circle, xfB, margin);
+		break;
+
+	case cb2Shape::e_heightfield:
+		{
+			cb2EdgeShape edge;
+			((const cb2HeightfieldShape*)shape)->GetChildEdge(&edge, childIndex);
+			cb2CollideEdgeAndCircle(&manifold, &edge, xfA, &circle, xfB, margin);
+		}
+		break;
+
+	case cb2Shape::e_compound:
+		cb2CollidePolygonAndCircle(&manifold, ((const cb2CompoundShape*)shape)->GetChild(childIndex), xfA, &circle, xfB, margin);
+		break;
+
+	default:
+		manifold.pointCount = 0;
+		break;
+	}
+
+	if (manifold.pointCount == 0)
+	{
+		return false;
+	}
+
+	cb2WorldManifold worldManifold;
+	worldManifold.Initialize(&manifold, xfA, shape->m_radius, xfB, radius);
+	*normal = worldManifold.normal;
+	*point = worldManifold.points[0] - 0.5f * worldManifold.separations[0] * worldManifold.normal;
+
+	cb2Shape::Type type = shape->GetType();
+	bool twoSided = type == cb2Shape::e_edge || type == cb2Shape::e_chain || type == cb2Shape::e_heightfield;
+	if (twoSided && cb2Dot(*normal, p0 - *point) < 0.0f)
+	{
+		*normal = -*normal;
+	}
+	return true;
+}
+
+// Stop the particles of a cell at the first surface they crossed, then find their contacts.
+void cb2ParticleSystem::FindContacts(int cell, int threadIndex)
+{
+	int b = m_cells[cell];
+	const cb2ParticleCandidate* candidates = m_sortedCandidates + m_candidateStarts[cell];
+	int candidateCount = m_candidateStarts[cell + 1] - m_candidateStarts[cell];
+	if (candidateCount == 0)
+	{
+		return;
+	}
+
+	float radius = m_def.radius;
+	for (int k = m_bucketStarts[b]; k < m_bucketStarts[b + 1]; ++k)
+	{
+		int i = m_sorted[k];
+
+		// Only a particle that moved more than its radius can pass through a surface.
+		cb2RayCastInput input;
+		input.p1 = m_oldPositions[i];
+		input.p2 = m_positions[i];
+		input.maxFraction = 1.0f;
+		if ((input.p2 - input.p1).lengthSquared() > radius * radius)
+		{
+			ci::Vec2f normal;
+			bool hit = false;
+			for (int j = 0; j < candidateCount; ++j)
+			{
+				cb2RayCastOutput output;
+				if (candidates[j].fixture->RayCast(&output, input, candidates[j].childIndex))
+				{
+					input.maxFraction = output.fraction;
+					normal = output.normal;
+					hit = true;
+				}
+			}
+
+			if (hit)
+			{
+				m_positions[i] = input.p1 + input.maxFraction * (input.p2 - input.p1) + radius * normal;
+			}
+		}
+
+		for (int j = 0; j < candidateCount; ++j)
+		{
+			const cb2ParticleCandidate& candidate = candidates[j];
+			ci::Vec2f normal, point;
+			if (cb2CollideParticle(candidate.fixture, candidate.childIndex, m_oldPositions[i], m_positions[i],
+									radius, m_diameter, &normal, &point) == false)
+			{
+				continue;
+			}
+
+			if (m_threadContactCounts[threadIndex] == m_threadContactCapacities[threadIndex])
+			{
+				int capacity = cb2Max(2 * m_threadContactCapacities[threadIndex], 64);
+				cb2GrowParticleBuffer(m_threadContacts + threadIndex, m_threadContactCounts[threadIndex], capacity);
+				m_threadContactCapacities[threadIndex] = capacity;
+			}
+
+			cb2ParticleContact* contact = m_threadContacts[threadIndex] + m_threadContactCounts[threadIndex]++;
+			contact->index = i;
+			contact->body = candidate.fixture->GetBody();
+			contact->normal = normal;
+			contact->point = point;
+			contact->push = 0.0f;
+			cb2::setZero(contact->displacement);
+		}
+	}
+}
+
+// The Lagrange multiplier of the density constraint of a water particle.
+void cb2ParticleSystem::ComputeLambda(int index)
+{
+	m_lambdas[index] = 0.0f;
+	if (m_flags[index] & cb2_granularParticle)
+	{
+		return;
+	}
+
+	const ci::Vec2f p = m_positions[index];
+	float h = m_kernelRadius;
+	float invRestDensity = 1.0f / m_restDensity;
+
+	float density = m_poly6 * h * h * h * h * h * h;
+	ci::Vec2f gradient(0.0f, 0.0f);
+	float sum = 0.0f;
+
+	const int* neighbors = m_neighbors + index * cb2_maxParticleNeighbors;
+	for (int k = 0; k < m_neighborCounts[index]; ++k)
+	{
+		int j = neighbors[k];
+		if (m_flags[j] & cb2_granularParticle)
+		{
+			continue;
+		}
+
+		ci::Vec2f d = p - m_positions[j];
+		float r2 = d.lengthSquared();
+		if (r2 >= h * h)
+		{
+			continue;
+		}
+
+		float q = h * h - r2;
+		density += m_poly6 * q * q * q;
+
+		float r = sqrtf(r2);
+		if (r > cb2_epsilon)
+		{
+			ci::Vec2f g = (m_spiky * (h - r) * (h - r) * invRestDensity / r) * d;
+			gradient += g;
+			sum += g.lengthSquared();
+		}
+	}
+
+	// Water only pushes apart, so free surfaces do not clump.
+	float C = density * invRestDensity - 1.0f;
+	if (C <= 0.0f)
+	{
+		return;
+	}
+
+	sum += gradient.lengthSquared();
+	float relaxation = cb2_particleRelaxation * m_spiky * m_spiky * h * h * h * h * invRestDensity * invRestDensity;
+	m_lambdas[index] = C / (sum + relaxation);
+}
+
+void cb2ParticleSystem::Project(int index)
+{
+	const ci::Vec2f p = m_positions[index];
+	const ci::Vec2f dp = p - m_oldPositions[index];
+	bool granular = (m_flags[index] & cb2_granularParticle) != 0;
+	float h = m_kernelRadius;
+	float d = m_diameter;
+	float friction = m_def.friction;
+	float invRestDensity = 1.0f / m_restDensity;
+	float lambda = m_lambdas[index];
+
+	ci::Vec2f delta(0.0f, 0.0f);
+	ci::Vec2f contactDelta(0.0f, 0.0f);
+	int contactCount = 0;
+
+	const int* neighbors = m_neighbors + index * cb2_maxParticleNeighbors;
+	for (int k = 0; k < m_neighborCounts[index]; ++k)
+	{
+		int j = neighbors[k];
+		ci::Vec2f n = p - m_positions[j];
+		float r2 = n.lengthSquared();
+		if (r2 >= h * h || r2 < cb2_epsilon * cb2_epsilon)
+		{
+			continue;
+		}
+
+		float r = sqrtf(r2);
+		n *= 1.0f / r;
+
+		bool granularPair = granular || (m_flags[j] & cb2_granularParticle) != 0;
+		if (granularPair == false)
+		{
+			// Density constraints of both particles.
+			delta += (invRestDensity * (lambda + m_lambdas[j]) * m_spiky * (h - r) * (h - r)) * n;
+			continue;
+		}
+
+		if (r >= d)
+		{
+			continue;
+		}
+
+		// Each particle of an overlapping pair takes half of the correction. The
+		// relative slip of the step is cancelled within the friction cone.
+		float push = d - r;
+		ci::Vec2f correction = (0.5f * push) * n;
+		ci::Vec2f slip = dp - (m_positions[j] - m_oldPositions[j]);
+		slip -= cb2Dot(slip, n) * n;
+		float slipLength = slip.length();
+		if (slipLength > cb2_epsilon)
+		{
+			correction -= (0.5f * cb2Min(1.0f, friction * push / slipLength)) * slip;
+		}
+
+		contactDelta += correction;
+		++contactCount;
+	}
+
+	if (contactCount > 0)
+	{
+		delta += contactDelta / (float)contactCount;
+	}
+
+	// The corrections of a step add up to at most one diameter, the contact margin,
+	// so a particle is never pushed through a surface it has no contact with.
+	float maxCorrection = d / m_def.iterations;
+	float length = delta.length();
+	if (length > maxCorrection)
+	{
+		delta *= maxCorrection / length;
+	}
+
+	m_deltas[index] = delta;
+}
+
+// Apply the correction of a particle and push it out of the fixtures it touches.
+// A particle pinched by a body against the ground is pushed out of the ground last,
+// so it may overlap the body but never leaves the world.
+void cb2ParticleSystem::ProjectContacts(int index)
+{
+	ci::Vec2f p = m_positions[index] + m_deltas[index];
+	float radius = m_def.radius;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int k = m_contactStarts[index]; k < m_contactStarts[index + 1]; ++k)
+		{
+			cb2ParticleContact* contact = m_contacts + k;
+			if ((contact->body->GetType() == cb2_dynamicBody) != (pass == 0))
+			{
+				continue;
+			}
+
+			float separation = cb2Dot(contact->normal, p - contact->point) - radius;
+			if (separation < 0.0f)
+			{
+				p -= separation * contact->normal;
+				contact->push -= separation;
+			}
+		}
+	}
+	m_positions[index] = p;
+}
+
+// Friction with the fixtures and the new velocity.
+void cb2ParticleSystem::Finish(int index, float inv_h)
+{
+	ci::Vec2f p = m_positions[index];
+	float friction = m_def.friction;
+	for (int k = m_contactStarts[index]; k < m_contactStarts[index + 1]; ++k)
+	{
+		cb2ParticleContact* contact = m_contacts + k;
+		contact->displacement = contact->push * contact->normal;
+		if (contact->push == 0.0f)
+		{
+			continue;
+		}
+
+		// The slip of the particle over the surface during the step.
+		ci::Vec2f surface = contact->body->GetLinearVelocityFromWorldPoint(contact->point);
+		ci::Vec2f slip = (p - m_oldPositions[index]) * inv_h - surface;
+		slip -= cb2Dot(slip, contact->normal) * contact->normal;
+		float slipLength = slip.length();
+		if (slipLength > cb2_epsilon)
+		{
+			ci::Vec2f correction = -(cb2Min(1.0f, friction * contact->push * inv_h / slipLength) / inv_h) * slip;
+			p += correction;
+			contact->displacement += correction;
+		}
+	}
+
+	m_positions[index] = p;
+	m_velocities[index] = inv_h * (p - m_oldPositions[index]);
+}
+
+// Every correction made by a fixture gave the particle momentum, the body gets the
+// opposite. Resting water keeps pushing, so a sleeping body is only woken by an
+// impulse that would move it faster than the sleep tolerance.
+void cb2ParticleSystem::ApplyImpulses(float inv_h)
+{
+	float scale = -m_mass * inv_h;
+	for (int k = 0; k < m_contactCount; ++k)
+	{
+		const cb2ParticleContact& contact = m_contacts[k];
+		cb2Body* body = contact.body;
+		if (body->GetType() != cb2_dynamicBody || contact.push == 0.0f)
+		{
+			continue;
+		}
+
+		ci::Vec2f impulse = scale * contact.displacement;
+		bool wake = impulse.length() > cb2_linearSleepTolerance * body->GetMass();
+		body->ApplyLinearImpulse(impulse, contact.point, wake);
+	}
+}
+
+void cb2ParticleSystem::Run(cb2Task* task, int count, int grainSize)
+{
+	if (m_threadPool && count > grainSize)
+	{
+		m_threadPool->ParallelFor(task, count, grainSize);
+	}
+	else if (count > 0)
+	{
+		task->Execute(0, count, 0);
+	}
+}
+
+void cb2ParticleSystem::Step(float h, const ci::Vec2f& gravity, cb2ThreadPool* threadPool)
+{
+	m_threadPool = threadPool;
+	m_contactCount = 0;
+
+	if (m_hasZombies)
+	{
+		RemoveZombies();
+	}
+
+	if (m_count == 0 || h <= 0.0f)
+	{
+		return;
+	}
+
+	int threadCount = threadPool ? threadPool->GetThreadCount() : 1;
+	if (threadCount > m_threadCount)
+	{
+		cb2GrowParticleBuffer(&m_threadContacts, m_threadCount, threadCount);
+		cb2GrowParticleBuffer(&m_threadContactCounts, m_threadCount, threadCount);
+		cb2GrowParticleBuffer(&m_threadContactCapacities, m_threadCount, threadCount);
+		for (int i = m_threadCount; i < threadCount; ++i)
+		{
+			m_threadContacts[i] = NULL;
+			m_threadContactCapacities[i] = 0;
+		}
+		m_threadCount = threadCount;
+	}
+
+	// Integrate the velocities and predict the positions.
+	{
+		cb2ParticlePredictTask task;
+		task.system = this;
+		task.gravity = m_def.gravityScale * gravity;
+		task.damping = 1.0f / (1.0f + h * m_def.damping);
+		task.h = h;
+		Run(&task, m_count, cb2_particleGrainSize);
+	}
+
+	BuildGrid();
+
+	{
+		cb2ParticleNeighborTask task;
+		task.system = this;
+		Run(&task, m_count, cb2_particleGrainSize);
+	}
+
+	// Contacts with the fixtures, gathered per thread and then put in particle order.
+	FindCandidates();
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		m_threadContactCounts[i] = 0;
+	}
+
+	if (m_candidateCount > 0)
+	{
+		cb2ParticleContactTask task;
+		task.system = this;
+		Run(&task, m_cellCount, cb2_particleCellGrainSize);
+	}
+
+	int contactCount = 0;
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		contactCount += m_threadContactCounts[i];
+	}
+
+	if (contactCount > m_contactCapacity)
+	{
+		cb2Free(m_contacts);
+		m_contactCapacity = cb2Max(2 * m_contactCapacity, contactCount);
+		m_contacts = (cb2ParticleContact*)cb2Alloc(m_contactCapacity * sizeof(cb2ParticleContact));
+	}
+
+	memset(m_contactStarts, 0, (m_count + 1) * sizeof(int));
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		for (int k = 0; k < m_threadContactCounts[i]; ++k)
+		{
+			++m_contactStarts[m_threadContacts[i][k].index + 1];
+		}
+	}
+	for (int i = 0; i < m_count; ++i)
+	{
+		m_contactStarts[i + 1] += m_contactStarts[i];
+	}
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		for (int k = 0; k < m_threadContactCounts[i]; ++k)
+		{
+			const cb2ParticleContact& contact = m_threadContacts[i][k];
+			m_contacts[m_contactStarts[contact.index]++] = contact;
+		}
+	}
+	for (int i = m_count; i > 0; --i)
+	{
+		m_contactStarts[i] = m_contactStarts[i - 1];
+	}
+	m_contactStarts[0] = 0;
+	m_contactCount = contactCount;
+
+	// Project the particle constraints, then the fixture contacts.
+	for (int iteration = 0; iteration < m_def.iterations; ++iteration)
+	{
+		cb2ParticleDensityTask densityTask;
+		densityTask.system = this;
+		Run(&densityTask, m_count, cb2_particleGrainSize);
+
+		cb2ParticleProjectTask projectTask;
+		projectTask.system = this;
+		projectTask.apply = false;
+		Run(&projectTask, m_count, cb2_particleGrainSize);
+
+		projectTask.apply = true;
+		Run(&projectTask, m_count, cb2_particleGrainSize);
+	}
+
+	float inv_h = 1.0f / h;
+	{
+		cb2ParticleFinishTask task;
+		task.system = this;
+		task.inv_h = inv_h;
+		Run(&task, m_count, cb2_particleGrainSize);
+	}
+
+	if (m_def.viscosity > 0.0f)
+	{
+		cb2ParticleViscosityTask task;
+		task.system = this;
+		task.neighborLists = m_neighbors;
+		task.neighborCounts = m_neighborCounts;
+		task.velocities = m_deltas;
+		task.inverseRadius = 1.0f / m_kernelRadius;
+		task.viscosity = m_def.viscosity;
+		Run(&task, m_count, cb2_particleGrainSize);
+		memcpy(m_velocities, m_deltas, m_count * sizeof(ci::Vec2f));
+	}
+
+	ApplyImpulses(inv_h);
+}
+
+void cb2ParticleSystem::ShiftOrigin(const ci::Vec2f& newOrigin)
+{
+	for (int i = 0; i < m_count; ++i)
+	{
+		m_positions[i] -= newOrigin;
+	}
+}
+
+void cb2ParticleSystem::Draw(cb2Draw* draw) const
+{
+	cb2Color water(0.3f, 0.5f, 0.9f);
+	cb2Color sand(0.8f, 0.7f, 0.4f);
+	for (int i = 0; i < m_count; ++i)
+	{
+		if ((m_flags[i] & cb2_zombieParticle) == 0)
+		{
+			draw->DrawCircle(m_positions[i], m_def.radius, (m_flags[i] & cb2_granularParticle) ? sand : water);
+		}
+	}
+}
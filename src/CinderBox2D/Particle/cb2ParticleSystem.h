@@ -0,0 +1,294 @@
+/*
+* Copyright (c) 2006-2010 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CB2_PARTICLE_SYSTEM_H
+#define CB2_PARTICLE_SYSTEM_H
+
+#include <CinderBox2D/Collision/cb2Collision.h>
+
+class cb2Body;
+class cb2Draw;
+class cb2Fixture;
+class cb2Task;
+class cb2ThreadPool;
+class cb2World;
+struct cb2QueryHit;
+
+/// The behavior of a particle.
+enum cb2ParticleFlag
+{
+	/// Water keeps its density, it flows and splashes.
+	cb2_waterParticle = 0,
+
+	/// Grains keep their distance and stick by friction, they pile up like sand.
+	cb2_granularParticle = 0x0001,
+
+	/// The particle is removed at the start of the next step.
+	cb2_zombieParticle = 0x0002
+};
+
+/// A particle definition.
+struct cb2ParticleDef
+{
+	cb2ParticleDef()
+	{
+		flags = cb2_waterParticle;
+		cb2::setZero(position);
+		cb2::setZero(velocity);
+		userData = NULL;
+	}
+
+	/// See cb2ParticleFlag.
+	unsigned int flags;
+
+	/// The world position of the particle.
+	ci::Vec2f position;
+
+	/// The world velocity of the particle.
+	ci::Vec2f velocity;
+
+	/// Use this to store application specific particle data.
+	void* userData;
+};
+
+/// A particle system definition. All particles of a system have the same size.
+struct cb2ParticleSystemDef
+{
+	cb2ParticleSystemDef()
+	{
+		radius = 0.05f;
+		density = 1.0f;
+		gravityScale = 1.0f;
+		damping = 0.0f;
+		viscosity = 0.05f;
+		friction = 0.3f;
+		iterations = 3;
+		categoryBits = 0x0001;
+		maskBits = 0xFFFF;
+	}
+
+	/// The radius of the particles. Particles in a fluid at rest are one diameter apart.
+	float radius;
+
+	/// The density of a particle, usually in kg/m^2. A particle has the mass of a square
+	/// of one diameter, so bodies of a lower density float.
+	float density;
+
+	/// Scale the gravity of the world for the particles.
+	float gravityScale;
+
+	/// Linear damping of the particle velocities.
+	float damping;
+
+	/// Blend of water velocities towards the mean of their neighbors, in [0,1] per step.
+	float viscosity;
+
+	/// Friction of grains with each other and of all particles with fixtures.
+	float friction;
+
+	/// The constraint iterations of each step.
+	int iterations;
+
+	/// The fixtures hit by the particles, tested as in cb2ContactFilter::ShouldCollide.
+	/// Sensors are never hit.
+	unsigned short categoryBits;
+	unsigned short maskBits;
+};
+
+/// Many small particles stepped by cb2World, without bodies, fixtures or broad-phase
+/// proxies. The particle state is kept in arrays indexed by particle. The neighbors
+/// of each particle are found with a uniform grid stored in a hash table, and each step
+/// projects position constraints on the predicted positions: a density constraint for
+/// water (position based fluids) and a contact constraint with friction for grains.
+/// The particles collide with the fixtures of the world, found with one batched query
+/// per step, and push back on the bodies with impulses. The work is split across the
+/// threads of the world.
+/// Particle indices stay valid until a particle is destroyed. Then the particles after
+/// it move down at the start of the next step, keeping their order.
+class cb2ParticleSystem
+{
+public:
+
+	/// Create a particle. Returns the index of the particle.
+	/// @warning This function is locked during callbacks.
+	int CreateParticle(const cb2ParticleDef& def);
+
+	/// Create many particles at once. Returns the index of the first one.
+	/// @warning This function is locked during callbacks.
+	int CreateParticles(const cb2ParticleDef* defs, int count);
+
+	/// Fill a shape with particles one diameter apart on a square grid.
+	/// Returns the index of the first particle, they are created one after the other.
+	/// @param def the flags, velocity and user data of the particles; the position is ignored.
+	int CreateParticlesInShape(const cb2Shape& shape, const cb2Transform& transform, const cb2ParticleDef& def);
+
+	/// Destroy a particle at the start of the next step.
+	void DestroyParticle(int index);
+
+	/// Reserve room for this many particles, so creating them and stepping do not allocate.
+	void Reserve(int count);
+
+	/// Get the number of particles, including the ones destroyed since the last step.
+	int GetParticleCount() const { return m_count; }
+
+	/// Get the particle arrays, indexed by particle. They may move when particles are created.
+	ci::Vec2f* GetPositionBuffer() { return m_positions; }
+	const ci::Vec2f* GetPositionBuffer() const { return m_positions; }
+	ci::Vec2f* GetVelocityBuffer() { return m_velocities; }
+	const ci::Vec2f* GetVelocityBuffer() const { return m_velocities; }
+	const unsigned int* GetFlagsBuffer() const { return m_flags; }
+	void** GetUserDataBuffer() { return m_userData; }
+
+	/// Change the flags of a particle.
+	void SetParticleFlags(int index, unsigned int flags);
+
+	/// Get the radius of the particles.
+	float GetRadius() const { return m_def.radius; }
+
+	/// Get the mass of one particle.
+	float GetParticleMass() const { return m_mass; }
+
+	/// Get the number of particle and fixture contacts of the last step.
+	int GetBodyContactCount() const { return m_contactCount; }
+
+	/// Get the next particle system in the world list.
+	cb2ParticleSystem* GetNext() { return m_next; }
+	const cb2ParticleSystem* GetNext() const { return m_next; }
+
+	/// Get the parent world.
+	cb2World* GetWorld() { return m_world; }
+
+	/// Draw the particles as circles.
+	void Draw(cb2Draw* draw) const;
+
+	/// Shift the particles with the world origin.
+	void ShiftOrigin(const ci::Vec2f& newOrigin);
+
+private:
+
+	friend class cb2World;
+	friend class cb2ParticlePredictTask;
+	friend class cb2ParticleNeighborTask;
+	friend class cb2ParticleDensityTask;
+	friend class cb2ParticleProjectTask;
+	friend class cb2ParticleContactTask;
+	friend class cb2ParticleFinishTask;
+
+	// A particle touching a fixture. The normal points out of the fixture and the
+	// contact is a plane through the surface point.
+	struct cb2ParticleContact
+	{
+		int index;
+		cb2Body* body;
+		ci::Vec2f normal;
+		ci::Vec2f point;
+		float push;
+		ci::Vec2f displacement;
+	};
+
+	// A fixture child near a cell of the grid.
+	struct cb2ParticleCandidate
+	{
+		cb2Fixture* fixture;
+		int childIndex;
+		int cell;
+	};
+
+	cb2ParticleSystem(const cb2ParticleSystemDef* def, cb2World* world);
+	~cb2ParticleSystem();
+
+	void Step(float h, const ci::Vec2f& gravity, cb2ThreadPool* threadPool);
+
+	void RemoveZombies();
+	void BuildGrid();
+	void FindCandidates();
+	void FindNeighbors(int index);
+	void FindContacts(int cell, int threadIndex);
+	void ComputeLambda(int index);
+	void Project(int index);
+	void ProjectContacts(int index);
+	void Finish(int index, float inv_h);
+	void ApplyImpulses(float inv_h);
+	void Run(cb2Task* task, int count, int grainSize);
+
+	int ComputeBucket(int x, int y) const;
+
+	cb2ParticleSystemDef m_def;
+	cb2World* m_world;
+	cb2ThreadPool* m_threadPool;
+
+	// Derived from the definition.
+	float m_mass;
+	float m_diameter;
+	float m_kernelRadius;
+	float m_inverseCellSize;
+	float m_restDensity;
+	float m_poly6;
+	float m_spiky;
+
+	// One entry per particle.
+	ci::Vec2f* m_positions;
+	ci::Vec2f* m_velocities;
+	unsigned int* m_flags;
+	void** m_userData;
+	int m_count;
+	int m_capacity;
+	bool m_hasZombies;
+
+	// Scratch arrays of the step, also one entry per particle.
+	ci::Vec2f* m_oldPositions;
+	ci::Vec2f* m_deltas;
+	float* m_lambdas;
+	int* m_neighborCounts;
+	int* m_neighbors;
+	int* m_contactStarts;
+	int* m_particleBuckets;
+
+	// The grid. The particles of bucket b are m_sorted[m_bucketStarts[b], m_bucketStarts[b + 1]).
+	// The occupied buckets are listed in m_cells.
+	int* m_bucketStarts;
+	int m_bucketCapacity;
+	int* m_sorted;
+	int m_bucketMask;
+	int* m_cells;
+	int m_cellCount;
+
+	// The fixtures near each occupied cell, in cell order.
+	cb2QueryHit* m_hits;
+	int m_hitCapacity;
+	cb2AABB* m_cellBoxes;
+	cb2ParticleCandidate* m_candidates;
+	cb2ParticleCandidate* m_sortedCandidates;
+	int* m_candidateStarts;
+	int m_candidateCount;
+	int m_candidateCapacity;
+
+	// The contacts found by each thread, then in particle order.
+	cb2ParticleContact** m_threadContacts;
+	int* m_threadContactCounts;
+	int* m_threadContactCapacities;
+	int m_threadCount;
+	cb2ParticleContact* m_contacts;
+	int m_contactCount;
+	int m_contactCapacity;
+
+	cb2ParticleSystem* m_prev;
+	cb2ParticleSystem* m_next;
+};
+
+#endif
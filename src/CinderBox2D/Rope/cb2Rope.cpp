@@ -18,6 +18,14 @@
 
 #include <CinderBox2D/Rope/cb2Rope.h>
 #include <CinderBox2D/Common/cb2Draw.h>
+#include <CinderBox2D/Collision/Shapes/cb2ChainShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CircleShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2EdgeShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2PolygonShape.h>
+#include <CinderBox2D/Collision/Shapes/cb2CapsuleShape.h>
+#include <CinderBox2D/Dynamics/cb2Body.h>
+#include <CinderBox2D/Dynamics/cb2Fixture.h>
+#include <CinderBox2D/Dynamics/cb2World.h>
 
 cb2Rope::cb2Rope()
 {
@@ -30,6 +38,13 @@ cb2Rope::cb2Rope()
 	m_as = NULL;
 	m_k2 = 1.0f;
 	m_k3 = 0.1f;
+	m_world = NULL;
+	m_radius = 0.0f;
+	m_hits = NULL;
+	m_hitCapacity = 0;
+	m_candidates = NULL;
+	m_candidateCount = 0;
+	m_candidateCapacity = 0;
 }
 
 cb2Rope::~cb2Rope()
@@ -40,6 +55,8 @@ cb2Rope::~cb2Rope()
 	cb2Free(m_ims);
 	cb2Free(m_Ls);
 	cb2Free(m_as);
+	cb2Free(m_hits);
+	cb2Free(m_candidates);
 }
 
 void cb2Rope::Initialize(const cb2RopeDef* def)
@@ -99,6 +116,8 @@ void cb2Rope::Initialize(const cb2RopeDef* def)
 	m_damping = def->damping;
 	m_k2 = def->k2;
 	m_k3 = def->k3;
+	m_world = def->world;
+	m_radius = def->radius;
 }
 
 void cb2Rope::Step(float h, int iterations)
@@ -122,11 +141,22 @@ void cb2Rope::Step(float h, int iterations)
 
 	}
 
+	if (m_world)
+	{
+		FindCandidates();
+		SolveSweeps();
+	}
+
 	for (int i = 0; i < iterations; ++i)
 	{
 		SolveC2();
 		SolveC3();
 		SolveC2();
+
+		if (m_candidateCount > 0)
+		{
+			SolveCollisions();
+		}
 	}
 
 	float inv_h = 1.0f / h;
@@ -248,6 +278,179 @@ void cb2Rope::SolveC3()
 	}
 }
 
+// One batched query with the box swept by the whole rope this step.
+void cb2Rope::FindCandidates()
+{
+	cb2AABB aabb;
+	aabb.lowerBound = cb2Min(m_p0s[0], m_ps[0]);
+	aabb.upperBound = cb2Max(m_p0s[0], m_ps[0]);
+	for (int i = 1; i < m_count; ++i)
+	{
+		aabb.lowerBound = cb2Min(aabb.lowerBound, cb2Min(m_p0s[i], m_ps[i]));
+		aabb.upperBound = cb2Max(aabb.upperBound, cb2Max(m_p0s[i], m_ps[i]));
+	}
+	ci::Vec2f r(m_radius, m_radius);
+	aabb.lowerBound -= r;
+	aabb.upperBound += r;
+
+	if (m_hitCapacity == 0)
+	{
+		m_hitCapacity = 16;
+		m_hits = (cb2QueryHit*)cb2Alloc(m_hitCapacity * sizeof(cb2QueryHit));
+	}
+
+	int hitCount = m_world->QueryAABBs(&aabb, 1, m_hits, m_hitCapacity);
+	while (hitCount == m_hitCapacity)
+	{
+		cb2Free(m_hits);
+		m_hitCapacity *= 2;
+		m_hits = (cb2QueryHit*)cb2Alloc(m_hitCapacity * sizeof(cb2QueryHit));
+		hitCount = m_world->QueryAABBs(&aabb, 1, m_hits, m_hitCapacity);
+	}
+
+	if (hitCount > m_candidateCapacity)
+	{
+		cb2Free(m_candidates);
+		m_candidateCapacity = m_hitCapacity;
+		m_candidates = (cb2RopeCandidate*)cb2Alloc(m_candidateCapacity * sizeof(cb2RopeCandidate));
+	}
+
+	m_candidateCount = 0;
+	for (int i = 0; i < hitCount; ++i)
+	{
+		cb2Fixture* fixture = m_hits[i].fixture;
+		if (fixture->IsSensor())
+		{
+			continue;
+		}
+
+		cb2RopeCandidate* candidate = m_candidates + m_candidateCount++;
+		candidate->fixture = fixture;
+		candidate->childIndex = m_hits[i].childIndex;
+		candidate->aabb = fixture->GetAABB(m_hits[i].childIndex);
+	}
+}
+
+// Stop the vertices at the first surface they crossed this step, so fast ropes do
+// not tunnel through thin shapes.
+void cb2Rope::SolveSweeps()
+{
+	for (int i = 0; i < m_count; ++i)
+	{
+		if (m_ims[i] == 0.0f)
+		{
+			continue;
+		}
+
+		cb2RayCastInput input;
+		input.p1 = m_p0s[i];
+		input.p2 = m_ps[i];
+		input.maxFraction = 1.0f;
+		if (input.p1 == input.p2)
+		{
+			continue;
+		}
+
+		ci::Vec2f normal;
+		bool hit = false;
+		for (int j = 0; j < m_candidateCount; ++j)
+		{
+			const cb2RopeCandidate& candidate = m_candidates[j];
+			cb2RayCastOutput output;
+			if (candidate.fixture->RayCast(&output, input, candidate.childIndex))
+			{
+				input.maxFraction = output.fraction;
+				normal = output.normal;
+				hit = true;
+			}
+		}
+
+		if (hit)
+		{
+			m_ps[i] = input.p1 + input.maxFraction * (input.p2 - input.p1) + m_radius * normal;
+		}
+	}
+}
+
+// Push the vertices out of the candidates along the contact normals. A vertex
+// is a circle of the collision radius.
+void cb2Rope::SolveCollisions()
+{
+	cb2CircleShape circle;
+	circle.m_radius = m_radius;
+
+	cb2Transform xfB;
+	xfB.SetIdentity();
+
+	for (int i = 0; i < m_count; ++i)
+	{
+		if (m_ims[i] == 0.0f)
+		{
+			continue;
+		}
+
+		for (int j = 0; j < m_candidateCount; ++j)
+		{
+			const cb2RopeCandidate& candidate = m_candidates[j];
+			ci::Vec2f p = m_ps[i];
+			if (p.x + m_radius < candidate.aabb.lowerBound.x || p.x - m_radius > candidate.aabb.upperBound.x ||
+				p.y + m_radius < candidate.aabb.lowerBound.y || p.y - m_radius > candidate.aabb.upperBound.y)
+			{
+				continue;
+			}
+
+			const cb2Shape* shape = candidate.fixture->GetShape();
+			const cb2Transform& xfA = candidate.fixture->GetBody()->GetTransform();
+			xfB.p = p;
+
+			cb2Manifold manifold;
+			switch (shape->GetType())
+			{
+			case cb2Shape::e_circle:
+				cb2CollideCircles(&manifold, (const cb2CircleShape*)shape, xfA, &circle, xfB);
+				break;
+
+			case cb2Shape::e_polygon:
+				cb2CollidePolygonAndCircle(&manifold, (const cb2PolygonShape*)shape, xfA, &circle, xfB);
+				break;
+
+			case cb2Shape::e_edge:
+				cb2CollideEdgeAndCircle(&manifold, (const cb2EdgeShape*)shape, xfA, &circle, xfB);
+				break;
+
+			case cb2Shape::e_chain:
+				{
+					cb2EdgeShape edge;
+					((const cb2ChainShape*)shape)->GetChildEdge(&edge, candidate.childIndex);
+					cb2CollideEdgeAndCircle(&manifold, &edge, xfA, &circle, xfB);
+				}
+				break;
+
+			case cb2Shape::e_capsule:
+				cb2CollideCapsuleAndCircle(&manifold, (const cb2CapsuleShape*)shape, xfA, &circle, xfB);
+				break;
+
+			default:
+				manifold.pointCount = 0;
+				break;
+			}
+
+			if (manifold.pointCount == 0)
+			{
+				continue;
+			}
+
+			cb2WorldManifold worldManifold;
+			worldManifold.Initialize(&manifold, xfA, shape->m_radius, xfB, m_radius);
+			float separation = worldManifold.separations[0];
+			if (separation < 0.0f)
+			{
+				m_ps[i] = p - separation * worldManifold.normal;
+			}
+		}
+	}
+}
+
 void cb2Rope::Draw(cb2Draw* draw) const
 {
 	cb2Color c(0.4f, 0.5f, 0.7f);
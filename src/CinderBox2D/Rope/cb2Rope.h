@@ -19,9 +19,12 @@
 #ifndef CB2_ROPE_H
 #define CB2_ROPE_H
 
-#include <CinderBox2D/Common/cb2Math.h>
+#include <CinderBox2D/Collision/cb2Collision.h>
 
 class cb2Draw;
+class cb2Fixture;
+class cb2World;
+struct cb2QueryHit;
 
 /// 
 struct cb2RopeDef
@@ -35,6 +38,8 @@ struct cb2RopeDef
 		damping = 0.1f;
 		k2 = 0.9f;
 		k3 = 0.1f;
+		world = NULL;
+		radius = 0.05f;
 	}
 
 	///
@@ -57,6 +62,14 @@ struct cb2RopeDef
 
 	/// Bending stiffness. Values above 0.5 can make the simulation blow up.
 	float k3;
+
+	/// Push the vertices out of the fixtures of this world, NULL for no collision.
+	/// The rope does not push back on the bodies and sensors are ignored. Step the
+	/// rope after the world. cb2RopeSystem does not collide.
+	cb2World* world;
+
+	/// The collision radius of the vertices.
+	float radius;
 };
 
 /// 
@@ -92,8 +105,19 @@ public:
 
 private:
 
+	// A fixture child near the rope, found once per step.
+	struct cb2RopeCandidate
+	{
+		cb2Fixture* fixture;
+		int childIndex;
+		cb2AABB aabb;
+	};
+
 	void SolveC2();
 	void SolveC3();
+	void FindCandidates();
+	void SolveSweeps();
+	void SolveCollisions();
 
 	int m_count;
 	ci::Vec2f* m_ps;
@@ -110,6 +134,14 @@ private:
 
 	float m_k2;
 	float m_k3;
+
+	cb2World* m_world;
+	float m_radius;
+	cb2QueryHit* m_hits;
+	int m_hitCapacity;
+	cb2RopeCandidate* m_candidates;
+	int m_candidateCount;
+	int m_candidateCapacity;
 };
 
 #endif
@@ -0,0 +1,379 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <CinderBox2D/Rope/cb2RopeSystem.h>
+#include <CinderBox2D/Common/cb2Draw.h>
+#include <CinderBox2D/Common/cb2Simd.h>
+#include <CinderBox2D/Common/cb2ThreadPool.h>
+#include <memory.h>
+
+// Ropes per task range.
+const int cb2_ropeGrainSize = 8;
+
+class cb2RopeStepTask : public cb2Task
+{
+public:
+	void Execute(int begin, int end, int threadIndex)
+	{
+		CB2_NOT_USED(threadIndex);
+		for (int i = begin; i < end; ++i)
+		{
+			system->StepRope(i, h, iterations);
+		}
+	}
+
+	cb2RopeSystem* system;
+	float h;
+	int iterations;
+};
+
+template <typename T>
+static void cb2GrowBuffer(T** buffer, int count, int capacity)
+{
+	T* oldBuffer = *buffer;
+	*buffer = (T*)cb2Alloc(capacity * sizeof(T));
+	if (oldBuffer)
+	{
+		memcpy(*buffer, oldBuffer, count * sizeof(T));
+		cb2Free(oldBuffer);
+	}
+}
+
+cb2RopeSystem::cb2RopeSystem()
+{
+	m_ropes = NULL;
+	m_ropeCount = 0;
+	m_ropeCapacity = 0;
+	m_ps = NULL;
+	m_p0s = NULL;
+	m_vs = NULL;
+	m_gs = NULL;
+	m_ims = NULL;
+	m_Ls = NULL;
+	m_as = NULL;
+	m_vertexCount = 0;
+	m_vertexCapacity = 0;
+	m_threadPool = NULL;
+}
+
+cb2RopeSystem::~cb2RopeSystem()
+{
+	cb2Free(m_ropes);
+	cb2Free(m_ps);
+	cb2Free(m_p0s);
+	cb2Free(m_vs);
+	cb2Free(m_gs);
+	cb2Free(m_ims);
+	cb2Free(m_Ls);
+	cb2Free(m_as);
+}
+
+void cb2RopeSystem::Reserve(int vertexCount)
+{
+	if (vertexCount <= m_vertexCapacity)
+	{
+		return;
+	}
+
+	int capacity = cb2Max(2 * m_vertexCapacity, vertexCount);
+	cb2GrowBuffer(&m_ps, m_vertexCount, capacity);
+	cb2GrowBuffer(&m_p0s, m_vertexCount, capacity);
+	cb2GrowBuffer(&m_vs, m_vertexCount, capacity);
+	cb2GrowBuffer(&m_gs, m_vertexCount, capacity);
+	cb2GrowBuffer(&m_ims, m_vertexCount, capacity);
+	cb2GrowBuffer(&m_Ls, m_vertexCount, capacity);
+	cb2GrowBuffer(&m_as, m_vertexCount, capacity);
+	m_vertexCapacity = capacity;
+}
+
+int cb2RopeSystem::CreateRope(const cb2RopeDef* def)
+{
+	cb2Assert(def->count >= 3);
+
+	if (m_ropeCount == m_ropeCapacity)
+	{
+		int capacity = cb2Max(2 * m_ropeCapacity, 16);
+		cb2GrowBuffer(&m_ropes, m_ropeCount, capacity);
+		m_ropeCapacity = capacity;
+	}
+
+	Reserve(m_vertexCount + def->count);
+
+	cb2RopeRange* rope = m_ropes + m_ropeCount;
+	rope->start = m_vertexCount;
+	rope->count = def->count;
+	rope->damping = def->damping;
+	rope->k2 = def->k2;
+	rope->k3 = def->k3;
+
+	int start = rope->start;
+	for (int i = 0; i < def->count; ++i)
+	{
+		m_ps[start + i] = def->vertices[i];
+		m_p0s[start + i] = def->vertices[i];
+		cb2::setZero(m_vs[start + i]);
+		m_Ls[start + i] = 0.0f;
+		m_as[start + i] = 0.0f;
+
+		float m = def->masses[i];
+		if (m > 0.0f)
+		{
+			m_ims[start + i] = 1.0f / m;
+			m_gs[start + i] = def->gravity;
+		}
+		else
+		{
+			m_ims[start + i] = 0.0f;
+			cb2::setZero(m_gs[start + i]);
+		}
+	}
+
+	for (int i = 0; i < def->count - 1; ++i)
+	{
+		m_Ls[start + i] = cb2Distance(def->vertices[i], def->vertices[i + 1]);
+	}
+
+	for (int i = 0; i < def->count - 2; ++i)
+	{
+		ci::Vec2f d1 = def->vertices[i + 1] - def->vertices[i];
+		ci::Vec2f d2 = def->vertices[i + 2] - def->vertices[i + 1];
+		m_as[start + i] = cb2Atan2(cb2Cross(d1, d2), cb2Dot(d1, d2));
+	}
+
+	m_vertexCount += def->count;
+	return m_ropeCount++;
+}
+
+int cb2RopeSystem::GetRopeStart(int index) const
+{
+	cb2Assert(0 <= index && index < m_ropeCount);
+	return m_ropes[index].start;
+}
+
+int cb2RopeSystem::GetRopeVertexCount(int index) const
+{
+	cb2Assert(0 <= index && index < m_ropeCount);
+	return m_ropes[index].count;
+}
+
+void cb2RopeSystem::SetAngle(int index, float angle)
+{
+	cb2Assert(0 <= index && index < m_ropeCount);
+	const cb2RopeRange& rope = m_ropes[index];
+	for (int i = 0; i < rope.count - 2; ++i)
+	{
+		m_as[rope.start + i] = angle;
+	}
+}
+
+void cb2RopeSystem::Step(float h, int iterations)
+{
+	if (h == 0.0f || m_ropeCount == 0)
+	{
+		return;
+	}
+
+	if (m_threadPool && m_threadPool->GetThreadCount() > 1)
+	{
+		cb2RopeStepTask task;
+		task.system = this;
+		task.h = h;
+		task.iterations = iterations;
+		m_threadPool->ParallelFor(&task, m_ropeCount, cb2_ropeGrainSize);
+		return;
+	}
+
+	for (int i = 0; i < m_ropeCount; ++i)
+	{
+		StepRope(i, h, iterations);
+	}
+}
+
+void cb2RopeSystem::StepRope(int index, float h, int iterations)
+{
+	const cb2RopeRange& rope = m_ropes[index];
+
+	// The vectors of a rope are contiguous floats, so they are integrated in lanes
+	// of two vertices.
+	float* ps = (float*)(m_ps + rope.start);
+	float* p0s = (float*)(m_p0s + rope.start);
+	float* vs = (float*)(m_vs + rope.start);
+	const float* gs = (const float*)(m_gs + rope.start);
+	int floatCount = 2 * rope.count;
+	int wideCount = floatCount - floatCount % cb2_simdWidth;
+
+	float d = expf(- h * rope.damping);
+	cb2FloatW hW = cb2SplatW(h);
+	cb2FloatW dW = cb2SplatW(d);
+	for (int i = 0; i < wideCount; i += cb2_simdWidth)
+	{
+		cb2FloatW p = cb2LoadW(ps + i);
+		cb2FloatW v = cb2AddW(cb2LoadW(vs + i), cb2MulW(hW, cb2LoadW(gs + i)));
+		v = cb2MulW(dW, v);
+		cb2StoreW(p0s + i, p);
+		cb2StoreW(vs + i, v);
+		cb2StoreW(ps + i, cb2AddW(p, cb2MulW(hW, v)));
+	}
+
+	for (int i = wideCount; i < floatCount; ++i)
+	{
+		p0s[i] = ps[i];
+		vs[i] = d * (vs[i] + h * gs[i]);
+		ps[i] += h * vs[i];
+	}
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		SolveC2(rope, 0);
+		SolveC2(rope, 1);
+		SolveC3(rope, 0);
+		SolveC3(rope, 1);
+		SolveC3(rope, 2);
+		SolveC2(rope, 0);
+		SolveC2(rope, 1);
+	}
+
+	float inv_h = 1.0f / h;
+	cb2FloatW inv_hW = cb2SplatW(inv_h);
+	for (int i = 0; i < wideCount; i += cb2_simdWidth)
+	{
+		cb2StoreW(vs + i, cb2MulW(inv_hW, cb2SubW(cb2LoadW(ps + i), cb2LoadW(p0s + i))));
+	}
+
+	for (int i = wideCount; i < floatCount; ++i)
+	{
+		vs[i] = inv_h * (ps[i] - p0s[i]);
+	}
+}
+
+// The stretch constraints first, first + 2, ...
+void cb2RopeSystem::SolveC2(const cb2RopeRange& rope, int first)
+{
+	ci::Vec2f* ps = m_ps + rope.start;
+	const float* ims = m_ims + rope.start;
+	const float* Ls = m_Ls + rope.start;
+	int count2 = rope.count - 1;
+
+	for (int i = first; i < count2; i += 2)
+	{
+		ci::Vec2f p1 = ps[i];
+		ci::Vec2f p2 = ps[i + 1];
+
+		ci::Vec2f d = p2 - p1;
+		float L = d.length();
+		d /= L;
+
+		float im1 = ims[i];
+		float im2 = ims[i + 1];
+
+		if (im1 + im2 == 0.0f)
+		{
+			continue;
+		}
+
+		float s1 = im1 / (im1 + im2);
+		float s2 = im2 / (im1 + im2);
+
+		ps[i] = p1 - rope.k2 * s1 * (Ls[i] - L) * d;
+		ps[i + 1] = p2 + rope.k2 * s2 * (Ls[i] - L) * d;
+	}
+}
+
+// The bending constraints first, first + 3, ...
+void cb2RopeSystem::SolveC3(const cb2RopeRange& rope, int first)
+{
+	ci::Vec2f* ps = m_ps + rope.start;
+	const float* ims = m_ims + rope.start;
+	const float* as = m_as + rope.start;
+	int count3 = rope.count - 2;
+
+	for (int i = first; i < count3; i += 3)
+	{
+		ci::Vec2f p1 = ps[i];
+		ci::Vec2f p2 = ps[i + 1];
+		ci::Vec2f p3 = ps[i + 2];
+
+		float m1 = ims[i];
+		float m2 = ims[i + 1];
+		float m3 = ims[i + 2];
+
+		ci::Vec2f d1 = p2 - p1;
+		ci::Vec2f d2 = p3 - p2;
+
+		float L1sqr = d1.lengthSquared();
+		float L2sqr = d2.lengthSquared();
+
+		if (L1sqr * L2sqr == 0.0f)
+		{
+			continue;
+		}
+
+		float a = cb2Cross(d1, d2);
+		float b = cb2Dot(d1, d2);
+
+		float angle = cb2Atan2(a, b);
+
+		ci::Vec2f Jd1 = (-1.0f / L1sqr) * cb2::skew(d1);
+		ci::Vec2f Jd2 = (1.0f / L2sqr) * cb2::skew(d2);
+
+		ci::Vec2f J1 = -Jd1;
+		ci::Vec2f J2 = Jd1 - Jd2;
+		ci::Vec2f J3 = Jd2;
+
+		float mass = m1 * cb2Dot(J1, J1) + m2 * cb2Dot(J2, J2) + m3 * cb2Dot(J3, J3);
+		if (mass == 0.0f)
+		{
+			continue;
+		}
+
+		mass = 1.0f / mass;
+
+		float C = angle - as[i];
+
+		while (C > cb2_pi)
+		{
+			angle -= 2 * cb2_pi;
+			C = angle - as[i];
+		}
+
+		while (C < -cb2_pi)
+		{
+			angle += 2.0f * cb2_pi;
+			C = angle - as[i];
+		}
+
+		float impulse = - rope.k3 * mass * C;
+
+		ps[i] = p1 + (m1 * impulse) * J1;
+		ps[i + 1] = p2 + (m2 * impulse) * J2;
+		ps[i + 2] = p3 + (m3 * impulse) * J3;
+	}
+}
+
+void cb2RopeSystem::Draw(cb2Draw* draw) const
+{
+	cb2Color c(0.4f, 0.5f, 0.7f);
+
+	for (int r = 0; r < m_ropeCount; ++r)
+	{
+		const cb2RopeRange& rope = m_ropes[r];
+		for (int i = rope.start; i < rope.start + rope.count - 1; ++i)
+		{
+			draw->DrawSegment(m_ps[i], m_ps[i + 1], c);
+		}
+	}
+}
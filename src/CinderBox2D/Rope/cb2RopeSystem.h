@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef CB2_ROPE_SYSTEM_H
+#define CB2_ROPE_SYSTEM_H
+
+#include <CinderBox2D/Rope/cb2Rope.h>
+
+class cb2Draw;
+class cb2ThreadPool;
+
+/// Many ropes stepped together. The vertices of all ropes share one set of
+/// buffers, so the positions can be drawn as one instanced batch. Unlike cb2Rope,
+/// the constraints are projected in colors: the even and then the odd stretch
+/// constraints, and the bending constraints in three groups. The constraints of a
+/// color do not share vertices, so the results do not depend on the order within
+/// a color. The ropes are independent and may run on several threads.
+class cb2RopeSystem
+{
+public:
+	cb2RopeSystem();
+	~cb2RopeSystem();
+
+	/// Add a rope. Returns the index of the rope.
+	int CreateRope(const cb2RopeDef* def);
+
+	/// Get the number of ropes.
+	int GetRopeCount() const
+	{
+		return m_ropeCount;
+	}
+
+	/// Set the thread pool used to step the ropes. Pass NULL to step them on the
+	/// calling thread.
+	void SetThreadPool(cb2ThreadPool* threadPool)
+	{
+		m_threadPool = threadPool;
+	}
+
+	/// Step all the ropes.
+	void Step(float timeStep, int iterations);
+
+	/// Get the vertices of all ropes, one rope after the other.
+	const ci::Vec2f* GetVertices() const
+	{
+		return m_ps;
+	}
+
+	/// Get the number of vertices of all ropes.
+	int GetVertexCount() const
+	{
+		return m_vertexCount;
+	}
+
+	/// Get the index of the first vertex of a rope in GetVertices.
+	int GetRopeStart(int index) const;
+
+	/// Get the number of vertices of a rope.
+	int GetRopeVertexCount(int index) const;
+
+	/// Set the rest angle of the bending constraints of a rope.
+	void SetAngle(int index, float angle);
+
+	///
+	void Draw(cb2Draw* draw) const;
+
+private:
+
+	friend class cb2RopeStepTask;
+
+	struct cb2RopeRange
+	{
+		int start;
+		int count;
+		float damping;
+		float k2;
+		float k3;
+	};
+
+	void Reserve(int vertexCount);
+	void StepRope(int index, float h, int iterations);
+	void SolveC2(const cb2RopeRange& rope, int first);
+	void SolveC3(const cb2RopeRange& rope, int first);
+
+	cb2RopeRange* m_ropes;
+	int m_ropeCount;
+	int m_ropeCapacity;
+
+	// One entry per vertex. The stretch constraint of a vertex joins it to the
+	// next one, the bending constraint of a vertex spans the next two.
+	ci::Vec2f* m_ps;
+	ci::Vec2f* m_p0s;
+	ci::Vec2f* m_vs;
+	ci::Vec2f* m_gs;
+	float* m_ims;
+	float* m_Ls;
+	float* m_as;
+	int m_vertexCount;
+	int m_vertexCapacity;
+
+	cb2ThreadPool* m_threadPool;
+};
+
+#endif
@@ -20,12 +20,15 @@ class _TBOX_PREFIX_App : public AppNative {
 	
 	cb2World				*mWorld;
 	vector<cb2Body*>		mBoxes;
+	double					mLastTime;
 };
 
 void _TBOX_PREFIX_App::setup()
 {
 	cb2Vec2 gravity( 0.0f, 10.0f );
 	mWorld = new cb2World( gravity );
+	mWorld->SetFixedStep( 1 / 30.0f, 10, 10, 10 );
+	mLastTime = getElapsedSeconds();
 
 	cb2BodyDef groundBodyDef;
 	groundBodyDef.position.Set( 0.0f, getWindowHeight() );
@@ -70,8 +73,9 @@ void _TBOX_PREFIX_App::mouseDown( MouseEvent event )
 
 void _TBOX_PREFIX_App::update()
 {
-	for( int i = 0; i < 10; ++i )
-		mWorld->Step( 1 / 30.0f, 10, 10 );
+	double time = getElapsedSeconds();
+	mWorld->Advance( (float)( time - mLastTime ) );
+	mLastTime = time;
 }
 
 void _TBOX_PREFIX_App::draw()
@@ -80,9 +84,11 @@ void _TBOX_PREFIX_App::draw()
 	gl::clear( Color( 0, 0, 0 ) );
 	
 	gl::color( Color( 1, 0.5f, 0.25f ) );
+	float alpha = mWorld->GetInterpolationAlpha();
 	for( vector<cb2Body*>::const_iterator boxIt = mBoxes.begin(); boxIt != mBoxes.end(); ++boxIt ) {
-		Vec2f pos( (*boxIt)->GetPosition().x, (*boxIt)->GetPosition().y );
-		float t = toDegrees( (*boxIt)->GetAngle() );
+		cb2Transform xf = (*boxIt)->GetInterpolatedTransform( alpha );
+		Vec2f pos( xf.p.x, xf.p.y );
+		float t = toDegrees( xf.q.GetAngle() );
 
 		glPushMatrix();
 		gl::translate( pos );